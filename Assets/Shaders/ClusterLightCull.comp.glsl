@@ -0,0 +1,114 @@
+#version 460
+#extension GL_GOOGLE_include_directive : require
+
+#define CLUSTER_ACCESS writeonly
+#include "ClusteredLighting.glsl"
+
+#define MAX_LIGHTS_PER_CLUSTER 256
+
+// One workgroup per cluster, its invocations stride over the lights
+layout(local_size_x = 64) in;
+
+// Matches LightCullingCounters in ClusteredLighting.h, read back by the host
+layout(set = 0, binding = 4, std430) buffer LightCullingCounters
+{
+    uint lightIndexCount;
+    // Clusters that found more than MAX_LIGHTS_PER_CLUSTER lights, and the lights past that they dropped
+    uint overflowedClusterCount;
+    uint droppedLightCount;
+    // Clusters left unlit because the index list was full
+    uint unlitClusterCount;
+};
+
+layout(push_constant) uniform CullingConstants
+{
+    mat4 view;
+    // P00 and P11 of the projection matrix
+    vec2 projectionScale;
+};
+
+shared uint clusterLights[MAX_LIGHTS_PER_CLUSTER];
+shared uint clusterLightCount;
+shared uint clusterOffset;
+
+float SquaredDistanceToBox(vec3 point, vec3 boxMin, vec3 boxMax)
+{
+    vec3 delta = point - clamp(point, boxMin, boxMax);
+    return dot(delta, delta);
+}
+
+void main()
+{
+    uvec3 cluster = gl_WorkGroupID;
+
+    if (gl_LocalInvocationIndex == 0)
+    {
+        clusterLightCount = 0;
+    }
+
+    // View space bounds of the froxel, depth points away from the eye
+    float sliceNear = SliceDepth(cluster.z);
+    float sliceFar = cluster.z + 1 == clusterCount.z ? 1e30 : SliceDepth(cluster.z + 1);
+
+    vec2 ndcMin = vec2(cluster.xy * tileSize) / vec2(extent) * 2.0 - 1.0;
+    vec2 ndcMax = min(vec2((cluster.xy + 1) * tileSize) / vec2(extent), vec2(1.0)) * 2.0 - 1.0;
+
+    vec2 nearMin = ndcMin * sliceNear / projectionScale;
+    vec2 nearMax = ndcMax * sliceNear / projectionScale;
+    vec2 farMin = ndcMin * sliceFar / projectionScale;
+    vec2 farMax = ndcMax * sliceFar / projectionScale;
+
+    vec3 boxMin = vec3(min(min(nearMin, nearMax), min(farMin, farMax)), sliceNear);
+    vec3 boxMax = vec3(max(max(nearMin, nearMax), max(farMin, farMax)), sliceFar);
+
+    barrier();
+
+    for (uint lightIndex = gl_LocalInvocationIndex; lightIndex < lightCount; lightIndex += gl_WorkGroupSize.x)
+    {
+        Light light = lights[lightIndex];
+        vec4 viewPosition = view * vec4(light.position, 1.0);
+        vec3 center = vec3(viewPosition.xy, -viewPosition.z);
+
+        // Spot lights are binned by their bounding sphere, the cone is applied when shading
+        if (SquaredDistanceToBox(center, boxMin, boxMax) <= light.range * light.range)
+        {
+            uint slot = atomicAdd(clusterLightCount, 1);
+            if (slot < MAX_LIGHTS_PER_CLUSTER)
+            {
+                clusterLights[slot] = lightIndex;
+            }
+        }
+    }
+
+    barrier();
+
+    if (gl_LocalInvocationIndex == 0)
+    {
+        uint count = min(clusterLightCount, MAX_LIGHTS_PER_CLUSTER);
+        if (clusterLightCount > MAX_LIGHTS_PER_CLUSTER)
+        {
+            atomicAdd(overflowedClusterCount, 1);
+            atomicAdd(droppedLightCount, clusterLightCount - MAX_LIGHTS_PER_CLUSTER);
+        }
+
+        uint offset = count > 0 ? atomicAdd(lightIndexCount, count) : 0;
+
+        // Clusters past the index budget go dark instead of writing out of bounds
+        if (offset + count > lightIndexCapacity)
+        {
+            atomicAdd(unlitClusterCount, 1);
+            count = 0;
+        }
+
+        clusterOffset = offset;
+        clusterLightCount = count;
+        clusters[ClusterIndex(cluster)] = uvec2(offset, count);
+    }
+
+    barrier();
+
+    for (uint slot = gl_LocalInvocationIndex; slot < clusterLightCount; slot += gl_WorkGroupSize.x)
+    {
+        lightIndices[clusterOffset + slot] = clusterLights[slot];
+    }
+}
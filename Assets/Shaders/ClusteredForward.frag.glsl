@@ -0,0 +1,41 @@
+#version 460
+#extension GL_GOOGLE_include_directive : require
+
+#include "ClusteredLighting.glsl"
+
+// False loops over every light, kept to compare against
+layout(constant_id = 1) const bool CLUSTERED = true;
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec3 inNormal;
+layout(location = 2) in vec3 inAlbedo;
+
+layout(location = 0) out vec4 outColor;
+
+const float ambient = 0.03;
+
+void main() {
+    vec3 normal = normalize(inNormal);
+    vec3 radiance = vec3(ambient);
+
+    if (CLUSTERED)
+    {
+        // Reversed infinite projection, gl_FragCoord.z = zNear / viewDepth
+        float viewDepth = clusterNear / gl_FragCoord.z;
+        uvec2 cluster = clusters[FragmentCluster(gl_FragCoord.xy, viewDepth)];
+
+        for (uint slot = 0; slot < cluster.y; ++slot)
+        {
+            radiance += EvaluateLight(lights[lightIndices[cluster.x + slot]], inPosition, normal);
+        }
+    }
+    else
+    {
+        for (uint lightIndex = 0; lightIndex < lightCount; ++lightIndex)
+        {
+            radiance += EvaluateLight(lights[lightIndex], inPosition, normal);
+        }
+    }
+
+    outColor = vec4(inAlbedo * radiance, 1.0);
+}
@@ -0,0 +1,26 @@
+#version 460
+
+// Same block as DepthPrepass.vert.glsl so both pipelines share one layout
+layout(push_constant) uniform DrawConstants
+{
+    mat4 viewProjection;
+};
+
+// World space positions from the prepass stream, normal and albedo from a second stream
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec3 inNormal;
+layout(location = 2) in vec3 inAlbedo;
+
+layout(location = 0) out vec3 outPosition;
+layout(location = 1) out vec3 outNormal;
+layout(location = 2) out vec3 outAlbedo;
+
+// The color pass tests with EQUAL, so depth has to match the prepass bit for bit
+invariant gl_Position;
+
+void main() {
+    outPosition = inPosition;
+    outNormal = inNormal;
+    outAlbedo = inAlbedo;
+    gl_Position = viewProjection * vec4(inPosition, 1.0);
+}
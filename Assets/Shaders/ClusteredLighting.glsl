@@ -0,0 +1,90 @@
+// Clustered forward lighting, shared by the light culling pass and forward fragment shaders
+#ifndef LIGHTING_SET
+#define LIGHTING_SET 0
+#endif
+
+// Fragment shaders only read the cluster lists
+#ifndef CLUSTER_ACCESS
+#define CLUSTER_ACCESS readonly
+#endif
+
+// Matches cof::Light, world space
+struct Light
+{
+    vec3 position;
+    float range;
+    vec3 color;
+    float spotCosOuter;
+    vec3 direction;
+    float spotCosInner;
+};
+
+layout(set = LIGHTING_SET, binding = 0, std430) readonly buffer Lights
+{
+    Light lights[];
+};
+
+// (offset into lightIndices, light count) per cluster
+layout(set = LIGHTING_SET, binding = 1, std430) CLUSTER_ACCESS buffer Clusters
+{
+    uvec2 clusters[];
+};
+
+layout(set = LIGHTING_SET, binding = 2, std430) CLUSTER_ACCESS buffer LightIndices
+{
+    uint lightIndices[];
+};
+
+// Matches cof::ClusterGrid
+layout(set = LIGHTING_SET, binding = 3, std140) uniform ClusterGrid
+{
+    uvec3 clusterCount;
+    uint tileSize;
+    float clusterNear;
+    float clusterFar;
+    float sliceScale;
+    float sliceBias;
+    uint lightCount;
+    uint lightIndexCapacity;
+    uvec2 extent;
+};
+
+uint DepthSlice(float viewDepth)
+{
+    return uint(clamp(floor(log(viewDepth) * sliceScale + sliceBias), 0.0, float(clusterCount.z - 1)));
+}
+
+float SliceDepth(uint slice)
+{
+    return exp((float(slice) - sliceBias) / sliceScale);
+}
+
+uint ClusterIndex(uvec3 cluster)
+{
+    return cluster.x + clusterCount.x * (cluster.y + clusterCount.y * cluster.z);
+}
+
+uint FragmentCluster(vec2 fragCoord, float viewDepth)
+{
+    uvec2 tile = min(uvec2(fragCoord) / tileSize, clusterCount.xy - 1);
+    return ClusterIndex(uvec3(tile, DepthSlice(viewDepth)));
+}
+
+// The window reaches zero at the light's range, so culling lights at their range doesn't pop
+vec3 EvaluateLight(Light light, vec3 position, vec3 normal)
+{
+    vec3 toLight = light.position - position;
+    float distanceSquared = max(dot(toLight, toLight), 1e-4);
+    vec3 lightDirection = toLight * inversesqrt(distanceSquared);
+
+    float falloff = distanceSquared / (light.range * light.range);
+    float window = clamp(1.0 - falloff * falloff, 0.0, 1.0);
+    float attenuation = window * window / distanceSquared;
+
+    if (light.spotCosOuter > -1.0)
+    {
+        attenuation *= smoothstep(light.spotCosOuter, light.spotCosInner, dot(-lightDirection, light.direction));
+    }
+
+    return light.color * attenuation * max(dot(normal, lightDirection), 0.0);
+}
@@ -0,0 +1,68 @@
+// Shared culling tests
+// View space positions have the depth axis pointing away from the eye
+// projection holds P00, P11, P22 and P32 of the projection matrix
+
+bool IsSphereInFrustum(vec3 center, float radius, vec4 projection, float zNear, float zFar)
+{
+    float lengthX = sqrt(projection.x * projection.x + 1.0);
+    float lengthY = sqrt(projection.y * projection.y + 1.0);
+
+    bool visible = center.z / lengthX - abs(center.x) * abs(projection.x) / lengthX > -radius;
+    visible = visible && center.z / lengthY - abs(center.y) * abs(projection.y) / lengthY > -radius;
+    visible = visible && center.z + radius > zNear;
+    visible = visible && (zFar <= 0.0 || center.z - radius < zFar);
+    return visible;
+}
+
+// Tangent lines from the eye to the sphere give the exact screen-space bounds of a perspective-projected sphere
+vec2 ProjectSphereExtent(vec2 center, float radius, float projectionScale)
+{
+    float tangentLength = sqrt(dot(center, center) - radius * radius);
+    float first = projectionScale * (center.x * tangentLength - center.y * radius) / (center.x * radius + center.y * tangentLength);
+    float second = projectionScale * (center.x * tangentLength + center.y * radius) / (center.y * tangentLength - center.x * radius);
+    return vec2(min(first, second), max(first, second));
+}
+
+bool IsSphereOccluded(vec3 center, float radius, vec4 projection, float zNear, sampler2D depthPyramid, uvec2 pyramidSize, bool reversedZ)
+{
+    // Spheres crossing the near plane can't be projected conservatively
+    if (center.z < radius + zNear)
+    {
+        return false;
+    }
+
+    vec2 extentX = ProjectSphereExtent(center.xz, radius, projection.x);
+    vec2 extentY = ProjectSphereExtent(center.yz, radius, projection.y);
+    vec4 bounds = clamp(vec4(extentX.x, extentY.x, extentX.y, extentY.y) * 0.5 + 0.5, 0.0, 1.0);
+
+    vec2 boundsSize = (bounds.zw - bounds.xy) * vec2(pyramidSize);
+    int mipCount = textureQueryLevels(depthPyramid);
+    int level = clamp(int(ceil(log2(max(max(boundsSize.x, boundsSize.y), 1.0)))), 0, mipCount - 1);
+
+    // The footprint is at most one texel wide at this level, so it straddles at most 2x2 texels
+    ivec2 levelSize = textureSize(depthPyramid, level);
+    ivec2 minTexel = clamp(ivec2(bounds.xy * vec2(levelSize)), ivec2(0), levelSize - 1);
+    ivec2 maxTexel = clamp(ivec2(bounds.zw * vec2(levelSize)), ivec2(0), levelSize - 1);
+
+    float depth00 = texelFetch(depthPyramid, minTexel, level).x;
+    float depth10 = texelFetch(depthPyramid, ivec2(maxTexel.x, minTexel.y), level).x;
+    float depth01 = texelFetch(depthPyramid, ivec2(minTexel.x, maxTexel.y), level).x;
+    float depth11 = texelFetch(depthPyramid, maxTexel, level).x;
+
+    float nearestSphereDepth = -projection.z + projection.w / (center.z - radius);
+
+    if (reversedZ)
+    {
+        float farthestDepth = min(min(depth00, depth10), min(depth01, depth11));
+        return nearestSphereDepth < farthestDepth;
+    }
+
+    float farthestDepth = max(max(depth00, depth10), max(depth01, depth11));
+    return nearestSphereDepth > farthestDepth;
+}
+
+// The cone apex and axis must be in the same space as the eye at the origin
+bool IsConeBackfacing(vec3 apex, vec3 axis, float cutoff)
+{
+    return dot(normalize(apex), axis) >= cutoff;
+}
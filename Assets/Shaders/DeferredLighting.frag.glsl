@@ -0,0 +1,53 @@
+#version 460
+#extension GL_GOOGLE_include_directive : require
+
+#include "GBuffer.glsl"
+
+layout(input_attachment_index = 0, set = 0, binding = 2) uniform subpassInput gbufferAlbedo;
+layout(input_attachment_index = 1, set = 0, binding = 3) uniform subpassInput gbufferNormal;
+layout(input_attachment_index = 2, set = 0, binding = 4) uniform subpassInput gbufferMaterial;
+layout(input_attachment_index = 3, set = 0, binding = 5) uniform subpassInput gbufferDepth;
+
+layout(location = 0) out vec4 outColor;
+
+const float PI = 3.14159265;
+
+// GGX distribution with Smith-Schlick visibility and Schlick fresnel
+vec3 EvaluateDirectional(vec3 albedo, vec3 normal, vec3 toView, vec3 toLight, float roughness, float metalness)
+{
+    float nDotL = max(dot(normal, toLight), 0.0);
+    float nDotV = max(dot(normal, toView), 1e-4);
+    vec3 halfVector = normalize(toLight + toView);
+    float nDotH = max(dot(normal, halfVector), 0.0);
+    float vDotH = max(dot(toView, halfVector), 0.0);
+
+    float alpha = max(roughness * roughness, 1e-3);
+    float alphaSquared = alpha * alpha;
+    float denominator = nDotH * nDotH * (alphaSquared - 1.0) + 1.0;
+    float distribution = alphaSquared / (PI * denominator * denominator);
+
+    float k = alpha * 0.5;
+    float visibility = 0.25 / ((nDotL * (1.0 - k) + k) * (nDotV * (1.0 - k) + k));
+
+    vec3 f0 = mix(vec3(0.04), albedo, metalness);
+    vec3 fresnel = f0 + (1.0 - f0) * pow(1.0 - vDotH, 5.0);
+
+    vec3 diffuse = (1.0 - fresnel) * (1.0 - metalness) * albedo / PI;
+    return (diffuse + distribution * visibility * fresnel) * nDotL;
+}
+
+void main() {
+    vec3 albedo = subpassLoad(gbufferAlbedo).rgb;
+    vec4 encodedNormal = subpassLoad(gbufferNormal);
+    vec2 material = subpassLoad(gbufferMaterial).rg;
+    float depth = subpassLoad(gbufferDepth).r;
+
+    vec3 normal = PACKED_GBUFFER ? DecodeOctahedral(encodedNormal.xy) : normalize(encodedNormal.xyz);
+
+    vec4 worldPosition = transform * vec4(gl_FragCoord.xy, depth, 1.0);
+    vec3 toView = normalize(cameraPosition.xyz - worldPosition.xyz / worldPosition.w);
+
+    // Radiance of 3 keeps a white lambertian surface facing the light at roughly its albedo
+    vec3 radiance = EvaluateDirectional(albedo, normal, toView, -lightDirection.xyz, material.x, material.y) * 3.0;
+    outColor = vec4(radiance + albedo * lightDirection.w, 1.0);
+}
@@ -0,0 +1,17 @@
+#version 460
+
+// Same block as the color pass so both pipelines share one layout, only the matrix is read
+layout(push_constant) uniform DrawConstants
+{
+    mat4 viewProjection;
+};
+
+// Position only stream, 12 of the 28 bytes an interleaved UnlitColoredVertex fetch would read
+layout(location = 0) in vec3 inPosition;
+
+// The color pass tests with EQUAL, so depth has to match it bit for bit
+invariant gl_Position;
+
+void main() {
+    gl_Position = viewProjection * vec4(inPosition, 1.0);
+}
@@ -0,0 +1,44 @@
+#version 460
+
+layout(local_size_x = 8, local_size_y = 8) in;
+
+layout(constant_id = 0) const bool REVERSED_Z = false;
+
+layout(set = 0, binding = 0) uniform sampler2D sourceImage;
+layout(set = 0, binding = 1, r32f) uniform writeonly image2D destinationImage;
+
+layout(push_constant) uniform ReduceConstants
+{
+    uvec2 destinationSize;
+};
+
+float Farthest(float a, float b)
+{
+    return REVERSED_Z ? min(a, b) : max(a, b);
+}
+
+void main()
+{
+    uvec2 texel = gl_GlobalInvocationID.xy;
+    if (any(greaterThanEqual(texel, destinationSize)))
+    {
+        return;
+    }
+
+    // Cover the whole source footprint so odd sizes stay conservative
+    ivec2 sourceSize = textureSize(sourceImage, 0);
+    vec2 footprint = vec2(sourceSize) / vec2(destinationSize);
+    ivec2 begin = ivec2(floor(vec2(texel) * footprint));
+    ivec2 end = min(ivec2(ceil(vec2(texel + 1) * footprint)), sourceSize);
+
+    float depth = REVERSED_Z ? 1.0 : 0.0;
+    for (int y = begin.y; y < end.y; ++y)
+    {
+        for (int x = begin.x; x < end.x; ++x)
+        {
+            depth = Farthest(depth, texelFetch(sourceImage, ivec2(x, y), 0).x);
+        }
+    }
+
+    imageStore(destinationImage, ivec2(texel), vec4(depth));
+}
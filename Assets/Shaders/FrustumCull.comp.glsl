@@ -0,0 +1,83 @@
+#version 460
+#extension GL_KHR_shader_subgroup_ballot : require
+
+layout(local_size_x = 64) in;
+
+struct DrawInstance
+{
+    vec4 boundingSphere;
+    uint indexCount;
+    uint firstIndex;
+    int vertexOffset;
+    uint padding;
+};
+
+struct DrawIndexedIndirectCommand
+{
+    uint indexCount;
+    uint instanceCount;
+    uint firstIndex;
+    int vertexOffset;
+    uint firstInstance;
+};
+
+layout(set = 0, binding = 0, std430) readonly buffer Instances
+{
+    DrawInstance instances[];
+};
+
+layout(set = 0, binding = 1, std430) writeonly buffer DrawCommands
+{
+    DrawIndexedIndirectCommand drawCommands[];
+};
+
+layout(set = 0, binding = 2, std430) buffer DrawCount
+{
+    uint drawCount;
+};
+
+layout(push_constant) uniform CullingConstants
+{
+    vec4 frustumPlanes[6];
+    uint instanceCount;
+};
+
+bool IsSphereInFrustum(vec3 center, float radius)
+{
+    bool visible = true;
+    for (int plane = 0; plane < 6; ++plane)
+    {
+        visible = visible && dot(frustumPlanes[plane].xyz, center) + frustumPlanes[plane].w > -radius;
+    }
+    return visible;
+}
+
+void main()
+{
+    uint instanceIndex = gl_GlobalInvocationID.x;
+    bool visible = false;
+
+    DrawInstance instance;
+    if (instanceIndex < instanceCount)
+    {
+        instance = instances[instanceIndex];
+        visible = IsSphereInFrustum(instance.boundingSphere.xyz, instance.boundingSphere.w);
+    }
+
+    // One atomic per subgroup instead of one per surviving instance
+    uvec4 visibleBallot = subgroupBallot(visible);
+    uint subgroupDrawCount = subgroupBallotBitCount(visibleBallot);
+
+    uint subgroupBase = 0;
+    if (subgroupElect() && subgroupDrawCount > 0)
+    {
+        subgroupBase = atomicAdd(drawCount, subgroupDrawCount);
+    }
+    subgroupBase = subgroupBroadcastFirst(subgroupBase);
+
+    if (visible)
+    {
+        uint drawIndex = subgroupBase + subgroupBallotExclusiveBitCount(visibleBallot);
+        drawCommands[drawIndex] = DrawIndexedIndirectCommand(instance.indexCount, 1, instance.firstIndex, instance.vertexOffset, instanceIndex);
+    }
+}
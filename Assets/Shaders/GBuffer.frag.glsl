@@ -0,0 +1,21 @@
+#version 460
+#extension GL_GOOGLE_include_directive : require
+
+#include "GBuffer.glsl"
+
+layout(location = 0) in vec3 inNormal;
+layout(location = 1) flat in uint inMaterialIndex;
+
+// Packed: R8G8B8A8_SRGB, R16G16_SFLOAT, R8G8_UNORM. Naive: three R16G16B16A16_SFLOAT targets
+layout(location = 0) out vec4 outAlbedo;
+layout(location = 1) out vec4 outNormal;
+layout(location = 2) out vec4 outMaterial;
+
+void main() {
+    GBufferMaterial material = materials[inMaterialIndex];
+    vec3 normal = normalize(inNormal);
+
+    outAlbedo = vec4(material.baseColor.rgb, 1.0);
+    outNormal = PACKED_GBUFFER ? vec4(EncodeOctahedral(normal), 0.0, 0.0) : vec4(normal, 0.0);
+    outMaterial = vec4(material.roughness, material.metalness, 0.0, 0.0);
+}
@@ -0,0 +1,59 @@
+// Shared declarations of the deferred G-buffer passes
+#extension GL_GOOGLE_include_directive : require
+
+#include "VertexPulling.glsl"
+
+// True for GBufferLayout::Packed, false for the RGBA16F layout
+layout(constant_id = 0) const bool PACKED_GBUFFER = true;
+
+// Matches cof::VisibilityDraw, the index buffer is bound for the draw instead of read through indices
+struct VisibilityDraw
+{
+    mat4 model;
+    vec4 dequantizeOffset;
+    vec4 dequantizeScale;
+    QuantizedLitVertices vertices;
+    uvec2 indices;
+    uint indexCount;
+    uint firstIndex;
+    uint materialIndex;
+    uint padding;
+};
+
+// Matches cof::GBufferMaterial
+struct GBufferMaterial
+{
+    vec4 baseColor;
+    float roughness;
+    float metalness;
+    vec2 padding;
+};
+
+layout(set = 0, binding = 0, std430) readonly buffer Draws
+{
+    VisibilityDraw draws[];
+};
+
+layout(set = 0, binding = 1, std430) readonly buffer Materials
+{
+    GBufferMaterial materials[];
+};
+
+layout(push_constant) uniform GBufferConstants
+{
+    mat4 transform; // viewProjection while rasterizing, pixel coordinates and depth to world space while lighting
+    vec4 lightDirection; // xyz direction the light travels in, w ambient term
+    vec4 cameraPosition;
+    uint drawIndex;
+};
+
+// Octahedral encoding into [-1, 1]^2, the same mapping vertex normals are quantized with
+vec2 EncodeOctahedral(vec3 unitVector)
+{
+    vec2 octahedron = unitVector.xy / (abs(unitVector.x) + abs(unitVector.y) + abs(unitVector.z));
+    if (unitVector.z < 0.0)
+    {
+        octahedron = (1.0 - abs(octahedron.yx)) * mix(vec2(-1.0), vec2(1.0), greaterThanEqual(octahedron, vec2(0.0)));
+    }
+    return octahedron;
+}
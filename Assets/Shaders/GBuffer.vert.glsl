@@ -0,0 +1,17 @@
+#version 460
+#extension GL_GOOGLE_include_directive : require
+
+#include "GBuffer.glsl"
+
+layout(location = 0) out vec3 outNormal;
+layout(location = 1) flat out uint outMaterialIndex;
+
+// Indices are relative to the draw, so gl_VertexIndex indexes its vertices directly
+void main() {
+    VisibilityDraw draw = draws[drawIndex];
+    LitVertex vertex = FetchQuantizedLitVertex(draw.vertices, gl_VertexIndex, draw.dequantizeOffset.xyz, draw.dequantizeScale.xyz);
+
+    outNormal = mat3(draw.model) * vertex.normal;
+    outMaterialIndex = draw.materialIndex;
+    gl_Position = transform * draw.model * vec4(vertex.position, 1.0);
+}
@@ -0,0 +1,131 @@
+#version 460
+#extension GL_GOOGLE_include_directive : require
+
+#include "Culling.glsl"
+
+// One workgroup per meshlet, one invocation per triangle
+layout(local_size_x = 128) in;
+
+layout(constant_id = 0) const bool REVERSED_Z = false;
+
+struct Meshlet
+{
+    vec4 boundingSphere;
+    vec4 coneApex;
+    vec4 coneAxisCutoff;
+    uint vertexOffset;
+    uint triangleOffset;
+    uint vertexCount;
+    uint triangleCount;
+};
+
+struct DrawIndexedIndirectCommand
+{
+    uint indexCount;
+    uint instanceCount;
+    uint firstIndex;
+    int vertexOffset;
+    uint firstInstance;
+};
+
+layout(set = 0, binding = 0, std430) readonly buffer Meshlets
+{
+    Meshlet meshlets[];
+};
+
+layout(set = 0, binding = 1, std430) readonly buffer MeshletVertices
+{
+    uint meshletVertices[];
+};
+
+// Three packed uint8 local indices per triangle
+layout(set = 0, binding = 2, std430) readonly buffer MeshletTriangles
+{
+    uint meshletTriangles[];
+};
+
+layout(set = 0, binding = 3, std430) writeonly buffer CompactedIndices
+{
+    uint compactedIndices[];
+};
+
+layout(set = 0, binding = 4, std430) buffer DrawCommand
+{
+    DrawIndexedIndirectCommand drawCommand;
+};
+
+layout(set = 0, binding = 5) uniform sampler2D depthPyramid;
+
+layout(push_constant) uniform MeshletCullingConstants
+{
+    mat4 view;
+    vec4 projection; // P00, P11, P22, P32
+    float zNear;
+    float zFar; // 0 for an infinite far plane
+    uvec2 pyramidSize;
+    uint meshletCount;
+    uint occlusionEnabled;
+};
+
+shared bool meshletVisible;
+shared uint indexBase;
+
+uint LocalIndex(uint byteOffset)
+{
+    return (meshletTriangles[byteOffset >> 2] >> ((byteOffset & 3) * 8)) & 0xff;
+}
+
+void main()
+{
+    uint meshletIndex = gl_WorkGroupID.x + gl_WorkGroupID.y * gl_NumWorkGroups.x;
+    if (meshletIndex >= meshletCount)
+    {
+        return;
+    }
+
+    Meshlet meshlet = meshlets[meshletIndex];
+
+    if (gl_LocalInvocationIndex == 0)
+    {
+        vec3 depthFlip = vec3(1.0, 1.0, -1.0);
+        vec3 center = (view * vec4(meshlet.boundingSphere.xyz, 1.0)).xyz * depthFlip;
+        float radius = meshlet.boundingSphere.w;
+
+        bool visible = IsSphereInFrustum(center, radius, projection, zNear, zFar);
+
+        if (visible && meshlet.coneAxisCutoff.w < 1.0)
+        {
+            vec3 apex = (view * vec4(meshlet.coneApex.xyz, 1.0)).xyz * depthFlip;
+            vec3 axis = (mat3(view) * meshlet.coneAxisCutoff.xyz) * depthFlip;
+            visible = !IsConeBackfacing(apex, axis, meshlet.coneAxisCutoff.w);
+        }
+
+        if (visible && occlusionEnabled != 0)
+        {
+            visible = !IsSphereOccluded(center, radius, projection, zNear, depthPyramid, pyramidSize, REVERSED_Z);
+        }
+
+        meshletVisible = visible;
+        if (visible)
+        {
+            indexBase = atomicAdd(drawCommand.indexCount, meshlet.triangleCount * 3);
+        }
+    }
+
+    barrier();
+
+    if (!meshletVisible)
+    {
+        return;
+    }
+
+    for (uint triangle = gl_LocalInvocationIndex; triangle < meshlet.triangleCount; triangle += gl_WorkGroupSize.x)
+    {
+        uint byteOffset = meshlet.triangleOffset + triangle * 3;
+        uint outputOffset = indexBase + triangle * 3;
+
+        compactedIndices[outputOffset + 0] = meshletVertices[meshlet.vertexOffset + LocalIndex(byteOffset + 0)];
+        compactedIndices[outputOffset + 1] = meshletVertices[meshlet.vertexOffset + LocalIndex(byteOffset + 1)];
+        compactedIndices[outputOffset + 2] = meshletVertices[meshlet.vertexOffset + LocalIndex(byteOffset + 2)];
+    }
+}
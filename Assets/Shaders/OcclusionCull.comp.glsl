@@ -0,0 +1,130 @@
+#version 460
+#extension GL_KHR_shader_subgroup_ballot : require
+#extension GL_KHR_shader_subgroup_arithmetic : require
+#extension GL_GOOGLE_include_directive : require
+
+#include "Culling.glsl"
+
+layout(local_size_x = 64) in;
+
+layout(constant_id = 0) const bool REVERSED_Z = false;
+
+const uint EARLY_PHASE = 0;
+const uint LATE_PHASE = 1;
+
+struct DrawInstance
+{
+    vec4 boundingSphere;
+    uint indexCount;
+    uint firstIndex;
+    int vertexOffset;
+    uint padding;
+};
+
+struct DrawIndexedIndirectCommand
+{
+    uint indexCount;
+    uint instanceCount;
+    uint firstIndex;
+    int vertexOffset;
+    uint firstInstance;
+};
+
+layout(set = 0, binding = 0, std430) readonly buffer Instances
+{
+    DrawInstance instances[];
+};
+
+layout(set = 0, binding = 1, std430) buffer Visibility
+{
+    uint visibility[];
+};
+
+layout(set = 0, binding = 2, std430) writeonly buffer DrawCommands
+{
+    DrawIndexedIndirectCommand drawCommands[];
+};
+
+layout(set = 0, binding = 3, std430) buffer CullingCounters
+{
+    uint drawCounts[2];
+    uint frustumCulledCount;
+    uint occlusionCulledCount;
+};
+
+layout(set = 0, binding = 4) uniform sampler2D depthPyramid;
+
+layout(push_constant) uniform OcclusionCullingConstants
+{
+    mat4 view;
+    vec4 projection; // P00, P11, P22, P32
+    float zNear;
+    float zFar; // 0 for an infinite far plane
+    uvec2 pyramidSize;
+    uint instanceCount;
+    uint phase;
+    uint lateDrawOffset;
+};
+
+void main()
+{
+    uint instanceIndex = gl_GlobalInvocationID.x;
+
+    bool draw = false;
+    bool frustumCulled = false;
+    bool occlusionCulled = false;
+
+    DrawInstance instance;
+    if (instanceIndex < instanceCount)
+    {
+        instance = instances[instanceIndex];
+        bool visibleLastFrame = visibility[instanceIndex] != 0;
+
+        // View space with the depth axis pointing away from the eye
+        vec3 center = (view * vec4(instance.boundingSphere.xyz, 1.0)).xyz * vec3(1.0, 1.0, -1.0);
+        float radius = instance.boundingSphere.w;
+
+        if (phase == EARLY_PHASE)
+        {
+            draw = visibleLastFrame && IsSphereInFrustum(center, radius, projection, zNear, zFar);
+        }
+        else
+        {
+            frustumCulled = !IsSphereInFrustum(center, radius, projection, zNear, zFar);
+            occlusionCulled = !frustumCulled && IsSphereOccluded(center, radius, projection, zNear, depthPyramid, pyramidSize, REVERSED_Z);
+
+            bool visible = !frustumCulled && !occlusionCulled;
+            draw = visible && !visibleLastFrame;
+            visibility[instanceIndex] = visible ? 1 : 0;
+        }
+    }
+
+    uvec4 drawBallot = subgroupBallot(draw);
+    uint subgroupDrawCount = subgroupBallotBitCount(drawBallot);
+    uint subgroupFrustumCulled = subgroupAdd(frustumCulled ? 1 : 0);
+    uint subgroupOcclusionCulled = subgroupAdd(occlusionCulled ? 1 : 0);
+
+    uint subgroupBase = 0;
+    if (subgroupElect())
+    {
+        if (subgroupDrawCount > 0)
+        {
+            subgroupBase = atomicAdd(drawCounts[phase], subgroupDrawCount);
+        }
+        if (subgroupFrustumCulled > 0)
+        {
+            atomicAdd(frustumCulledCount, subgroupFrustumCulled);
+        }
+        if (subgroupOcclusionCulled > 0)
+        {
+            atomicAdd(occlusionCulledCount, subgroupOcclusionCulled);
+        }
+    }
+    subgroupBase = subgroupBroadcastFirst(subgroupBase);
+
+    if (draw)
+    {
+        uint drawIndex = phase * lateDrawOffset + subgroupBase + subgroupBallotExclusiveBitCount(drawBallot);
+        drawCommands[drawIndex] = DrawIndexedIndirectCommand(instance.indexCount, 1, instance.firstIndex, instance.vertexOffset, instanceIndex);
+    }
+}
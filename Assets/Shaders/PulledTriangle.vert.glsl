@@ -0,0 +1,21 @@
+#version 460
+#extension GL_GOOGLE_include_directive : require
+
+#include "VertexPulling.glsl"
+
+// Base pointer of the draw's vertices, gl_VertexIndex already includes the draw's vertex offset
+layout(push_constant) uniform DrawConstants
+{
+    mat4 viewProjection;
+    UnlitColoredVertices vertexBuffer;
+};
+
+layout(location = 0) out vec3 fragColor;
+
+invariant gl_Position;
+
+void main() {
+    UnlitColoredVertex vertex = vertexBuffer.vertices[gl_VertexIndex];
+    gl_Position = viewProjection * vec4(vertex.position, 1.0);
+    fragColor = vertex.color.rgb;
+}
@@ -0,0 +1,22 @@
+// Decoding for the quantized vertex formats in Vertex.h
+// Positions arrive already normalized by the R16G16B16A16_UNORM fetch and are mapped back with the mesh's QuantizationTransform
+
+vec3 DequantizePosition(vec3 position, vec3 offset, vec3 scale)
+{
+    return offset + position * 65535.0 * scale;
+}
+
+// Octahedral unit vectors arrive normalized by the R16G16_SNORM fetch
+vec3 DecodeOctahedral(vec2 encoded)
+{
+    vec3 unitVector = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+    float fold = max(-unitVector.z, 0.0);
+    unitVector.xy += mix(vec2(fold), vec2(-fold), greaterThanEqual(unitVector.xy, vec2(0.0)));
+    return normalize(unitVector);
+}
+
+// The bitangent sign is stored in position.w, 0 for -1 and 1 for +1
+float BitangentSign(float positionW)
+{
+    return positionW * 2.0 - 1.0;
+}
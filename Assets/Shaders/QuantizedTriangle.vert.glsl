@@ -0,0 +1,21 @@
+#version 460
+
+// viewProjection has the scene's QuantizationTransform::Matrix() folded in, like DepthPrepass.vert.glsl gets it
+layout(push_constant) uniform DrawConstants
+{
+    mat4 viewProjection;
+};
+
+// cof::QuantizedUnlitColoredVertex, normalized to [0, 1] by the R16G16B16A16_UNORM and R8G8B8A8_UNORM fetches
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec4 inColor;
+
+layout(location = 0) out vec3 fragColor;
+
+// The same expression as the depth prepass, so the EQUAL depth test passes
+invariant gl_Position;
+
+void main() {
+    gl_Position = viewProjection * vec4(inPosition, 1.0);
+    fragColor = inColor.rgb;
+}
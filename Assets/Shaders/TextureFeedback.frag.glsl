@@ -0,0 +1,21 @@
+#version 460
+#extension GL_GOOGLE_include_directive : require
+
+#include "TextureFeedback.glsl"
+
+layout(location = 0) in vec2 inTexCoord;
+layout(location = 1) flat in uint inMaterialIndex;
+
+// The LOD is independent of the texture, the CPU adds log2 of each texture's size to get its mip level
+void main() {
+    vec2 dx = dFdx(inTexCoord);
+    vec2 dy = dFdy(inTexCoord);
+    float lod = 0.5 * log2(max(max(dot(dx, dx), dot(dy, dy)), 1e-20));
+    uint request = uint(clamp(lod + FEEDBACK_LOD_OFFSET, 0.0, 2.0 * FEEDBACK_LOD_OFFSET) * FEEDBACK_LOD_SCALE);
+
+    // Most pixels of a material ask for the same LOD, the plain read skips nearly all atomics
+    if (request < requests[inMaterialIndex])
+    {
+        atomicMin(requests[inMaterialIndex], request);
+    }
+}
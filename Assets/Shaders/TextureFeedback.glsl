@@ -0,0 +1,40 @@
+// Shared declarations of the texture feedback pass
+#extension GL_GOOGLE_include_directive : require
+
+#include "VertexPulling.glsl"
+
+// Matches cof::TextureFeedbackPass, a request is the finest LOD in units of a one texel texture, in fixed point
+const float FEEDBACK_LOD_OFFSET = 32.0;
+const float FEEDBACK_LOD_SCALE = 256.0;
+const uint NO_FEEDBACK = 0xffffffff;
+
+// Matches cof::VisibilityDraw, the index buffer is bound for the draw instead of read through indices
+struct VisibilityDraw
+{
+    mat4 model;
+    vec4 dequantizeOffset;
+    vec4 dequantizeScale;
+    QuantizedLitVertices vertices;
+    uvec2 indices;
+    uint indexCount;
+    uint firstIndex;
+    uint materialIndex;
+    uint padding;
+};
+
+layout(set = 0, binding = 0, std430) readonly buffer Draws
+{
+    VisibilityDraw draws[];
+};
+
+// One request per material, reset to NO_FEEDBACK every frame
+layout(set = 0, binding = 1, std430) buffer Feedback
+{
+    uint requests[];
+};
+
+layout(push_constant) uniform FeedbackConstants
+{
+    mat4 viewProjection;
+    uint drawIndex;
+};
@@ -0,0 +1,17 @@
+#version 460
+#extension GL_GOOGLE_include_directive : require
+
+#include "TextureFeedback.glsl"
+
+layout(location = 0) out vec2 outTexCoord;
+layout(location = 1) flat out uint outMaterialIndex;
+
+// Indices are relative to the draw, so gl_VertexIndex indexes its vertices directly
+void main() {
+    VisibilityDraw draw = draws[drawIndex];
+    LitVertex vertex = FetchQuantizedLitVertex(draw.vertices, gl_VertexIndex, draw.dequantizeOffset.xyz, draw.dequantizeScale.xyz);
+
+    outTexCoord = vertex.texCoord;
+    outMaterialIndex = draw.materialIndex;
+    gl_Position = viewProjection * draw.model * vec4(vertex.position, 1.0);
+}
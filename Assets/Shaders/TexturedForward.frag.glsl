@@ -0,0 +1,21 @@
+#version 460
+#extension GL_GOOGLE_include_directive : require
+
+#include "TexturedForward.glsl"
+
+// cof::TextureStreamer's set, only textures it has made sampleable are drawn with
+layout(set = 1, binding = 0) uniform sampler2D textures[MAX_TEXTURE_COUNT];
+
+layout(location = 0) in vec3 inNormal;
+layout(location = 1) in vec2 inTexCoord;
+layout(location = 2) flat in uint inMaterialIndex;
+
+layout(location = 0) out vec4 outColor;
+
+// Lit like VisibilityResolve.comp.glsl. The material index is the same for the whole draw, so indexing the array with it
+// only needs dynamic indexing
+void main() {
+    vec4 baseColor = baseColors[inMaterialIndex] * texture(textures[inMaterialIndex], inTexCoord);
+    float diffuse = max(dot(normalize(inNormal), -lightDirection.xyz), 0.0);
+    outColor = vec4(baseColor.rgb * (lightDirection.w + diffuse), 1.0);
+}
@@ -0,0 +1,39 @@
+// Shared declarations of NomadBench's textured forward passes, set 1 holds the textures and is declared by the fragment shaders
+#extension GL_GOOGLE_include_directive : require
+
+#include "VertexPulling.glsl"
+
+// Matches cof::VisibilityBuffer::maxMaterialCount, the renderers hold at most a texture per material
+const uint MAX_TEXTURE_COUNT = 32;
+
+// Matches cof::VisibilityDraw, the index buffer is bound for the draw instead of read through indices
+struct VisibilityDraw
+{
+    mat4 model;
+    vec4 dequantizeOffset;
+    vec4 dequantizeScale;
+    QuantizedLitVertices vertices;
+    uvec2 indices;
+    uint indexCount;
+    uint firstIndex;
+    uint materialIndex;
+    uint padding;
+};
+
+layout(set = 0, binding = 0, std430) readonly buffer Draws
+{
+    VisibilityDraw draws[];
+};
+
+// Base color factor per material, it multiplies the material's texture
+layout(set = 0, binding = 1, std430) readonly buffer Materials
+{
+    vec4 baseColors[];
+};
+
+layout(push_constant) uniform TexturedConstants
+{
+    mat4 viewProjection;
+    vec4 lightDirection; // xyz direction the light travels in, w ambient term
+    uint drawIndex;
+};
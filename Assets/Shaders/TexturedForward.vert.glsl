@@ -0,0 +1,22 @@
+#version 460
+#extension GL_GOOGLE_include_directive : require
+
+#include "TexturedForward.glsl"
+
+layout(location = 0) out vec3 outNormal;
+layout(location = 1) out vec2 outTexCoord;
+layout(location = 2) flat out uint outMaterialIndex;
+
+// The depth prepass runs this shader on its own, the color pass tests against it for equality
+invariant gl_Position;
+
+// Indices are relative to the draw, so gl_VertexIndex indexes its vertices directly
+void main() {
+    VisibilityDraw draw = draws[drawIndex];
+    LitVertex vertex = FetchQuantizedLitVertex(draw.vertices, gl_VertexIndex, draw.dequantizeOffset.xyz, draw.dequantizeScale.xyz);
+
+    outNormal = mat3(draw.model) * vertex.normal;
+    outTexCoord = vertex.texCoord;
+    outMaterialIndex = draw.materialIndex;
+    gl_Position = viewProjection * draw.model * vec4(vertex.position, 1.0);
+}
@@ -1,11 +1,18 @@
 #version 460
 
-layout(location = 0) in vec2 inPosition;
-layout(location = 1) in vec3 inColor;
+layout(push_constant) uniform DrawConstants
+{
+    mat4 viewProjection;
+};
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec4 inColor;
 
 layout(location = 0) out vec3 fragColor;
 
+invariant gl_Position;
+
 void main() {
-    gl_Position = vec4(inPosition, 0.0, 1.0);
-    fragColor = inColor;
+    gl_Position = viewProjection * vec4(inPosition, 1.0);
+    fragColor = inColor.rgb;
 }
\ No newline at end of file
@@ -0,0 +1,52 @@
+// Vertex formats fetched through buffer device addresses instead of the vertex input stage
+#extension GL_EXT_buffer_reference : require
+#extension GL_EXT_scalar_block_layout : require
+
+#include "Quantization.glsl"
+
+// Matches cof::UnlitColoredVertex
+struct UnlitColoredVertex
+{
+    vec3 position;
+    vec4 color;
+};
+
+layout(buffer_reference, scalar, buffer_reference_align = 4) readonly buffer UnlitColoredVertices
+{
+    UnlitColoredVertex vertices[];
+};
+
+// cof::QuantizedLitVertex, five words per vertex
+layout(buffer_reference, scalar, buffer_reference_align = 4) readonly buffer QuantizedLitVertices
+{
+    uint words[];
+};
+
+struct LitVertex
+{
+    vec3 position;
+    vec3 normal;
+    vec4 tangent;
+    vec2 texCoord;
+};
+
+// Position only fetch for depth and visibility passes
+vec3 FetchQuantizedPosition(QuantizedLitVertices vertices, uint index, vec3 offset, vec3 scale)
+{
+    uint base = index * 5;
+    vec3 position = vec3(unpackUnorm2x16(vertices.words[base + 0]), unpackUnorm2x16(vertices.words[base + 1]).x);
+    return DequantizePosition(position, offset, scale);
+}
+
+LitVertex FetchQuantizedLitVertex(QuantizedLitVertices vertices, uint index, vec3 offset, vec3 scale)
+{
+    uint base = index * 5;
+    vec4 position = vec4(unpackUnorm2x16(vertices.words[base + 0]), unpackUnorm2x16(vertices.words[base + 1]));
+
+    LitVertex vertex;
+    vertex.position = DequantizePosition(position.xyz, offset, scale);
+    vertex.normal = DecodeOctahedral(unpackSnorm2x16(vertices.words[base + 2]));
+    vertex.tangent = vec4(DecodeOctahedral(unpackSnorm2x16(vertices.words[base + 3])), BitangentSign(position.w));
+    vertex.texCoord = unpackHalf2x16(vertices.words[base + 4]);
+    return vertex;
+}
@@ -0,0 +1,58 @@
+// Page lookup of software virtual textures, shared by the feedback pass and every shader sampling virtual textures
+
+// Matches cof::VirtualTextureCache
+const float VT_PAGE_SIZE = 128.0;
+const float VT_PAGE_BORDER = 4.0;
+const float VT_PHYSICAL_PAGE_SIZE = VT_PAGE_SIZE + 2.0 * VT_PAGE_BORDER;
+const uint VT_NO_TEXTURE = 0xffffffff;
+const uint VT_NO_REQUEST = 0xffffffff;
+
+// Matches cof::VirtualTextureMaterial, textureIndex is VT_NO_TEXTURE for materials without a virtual texture
+struct VirtualTextureMaterial
+{
+    uint textureIndex;
+    uint pageCount;
+    uint mipCount;
+    uint padding;
+};
+
+// Finest mip the footprint of the pixel needs, lodBias moves derivatives of a smaller target to the screen's
+uint VirtualMip(VirtualTextureMaterial material, vec2 uv, float lodBias)
+{
+    float virtualSize = float(material.pageCount) * VT_PAGE_SIZE;
+    vec2 dx = dFdx(uv) * virtualSize;
+    vec2 dy = dFdy(uv) * virtualSize;
+    float lod = 0.5 * log2(max(max(dot(dx, dx), dot(dy, dy)), 1e-20)) + lodBias;
+    return uint(clamp(floor(lod), 0.0, float(material.mipCount - 1)));
+}
+
+uvec2 VirtualPage(VirtualTextureMaterial material, vec2 uv, uint mip)
+{
+    uint pageCount = material.pageCount >> mip;
+    return min(uvec2(fract(uv) * float(pageCount)), uvec2(pageCount - 1));
+}
+
+// Matches cof::PackVirtualPage
+uint PackVirtualPage(uint textureIndex, uint mip, uvec2 page)
+{
+    return (textureIndex << 26) | (mip << 22) | (page.y << 11) | page.x;
+}
+
+// The indirection texel of a page points at the finest resident page covering it: rg its atlas slot, b its mip, a
+// whether there is one. Filtering stays within the page, the border holds the texels of its neighbours
+vec4 SampleVirtualTexture(sampler2D atlas, usampler2D indirection, VirtualTextureMaterial material, vec2 uv)
+{
+    uint mip = VirtualMip(material, uv, 0.0);
+    uvec4 entry = texelFetch(indirection, ivec2(VirtualPage(material, uv, mip)), int(mip));
+    if (entry.a == 0)
+    {
+        return vec4(0.5, 0.5, 0.5, 1.0);
+    }
+
+    vec2 residentPages = vec2(float(material.pageCount >> entry.b));
+    vec2 pageUv = fract(uv) * residentPages;
+    pageUv -= min(floor(pageUv), residentPages - 1.0);
+
+    vec2 atlasTexel = vec2(entry.rg) * VT_PHYSICAL_PAGE_SIZE + VT_PAGE_BORDER + pageUv * VT_PAGE_SIZE;
+    return textureLod(atlas, atlasTexel / vec2(textureSize(atlas, 0)), 0.0);
+}
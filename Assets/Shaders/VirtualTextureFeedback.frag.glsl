@@ -0,0 +1,36 @@
+#version 460
+#extension GL_GOOGLE_include_directive : require
+
+#include "VirtualTexture.glsl"
+
+// Runs with TextureFeedback.vert.glsl, which only uses binding 0 and the push constants
+layout(constant_id = 0) const uint FEEDBACK_WIDTH = 1;
+// log2 of how much smaller the feedback target is than the screen
+layout(constant_id = 1) const float FEEDBACK_LOD_BIAS = 0.0;
+
+layout(location = 0) in vec2 inTexCoord;
+layout(location = 1) flat in uint inMaterialIndex;
+
+// One page per pixel, reset to VT_NO_REQUEST every frame
+layout(set = 0, binding = 1, std430) writeonly buffer Requests
+{
+    uint requests[];
+};
+
+layout(set = 0, binding = 2, std430) readonly buffer Materials
+{
+    VirtualTextureMaterial materials[];
+};
+
+// Depth tested, so the pixel holds the page of the surface that ends up on screen
+void main() {
+    VirtualTextureMaterial material = materials[inMaterialIndex];
+    if (material.textureIndex == VT_NO_TEXTURE)
+    {
+        return;
+    }
+
+    uint mip = VirtualMip(material, inTexCoord, -FEEDBACK_LOD_BIAS);
+    uvec2 pixel = uvec2(gl_FragCoord.xy);
+    requests[pixel.y * FEEDBACK_WIDTH + pixel.x] = PackVirtualPage(material.textureIndex, mip, VirtualPage(material, inTexCoord, mip));
+}
@@ -0,0 +1,35 @@
+#version 460
+#extension GL_GOOGLE_include_directive : require
+
+#include "TexturedForward.glsl"
+#include "VirtualTexture.glsl"
+
+layout(location = 0) in vec3 inNormal;
+layout(location = 1) in vec2 inTexCoord;
+layout(location = 2) flat in uint inMaterialIndex;
+
+layout(location = 0) out vec4 outColor;
+
+// Per material, textureIndex is VT_NO_TEXTURE for materials drawn with their base color only
+layout(set = 0, binding = 2, std430) readonly buffer VirtualMaterials
+{
+    VirtualTextureMaterial virtualMaterials[];
+};
+
+// cof::VirtualTextureCache's set
+layout(set = 1, binding = 0) uniform sampler2D atlas;
+layout(set = 1, binding = 1) uniform usampler2D indirections[MAX_TEXTURE_COUNT];
+
+// Lit like TexturedForward.frag.glsl. The material is the same for the whole draw, so the derivatives SampleVirtualTexture
+// takes stay in uniform control flow
+void main() {
+    VirtualTextureMaterial material = virtualMaterials[inMaterialIndex];
+    vec4 baseColor = baseColors[inMaterialIndex];
+    if (material.textureIndex != VT_NO_TEXTURE)
+    {
+        baseColor *= SampleVirtualTexture(atlas, indirections[material.textureIndex], material, inTexCoord);
+    }
+
+    float diffuse = max(dot(normalize(inNormal), -lightDirection.xyz), 0.0);
+    outColor = vec4(baseColor.rgb * (lightDirection.w + diffuse), 1.0);
+}
@@ -0,0 +1,10 @@
+#version 460
+#extension GL_GOOGLE_include_directive : require
+
+#include "VisibilityBuffer.glsl"
+
+layout(location = 0) out uint outVisibility;
+
+void main() {
+    outVisibility = PackVisibility(drawOrMaterialIndex, uint(gl_PrimitiveID));
+}
@@ -0,0 +1,55 @@
+// Shared declarations of the visibility buffer passes
+#extension GL_GOOGLE_include_directive : require
+
+#include "VertexPulling.glsl"
+
+// Matches cof::VisibilityBuffer, a pixel holds (draw index << TRIANGLE_ID_BITS) | triangle index
+const uint TRIANGLE_ID_BITS = 23;
+const uint TRIANGLE_ID_MASK = (1u << TRIANGLE_ID_BITS) - 1;
+const uint EMPTY_VISIBILITY = 0xffffffff;
+const uint TILE_SIZE = 8;
+const uint MAX_MATERIAL_COUNT = 32;
+
+layout(buffer_reference, scalar, buffer_reference_align = 4) readonly buffer Indices
+{
+    uint indices[];
+};
+
+// Matches cof::VisibilityDraw
+struct VisibilityDraw
+{
+    mat4 model;
+    vec4 dequantizeOffset;
+    vec4 dequantizeScale;
+    QuantizedLitVertices vertices;
+    Indices indices;
+    uint indexCount;
+    uint firstIndex;
+    uint materialIndex;
+    uint padding;
+};
+
+// Matches cof::VisibilityMaterial
+struct VisibilityMaterial
+{
+    vec4 baseColor;
+};
+
+layout(set = 0, binding = 0, std430) readonly buffer Draws
+{
+    VisibilityDraw draws[];
+};
+
+layout(push_constant) uniform VisibilityConstants
+{
+    mat4 viewProjection;
+    vec4 lightDirection; // xyz direction the light travels in, w ambient term
+    uint drawOrMaterialIndex;
+    uint tileCount;
+    uvec2 extent;
+};
+
+uint PackVisibility(uint drawIndex, uint triangleIndex)
+{
+    return (drawIndex << TRIANGLE_ID_BITS) | (triangleIndex & TRIANGLE_ID_MASK);
+}
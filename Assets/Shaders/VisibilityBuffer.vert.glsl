@@ -0,0 +1,11 @@
+#version 460
+#extension GL_GOOGLE_include_directive : require
+
+#include "VisibilityBuffer.glsl"
+
+// Indices are relative to the draw, so gl_VertexIndex indexes its vertices directly
+void main() {
+    VisibilityDraw draw = draws[drawOrMaterialIndex];
+    vec3 position = FetchQuantizedPosition(draw.vertices, gl_VertexIndex, draw.dequantizeOffset.xyz, draw.dequantizeScale.xyz);
+    gl_Position = viewProjection * draw.model * vec4(position, 1.0);
+}
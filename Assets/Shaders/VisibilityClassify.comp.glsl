@@ -0,0 +1,66 @@
+#version 460
+#extension GL_GOOGLE_include_directive : require
+
+#include "VisibilityBuffer.glsl"
+
+// One workgroup per tile, appends the tile to the list of every material visible in it
+layout(local_size_x = 8, local_size_y = 8) in;
+
+struct DispatchIndirectCommand
+{
+    uint x;
+    uint y;
+    uint z;
+};
+
+layout(set = 0, binding = 2, r32ui) uniform readonly uimage2D visibilityImage;
+layout(set = 0, binding = 3, rgba8) uniform writeonly image2D shadedImage;
+
+// MAX_MATERIAL_COUNT lists of tileCount packed tile coordinates
+layout(set = 0, binding = 4, std430) writeonly buffer TileLists
+{
+    uint tileLists[];
+};
+
+layout(set = 0, binding = 5, std430) buffer MaterialDispatches
+{
+    DispatchIndirectCommand materialDispatches[MAX_MATERIAL_COUNT];
+};
+
+const vec4 BACKGROUND_COLOR = vec4(0.0, 0.0, 0.0, 1.0);
+
+shared uint tileMaterials;
+
+void main()
+{
+    if (gl_LocalInvocationIndex == 0)
+    {
+        tileMaterials = 0;
+    }
+
+    barrier();
+
+    ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+    if (all(lessThan(gl_GlobalInvocationID.xy, extent)))
+    {
+        uint visibility = imageLoad(visibilityImage, pixel).x;
+        if (visibility == EMPTY_VISIBILITY)
+        {
+            // Nothing resolves empty pixels, so clear them here
+            imageStore(shadedImage, pixel, BACKGROUND_COLOR);
+        }
+        else
+        {
+            atomicOr(tileMaterials, 1u << draws[visibility >> TRIANGLE_ID_BITS].materialIndex);
+        }
+    }
+
+    barrier();
+
+    uint material = gl_LocalInvocationIndex;
+    if (material < MAX_MATERIAL_COUNT && (tileMaterials & (1u << material)) != 0)
+    {
+        uint slot = atomicAdd(materialDispatches[material].x, 1);
+        tileLists[material * tileCount + slot] = gl_WorkGroupID.x | (gl_WorkGroupID.y << 16);
+    }
+}
@@ -0,0 +1,114 @@
+#version 460
+#extension GL_GOOGLE_include_directive : require
+
+#include "VisibilityBuffer.glsl"
+
+// One workgroup per tile of the material being resolved, every pixel is shaded exactly once
+layout(local_size_x = 8, local_size_y = 8) in;
+
+layout(set = 0, binding = 1, std430) readonly buffer Materials
+{
+    VisibilityMaterial materials[];
+};
+
+layout(set = 0, binding = 2, r32ui) uniform readonly uimage2D visibilityImage;
+layout(set = 0, binding = 3, rgba8) uniform writeonly image2D shadedImage;
+
+layout(set = 0, binding = 4, std430) readonly buffer TileLists
+{
+    uint tileLists[];
+};
+
+struct Barycentrics
+{
+    vec3 lambda;
+    vec3 ddx;
+    vec3 ddy;
+};
+
+// Perspective correct barycentrics and their screen space derivatives from the clip space triangle,
+// following "The Visibility Buffer: A Cache-Friendly Approach to Deferred Shading"
+Barycentrics ComputeBarycentrics(vec4 clip0, vec4 clip1, vec4 clip2, vec2 pixelNdc, vec2 size)
+{
+    vec3 invW = 1.0 / vec3(clip0.w, clip1.w, clip2.w);
+
+    vec2 ndc0 = clip0.xy * invW.x;
+    vec2 ndc1 = clip1.xy * invW.y;
+    vec2 ndc2 = clip2.xy * invW.z;
+
+    float invDet = 1.0 / determinant(mat2(ndc2 - ndc1, ndc0 - ndc1));
+    vec3 ddx = vec3(ndc1.y - ndc2.y, ndc2.y - ndc0.y, ndc0.y - ndc1.y) * invDet * invW;
+    vec3 ddy = vec3(ndc2.x - ndc1.x, ndc0.x - ndc2.x, ndc1.x - ndc0.x) * invDet * invW;
+    float ddxSum = dot(ddx, vec3(1.0));
+    float ddySum = dot(ddy, vec3(1.0));
+
+    vec2 delta = pixelNdc - ndc0;
+    float interpolatedInvW = invW.x + delta.x * ddxSum + delta.y * ddySum;
+    float interpolatedW = 1.0 / interpolatedInvW;
+
+    Barycentrics result;
+    result.lambda.x = interpolatedW * (invW.x + delta.x * ddx.x + delta.y * ddy.x);
+    result.lambda.y = interpolatedW * (delta.x * ddx.y + delta.y * ddy.y);
+    result.lambda.z = interpolatedW * (delta.x * ddx.z + delta.y * ddy.z);
+
+    // Derivatives per pixel instead of per NDC unit
+    ddx *= 2.0 / size.x;
+    ddy *= 2.0 / size.y;
+    ddxSum *= 2.0 / size.x;
+    ddySum *= 2.0 / size.y;
+
+    float interpolatedWdx = 1.0 / (interpolatedInvW + ddxSum);
+    float interpolatedWdy = 1.0 / (interpolatedInvW + ddySum);
+    result.ddx = interpolatedWdx * (result.lambda * interpolatedInvW + ddx) - result.lambda;
+    result.ddy = interpolatedWdy * (result.lambda * interpolatedInvW + ddy) - result.lambda;
+    return result;
+}
+
+void main()
+{
+    uint materialIndex = drawOrMaterialIndex;
+    uint tile = tileLists[materialIndex * tileCount + gl_WorkGroupID.x];
+    ivec2 pixel = ivec2(uvec2(tile & 0xffff, tile >> 16) * TILE_SIZE + gl_LocalInvocationID.xy);
+
+    if (any(greaterThanEqual(uvec2(pixel), extent)))
+    {
+        return;
+    }
+
+    uint visibility = imageLoad(visibilityImage, pixel).x;
+    if (visibility == EMPTY_VISIBILITY)
+    {
+        return;
+    }
+
+    VisibilityDraw draw = draws[visibility >> TRIANGLE_ID_BITS];
+
+    // Pixels of other materials in this tile are resolved by their own dispatch
+    if (draw.materialIndex != materialIndex)
+    {
+        return;
+    }
+
+    uint firstIndex = (visibility & TRIANGLE_ID_MASK) * 3;
+    LitVertex vertex0 = FetchQuantizedLitVertex(draw.vertices, draw.indices.indices[firstIndex + 0], draw.dequantizeOffset.xyz, draw.dequantizeScale.xyz);
+    LitVertex vertex1 = FetchQuantizedLitVertex(draw.vertices, draw.indices.indices[firstIndex + 1], draw.dequantizeOffset.xyz, draw.dequantizeScale.xyz);
+    LitVertex vertex2 = FetchQuantizedLitVertex(draw.vertices, draw.indices.indices[firstIndex + 2], draw.dequantizeOffset.xyz, draw.dequantizeScale.xyz);
+
+    mat4 modelViewProjection = viewProjection * draw.model;
+    vec4 clip0 = modelViewProjection * vec4(vertex0.position, 1.0);
+    vec4 clip1 = modelViewProjection * vec4(vertex1.position, 1.0);
+    vec4 clip2 = modelViewProjection * vec4(vertex2.position, 1.0);
+
+    vec2 pixelNdc = (vec2(pixel) + 0.5) / vec2(extent) * 2.0 - 1.0;
+    Barycentrics barycentrics = ComputeBarycentrics(clip0, clip1, clip2, pixelNdc, vec2(extent));
+    vec3 lambda = barycentrics.lambda;
+
+    vec3 normal = vertex0.normal * lambda.x + vertex1.normal * lambda.y + vertex2.normal * lambda.z;
+    normal = normalize(mat3(draw.model) * normal);
+
+    VisibilityMaterial material = materials[materialIndex];
+    float diffuse = max(dot(normal, -lightDirection.xyz), 0.0);
+    vec3 color = material.baseColor.rgb * (lightDirection.w + diffuse);
+
+    imageStore(shadedImage, pixel, vec4(color, material.baseColor.a));
+}
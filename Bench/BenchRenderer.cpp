@@ -0,0 +1,621 @@
+#include "BenchRenderer.h"
+
+#include "GPU/GPUContext.h"
+#include "GPU/UploadStreamer.h"
+#include "Graphics/DepthBuffer.h"
+#include "Graphics/VertexQuantization.h"
+
+#include <glm/geometric.hpp>
+
+#include <algorithm>
+#include <assert.h>
+#include <cstdio>
+#include <limits>
+
+namespace cof
+{
+	void BenchMetrics::Add(std::string_view name, double value)
+	{
+		auto metric{ std::find_if(metrics.begin(), metrics.end(), [name](const MetricSamples& samples) { return samples.name == name; }) };
+		if (metric == metrics.end())
+		{
+			metrics.push_back({ std::string{ name }, {} });
+			metric = metrics.end() - 1;
+		}
+
+		metric->samples.push_back(value);
+	}
+
+	const std::vector<BenchRendererInfo>& BenchRenderers()
+	{
+		static const std::vector<BenchRendererInfo> renderers
+		{
+			{ "forward", CreateForwardRenderer },
+			{ "hiz", CreateOcclusionRenderer },
+			{ "meshlet", CreateMeshletRenderer },
+			{ "lod", CreateLodRenderer },
+			{ "quantized", CreateQuantizedRenderer },
+			{ "vbuffer", CreateVisibilityRenderer },
+			{ "clustered", CreateClusteredRenderer },
+			{ "bruteforce", CreateBruteForceRenderer },
+			{ "deferred", CreateDeferredRenderer },
+			{ "deferred-naive", CreateNaiveDeferredRenderer },
+			{ "textures", CreateTexturedRenderer },
+			{ "virtualtextures", CreateVirtualTextureRenderer },
+			{ "streaming", CreateStreamingRenderer }
+		};
+		return renderers;
+	}
+
+	VkBuffer CreateBenchBuffer(VmaAllocator allocator, VkDeviceSize size, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage, VmaAllocation& allocation, VmaAllocationInfo* allocationInfo)
+	{
+		VkBufferCreateInfo bufferInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+			.size = size,
+			.usage = usage,
+			.sharingMode = VK_SHARING_MODE_EXCLUSIVE
+		};
+
+		VmaAllocationCreateInfo allocInfo
+		{
+			.flags = memoryUsage == VMA_MEMORY_USAGE_GPU_ONLY ? VmaAllocationCreateFlags{ 0 } : VmaAllocationCreateFlags{ VMA_ALLOCATION_CREATE_MAPPED_BIT },
+			.usage = memoryUsage
+		};
+
+		VkBuffer buffer;
+		[[maybe_unused]] VkResult errorCode = vmaCreateBuffer(allocator, &bufferInfo, &allocInfo, &buffer, &allocation, allocationInfo);
+		assert(errorCode == VK_SUCCESS);
+		return buffer;
+	}
+
+	Shader LoadBenchShader(const BenchContext& context, const char* name)
+	{
+		return LoadShader(context.assets / "Shaders" / name, context.gpuContext.LogicalDevice());
+	}
+
+	VkPipelineShaderStageCreateInfo ShaderStage(VkShaderStageFlagBits stage, const Shader& shader, const VkSpecializationInfo* specialization) noexcept
+	{
+		return VkPipelineShaderStageCreateInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+			.stage = stage,
+			.module = shader.Handle(),
+			.pName = "main",
+			.pSpecializationInfo = specialization
+		};
+	}
+
+	VkPipeline CreateBenchPipeline(const VkDevice device, VkExtent2D extent, const BenchPipelineInfo& info)
+	{
+		VkPipelineInputAssemblyStateCreateInfo inputAssembly
+		{
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
+			.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+			.primitiveRestartEnable = VK_FALSE
+		};
+
+		VkViewport viewport
+		{
+			.x = 0.0f,
+			.y = 0.0f,
+			.width = static_cast<float>(extent.width),
+			.height = static_cast<float>(extent.height),
+			.minDepth = 0.0f,
+			.maxDepth = 1.0f
+		};
+
+		VkRect2D scissor{ .offset = { 0, 0 }, .extent = extent };
+
+		VkPipelineViewportStateCreateInfo viewportState
+		{
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
+			.viewportCount = 1,
+			.pViewports = &viewport,
+			.scissorCount = 1,
+			.pScissors = &scissor
+		};
+
+		//The projection flips y, so glTF's counter clockwise front faces stay counter clockwise on screen
+		VkPipelineRasterizationStateCreateInfo rasterizer
+		{
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
+			.depthClampEnable = VK_FALSE,
+			.rasterizerDiscardEnable = VK_FALSE,
+			.polygonMode = VK_POLYGON_MODE_FILL,
+			.cullMode = VK_CULL_MODE_BACK_BIT,
+			.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE,
+			.depthBiasEnable = VK_FALSE,
+			.lineWidth = 1.0f
+		};
+
+		VkPipelineMultisampleStateCreateInfo multisampling
+		{
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
+			.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT
+		};
+
+		const std::vector<VkPipelineColorBlendAttachmentState> colorBlendAttachments(info.colorAttachmentCount, VkPipelineColorBlendAttachmentState
+		{
+			.blendEnable = VK_FALSE,
+			.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT
+		});
+
+		VkPipelineColorBlendStateCreateInfo colorBlending
+		{
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
+			.logicOpEnable = VK_FALSE,
+			.attachmentCount = info.colorAttachmentCount,
+			.pAttachments = colorBlendAttachments.data()
+		};
+
+		VkPipelineDepthStencilStateCreateInfo depthStencil
+		{
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
+			.depthTestEnable = VK_TRUE,
+			.depthWriteEnable = info.depthWrite,
+			.depthCompareOp = info.depthCompareOp
+		};
+
+		VkGraphicsPipelineCreateInfo pipelineInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+			.stageCount = static_cast<uint32_t>(info.stages.size()),
+			.pStages = info.stages.data(),
+			.pVertexInputState = &info.vertexInput,
+			.pInputAssemblyState = &inputAssembly,
+			.pViewportState = &viewportState,
+			.pRasterizationState = &rasterizer,
+			.pMultisampleState = &multisampling,
+			.pDepthStencilState = &depthStencil,
+			.pColorBlendState = &colorBlending,
+			.layout = info.layout,
+			.renderPass = info.renderPass,
+			.subpass = info.subpass
+		};
+
+		VkPipeline pipeline;
+		[[maybe_unused]] VkResult errorCode = vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline);
+		assert(errorCode == VK_SUCCESS);
+		return pipeline;
+	}
+
+	VkPipelineLayout CreateBenchPipelineLayout(const VkDevice device, const std::vector<VkDescriptorSetLayout>& setLayouts, VkShaderStageFlags pushConstantStages, uint32_t pushConstantSize)
+	{
+		VkPushConstantRange pushConstantRange
+		{
+			.stageFlags = pushConstantStages,
+			.offset = 0,
+			.size = pushConstantSize
+		};
+
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+			.setLayoutCount = static_cast<uint32_t>(setLayouts.size()),
+			.pSetLayouts = setLayouts.data(),
+			.pushConstantRangeCount = pushConstantSize == 0 ? 0u : 1u,
+			.pPushConstantRanges = &pushConstantRange
+		};
+
+		VkPipelineLayout pipelineLayout;
+		[[maybe_unused]] VkResult errorCode = vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout);
+		assert(errorCode == VK_SUCCESS);
+		return pipelineLayout;
+	}
+
+	VkFramebuffer CreateFramebuffer(const VkDevice device, VkRenderPass renderPass, VkExtent2D extent, const std::vector<VkImageView>& attachments)
+	{
+		VkFramebufferCreateInfo framebufferInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
+			.renderPass = renderPass,
+			.attachmentCount = static_cast<uint32_t>(attachments.size()),
+			.pAttachments = attachments.data(),
+			.width = extent.width,
+			.height = extent.height,
+			.layers = 1
+		};
+
+		VkFramebuffer framebuffer;
+		[[maybe_unused]] VkResult errorCode = vkCreateFramebuffer(device, &framebufferInfo, nullptr, &framebuffer);
+		assert(errorCode == VK_SUCCESS);
+		return framebuffer;
+	}
+
+	RenderPass CreateForwardRenderPass(const VkDevice device, VkFormat targetFormat, VkImageLayout targetLayout, VkAttachmentLoadOp depthLoadOp)
+	{
+		VkAttachmentDescription colorAttachment
+		{
+			.format = targetFormat,
+			.samples = VK_SAMPLE_COUNT_1_BIT,
+			.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+			.storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+			.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+			.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+			.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+			.finalLayout = targetLayout
+		};
+
+		VkAttachmentDescription depthAttachment
+		{
+			.format = DepthBuffer::format,
+			.samples = VK_SAMPLE_COUNT_1_BIT,
+			.loadOp = depthLoadOp,
+			.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+			.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+			.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+			.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+			.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL
+		};
+
+		VkAttachmentReference colorAttachmentRef{ .attachment = 0, .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+		VkAttachmentReference depthAttachmentRef{ .attachment = 1, .layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
+		VkAttachmentReference readOnlyDepthAttachmentRef{ .attachment = 1, .layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL };
+
+		VkSubpassDescription prepassSubpass
+		{
+			.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
+			.colorAttachmentCount = 0,
+			.pDepthStencilAttachment = &depthAttachmentRef
+		};
+
+		VkSubpassDescription colorSubpass
+		{
+			.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
+			.colorAttachmentCount = 1,
+			.pColorAttachments = &colorAttachmentRef,
+			.pDepthStencilAttachment = &readOnlyDepthAttachmentRef
+		};
+
+		VkSubpassDependency prepassDependency
+		{
+			.srcSubpass = 0,
+			.dstSubpass = 1,
+			.srcStageMask = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+			.dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+			.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+			.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT,
+			.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT
+		};
+
+		return RenderPass{ device, { colorAttachment, depthAttachment }, { prepassSubpass, colorSubpass }, { prepassDependency } };
+	}
+
+	BenchFrustumDraws::BenchFrustumDraws(const BenchContext& benchContext)
+		: context{ benchContext }
+		, cullShader{ LoadBenchShader(benchContext, "FrustumCull.comp.spv") }
+		, cullingPass{ benchContext.gpuContext.LogicalDevice(), cullShader }
+	{
+		const uint32_t instanceCount{ context.geometry.instanceCount };
+
+		drawCommandBuffer = CreateBenchBuffer(context.allocator, sizeof(VkDrawIndexedIndirectCommand) * instanceCount,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_GPU_ONLY, drawCommandAllocation);
+		drawCountBuffer = CreateBenchBuffer(context.allocator, sizeof(uint32_t),
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_ONLY, drawCountAllocation);
+		readbackBuffer = CreateBenchBuffer(context.allocator, readbackCommandOffset + sizeof(VkDrawIndexedIndirectCommand) * instanceCount,
+			VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_TO_CPU, readbackAllocation, &readbackInfo);
+
+		cullingPass.BindBuffers(context.geometry.instanceBuffer, drawCommandBuffer, drawCountBuffer);
+	}
+
+	BenchFrustumDraws::~BenchFrustumDraws()
+	{
+		vmaDestroyBuffer(context.allocator, readbackBuffer, readbackAllocation);
+		vmaDestroyBuffer(context.allocator, drawCountBuffer, drawCountAllocation);
+		vmaDestroyBuffer(context.allocator, drawCommandBuffer, drawCommandAllocation);
+	}
+
+	void BenchFrustumDraws::AddCullingPasses(RenderGraph& graph)
+	{
+		const uint32_t instanceCount{ context.geometry.instanceCount };
+
+		//Every frame waits for the previous one, so the draw buffers don't carry a dependency into the next
+		drawCommands = graph.ImportBuffer("DrawCommands", drawCommandBuffer, { .stages = 0, .access = 0, .layout = VK_IMAGE_LAYOUT_UNDEFINED });
+		drawCount = graph.ImportBuffer("DrawCount", drawCountBuffer, { .stages = 0, .access = 0, .layout = VK_IMAGE_LAYOUT_UNDEFINED });
+
+		graph.AddPass(
+		{
+			.name = "ResetDrawCount",
+			.accesses = { { drawCount, ResourceUsage::TransferWrite } },
+			.execute = [this](VkCommandBuffer commandBuffer) { cullingPass.RecordReset(commandBuffer); }
+		});
+
+		graph.AddPass(
+		{
+			.name = "FrustumCulling",
+			.accesses = { { drawCommands, ResourceUsage::ComputeWrite }, { drawCount, ResourceUsage::ComputeReadWrite } },
+			.execute = [this, instanceCount](VkCommandBuffer commandBuffer) { cullingPass.RecordCulling(commandBuffer, frustum, instanceCount); }
+		});
+	}
+
+	void BenchFrustumDraws::AddReadbackPass(RenderGraph& graph)
+	{
+		const uint32_t instanceCount{ context.geometry.instanceCount };
+
+		//Draw and triangle counts after culling, read once the frame's fence signaled
+		graph.AddPass(
+		{
+			.name = "DrawReadback",
+			.accesses = { { drawCommands, ResourceUsage::TransferRead }, { drawCount, ResourceUsage::TransferRead } },
+			.execute = [this, instanceCount](VkCommandBuffer commandBuffer)
+			{
+				const VkBufferCopy countCopy{ .srcOffset = 0, .dstOffset = 0, .size = sizeof(uint32_t) };
+				const VkBufferCopy commandCopy{ .srcOffset = 0, .dstOffset = readbackCommandOffset, .size = sizeof(VkDrawIndexedIndirectCommand) * instanceCount };
+				vkCmdCopyBuffer(commandBuffer, drawCountBuffer, readbackBuffer, 1, &countCopy);
+				vkCmdCopyBuffer(commandBuffer, drawCommandBuffer, readbackBuffer, 1, &commandCopy);
+
+				VkMemoryBarrier hostBarrier
+				{
+					.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+					.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+					.dstAccessMask = VK_ACCESS_HOST_READ_BIT
+				};
+				vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &hostBarrier, 0, nullptr, 0, nullptr);
+			},
+			.sideEffects = true
+		});
+	}
+
+	void BenchFrustumDraws::RecordDraw(VkCommandBuffer commandBuffer) const
+	{
+		cullingPass.RecordDraw(commandBuffer, context.geometry.instanceCount);
+	}
+
+	void BenchFrustumDraws::Collect(BenchMetrics& metrics) const
+	{
+		vmaInvalidateAllocation(context.allocator, readbackAllocation, 0, VK_WHOLE_SIZE);
+		const std::byte* readback{ static_cast<const std::byte*>(readbackInfo.pMappedData) };
+
+		uint32_t culledDrawCount;
+		std::memcpy(&culledDrawCount, readback, sizeof(culledDrawCount));
+		culledDrawCount = std::min(culledDrawCount, context.geometry.instanceCount);
+
+		metrics.Add("draws", static_cast<double>(culledDrawCount));
+		metrics.Add("triangles", static_cast<double>(CountIndirectTriangles(readback + readbackCommandOffset, culledDrawCount)));
+	}
+
+	uint32_t FindBenchMaterial(std::vector<glm::vec4>& materialColors, std::vector<uint32_t>& materialImages, const glm::vec4& baseColor, uint32_t image)
+	{
+		uint32_t closest{ 0 };
+		float closestDistance{ std::numeric_limits<float>::max() };
+		for (uint32_t material{}; material < materialColors.size(); ++material)
+		{
+			const glm::vec4 difference{ materialColors[material] - baseColor };
+			//Any color distance is below this, so a different image only wins when no material has the same one
+			const float distance{ glm::dot(difference, difference) + (materialImages[material] != image ? 1e6f : 0.0f) };
+			if (distance < closestDistance)
+			{
+				closest = material;
+				closestDistance = distance;
+			}
+		}
+
+		if (closestDistance > 0.0f && materialColors.size() < VisibilityBuffer::maxMaterialCount)
+		{
+			materialColors.push_back(baseColor);
+			materialImages.push_back(image);
+			return static_cast<uint32_t>(materialColors.size() - 1);
+		}
+		return closest;
+	}
+
+	const glm::vec3 BenchVisibilityDraws::lightDirection{ -glm::normalize(glm::vec3{ 0.267f, 0.890f, 0.178f }) };
+
+	BenchVisibilityDraws::BenchVisibilityDraws(const BenchContext& benchContext)
+		: context{ benchContext }
+		, geometryBuffer{ benchContext.gpuContext, sizeof(uint32_t) * benchContext.scene.indices.size() + sizeof(QuantizedLitVertex) * benchContext.scene.vertices.size() + 16 }
+	{
+		const GltfScene& scene{ context.scene };
+		const std::vector<glm::vec3> normals{ SceneNormals(scene) };
+
+		std::vector<LitTexturedVertex> litVertices(scene.vertices.size());
+		for (size_t vertex{}; vertex < litVertices.size(); ++vertex)
+		{
+			litVertices[vertex] = LitTexturedVertex
+			{
+				.position = scene.vertices[vertex].position,
+				.normal = normals[vertex],
+				//Not read by any of the shaders, any unit vector quantizes
+				.tangent = glm::vec4{ 1.0f, 0.0f, 0.0f, 1.0f },
+				.texCoord = scene.texCoords[vertex]
+			};
+		}
+
+		QuantizationTransform transform{};
+		QuantizationError error{};
+		const std::vector<QuantizedLitVertex> vertices{ QuantizeVertices(litVertices, transform, error) };
+
+		//The draws are recorded with the index buffer bound at offset 0, so the indices go first
+		std::vector<uint32_t> indices(scene.indices.size());
+		const VkDeviceSize indexOffset{ geometryBuffer.Allocate(sizeof(uint32_t) * indices.size()) };
+		const VkDeviceSize vertexOffset{ geometryBuffer.Allocate(sizeof(QuantizedLitVertex) * vertices.size()) };
+		assert(indexOffset == 0);
+
+		//Every instance gets a draw of its own unless there are more than a visibility pixel can address
+		const size_t instanceCount{ scene.drawInstances.size() };
+		const size_t instancesPerGroup{ (instanceCount + VisibilityBuffer::maxDrawCount - 1) / VisibilityBuffer::maxDrawCount };
+		for (size_t firstInstance{}; firstInstance < instanceCount; firstInstance += instancesPerGroup)
+		{
+			const size_t lastInstance{ std::min(firstInstance + instancesPerGroup, instanceCount) };
+			const DrawInstance& first{ scene.drawInstances[firstInstance] };
+
+			glm::vec3 boundsMin{ std::numeric_limits<float>::max() };
+			glm::vec3 boundsMax{ std::numeric_limits<float>::lowest() };
+			uint32_t indexCount{ 0 };
+			for (size_t instance{ firstInstance }; instance < lastInstance; ++instance)
+			{
+				//Indices become relative to the group's first vertex
+				const DrawInstance& drawInstance{ scene.drawInstances[instance] };
+				const uint32_t rebase{ static_cast<uint32_t>(drawInstance.vertexOffset - first.vertexOffset) };
+				for (uint32_t index{ drawInstance.firstIndex }; index < drawInstance.firstIndex + drawInstance.indexCount; ++index)
+				{
+					indices[index] = scene.indices[index] + rebase;
+				}
+
+				const glm::vec3 center{ drawInstance.boundingSphere };
+				boundsMin = glm::min(boundsMin, center - drawInstance.boundingSphere.w);
+				boundsMax = glm::max(boundsMax, center + drawInstance.boundingSphere.w);
+				indexCount += drawInstance.indexCount;
+			}
+			assert(indexCount / 3 <= (1u << VisibilityBuffer::triangleIdBits));
+
+			const glm::vec3 center{ (boundsMin + boundsMax) * 0.5f };
+			float radius{ 0.0f };
+			for (size_t instance{ firstInstance }; instance < lastInstance; ++instance)
+			{
+				const glm::vec4& sphere{ scene.drawInstances[instance].boundingSphere };
+				radius = std::max(radius, glm::length(glm::vec3{ sphere } - center) + sphere.w);
+			}
+
+			groups.push_back(Group
+			{
+				.boundingSphere = glm::vec4{ center, radius },
+				.draw =
+				{
+					.model = glm::mat4{ 1.0f },
+					.dequantizeOffset = glm::vec4{ transform.offset, 0.0f },
+					.dequantizeScale = glm::vec4{ transform.scale, 0.0f },
+					.vertices = geometryBuffer.DeviceAddress(vertexOffset + sizeof(QuantizedLitVertex) * static_cast<uint32_t>(first.vertexOffset)),
+					.indices = geometryBuffer.DeviceAddress(indexOffset + sizeof(uint32_t) * first.firstIndex),
+					.indexCount = indexCount,
+					.firstIndex = first.firstIndex,
+					.materialIndex = FindBenchMaterial(materialColors, materialImages, scene.baseColors[firstInstance], scene.baseColorImages[firstInstance]),
+					.padding = 0
+				}
+			});
+		}
+
+		printf("  Visibility draws: %zu draws for %zu instances, %zu materials, %.2f MiB of quantized lit vertices\n",
+			groups.size(), instanceCount, materialColors.size(), static_cast<double>(sizeof(QuantizedLitVertex) * vertices.size()) / (1024.0 * 1024.0));
+
+		drawBuffer = CreateBenchBuffer(context.allocator, sizeof(VisibilityDraw) * groups.size(),
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, drawAllocation, &drawInfo);
+
+		context.uploadStreamer.Enqueue(BufferUpload{ geometryBuffer.Handle(), indexOffset, AsBytes(indices), VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_SHADER_READ_BIT }, UploadPriority::Visible);
+		context.uploadStreamer.Enqueue(BufferUpload{ geometryBuffer.Handle(), vertexOffset, AsBytes(vertices), VK_ACCESS_SHADER_READ_BIT }, UploadPriority::Visible);
+		visibleDraws.reserve(groups.size());
+	}
+
+	BenchVisibilityDraws::~BenchVisibilityDraws()
+	{
+		vmaDestroyBuffer(context.allocator, drawBuffer, drawAllocation);
+	}
+
+	void BenchVisibilityDraws::Prepare(const glm::mat4& viewProjection)
+	{
+		const Frustum frustum{ ExtractFrustum(viewProjection) };
+		visibleDraws.clear();
+		frameTriangles = 0;
+		for (const Group& group : groups)
+		{
+			const glm::vec3 center{ group.boundingSphere };
+			const float radius{ group.boundingSphere.w };
+			const bool visible{ std::all_of(frustum.planes.begin(), frustum.planes.end(),
+				[&](const glm::vec4& plane) { return glm::dot(glm::vec3{ plane }, center) + plane.w >= -radius; }) };
+			if (visible)
+			{
+				visibleDraws.push_back(group.draw);
+				frameTriangles += group.draw.indexCount / 3;
+			}
+		}
+
+		//The previous frame has finished, so its draws can be overwritten
+		std::memcpy(drawInfo.pMappedData, visibleDraws.data(), sizeof(VisibilityDraw) * visibleDraws.size());
+		vmaFlushAllocation(context.allocator, drawAllocation, 0, VK_WHOLE_SIZE);
+	}
+
+	void BenchVisibilityDraws::Collect(BenchMetrics& metrics) const
+	{
+		metrics.Add("draws", static_cast<double>(visibleDraws.size()));
+		metrics.Add("triangles", static_cast<double>(frameTriangles));
+	}
+
+	glm::mat4 ClockwiseViewProjection(const BenchView& view) noexcept
+	{
+		//Undoes the flip of BenchView::projection, which turned the clockwise winding counter clockwise
+		glm::mat4 viewProjection{ view.viewProjection };
+		for (int column{}; column < 4; ++column)
+		{
+			viewProjection[column][1] = -viewProjection[column][1];
+		}
+		return viewProjection;
+	}
+
+	void RecordBlitToTarget(VkCommandBuffer commandBuffer, VkImage source, VkImage target, VkExtent2D extent)
+	{
+		const int32_t width{ static_cast<int32_t>(extent.width) };
+		const int32_t height{ static_cast<int32_t>(extent.height) };
+		const VkImageBlit blit
+		{
+			.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 },
+			.srcOffsets = { { 0, 0, 0 }, { width, height, 1 } },
+			.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 },
+			.dstOffsets = { { 0, height, 0 }, { width, 0, 1 } }
+		};
+		vkCmdBlitImage(commandBuffer, source, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, target, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_NEAREST);
+	}
+
+	uint64_t CountIndirectTriangles(const std::byte* commands, uint32_t drawCount) noexcept
+	{
+		uint64_t triangleCount{ 0 };
+		for (uint32_t draw{}; draw < drawCount; ++draw)
+		{
+			VkDrawIndexedIndirectCommand command;
+			std::memcpy(&command, commands + sizeof(command) * draw, sizeof(command));
+			triangleCount += command.indexCount / 3;
+		}
+		return triangleCount;
+	}
+
+	std::vector<uint32_t> AbsoluteSceneIndices(const GltfScene& scene)
+	{
+		std::vector<uint32_t> indices(scene.indices.size());
+		for (const DrawInstance& instance : scene.drawInstances)
+		{
+			for (uint32_t index{ instance.firstIndex }; index < instance.firstIndex + instance.indexCount; ++index)
+			{
+				indices[index] = scene.indices[index] + static_cast<uint32_t>(instance.vertexOffset);
+			}
+		}
+		return indices;
+	}
+
+	std::vector<glm::vec3> ScenePositions(const GltfScene& scene)
+	{
+		std::vector<glm::vec3> positions(scene.vertices.size());
+		std::transform(scene.vertices.begin(), scene.vertices.end(), positions.begin(), [](const UnlitColoredVertex& vertex) { return vertex.position; });
+		return positions;
+	}
+
+	std::vector<glm::vec3> SceneNormals(const GltfScene& scene)
+	{
+		std::vector<glm::vec3> normals(scene.vertices.size(), glm::vec3{ 0.0f });
+		for (const DrawInstance& instance : scene.drawInstances)
+		{
+			for (uint32_t index{ instance.firstIndex }; index + 3 <= instance.firstIndex + instance.indexCount; index += 3)
+			{
+				const uint32_t corners[3]
+				{
+					scene.indices[index] + static_cast<uint32_t>(instance.vertexOffset),
+					scene.indices[index + 1] + static_cast<uint32_t>(instance.vertexOffset),
+					scene.indices[index + 2] + static_cast<uint32_t>(instance.vertexOffset)
+				};
+				//The cross product's length is twice the triangle's area
+				const glm::vec3 faceNormal{ glm::cross(scene.vertices[corners[1]].position - scene.vertices[corners[0]].position,
+					scene.vertices[corners[2]].position - scene.vertices[corners[0]].position) };
+				for (uint32_t corner : corners)
+				{
+					normals[corner] += faceNormal;
+				}
+			}
+		}
+
+		for (glm::vec3& normal : normals)
+		{
+			const float normalLength{ glm::length(normal) };
+			normal = normalLength > 0.0f ? normal / normalLength : glm::vec3{ 0.0f, 1.0f, 0.0f };
+		}
+		return normals;
+	}
+}
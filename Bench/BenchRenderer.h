@@ -0,0 +1,307 @@
+#pragma once
+#include "BenchReport.h"
+
+#include "GPU/GeometryBuffer.h"
+#include "GPU/Shader.h"
+#include "GPU/vk_mem_alloc.h"
+#include "Graphics/FrustumCulling.h"
+#include "Graphics/GltfScene.h"
+#include "Graphics/RenderGraph.h"
+#include "Graphics/RenderPass.h"
+#include "Graphics/VertexLayout.h"
+#include "Graphics/VisibilityBuffer.h"
+
+#include <vulkan/vulkan_core.h>
+#include <glm/ext/matrix_float4x4.hpp>
+#include <glm/ext/vector_float3.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+namespace cof
+{
+	struct GPUContext;
+	class UploadStreamer;
+
+	//Scene geometry RunScene uploads once for every renderer, laid out like GltfScene
+	struct BenchGeometry
+	{
+		//GltfScene::indices, relative to the vertexOffset of their instance
+		VkBuffer indexBuffer;
+		//Positions of GltfScene::vertices as a stream of their own, for depth only passes
+		VkBuffer positionBuffer;
+		//GltfScene::drawInstances
+		VkBuffer instanceBuffer;
+		//GltfScene::vertices, pulled through their device address
+		VkDeviceAddress vertexAddress;
+		uint32_t instanceCount;
+	};
+
+	//What a renderer is created with, all of it outlives the renderer
+	struct BenchContext
+	{
+		const GPUContext& gpuContext;
+		VmaAllocator allocator;
+		//Renderers enqueue their own uploads while they're created, RunScene flushes them before the first frame
+		UploadStreamer& uploadStreamer;
+		std::filesystem::path assets;
+		//The .gltf the scene was loaded from, for renderers that read more of it
+		std::filesystem::path scenePath;
+		const GltfScene& scene;
+		const BenchGeometry& geometry;
+		VkExtent2D extent;
+		VkFormat targetFormat;
+		//Layout the frame has to leave the target in
+		VkImageLayout targetLayout;
+		//Point lights the lit renderers spread over the scene
+		uint32_t lightCount;
+	};
+
+	//Every renderer draws with the same near plane, culling and LOD selection need it
+	constexpr float benchZNear{ 0.05f };
+
+	struct BenchView
+	{
+		glm::mat4 view;
+		//InfiniteReversedPerspective with y flipped, so glTF's counter clockwise front faces stay counter clockwise on screen
+		glm::mat4 projection;
+		glm::mat4 viewProjection;
+		glm::vec3 cameraPosition;
+	};
+
+	//Matches DrawConstants in PulledTriangle.vert.glsl, DepthPrepass.vert.glsl only reads the matrix
+	struct DrawConstants
+	{
+		glm::mat4 viewProjection;
+		VkDeviceAddress vertexBuffer;
+	};
+
+	//Per frame samples of the metrics a renderer adds to the CPU frame time and GPU scopes RunScene measures.
+	//Like those they are lower is better, e.g. draws and triangles
+	class BenchMetrics
+	{
+	public:
+		void Add(std::string_view name, double value);
+		std::vector<MetricSamples>& Samples() noexcept { return metrics; }
+
+	private:
+		std::vector<MetricSamples> metrics;
+	};
+
+	//One way of rendering a scene. RunScene drives every renderer along the same camera path through the same frame loop,
+	//so their results compare directly: AddPasses and Compiled once, then Prepare and Collect around every frame
+	class BenchRenderer
+	{
+	public:
+		virtual ~BenchRenderer() = default;
+
+		//Adds the passes that render a frame into target, which has to end up in BenchContext::targetLayout
+		virtual void AddPasses(RenderGraph& graph, RenderResource target) = 0;
+		//The graph's transient images exist from here on, e.g. for framebuffers. targetViews are color views of the target images
+		virtual void Compiled(const RenderGraph& graph, const std::vector<VkImageView>& targetViews) = 0;
+		//Before the frame rendering into the target image imageIndex is recorded
+		virtual void Prepare(const BenchView& view, uint32_t imageIndex) = 0;
+		//Once the frame's fence signaled, measured frames only
+		virtual void Collect(BenchMetrics& metrics) = 0;
+		//After the last frame, prints what the renderer measured beyond its metrics
+		virtual void Report() const {}
+	};
+
+	//GPU frustum culling of the scene's instances into indirect draws, read back after every frame for the draw and triangle
+	//metrics. Shared by the renderers that draw the scene's instances as they are
+	class BenchFrustumDraws
+	{
+	public:
+		explicit BenchFrustumDraws(const BenchContext& benchContext);
+		~BenchFrustumDraws();
+
+		BenchFrustumDraws(const BenchFrustumDraws& other) = delete;
+		BenchFrustumDraws& operator=(const BenchFrustumDraws& other) = delete;
+		BenchFrustumDraws(BenchFrustumDraws&& other) = delete;
+		BenchFrustumDraws& operator=(BenchFrustumDraws&& other) = delete;
+
+		//Adds ResetDrawCount and FrustumCulling, passes drawing the result read both resources as IndirectRead
+		void AddCullingPasses(RenderGraph& graph);
+		//Adds DrawReadback, after the last pass that draws
+		void AddReadbackPass(RenderGraph& graph);
+
+		RenderResource DrawCommands() const noexcept { return drawCommands; }
+		RenderResource DrawCount() const noexcept { return drawCount; }
+
+		void Prepare(const glm::mat4& viewProjection) noexcept { frustum = ExtractFrustum(viewProjection); }
+		void RecordDraw(VkCommandBuffer commandBuffer) const;
+		//Adds the draws and triangles of the last frame
+		void Collect(BenchMetrics& metrics) const;
+
+	private:
+		//The culled draws of the frame, the count first and the commands behind it
+		constexpr static VkDeviceSize readbackCommandOffset{ sizeof(VkDrawIndexedIndirectCommand) };
+
+		const BenchContext& context;
+		Shader cullShader;
+		FrustumCullingPass cullingPass;
+
+		VkBuffer drawCommandBuffer;
+		VmaAllocation drawCommandAllocation;
+		VkBuffer drawCountBuffer;
+		VmaAllocation drawCountAllocation;
+		VkBuffer readbackBuffer;
+		VmaAllocation readbackAllocation;
+		VmaAllocationInfo readbackInfo;
+
+		RenderResource drawCommands{};
+		RenderResource drawCount{};
+		Frustum frustum{};
+	};
+
+	//The scene as VisibilityDraws for the visibility buffer, deferred, textured and virtual textured renderers: quantized lit vertices with SceneNormals,
+	//a draw per instance or per run of instances when there are more than VisibilityBuffer::maxDrawCount. Draws are culled
+	//against the frustum on the CPU and written to a host visible draw buffer every frame
+	class BenchVisibilityDraws
+	{
+	public:
+		explicit BenchVisibilityDraws(const BenchContext& benchContext);
+		~BenchVisibilityDraws();
+
+		BenchVisibilityDraws(const BenchVisibilityDraws& other) = delete;
+		BenchVisibilityDraws& operator=(const BenchVisibilityDraws& other) = delete;
+		BenchVisibilityDraws(BenchVisibilityDraws&& other) = delete;
+		BenchVisibilityDraws& operator=(BenchVisibilityDraws&& other) = delete;
+
+		void Prepare(const glm::mat4& viewProjection);
+		//Adds the draws and triangles of the last frame
+		void Collect(BenchMetrics& metrics) const;
+
+		//The visible draws, in the order of DrawBuffer()
+		const std::vector<VisibilityDraw>& Draws() const noexcept { return visibleDraws; }
+		VkBuffer DrawBuffer() const noexcept { return drawBuffer; }
+		//The draws' indices start at offset 0
+		VkBuffer IndexBuffer() const noexcept { return geometryBuffer.Handle(); }
+		//Base colors the draws' materialIndex refers to, at most VisibilityBuffer::maxMaterialCount
+		const std::vector<glm::vec4>& MaterialColors() const noexcept { return materialColors; }
+		//GltfScene::images index of every material's base color texture, or GltfScene::noImage
+		const std::vector<uint32_t>& MaterialImages() const noexcept { return materialImages; }
+
+		//The light GltfScene bakes into the vertex colors, as the direction it travels in
+		static const glm::vec3 lightDirection;
+		constexpr static float ambient{ 0.25f };
+
+	private:
+		struct Group
+		{
+			glm::vec4 boundingSphere;
+			VisibilityDraw draw;
+		};
+
+		const BenchContext& context;
+		GeometryBuffer geometryBuffer;
+		std::vector<Group> groups;
+		std::vector<glm::vec4> materialColors;
+		std::vector<uint32_t> materialImages;
+		std::vector<VisibilityDraw> visibleDraws;
+
+		VkBuffer drawBuffer;
+		VmaAllocation drawAllocation;
+		VmaAllocationInfo drawInfo;
+		uint64_t frameTriangles{ 0 };
+	};
+
+	struct BenchRendererInfo
+	{
+		const char* name;
+		std::unique_ptr<BenchRenderer>(*create)(const BenchContext& context);
+	};
+
+	//Every renderer NomadBench knows, forward first since the others are compared against it
+	const std::vector<BenchRendererInfo>& BenchRenderers();
+
+	//GPU frustum culling, a depth prepass and a color pass testing against it for equality, like the application
+	std::unique_ptr<BenchRenderer> CreateForwardRenderer(const BenchContext& context);
+	//Two phase Hi-Z occlusion culling in front of the same passes
+	std::unique_ptr<BenchRenderer> CreateOcclusionRenderer(const BenchContext& context);
+	//Frustum and normal cone culling per meshlet, the surviving triangles drawn by a single indirect draw
+	std::unique_ptr<BenchRenderer> CreateMeshletRenderer(const BenchContext& context);
+	//CPU frustum culling and a LOD per instance picked by its projected simplification error
+	std::unique_ptr<BenchRenderer> CreateLodRenderer(const BenchContext& context);
+	//The forward passes over 16 bit quantized positions and 8 bit colors instead of full precision vertices
+	std::unique_ptr<BenchRenderer> CreateQuantizedRenderer(const BenchContext& context);
+	//Quantized lit vertices rasterized into a VisibilityBuffer, resolved per material and blitted to the target
+	std::unique_ptr<BenchRenderer> CreateVisibilityRenderer(const BenchContext& context);
+	//Forward shading of BenchContext::lightCount point lights binned into clusters, and the same passes looping over every light
+	std::unique_ptr<BenchRenderer> CreateClusteredRenderer(const BenchContext& context);
+	std::unique_ptr<BenchRenderer> CreateBruteForceRenderer(const BenchContext& context);
+	//The visibility buffer's draws shaded through a DeferredGBuffer, with the packed and the naive attachment layout
+	std::unique_ptr<BenchRenderer> CreateDeferredRenderer(const BenchContext& context);
+	std::unique_ptr<BenchRenderer> CreateNaiveDeferredRenderer(const BenchContext& context);
+	//The visibility draws forward shaded with the scene's base color textures, streamed by TextureStreamer from GPU feedback
+	std::unique_ptr<BenchRenderer> CreateTexturedRenderer(const BenchContext& context);
+	//The same passes sampling the textures through a VirtualTextureCache, its pages requested by GPU feedback
+	std::unique_ptr<BenchRenderer> CreateVirtualTextureRenderer(const BenchContext& context);
+	//Every instance cooked into cluster pages and drawn from what GeometryStreamer has resident through a VisibilityBuffer
+	std::unique_ptr<BenchRenderer> CreateStreamingRenderer(const BenchContext& context);
+
+	VkBuffer CreateBenchBuffer(VmaAllocator allocator, VkDeviceSize size, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage, VmaAllocation& allocation, VmaAllocationInfo* allocationInfo = nullptr);
+
+	template<typename T>
+	std::vector<std::byte> AsBytes(const std::vector<T>& elements)
+	{
+		std::vector<std::byte> bytes(sizeof(T) * elements.size());
+		std::memcpy(bytes.data(), elements.data(), bytes.size());
+		return bytes;
+	}
+
+	//name is a compiled shader in the assets' Shaders directory, e.g. FrustumCull.comp.spv
+	Shader LoadBenchShader(const BenchContext& context, const char* name);
+
+	VkPipelineShaderStageCreateInfo ShaderStage(VkShaderStageFlagBits stage, const Shader& shader, const VkSpecializationInfo* specialization = nullptr) noexcept;
+
+	//What sets bench graphics pipelines apart. The rest is shared: triangle lists over the whole extent, back faces culled,
+	//no blending and depth testing against the reversed-Z DepthBuffer
+	struct BenchPipelineInfo
+	{
+		std::vector<VkPipelineShaderStageCreateInfo> stages;
+		VkPipelineVertexInputStateCreateInfo vertexInput{ pulledVertexInputState };
+		VkPipelineLayout layout;
+		VkRenderPass renderPass;
+		uint32_t subpass;
+		uint32_t colorAttachmentCount;
+		VkBool32 depthWrite;
+		VkCompareOp depthCompareOp;
+	};
+
+	VkPipeline CreateBenchPipeline(const VkDevice device, VkExtent2D extent, const BenchPipelineInfo& info);
+
+	//pushConstantSize bytes of push constants visible to pushConstantStages, none when it's zero
+	VkPipelineLayout CreateBenchPipelineLayout(const VkDevice device, const std::vector<VkDescriptorSetLayout>& setLayouts, VkShaderStageFlags pushConstantStages, uint32_t pushConstantSize);
+
+	//The library's passes cull clockwise back faces like the application, whose projection keeps Vulkan's y pointing down.
+	//Renderers built on them pass this instead of BenchView::viewProjection and blit the result to the target upside down
+	glm::mat4 ClockwiseViewProjection(const BenchView& view) noexcept;
+
+	//Copies a color image of extent in VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL into the target in VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+	//flipped vertically to undo ClockwiseViewProjection
+	void RecordBlitToTarget(VkCommandBuffer commandBuffer, VkImage source, VkImage target, VkExtent2D extent);
+
+	VkFramebuffer CreateFramebuffer(const VkDevice device, VkRenderPass renderPass, VkExtent2D extent, const std::vector<VkImageView>& attachments);
+
+	//Depth prepass and a color pass testing against it for equality. depthLoadOp loads depth an earlier pass rendered
+	//instead of clearing it, the color attachment ends up in targetLayout
+	RenderPass CreateForwardRenderPass(const VkDevice device, VkFormat targetFormat, VkImageLayout targetLayout, VkAttachmentLoadOp depthLoadOp);
+
+	//Triangles of the first drawCount indirect draws in commands, which points at readback memory
+	uint64_t CountIndirectTriangles(const std::byte* commands, uint32_t drawCount) noexcept;
+
+	//GltfScene::indices with the vertexOffset of their instance added, for processing the whole scene as one mesh
+	std::vector<uint32_t> AbsoluteSceneIndices(const GltfScene& scene);
+	std::vector<glm::vec3> ScenePositions(const GltfScene& scene);
+	//Smooth normals weighted by triangle area, GltfScene only keeps the lit vertex colors
+	std::vector<glm::vec3> SceneNormals(const GltfScene& scene);
+	//Index of the material with baseColor and image, added to materialColors and materialImages if there's none. Past
+	//VisibilityBuffer::maxMaterialCount materials the closest color is shared, preferring materials with the same image
+	uint32_t FindBenchMaterial(std::vector<glm::vec4>& materialColors, std::vector<uint32_t>& materialImages, const glm::vec4& baseColor, uint32_t image);
+}
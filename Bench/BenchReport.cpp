@@ -0,0 +1,252 @@
+#include "BenchReport.h"
+
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <numeric>
+
+namespace cof
+{
+	using Json = nlohmann::ordered_json;
+
+	//Differences below this are noise no matter the relative change, e.g. a 0.003 ms scope doubling
+	constexpr double noiseFloor{ 0.01 };
+	constexpr int resultsVersion{ 1 };
+
+	MetricSummary Summarize(std::vector<double>& samples)
+	{
+		if (samples.empty())
+		{
+			return {};
+		}
+
+		std::sort(samples.begin(), samples.end());
+		auto percentile = [&samples](double fraction)
+		{
+			const size_t rank{ static_cast<size_t>(std::ceil(fraction * static_cast<double>(samples.size()))) };
+			return samples[std::clamp<size_t>(rank, 1, samples.size()) - 1];
+		};
+
+		return MetricSummary
+		{
+			.mean = std::accumulate(samples.begin(), samples.end(), 0.0) / static_cast<double>(samples.size()),
+			.min = samples.front(),
+			.p50 = percentile(0.50),
+			.p95 = percentile(0.95),
+			.p99 = percentile(0.99),
+			.max = samples.back()
+		};
+	}
+
+	static Json SummaryJson(const MetricSummary& summary)
+	{
+		return Json
+		{
+			{ "mean", summary.mean }, { "min", summary.min }, { "p50", summary.p50 }, { "p95", summary.p95 }, { "p99", summary.p99 }, { "max", summary.max }
+		};
+	}
+
+	bool WriteBenchResults(const char* path, BenchRun& run)
+	{
+		//Parentheses, braces would make it the only element of an array
+		Json scenes(Json::array());
+		for (SceneBenchResult& scene : run.scenes)
+		{
+			Json metrics(Json::object());
+			for (MetricSamples& metric : scene.metrics)
+			{
+				metrics[metric.name] = SummaryJson(Summarize(metric.samples));
+			}
+
+			scenes.push_back(Json
+			{
+				{ "name", scene.scene },
+				{ "frames", scene.frameCount },
+				{ "loadMs", scene.loadMilliseconds },
+				{ "instances", scene.instanceCount },
+				{ "sceneTriangles", scene.sceneTriangleCount },
+				{ "memory", { { "deviceBytes", scene.deviceMemoryBytes }, { "usedBytes", scene.usedMemoryBytes } } },
+				{ "metrics", std::move(metrics) }
+			});
+		}
+
+		const Json results
+		{
+			{ "version", resultsVersion },
+			{ "device", run.device },
+			{ "extent", { run.width, run.height } },
+			{ "warmupFrames", run.warmupFrameCount },
+			{ "scenes", std::move(scenes) }
+		};
+
+		std::ofstream file{ path, std::ios::binary };
+		file << results.dump(1, '\t') << '\n';
+		return static_cast<bool>(file);
+	}
+
+	std::optional<Json> LoadBenchResults(const char* path)
+	{
+		std::ifstream file{ path, std::ios::binary };
+		if (!file)
+		{
+			return std::nullopt;
+		}
+
+		Json results(Json::parse(file, nullptr, false));
+		if (results.is_discarded())
+		{
+			return std::nullopt;
+		}
+		return results;
+	}
+
+	void PrintBenchRun(BenchRun& run)
+	{
+		printf("%s, %ux%u, %u warmup frames\n", run.device.c_str(), run.width, run.height, run.warmupFrameCount);
+		for (SceneBenchResult& scene : run.scenes)
+		{
+			printf("\n%s: %u frames, %u instances, %llu triangles, loaded in %.1f ms, %.1f MiB device memory (%.1f MiB used)\n",
+				scene.scene.c_str(), scene.frameCount, scene.instanceCount, static_cast<unsigned long long>(scene.sceneTriangleCount),
+				scene.loadMilliseconds, static_cast<double>(scene.deviceMemoryBytes) / (1024.0 * 1024.0), static_cast<double>(scene.usedMemoryBytes) / (1024.0 * 1024.0));
+			printf("  %-32s %10s %10s %10s %10s %10s\n", "Metric", "Mean", "P50", "P95", "P99", "Max");
+
+			for (MetricSamples& metric : scene.metrics)
+			{
+				const MetricSummary summary{ Summarize(metric.samples) };
+				printf("  %-32s %10.3f %10.3f %10.3f %10.3f %10.3f\n", metric.name.c_str(), summary.mean, summary.p50, summary.p95, summary.p99, summary.max);
+			}
+		}
+	}
+
+	//Lookups of results that may come from an older or hand edited file, missing members and members of the wrong type
+	//read as null, zero or empty
+	static const Json& Member(const Json& object, const char* key)
+	{
+		static const Json missing{};
+		if (!object.is_object())
+		{
+			return missing;
+		}
+
+		const auto member{ object.find(key) };
+		return member != object.end() ? *member : missing;
+	}
+
+	static const Json& Elements(const Json& object, const char* key)
+	{
+		static const Json empty(Json::array());
+		const Json& member{ Member(object, key) };
+		return member.is_array() ? member : empty;
+	}
+
+	static const Json& Members(const Json& object, const char* key)
+	{
+		static const Json empty(Json::object());
+		const Json& member{ Member(object, key) };
+		return member.is_object() ? member : empty;
+	}
+
+	static double Number(const Json& value)
+	{
+		return value.is_number() ? value.get<double>() : 0.0;
+	}
+
+	static std::string String(const Json& value)
+	{
+		return value.is_string() ? value.get<std::string>() : std::string{};
+	}
+
+	static double Extent(const Json& results, size_t axis)
+	{
+		const Json& extent{ Member(results, "extent") };
+		return extent.is_array() && axis < extent.size() ? Number(extent[axis]) : 0.0;
+	}
+
+	//Prints one comparison and whether it regressed
+	static bool CompareValue(const char* scene, const std::string& metric, const char* statistic, double current, double baseline, double threshold)
+	{
+		const double change{ baseline != 0.0 ? (current - baseline) / baseline : (current != 0.0 ? 1.0 : 0.0) };
+		const bool regressed{ change > threshold && current - baseline > noiseFloor };
+		const bool improved{ change < -threshold && baseline - current > noiseFloor };
+
+		printf("  %-12s %-32s %-4s %12.4f -> %12.4f %+8.1f%%%s\n", scene, metric.c_str(), statistic, baseline, current, change * 100.0,
+			regressed ? "  REGRESSION" : improved ? "  improved" : "");
+		return regressed;
+	}
+
+	uint32_t CompareBenchResults(const Json& current, const Json& baseline, double threshold)
+	{
+		if (Number(Member(current, "version")) != Number(Member(baseline, "version")))
+		{
+			printf("Results versions differ, %g against a baseline of %g\n", Number(Member(current, "version")), Number(Member(baseline, "version")));
+		}
+		if (String(Member(current, "device")) != String(Member(baseline, "device")))
+		{
+			printf("Comparing %s against a baseline from %s\n", String(Member(current, "device")).c_str(), String(Member(baseline, "device")).c_str());
+		}
+		if (Extent(current, 0) != Extent(baseline, 0) || Extent(current, 1) != Extent(baseline, 1))
+		{
+			printf("Extents differ, %gx%g against a baseline of %gx%g\n", Extent(current, 0), Extent(current, 1), Extent(baseline, 0), Extent(baseline, 1));
+		}
+
+		printf("Regressions are more than %.1f%% above the baseline\n", threshold * 100.0);
+
+		uint32_t regressionCount{ 0 };
+		for (const Json& baselineScene : Elements(baseline, "scenes"))
+		{
+			const std::string sceneName{ String(Member(baselineScene, "name")) };
+			const Json* currentScene{ nullptr };
+			for (const Json& scene : Elements(current, "scenes"))
+			{
+				if (String(Member(scene, "name")) == sceneName)
+				{
+					currentScene = &scene;
+				}
+			}
+
+			if (currentScene == nullptr)
+			{
+				printf("  %-12s missing\n", sceneName.c_str());
+				++regressionCount;
+				continue;
+			}
+
+			const Json& currentMetrics{ Members(*currentScene, "metrics") };
+			for (const auto& [metricName, baselineMetric] : Members(baselineScene, "metrics").items())
+			{
+				const Json& currentMetric{ Member(currentMetrics, metricName.c_str()) };
+				if (currentMetric.is_null())
+				{
+					printf("  %-12s %-32s missing\n", sceneName.c_str(), metricName.c_str());
+					++regressionCount;
+					continue;
+				}
+
+				for (const char* statistic : { "p50", "p95", "p99" })
+				{
+					regressionCount += CompareValue(sceneName.c_str(), metricName, statistic, Number(Member(currentMetric, statistic)),
+						Number(Member(baselineMetric, statistic)), threshold) ? 1 : 0;
+				}
+			}
+
+			for (const char* memory : { "deviceBytes", "usedBytes" })
+			{
+				regressionCount += CompareValue(sceneName.c_str(), "memory", memory, Number(Member(Member(*currentScene, "memory"), memory)),
+					Number(Member(Member(baselineScene, "memory"), memory)), threshold) ? 1 : 0;
+			}
+		}
+
+		if (regressionCount == 0)
+		{
+			fputs("No regressions\n", stdout);
+		}
+		else
+		{
+			printf("%u regressions\n", regressionCount);
+		}
+		return regressionCount;
+	}
+}
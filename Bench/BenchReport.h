@@ -0,0 +1,65 @@
+#pragma once
+#include <nlohmann/json_fwd.hpp>
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace cof
+{
+	//Distribution of a per frame metric over the measured frames
+	struct MetricSummary
+	{
+		double mean;
+		double min;
+		double p50;
+		double p95;
+		double p99;
+		double max;
+	};
+
+	//Nearest rank percentiles, sorts samples in place. All zero without samples
+	MetricSummary Summarize(std::vector<double>& samples);
+
+	//Per frame samples of one metric, e.g. a GPU scope. Names are the keys in the results file
+	struct MetricSamples
+	{
+		std::string name;
+		std::vector<double> samples;
+	};
+
+	struct SceneBenchResult
+	{
+		std::string scene;
+		uint32_t frameCount;
+		double loadMilliseconds;
+		uint32_t instanceCount;
+		uint64_t sceneTriangleCount;
+		//CPU frame time, GPU scopes, draws and triangles after culling, all lower is better
+		std::vector<MetricSamples> metrics;
+		//Device memory allocated for the scene and how much of it allocations use, sampled after the last frame
+		uint64_t deviceMemoryBytes;
+		uint64_t usedMemoryBytes;
+	};
+
+	struct BenchRun
+	{
+		std::string device;
+		uint32_t width;
+		uint32_t height;
+		uint32_t warmupFrameCount;
+		std::vector<SceneBenchResult> scenes;
+	};
+
+	//Writes the summaries of every metric, not the samples themselves
+	bool WriteBenchResults(const char* path, BenchRun& run);
+	//Nullopt if the file can't be read or isn't JSON. Ordered, so comparisons list metrics in the order they were written
+	std::optional<nlohmann::ordered_json> LoadBenchResults(const char* path);
+	void PrintBenchRun(BenchRun& run);
+
+	//Prints the p50, p95 and p99 of every metric in baseline and the memory next to current. A value more than threshold,
+	//relative, above its baseline is a regression, as long as it also grew by more than noise. Returns the regression count,
+	//scenes or metrics current doesn't have count as regressions too
+	uint32_t CompareBenchResults(const nlohmann::ordered_json& current, const nlohmann::ordered_json& baseline, double threshold);
+}
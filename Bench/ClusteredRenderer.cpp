@@ -0,0 +1,341 @@
+#include "BenchRenderer.h"
+
+#include "GPU/GPUContext.h"
+#include "GPU/UploadStreamer.h"
+#include "Graphics/ClusteredLighting.h"
+#include "Graphics/DepthBuffer.h"
+#include "Graphics/OcclusionCulling.h"
+
+#include <glm/geometric.hpp>
+
+#include <algorithm>
+#include <array>
+#include <assert.h>
+#include <cmath>
+#include <cstdio>
+#include <random>
+
+namespace cof
+{
+	//Second vertex stream of ClusteredForward.vert.glsl, positions come from BenchGeometry::positionBuffer
+	struct ShadingAttributes
+	{
+		glm::vec3 normal;
+		glm::vec3 albedo;
+	};
+
+	constexpr static std::array shadingBindings
+	{
+		VkVertexInputBindingDescription{ .binding = 0, .stride = sizeof(glm::vec3), .inputRate = VK_VERTEX_INPUT_RATE_VERTEX },
+		VkVertexInputBindingDescription{ .binding = 1, .stride = sizeof(ShadingAttributes), .inputRate = VK_VERTEX_INPUT_RATE_VERTEX }
+	};
+
+	constexpr static std::array shadingAttributes
+	{
+		VkVertexInputAttributeDescription{ .location = 0, .binding = 0, .format = VK_FORMAT_R32G32B32_SFLOAT, .offset = 0 },
+		VkVertexInputAttributeDescription{ .location = 1, .binding = 1, .format = VK_FORMAT_R32G32B32_SFLOAT, .offset = offsetof(ShadingAttributes, normal) },
+		VkVertexInputAttributeDescription{ .location = 2, .binding = 1, .format = VK_FORMAT_R32G32B32_SFLOAT, .offset = offsetof(ShadingAttributes, albedo) }
+	};
+
+	//Point lights spread uniformly over the scene bounds, the same for every run. Ranges shrink as lights are added so
+	//the light volumes cover about the same space at any count, the intensity follows so a light looks the same at its range
+	static std::vector<Light> SceneLights(const GltfScene& scene, uint32_t lightCount)
+	{
+		std::mt19937 random{ 1 };
+		std::uniform_real_distribution<float> unit{ 0.0f, 1.0f };
+
+		const glm::vec3 extent{ scene.boundsMax - scene.boundsMin };
+		const float range{ 0.5f * glm::length(extent) / std::cbrt(static_cast<float>(std::max(lightCount, 1u))) };
+
+		std::vector<Light> lights(lightCount);
+		for (Light& light : lights)
+		{
+			light = Light
+			{
+				.position = scene.boundsMin + extent * glm::vec3{ unit(random), unit(random), unit(random) },
+				.range = range,
+				.color = glm::vec3{ 0.2f + 0.8f * unit(random), 0.2f + 0.8f * unit(random), 0.2f + 0.8f * unit(random) } * (0.25f * range * range),
+				.spotCosOuter = -1.0f,
+				.direction = glm::vec3{ 0.0f, -1.0f, 0.0f },
+				.spotCosInner = -1.0f
+			};
+		}
+		return lights;
+	}
+
+	class ClusteredRenderer : public BenchRenderer
+	{
+	public:
+		ClusteredRenderer(const BenchContext& benchContext, bool clusteredShading)
+			: context{ benchContext }
+			, device{ benchContext.gpuContext.LogicalDevice() }
+			, clustered{ clusteredShading }
+			, frustumDraws{ benchContext }
+			, lightCullShader{ LoadBenchShader(benchContext, "ClusterLightCull.comp.spv") }
+			, vertexShader{ LoadBenchShader(benchContext, "ClusteredForward.vert.spv") }
+			, fragmentShader{ LoadBenchShader(benchContext, "ClusteredForward.frag.spv") }
+			, prepassShader{ LoadBenchShader(benchContext, "DepthPrepass.vert.spv") }
+			, lightCullingPass{ device, benchContext.allocator,
+				MakeClusterGrid(benchContext.extent, benchZNear, std::max(glm::length(benchContext.scene.boundsMax - benchContext.scene.boundsMin), 2.0f * benchZNear)), lightCullShader }
+			, forwardPass{ CreateForwardRenderPass(device, benchContext.targetFormat, benchContext.targetLayout, VK_ATTACHMENT_LOAD_OP_CLEAR) }
+			, lights{ SceneLights(benchContext.scene, benchContext.lightCount) }
+		{
+			const GltfScene& scene{ context.scene };
+
+			//Albedo is the instance's base color, the vertex colors have GltfScene's light baked in
+			const std::vector<glm::vec3> normals{ SceneNormals(scene) };
+			std::vector<ShadingAttributes> attributes(scene.vertices.size());
+			for (size_t instance{}; instance < scene.drawInstances.size(); ++instance)
+			{
+				const DrawInstance& drawInstance{ scene.drawInstances[instance] };
+				const size_t lastVertex{ instance + 1 < scene.drawInstances.size() ? static_cast<size_t>(scene.drawInstances[instance + 1].vertexOffset) : scene.vertices.size() };
+				for (size_t vertex{ static_cast<size_t>(drawInstance.vertexOffset) }; vertex < lastVertex; ++vertex)
+				{
+					attributes[vertex] = ShadingAttributes{ normals[vertex], glm::vec3{ scene.baseColors[instance] } };
+				}
+			}
+
+			attributeBuffer = CreateBenchBuffer(context.allocator, sizeof(ShadingAttributes) * attributes.size(),
+				VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_ONLY, attributeAllocation);
+			//An empty storage buffer can't be bound, so there's always room for one light
+			lightBuffer = CreateBenchBuffer(context.allocator, sizeof(Light) * std::max<size_t>(lights.size(), 1),
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_ONLY, lightAllocation);
+
+			context.uploadStreamer.Enqueue(BufferUpload{ attributeBuffer, 0, AsBytes(attributes), VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT }, UploadPriority::Visible);
+			if (!lights.empty())
+			{
+				context.uploadStreamer.Enqueue(BufferUpload{ lightBuffer, 0, AsBytes(lights), VK_ACCESS_SHADER_READ_BIT }, UploadPriority::Visible);
+			}
+			lightCullingPass.BindLights(lightBuffer, static_cast<uint32_t>(lights.size()));
+
+			pipelineLayout = CreateBenchPipelineLayout(device, { lightCullingPass.DescriptorSetLayout() }, VK_SHADER_STAGE_VERTEX_BIT, sizeof(glm::mat4));
+
+			prepassPipeline = CreateBenchPipeline(device, context.extent,
+			{
+				.stages = { ShaderStage(VK_SHADER_STAGE_VERTEX_BIT, prepassShader) },
+				.vertexInput = VertexLayout<UnlitColoredVertex, VertexStreams::Deinterleaved, 1>::InputState(),
+				.layout = pipelineLayout,
+				.renderPass = forwardPass.Handle(),
+				.subpass = 0,
+				.colorAttachmentCount = 0,
+				.depthWrite = VK_TRUE,
+				.depthCompareOp = DepthBuffer::compareOp
+			});
+
+			const VkBool32 clusteredConstant{ clustered ? VK_TRUE : VK_FALSE };
+			const VkSpecializationMapEntry specializationEntry
+			{
+				.constantID = ClusteredLightCullingPass::clusteredConstantId,
+				.offset = 0,
+				.size = sizeof(VkBool32)
+			};
+
+			const VkSpecializationInfo specializationInfo
+			{
+				.mapEntryCount = 1,
+				.pMapEntries = &specializationEntry,
+				.dataSize = sizeof(VkBool32),
+				.pData = &clusteredConstant
+			};
+
+			colorPipeline = CreateBenchPipeline(device, context.extent,
+			{
+				.stages = { ShaderStage(VK_SHADER_STAGE_VERTEX_BIT, vertexShader), ShaderStage(VK_SHADER_STAGE_FRAGMENT_BIT, fragmentShader, &specializationInfo) },
+				.vertexInput =
+				{
+					.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+					.vertexBindingDescriptionCount = static_cast<uint32_t>(shadingBindings.size()),
+					.pVertexBindingDescriptions = shadingBindings.data(),
+					.vertexAttributeDescriptionCount = static_cast<uint32_t>(shadingAttributes.size()),
+					.pVertexAttributeDescriptions = shadingAttributes.data()
+				},
+				.layout = pipelineLayout,
+				.renderPass = forwardPass.Handle(),
+				.subpass = 1,
+				.colorAttachmentCount = 1,
+				.depthWrite = VK_FALSE,
+				.depthCompareOp = VK_COMPARE_OP_EQUAL
+			});
+		}
+
+		~ClusteredRenderer() override
+		{
+			for (VkFramebuffer framebuffer : framebuffers)
+			{
+				vkDestroyFramebuffer(device, framebuffer, nullptr);
+			}
+			vkDestroyPipeline(device, colorPipeline, nullptr);
+			vkDestroyPipeline(device, prepassPipeline, nullptr);
+			vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+
+			vmaDestroyBuffer(context.allocator, lightBuffer, lightAllocation);
+			vmaDestroyBuffer(context.allocator, attributeBuffer, attributeAllocation);
+		}
+
+		ClusteredRenderer(const ClusteredRenderer& other) = delete;
+		ClusteredRenderer& operator=(const ClusteredRenderer& other) = delete;
+		ClusteredRenderer(ClusteredRenderer&& other) = delete;
+		ClusteredRenderer& operator=(ClusteredRenderer&& other) = delete;
+
+		void AddPasses(RenderGraph& graph, RenderResource target) override
+		{
+			depthImage = graph.CreateImage("Depth", { DepthBuffer::format, context.extent, VK_IMAGE_ASPECT_DEPTH_BIT });
+
+			//Synchronizes the cluster lists with the fragment shaders itself. Without accesses the pass lands in the first
+			//level, ahead of Forward. Brute force only needs the grid uniform Record writes, which doesn't change between frames
+			graph.AddPass(
+			{
+				.name = "LightCulling",
+				.execute = [this](VkCommandBuffer commandBuffer)
+				{
+					if (clustered || !gridRecorded)
+					{
+						lightCullingPass.Record(commandBuffer, cullingView);
+						gridRecorded = true;
+					}
+				},
+				.sideEffects = true
+			});
+
+			frustumDraws.AddCullingPasses(graph);
+
+			graph.AddPass(
+			{
+				.name = "Forward",
+				.accesses =
+				{
+					{ frustumDraws.DrawCommands(), ResourceUsage::IndirectRead },
+					{ frustumDraws.DrawCount(), ResourceUsage::IndirectRead },
+					{ target, ResourceUsage::ColorWrite, context.targetLayout },
+					{ depthImage, ResourceUsage::DepthWrite }
+				},
+				.execute = [this](VkCommandBuffer commandBuffer)
+				{
+					VkClearValue clearValues[2]{};
+					clearValues[0].color = { 0.0f, 0.0f, 0.0f, 1.0f };
+					clearValues[1].depthStencil = { DepthBuffer::clearDepth, 0 };
+
+					VkRenderPassBeginInfo renderPassInfo
+					{
+						.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+						.renderPass = forwardPass.Handle(),
+						.framebuffer = framebuffers[imageIndex],
+						.renderArea = { .offset = { 0, 0 }, .extent = context.extent },
+						.clearValueCount = static_cast<uint32_t>(std::size(clearValues)),
+						.pClearValues = clearValues
+					};
+
+					const VkBuffer vertexBuffers[2]{ context.geometry.positionBuffer, attributeBuffer };
+					const VkDeviceSize vertexOffsets[2]{ 0, 0 };
+					const VkDescriptorSet lightingSet{ lightCullingPass.DescriptorSet() };
+
+					vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+					vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::mat4), &viewProjection);
+					vkCmdBindIndexBuffer(commandBuffer, context.geometry.indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+					vkCmdBindVertexBuffers(commandBuffer, 0, 2, vertexBuffers, vertexOffsets);
+
+					vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, prepassPipeline);
+					frustumDraws.RecordDraw(commandBuffer);
+
+					vkCmdNextSubpass(commandBuffer, VK_SUBPASS_CONTENTS_INLINE);
+					vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, colorPipeline);
+					vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &lightingSet, 0, nullptr);
+					frustumDraws.RecordDraw(commandBuffer);
+
+					vkCmdEndRenderPass(commandBuffer);
+				}
+			});
+
+			frustumDraws.AddReadbackPass(graph);
+		}
+
+		void Compiled(const RenderGraph& graph, const std::vector<VkImageView>& targetViews) override
+		{
+			for (VkImageView targetView : targetViews)
+			{
+				framebuffers.push_back(CreateFramebuffer(device, forwardPass.Handle(), context.extent, { targetView, graph.View(depthImage) }));
+			}
+		}
+
+		void Prepare(const BenchView& view, uint32_t targetImage) override
+		{
+			viewProjection = view.viewProjection;
+			cullingView = CullingView{ .view = view.view, .projection = view.projection, .zNear = benchZNear, .zFar = 0.0f };
+			frustumDraws.Prepare(view.viewProjection);
+			imageIndex = targetImage;
+		}
+
+		void Collect(BenchMetrics& metrics) override
+		{
+			frustumDraws.Collect(metrics);
+
+			//Brute force shading never reads the cluster lists
+			if (clustered)
+			{
+				const LightCullingCounters counters{ lightCullingPass.Counters() };
+				metrics.Add("overflowedClusters", static_cast<double>(counters.overflowedClusterCount));
+				metrics.Add("droppedLights", static_cast<double>(counters.droppedLightCount));
+				metrics.Add("unlitClusters", static_cast<double>(counters.unlitClusterCount));
+
+				maxDroppedLights = std::max(maxDroppedLights, counters.droppedLightCount);
+				maxUnlitClusters = std::max(maxUnlitClusters, counters.unlitClusterCount);
+			}
+		}
+
+		//What a fragment loops over at the last frame's view, binned on the CPU like ClusterLightCull.comp.glsl does
+		void Report() const override
+		{
+			printf("  %s lighting, ", clustered ? "Clustered" : "Brute force");
+			BinLightsReference(lights, lightCullingPass.Grid(), cullingView).Print();
+
+			if (maxDroppedLights > 0 || maxUnlitClusters > 0)
+			{
+				printf("  Warning: the GPU binning dropped up to %u lights past %u per cluster and left up to %u clusters unlit in a frame, shading is missing lights\n",
+					maxDroppedLights, ClusteredLightCullingPass::maxLightsPerCluster, maxUnlitClusters);
+			}
+		}
+
+	private:
+		const BenchContext& context;
+		const VkDevice device;
+		const bool clustered;
+
+		BenchFrustumDraws frustumDraws;
+		Shader lightCullShader;
+		Shader vertexShader;
+		Shader fragmentShader;
+		Shader prepassShader;
+		ClusteredLightCullingPass lightCullingPass;
+		RenderPass forwardPass;
+
+		std::vector<Light> lights;
+		VkBuffer attributeBuffer;
+		VmaAllocation attributeAllocation;
+		VkBuffer lightBuffer;
+		VmaAllocation lightAllocation;
+
+		VkPipelineLayout pipelineLayout;
+		VkPipeline prepassPipeline;
+		VkPipeline colorPipeline;
+		std::vector<VkFramebuffer> framebuffers;
+
+		RenderResource depthImage{};
+		glm::mat4 viewProjection{ 1.0f };
+		CullingView cullingView{};
+		uint32_t imageIndex{ 0 };
+		bool gridRecorded{ false };
+
+		uint32_t maxDroppedLights{ 0 };
+		uint32_t maxUnlitClusters{ 0 };
+	};
+
+	std::unique_ptr<BenchRenderer> CreateClusteredRenderer(const BenchContext& context)
+	{
+		return std::make_unique<ClusteredRenderer>(context, true);
+	}
+
+	std::unique_ptr<BenchRenderer> CreateBruteForceRenderer(const BenchContext& context)
+	{
+		return std::make_unique<ClusteredRenderer>(context, false);
+	}
+}
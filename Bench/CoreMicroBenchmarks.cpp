@@ -0,0 +1,142 @@
+#include "MicroBench.h"
+
+#include "GPU/GPUContext.h"
+#include "GPU/Shader.h"
+#include "Utils/CpuProfiler.h"
+#include "Utils/Utils.h"
+#include "Utils/VulkanUtils.h"
+
+#include <vulkan/vulkan_core.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+//CPU side building blocks of device creation and asset loading, and the cost of profiling them. Inputs are seeded by
+//the thread index, so every run of a size processes the same data
+
+//Size is the number of devices whose features are turned into masks, like RequestPhysicalDevice does for every device
+static void FeaturesBitMask(cof::MicroBenchState& state)
+{
+	std::mt19937_64 random{ state.ThreadIndex() };
+	std::vector<VkPhysicalDeviceFeatures> deviceFeatures(state.Size());
+	for (VkPhysicalDeviceFeatures& features : deviceFeatures)
+	{
+		auto featuresArray = cof::ArrayCast<VkBool32>(features);
+		for (VkBool32& feature : featuresArray)
+		{
+			feature = static_cast<VkBool32>(random() & 1);
+		}
+		features = cof::ReverseArrayCast<VkPhysicalDeviceFeatures>(featuresArray);
+	}
+
+	state.SetItemsPerIteration(state.Size());
+	while (state.KeepRunning())
+	{
+		for (const VkPhysicalDeviceFeatures& features : deviceFeatures)
+		{
+			cof::DoNotOptimize(cof::FeaturesBitMask(features));
+		}
+	}
+}
+MICRO_BENCH(FeaturesBitMask).Sizes({ 1, 16, 256 }).Threads({ 1, 2, 4, 8 });
+
+//Size is the number of masks turned back into the features a device is created with
+static void FeaturesFromBitMask(cof::MicroBenchState& state)
+{
+	std::mt19937_64 random{ state.ThreadIndex() };
+	std::vector<uint64_t> masks(state.Size());
+	for (uint64_t& mask : masks)
+	{
+		mask = random();
+	}
+
+	state.SetItemsPerIteration(state.Size());
+	while (state.KeepRunning())
+	{
+		for (uint64_t mask : masks)
+		{
+			cof::DoNotOptimize(cof::FeaturesFromBitMask(mask));
+		}
+	}
+}
+MICRO_BENCH(FeaturesFromBitMask).Sizes({ 1, 16, 256 }).Threads({ 1, 2, 4, 8 });
+
+//Size is the number of extensions the device reports, drivers report around a hundred to two hundred. Looks up the
+//first and last one and one that isn't there, a lookup is a linear search
+static void IsExtensionSupported(cof::MicroBenchState& state)
+{
+	std::vector<VkExtensionProperties> availableExtensions(std::max<size_t>(state.Size(), 1));
+	for (size_t extension{}; extension < availableExtensions.size(); ++extension)
+	{
+		snprintf(availableExtensions[extension].extensionName, sizeof(availableExtensions[extension].extensionName), "VK_EXT_synthetic_extension_%zu", extension);
+		availableExtensions[extension].specVersion = 1;
+	}
+
+	const std::string desiredExtensions[]
+	{
+		availableExtensions.front().extensionName,
+		availableExtensions.back().extensionName,
+		"VK_KHR_unavailable_extension"
+	};
+
+	state.SetItemsPerIteration(std::size(desiredExtensions));
+	while (state.KeepRunning())
+	{
+		for (const std::string& desiredExtension : desiredExtensions)
+		{
+			cof::DoNotOptimize(IsExtensionSupported(availableExtensions, desiredExtension));
+		}
+	}
+}
+MICRO_BENCH(IsExtensionSupported).Sizes({ 8, 64, 256 }).Threads({ 1, 4 });
+
+//Size is the shader file's size in bytes. Reads a file the OS has cached, so this is the open, allocation and copy
+//LoadShader does before it creates the module, not the disk
+static void ReadShaderFile(cof::MicroBenchState& state)
+{
+	const std::filesystem::path path{ std::filesystem::temp_directory_path() /
+		("NomadMicroBench" + std::to_string(state.ThreadIndex()) + "_" + std::to_string(state.Size()) + ".spv") };
+	{
+		std::ofstream file{ path, std::ios::binary };
+		const std::vector<char> contents(state.Size(), '\x07');
+		file.write(contents.data(), static_cast<std::streamsize>(contents.size()));
+	}
+
+	state.SetItemsPerIteration(state.Size());
+	while (state.KeepRunning())
+	{
+		const std::vector<std::byte> buffer{ cof::ReadShaderFile(path) };
+		cof::DoNotOptimize(buffer.data());
+	}
+
+	std::error_code error;
+	std::filesystem::remove(path, error);
+}
+MICRO_BENCH(ReadShaderFile).Sizes({ 4 * 1024, 64 * 1024, 1024 * 1024 }).Threads({ 1, 2, 4 });
+
+//Size is the number of zones recorded per iteration, so the time per item is what a CPU_ZONE costs, which should stay
+//under 50 ns. Uses CpuZone, what CPU_ZONE expands to, so the cost is measured without NOMAD_CPU_PROFILER too. Each
+//thread records into its own ring, more threads shouldn't slow a zone down
+static void CpuZone(cof::MicroBenchState& state)
+{
+	//The first zone of a thread allocates its ring, that isn't part of a zone's cost
+	{
+		const cof::CpuZone zone{ "MicroBench warm up" };
+	}
+
+	state.SetItemsPerIteration(state.Size());
+	while (state.KeepRunning())
+	{
+		for (size_t zoneIndex{}; zoneIndex < state.Size(); ++zoneIndex)
+		{
+			const cof::CpuZone zone{ "MicroBench zone" };
+			cof::DoNotOptimize(zoneIndex);
+		}
+	}
+}
+MICRO_BENCH(CpuZone).Sizes({ 1, 64, 1024 }).Threads({ 1, 2, 4, 8 });
@@ -0,0 +1,120 @@
+#include "BenchRenderer.h"
+
+#include "GPU/GPUContext.h"
+#include "GPU/UploadStreamer.h"
+#include "Graphics/DeferredGBuffer.h"
+
+#include <cstdio>
+
+namespace cof
+{
+	class DeferredRenderer : public BenchRenderer
+	{
+	public:
+		DeferredRenderer(const BenchContext& benchContext, GBufferLayout gbufferLayout)
+			: context{ benchContext }
+			, device{ benchContext.gpuContext.LogicalDevice() }
+			, visibilityDraws{ benchContext }
+			, geometryVertexShader{ LoadBenchShader(benchContext, "GBuffer.vert.spv") }
+			, geometryFragmentShader{ LoadBenchShader(benchContext, "GBuffer.frag.spv") }
+			, lightingVertexShader{ LoadBenchShader(benchContext, "FullscreenTriangle.vert.spv") }
+			, lightingFragmentShader{ LoadBenchShader(benchContext, "DeferredLighting.frag.spv") }
+			, gbuffer{ device, benchContext.allocator, benchContext.extent, { geometryVertexShader, geometryFragmentShader, lightingVertexShader, lightingFragmentShader }, gbufferLayout }
+		{
+			//The scene only has base colors, every material gets the same rough dielectric surface
+			std::vector<GBufferMaterial> materials;
+			for (const glm::vec4& baseColor : visibilityDraws.MaterialColors())
+			{
+				materials.push_back(GBufferMaterial{ .baseColor = baseColor, .roughness = 0.8f, .metalness = 0.0f, .padding = { 0.0f, 0.0f } });
+			}
+
+			materialBuffer = CreateBenchBuffer(context.allocator, sizeof(GBufferMaterial) * materials.size(),
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_ONLY, materialAllocation);
+			context.uploadStreamer.Enqueue(BufferUpload{ materialBuffer, 0, AsBytes(materials), VK_ACCESS_SHADER_READ_BIT }, UploadPriority::Visible);
+
+			gbuffer.BindScene(visibilityDraws.DrawBuffer(), materialBuffer);
+		}
+
+		~DeferredRenderer() override
+		{
+			vmaDestroyBuffer(context.allocator, materialBuffer, materialAllocation);
+		}
+
+		DeferredRenderer(const DeferredRenderer& other) = delete;
+		DeferredRenderer& operator=(const DeferredRenderer& other) = delete;
+		DeferredRenderer(DeferredRenderer&& other) = delete;
+		DeferredRenderer& operator=(DeferredRenderer&& other) = delete;
+
+		void AddPasses(RenderGraph& graph, RenderResource target) override
+		{
+			//The G-buffer is one render pass with its own attachments, like the visibility buffer only the blit goes through the graph
+			graph.AddPass(
+			{
+				.name = "Deferred",
+				.accesses = { { target, ResourceUsage::TransferWrite } },
+				.execute = [this, &graph, target](VkCommandBuffer commandBuffer)
+				{
+					gbuffer.Record(commandBuffer, visibilityDraws.IndexBuffer(), visibilityDraws.Draws(), viewProjection, cameraPosition,
+						BenchVisibilityDraws::lightDirection, BenchVisibilityDraws::ambient);
+					RecordBlitToTarget(commandBuffer, gbuffer.LitImage(), graph.Image(target), context.extent);
+				}
+			});
+		}
+
+		void Compiled(const RenderGraph&, const std::vector<VkImageView>&) override {}
+
+		void Prepare(const BenchView& view, uint32_t) override
+		{
+			viewProjection = ClockwiseViewProjection(view);
+			cameraPosition = view.cameraPosition;
+			visibilityDraws.Prepare(view.viewProjection);
+		}
+
+		void Collect(BenchMetrics& metrics) override
+		{
+			visibilityDraws.Collect(metrics);
+		}
+
+		void Report() const override
+		{
+			//Both layouts are printed by either renderer so the packed savings are next to each other in the report. They're
+			//derived from the formats, the Deferred pass's GPU time of deferred against deferred-naive is what was measured
+			constexpr double megabyte{ 1024.0 * 1024.0 };
+			const uint64_t pixelCount{ static_cast<uint64_t>(context.extent.width) * context.extent.height };
+			const uint64_t packedBytes{ pixelCount * DeferredGBuffer::Formats(GBufferLayout::Packed).bytesPerPixel };
+			const uint64_t naiveBytes{ pixelCount * DeferredGBuffer::Formats(GBufferLayout::Naive).bytesPerPixel };
+
+			EstimateGBufferBandwidth(GBufferLayout::Packed, context.extent).Print();
+			EstimateGBufferBandwidth(GBufferLayout::Naive, context.extent).Print();
+			printf("G-buffer attachments: %.2f MiB packed, %.2f MiB naive, %.2f MiB saved by packing\n",
+				static_cast<double>(packedBytes) / megabyte, static_cast<double>(naiveBytes) / megabyte, static_cast<double>(naiveBytes - packedBytes) / megabyte);
+			printf("The bandwidth figures are estimates, compare gpuMs/Deferred of deferred and deferred-naive for the measured cost\n");
+		}
+
+	private:
+		const BenchContext& context;
+		const VkDevice device;
+
+		BenchVisibilityDraws visibilityDraws;
+		Shader geometryVertexShader;
+		Shader geometryFragmentShader;
+		Shader lightingVertexShader;
+		Shader lightingFragmentShader;
+		DeferredGBuffer gbuffer;
+
+		VkBuffer materialBuffer;
+		VmaAllocation materialAllocation;
+		glm::mat4 viewProjection{ 1.0f };
+		glm::vec3 cameraPosition{ 0.0f };
+	};
+
+	std::unique_ptr<BenchRenderer> CreateDeferredRenderer(const BenchContext& context)
+	{
+		return std::make_unique<DeferredRenderer>(context, GBufferLayout::Packed);
+	}
+
+	std::unique_ptr<BenchRenderer> CreateNaiveDeferredRenderer(const BenchContext& context)
+	{
+		return std::make_unique<DeferredRenderer>(context, GBufferLayout::Naive);
+	}
+}
@@ -0,0 +1,162 @@
+#include "BenchRenderer.h"
+
+#include "GPU/GPUContext.h"
+#include "Graphics/DepthBuffer.h"
+
+#include <assert.h>
+
+namespace cof
+{
+	class ForwardRenderer : public BenchRenderer
+	{
+	public:
+		explicit ForwardRenderer(const BenchContext& benchContext)
+			: context{ benchContext }
+			, device{ benchContext.gpuContext.LogicalDevice() }
+			, frustumDraws{ benchContext }
+			, vertexShader{ LoadBenchShader(benchContext, "PulledTriangle.vert.spv") }
+			, fragmentShader{ LoadBenchShader(benchContext, "VBufferTriangle.frag.spv") }
+			, prepassShader{ LoadBenchShader(benchContext, "DepthPrepass.vert.spv") }
+			, forwardPass{ CreateForwardRenderPass(device, benchContext.targetFormat, benchContext.targetLayout, VK_ATTACHMENT_LOAD_OP_CLEAR) }
+		{
+			pipelineLayout = CreateBenchPipelineLayout(device, {}, VK_SHADER_STAGE_VERTEX_BIT, sizeof(DrawConstants));
+
+			prepassPipeline = CreateBenchPipeline(device, context.extent,
+			{
+				.stages = { ShaderStage(VK_SHADER_STAGE_VERTEX_BIT, prepassShader) },
+				.vertexInput = VertexLayout<UnlitColoredVertex, VertexStreams::Deinterleaved, 1>::InputState(),
+				.layout = pipelineLayout,
+				.renderPass = forwardPass.Handle(),
+				.subpass = 0,
+				.colorAttachmentCount = 0,
+				.depthWrite = VK_TRUE,
+				.depthCompareOp = DepthBuffer::compareOp
+			});
+
+			colorPipeline = CreateBenchPipeline(device, context.extent,
+			{
+				.stages = { ShaderStage(VK_SHADER_STAGE_VERTEX_BIT, vertexShader), ShaderStage(VK_SHADER_STAGE_FRAGMENT_BIT, fragmentShader) },
+				.layout = pipelineLayout,
+				.renderPass = forwardPass.Handle(),
+				.subpass = 1,
+				.colorAttachmentCount = 1,
+				.depthWrite = VK_FALSE,
+				.depthCompareOp = VK_COMPARE_OP_EQUAL
+			});
+
+			drawConstants.vertexBuffer = context.geometry.vertexAddress;
+		}
+
+		~ForwardRenderer() override
+		{
+			for (VkFramebuffer framebuffer : framebuffers)
+			{
+				vkDestroyFramebuffer(device, framebuffer, nullptr);
+			}
+			vkDestroyPipeline(device, colorPipeline, nullptr);
+			vkDestroyPipeline(device, prepassPipeline, nullptr);
+			vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+		}
+
+		ForwardRenderer(const ForwardRenderer& other) = delete;
+		ForwardRenderer& operator=(const ForwardRenderer& other) = delete;
+		ForwardRenderer(ForwardRenderer&& other) = delete;
+		ForwardRenderer& operator=(ForwardRenderer&& other) = delete;
+
+		void AddPasses(RenderGraph& graph, RenderResource target) override
+		{
+			depthImage = graph.CreateImage("Depth", { DepthBuffer::format, context.extent, VK_IMAGE_ASPECT_DEPTH_BIT });
+			frustumDraws.AddCullingPasses(graph);
+
+			graph.AddPass(
+			{
+				.name = "Forward",
+				.accesses =
+				{
+					{ frustumDraws.DrawCommands(), ResourceUsage::IndirectRead },
+					{ frustumDraws.DrawCount(), ResourceUsage::IndirectRead },
+					{ target, ResourceUsage::ColorWrite, context.targetLayout },
+					{ depthImage, ResourceUsage::DepthWrite }
+				},
+				.execute = [this](VkCommandBuffer commandBuffer)
+				{
+					VkClearValue clearValues[2]{};
+					clearValues[0].color = { 0.0f, 0.0f, 0.0f, 1.0f };
+					clearValues[1].depthStencil = { DepthBuffer::clearDepth, 0 };
+
+					VkRenderPassBeginInfo renderPassInfo
+					{
+						.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+						.renderPass = forwardPass.Handle(),
+						.framebuffer = framebuffers[imageIndex],
+						.renderArea = { .offset = { 0, 0 }, .extent = context.extent },
+						.clearValueCount = static_cast<uint32_t>(std::size(clearValues)),
+						.pClearValues = clearValues
+					};
+
+					const VkDeviceSize positionOffset{ 0 };
+
+					vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+					vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(DrawConstants), &drawConstants);
+					vkCmdBindIndexBuffer(commandBuffer, context.geometry.indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+
+					vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, prepassPipeline);
+					vkCmdBindVertexBuffers(commandBuffer, 0, 1, &context.geometry.positionBuffer, &positionOffset);
+					frustumDraws.RecordDraw(commandBuffer);
+
+					vkCmdNextSubpass(commandBuffer, VK_SUBPASS_CONTENTS_INLINE);
+					vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, colorPipeline);
+					frustumDraws.RecordDraw(commandBuffer);
+
+					vkCmdEndRenderPass(commandBuffer);
+				}
+			});
+
+			frustumDraws.AddReadbackPass(graph);
+		}
+
+		void Compiled(const RenderGraph& graph, const std::vector<VkImageView>& targetViews) override
+		{
+			for (VkImageView targetView : targetViews)
+			{
+				framebuffers.push_back(CreateFramebuffer(device, forwardPass.Handle(), context.extent, { targetView, graph.View(depthImage) }));
+			}
+		}
+
+		void Prepare(const BenchView& view, uint32_t targetImage) override
+		{
+			drawConstants.viewProjection = view.viewProjection;
+			frustumDraws.Prepare(view.viewProjection);
+			imageIndex = targetImage;
+		}
+
+		void Collect(BenchMetrics& metrics) override
+		{
+			frustumDraws.Collect(metrics);
+		}
+
+	private:
+		const BenchContext& context;
+		const VkDevice device;
+
+		BenchFrustumDraws frustumDraws;
+		Shader vertexShader;
+		Shader fragmentShader;
+		Shader prepassShader;
+		RenderPass forwardPass;
+
+		VkPipelineLayout pipelineLayout;
+		VkPipeline prepassPipeline;
+		VkPipeline colorPipeline;
+		std::vector<VkFramebuffer> framebuffers;
+
+		RenderResource depthImage{};
+		DrawConstants drawConstants{};
+		uint32_t imageIndex{ 0 };
+	};
+
+	std::unique_ptr<BenchRenderer> CreateForwardRenderer(const BenchContext& context)
+	{
+		return std::make_unique<ForwardRenderer>(context);
+	}
+}
@@ -0,0 +1,351 @@
+#include "BenchRenderer.h"
+
+#include "GPU/GPUContext.h"
+#include "GPU/UploadStreamer.h"
+#include "Graphics/DepthBuffer.h"
+#include "Graphics/FrustumCulling.h"
+#include "Graphics/MeshLod.h"
+
+#include <glm/geometric.hpp>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <assert.h>
+
+namespace cof
+{
+	//Simplification of a mesh stops once it deviates by this share of its bounding sphere radius
+	constexpr static float lodMaxRelativeError{ 0.05f };
+	//The coarsest LOD whose error projects to at most this many pixels is drawn
+	constexpr static float lodMaxPixelError{ 1.0f };
+
+	//Every mesh primitive gets a LOD chain when the scene is loaded, its instances index the same LOD ranges with their own
+	//vertexOffset. Each frame the CPU culls the instances against the frustum, picks the LOD of every visible one from its
+	//distance and writes the indirect draws the forward passes execute
+	class LodRenderer : public BenchRenderer
+	{
+	public:
+		explicit LodRenderer(const BenchContext& benchContext)
+			: context{ benchContext }
+			, device{ benchContext.gpuContext.LogicalDevice() }
+			, vertexShader{ LoadBenchShader(benchContext, "PulledTriangle.vert.spv") }
+			, fragmentShader{ LoadBenchShader(benchContext, "VBufferTriangle.frag.spv") }
+			, prepassShader{ LoadBenchShader(benchContext, "DepthPrepass.vert.spv") }
+			, forwardPass{ CreateForwardRenderPass(device, benchContext.targetFormat, benchContext.targetLayout, VK_ATTACHMENT_LOAD_OP_CLEAR) }
+		{
+			const std::chrono::steady_clock::time_point buildStart{ std::chrono::steady_clock::now() };
+
+			std::vector<uint32_t> lodIndices;
+			for (size_t instance{}; instance < context.scene.drawInstances.size(); ++instance)
+			{
+				const DrawInstance& drawInstance{ context.scene.drawInstances[instance] };
+				const uint32_t primitive{ context.scene.primitives[instance] };
+
+				//Mirrored instances of a primitive wind its triangles the other way, so they need a chain of their own
+				const auto shared{ std::find_if(meshes.begin(), meshes.end(), [&](const MeshLods& mesh)
+				{
+					const DrawInstance& source{ context.scene.drawInstances[mesh.sourceInstance] };
+					return mesh.primitive == primitive && source.indexCount == drawInstance.indexCount
+						&& std::equal(	context.scene.indices.begin() + source.firstIndex, context.scene.indices.begin() + source.firstIndex + source.indexCount,
+										context.scene.indices.begin() + drawInstance.firstIndex);
+				}) };
+				if (shared != meshes.end())
+				{
+					instanceMeshes.push_back(static_cast<uint32_t>(shared - meshes.begin()));
+					continue;
+				}
+
+				const std::vector<uint32_t> indices(context.scene.indices.begin() + drawInstance.firstIndex, context.scene.indices.begin() + drawInstance.firstIndex + drawInstance.indexCount);
+				const uint32_t vertexCount{ indices.empty() ? 0 : *std::max_element(indices.begin(), indices.end()) + 1 };
+
+				std::vector<glm::vec3> positions(vertexCount);
+				for (uint32_t vertex{}; vertex < vertexCount; ++vertex)
+				{
+					positions[vertex] = context.scene.vertices[static_cast<size_t>(drawInstance.vertexOffset) + vertex].position;
+				}
+
+				//Vertices are in world space, the chain is built in the space of the first instance that uses it
+				MeshLods mesh
+				{
+					.chain = BuildLodChain(indices, positions, lodMaxRelativeError * drawInstance.boundingSphere.w),
+					.firstIndex = static_cast<uint32_t>(lodIndices.size()),
+					.primitive = primitive,
+					.sourceInstance = static_cast<uint32_t>(instance)
+				};
+				lodIndices.insert(lodIndices.end(), mesh.chain.indices.begin(), mesh.chain.indices.end());
+				//Only the LOD ranges are needed from here on
+				mesh.chain.indices = {};
+				instanceMeshes.push_back(static_cast<uint32_t>(meshes.size()));
+				meshes.push_back(std::move(mesh));
+			}
+
+			const std::chrono::duration<double, std::milli> buildTime{ std::chrono::steady_clock::now() - buildStart };
+			printf("  LOD chains built in %.1f ms, %zu indices for all LODs of %zu meshes drawn by %zu instances\n", buildTime.count(), lodIndices.size(),
+				meshes.size(), instanceMeshes.size());
+			for (const MeshLods& mesh : meshes)
+			{
+				const PrimitiveCacheReport& primitive{ context.scene.primitiveCacheReports[mesh.primitive] };
+				const std::string label{ "  LOD chain of " + (primitive.meshName.empty() ? "mesh " + std::to_string(primitive.meshIndex) : primitive.meshName)
+					+ " primitive " + std::to_string(primitive.primitiveIndex) };
+				mesh.chain.Print(label.c_str());
+			}
+
+			const uint32_t instanceCount{ context.geometry.instanceCount };
+			indexBuffer = CreateBenchBuffer(context.allocator, sizeof(uint32_t) * lodIndices.size(),
+				VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_ONLY, indexAllocation);
+			//Written by the CPU every frame, the previous frame has finished by then
+			drawCommandBuffer = CreateBenchBuffer(context.allocator, sizeof(VkDrawIndexedIndirectCommand) * instanceCount,
+				VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, drawCommandAllocation, &drawCommandInfo);
+
+			context.uploadStreamer.Enqueue(BufferUpload{ indexBuffer, 0, AsBytes(lodIndices), VK_ACCESS_INDEX_READ_BIT }, UploadPriority::Visible);
+
+			pipelineLayout = CreateBenchPipelineLayout(device, {}, VK_SHADER_STAGE_VERTEX_BIT, sizeof(DrawConstants));
+
+			prepassPipeline = CreateBenchPipeline(device, context.extent,
+			{
+				.stages = { ShaderStage(VK_SHADER_STAGE_VERTEX_BIT, prepassShader) },
+				.vertexInput = VertexLayout<UnlitColoredVertex, VertexStreams::Deinterleaved, 1>::InputState(),
+				.layout = pipelineLayout,
+				.renderPass = forwardPass.Handle(),
+				.subpass = 0,
+				.colorAttachmentCount = 0,
+				.depthWrite = VK_TRUE,
+				.depthCompareOp = DepthBuffer::compareOp
+			});
+
+			colorPipeline = CreateBenchPipeline(device, context.extent,
+			{
+				.stages = { ShaderStage(VK_SHADER_STAGE_VERTEX_BIT, vertexShader), ShaderStage(VK_SHADER_STAGE_FRAGMENT_BIT, fragmentShader) },
+				.layout = pipelineLayout,
+				.renderPass = forwardPass.Handle(),
+				.subpass = 1,
+				.colorAttachmentCount = 1,
+				.depthWrite = VK_FALSE,
+				.depthCompareOp = VK_COMPARE_OP_EQUAL
+			});
+
+			drawConstants.vertexBuffer = context.geometry.vertexAddress;
+		}
+
+		~LodRenderer() override
+		{
+			for (VkFramebuffer framebuffer : framebuffers)
+			{
+				vkDestroyFramebuffer(device, framebuffer, nullptr);
+			}
+			vkDestroyPipeline(device, colorPipeline, nullptr);
+			vkDestroyPipeline(device, prepassPipeline, nullptr);
+			vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+
+			vmaDestroyBuffer(context.allocator, drawCommandBuffer, drawCommandAllocation);
+			vmaDestroyBuffer(context.allocator, indexBuffer, indexAllocation);
+		}
+
+		LodRenderer(const LodRenderer& other) = delete;
+		LodRenderer& operator=(const LodRenderer& other) = delete;
+		LodRenderer(LodRenderer&& other) = delete;
+		LodRenderer& operator=(LodRenderer&& other) = delete;
+
+		void AddPasses(RenderGraph& graph, RenderResource target) override
+		{
+			depthImage = graph.CreateImage("Depth", { DepthBuffer::format, context.extent, VK_IMAGE_ASPECT_DEPTH_BIT });
+
+			//The draws are written by the host before the submit, which makes them visible to the device
+			graph.AddPass(
+			{
+				.name = "Forward",
+				.accesses =
+				{
+					{ target, ResourceUsage::ColorWrite, context.targetLayout },
+					{ depthImage, ResourceUsage::DepthWrite }
+				},
+				.execute = [this](VkCommandBuffer commandBuffer)
+				{
+					VkClearValue clearValues[2]{};
+					clearValues[0].color = { 0.0f, 0.0f, 0.0f, 1.0f };
+					clearValues[1].depthStencil = { DepthBuffer::clearDepth, 0 };
+
+					VkRenderPassBeginInfo renderPassInfo
+					{
+						.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+						.renderPass = forwardPass.Handle(),
+						.framebuffer = framebuffers[imageIndex],
+						.renderArea = { .offset = { 0, 0 }, .extent = context.extent },
+						.clearValueCount = static_cast<uint32_t>(std::size(clearValues)),
+						.pClearValues = clearValues
+					};
+
+					const VkDeviceSize positionOffset{ 0 };
+
+					vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+					vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(DrawConstants), &drawConstants);
+					vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+
+					vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, prepassPipeline);
+					vkCmdBindVertexBuffers(commandBuffer, 0, 1, &context.geometry.positionBuffer, &positionOffset);
+					vkCmdDrawIndexedIndirect(commandBuffer, drawCommandBuffer, 0, drawCount, sizeof(VkDrawIndexedIndirectCommand));
+
+					vkCmdNextSubpass(commandBuffer, VK_SUBPASS_CONTENTS_INLINE);
+					vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, colorPipeline);
+					vkCmdDrawIndexedIndirect(commandBuffer, drawCommandBuffer, 0, drawCount, sizeof(VkDrawIndexedIndirectCommand));
+
+					vkCmdEndRenderPass(commandBuffer);
+				}
+			});
+		}
+
+		void Compiled(const RenderGraph& graph, const std::vector<VkImageView>& targetViews) override
+		{
+			for (VkImageView targetView : targetViews)
+			{
+				framebuffers.push_back(CreateFramebuffer(device, forwardPass.Handle(), context.extent, { targetView, graph.View(depthImage) }));
+			}
+		}
+
+		void Prepare(const BenchView& view, uint32_t targetImage) override
+		{
+			drawConstants.viewProjection = view.viewProjection;
+			imageIndex = targetImage;
+
+			const Frustum frustum{ ExtractFrustum(view.viewProjection) };
+			const float projectionScale{ std::abs(view.projection[1][1]) * static_cast<float>(context.extent.height) * 0.5f };
+
+			std::byte* commands{ static_cast<std::byte*>(drawCommandInfo.pMappedData) };
+			drawCount = 0;
+			frameTriangles = 0;
+			frameFullDetailTriangles = 0;
+			frameLodCounts.fill(0);
+
+			for (size_t instance{}; instance < instanceMeshes.size(); ++instance)
+			{
+				const DrawInstance& drawInstance{ context.scene.drawInstances[instance] };
+				const glm::vec3 center{ drawInstance.boundingSphere };
+				const float radius{ drawInstance.boundingSphere.w };
+
+				const bool visible{ std::all_of(frustum.planes.begin(), frustum.planes.end(),
+					[&](const glm::vec4& plane) { return glm::dot(glm::vec3{ plane }, center) + plane.w >= -radius; }) };
+				if (!visible)
+				{
+					continue;
+				}
+
+				//The chain's errors are in the space of its source instance, the ratio of the bounding radii scales them to this one
+				const MeshLods& mesh{ meshes[instanceMeshes[instance]] };
+				const float sourceRadius{ context.scene.drawInstances[mesh.sourceInstance].boundingSphere.w };
+				const float scale{ sourceRadius > 0.0f ? radius / sourceRadius : 1.0f };
+				const float distance{ std::max(glm::length(center - view.cameraPosition) - radius, benchZNear) };
+				const uint32_t lod{ scale > 0.0f ? SelectLod(mesh.chain, distance / scale, projectionScale, lodMaxPixelError) : static_cast<uint32_t>(mesh.chain.lods.size() - 1) };
+
+				const MeshLod& selected{ mesh.chain.lods[lod] };
+				const VkDrawIndexedIndirectCommand command
+				{
+					.indexCount = selected.indexCount,
+					.instanceCount = 1,
+					.firstIndex = mesh.firstIndex + selected.firstIndex,
+					.vertexOffset = drawInstance.vertexOffset,
+					.firstInstance = 0
+				};
+				std::memcpy(commands + sizeof(command) * drawCount, &command, sizeof(command));
+
+				++drawCount;
+				++frameLodCounts[lod];
+				frameTriangles += selected.indexCount / 3;
+				frameFullDetailTriangles += mesh.chain.lods[0].indexCount / 3;
+			}
+
+			vmaFlushAllocation(context.allocator, drawCommandAllocation, 0, VK_WHOLE_SIZE);
+		}
+
+		void Collect(BenchMetrics& metrics) override
+		{
+			metrics.Add("draws", static_cast<double>(drawCount));
+			metrics.Add("triangles", static_cast<double>(frameTriangles));
+
+			triangleTotal += frameTriangles;
+			fullDetailTriangleTotal += frameFullDetailTriangles;
+			for (uint32_t lod{}; lod < defaultMaxLodCount; ++lod)
+			{
+				lodCountTotals[lod] += frameLodCounts[lod];
+			}
+		}
+
+		void Report() const override
+		{
+			if (fullDetailTriangleTotal == 0)
+			{
+				return;
+			}
+
+			printf("  LOD selection: %.1f%% of the visible full detail triangles drawn at %.1f pixels of error, draws per LOD",
+				100.0 * static_cast<double>(triangleTotal) / static_cast<double>(fullDetailTriangleTotal), lodMaxPixelError);
+			uint64_t drawTotal{ 0 };
+			for (uint64_t lodCount : lodCountTotals)
+			{
+				drawTotal += lodCount;
+			}
+			for (uint32_t lod{}; lod < defaultMaxLodCount; ++lod)
+			{
+				printf(" %.1f%%", 100.0 * static_cast<double>(lodCountTotals[lod]) / static_cast<double>(drawTotal));
+			}
+			printf("\n");
+		}
+
+	private:
+		struct MeshLods
+		{
+			//Without its indices, they're in the shared index buffer from firstIndex on
+			LodChain chain;
+			uint32_t firstIndex;
+			//Index into the scene's primitiveCacheReports
+			uint32_t primitive;
+			//Instance whose vertices the chain was built from
+			uint32_t sourceInstance;
+		};
+
+		const BenchContext& context;
+		const VkDevice device;
+
+		Shader vertexShader;
+		Shader fragmentShader;
+		Shader prepassShader;
+		RenderPass forwardPass;
+
+		std::vector<MeshLods> meshes;
+		//Index into meshes of every instance
+		std::vector<uint32_t> instanceMeshes;
+
+		VkBuffer indexBuffer;
+		VmaAllocation indexAllocation;
+		VkBuffer drawCommandBuffer;
+		VmaAllocation drawCommandAllocation;
+		VmaAllocationInfo drawCommandInfo;
+
+		VkPipelineLayout pipelineLayout;
+		VkPipeline prepassPipeline;
+		VkPipeline colorPipeline;
+		std::vector<VkFramebuffer> framebuffers;
+
+		RenderResource depthImage{};
+		DrawConstants drawConstants{};
+		uint32_t imageIndex{ 0 };
+
+		uint32_t drawCount{ 0 };
+		uint64_t frameTriangles{ 0 };
+		uint64_t frameFullDetailTriangles{ 0 };
+		std::array<uint32_t, defaultMaxLodCount> frameLodCounts{};
+
+		uint64_t triangleTotal{ 0 };
+		uint64_t fullDetailTriangleTotal{ 0 };
+		std::array<uint64_t, defaultMaxLodCount> lodCountTotals{};
+	};
+
+	std::unique_ptr<BenchRenderer> CreateLodRenderer(const BenchContext& context)
+	{
+		return std::make_unique<LodRenderer>(context);
+	}
+}
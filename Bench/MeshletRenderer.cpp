@@ -0,0 +1,285 @@
+#include "BenchRenderer.h"
+
+#include "GPU/GPUContext.h"
+#include "GPU/UploadStreamer.h"
+#include "Graphics/DepthBuffer.h"
+#include "Graphics/DepthPyramid.h"
+#include "Graphics/Meshlet.h"
+#include "Graphics/MeshletCulling.h"
+#include "Graphics/OcclusionCulling.h"
+
+#include <chrono>
+#include <cstdio>
+#include <assert.h>
+
+namespace cof
+{
+	//The whole scene as one meshlet mesh, culled per meshlet by frustum and normal cone instead of per instance.
+	//The triangles that survive are compacted into an index buffer and drawn by the forward renderer's passes
+	class MeshletRenderer : public BenchRenderer
+	{
+	public:
+		explicit MeshletRenderer(const BenchContext& benchContext)
+			: context{ benchContext }
+			, device{ benchContext.gpuContext.LogicalDevice() }
+			, cullShader{ LoadBenchShader(benchContext, "MeshletCull.comp.spv") }
+			, reduceShader{ LoadBenchShader(benchContext, "DepthReduce.comp.spv") }
+			, vertexShader{ LoadBenchShader(benchContext, "PulledTriangle.vert.spv") }
+			, fragmentShader{ LoadBenchShader(benchContext, "VBufferTriangle.frag.spv") }
+			, prepassShader{ LoadBenchShader(benchContext, "DepthPrepass.vert.spv") }
+			, cullingPass{ device, cullShader, true }
+			, depthPyramid{ device, benchContext.allocator, benchContext.extent, reduceShader, true }
+			, forwardPass{ CreateForwardRenderPass(device, benchContext.targetFormat, benchContext.targetLayout, VK_ATTACHMENT_LOAD_OP_CLEAR) }
+		{
+			const std::chrono::steady_clock::time_point buildStart{ std::chrono::steady_clock::now() };
+			MeshletMesh mesh{ BuildMeshlets(AbsoluteSceneIndices(context.scene), ScenePositions(context.scene)) };
+			const std::chrono::duration<double, std::milli> buildTime{ std::chrono::steady_clock::now() - buildStart };
+
+			meshletCount = static_cast<uint32_t>(mesh.meshlets.size());
+			meshletTriangleCount = mesh.meshletTriangles.size() / 3;
+			printf("  %u meshlets built in %.1f ms, %.1f triangles per meshlet\n",
+				meshletCount, buildTime.count(), meshletCount != 0 ? static_cast<double>(meshletTriangleCount) / meshletCount : 0.0);
+
+			//The shader reads the local indices as uints
+			mesh.meshletTriangles.resize((mesh.meshletTriangles.size() + 3) & ~size_t{ 3 });
+
+			meshletBuffer = CreateBenchBuffer(context.allocator, sizeof(Meshlet) * mesh.meshlets.size(),
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_ONLY, meshletAllocation);
+			meshletVertexBuffer = CreateBenchBuffer(context.allocator, sizeof(uint32_t) * mesh.meshletVertices.size(),
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_ONLY, meshletVertexAllocation);
+			meshletTriangleBuffer = CreateBenchBuffer(context.allocator, mesh.meshletTriangles.size(),
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_ONLY, meshletTriangleAllocation);
+			compactedIndexBuffer = CreateBenchBuffer(context.allocator, sizeof(uint32_t) * 3 * meshletTriangleCount,
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VMA_MEMORY_USAGE_GPU_ONLY, compactedIndexAllocation);
+			drawCommandBuffer = CreateBenchBuffer(context.allocator, sizeof(VkDrawIndexedIndirectCommand),
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_ONLY, drawCommandAllocation);
+			readbackBuffer = CreateBenchBuffer(context.allocator, sizeof(VkDrawIndexedIndirectCommand),
+				VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_TO_CPU, readbackAllocation, &readbackInfo);
+
+			context.uploadStreamer.Enqueue(BufferUpload{ meshletBuffer, 0, AsBytes(mesh.meshlets), VK_ACCESS_SHADER_READ_BIT }, UploadPriority::Visible);
+			context.uploadStreamer.Enqueue(BufferUpload{ meshletVertexBuffer, 0, AsBytes(mesh.meshletVertices), VK_ACCESS_SHADER_READ_BIT }, UploadPriority::Visible);
+			context.uploadStreamer.Enqueue(BufferUpload{ meshletTriangleBuffer, 0, AsBytes(mesh.meshletTriangles), VK_ACCESS_SHADER_READ_BIT }, UploadPriority::Visible);
+
+			cullingPass.BindBuffers(meshletBuffer, meshletVertexBuffer, meshletTriangleBuffer, compactedIndexBuffer, drawCommandBuffer, meshletCount);
+			//Only bound because the shader statically uses it, occlusion stays disabled so it's never sampled
+			cullingPass.BindDepthPyramid(depthPyramid);
+
+			pipelineLayout = CreateBenchPipelineLayout(device, {}, VK_SHADER_STAGE_VERTEX_BIT, sizeof(DrawConstants));
+
+			prepassPipeline = CreateBenchPipeline(device, context.extent,
+			{
+				.stages = { ShaderStage(VK_SHADER_STAGE_VERTEX_BIT, prepassShader) },
+				.vertexInput = VertexLayout<UnlitColoredVertex, VertexStreams::Deinterleaved, 1>::InputState(),
+				.layout = pipelineLayout,
+				.renderPass = forwardPass.Handle(),
+				.subpass = 0,
+				.colorAttachmentCount = 0,
+				.depthWrite = VK_TRUE,
+				.depthCompareOp = DepthBuffer::compareOp
+			});
+
+			colorPipeline = CreateBenchPipeline(device, context.extent,
+			{
+				.stages = { ShaderStage(VK_SHADER_STAGE_VERTEX_BIT, vertexShader), ShaderStage(VK_SHADER_STAGE_FRAGMENT_BIT, fragmentShader) },
+				.layout = pipelineLayout,
+				.renderPass = forwardPass.Handle(),
+				.subpass = 1,
+				.colorAttachmentCount = 1,
+				.depthWrite = VK_FALSE,
+				.depthCompareOp = VK_COMPARE_OP_EQUAL
+			});
+
+			drawConstants.vertexBuffer = context.geometry.vertexAddress;
+		}
+
+		~MeshletRenderer() override
+		{
+			for (VkFramebuffer framebuffer : framebuffers)
+			{
+				vkDestroyFramebuffer(device, framebuffer, nullptr);
+			}
+			vkDestroyPipeline(device, colorPipeline, nullptr);
+			vkDestroyPipeline(device, prepassPipeline, nullptr);
+			vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+
+			vmaDestroyBuffer(context.allocator, readbackBuffer, readbackAllocation);
+			vmaDestroyBuffer(context.allocator, drawCommandBuffer, drawCommandAllocation);
+			vmaDestroyBuffer(context.allocator, compactedIndexBuffer, compactedIndexAllocation);
+			vmaDestroyBuffer(context.allocator, meshletTriangleBuffer, meshletTriangleAllocation);
+			vmaDestroyBuffer(context.allocator, meshletVertexBuffer, meshletVertexAllocation);
+			vmaDestroyBuffer(context.allocator, meshletBuffer, meshletAllocation);
+		}
+
+		MeshletRenderer(const MeshletRenderer& other) = delete;
+		MeshletRenderer& operator=(const MeshletRenderer& other) = delete;
+		MeshletRenderer(MeshletRenderer&& other) = delete;
+		MeshletRenderer& operator=(MeshletRenderer&& other) = delete;
+
+		void AddPasses(RenderGraph& graph, RenderResource target) override
+		{
+			depthImage = graph.CreateImage("Depth", { DepthBuffer::format, context.extent, VK_IMAGE_ASPECT_DEPTH_BIT });
+			const RenderResource compactedIndices = graph.ImportBuffer("CompactedIndices", compactedIndexBuffer, { .stages = 0, .access = 0, .layout = VK_IMAGE_LAYOUT_UNDEFINED });
+			const RenderResource drawCommand = graph.ImportBuffer("DrawCommand", drawCommandBuffer, { .stages = 0, .access = 0, .layout = VK_IMAGE_LAYOUT_UNDEFINED });
+
+			//Record resets the draw command itself before culling
+			graph.AddPass(
+			{
+				.name = "MeshletCulling",
+				.accesses = { { compactedIndices, ResourceUsage::ComputeWrite }, { drawCommand, ResourceUsage::ComputeReadWrite } },
+				.execute = [this](VkCommandBuffer commandBuffer) { cullingPass.Record(commandBuffer, cullingView, false); }
+			});
+
+			graph.AddPass(
+			{
+				.name = "Forward",
+				.accesses =
+				{
+					{ compactedIndices, ResourceUsage::IndexRead },
+					{ drawCommand, ResourceUsage::IndirectRead },
+					{ target, ResourceUsage::ColorWrite, context.targetLayout },
+					{ depthImage, ResourceUsage::DepthWrite }
+				},
+				.execute = [this](VkCommandBuffer commandBuffer)
+				{
+					VkClearValue clearValues[2]{};
+					clearValues[0].color = { 0.0f, 0.0f, 0.0f, 1.0f };
+					clearValues[1].depthStencil = { DepthBuffer::clearDepth, 0 };
+
+					VkRenderPassBeginInfo renderPassInfo
+					{
+						.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+						.renderPass = forwardPass.Handle(),
+						.framebuffer = framebuffers[imageIndex],
+						.renderArea = { .offset = { 0, 0 }, .extent = context.extent },
+						.clearValueCount = static_cast<uint32_t>(std::size(clearValues)),
+						.pClearValues = clearValues
+					};
+
+					const VkDeviceSize positionOffset{ 0 };
+
+					vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+					vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(DrawConstants), &drawConstants);
+
+					//The compacted indices are absolute, the draw command's vertexOffset is 0
+					vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, prepassPipeline);
+					vkCmdBindVertexBuffers(commandBuffer, 0, 1, &context.geometry.positionBuffer, &positionOffset);
+					cullingPass.RecordDraw(commandBuffer);
+
+					vkCmdNextSubpass(commandBuffer, VK_SUBPASS_CONTENTS_INLINE);
+					vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, colorPipeline);
+					cullingPass.RecordDraw(commandBuffer);
+
+					vkCmdEndRenderPass(commandBuffer);
+				}
+			});
+
+			graph.AddPass(
+			{
+				.name = "DrawReadback",
+				.accesses = { { drawCommand, ResourceUsage::TransferRead } },
+				.execute = [this](VkCommandBuffer commandBuffer)
+				{
+					const VkBufferCopy commandCopy{ .srcOffset = 0, .dstOffset = 0, .size = sizeof(VkDrawIndexedIndirectCommand) };
+					vkCmdCopyBuffer(commandBuffer, drawCommandBuffer, readbackBuffer, 1, &commandCopy);
+
+					VkMemoryBarrier hostBarrier
+					{
+						.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+						.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+						.dstAccessMask = VK_ACCESS_HOST_READ_BIT
+					};
+					vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &hostBarrier, 0, nullptr, 0, nullptr);
+				},
+				.sideEffects = true
+			});
+		}
+
+		void Compiled(const RenderGraph& graph, const std::vector<VkImageView>& targetViews) override
+		{
+			for (VkImageView targetView : targetViews)
+			{
+				framebuffers.push_back(CreateFramebuffer(device, forwardPass.Handle(), context.extent, { targetView, graph.View(depthImage) }));
+			}
+		}
+
+		void Prepare(const BenchView& view, uint32_t targetImage) override
+		{
+			drawConstants.viewProjection = view.viewProjection;
+			cullingView = CullingView{ .view = view.view, .projection = view.projection, .zNear = benchZNear, .zFar = 0.0f };
+			imageIndex = targetImage;
+		}
+
+		void Collect(BenchMetrics& metrics) override
+		{
+			vmaInvalidateAllocation(context.allocator, readbackAllocation, 0, VK_WHOLE_SIZE);
+			const uint64_t triangleCount{ CountIndirectTriangles(static_cast<const std::byte*>(readbackInfo.pMappedData), 1) };
+
+			metrics.Add("draws", 1.0);
+			metrics.Add("triangles", static_cast<double>(triangleCount));
+
+			culledTriangleTotal += meshletTriangleCount - std::min(triangleCount, meshletTriangleCount);
+			++measuredFrameCount;
+		}
+
+		void Report() const override
+		{
+			if (measuredFrameCount == 0 || meshletTriangleCount == 0)
+			{
+				return;
+			}
+
+			const double culledTriangles{ static_cast<double>(culledTriangleTotal) / measuredFrameCount };
+			printf("  Meshlets: %.0f of %llu triangles culled on average (%.1f%%)\n",
+				culledTriangles, static_cast<unsigned long long>(meshletTriangleCount), 100.0 * culledTriangles / static_cast<double>(meshletTriangleCount));
+		}
+
+	private:
+		const BenchContext& context;
+		const VkDevice device;
+
+		Shader cullShader;
+		Shader reduceShader;
+		Shader vertexShader;
+		Shader fragmentShader;
+		Shader prepassShader;
+		MeshletCullingPass cullingPass;
+		DepthPyramid depthPyramid;
+		RenderPass forwardPass;
+
+		uint32_t meshletCount;
+		//Degenerate triangles are left out of the meshlets, so this can be below the scene's triangle count
+		uint64_t meshletTriangleCount;
+
+		VkBuffer meshletBuffer;
+		VmaAllocation meshletAllocation;
+		VkBuffer meshletVertexBuffer;
+		VmaAllocation meshletVertexAllocation;
+		VkBuffer meshletTriangleBuffer;
+		VmaAllocation meshletTriangleAllocation;
+		VkBuffer compactedIndexBuffer;
+		VmaAllocation compactedIndexAllocation;
+		VkBuffer drawCommandBuffer;
+		VmaAllocation drawCommandAllocation;
+		VkBuffer readbackBuffer;
+		VmaAllocation readbackAllocation;
+		VmaAllocationInfo readbackInfo;
+
+		VkPipelineLayout pipelineLayout;
+		VkPipeline prepassPipeline;
+		VkPipeline colorPipeline;
+		std::vector<VkFramebuffer> framebuffers;
+
+		RenderResource depthImage{};
+		DrawConstants drawConstants{};
+		CullingView cullingView{};
+		uint32_t imageIndex{ 0 };
+
+		uint64_t culledTriangleTotal{ 0 };
+		uint32_t measuredFrameCount{ 0 };
+	};
+
+	std::unique_ptr<BenchRenderer> CreateMeshletRenderer(const BenchContext& context)
+	{
+		return std::make_unique<MeshletRenderer>(context);
+	}
+}
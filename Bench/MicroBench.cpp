@@ -0,0 +1,192 @@
+#include "MicroBench.h"
+
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <thread>
+
+namespace cof
+{
+	MicroBenchState::MicroBenchState(size_t inputSize, uint32_t index, uint32_t count, uint64_t iterationCount, std::barrier<>& barrier) noexcept
+		: size{ inputSize }
+		, threadIndex{ index }
+		, threadCount{ count }
+		, remainingIterations{ iterationCount }
+		, startBarrier{ barrier }
+	{
+	}
+
+	bool MicroBenchState::StartOrStop() noexcept
+	{
+		if (!started)
+		{
+			started = true;
+			startBarrier.arrive_and_wait();
+			begin = std::chrono::steady_clock::now();
+			return KeepRunning();
+		}
+
+		end = std::chrono::steady_clock::now();
+		return false;
+	}
+
+	//Out of line, so the compiler has to assume the pointed to value is read
+	void UseCharPointer(const volatile char*) noexcept
+	{
+	}
+
+	std::deque<MicroBenchmark>& MicroBenchmarks()
+	{
+		//Registration runs during static initialization of other translation units, so no namespace scope registry
+		static std::deque<MicroBenchmark> benchmarks;
+		return benchmarks;
+	}
+
+	MicroBenchmark& RegisterMicroBench(const char* name, MicroBenchFunction function)
+	{
+		return MicroBenchmarks().emplace_back(name, function);
+	}
+
+	struct RunTiming
+	{
+		double seconds;
+		uint64_t itemsPerIteration;
+	};
+
+	//The slowest thread's time, the run is over when every thread is done
+	static RunTiming RunOnce(MicroBenchFunction function, size_t size, uint32_t threadCount, uint64_t iterations)
+	{
+		std::barrier startBarrier{ static_cast<std::ptrdiff_t>(threadCount) };
+		std::vector<MicroBenchState> states;
+		states.reserve(threadCount);
+		for (uint32_t thread{}; thread < threadCount; ++thread)
+		{
+			states.emplace_back(size, thread, threadCount, iterations, startBarrier);
+		}
+
+		{
+			std::vector<std::jthread> workers;
+			for (uint32_t thread{ 1 }; thread < threadCount; ++thread)
+			{
+				workers.emplace_back(function, std::ref(states[thread]));
+			}
+			function(states[0]);
+		}
+
+		std::chrono::steady_clock::duration slowest{};
+		for (const MicroBenchState& state : states)
+		{
+			slowest = std::max(slowest, state.Duration());
+		}
+
+		return { std::chrono::duration<double>(slowest).count(), states[0].ItemsPerIteration() };
+	}
+
+	static MicroBenchResult RunBenchmark(const MicroBenchmark& benchmark, size_t size, uint32_t threadCount, const MicroBenchOptions& options)
+	{
+		constexpr uint64_t maxIterations{ 1'000'000'000 };
+		const double minSeconds{ options.minMilliseconds / 1000.0 };
+
+		//Grows the iteration count until a run takes long enough, which also warms caches and the allocator
+		uint64_t iterations{ 1 };
+		for (;;)
+		{
+			const double seconds{ RunOnce(benchmark.Function(), size, threadCount, iterations).seconds };
+			if (seconds >= minSeconds || iterations >= maxIterations)
+			{
+				break;
+			}
+
+			const double predicted{ static_cast<double>(iterations) * minSeconds * 1.4 / std::max(seconds, 1e-9) };
+			iterations = std::clamp(static_cast<uint64_t>(predicted), iterations * 2, std::min(iterations * 100, maxIterations));
+		}
+
+		std::vector<double> nanoseconds;
+		uint64_t itemsPerIteration{ 0 };
+		for (uint32_t repetition{}; repetition < std::max(options.repetitions, 1u); ++repetition)
+		{
+			const RunTiming timing{ RunOnce(benchmark.Function(), size, threadCount, iterations) };
+			nanoseconds.push_back(timing.seconds * 1e9 / static_cast<double>(iterations));
+			itemsPerIteration = timing.itemsPerIteration;
+		}
+
+		std::sort(nanoseconds.begin(), nanoseconds.end());
+		const double median{ nanoseconds[nanoseconds.size() / 2] };
+
+		return MicroBenchResult
+		{
+			.name = benchmark.Name(),
+			.size = size,
+			.threadCount = threadCount,
+			.iterations = iterations,
+			.medianNanoseconds = median,
+			.minNanoseconds = nanoseconds.front(),
+			.maxNanoseconds = nanoseconds.back(),
+			.itemsPerSecond = median > 0.0 ? static_cast<double>(itemsPerIteration) * threadCount * 1e9 / median : 0.0
+		};
+	}
+
+	std::vector<MicroBenchResult> RunMicroBenchmarks(const MicroBenchOptions& options)
+	{
+		printf("%-28s %10s %7s %12s %14s %8s %14s\n", "Benchmark", "Size", "Threads", "Iterations", "Median ns", "Spread", "Items/s");
+
+		std::vector<MicroBenchResult> results;
+		for (const MicroBenchmark& benchmark : MicroBenchmarks())
+		{
+			if (std::string_view{ benchmark.Name() }.find(options.filter) == std::string_view::npos)
+			{
+				continue;
+			}
+
+			for (size_t size : benchmark.SweptSizes())
+			{
+				for (uint32_t threadCount : benchmark.SweptThreadCounts())
+				{
+					if (threadCount == 0 || threadCount > options.maxThreadCount)
+					{
+						continue;
+					}
+
+					results.push_back(RunBenchmark(benchmark, size, threadCount, options));
+					PrintMicroBenchResult(results.back());
+				}
+			}
+		}
+		return results;
+	}
+
+	void PrintMicroBenchResult(const MicroBenchResult& result)
+	{
+		//Spread is the range of the repetitions relative to their median, large values mean the numbers aren't stable
+		const double spread{ result.medianNanoseconds > 0.0 ? (result.maxNanoseconds - result.minNanoseconds) / result.medianNanoseconds : 0.0 };
+		printf("%-28s %10zu %7u %12llu %14.2f %7.1f%% %14.4g\n", result.name.c_str(), result.size, result.threadCount,
+			static_cast<unsigned long long>(result.iterations), result.medianNanoseconds, spread * 100.0, result.itemsPerSecond);
+	}
+
+	bool WriteMicroBenchResults(const char* path, const std::vector<MicroBenchResult>& results)
+	{
+		//Parentheses, braces would make it the only element of an array
+		nlohmann::ordered_json json(nlohmann::ordered_json::array());
+		for (const MicroBenchResult& result : results)
+		{
+			json.push_back(nlohmann::ordered_json
+			{
+				{ "name", result.name },
+				{ "size", result.size },
+				{ "threads", result.threadCount },
+				{ "iterations", result.iterations },
+				{ "medianNs", result.medianNanoseconds },
+				{ "minNs", result.minNanoseconds },
+				{ "maxNs", result.maxNanoseconds },
+				{ "itemsPerSecond", result.itemsPerSecond }
+			});
+		}
+
+		std::ofstream file{ path, std::ios::binary };
+		file << json.dump(1, '\t') << '\n';
+		return static_cast<bool>(file);
+	}
+}
@@ -0,0 +1,152 @@
+#pragma once
+#include <barrier>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <initializer_list>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace cof
+{
+	//What one thread of a benchmark run sees. A kernel does its setup, then works while KeepRunning() returns true,
+	//only that loop is timed. Every thread of a run has a state of its own and runs the same number of iterations
+	class MicroBenchState
+	{
+	public:
+		MicroBenchState(size_t inputSize, uint32_t index, uint32_t count, uint64_t iterationCount, std::barrier<>& barrier) noexcept;
+
+		//Input size of the run, one of the benchmark's Sizes
+		size_t Size() const noexcept { return size; }
+		uint32_t ThreadIndex() const noexcept { return threadIndex; }
+		uint32_t ThreadCount() const noexcept { return threadCount; }
+
+		//The first call waits for every thread of the run and starts the clock, the call that returns false stops it
+		bool KeepRunning() noexcept
+		{
+			if (started && remainingIterations != 0) [[likely]]
+			{
+				--remainingIterations;
+				return true;
+			}
+			return StartOrStop();
+		}
+
+		//Items, e.g. bytes or lookups, an iteration processes, so results also show a throughput
+		void SetItemsPerIteration(uint64_t itemCount) noexcept { itemsPerIteration = itemCount; }
+		uint64_t ItemsPerIteration() const noexcept { return itemsPerIteration; }
+
+		std::chrono::steady_clock::duration Duration() const noexcept { return end - begin; }
+
+	private:
+		bool StartOrStop() noexcept;
+
+		size_t size;
+		uint32_t threadIndex;
+		uint32_t threadCount;
+		uint64_t remainingIterations;
+		uint64_t itemsPerIteration{ 0 };
+		bool started{ false };
+		std::barrier<>& startBarrier;
+		std::chrono::steady_clock::time_point begin;
+		std::chrono::steady_clock::time_point end;
+	};
+
+	void UseCharPointer(const volatile char* pointer) noexcept;
+
+	//Keeps the compiler from optimizing away the computation of value, e.g. a kernel's result
+	template<typename T>
+	inline void DoNotOptimize(const T& value) noexcept
+	{
+#if defined(_MSC_VER)
+		UseCharPointer(&reinterpret_cast<const volatile char&>(value));
+		_ReadWriteBarrier();
+#else
+		asm volatile("" : : "r,m"(value) : "memory");
+#endif
+	}
+
+	using MicroBenchFunction = void(*)(MicroBenchState& state);
+
+	class MicroBenchmark
+	{
+	public:
+		MicroBenchmark(const char* benchName, MicroBenchFunction benchFunction) noexcept
+			: name{ benchName }
+			, function{ benchFunction }
+		{
+		}
+
+		//Input sizes the benchmark is run with, only 0 by default
+		MicroBenchmark& Sizes(std::initializer_list<size_t> inputSizes)
+		{
+			sizes = inputSizes;
+			return *this;
+		}
+
+		//Thread counts the benchmark is run with for every size, only 1 by default
+		MicroBenchmark& Threads(std::initializer_list<uint32_t> counts)
+		{
+			threadCounts = counts;
+			return *this;
+		}
+
+		const char* Name() const noexcept { return name; }
+		MicroBenchFunction Function() const noexcept { return function; }
+		const std::vector<size_t>& SweptSizes() const noexcept { return sizes; }
+		const std::vector<uint32_t>& SweptThreadCounts() const noexcept { return threadCounts; }
+
+	private:
+		const char* name;
+		MicroBenchFunction function;
+		std::vector<size_t> sizes{ 0 };
+		std::vector<uint32_t> threadCounts{ 1 };
+	};
+
+	//Every registered benchmark in registration order, a deque so the references RegisterMicroBench returns stay valid
+	std::deque<MicroBenchmark>& MicroBenchmarks();
+	MicroBenchmark& RegisterMicroBench(const char* name, MicroBenchFunction function);
+
+	struct MicroBenchOptions
+	{
+		//Only benchmarks whose name contains it run
+		std::string_view filter;
+		//Each repetition runs at least this long
+		double minMilliseconds{ 50.0 };
+		uint32_t repetitions{ 5 };
+		//Thread counts above it are skipped, the hardware's thread count by default
+		uint32_t maxThreadCount;
+	};
+
+	//One size and thread count of a benchmark, times are per iteration of one thread
+	struct MicroBenchResult
+	{
+		std::string name;
+		size_t size;
+		uint32_t threadCount;
+		uint64_t iterations;
+		double medianNanoseconds;
+		double minNanoseconds;
+		double maxNanoseconds;
+		//Of all threads together, 0 when the kernel doesn't count items
+		double itemsPerSecond;
+	};
+
+	//Calibrates the iteration count of every run to minMilliseconds, then reports the spread over the repetitions
+	std::vector<MicroBenchResult> RunMicroBenchmarks(const MicroBenchOptions& options);
+	void PrintMicroBenchResult(const MicroBenchResult& result);
+	bool WriteMicroBenchResults(const char* path, const std::vector<MicroBenchResult>& results);
+}
+
+#define COF_BENCH_CONCAT_IMPL(a, b) a##b
+#define COF_BENCH_CONCAT(a, b) COF_BENCH_CONCAT_IMPL(a, b)
+
+//Registers a void(cof::MicroBenchState&) kernel under its own name, sweeps chain on, e.g.
+//MICRO_BENCH(ReadShaderFile).Sizes({ 4096, 65536 }).Threads({ 1, 4 });
+#define MICRO_BENCH(function) [[maybe_unused]] static cof::MicroBenchmark& COF_BENCH_CONCAT(microBenchmark, __LINE__) = cof::RegisterMicroBench(#function, function)
@@ -0,0 +1,756 @@
+#include "BenchRenderer.h"
+
+#include "GPU/GPUContext.h"
+#include "GPU/CommandPool.h"
+#include "GPU/Shader.h"
+#include "GPU/Semaphore.h"
+#include "GPU/GeometryBuffer.h"
+#include "GPU/UploadStreamer.h"
+#include "GPU/GpuProfiler.h"
+#include "Utils/CpuProfiler.h"
+#include "Graphics/OffscreenTarget.h"
+#include "Graphics/DepthBuffer.h"
+#include "Graphics/VertexLayout.h"
+#include "Graphics/RenderGraph.h"
+#include "Graphics/GltfScene.h"
+
+#include "GPU/vk_mem_alloc.h"
+
+#include <vulkan/vulkan.h>
+#include <glm/ext/matrix_float4x4.hpp>
+#include <glm/geometric.hpp>
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <assert.h>
+
+//Renders glTF scenes headless along a camera path that only depends on the frame number, so every run draws the same
+//frames, and writes the distribution of CPU frame time, GPU pass times, draws, triangles and memory as JSON.
+//Every scene is rendered by every selected renderer, results are named scene/renderer so the renderers compare directly.
+//
+//NomadBench [--assets dir] [--scene name]... [--renderer name]... [--frames N] [--warmup N] [--extent WxH] [--lights N]
+//           [--out results.json] [--baseline baseline.json] [--threshold 0.05] [--trace trace.json]
+//NomadBench --compare results.json baseline.json [--threshold 0.05]
+//
+//--scene takes a name from benchScenes or a .gltf path relative to the assets, every scene in benchScenes by default.
+//--renderer takes a name from cof::BenchRenderers(), every renderer by default.
+//--lights is how many point lights the lit renderers shade, e.g. clustered against bruteforce.
+//--trace writes the GPU passes as a Chrome trace, plus the CPU_ZONE scopes when built with NOMAD_CPU_PROFILER.
+//With a baseline the results are compared against it, the exit code is 1 if anything regressed
+
+#if defined(_DEBUG)
+constexpr static std::array layers
+{
+	"VK_LAYER_LUNARG_standard_validation"
+};
+#else
+constexpr static std::array<const char*, 0> layers{};
+#endif
+
+static VkApplicationInfo appInfo
+{
+	VK_STRUCTURE_TYPE_APPLICATION_INFO,
+	nullptr,
+	"NomadBench",
+	1u,
+	"LunarG SDK",
+	1u,
+	VK_API_VERSION_1_2
+};
+
+//fullDrawIndexUint32, multiDrawIndirect and drawIndirectFirstInstance for the GPU driven draws, geometryShader for the
+//gl_PrimitiveID the visibility buffer stores, fragmentStoresAndAtomics for the texture feedback and
+//shaderSampledImageArrayDynamicIndexing for the streamed textures
+constexpr static uint64_t desiredFeaturesBitMask{ 1ull << 1 | 1ull << 4 | 1ull << 9 | 1ull << 10 | 1ull << 26 | 1ull << 34 };
+constexpr static VkQueueFlags queueFlags{ VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT };
+
+static VkPhysicalDeviceVulkan12Features desiredVulkan12Features
+{
+	.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+	.drawIndirectCount = VK_TRUE,
+	.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE,
+	.descriptorBindingUpdateUnusedWhilePending = VK_TRUE,
+	.descriptorBindingPartiallyBound = VK_TRUE,
+	.scalarBlockLayout = VK_TRUE,
+	.timelineSemaphore = VK_TRUE,
+	.bufferDeviceAddress = VK_TRUE
+};
+
+constexpr static VkDeviceSize uploadStagingSize{ 32 * 1024 * 1024 };
+constexpr static uint32_t targetImageCount{ 2 };
+constexpr static uint32_t profilerFrameSlots{ 2 };
+
+enum class CameraPath
+{
+	//Walks along the longer horizontal axis of the bounds and back over the upper floor, for interiors
+	Flythrough,
+	//Circles the bounds looking at their center, for single objects
+	Orbit
+};
+
+struct BenchScene
+{
+	const char* name;
+	//Relative to the assets directory
+	const char* path;
+	CameraPath cameraPath;
+};
+
+constexpr static BenchScene benchScenes[]
+{
+	{ "Sponza", "Models/Sponza/Sponza.gltf", CameraPath::Flythrough },
+	{ "CesiumCube", "Models/CesiumCube/glTF/BoxTextured.gltf", CameraPath::Orbit }
+};
+
+struct Options
+{
+	const char* assetDirectory{ "Assets" };
+	std::vector<BenchScene> scenes;
+	std::vector<cof::BenchRendererInfo> renderers;
+	uint32_t frameCount{ 600 };
+	uint32_t warmupFrameCount{ 60 };
+	VkExtent2D extent{ 1280, 720 };
+	uint32_t lightCount{ 256 };
+	const char* outputPath{ "NomadBench.json" };
+	const char* baselinePath{ nullptr };
+	const char* comparePath{ nullptr };
+	double threshold{ 0.05 };
+	const char* tracePath{ nullptr };
+};
+
+static std::optional<Options> ParseOptions(int argc, char** argv)
+{
+	Options options{};
+	for (int argument{ 1 }; argument < argc; ++argument)
+	{
+		const std::string_view option{ argv[argument] };
+		const bool hasValue{ argument + 1 < argc };
+
+		if (option == "--assets" && hasValue)
+		{
+			options.assetDirectory = argv[++argument];
+		}
+		else if (option == "--scene" && hasValue)
+		{
+			const std::string_view name{ argv[++argument] };
+			bool found{ false };
+			for (const BenchScene& scene : benchScenes)
+			{
+				if (name == scene.name)
+				{
+					options.scenes.push_back(scene);
+					found = true;
+				}
+			}
+
+			if (!found && name.ends_with(".gltf"))
+			{
+				options.scenes.push_back({ argv[argument], argv[argument], CameraPath::Orbit });
+			}
+			else if (!found)
+			{
+				printf("Unknown scene %s\n", argv[argument]);
+				return std::nullopt;
+			}
+		}
+		else if (option == "--renderer" && hasValue)
+		{
+			const std::vector<cof::BenchRendererInfo>& renderers{ cof::BenchRenderers() };
+			const std::string_view name{ argv[++argument] };
+			auto renderer{ std::find_if(renderers.begin(), renderers.end(), [name](const cof::BenchRendererInfo& info) { return name == info.name; }) };
+			if (renderer == renderers.end())
+			{
+				printf("Unknown renderer %s\n", argv[argument]);
+				return std::nullopt;
+			}
+			options.renderers.push_back(*renderer);
+		}
+		else if (option == "--frames" && hasValue)
+		{
+			options.frameCount = static_cast<uint32_t>(std::strtoul(argv[++argument], nullptr, 10));
+		}
+		else if (option == "--warmup" && hasValue)
+		{
+			options.warmupFrameCount = static_cast<uint32_t>(std::strtoul(argv[++argument], nullptr, 10));
+		}
+		else if (option == "--extent" && hasValue)
+		{
+			char* height;
+			options.extent.width = static_cast<uint32_t>(std::strtoul(argv[++argument], &height, 10));
+			options.extent.height = *height == 'x' ? static_cast<uint32_t>(std::strtoul(height + 1, nullptr, 10)) : 0;
+		}
+		else if (option == "--lights" && hasValue)
+		{
+			options.lightCount = static_cast<uint32_t>(std::strtoul(argv[++argument], nullptr, 10));
+		}
+		else if (option == "--out" && hasValue)
+		{
+			options.outputPath = argv[++argument];
+		}
+		else if (option == "--baseline" && hasValue)
+		{
+			options.baselinePath = argv[++argument];
+		}
+		else if (option == "--compare" && argument + 2 < argc)
+		{
+			options.comparePath = argv[++argument];
+			options.baselinePath = argv[++argument];
+		}
+		else if (option == "--threshold" && hasValue)
+		{
+			options.threshold = std::strtod(argv[++argument], nullptr);
+		}
+		else if (option == "--trace" && hasValue)
+		{
+			options.tracePath = argv[++argument];
+		}
+		else
+		{
+			printf("Unknown option %s\n", argv[argument]);
+			return std::nullopt;
+		}
+	}
+
+	if (options.frameCount == 0 || options.extent.width == 0 || options.extent.height == 0)
+	{
+		printf("Frame count and extent have to be positive\n");
+		return std::nullopt;
+	}
+
+	if (options.scenes.empty())
+	{
+		options.scenes.assign(std::begin(benchScenes), std::end(benchScenes));
+	}
+
+	if (options.renderers.empty())
+	{
+		options.renderers = cof::BenchRenderers();
+	}
+
+	return options;
+}
+
+struct CameraKey
+{
+	glm::vec3 position;
+	glm::vec3 target;
+};
+
+//Keys are relative to the scene bounds, 0 at boundsMin and 1 at boundsMax on every axis, with y up
+static std::vector<CameraKey> CameraKeys(CameraPath path)
+{
+	if (path == CameraPath::Orbit)
+	{
+		constexpr uint32_t orbitKeyCount{ 8 };
+		std::vector<CameraKey> keys;
+		for (uint32_t key{}; key < orbitKeyCount; ++key)
+		{
+			const float angle{ 6.2831853f * static_cast<float>(key) / static_cast<float>(orbitKeyCount) };
+			keys.push_back({ glm::vec3{ 0.5f + 1.5f * std::cos(angle), 0.9f, 0.5f + 1.5f * std::sin(angle) }, glm::vec3{ 0.5f } });
+		}
+		return keys;
+	}
+
+	//Down the nave at eye height, turning back at the far end and returning along the upper floor
+	return
+	{
+		{ glm::vec3{ 0.08f, 0.12f, 0.50f }, glm::vec3{ 0.50f, 0.15f, 0.50f } },
+		{ glm::vec3{ 0.35f, 0.12f, 0.45f }, glm::vec3{ 0.70f, 0.20f, 0.50f } },
+		{ glm::vec3{ 0.65f, 0.12f, 0.55f }, glm::vec3{ 0.95f, 0.30f, 0.50f } },
+		{ glm::vec3{ 0.90f, 0.12f, 0.50f }, glm::vec3{ 0.50f, 0.60f, 0.50f } },
+		{ glm::vec3{ 0.70f, 0.45f, 0.25f }, glm::vec3{ 0.30f, 0.20f, 0.60f } },
+		{ glm::vec3{ 0.30f, 0.45f, 0.75f }, glm::vec3{ 0.50f, 0.10f, 0.30f } }
+	};
+}
+
+static glm::vec3 CatmullRom(const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2, const glm::vec3& p3, float t) noexcept
+{
+	const float t2{ t * t };
+	const float t3{ t2 * t };
+	return ((p1 * 2.0f) + (p2 - p0) * t + (p0 * 2.0f - p1 * 5.0f + p2 * 4.0f - p3) * t2 + (p1 * 3.0f - p0 - p2 * 3.0f + p3) * t3) * 0.5f;
+}
+
+//Right handed, y up, looking down -z like InfiniteReversedPerspective expects
+static glm::mat4 LookAt(const glm::vec3& eye, const glm::vec3& target) noexcept
+{
+	const glm::vec3 forward{ glm::normalize(target - eye) };
+	const glm::vec3 side{ glm::normalize(glm::cross(forward, glm::vec3{ 0.0f, 1.0f, 0.0f })) };
+	const glm::vec3 up{ glm::cross(side, forward) };
+
+	glm::mat4 view{ 1.0f };
+	view[0] = glm::vec4{ side.x, up.x, -forward.x, 0.0f };
+	view[1] = glm::vec4{ side.y, up.y, -forward.y, 0.0f };
+	view[2] = glm::vec4{ side.z, up.z, -forward.z, 0.0f };
+	view[3] = glm::vec4{ -glm::dot(side, eye), -glm::dot(up, eye), glm::dot(forward, eye), 1.0f };
+	return view;
+}
+
+struct CameraPose
+{
+	glm::mat4 view;
+	glm::vec3 eye;
+};
+
+//Closed Catmull-Rom loop through the keys, a whole loop over frameCount frames
+static CameraPose CameraView(const std::vector<CameraKey>& keys, const cof::GltfScene& scene, uint32_t frame, uint32_t frameCount)
+{
+	glm::vec3 size{ scene.boundsMax - scene.boundsMin };
+	//Keys run along x, scenes that are longer along z get them rotated onto it
+	const bool alongZ{ size.z > size.x };
+
+	auto toScene = [&](glm::vec3 key)
+	{
+		if (alongZ)
+		{
+			key = glm::vec3{ key.z, key.y, key.x };
+		}
+		return scene.boundsMin + key * size;
+	};
+
+	const size_t keyCount{ keys.size() };
+	const double position{ static_cast<double>(frame) * static_cast<double>(keyCount) / static_cast<double>(frameCount) };
+	const size_t segment{ static_cast<size_t>(position) % keyCount };
+	const float t{ static_cast<float>(position - std::floor(position)) };
+
+	auto key = [&](size_t offset) -> const CameraKey& { return keys[(segment + keyCount + offset - 1) % keyCount]; };
+
+	const glm::vec3 eye{ toScene(CatmullRom(key(0).position, key(1).position, key(2).position, key(3).position, t)) };
+	const glm::vec3 target{ toScene(CatmullRom(key(0).target, key(1).target, key(2).target, key(3).target, t)) };
+	return { LookAt(eye, target), eye };
+}
+
+//Everything a run renders with lives and dies with it, including the allocator, so its memory is the renderer's alone
+static std::optional<cof::SceneBenchResult> RunScene(const cof::GPUContext& gpuContext, const BenchScene& benchScene, const cof::BenchRendererInfo& rendererInfo, const Options& options, std::vector<cof::TraceEvent>& traceEvents)
+{
+	CPU_ZONE("RunScene");
+
+	const VkDevice logicalDevice{ gpuContext.LogicalDevice() };
+	const std::filesystem::path assets{ options.assetDirectory };
+	const std::filesystem::path scenePath{ assets / benchScene.path };
+	const std::chrono::steady_clock::time_point loadStart{ std::chrono::steady_clock::now() };
+
+	std::optional<cof::GltfScene> scene{ cof::LoadGltfScene(scenePath) };
+	if (!scene)
+	{
+		printf("Skipping %s\n", benchScene.name);
+		return std::nullopt;
+	}
+	for (const cof::PrimitiveCacheReport& primitive : scene->primitiveCacheReports)
+	{
+		const std::string label{ "  Vertex cache of " + (primitive.meshName.empty() ? "mesh " + std::to_string(primitive.meshIndex) : primitive.meshName)
+			+ " primitive " + std::to_string(primitive.primitiveIndex) };
+		primitive.report.Print(label.c_str());
+	}
+	scene->vertexCacheReport.Print("  Vertex cache of the scene");
+
+	cof::SceneBenchResult result
+	{
+		.scene = std::string{ benchScene.name } + "/" + rendererInfo.name,
+		.frameCount = options.frameCount,
+		.instanceCount = static_cast<uint32_t>(scene->drawInstances.size()),
+		.sceneTriangleCount = scene->triangleCount
+	};
+
+	VmaAllocatorCreateInfo allocatorInfo
+	{
+		.physicalDevice = gpuContext.PhysicalDevice(),
+		.device = logicalDevice
+	};
+
+	VmaAllocator allocator;
+	vmaCreateAllocator(&allocatorInfo, &allocator);
+
+	{
+		const std::vector<std::byte> vertexBytes{ cof::AsBytes(scene->vertices) };
+		const std::vector<std::byte> positionBytes{ cof::DeinterleaveVertices(scene->vertices)[0] };
+		const std::vector<std::byte> indexBytes{ cof::AsBytes(scene->indices) };
+		const std::vector<std::byte> instanceBytes{ cof::AsBytes(scene->drawInstances) };
+
+		cof::GeometryBuffer geometryBuffer{ gpuContext, vertexBytes.size() };
+		const VkDeviceSize vertexOffset{ geometryBuffer.Allocate(vertexBytes.size()) };
+
+		VmaAllocation indexAllocation, positionAllocation, instanceAllocation;
+		const cof::BenchGeometry geometry
+		{
+			.indexBuffer = cof::CreateBenchBuffer(allocator, indexBytes.size(), VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_ONLY, indexAllocation),
+			.positionBuffer = cof::CreateBenchBuffer(allocator, positionBytes.size(), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_ONLY, positionAllocation),
+			.instanceBuffer = cof::CreateBenchBuffer(allocator, instanceBytes.size(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_ONLY, instanceAllocation),
+			.vertexAddress = geometryBuffer.DeviceAddress(vertexOffset),
+			.instanceCount = result.instanceCount
+		};
+
+		cof::UploadStreamer uploadStreamer{ gpuContext, allocator, gpuContext.QueueFamilyIndex<VK_QUEUE_GRAPHICS_BIT>(), uploadStagingSize };
+		uploadStreamer.Enqueue(cof::BufferUpload{ geometryBuffer.Handle(), vertexOffset, vertexBytes, VK_ACCESS_SHADER_READ_BIT }, cof::UploadPriority::Visible);
+		uploadStreamer.Enqueue(cof::BufferUpload{ geometry.positionBuffer, 0, positionBytes, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT }, cof::UploadPriority::Visible);
+		uploadStreamer.Enqueue(cof::BufferUpload{ geometry.indexBuffer, 0, indexBytes, VK_ACCESS_INDEX_READ_BIT }, cof::UploadPriority::Visible);
+		uploadStreamer.Enqueue(cof::BufferUpload{ geometry.instanceBuffer, 0, instanceBytes, VK_ACCESS_SHADER_READ_BIT }, cof::UploadPriority::Visible);
+
+		const VkQueue graphicsQueue{ gpuContext.Queue<VK_QUEUE_GRAPHICS_BIT>() };
+		//Transfer destination for renderers that finish the frame with a blit
+		cof::OffscreenTarget target{ gpuContext, allocator, graphicsQueue, VK_FORMAT_R8G8B8A8_UNORM, options.extent,
+			VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, targetImageCount };
+
+		const cof::BenchContext benchContext
+		{
+			.gpuContext = gpuContext,
+			.allocator = allocator,
+			.uploadStreamer = uploadStreamer,
+			.assets = assets,
+			.scenePath = scenePath,
+			.scene = *scene,
+			.geometry = geometry,
+			.extent = options.extent,
+			.targetFormat = target.Format(),
+			.targetLayout = target.PresentLayout(),
+			.lightCount = options.lightCount
+		};
+
+		cof::GpuProfiler gpuProfiler{ logicalDevice, gpuContext.PhysicalDevice(), gpuContext.QueueFamilyIndex<VK_QUEUE_GRAPHICS_BIT>(), profilerFrameSlots };
+		cof::RenderGraph frameGraph{ logicalDevice, allocator };
+		frameGraph.Profile(&gpuProfiler);
+
+		//Destroyed before the graph whose passes it recorded
+		const std::unique_ptr<cof::BenchRenderer> renderer{ rendererInfo.create(benchContext) };
+		//Includes whatever the renderer uploads or builds from the scene
+		uploadStreamer.Flush();
+
+		const std::chrono::duration<double, std::milli> loadTime{ std::chrono::steady_clock::now() - loadStart };
+		result.loadMilliseconds = loadTime.count();
+
+		//Vulkan's clip space y points down, flipping it keeps the image upright
+		glm::mat4 projection{ cof::InfiniteReversedPerspective(1.0f, static_cast<float>(options.extent.width) / static_cast<float>(options.extent.height), cof::benchZNear) };
+		projection[1][1] = -projection[1][1];
+
+		constexpr VkImageSubresourceRange colorRange{ .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .baseMipLevel = 0, .levelCount = 1, .baseArrayLayer = 0, .layerCount = 1 };
+
+		//Every frame waits for the previous one, so the target doesn't carry a dependency into the next
+		const cof::RenderResource targetImage = frameGraph.ImportImage("Target", VK_NULL_HANDLE, colorRange,
+			{ .stages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, .access = 0, .layout = VK_IMAGE_LAYOUT_UNDEFINED });
+		frameGraph.MarkOutput(targetImage, target.PresentLayout());
+
+		renderer->AddPasses(frameGraph, targetImage);
+
+		//Creates the transient images the renderer's framebuffers reference
+		frameGraph.Compile();
+		frameGraph.Statistics().Print();
+
+		[[maybe_unused]] VkResult errorCode{ VK_RESULT_MAX_ENUM };
+
+		std::vector<VkImageView> targetViews(targetImageCount);
+		for (uint32_t image{}; image < targetImageCount; ++image)
+		{
+			VkImageViewCreateInfo viewInfo
+			{
+				.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+				.image = target.Image(image),
+				.viewType = VK_IMAGE_VIEW_TYPE_2D,
+				.format = target.Format(),
+				.subresourceRange = colorRange
+			};
+
+			errorCode = vkCreateImageView(logicalDevice, &viewInfo, nullptr, &targetViews[image]);
+			assert(errorCode == VK_SUCCESS);
+		}
+
+		renderer->Compiled(frameGraph, targetViews);
+
+		cof::CommandPool<VK_QUEUE_GRAPHICS_BIT> commandPool{ gpuContext, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT };
+
+		VkCommandBufferAllocateInfo commandBufferInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+			.commandPool = commandPool.Handle(),
+			.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+			.commandBufferCount = 1
+		};
+
+		VkCommandBuffer commandBuffer;
+		errorCode = vkAllocateCommandBuffers(logicalDevice, &commandBufferInfo, &commandBuffer);
+		assert(errorCode == VK_SUCCESS);
+
+		cof::Semaphore imageAvailableSemaphore{ logicalDevice };
+		cof::Semaphore renderingFinishedSemaphore{ logicalDevice };
+
+		VkFenceCreateInfo fenceInfo{ .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO };
+		VkFence frameFence;
+		errorCode = vkCreateFence(logicalDevice, &fenceInfo, nullptr, &frameFence);
+		assert(errorCode == VK_SUCCESS);
+
+		const std::vector<CameraKey> cameraKeys{ CameraKeys(benchScene.cameraPath) };
+
+		std::vector<double> cpuFrameMilliseconds;
+		cof::BenchMetrics rendererMetrics;
+		//Scopes by their path from the outermost one, e.g. Frame/Forward, in order of appearance
+		std::vector<cof::MetricSamples> gpuScopes;
+		std::vector<uint64_t> gpuSampleCounts;
+		std::vector<std::string> scopePaths;
+
+		const uint32_t totalFrameCount{ options.warmupFrameCount + options.frameCount };
+		for (uint32_t frame{}; frame < totalFrameCount; ++frame)
+		{
+			CPU_ZONE("Frame");
+
+			const bool measured{ frame >= options.warmupFrameCount };
+			//Warmup frames all look from the start of the path
+			const uint32_t pathFrame{ measured ? frame - options.warmupFrameCount : 0 };
+			if (frame == options.warmupFrameCount)
+			{
+				for (cof::MetricSamples& scope : gpuScopes)
+				{
+					scope.samples.clear();
+				}
+			}
+
+			const std::chrono::steady_clock::time_point frameStart{ std::chrono::steady_clock::now() };
+
+			const CameraPose pose{ CameraView(cameraKeys, *scene, pathFrame, options.frameCount) };
+			const cof::BenchView view
+			{
+				.view = pose.view,
+				.projection = projection,
+				.viewProjection = projection * pose.view,
+				.cameraPosition = pose.eye
+			};
+
+			const uint32_t imageIndex{ target.AcquireNextImage(imageAvailableSemaphore.Handle()) };
+			renderer->Prepare(view, imageIndex);
+
+			VkCommandBufferBeginInfo beginInfo
+			{
+				.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+				.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
+			};
+
+			vkBeginCommandBuffer(commandBuffer, &beginInfo);
+			gpuProfiler.BeginFrame(commandBuffer, frame % profilerFrameSlots);
+			gpuProfiler.BeginScope(commandBuffer, "Frame");
+
+			const uint64_t uploadWaitValue{ uploadStreamer.RecordAcquires(commandBuffer) };
+
+			frameGraph.SetImage(targetImage, target.Image(imageIndex));
+			frameGraph.Execute(commandBuffer);
+
+			gpuProfiler.EndScope(commandBuffer);
+			errorCode = vkEndCommandBuffer(commandBuffer);
+			assert(errorCode == VK_SUCCESS);
+
+			VkSemaphore waitSemaphores[]{ imageAvailableSemaphore.Handle(), uploadStreamer.Semaphore() };
+			VkPipelineStageFlags waitStages[]{ VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT };
+			//Binary semaphores ignore their value, waiting on zero for the timeline is a no-op
+			uint64_t waitValues[]{ 0, uploadWaitValue };
+			VkSemaphore signalSemaphores[]{ renderingFinishedSemaphore.Handle() };
+
+			VkTimelineSemaphoreSubmitInfo timelineInfo
+			{
+				.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+				.waitSemaphoreValueCount = static_cast<uint32_t>(std::size(waitValues)),
+				.pWaitSemaphoreValues = waitValues
+			};
+
+			VkSubmitInfo submitInfo
+			{
+				.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+				.pNext = &timelineInfo,
+				.waitSemaphoreCount = static_cast<uint32_t>(std::size(waitSemaphores)),
+				.pWaitSemaphores = waitSemaphores,
+				.pWaitDstStageMask = waitStages,
+				.commandBufferCount = 1,
+				.pCommandBuffers = &commandBuffer,
+				.signalSemaphoreCount = static_cast<uint32_t>(std::size(signalSemaphores)),
+				.pSignalSemaphores = signalSemaphores
+			};
+
+			{
+				CPU_ZONE("vkQueueSubmit");
+				errorCode = vkQueueSubmit(graphicsQueue, 1, &submitInfo, frameFence);
+				assert(errorCode == VK_SUCCESS);
+			}
+			gpuProfiler.Submitted();
+
+			target.Present(graphicsQueue, renderingFinishedSemaphore.Handle(), imageIndex);
+
+			{
+				CPU_ZONE("vkWaitForFences");
+				vkWaitForFences(logicalDevice, 1, &frameFence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+				vkResetFences(logicalDevice, 1, &frameFence);
+			}
+
+			const std::chrono::duration<double, std::milli> frameTime{ std::chrono::steady_clock::now() - frameStart };
+
+			//Collected outside the timed part of the frame
+			if (measured)
+			{
+				cpuFrameMilliseconds.push_back(frameTime.count());
+				renderer->Collect(rendererMetrics);
+			}
+
+			//A scope's samples arrive a few frames late, when its frame slot is read back
+			const std::vector<cof::GpuScopeTiming>& timings{ gpuProfiler.Timings() };
+			scopePaths.resize(timings.size());
+			for (size_t scope{}; scope < timings.size(); ++scope)
+			{
+				const cof::GpuScopeTiming& timing{ timings[scope] };
+				scopePaths[scope] = timing.parent == cof::GpuProfiler::noParent ? timing.name : scopePaths[timing.parent] + "/" + timing.name;
+
+				const std::string metricName{ "gpuMs/" + scopePaths[scope] };
+				auto metric{ std::find_if(gpuScopes.begin(), gpuScopes.end(), [&metricName](const cof::MetricSamples& samples) { return samples.name == metricName; }) };
+				if (metric == gpuScopes.end())
+				{
+					gpuScopes.push_back({ metricName, {} });
+					gpuSampleCounts.push_back(0);
+					metric = gpuScopes.end() - 1;
+				}
+
+				const size_t metricIndex{ static_cast<size_t>(metric - gpuScopes.begin()) };
+				if (timing.sampleCount != gpuSampleCounts[metricIndex])
+				{
+					gpuSampleCounts[metricIndex] = timing.sampleCount;
+					metric->samples.push_back(timing.lastMilliseconds);
+				}
+			}
+		}
+
+		vkDeviceWaitIdle(logicalDevice);
+
+		result.metrics.push_back({ "cpuFrameMs", std::move(cpuFrameMilliseconds) });
+		for (cof::MetricSamples& scope : gpuScopes)
+		{
+			result.metrics.push_back(std::move(scope));
+		}
+		for (cof::MetricSamples& metric : rendererMetrics.Samples())
+		{
+			result.metrics.push_back(std::move(metric));
+		}
+		renderer->Report();
+
+		//The geometry buffer bypasses VMA
+		VmaStats memoryStatistics;
+		vmaCalculateStats(allocator, &memoryStatistics);
+		result.deviceMemoryBytes = memoryStatistics.total.usedBytes + memoryStatistics.total.unusedBytes + geometryBuffer.Capacity();
+		result.usedMemoryBytes = memoryStatistics.total.usedBytes + geometryBuffer.Size();
+
+		const std::vector<cof::TraceEvent> sceneTraceEvents{ gpuProfiler.TraceEvents() };
+		traceEvents.insert(traceEvents.end(), sceneTraceEvents.begin(), sceneTraceEvents.end());
+
+		vkDestroyFence(logicalDevice, frameFence, nullptr);
+		for (VkImageView targetView : targetViews)
+		{
+			vkDestroyImageView(logicalDevice, targetView, nullptr);
+		}
+
+		vmaDestroyBuffer(allocator, geometry.instanceBuffer, instanceAllocation);
+		vmaDestroyBuffer(allocator, geometry.positionBuffer, positionAllocation);
+		vmaDestroyBuffer(allocator, geometry.indexBuffer, indexAllocation);
+	}
+
+	vmaDestroyAllocator(allocator);
+	return result;
+}
+
+static int CompareFiles(const char* currentPath, const char* baselinePath, double threshold)
+{
+	const std::optional<nlohmann::ordered_json> current{ cof::LoadBenchResults(currentPath) };
+	const std::optional<nlohmann::ordered_json> baseline{ cof::LoadBenchResults(baselinePath) };
+	if (!current || !baseline)
+	{
+		printf("Couldn't read %s\n", !current ? currentPath : baselinePath);
+		return 2;
+	}
+
+	return cof::CompareBenchResults(*current, *baseline, threshold) == 0 ? 0 : 1;
+}
+
+int main(int argc, char** argv)
+{
+	const std::optional<Options> options{ ParseOptions(argc, argv) };
+	if (!options)
+	{
+		return 2;
+	}
+
+	if (options->comparePath != nullptr)
+	{
+		return CompareFiles(options->comparePath, options->baselinePath, options->threshold);
+	}
+
+	cof::SetCpuThreadName("Main");
+
+	VkInstanceCreateInfo instanceInfo
+	{
+		.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO,
+		.pApplicationInfo = &appInfo,
+		.enabledLayerCount = static_cast<uint32_t>(layers.size()),
+		.ppEnabledLayerNames = layers.data()
+	};
+
+	VkInstance instance;
+	[[maybe_unused]] VkResult errorCode = vkCreateInstance(&instanceInfo, nullptr, &instance);
+	assert(errorCode == VK_SUCCESS);
+
+	cof::BenchRun run
+	{
+		.width = options->extent.width,
+		.height = options->extent.height,
+		.warmupFrameCount = options->warmupFrameCount
+	};
+
+	std::vector<cof::TraceEvent> traceEvents;
+
+	{
+		//No surface, so no VK_KHR_swapchain either
+		cof::GPUContext gpuContext{ instance, desiredFeaturesBitMask, queueFlags, {}, &desiredVulkan12Features };
+
+		VkPhysicalDeviceProperties properties;
+		vkGetPhysicalDeviceProperties(gpuContext.PhysicalDevice(), &properties);
+		run.device = properties.deviceName;
+
+		for (const BenchScene& scene : options->scenes)
+		{
+			for (const cof::BenchRendererInfo& renderer : options->renderers)
+			{
+				printf("Running %s with %s\n", scene.name, renderer.name);
+				if (std::optional<cof::SceneBenchResult> result{ RunScene(gpuContext, scene, renderer, *options, traceEvents) })
+				{
+					run.scenes.push_back(std::move(*result));
+				}
+			}
+		}
+	}
+
+	vkDestroyInstance(instance, nullptr);
+
+	if (run.scenes.empty())
+	{
+		printf("No scene could be run\n");
+		return 2;
+	}
+
+	PrintBenchRun(run);
+
+	if (!cof::WriteBenchResults(options->outputPath, run))
+	{
+		printf("Couldn't write %s\n", options->outputPath);
+		return 2;
+	}
+	printf("Wrote %s\n", options->outputPath);
+
+	if (options->tracePath != nullptr)
+	{
+		printf("%s %s\n", cof::WriteChromeTrace(options->tracePath, traceEvents) ? "Wrote" : "Couldn't write", options->tracePath);
+	}
+
+	return options->baselinePath != nullptr ? CompareFiles(options->outputPath, options->baselinePath, options->threshold) : 0;
+}
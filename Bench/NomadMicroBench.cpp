@@ -0,0 +1,79 @@
+#include "MicroBench.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <string_view>
+#include <thread>
+
+//Runs every registered CPU kernel for each of its sizes and thread counts and prints the time per iteration.
+//Kernels register themselves with MICRO_BENCH, a new one only needs its source file added to the target.
+//
+//NomadMicroBench [--filter name] [--min-time ms] [--repetitions N] [--max-threads N] [--out results.json] [--list]
+int main(int argc, char** argv)
+{
+	cof::MicroBenchOptions options
+	{
+		.maxThreadCount = std::max(std::thread::hardware_concurrency(), 1u)
+	};
+	const char* outputPath{ nullptr };
+
+	for (int argument{ 1 }; argument < argc; ++argument)
+	{
+		const std::string_view option{ argv[argument] };
+		const bool hasValue{ argument + 1 < argc };
+
+		if (option == "--filter" && hasValue)
+		{
+			options.filter = argv[++argument];
+		}
+		else if (option == "--min-time" && hasValue)
+		{
+			options.minMilliseconds = std::strtod(argv[++argument], nullptr);
+		}
+		else if (option == "--repetitions" && hasValue)
+		{
+			options.repetitions = static_cast<uint32_t>(std::strtoul(argv[++argument], nullptr, 10));
+		}
+		else if (option == "--max-threads" && hasValue)
+		{
+			options.maxThreadCount = static_cast<uint32_t>(std::strtoul(argv[++argument], nullptr, 10));
+		}
+		else if (option == "--out" && hasValue)
+		{
+			outputPath = argv[++argument];
+		}
+		else if (option == "--list")
+		{
+			for (const cof::MicroBenchmark& benchmark : cof::MicroBenchmarks())
+			{
+				printf("%s\n", benchmark.Name());
+			}
+			return 0;
+		}
+		else
+		{
+			printf("Unknown option %s\n", argv[argument]);
+			return 2;
+		}
+	}
+
+	const std::vector<cof::MicroBenchResult> results{ cof::RunMicroBenchmarks(options) };
+	if (results.empty())
+	{
+		printf("No benchmark matches %.*s\n", static_cast<int>(options.filter.size()), options.filter.data());
+		return 2;
+	}
+
+	if (outputPath != nullptr)
+	{
+		if (!cof::WriteMicroBenchResults(outputPath, results))
+		{
+			printf("Couldn't write %s\n", outputPath);
+			return 2;
+		}
+		printf("Wrote %s\n", outputPath);
+	}
+
+	return 0;
+}
@@ -0,0 +1,388 @@
+#include "BenchRenderer.h"
+
+#include "GPU/GPUContext.h"
+#include "GPU/UploadStreamer.h"
+#include "Graphics/DepthBuffer.h"
+#include "Graphics/DepthPyramid.h"
+#include "Graphics/OcclusionCulling.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <assert.h>
+
+namespace cof
+{
+	//The forward renderer's passes behind two phase Hi-Z culling. Early draws what was visible last frame into depth,
+	//the depth pyramid is reduced from it and Late draws what became visible, then the color pass shades both
+	class OcclusionRenderer : public BenchRenderer
+	{
+	public:
+		explicit OcclusionRenderer(const BenchContext& benchContext)
+			: context{ benchContext }
+			, device{ benchContext.gpuContext.LogicalDevice() }
+			, cullShader{ LoadBenchShader(benchContext, "OcclusionCull.comp.spv") }
+			, reduceShader{ LoadBenchShader(benchContext, "DepthReduce.comp.spv") }
+			, vertexShader{ LoadBenchShader(benchContext, "PulledTriangle.vert.spv") }
+			, fragmentShader{ LoadBenchShader(benchContext, "VBufferTriangle.frag.spv") }
+			, prepassShader{ LoadBenchShader(benchContext, "DepthPrepass.vert.spv") }
+			, cullingPass{ device, cullShader, true }
+			, depthPyramid{ device, benchContext.allocator, benchContext.extent, reduceShader, true }
+			, earlyDepthPass{ CreateEarlyDepthPass(device) }
+			, forwardPass{ CreateForwardRenderPass(device, benchContext.targetFormat, benchContext.targetLayout, VK_ATTACHMENT_LOAD_OP_LOAD) }
+		{
+			const uint32_t instanceCount{ context.geometry.instanceCount };
+
+			visibilityBuffer = CreateBenchBuffer(context.allocator, sizeof(uint32_t) * instanceCount,
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_ONLY, visibilityAllocation);
+			drawCommandBuffer = CreateBenchBuffer(context.allocator, 2 * sizeof(VkDrawIndexedIndirectCommand) * instanceCount,
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_GPU_ONLY, drawCommandAllocation);
+			counterBuffer = CreateBenchBuffer(context.allocator, sizeof(OcclusionCullingStatistics),
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_ONLY, counterAllocation);
+			readbackBuffer = CreateBenchBuffer(context.allocator, readbackCommandOffset + 2 * sizeof(VkDrawIndexedIndirectCommand) * instanceCount,
+				VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_TO_CPU, readbackAllocation, &readbackInfo);
+
+			//Nothing was visible before the first frame, so its early phase draws nothing and the late phase everything in the frustum
+			context.uploadStreamer.Enqueue(BufferUpload{ visibilityBuffer, 0, std::vector<std::byte>(sizeof(uint32_t) * instanceCount), VK_ACCESS_SHADER_READ_BIT }, UploadPriority::Visible);
+
+			cullingPass.BindBuffers(context.geometry.instanceBuffer, visibilityBuffer, drawCommandBuffer, counterBuffer, instanceCount);
+			cullingPass.BindDepthPyramid(depthPyramid);
+
+			pipelineLayout = CreateBenchPipelineLayout(device, {}, VK_SHADER_STAGE_VERTEX_BIT, sizeof(DrawConstants));
+
+			BenchPipelineInfo depthPipelineInfo
+			{
+				.stages = { ShaderStage(VK_SHADER_STAGE_VERTEX_BIT, prepassShader) },
+				.vertexInput = VertexLayout<UnlitColoredVertex, VertexStreams::Deinterleaved, 1>::InputState(),
+				.layout = pipelineLayout,
+				.renderPass = earlyDepthPass.Handle(),
+				.subpass = 0,
+				.colorAttachmentCount = 0,
+				.depthWrite = VK_TRUE,
+				.depthCompareOp = DepthBuffer::compareOp
+			};
+			earlyDepthPipeline = CreateBenchPipeline(device, context.extent, depthPipelineInfo);
+
+			depthPipelineInfo.renderPass = forwardPass.Handle();
+			lateDepthPipeline = CreateBenchPipeline(device, context.extent, depthPipelineInfo);
+
+			colorPipeline = CreateBenchPipeline(device, context.extent,
+			{
+				.stages = { ShaderStage(VK_SHADER_STAGE_VERTEX_BIT, vertexShader), ShaderStage(VK_SHADER_STAGE_FRAGMENT_BIT, fragmentShader) },
+				.layout = pipelineLayout,
+				.renderPass = forwardPass.Handle(),
+				.subpass = 1,
+				.colorAttachmentCount = 1,
+				.depthWrite = VK_FALSE,
+				.depthCompareOp = VK_COMPARE_OP_EQUAL
+			});
+
+			drawConstants.vertexBuffer = context.geometry.vertexAddress;
+		}
+
+		~OcclusionRenderer() override
+		{
+			for (VkFramebuffer framebuffer : framebuffers)
+			{
+				vkDestroyFramebuffer(device, framebuffer, nullptr);
+			}
+			vkDestroyFramebuffer(device, earlyDepthFramebuffer, nullptr);
+			vkDestroyPipeline(device, colorPipeline, nullptr);
+			vkDestroyPipeline(device, lateDepthPipeline, nullptr);
+			vkDestroyPipeline(device, earlyDepthPipeline, nullptr);
+			vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+
+			vmaDestroyBuffer(context.allocator, readbackBuffer, readbackAllocation);
+			vmaDestroyBuffer(context.allocator, counterBuffer, counterAllocation);
+			vmaDestroyBuffer(context.allocator, drawCommandBuffer, drawCommandAllocation);
+			vmaDestroyBuffer(context.allocator, visibilityBuffer, visibilityAllocation);
+		}
+
+		OcclusionRenderer(const OcclusionRenderer& other) = delete;
+		OcclusionRenderer& operator=(const OcclusionRenderer& other) = delete;
+		OcclusionRenderer(OcclusionRenderer&& other) = delete;
+		OcclusionRenderer& operator=(OcclusionRenderer&& other) = delete;
+
+		void AddPasses(RenderGraph& graph, RenderResource target) override
+		{
+			const uint32_t instanceCount{ context.geometry.instanceCount };
+
+			//The visibility buffer is the only state carried from one frame into the next, and every frame waits for the previous one
+			depthImage = graph.CreateImage("Depth", { DepthBuffer::format, context.extent, VK_IMAGE_ASPECT_DEPTH_BIT });
+			const RenderResource visibility = graph.ImportBuffer("Visibility", visibilityBuffer, { .stages = 0, .access = 0, .layout = VK_IMAGE_LAYOUT_UNDEFINED });
+			const RenderResource drawCommands = graph.ImportBuffer("DrawCommands", drawCommandBuffer, { .stages = 0, .access = 0, .layout = VK_IMAGE_LAYOUT_UNDEFINED });
+			const RenderResource counters = graph.ImportBuffer("CullingCounters", counterBuffer, { .stages = 0, .access = 0, .layout = VK_IMAGE_LAYOUT_UNDEFINED });
+
+			//Record clears the counters itself before the early phase
+			graph.AddPass(
+			{
+				.name = "EarlyCulling",
+				.accesses =
+				{
+					{ visibility, ResourceUsage::ComputeRead },
+					{ drawCommands, ResourceUsage::ComputeWrite },
+					{ counters, ResourceUsage::ComputeReadWrite }
+				},
+				.execute = [this, instanceCount](VkCommandBuffer commandBuffer)
+				{
+					cullingPass.Record(commandBuffer, OcclusionCullingPass::Phase::Early, cullingView, instanceCount);
+				}
+			});
+
+			graph.AddPass(
+			{
+				.name = "EarlyDepth",
+				.accesses =
+				{
+					{ drawCommands, ResourceUsage::IndirectRead },
+					{ counters, ResourceUsage::IndirectRead },
+					{ depthImage, ResourceUsage::DepthWrite }
+				},
+				.execute = [this](VkCommandBuffer commandBuffer)
+				{
+					VkClearValue clearValue{};
+					clearValue.depthStencil = { DepthBuffer::clearDepth, 0 };
+
+					VkRenderPassBeginInfo renderPassInfo
+					{
+						.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+						.renderPass = earlyDepthPass.Handle(),
+						.framebuffer = earlyDepthFramebuffer,
+						.renderArea = { .offset = { 0, 0 }, .extent = context.extent },
+						.clearValueCount = 1,
+						.pClearValues = &clearValue
+					};
+
+					vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+					BindDepthDraws(commandBuffer, earlyDepthPipeline);
+					cullingPass.RecordDraw(commandBuffer, OcclusionCullingPass::Phase::Early);
+					vkCmdEndRenderPass(commandBuffer);
+				}
+			});
+
+			graph.AddPass(
+			{
+				.name = "DepthPyramid",
+				.accesses = { { depthImage, ResourceUsage::ComputeSampled } },
+				.execute = [this](VkCommandBuffer commandBuffer) { depthPyramid.Record(commandBuffer); }
+			});
+
+			graph.AddPass(
+			{
+				.name = "LateCulling",
+				.accesses =
+				{
+					{ visibility, ResourceUsage::ComputeReadWrite },
+					{ drawCommands, ResourceUsage::ComputeReadWrite },
+					{ counters, ResourceUsage::ComputeReadWrite }
+				},
+				.execute = [this, instanceCount](VkCommandBuffer commandBuffer)
+				{
+					cullingPass.Record(commandBuffer, OcclusionCullingPass::Phase::Late, cullingView, instanceCount);
+				}
+			});
+
+			//The late draws complete the depth the early phase left behind, then color is shaded for both
+			graph.AddPass(
+			{
+				.name = "Forward",
+				.accesses =
+				{
+					{ drawCommands, ResourceUsage::IndirectRead },
+					{ counters, ResourceUsage::IndirectRead },
+					{ target, ResourceUsage::ColorWrite, context.targetLayout },
+					{ depthImage, ResourceUsage::DepthReadWrite }
+				},
+				.execute = [this](VkCommandBuffer commandBuffer)
+				{
+					VkClearValue clearValues[2]{};
+					clearValues[0].color = { 0.0f, 0.0f, 0.0f, 1.0f };
+
+					VkRenderPassBeginInfo renderPassInfo
+					{
+						.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+						.renderPass = forwardPass.Handle(),
+						.framebuffer = framebuffers[imageIndex],
+						.renderArea = { .offset = { 0, 0 }, .extent = context.extent },
+						.clearValueCount = static_cast<uint32_t>(std::size(clearValues)),
+						.pClearValues = clearValues
+					};
+
+					vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+					BindDepthDraws(commandBuffer, lateDepthPipeline);
+					cullingPass.RecordDraw(commandBuffer, OcclusionCullingPass::Phase::Late);
+
+					vkCmdNextSubpass(commandBuffer, VK_SUBPASS_CONTENTS_INLINE);
+					vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, colorPipeline);
+					cullingPass.RecordDraw(commandBuffer, OcclusionCullingPass::Phase::Early);
+					cullingPass.RecordDraw(commandBuffer, OcclusionCullingPass::Phase::Late);
+
+					vkCmdEndRenderPass(commandBuffer);
+				}
+			});
+
+			//Counters and both phases' draws, read once the frame's fence signaled
+			graph.AddPass(
+			{
+				.name = "CullingReadback",
+				.accesses = { { drawCommands, ResourceUsage::TransferRead }, { counters, ResourceUsage::TransferRead } },
+				.execute = [this, instanceCount](VkCommandBuffer commandBuffer)
+				{
+					cullingPass.RecordStatisticsCopy(commandBuffer, readbackBuffer);
+
+					const VkBufferCopy commandCopy{ .srcOffset = 0, .dstOffset = readbackCommandOffset, .size = 2 * sizeof(VkDrawIndexedIndirectCommand) * instanceCount };
+					vkCmdCopyBuffer(commandBuffer, drawCommandBuffer, readbackBuffer, 1, &commandCopy);
+
+					VkMemoryBarrier hostBarrier
+					{
+						.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+						.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+						.dstAccessMask = VK_ACCESS_HOST_READ_BIT
+					};
+					vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &hostBarrier, 0, nullptr, 0, nullptr);
+				},
+				.sideEffects = true
+			});
+		}
+
+		void Compiled(const RenderGraph& graph, const std::vector<VkImageView>& targetViews) override
+		{
+			const VkImageView depthView{ graph.View(depthImage) };
+			depthPyramid.BindDepth(depthView);
+
+			earlyDepthFramebuffer = CreateFramebuffer(device, earlyDepthPass.Handle(), context.extent, { depthView });
+			for (VkImageView targetView : targetViews)
+			{
+				framebuffers.push_back(CreateFramebuffer(device, forwardPass.Handle(), context.extent, { targetView, depthView }));
+			}
+		}
+
+		void Prepare(const BenchView& view, uint32_t targetImage) override
+		{
+			drawConstants.viewProjection = view.viewProjection;
+			cullingView = CullingView{ .view = view.view, .projection = view.projection, .zNear = benchZNear, .zFar = 0.0f };
+			imageIndex = targetImage;
+		}
+
+		void Collect(BenchMetrics& metrics) override
+		{
+			vmaInvalidateAllocation(context.allocator, readbackAllocation, 0, VK_WHOLE_SIZE);
+			const std::byte* readback{ static_cast<const std::byte*>(readbackInfo.pMappedData) };
+			const uint32_t instanceCount{ context.geometry.instanceCount };
+
+			OcclusionCullingStatistics statistics;
+			std::memcpy(&statistics, readback, sizeof(statistics));
+			const uint32_t earlyDrawCount{ std::min(statistics.earlyDrawCount, instanceCount) };
+			const uint32_t lateDrawCount{ std::min(statistics.lateDrawCount, instanceCount) };
+
+			const std::byte* commands{ readback + readbackCommandOffset };
+			const uint64_t triangleCount{ CountIndirectTriangles(commands, earlyDrawCount) +
+				CountIndirectTriangles(commands + sizeof(VkDrawIndexedIndirectCommand) * instanceCount, lateDrawCount) };
+
+			metrics.Add("draws", static_cast<double>(earlyDrawCount + lateDrawCount));
+			metrics.Add("triangles", static_cast<double>(triangleCount));
+
+			frustumCulledTotal += statistics.frustumCulledCount;
+			occlusionCulledTotal += statistics.occlusionCulledCount;
+			++measuredFrameCount;
+		}
+
+		void Report() const override
+		{
+			if (measuredFrameCount == 0)
+			{
+				return;
+			}
+
+			const double instances{ static_cast<double>(context.geometry.instanceCount) * static_cast<double>(measuredFrameCount) };
+			const double frustumCulled{ 100.0 * static_cast<double>(frustumCulledTotal) / instances };
+			const double occlusionCulled{ 100.0 * static_cast<double>(occlusionCulledTotal) / instances };
+			printf("  Hi-Z: %.1f%% of the instances culled on average, %.1f%% by the frustum and %.1f%% by occlusion\n",
+				frustumCulled + occlusionCulled, frustumCulled, occlusionCulled);
+		}
+
+	private:
+		//Counters first, the early draws behind them and the late draws instanceCount commands further
+		constexpr static VkDeviceSize readbackCommandOffset{ sizeof(OcclusionCullingStatistics) };
+
+		//Depth only, stored so the pyramid can be reduced from it and the forward pass can continue it
+		static RenderPass CreateEarlyDepthPass(const VkDevice device)
+		{
+			VkAttachmentDescription depthAttachment
+			{
+				.format = DepthBuffer::format,
+				.samples = VK_SAMPLE_COUNT_1_BIT,
+				.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+				.storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+				.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+				.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+				.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+				.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL
+			};
+
+			VkAttachmentReference depthAttachmentRef{ .attachment = 0, .layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
+
+			VkSubpassDescription depthSubpass
+			{
+				.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
+				.colorAttachmentCount = 0,
+				.pDepthStencilAttachment = &depthAttachmentRef
+			};
+
+			return RenderPass{ device, { depthAttachment }, { depthSubpass }, {} };
+		}
+
+		void BindDepthDraws(VkCommandBuffer commandBuffer, VkPipeline pipeline) const
+		{
+			const VkDeviceSize positionOffset{ 0 };
+
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+			vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(DrawConstants), &drawConstants);
+			vkCmdBindIndexBuffer(commandBuffer, context.geometry.indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+			vkCmdBindVertexBuffers(commandBuffer, 0, 1, &context.geometry.positionBuffer, &positionOffset);
+		}
+
+		const BenchContext& context;
+		const VkDevice device;
+
+		Shader cullShader;
+		Shader reduceShader;
+		Shader vertexShader;
+		Shader fragmentShader;
+		Shader prepassShader;
+		OcclusionCullingPass cullingPass;
+		DepthPyramid depthPyramid;
+		RenderPass earlyDepthPass;
+		RenderPass forwardPass;
+
+		VkBuffer visibilityBuffer;
+		VmaAllocation visibilityAllocation;
+		VkBuffer drawCommandBuffer;
+		VmaAllocation drawCommandAllocation;
+		VkBuffer counterBuffer;
+		VmaAllocation counterAllocation;
+		VkBuffer readbackBuffer;
+		VmaAllocation readbackAllocation;
+		VmaAllocationInfo readbackInfo;
+
+		VkPipelineLayout pipelineLayout;
+		VkPipeline earlyDepthPipeline;
+		VkPipeline lateDepthPipeline;
+		VkPipeline colorPipeline;
+		VkFramebuffer earlyDepthFramebuffer{ VK_NULL_HANDLE };
+		std::vector<VkFramebuffer> framebuffers;
+
+		RenderResource depthImage{};
+		DrawConstants drawConstants{};
+		CullingView cullingView{};
+		uint32_t imageIndex{ 0 };
+
+		uint64_t frustumCulledTotal{ 0 };
+		uint64_t occlusionCulledTotal{ 0 };
+		uint32_t measuredFrameCount{ 0 };
+	};
+
+	std::unique_ptr<BenchRenderer> CreateOcclusionRenderer(const BenchContext& context)
+	{
+		return std::make_unique<OcclusionRenderer>(context);
+	}
+}
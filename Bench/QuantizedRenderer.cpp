@@ -0,0 +1,197 @@
+#include "BenchRenderer.h"
+
+#include "GPU/GPUContext.h"
+#include "GPU/UploadStreamer.h"
+#include "Graphics/DepthBuffer.h"
+#include "Graphics/VertexQuantization.h"
+
+#include <assert.h>
+#include <cstdio>
+
+namespace cof
+{
+	class QuantizedRenderer : public BenchRenderer
+	{
+	public:
+		explicit QuantizedRenderer(const BenchContext& benchContext)
+			: context{ benchContext }
+			, device{ benchContext.gpuContext.LogicalDevice() }
+			, frustumDraws{ benchContext }
+			, vertexShader{ LoadBenchShader(benchContext, "QuantizedTriangle.vert.spv") }
+			, fragmentShader{ LoadBenchShader(benchContext, "VBufferTriangle.frag.spv") }
+			, prepassShader{ LoadBenchShader(benchContext, "DepthPrepass.vert.spv") }
+			, forwardPass{ CreateForwardRenderPass(device, benchContext.targetFormat, benchContext.targetLayout, VK_ATTACHMENT_LOAD_OP_CLEAR) }
+		{
+			const std::vector<UnlitColoredVertex>& vertices{ context.scene.vertices };
+
+			QuantizationError error{};
+			const std::vector<QuantizedUnlitColoredVertex> quantizedVertices{ QuantizeVertices(vertices, transform, error) };
+			const std::vector<std::byte> positionBytes{ std::move(DeinterleaveVertices(quantizedVertices)[0]) };
+			error.Print("  Quantized vertices", vertices.size(), sizeof(UnlitColoredVertex), sizeof(QuantizedUnlitColoredVertex));
+
+			//Both renderers keep an interleaved buffer for the color pass and a position stream for the prepass
+			const size_t sourceBytes{ vertices.size() * (sizeof(UnlitColoredVertex) + sizeof(glm::vec3)) };
+			const size_t quantizedBytes{ vertices.size() * sizeof(QuantizedUnlitColoredVertex) + positionBytes.size() };
+			printf("  Vertex memory: %.2f -> %.2f MiB, %.2f MiB saved against forward\n", static_cast<double>(sourceBytes) / (1024.0 * 1024.0),
+				static_cast<double>(quantizedBytes) / (1024.0 * 1024.0), static_cast<double>(sourceBytes - quantizedBytes) / (1024.0 * 1024.0));
+
+			vertexBuffer = CreateBenchBuffer(context.allocator, sizeof(QuantizedUnlitColoredVertex) * quantizedVertices.size(),
+				VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_ONLY, vertexAllocation);
+			positionBuffer = CreateBenchBuffer(context.allocator, positionBytes.size(),
+				VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_ONLY, positionAllocation);
+
+			context.uploadStreamer.Enqueue(BufferUpload{ vertexBuffer, 0, AsBytes(quantizedVertices), VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT }, UploadPriority::Visible);
+			context.uploadStreamer.Enqueue(BufferUpload{ positionBuffer, 0, positionBytes, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT }, UploadPriority::Visible);
+
+			pipelineLayout = CreateBenchPipelineLayout(device, {}, VK_SHADER_STAGE_VERTEX_BIT, sizeof(glm::mat4));
+
+			prepassPipeline = CreateBenchPipeline(device, context.extent,
+			{
+				.stages = { ShaderStage(VK_SHADER_STAGE_VERTEX_BIT, prepassShader) },
+				.vertexInput = VertexLayout<QuantizedUnlitColoredVertex, VertexStreams::Deinterleaved, 1>::InputState(),
+				.layout = pipelineLayout,
+				.renderPass = forwardPass.Handle(),
+				.subpass = 0,
+				.colorAttachmentCount = 0,
+				.depthWrite = VK_TRUE,
+				.depthCompareOp = DepthBuffer::compareOp
+			});
+
+			colorPipeline = CreateBenchPipeline(device, context.extent,
+			{
+				.stages = { ShaderStage(VK_SHADER_STAGE_VERTEX_BIT, vertexShader), ShaderStage(VK_SHADER_STAGE_FRAGMENT_BIT, fragmentShader) },
+				.vertexInput = VertexLayout<QuantizedUnlitColoredVertex>::InputState(),
+				.layout = pipelineLayout,
+				.renderPass = forwardPass.Handle(),
+				.subpass = 1,
+				.colorAttachmentCount = 1,
+				.depthWrite = VK_FALSE,
+				.depthCompareOp = VK_COMPARE_OP_EQUAL
+			});
+		}
+
+		~QuantizedRenderer() override
+		{
+			for (VkFramebuffer framebuffer : framebuffers)
+			{
+				vkDestroyFramebuffer(device, framebuffer, nullptr);
+			}
+			vkDestroyPipeline(device, colorPipeline, nullptr);
+			vkDestroyPipeline(device, prepassPipeline, nullptr);
+			vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+
+			vmaDestroyBuffer(context.allocator, positionBuffer, positionAllocation);
+			vmaDestroyBuffer(context.allocator, vertexBuffer, vertexAllocation);
+		}
+
+		QuantizedRenderer(const QuantizedRenderer& other) = delete;
+		QuantizedRenderer& operator=(const QuantizedRenderer& other) = delete;
+		QuantizedRenderer(QuantizedRenderer&& other) = delete;
+		QuantizedRenderer& operator=(QuantizedRenderer&& other) = delete;
+
+		void AddPasses(RenderGraph& graph, RenderResource target) override
+		{
+			depthImage = graph.CreateImage("Depth", { DepthBuffer::format, context.extent, VK_IMAGE_ASPECT_DEPTH_BIT });
+			frustumDraws.AddCullingPasses(graph);
+
+			graph.AddPass(
+			{
+				.name = "Forward",
+				.accesses =
+				{
+					{ frustumDraws.DrawCommands(), ResourceUsage::IndirectRead },
+					{ frustumDraws.DrawCount(), ResourceUsage::IndirectRead },
+					{ target, ResourceUsage::ColorWrite, context.targetLayout },
+					{ depthImage, ResourceUsage::DepthWrite }
+				},
+				.execute = [this](VkCommandBuffer commandBuffer)
+				{
+					VkClearValue clearValues[2]{};
+					clearValues[0].color = { 0.0f, 0.0f, 0.0f, 1.0f };
+					clearValues[1].depthStencil = { DepthBuffer::clearDepth, 0 };
+
+					VkRenderPassBeginInfo renderPassInfo
+					{
+						.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+						.renderPass = forwardPass.Handle(),
+						.framebuffer = framebuffers[imageIndex],
+						.renderArea = { .offset = { 0, 0 }, .extent = context.extent },
+						.clearValueCount = static_cast<uint32_t>(std::size(clearValues)),
+						.pClearValues = clearValues
+					};
+
+					const VkDeviceSize vertexOffset{ 0 };
+
+					vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+					vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::mat4), &quantizedViewProjection);
+					vkCmdBindIndexBuffer(commandBuffer, context.geometry.indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+
+					vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, prepassPipeline);
+					vkCmdBindVertexBuffers(commandBuffer, 0, 1, &positionBuffer, &vertexOffset);
+					frustumDraws.RecordDraw(commandBuffer);
+
+					vkCmdNextSubpass(commandBuffer, VK_SUBPASS_CONTENTS_INLINE);
+					vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, colorPipeline);
+					vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer, &vertexOffset);
+					frustumDraws.RecordDraw(commandBuffer);
+
+					vkCmdEndRenderPass(commandBuffer);
+				}
+			});
+
+			frustumDraws.AddReadbackPass(graph);
+		}
+
+		void Compiled(const RenderGraph& graph, const std::vector<VkImageView>& targetViews) override
+		{
+			for (VkImageView targetView : targetViews)
+			{
+				framebuffers.push_back(CreateFramebuffer(device, forwardPass.Handle(), context.extent, { targetView, graph.View(depthImage) }));
+			}
+		}
+
+		void Prepare(const BenchView& view, uint32_t targetImage) override
+		{
+			//The scene's instances are already in world space, so the transform is the whole model matrix
+			quantizedViewProjection = view.viewProjection * transform.Matrix();
+			frustumDraws.Prepare(view.viewProjection);
+			imageIndex = targetImage;
+		}
+
+		void Collect(BenchMetrics& metrics) override
+		{
+			frustumDraws.Collect(metrics);
+		}
+
+	private:
+		const BenchContext& context;
+		const VkDevice device;
+
+		BenchFrustumDraws frustumDraws;
+		Shader vertexShader;
+		Shader fragmentShader;
+		Shader prepassShader;
+		RenderPass forwardPass;
+
+		//Quantized over the bounds of the whole scene, one transform for every instance
+		QuantizationTransform transform{};
+		VkBuffer vertexBuffer;
+		VmaAllocation vertexAllocation;
+		VkBuffer positionBuffer;
+		VmaAllocation positionAllocation;
+
+		VkPipelineLayout pipelineLayout;
+		VkPipeline prepassPipeline;
+		VkPipeline colorPipeline;
+		std::vector<VkFramebuffer> framebuffers;
+
+		RenderResource depthImage{};
+		glm::mat4 quantizedViewProjection{ 1.0f };
+		uint32_t imageIndex{ 0 };
+	};
+
+	std::unique_ptr<BenchRenderer> CreateQuantizedRenderer(const BenchContext& context)
+	{
+		return std::make_unique<QuantizedRenderer>(context);
+	}
+}
@@ -0,0 +1,227 @@
+#include "BenchRenderer.h"
+
+#include "GPU/GPUContext.h"
+#include "GPU/UploadStreamer.h"
+#include "Graphics/GeometryStreaming.h"
+#include "Graphics/MeshLod.h"
+#include "Graphics/VertexQuantization.h"
+#include "Graphics/VisibilityBuffer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+
+namespace cof
+{
+	//Same LOD chains and selection as LodRenderer
+	constexpr static float streamingMaxRelativeError{ 0.05f };
+	constexpr static float streamingMaxPixelError{ 1.0f };
+	//32 MiB of page slots besides the pinned ones, less than Sponza's finest LODs take, so the report shows evictions
+	constexpr static uint32_t streamedPageSlotCount{ 256 };
+	constexpr static uint32_t maxLoadingPages{ 32 };
+	//Upload bytes the streamed pages may take per frame
+	constexpr static VkDeviceSize pageUploadBudget{ 4 * 1024 * 1024 };
+
+	//Every instance of the scene cooked into cluster pages, in the order of GltfScene::drawInstances
+	static std::vector<CookedClusterMesh> CookScene(const GltfScene& scene)
+	{
+		const std::vector<glm::vec3> normals{ SceneNormals(scene) };
+
+		const std::chrono::steady_clock::time_point cookStart{ std::chrono::steady_clock::now() };
+		std::vector<CookedClusterMesh> meshes;
+		size_t pageCount{ 0 };
+		size_t pageBytes{ 0 };
+		for (const DrawInstance& drawInstance : scene.drawInstances)
+		{
+			const std::vector<uint32_t> indices(scene.indices.begin() + drawInstance.firstIndex, scene.indices.begin() + drawInstance.firstIndex + drawInstance.indexCount);
+			const uint32_t vertexCount{ *std::max_element(indices.begin(), indices.end()) + 1 };
+
+			std::vector<glm::vec3> positions(vertexCount);
+			std::vector<LitTexturedVertex> litVertices(vertexCount);
+			for (uint32_t vertex{}; vertex < vertexCount; ++vertex)
+			{
+				const size_t sceneVertex{ static_cast<size_t>(drawInstance.vertexOffset) + vertex };
+				positions[vertex] = scene.vertices[sceneVertex].position;
+				litVertices[vertex] = LitTexturedVertex
+				{
+					.position = positions[vertex],
+					.normal = normals[sceneVertex],
+					//Not read by any of the shaders, any unit vector quantizes
+					.tangent = glm::vec4{ 1.0f, 0.0f, 0.0f, 1.0f },
+					.texCoord = scene.texCoords[sceneVertex]
+				};
+			}
+
+			QuantizationTransform transform{};
+			QuantizationError error{};
+			const std::vector<QuantizedLitVertex> vertices{ QuantizeVertices(litVertices, transform, error) };
+			const LodChain chain{ BuildLodChain(indices, positions, streamingMaxRelativeError * drawInstance.boundingSphere.w) };
+
+			meshes.push_back(CookClusterPages(chain, vertices, positions, transform));
+			pageCount += meshes.back().pageData.size();
+			for (const std::vector<std::byte>& data : meshes.back().pageData)
+			{
+				pageBytes += data.size();
+			}
+		}
+
+		const std::chrono::duration<double, std::milli> cookTime{ std::chrono::steady_clock::now() - cookStart };
+		printf("  Cluster pages: %zu pages, %.1f MiB of %zu instances cooked in %.1f ms\n", pageCount,
+			static_cast<double>(pageBytes) / (1024.0 * 1024.0), scene.drawInstances.size(), cookTime.count());
+		return meshes;
+	}
+
+	//The coarsest LOD of every mesh stays resident, the slots on top of those are what the finer LODs stream through
+	static uint32_t PageSlotCount(const std::vector<CookedClusterMesh>& meshes)
+	{
+		uint32_t pinnedPages{ 0 };
+		for (const CookedClusterMesh& cooked : meshes)
+		{
+			const uint32_t coarsestLod{ cooked.mesh.LodCount() - 1 };
+			pinnedPages += cooked.mesh.lodFirstPages[coarsestLod + 1] - cooked.mesh.lodFirstPages[coarsestLod];
+		}
+		return pinnedPages + streamedPageSlotCount;
+	}
+
+	//Every instance is cooked into cluster pages at load, their data stays in memory in place of the files a game would
+	//stream from. Each frame GeometryStreamer picks the LODs, requests the missing pages and returns a draw per resident
+	//page, which the visibility buffer renders and resolves like VisibilityRenderer
+	class StreamingRenderer : public BenchRenderer
+	{
+	public:
+		explicit StreamingRenderer(const BenchContext& benchContext)
+			: context{ benchContext }
+			, device{ benchContext.gpuContext.LogicalDevice() }
+			, geometryVertexShader{ LoadBenchShader(benchContext, "VisibilityBuffer.vert.spv") }
+			, geometryFragmentShader{ LoadBenchShader(benchContext, "VisibilityBuffer.frag.spv") }
+			, classifyShader{ LoadBenchShader(benchContext, "VisibilityClassify.comp.spv") }
+			, resolveShader{ LoadBenchShader(benchContext, "VisibilityResolve.comp.spv") }
+			, visibilityBuffer{ device, benchContext.gpuContext.EnabledFeatures(), benchContext.allocator, benchContext.extent, { geometryVertexShader, geometryFragmentShader, classifyShader, resolveShader }, true }
+			, cookedMeshes{ CookScene(benchContext.scene) }
+			, geometryStreamer{ benchContext.gpuContext, benchContext.uploadStreamer, PageSlotCount(cookedMeshes), maxLoadingPages }
+		{
+			const GltfScene& scene{ context.scene };
+
+			//The scene's vertices are in world space already
+			std::vector<glm::vec4> materialColors;
+			std::vector<uint32_t> materialImages;
+			for (uint32_t instance{}; instance < cookedMeshes.size(); ++instance)
+			{
+				const uint32_t meshIndex{ geometryStreamer.AddMesh(std::move(cookedMeshes[instance].mesh), [this, instance](uint32_t pageIndex) { return cookedMeshes[instance].pageData[pageIndex]; }) };
+				geometryStreamer.AddInstance(meshIndex, glm::mat4{ 1.0f }, FindBenchMaterial(materialColors, materialImages, scene.baseColors[instance], scene.baseColorImages[instance]));
+			}
+			printf("  Page slots: %u of %u KiB, %u of them for the streamed LODs\n", geometryStreamer.Statistics().slotCount, clusterPageSize / 1024, streamedPageSlotCount);
+
+			std::vector<VisibilityMaterial> materials;
+			for (const glm::vec4& baseColor : materialColors)
+			{
+				materials.push_back(VisibilityMaterial{ baseColor });
+			}
+
+			materialBuffer = CreateBenchBuffer(context.allocator, sizeof(VisibilityMaterial) * materials.size(),
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_ONLY, materialAllocation);
+			context.uploadStreamer.Enqueue(BufferUpload{ materialBuffer, 0, AsBytes(materials), VK_ACCESS_SHADER_READ_BIT }, UploadPriority::Visible);
+
+			//Written by the CPU every frame, the previous frame has finished by then
+			drawBuffer = CreateBenchBuffer(context.allocator, sizeof(VisibilityDraw) * GeometryStreamer::maxDraws,
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, drawAllocation, &drawInfo);
+
+			visibilityBuffer.BindScene(drawBuffer, materialBuffer, static_cast<uint32_t>(materials.size()));
+		}
+
+		~StreamingRenderer() override
+		{
+			vmaDestroyBuffer(context.allocator, drawBuffer, drawAllocation);
+			vmaDestroyBuffer(context.allocator, materialBuffer, materialAllocation);
+		}
+
+		StreamingRenderer(const StreamingRenderer& other) = delete;
+		StreamingRenderer& operator=(const StreamingRenderer& other) = delete;
+		StreamingRenderer(StreamingRenderer&& other) = delete;
+		StreamingRenderer& operator=(StreamingRenderer&& other) = delete;
+
+		void AddPasses(RenderGraph& graph, RenderResource target) override
+		{
+			//Like VisibilityRenderer, the page buffer's uploads are acquired before the frame by RunScene
+			graph.AddPass(
+			{
+				.name = "StreamedVisibilityBuffer",
+				.accesses = { { target, ResourceUsage::TransferWrite } },
+				.execute = [this, &graph, target](VkCommandBuffer commandBuffer)
+				{
+					visibilityBuffer.RecordGeometry(commandBuffer, geometryStreamer.Buffer(), *draws, viewProjection);
+					visibilityBuffer.RecordResolve(commandBuffer, viewProjection, BenchVisibilityDraws::lightDirection, BenchVisibilityDraws::ambient);
+					RecordBlitToTarget(commandBuffer, visibilityBuffer.ShadedImage(), graph.Image(target), context.extent);
+				}
+			});
+		}
+
+		//Blits into the target image instead of rendering to it, no framebuffers needed
+		void Compiled(const RenderGraph&, const std::vector<VkImageView>&) override {}
+
+		void Prepare(const BenchView& view, uint32_t) override
+		{
+			//RunScene doesn't stream, the pages requested by Update are submitted here
+			const float projectionScale{ std::abs(view.projection[1][1]) * static_cast<float>(context.extent.height) * 0.5f };
+			draws = &geometryStreamer.Update(view.viewProjection, view.cameraPosition, projectionScale, streamingMaxPixelError);
+			context.uploadStreamer.Submit(pageUploadBudget);
+
+			frameTriangles = 0;
+			for (const VisibilityDraw& draw : *draws)
+			{
+				frameTriangles += draw.indexCount / 3;
+			}
+
+			std::memcpy(drawInfo.pMappedData, draws->data(), sizeof(VisibilityDraw) * draws->size());
+			vmaFlushAllocation(context.allocator, drawAllocation, 0, VK_WHOLE_SIZE);
+
+			viewProjection = ClockwiseViewProjection(view);
+		}
+
+		void Collect(BenchMetrics& metrics) override
+		{
+			const GeometryStreamingStatistics statistics{ geometryStreamer.Statistics() };
+			metrics.Add("draws", static_cast<double>(draws->size()));
+			metrics.Add("triangles", static_cast<double>(frameTriangles));
+			metrics.Add("residentPages", static_cast<double>(statistics.residentPages));
+			metrics.Add("fallbackInstances", static_cast<double>(statistics.fallbackInstances));
+			metrics.Add("droppedInstances", static_cast<double>(statistics.droppedInstances));
+		}
+
+		void Report() const override
+		{
+			printf("  ");
+			geometryStreamer.Statistics().Print();
+		}
+
+	private:
+		const BenchContext& context;
+		const VkDevice device;
+
+		Shader geometryVertexShader;
+		Shader geometryFragmentShader;
+		Shader classifyShader;
+		Shader resolveShader;
+		VisibilityBuffer visibilityBuffer;
+
+		//Cooked page data per instance, loadPage copies out of it. The metadata moved into the streamer
+		std::vector<CookedClusterMesh> cookedMeshes;
+		GeometryStreamer geometryStreamer;
+
+		VkBuffer materialBuffer;
+		VmaAllocation materialAllocation;
+		VkBuffer drawBuffer;
+		VmaAllocation drawAllocation;
+		VmaAllocationInfo drawInfo;
+
+		const std::vector<VisibilityDraw>* draws{ nullptr };
+		uint64_t frameTriangles{ 0 };
+		glm::mat4 viewProjection{ 1.0f };
+	};
+
+	std::unique_ptr<BenchRenderer> CreateStreamingRenderer(const BenchContext& context)
+	{
+		return std::make_unique<StreamingRenderer>(context);
+	}
+}
@@ -0,0 +1,350 @@
+#include "BenchRenderer.h"
+
+#include "GPU/GPUContext.h"
+#include "GPU/UploadStreamer.h"
+#include "Graphics/DepthBuffer.h"
+#include "Graphics/TextureStreaming.h"
+#include "Utils/Image.h"
+
+#include <array>
+#include <assert.h>
+#include <chrono>
+#include <cstdio>
+
+namespace cof
+{
+	//Matches TexturedConstants in TexturedForward.glsl
+	struct TexturedConstants
+	{
+		glm::mat4 viewProjection;
+		glm::vec4 lightDirection;
+		uint32_t drawIndex;
+	};
+
+	//About half of what Sponza's base color textures take with all their mips, so the report shows evictions
+	constexpr static VkDeviceSize textureBudget{ 64 * 1024 * 1024 };
+	//Upload bytes the streamed mips may take per frame
+	constexpr static VkDeviceSize uploadBudget{ 8 * 1024 * 1024 };
+
+	//The scene's base color textures decoded at load, with their mips built on the CPU
+	static std::vector<Image> LoadMipChain(const std::filesystem::path& path)
+	{
+		std::optional<Image> image{ path.empty() ? std::nullopt : LoadImageFile(path) };
+		if (!image)
+		{
+			if (!path.empty())
+			{
+				printf("  Couldn't decode %s, it's drawn white\n", path.string().c_str());
+			}
+			//Materials without a texture sample a white texel, so every material has a texture
+			image = Image{ .width = 1, .height = 1, .texels = std::vector<std::byte>(4, std::byte{ 0xff }) };
+		}
+
+		std::vector<Image> mips;
+		mips.push_back(std::move(*image));
+		while (mips.back().width > 1 || mips.back().height > 1)
+		{
+			mips.push_back(DownsampleImage(mips.back()));
+		}
+		return mips;
+	}
+
+	class TexturedRenderer : public BenchRenderer
+	{
+	public:
+		explicit TexturedRenderer(const BenchContext& benchContext)
+			: context{ benchContext }
+			, device{ benchContext.gpuContext.LogicalDevice() }
+			, visibilityDraws{ benchContext }
+			, vertexShader{ LoadBenchShader(benchContext, "TexturedForward.vert.spv") }
+			, fragmentShader{ LoadBenchShader(benchContext, "TexturedForward.frag.spv") }
+			, feedbackVertexShader{ LoadBenchShader(benchContext, "TextureFeedback.vert.spv") }
+			, feedbackFragmentShader{ LoadBenchShader(benchContext, "TextureFeedback.frag.spv") }
+			, feedbackPass{ device, benchContext.allocator, { feedbackVertexShader, feedbackFragmentShader }, benchContext.extent, static_cast<uint32_t>(visibilityDraws.MaterialColors().size()) }
+			, textureStreamer{ device, benchContext.allocator, benchContext.uploadStreamer, VisibilityBuffer::maxMaterialCount, textureBudget }
+			, forwardPass{ CreateForwardRenderPass(device, benchContext.targetFormat, benchContext.targetLayout, VK_ATTACHMENT_LOAD_OP_CLEAR) }
+		{
+			[[maybe_unused]] VkResult errorCode{ VK_RESULT_MAX_ENUM };
+
+			//Texture i belongs to material i, the feedback of the material drives its residency
+			const std::chrono::steady_clock::time_point decodeStart{ std::chrono::steady_clock::now() };
+			const std::vector<uint32_t>& materialImages{ visibilityDraws.MaterialImages() };
+			textureMips.reserve(materialImages.size());
+			for (uint32_t material{}; material < materialImages.size(); ++material)
+			{
+				const uint32_t image{ materialImages[material] };
+				textureMips.push_back(LoadMipChain(image != GltfScene::noImage ? context.scene.images[image] : std::filesystem::path{}));
+				decodedCount += image != GltfScene::noImage ? 1 : 0;
+			}
+			decodeMilliseconds = std::chrono::duration<double, std::milli>{ std::chrono::steady_clock::now() - decodeStart }.count();
+
+			for (uint32_t material{}; material < textureMips.size(); ++material)
+			{
+				const Image& full{ textureMips[material].front() };
+				[[maybe_unused]] const uint32_t textureIndex{ textureStreamer.AddTexture(StreamedTextureInfo
+				{
+					.format = VK_FORMAT_R8G8B8A8_SRGB,
+					.extent = { full.width, full.height },
+					.mipCount = static_cast<uint32_t>(textureMips[material].size()),
+					.materialIndex = material,
+					.loadMip = [this, material](uint32_t mipLevel) { return textureMips[material][mipLevel].texels; }
+				}) };
+				assert(textureIndex == material);
+			}
+
+			const std::vector<glm::vec4>& materialColors{ visibilityDraws.MaterialColors() };
+			materialBuffer = CreateBenchBuffer(context.allocator, sizeof(glm::vec4) * materialColors.size(),
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_ONLY, materialAllocation);
+			context.uploadStreamer.Enqueue(BufferUpload{ materialBuffer, 0, AsBytes(materialColors), VK_ACCESS_SHADER_READ_BIT }, UploadPriority::Visible);
+
+			feedbackPass.BindScene(visibilityDraws.DrawBuffer());
+
+			std::array bindings
+			{
+				VkDescriptorSetLayoutBinding{ .binding = 0, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_VERTEX_BIT },
+				VkDescriptorSetLayoutBinding{ .binding = 1, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT }
+			};
+
+			VkDescriptorSetLayoutCreateInfo descriptorSetLayoutInfo
+			{
+				.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+				.bindingCount = static_cast<uint32_t>(bindings.size()),
+				.pBindings = bindings.data()
+			};
+
+			errorCode = vkCreateDescriptorSetLayout(device, &descriptorSetLayoutInfo, nullptr, &sceneSetLayout);
+			assert(errorCode == VK_SUCCESS);
+
+			VkDescriptorPoolSize poolSize{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, static_cast<uint32_t>(bindings.size()) };
+
+			VkDescriptorPoolCreateInfo descriptorPoolInfo
+			{
+				.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+				.maxSets = 1,
+				.poolSizeCount = 1,
+				.pPoolSizes = &poolSize
+			};
+
+			errorCode = vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool);
+			assert(errorCode == VK_SUCCESS);
+
+			VkDescriptorSetAllocateInfo descriptorSetInfo
+			{
+				.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+				.descriptorPool = descriptorPool,
+				.descriptorSetCount = 1,
+				.pSetLayouts = &sceneSetLayout
+			};
+
+			errorCode = vkAllocateDescriptorSets(device, &descriptorSetInfo, &sceneSet);
+			assert(errorCode == VK_SUCCESS);
+
+			const VkDescriptorBufferInfo drawBufferInfo{ visibilityDraws.DrawBuffer(), 0, VK_WHOLE_SIZE };
+			const VkDescriptorBufferInfo materialBufferInfo{ materialBuffer, 0, VK_WHOLE_SIZE };
+			std::array descriptorWrites
+			{
+				VkWriteDescriptorSet{ .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, .dstSet = sceneSet, .dstBinding = 0, .descriptorCount = 1, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .pBufferInfo = &drawBufferInfo },
+				VkWriteDescriptorSet{ .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, .dstSet = sceneSet, .dstBinding = 1, .descriptorCount = 1, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .pBufferInfo = &materialBufferInfo }
+			};
+
+			vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+
+			pipelineLayout = CreateBenchPipelineLayout(device, { sceneSetLayout, textureStreamer.DescriptorSetLayout() },
+				VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(TexturedConstants));
+
+			prepassPipeline = CreateBenchPipeline(device, context.extent,
+			{
+				.stages = { ShaderStage(VK_SHADER_STAGE_VERTEX_BIT, vertexShader) },
+				.layout = pipelineLayout,
+				.renderPass = forwardPass.Handle(),
+				.subpass = 0,
+				.colorAttachmentCount = 0,
+				.depthWrite = VK_TRUE,
+				.depthCompareOp = DepthBuffer::compareOp
+			});
+
+			colorPipeline = CreateBenchPipeline(device, context.extent,
+			{
+				.stages = { ShaderStage(VK_SHADER_STAGE_VERTEX_BIT, vertexShader), ShaderStage(VK_SHADER_STAGE_FRAGMENT_BIT, fragmentShader) },
+				.layout = pipelineLayout,
+				.renderPass = forwardPass.Handle(),
+				.subpass = 1,
+				.colorAttachmentCount = 1,
+				.depthWrite = VK_FALSE,
+				.depthCompareOp = VK_COMPARE_OP_EQUAL
+			});
+
+			const TextureStreamingStatistics statistics{ textureStreamer.Statistics() };
+			printf("  Textures: %u of %zu materials decoded in %.1f ms, %.1f MiB with all mips\n", decodedCount, textureMips.size(), decodeMilliseconds,
+				static_cast<double>(statistics.fullBytes) / (1024.0 * 1024.0));
+		}
+
+		~TexturedRenderer() override
+		{
+			for (VkFramebuffer framebuffer : framebuffers)
+			{
+				vkDestroyFramebuffer(device, framebuffer, nullptr);
+			}
+			vkDestroyPipeline(device, colorPipeline, nullptr);
+			vkDestroyPipeline(device, prepassPipeline, nullptr);
+			vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+			vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+			vkDestroyDescriptorSetLayout(device, sceneSetLayout, nullptr);
+
+			vmaDestroyBuffer(context.allocator, materialBuffer, materialAllocation);
+		}
+
+		TexturedRenderer(const TexturedRenderer& other) = delete;
+		TexturedRenderer& operator=(const TexturedRenderer& other) = delete;
+		TexturedRenderer(TexturedRenderer&& other) = delete;
+		TexturedRenderer& operator=(TexturedRenderer&& other) = delete;
+
+		void AddPasses(RenderGraph& graph, RenderResource target) override
+		{
+			depthImage = graph.CreateImage("Depth", { DepthBuffer::format, context.extent, VK_IMAGE_ASPECT_DEPTH_BIT });
+
+			//The feedback pass synchronizes its buffers itself and renders without attachments, so it shares the pass
+			graph.AddPass(
+			{
+				.name = "Textured",
+				.accesses =
+				{
+					{ target, ResourceUsage::ColorWrite, context.targetLayout },
+					{ depthImage, ResourceUsage::DepthWrite }
+				},
+				.execute = [this](VkCommandBuffer commandBuffer)
+				{
+					feedbackPass.Record(commandBuffer, visibilityDraws.IndexBuffer(), visibilityDraws.Draws(), feedbackViewProjection);
+
+					VkClearValue clearValues[2]{};
+					clearValues[0].color = { 0.0f, 0.0f, 0.0f, 1.0f };
+					clearValues[1].depthStencil = { DepthBuffer::clearDepth, 0 };
+
+					VkRenderPassBeginInfo renderPassInfo
+					{
+						.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+						.renderPass = forwardPass.Handle(),
+						.framebuffer = framebuffers[imageIndex],
+						.renderArea = { .offset = { 0, 0 }, .extent = context.extent },
+						.clearValueCount = static_cast<uint32_t>(std::size(clearValues)),
+						.pClearValues = clearValues
+					};
+
+					const VkDescriptorSet descriptorSets[2]{ sceneSet, textureStreamer.DescriptorSet() };
+
+					vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+					vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 2, descriptorSets, 0, nullptr);
+					vkCmdBindIndexBuffer(commandBuffer, visibilityDraws.IndexBuffer(), 0, VK_INDEX_TYPE_UINT32);
+
+					vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, prepassPipeline);
+					RecordDraws(commandBuffer);
+
+					vkCmdNextSubpass(commandBuffer, VK_SUBPASS_CONTENTS_INLINE);
+					vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, colorPipeline);
+					RecordDraws(commandBuffer);
+
+					vkCmdEndRenderPass(commandBuffer);
+				}
+			});
+		}
+
+		void Compiled(const RenderGraph& graph, const std::vector<VkImageView>& targetViews) override
+		{
+			for (VkImageView targetView : targetViews)
+			{
+				framebuffers.push_back(CreateFramebuffer(device, forwardPass.Handle(), context.extent, { targetView, graph.View(depthImage) }));
+			}
+		}
+
+		void Prepare(const BenchView& view, uint32_t targetImage) override
+		{
+			//RunScene doesn't stream, the mips the feedback asks for are submitted here
+			textureStreamer.Update(feedbackPass.Requests());
+			context.uploadStreamer.Submit(uploadBudget);
+
+			//The feedback pass is the library's, it culls clockwise back faces
+			viewProjection = view.viewProjection;
+			feedbackViewProjection = ClockwiseViewProjection(view);
+			visibilityDraws.Prepare(view.viewProjection);
+			imageIndex = targetImage;
+		}
+
+		void Collect(BenchMetrics& metrics) override
+		{
+			visibilityDraws.Collect(metrics);
+
+			const TextureStreamingStatistics statistics{ textureStreamer.Statistics() };
+			metrics.Add("textureResidentMiB", static_cast<double>(statistics.residentBytes) / (1024.0 * 1024.0));
+			metrics.Add("texturesStreaming", static_cast<double>(statistics.streamingCount));
+		}
+
+		void Report() const override
+		{
+			printf("  Texture streaming after the last frame: ");
+			textureStreamer.Statistics().Print();
+		}
+
+	private:
+		//Draws whose texture hasn't arrived yet are left out, only the first frames have any
+		void RecordDraws(VkCommandBuffer commandBuffer) const
+		{
+			TexturedConstants constants
+			{
+				.viewProjection = viewProjection,
+				.lightDirection = glm::vec4{ BenchVisibilityDraws::lightDirection, BenchVisibilityDraws::ambient }
+			};
+
+			const std::vector<VisibilityDraw>& draws{ visibilityDraws.Draws() };
+			for (uint32_t drawIndex{}; drawIndex < draws.size(); ++drawIndex)
+			{
+				if (!textureStreamer.Sampleable(draws[drawIndex].materialIndex))
+				{
+					continue;
+				}
+
+				constants.drawIndex = drawIndex;
+				vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(TexturedConstants), &constants);
+				vkCmdDrawIndexed(commandBuffer, draws[drawIndex].indexCount, 1, draws[drawIndex].firstIndex, 0, 0);
+			}
+		}
+
+		const BenchContext& context;
+		const VkDevice device;
+
+		BenchVisibilityDraws visibilityDraws;
+		Shader vertexShader;
+		Shader fragmentShader;
+		Shader feedbackVertexShader;
+		Shader feedbackFragmentShader;
+		TextureFeedbackPass feedbackPass;
+		//Every texture's mips, finest first, loadMip copies out of them. Declared before textureStreamer, whose streaming
+		//thread reads them until it's destroyed
+		std::vector<std::vector<Image>> textureMips;
+		TextureStreamer textureStreamer;
+		RenderPass forwardPass;
+
+		uint32_t decodedCount{ 0 };
+		double decodeMilliseconds{ 0.0 };
+
+		VkBuffer materialBuffer;
+		VmaAllocation materialAllocation;
+		VkDescriptorSetLayout sceneSetLayout;
+		VkDescriptorPool descriptorPool;
+		VkDescriptorSet sceneSet;
+
+		VkPipelineLayout pipelineLayout;
+		VkPipeline prepassPipeline;
+		VkPipeline colorPipeline;
+		std::vector<VkFramebuffer> framebuffers;
+
+		RenderResource depthImage{};
+		glm::mat4 viewProjection{ 1.0f };
+		glm::mat4 feedbackViewProjection{ 1.0f };
+		uint32_t imageIndex{ 0 };
+	};
+
+	std::unique_ptr<BenchRenderer> CreateTexturedRenderer(const BenchContext& context)
+	{
+		return std::make_unique<TexturedRenderer>(context);
+	}
+}
@@ -0,0 +1,406 @@
+#include "BenchRenderer.h"
+
+#include "GPU/GPUContext.h"
+#include "GPU/UploadStreamer.h"
+#include "Graphics/DepthBuffer.h"
+#include "Graphics/VirtualTexture.h"
+#include "Utils/Image.h"
+
+#include <array>
+#include <assert.h>
+#include <bit>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+namespace cof
+{
+	//Matches TexturedConstants in TexturedForward.glsl
+	struct VirtualTexturedConstants
+	{
+		glm::mat4 viewProjection;
+		glm::vec4 lightDirection;
+		uint32_t drawIndex;
+	};
+
+	//256 slots, a few of Sponza's 25 textures fully resident, so the report shows evictions
+	constexpr static uint32_t atlasPageCount{ 16 };
+	constexpr static uint32_t pageUploadsPerFrame{ 16 };
+
+	//Mips of the image down to a single page, empty when the image isn't square with a power of two multiple of
+	//VirtualTextureCache::pageSize texels on a side
+	static std::vector<Image> LoadVirtualMipChain(const std::filesystem::path& path)
+	{
+		std::optional<Image> image{ LoadImageFile(path) };
+		if (!image)
+		{
+			printf("  Couldn't decode %s, it's drawn without texture\n", path.string().c_str());
+			return {};
+		}
+
+		const uint32_t pageCount{ image->width / VirtualTextureCache::pageSize };
+		if (image->width != image->height || image->width % VirtualTextureCache::pageSize != 0 || !std::has_single_bit(pageCount)
+			|| pageCount > VirtualTextureCache::maxPageCount)
+		{
+			return {};
+		}
+
+		std::vector<Image> mips;
+		mips.push_back(std::move(*image));
+		while (mips.back().width > VirtualTextureCache::pageSize)
+		{
+			mips.push_back(DownsampleImage(mips.back()));
+		}
+		return mips;
+	}
+
+	//The page's texels and the border around it, which wraps around the edges like the texture coordinates do
+	static std::vector<std::byte> CutPage(const std::vector<Image>& mips, const VirtualPage& page)
+	{
+		const Image& mip{ mips[page.mip] };
+		const int64_t size{ mip.width };
+		const int64_t originX{ static_cast<int64_t>(page.x) * VirtualTextureCache::pageSize - VirtualTextureCache::pageBorder };
+		const int64_t originY{ static_cast<int64_t>(page.y) * VirtualTextureCache::pageSize - VirtualTextureCache::pageBorder };
+
+		std::vector<std::byte> texels(VirtualTextureCache::pageBytes);
+		for (uint32_t y{}; y < VirtualTextureCache::physicalPageSize; ++y)
+		{
+			const int64_t sourceY{ ((originY + y) % size + size) % size };
+			for (uint32_t x{}; x < VirtualTextureCache::physicalPageSize; ++x)
+			{
+				const int64_t sourceX{ ((originX + x) % size + size) % size };
+				std::memcpy(texels.data() + 4 * (static_cast<size_t>(y) * VirtualTextureCache::physicalPageSize + x), mip.texels.data() + 4 * (sourceY * size + sourceX), 4);
+			}
+		}
+		return texels;
+	}
+
+	class VirtualTextureRenderer : public BenchRenderer
+	{
+	public:
+		explicit VirtualTextureRenderer(const BenchContext& benchContext)
+			: context{ benchContext }
+			, device{ benchContext.gpuContext.LogicalDevice() }
+			, visibilityDraws{ benchContext }
+			, vertexShader{ LoadBenchShader(benchContext, "TexturedForward.vert.spv") }
+			, fragmentShader{ LoadBenchShader(benchContext, "VirtualTextured.frag.spv") }
+			, feedbackVertexShader{ LoadBenchShader(benchContext, "TextureFeedback.vert.spv") }
+			, feedbackFragmentShader{ LoadBenchShader(benchContext, "VirtualTextureFeedback.frag.spv") }
+			, feedbackPass{ device, benchContext.allocator, { feedbackVertexShader, feedbackFragmentShader }, benchContext.extent }
+			, forwardPass{ CreateForwardRenderPass(device, benchContext.targetFormat, benchContext.targetLayout, VK_ATTACHMENT_LOAD_OP_CLEAR) }
+			, textureCache{ device, benchContext.allocator, atlasPageCount, VisibilityBuffer::maxMaterialCount, pageUploadsPerFrame }
+		{
+			[[maybe_unused]] VkResult errorCode{ VK_RESULT_MAX_ENUM };
+
+			//Every mip chain is decoded before the first texture is added, the streaming thread cuts pages out of them
+			const std::chrono::steady_clock::time_point decodeStart{ std::chrono::steady_clock::now() };
+			const std::vector<uint32_t>& materialImages{ visibilityDraws.MaterialImages() };
+			materialTextureIndices.assign(materialImages.size(), noVirtualTexture);
+			for (uint32_t material{}; material < materialImages.size(); ++material)
+			{
+				if (materialImages[material] == GltfScene::noImage || context.scene.images[materialImages[material]].empty())
+				{
+					continue;
+				}
+
+				std::vector<Image> mips{ LoadVirtualMipChain(context.scene.images[materialImages[material]]) };
+				if (!mips.empty())
+				{
+					materialTextureIndices[material] = static_cast<uint32_t>(textureMips.size());
+					textureMips.push_back(std::move(mips));
+				}
+			}
+			decodeMilliseconds = std::chrono::duration<double, std::milli>{ std::chrono::steady_clock::now() - decodeStart }.count();
+
+			for (uint32_t texture{}; texture < textureMips.size(); ++texture)
+			{
+				[[maybe_unused]] const uint32_t textureIndex{ textureCache.AddTexture(VirtualTextureInfo
+				{
+					.extent = textureMips[texture].front().width,
+					.loadPage = [this, texture](const VirtualPage& page) { return CutPage(textureMips[texture], page); }
+				}) };
+				assert(textureIndex == texture);
+			}
+
+			std::vector<VirtualTextureMaterial> virtualMaterials;
+			for (const uint32_t texture : materialTextureIndices)
+			{
+				virtualMaterials.push_back(texture != noVirtualTexture ? textureCache.Material(texture)
+					: VirtualTextureMaterial{ .textureIndex = noVirtualTexture, .pageCount = 0, .mipCount = 0, .padding = 0 });
+			}
+
+			const std::vector<glm::vec4>& materialColors{ visibilityDraws.MaterialColors() };
+			materialBuffer = CreateBenchBuffer(context.allocator, sizeof(glm::vec4) * materialColors.size(),
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_ONLY, materialAllocation);
+			context.uploadStreamer.Enqueue(BufferUpload{ materialBuffer, 0, AsBytes(materialColors), VK_ACCESS_SHADER_READ_BIT }, UploadPriority::Visible);
+
+			virtualMaterialBuffer = CreateBenchBuffer(context.allocator, sizeof(VirtualTextureMaterial) * virtualMaterials.size(),
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_ONLY, virtualMaterialAllocation);
+			context.uploadStreamer.Enqueue(BufferUpload{ virtualMaterialBuffer, 0, AsBytes(virtualMaterials), VK_ACCESS_SHADER_READ_BIT }, UploadPriority::Visible);
+
+			feedbackPass.BindScene(visibilityDraws.DrawBuffer(), virtualMaterialBuffer);
+
+			std::array bindings
+			{
+				VkDescriptorSetLayoutBinding{ .binding = 0, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_VERTEX_BIT },
+				VkDescriptorSetLayoutBinding{ .binding = 1, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT },
+				VkDescriptorSetLayoutBinding{ .binding = 2, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT }
+			};
+
+			VkDescriptorSetLayoutCreateInfo descriptorSetLayoutInfo
+			{
+				.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+				.bindingCount = static_cast<uint32_t>(bindings.size()),
+				.pBindings = bindings.data()
+			};
+
+			errorCode = vkCreateDescriptorSetLayout(device, &descriptorSetLayoutInfo, nullptr, &sceneSetLayout);
+			assert(errorCode == VK_SUCCESS);
+
+			VkDescriptorPoolSize poolSize{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, static_cast<uint32_t>(bindings.size()) };
+
+			VkDescriptorPoolCreateInfo descriptorPoolInfo
+			{
+				.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+				.maxSets = 1,
+				.poolSizeCount = 1,
+				.pPoolSizes = &poolSize
+			};
+
+			errorCode = vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool);
+			assert(errorCode == VK_SUCCESS);
+
+			VkDescriptorSetAllocateInfo descriptorSetInfo
+			{
+				.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+				.descriptorPool = descriptorPool,
+				.descriptorSetCount = 1,
+				.pSetLayouts = &sceneSetLayout
+			};
+
+			errorCode = vkAllocateDescriptorSets(device, &descriptorSetInfo, &sceneSet);
+			assert(errorCode == VK_SUCCESS);
+
+			const VkDescriptorBufferInfo drawBufferInfo{ visibilityDraws.DrawBuffer(), 0, VK_WHOLE_SIZE };
+			const VkDescriptorBufferInfo materialBufferInfo{ materialBuffer, 0, VK_WHOLE_SIZE };
+			const VkDescriptorBufferInfo virtualMaterialBufferInfo{ virtualMaterialBuffer, 0, VK_WHOLE_SIZE };
+			std::array descriptorWrites
+			{
+				VkWriteDescriptorSet{ .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, .dstSet = sceneSet, .dstBinding = 0, .descriptorCount = 1, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .pBufferInfo = &drawBufferInfo },
+				VkWriteDescriptorSet{ .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, .dstSet = sceneSet, .dstBinding = 1, .descriptorCount = 1, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .pBufferInfo = &materialBufferInfo },
+				VkWriteDescriptorSet{ .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, .dstSet = sceneSet, .dstBinding = 2, .descriptorCount = 1, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .pBufferInfo = &virtualMaterialBufferInfo }
+			};
+
+			vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+
+			pipelineLayout = CreateBenchPipelineLayout(device, { sceneSetLayout, textureCache.DescriptorSetLayout() },
+				VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(VirtualTexturedConstants));
+
+			prepassPipeline = CreateBenchPipeline(device, context.extent,
+			{
+				.stages = { ShaderStage(VK_SHADER_STAGE_VERTEX_BIT, vertexShader) },
+				.layout = pipelineLayout,
+				.renderPass = forwardPass.Handle(),
+				.subpass = 0,
+				.colorAttachmentCount = 0,
+				.depthWrite = VK_TRUE,
+				.depthCompareOp = DepthBuffer::compareOp
+			});
+
+			colorPipeline = CreateBenchPipeline(device, context.extent,
+			{
+				.stages = { ShaderStage(VK_SHADER_STAGE_VERTEX_BIT, vertexShader), ShaderStage(VK_SHADER_STAGE_FRAGMENT_BIT, fragmentShader) },
+				.layout = pipelineLayout,
+				.renderPass = forwardPass.Handle(),
+				.subpass = 1,
+				.colorAttachmentCount = 1,
+				.depthWrite = VK_FALSE,
+				.depthCompareOp = VK_COMPARE_OP_EQUAL
+			});
+
+			const VirtualTextureStatistics statistics{ textureCache.Statistics() };
+			printf("  Virtual textures: %zu of %zu materials decoded in %.1f ms, %u atlas pages in %.1f MiB\n", textureMips.size(), materialImages.size(),
+				decodeMilliseconds, statistics.pageCapacity, static_cast<double>(statistics.atlasBytes) / (1024.0 * 1024.0));
+		}
+
+		~VirtualTextureRenderer() override
+		{
+			for (VkFramebuffer framebuffer : framebuffers)
+			{
+				vkDestroyFramebuffer(device, framebuffer, nullptr);
+			}
+			vkDestroyPipeline(device, colorPipeline, nullptr);
+			vkDestroyPipeline(device, prepassPipeline, nullptr);
+			vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+			vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+			vkDestroyDescriptorSetLayout(device, sceneSetLayout, nullptr);
+
+			vmaDestroyBuffer(context.allocator, virtualMaterialBuffer, virtualMaterialAllocation);
+			vmaDestroyBuffer(context.allocator, materialBuffer, materialAllocation);
+		}
+
+		VirtualTextureRenderer(const VirtualTextureRenderer& other) = delete;
+		VirtualTextureRenderer& operator=(const VirtualTextureRenderer& other) = delete;
+		VirtualTextureRenderer(VirtualTextureRenderer&& other) = delete;
+		VirtualTextureRenderer& operator=(VirtualTextureRenderer&& other) = delete;
+
+		void AddPasses(RenderGraph& graph, RenderResource target) override
+		{
+			depthImage = graph.CreateImage("Depth", { DepthBuffer::format, context.extent, VK_IMAGE_ASPECT_DEPTH_BIT });
+
+			//The feedback pass and the cache synchronize their resources themselves, so they share the pass
+			graph.AddPass(
+			{
+				.name = "Virtual textured",
+				.accesses =
+				{
+					{ target, ResourceUsage::ColorWrite, context.targetLayout },
+					{ depthImage, ResourceUsage::DepthWrite }
+				},
+				.execute = [this](VkCommandBuffer commandBuffer)
+				{
+					feedbackPass.Record(commandBuffer, visibilityDraws.IndexBuffer(), visibilityDraws.Draws(), feedbackViewProjection);
+					textureCache.RecordUploads(commandBuffer);
+
+					VkClearValue clearValues[2]{};
+					clearValues[0].color = { 0.0f, 0.0f, 0.0f, 1.0f };
+					clearValues[1].depthStencil = { DepthBuffer::clearDepth, 0 };
+
+					VkRenderPassBeginInfo renderPassInfo
+					{
+						.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+						.renderPass = forwardPass.Handle(),
+						.framebuffer = framebuffers[imageIndex],
+						.renderArea = { .offset = { 0, 0 }, .extent = context.extent },
+						.clearValueCount = static_cast<uint32_t>(std::size(clearValues)),
+						.pClearValues = clearValues
+					};
+
+					const VkDescriptorSet descriptorSets[2]{ sceneSet, textureCache.DescriptorSet() };
+
+					vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+					vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 2, descriptorSets, 0, nullptr);
+					vkCmdBindIndexBuffer(commandBuffer, visibilityDraws.IndexBuffer(), 0, VK_INDEX_TYPE_UINT32);
+
+					vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, prepassPipeline);
+					RecordDraws(commandBuffer);
+
+					vkCmdNextSubpass(commandBuffer, VK_SUBPASS_CONTENTS_INLINE);
+					vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, colorPipeline);
+					RecordDraws(commandBuffer);
+
+					vkCmdEndRenderPass(commandBuffer);
+				}
+			});
+		}
+
+		void Compiled(const RenderGraph& graph, const std::vector<VkImageView>& targetViews) override
+		{
+			for (VkImageView targetView : targetViews)
+			{
+				framebuffers.push_back(CreateFramebuffer(device, forwardPass.Handle(), context.extent, { targetView, graph.View(depthImage) }));
+			}
+		}
+
+		void Prepare(const BenchView& view, uint32_t targetImage) override
+		{
+			const VirtualTextureStatistics statistics{ textureCache.Statistics() };
+			textureCache.Update(feedbackPass.Requests());
+			const VirtualTextureStatistics updated{ textureCache.Statistics() };
+			frameRequests = updated.requestCount - statistics.requestCount;
+			frameHits = updated.hitCount - statistics.hitCount;
+
+			//The feedback pass is the library's, it culls clockwise back faces
+			viewProjection = view.viewProjection;
+			feedbackViewProjection = ClockwiseViewProjection(view);
+			visibilityDraws.Prepare(view.viewProjection);
+			imageIndex = targetImage;
+		}
+
+		void Collect(BenchMetrics& metrics) override
+		{
+			visibilityDraws.Collect(metrics);
+
+			const VirtualTextureStatistics statistics{ textureCache.Statistics() };
+			metrics.Add("virtualPagesResident", static_cast<double>(statistics.residentPages));
+			metrics.Add("virtualPageHitRate", frameRequests == 0 ? 1.0 : static_cast<double>(frameHits) / static_cast<double>(frameRequests));
+			metrics.Add("virtualUploadKiB", static_cast<double>(statistics.lastFrameUploadBytes) / 1024.0);
+		}
+
+		void Report() const override
+		{
+			printf("  Virtual texture cache after the last frame: ");
+			textureCache.Statistics().Print();
+		}
+
+	private:
+		//Draws whose texture has no indirection yet are left out, only the first frames have any
+		void RecordDraws(VkCommandBuffer commandBuffer) const
+		{
+			VirtualTexturedConstants constants
+			{
+				.viewProjection = viewProjection,
+				.lightDirection = glm::vec4{ BenchVisibilityDraws::lightDirection, BenchVisibilityDraws::ambient }
+			};
+
+			const std::vector<VisibilityDraw>& draws{ visibilityDraws.Draws() };
+			for (uint32_t drawIndex{}; drawIndex < draws.size(); ++drawIndex)
+			{
+				const uint32_t texture{ materialTextureIndices[draws[drawIndex].materialIndex] };
+				if (texture != noVirtualTexture && !textureCache.Sampleable(texture))
+				{
+					continue;
+				}
+
+				constants.drawIndex = drawIndex;
+				vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(VirtualTexturedConstants), &constants);
+				vkCmdDrawIndexed(commandBuffer, draws[drawIndex].indexCount, 1, draws[drawIndex].firstIndex, 0, 0);
+			}
+		}
+
+		const BenchContext& context;
+		const VkDevice device;
+
+		BenchVisibilityDraws visibilityDraws;
+		Shader vertexShader;
+		Shader fragmentShader;
+		Shader feedbackVertexShader;
+		Shader feedbackFragmentShader;
+		VirtualTextureFeedbackPass feedbackPass;
+		RenderPass forwardPass;
+
+		//Every virtual texture's mips down to a single page, finest first, loadPage cuts pages out of them
+		std::vector<std::vector<Image>> textureMips;
+		//Virtual texture per material or noVirtualTexture
+		std::vector<uint32_t> materialTextureIndices;
+		double decodeMilliseconds{ 0.0 };
+
+		//After textureMips, its destructor joins the streaming thread reading them
+		VirtualTextureCache textureCache;
+
+		VkBuffer materialBuffer;
+		VmaAllocation materialAllocation;
+		VkBuffer virtualMaterialBuffer;
+		VmaAllocation virtualMaterialAllocation;
+		VkDescriptorSetLayout sceneSetLayout;
+		VkDescriptorPool descriptorPool;
+		VkDescriptorSet sceneSet;
+
+		VkPipelineLayout pipelineLayout;
+		VkPipeline prepassPipeline;
+		VkPipeline colorPipeline;
+		std::vector<VkFramebuffer> framebuffers;
+
+		RenderResource depthImage{};
+		glm::mat4 viewProjection{ 1.0f };
+		glm::mat4 feedbackViewProjection{ 1.0f };
+		uint64_t frameRequests{ 0 };
+		uint64_t frameHits{ 0 };
+		uint32_t imageIndex{ 0 };
+	};
+
+	std::unique_ptr<BenchRenderer> CreateVirtualTextureRenderer(const BenchContext& context)
+	{
+		return std::make_unique<VirtualTextureRenderer>(context);
+	}
+}
@@ -0,0 +1,97 @@
+#include "BenchRenderer.h"
+
+#include "GPU/GPUContext.h"
+#include "GPU/UploadStreamer.h"
+#include "Graphics/VisibilityBuffer.h"
+
+namespace cof
+{
+	class VisibilityRenderer : public BenchRenderer
+	{
+	public:
+		explicit VisibilityRenderer(const BenchContext& benchContext)
+			: context{ benchContext }
+			, device{ benchContext.gpuContext.LogicalDevice() }
+			, visibilityDraws{ benchContext }
+			, geometryVertexShader{ LoadBenchShader(benchContext, "VisibilityBuffer.vert.spv") }
+			, geometryFragmentShader{ LoadBenchShader(benchContext, "VisibilityBuffer.frag.spv") }
+			, classifyShader{ LoadBenchShader(benchContext, "VisibilityClassify.comp.spv") }
+			, resolveShader{ LoadBenchShader(benchContext, "VisibilityResolve.comp.spv") }
+			, visibilityBuffer{ device, benchContext.gpuContext.EnabledFeatures(), benchContext.allocator, benchContext.extent, { geometryVertexShader, geometryFragmentShader, classifyShader, resolveShader }, true }
+		{
+			std::vector<VisibilityMaterial> materials;
+			for (const glm::vec4& baseColor : visibilityDraws.MaterialColors())
+			{
+				materials.push_back(VisibilityMaterial{ baseColor });
+			}
+
+			materialBuffer = CreateBenchBuffer(context.allocator, sizeof(VisibilityMaterial) * materials.size(),
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_ONLY, materialAllocation);
+			context.uploadStreamer.Enqueue(BufferUpload{ materialBuffer, 0, AsBytes(materials), VK_ACCESS_SHADER_READ_BIT }, UploadPriority::Visible);
+
+			visibilityBuffer.BindScene(visibilityDraws.DrawBuffer(), materialBuffer, static_cast<uint32_t>(materials.size()));
+		}
+
+		~VisibilityRenderer() override
+		{
+			vmaDestroyBuffer(context.allocator, materialBuffer, materialAllocation);
+		}
+
+		VisibilityRenderer(const VisibilityRenderer& other) = delete;
+		VisibilityRenderer& operator=(const VisibilityRenderer& other) = delete;
+		VisibilityRenderer(VisibilityRenderer&& other) = delete;
+		VisibilityRenderer& operator=(VisibilityRenderer&& other) = delete;
+
+		void AddPasses(RenderGraph& graph, RenderResource target) override
+		{
+			//The visibility buffer owns its images and synchronizes them itself, only the blit into the target goes through the graph.
+			//The graph swaps the image behind the target every frame, so it's looked up while recording
+			graph.AddPass(
+			{
+				.name = "VisibilityBuffer",
+				.accesses = { { target, ResourceUsage::TransferWrite } },
+				.execute = [this, &graph, target](VkCommandBuffer commandBuffer)
+				{
+					visibilityBuffer.RecordGeometry(commandBuffer, visibilityDraws.IndexBuffer(), visibilityDraws.Draws(), viewProjection);
+					visibilityBuffer.RecordResolve(commandBuffer, viewProjection, BenchVisibilityDraws::lightDirection, BenchVisibilityDraws::ambient);
+					RecordBlitToTarget(commandBuffer, visibilityBuffer.ShadedImage(), graph.Image(target), context.extent);
+				}
+			});
+		}
+
+		//Blits into the target image instead of rendering to it, no framebuffers needed
+		void Compiled(const RenderGraph&, const std::vector<VkImageView>&) override {}
+
+		void Prepare(const BenchView& view, uint32_t) override
+		{
+			//RecordGeometry draws every VisibilityDraw it's given, so they're culled on the CPU like LodRenderer does
+			viewProjection = ClockwiseViewProjection(view);
+			visibilityDraws.Prepare(view.viewProjection);
+		}
+
+		void Collect(BenchMetrics& metrics) override
+		{
+			visibilityDraws.Collect(metrics);
+		}
+
+	private:
+		const BenchContext& context;
+		const VkDevice device;
+
+		BenchVisibilityDraws visibilityDraws;
+		Shader geometryVertexShader;
+		Shader geometryFragmentShader;
+		Shader classifyShader;
+		Shader resolveShader;
+		VisibilityBuffer visibilityBuffer;
+
+		VkBuffer materialBuffer;
+		VmaAllocation materialAllocation;
+		glm::mat4 viewProjection{ 1.0f };
+	};
+
+	std::unique_ptr<BenchRenderer> CreateVisibilityRenderer(const BenchContext& context)
+	{
+		return std::make_unique<VisibilityRenderer>(context);
+	}
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <vulkan/vulkan_core.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace cof
+{
+	//Queue family ownership transfer of exclusive buffers. The release is recorded on the queue that wrote the buffers, the
+	//acquire with the same families on the queue that consumes them, after waiting on a semaphore the release's submit signals.
+	//Both are no-ops when the families match, the semaphore alone orders the queues then.
+	//Buffers whose contents are overwritten by their next owner don't need to be transferred back, a semaphore or fence suffices
+	void RecordBufferRelease(VkCommandBuffer commandBuffer,
+							 const std::vector<VkBuffer>& buffers,
+							 uint32_t srcQueueFamily,
+							 uint32_t dstQueueFamily,
+							 VkPipelineStageFlags srcStages,
+							 VkAccessFlags srcAccess);
+
+	void RecordBufferAcquire(VkCommandBuffer commandBuffer,
+							 const std::vector<VkBuffer>& buffers,
+							 uint32_t srcQueueFamily,
+							 uint32_t dstQueueFamily,
+							 VkPipelineStageFlags dstStages,
+							 VkAccessFlags dstAccess);
+
+	//Frames of graphics and compute submitted to different queues. Each queue's GPU time comes from a begin and end timestamp on
+	//that queue, but timestamps of different queues aren't guaranteed to share a clock, so the overlap is measured on the CPU:
+	//frames alternate between submitting compute while graphics runs and submitting it after graphics finished, timed from the
+	//graphics submit until both fences signaled
+	struct QueueOverlapSamples
+	{
+		double graphicsMilliseconds{ 0.0 };
+		double computeMilliseconds{ 0.0 };
+		uint32_t timestampFrames{ 0 };
+		double overlappedMilliseconds{ 0.0 };
+		uint32_t overlappedFrames{ 0 };
+		double serializedMilliseconds{ 0.0 };
+		uint32_t serializedFrames{ 0 };
+
+		//timestamps holds graphics begin, graphics end, compute begin and compute end, timestampPeriod comes from VkPhysicalDeviceLimits
+		void AddTimestamps(const uint64_t (&timestamps)[4], float timestampPeriod) noexcept;
+		void AddFrame(bool serialized, double wallMilliseconds) noexcept;
+	};
+
+	//Averages of QueueOverlapSamples
+	struct QueueOverlap
+	{
+		double graphicsMilliseconds;
+		double computeMilliseconds;
+		//Wall time of a frame with both queues in flight together
+		double overlappedMilliseconds;
+		//Wall time of a frame with compute submitted after graphics finished
+		double serializedMilliseconds;
+		//What running the queues back to back adds
+		double savedMilliseconds;
+
+		void Print() const;
+	};
+
+	QueueOverlap MeasureQueueOverlap(const QueueOverlapSamples& samples) noexcept;
+}
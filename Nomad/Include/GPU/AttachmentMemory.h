@@ -0,0 +1,28 @@
+#pragma once
+#include "GPU/vk_mem_alloc.h"
+
+#include <vulkan/vulkan_core.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace cof
+{
+	//Images with VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT go to lazily allocated memory when the device has it, tile based GPUs
+	//then never back them with physical pages. Everything else, and transient attachments on devices without lazily allocated
+	//memory, lands in regular device local memory. Returns whether the memory is lazily allocated
+	bool CreateAttachmentImage(VmaAllocator allocator, const VkImageCreateInfo& imageInfo, VkImage& image, VmaAllocation& allocation);
+
+	//An image sharing one allocation with others, it only needs its memory from the first to the last level that touches it
+	struct AliasedImage
+	{
+		VkDeviceSize size;
+		VkDeviceSize alignment;
+		uint32_t firstLevel;
+		uint32_t lastLevel;
+	};
+
+	//Greedy first fit from the largest image down, images with overlapping lifetimes never overlap in memory.
+	//Writes the offset of every image and returns the size of the allocation they fit in
+	VkDeviceSize PlaceAliasedImages(const std::vector<AliasedImage>& images, std::vector<VkDeviceSize>& offsets);
+}
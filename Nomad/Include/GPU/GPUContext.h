@@ -2,6 +2,7 @@
 #include <vulkan/vulkan_core.h>
 
 #include <cstdint>
+#include <limits>
 #include <vector>
 #include <assert.h>
 namespace cof
@@ -17,7 +18,8 @@ namespace cof
 		GPUContext(	const VkInstance instance, 
 					const uint64_t desiredFeaturesBitMask, 
 					const VkQueueFlags desiredQueueFamilies, 
-					const std::vector<const char*>& desiredExtensions);
+					const std::vector<const char*>& desiredExtensions,
+					const void* desiredFeatureChain = nullptr);
 		~GPUContext();
 		GPUContext(const GPUContext& other) = delete;
 		GPUContext& operator=(const GPUContext& other) = delete;
@@ -26,15 +28,28 @@ namespace cof
 
 		VkDevice LogicalDevice() const noexcept { return logicalDevice; }
 		VkPhysicalDevice PhysicalDevice() const noexcept { return physicalDevice; }
+		//The core features the logical device was created with
+		const VkPhysicalDeviceFeatures& EnabledFeatures() const noexcept { return enabledFeatures; }
 		const QueueFamilyIndices& QueueFamilyIndices() const noexcept { return queueFamilyIndices; }
 
 		template<VkQueueFlagBits QueueType>
 		uint32_t QueueFamilyIndex() const noexcept;
+
+		//First queue of the family, the compute queue is the graphics queue when no separate compute family was found
+		template<VkQueueFlagBits QueueType>
+		VkQueue Queue() const noexcept;
+
+		//Compute work can run concurrently with graphics work on a queue of its own
+		bool HasAsyncCompute() const noexcept
+		{
+			return queueFamilyIndices.compute != std::numeric_limits<uint32_t>::max() && queueFamilyIndices.compute != queueFamilyIndices.graphics;
+		}
 	
 	private:
 
 		VkDevice logicalDevice;
 		VkPhysicalDevice physicalDevice;
+		VkPhysicalDeviceFeatures enabledFeatures;
 
 		struct QueueFamilyIndices
 		{
@@ -44,6 +59,10 @@ namespace cof
 		} queueFamilyIndices;
 	};
 
+	//Bit n of a feature mask is the nth VkBool32 of VkPhysicalDeviceFeatures, in declaration order
+	uint64_t FeaturesBitMask(const VkPhysicalDeviceFeatures& features) noexcept;
+	VkPhysicalDeviceFeatures FeaturesFromBitMask(const uint64_t featuresBitMask) noexcept;
+
 	template<VkQueueFlagBits QueueType>
 	inline uint32_t GPUContext::QueueFamilyIndex() const noexcept
 	{
@@ -65,4 +84,22 @@ namespace cof
 			return std::numeric_limits<uint32_t>::max();
 		}
 	}
+
+	template<VkQueueFlagBits QueueType>
+	inline VkQueue GPUContext::Queue() const noexcept
+	{
+		uint32_t queueFamilyIndex{ QueueFamilyIndex<QueueType>() };
+		if constexpr (QueueType == VK_QUEUE_COMPUTE_BIT)
+		{
+			if (queueFamilyIndex == std::numeric_limits<uint32_t>::max())
+			{
+				queueFamilyIndex = queueFamilyIndices.graphics;
+			}
+		}
+		assert(queueFamilyIndex != std::numeric_limits<uint32_t>::max());
+
+		VkQueue queue;
+		vkGetDeviceQueue(logicalDevice, queueFamilyIndex, 0, &queue);
+		return queue;
+	}
 }
\ No newline at end of file
@@ -0,0 +1,38 @@
+#pragma once
+#include <vulkan/vulkan_core.h>
+
+namespace cof
+{
+	struct GPUContext;
+
+	//One device local buffer holding the vertices and indices of many meshes, shaders pull vertices from it through its device address.
+	//Needs the bufferDeviceAddress feature, the memory is allocated directly because VMA doesn't pass VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT yet
+	class GeometryBuffer
+	{
+	public:
+		GeometryBuffer(const cof::GPUContext& gpuContext, VkDeviceSize bufferCapacity);
+		~GeometryBuffer();
+
+		GeometryBuffer(const GeometryBuffer& other) = delete;
+		GeometryBuffer& operator=(const GeometryBuffer& other) = delete;
+		GeometryBuffer(GeometryBuffer&& other) = delete;
+		GeometryBuffer& operator=(GeometryBuffer&& other) = delete;
+
+		//Linear suballocation, returns the offset of the range. Filling it is up to the caller, e.g. with vkCmdCopyBuffer
+		VkDeviceSize Allocate(VkDeviceSize allocationSize, VkDeviceSize alignment = 16);
+
+		VkBuffer Handle() const noexcept { return handle; }
+		VkDeviceAddress DeviceAddress(VkDeviceSize offset = 0) const noexcept { return deviceAddress + offset; }
+		VkDeviceSize Capacity() const noexcept { return capacity; }
+		VkDeviceSize Size() const noexcept { return size; }
+
+	private:
+		VkBuffer handle;
+		VkDeviceMemory memory;
+		VkDeviceAddress deviceAddress;
+		VkDeviceSize capacity;
+		VkDeviceSize size{ 0 };
+
+		const VkDevice parent;
+	};
+}
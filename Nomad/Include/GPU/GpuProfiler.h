@@ -0,0 +1,195 @@
+#pragma once
+#include "Utils/CpuProfiler.h"
+
+#include <vulkan/vulkan_core.h>
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace cof
+{
+	//Counters of the pipeline statistics query a profiler scope collects, in the order Vulkan writes them
+	struct PipelineStatistics
+	{
+		uint64_t inputAssemblyVertices;
+		uint64_t inputAssemblyPrimitives;
+		uint64_t vertexShaderInvocations;
+		//Primitives reaching the clipper, after the primitives the vertex stages dropped
+		uint64_t clippingInvocations;
+		//Primitives leaving it, fewer when whole primitives are clipped away
+		uint64_t clippingPrimitives;
+		uint64_t fragmentShaderInvocations;
+		uint64_t computeShaderInvocations;
+
+		PipelineStatistics& operator+=(const PipelineStatistics& other) noexcept;
+	};
+
+	//Rolling GPU time of one scope over the frames in the profiler's history
+	struct GpuScopeTiming
+	{
+		std::string name;
+		//Index of the enclosing scope into GpuProfiler::Timings, noParent for scopes recorded outside any other
+		uint32_t parent;
+		uint32_t depth;
+		//Frames the scope was recorded in, counting all of them, not just the ones still in the history
+		uint64_t sampleCount;
+		double lastMilliseconds;
+		double averageMilliseconds;
+		double medianMilliseconds;
+		double p95Milliseconds;
+		double p99Milliseconds;
+		double maxMilliseconds;
+		//Including nested scopes, of the last frame read back. Zero unless the profiler collects pipeline statistics
+		PipelineStatistics lastStatistics;
+	};
+
+	//Hierarchical GPU timings from vkCmdWriteTimestamp pairs around scopes recorded in one queue family's command buffers.
+	//Every frame slot has a query pool of its own, BeginFrame reads back what the slot collected the last time it was used
+	//and resets the pool, so results are never waited on as long as the caller waited on that slot's fence before.
+	//A scope is identified by its name and the scope it's nested in, Timings lists them depth first in recording order.
+	//Without timestamp support on the queue family every call is a no-op.
+	//With pipelineStatistics, which needs the pipelineStatisticsQuery feature, every scope also runs a pipeline statistics
+	//query. Queries of one type can't nest, so a scope's query is paused while a nested scope runs and its segments are
+	//summed on readback. Scopes must begin and end outside render pass instances, or within one subpass
+	class GpuProfiler
+	{
+	public:
+		GpuProfiler(const VkDevice device, const VkPhysicalDevice physicalDevice, uint32_t queueFamilyIndex, uint32_t frameSlotCount, bool pipelineStatistics = false, uint32_t maxScopesPerFrame = 256);
+		~GpuProfiler();
+
+		GpuProfiler(const GpuProfiler& other) = delete;
+		GpuProfiler& operator=(const GpuProfiler& other) = delete;
+		GpuProfiler(GpuProfiler&& other) = delete;
+		GpuProfiler& operator=(GpuProfiler&& other) = delete;
+
+		//First command of the frame, the fence of the submit that last used frameSlot has to have signaled
+		void BeginFrame(VkCommandBuffer commandBuffer, uint32_t frameSlot);
+		//Scopes nest and have to be ended in the same frame, scopes beyond maxScopesPerFrame aren't timed
+		void BeginScope(VkCommandBuffer commandBuffer, std::string_view name, VkPipelineStageFlagBits stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+		void EndScope(VkCommandBuffer commandBuffer, VkPipelineStageFlagBits stage = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+		//Right after the frame's vkQueueSubmit, its scopes are placed on the CPU timeline of TraceEvents from there
+		void Submitted() noexcept;
+
+		bool Enabled() const noexcept { return timestampValidBits != 0; }
+		bool CollectsStatistics() const noexcept { return collectStatistics; }
+		const std::vector<GpuScopeTiming>& Timings();
+		//The timing tree with its rolling statistics
+		void Print();
+		//The pipeline statistics of the last frame per scope. Fragment invocations are divided by pixelCount as overdraw
+		void PrintStatistics(uint32_t pixelCount);
+		//Scopes of the last traceEventCapacity read back for WriteChromeTrace. GPU and CPU clocks aren't calibrated against
+		//each other, every frame is assumed to start executing when it was submitted, which holds while the queue is idle
+		std::vector<TraceEvent> TraceEvents() const { return { traceEvents.begin(), traceEvents.end() }; }
+
+		constexpr static uint32_t noParent{ 0xffffffff };
+		constexpr static uint32_t noScope{ 0xffffffff };
+		constexpr static uint32_t noQuery{ 0xffffffff };
+		//Frames the averages and percentiles are taken over
+		constexpr static uint32_t historyLength{ 256 };
+		constexpr static uint32_t traceEventCapacity{ 1 << 16 };
+
+	private:
+		struct RecordedScope
+		{
+			uint32_t node;
+			//Index into the slot's scopes, noScope for scopes recorded outside any other
+			uint32_t parentScope;
+			uint32_t beginQuery;
+			uint32_t endQuery;
+		};
+
+		//Stretch of a scope's pipeline statistics between its nested scopes, its query is its index into the slot's segments
+		struct StatisticsSegment
+		{
+			uint32_t scope;
+		};
+
+		struct OpenScope
+		{
+			uint32_t node;
+			//Index into the slot's scopes, noScope when the pool ran out of queries
+			uint32_t scope;
+		};
+
+		struct FrameSlot
+		{
+			VkQueryPool queryPool;
+			VkQueryPool statisticsPool;
+			std::vector<RecordedScope> scopes;
+			std::vector<StatisticsSegment> segments;
+			uint32_t queryCount{ 0 };
+			//CpuTicks when the frame was submitted, zero if Submitted wasn't called
+			uint64_t submitTicks{ 0 };
+		};
+
+		struct Node
+		{
+			std::string name;
+			uint32_t parent;
+			uint32_t depth;
+			//Ring of the last historyLength durations
+			std::vector<double> history;
+			uint64_t sampleCount{ 0 };
+			double lastMilliseconds{ 0.0 };
+			PipelineStatistics lastStatistics{};
+		};
+
+		void ReadBack(FrameSlot& slot);
+		void ReadBackStatistics(FrameSlot& slot);
+		uint32_t FindNode(uint32_t parentNode, std::string_view name);
+		void BeginSegment(VkCommandBuffer commandBuffer, uint32_t scope);
+		void EndSegment(VkCommandBuffer commandBuffer);
+
+		std::vector<FrameSlot> frameSlots;
+		std::vector<Node> nodes;
+		//Innermost last
+		std::vector<OpenScope> openScopes;
+		//Depth first order of nodes, rebuilt when nodes are added
+		std::vector<uint32_t> nodeOrder;
+		std::vector<GpuScopeTiming> timings;
+		std::vector<uint64_t> queryResults;
+		std::vector<PipelineStatistics> statisticsResults;
+		std::vector<PipelineStatistics> scopeStatistics;
+		std::vector<double> sortedHistory;
+		std::deque<TraceEvent> traceEvents;
+		FrameSlot* currentSlot{ nullptr };
+		//Statistics query recording in the current frame, noQuery when none is
+		uint32_t activeSegmentQuery{ noQuery };
+
+		uint32_t maxQueries;
+		uint32_t timestampValidBits;
+		double timestampPeriod;
+		bool collectStatistics;
+
+		const VkDevice parent;
+	};
+
+	//Times the lifetime of the object as a scope of profiler
+	class GpuProfileScope
+	{
+	public:
+		GpuProfileScope(GpuProfiler& gpuProfiler, VkCommandBuffer scopeCommandBuffer, std::string_view name)
+			: profiler{ gpuProfiler }
+			, commandBuffer{ scopeCommandBuffer }
+		{
+			profiler.BeginScope(commandBuffer, name);
+		}
+
+		~GpuProfileScope()
+		{
+			profiler.EndScope(commandBuffer);
+		}
+
+		GpuProfileScope(const GpuProfileScope& other) = delete;
+		GpuProfileScope& operator=(const GpuProfileScope& other) = delete;
+		GpuProfileScope(GpuProfileScope&& other) = delete;
+		GpuProfileScope& operator=(GpuProfileScope&& other) = delete;
+
+	private:
+		GpuProfiler& profiler;
+		VkCommandBuffer commandBuffer;
+	};
+}
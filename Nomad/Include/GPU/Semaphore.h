@@ -1,6 +1,8 @@
 #pragma once
 #include <vulkan/vulkan_core.h>
 
+#include <cstdint>
+
 namespace cof
 {
 	struct Semaphore
@@ -18,4 +20,27 @@ namespace cof
 		VkSemaphore handle;
 		const VkDevice parent;
 	};
+
+	//Requires the timelineSemaphore feature of Vulkan 1.2
+	struct TimelineSemaphore
+	{
+		TimelineSemaphore(VkDevice device, uint64_t initialValue = 0);
+		~TimelineSemaphore();
+
+		TimelineSemaphore(const TimelineSemaphore& other) = delete;
+		TimelineSemaphore& operator=(const TimelineSemaphore& other) = delete;
+		TimelineSemaphore(TimelineSemaphore&& other) = delete;
+		TimelineSemaphore& operator=(TimelineSemaphore&& other) = delete;
+
+		VkSemaphore Handle() const noexcept { return handle; }
+
+		//Highest value signaled so far
+		uint64_t Value() const;
+		//Returns false when the timeout passes first
+		bool Wait(uint64_t value, uint64_t timeout) const;
+
+	private:
+		VkSemaphore handle;
+		const VkDevice parent;
+	};
 }
\ No newline at end of file
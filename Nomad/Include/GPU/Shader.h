@@ -18,6 +18,8 @@ namespace cof
 		const VkDevice parent;
 	};
 
+	//Contents of a SPIR-V file, asserts the file can be opened
+	std::vector<std::byte> ReadShaderFile(const std::filesystem::path& shaderPath);
 	Shader LoadShader(std::filesystem::path&& shaderPath, const VkDevice device);
 	Shader LoadShader(const std::filesystem::path& shaderPath, const VkDevice device);
 }
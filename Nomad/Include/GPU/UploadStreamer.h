@@ -0,0 +1,167 @@
+#pragma once
+#include "GPU/CommandPool.h"
+#include "GPU/Semaphore.h"
+#include "GPU/vk_mem_alloc.h"
+
+#include <vulkan/vulkan_core.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <unordered_set>
+#include <vector>
+
+namespace cof
+{
+	struct GPUContext;
+
+	//Classes are served strictly in order, a class only gets the budget the classes above it leave over
+	enum class UploadPriority
+	{
+		//Needed by what's on screen right now
+		Visible,
+		//Likely needed within the next few frames
+		Prefetch,
+		//Scene loads and everything else that can take its time
+		Background
+	};
+
+	constexpr uint32_t uploadPriorityCount{ 3 };
+
+	using UploadTicket = uint64_t;
+
+	//dstAccess is how the consuming queue first uses the data
+	struct BufferUpload
+	{
+		VkBuffer buffer;
+		VkDeviceSize offset;
+		std::vector<std::byte> data;
+		VkAccessFlags dstAccess;
+	};
+
+	//Replaces the whole subresource region, the rest of the subresource is undefined afterwards
+	struct ImageUpload
+	{
+		VkImage image;
+		VkImageSubresourceLayers subresource;
+		VkOffset3D offset;
+		VkExtent3D extent;
+		//Tightly packed texels of the region
+		std::vector<std::byte> data;
+		VkImageLayout finalLayout;
+		VkAccessFlags dstAccess;
+	};
+
+	struct UploadStatistics
+	{
+		std::array<uint64_t, uploadPriorityCount> uploadedBytes;
+		std::array<uint64_t, uploadPriorityCount> queuedBytes;
+		uint64_t lastSubmitBytes;
+		uint32_t submitCount;
+		//Submits that stopped early because the staging ring was full rather than the budget spent
+		uint32_t stagingStallCount;
+
+		void Print() const;
+	};
+
+	//Owns the transfer queue and streams buffer and image data to the GPU through a persistently mapped staging ring.
+	//Every Submit records at most budget bytes of copies, so large loads spread over many frames instead of stalling one.
+	//Large buffer uploads are split over submits, an image region is copied in one go and may exceed the budget when it's
+	//the first copy of a submit. Submits signal a timeline semaphore, the consumer picks finished uploads up with
+	//RecordAcquires, which also takes them over from the transfer queue family
+	class UploadStreamer
+	{
+	public:
+		UploadStreamer(const cof::GPUContext& gpuContext, VmaAllocator allocator, uint32_t consumerFamily, VkDeviceSize stagingSize);
+		~UploadStreamer();
+
+		UploadStreamer(const UploadStreamer& other) = delete;
+		UploadStreamer& operator=(const UploadStreamer& other) = delete;
+		UploadStreamer(UploadStreamer&& other) = delete;
+		UploadStreamer& operator=(UploadStreamer&& other) = delete;
+
+		UploadTicket Enqueue(BufferUpload upload, UploadPriority priority);
+		UploadTicket Enqueue(ImageUpload upload, UploadPriority priority);
+
+		//Records and submits up to budget bytes of queued copies, once per frame
+		void Submit(VkDeviceSize budget);
+		//Submits everything queued regardless of budget and waits for it, e.g. behind a loading screen.
+		//The consumer still has to pick the uploads up with RecordAcquires
+		void Flush();
+
+		//Records the acquire barriers of every upload the transfer queue has finished and returns the timeline value the
+		//submit of commandBuffer has to wait on at VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, zero when nothing was acquired.
+		//The value has already been reached, so the wait never stalls
+		uint64_t RecordAcquires(VkCommandBuffer commandBuffer);
+		//Whether the upload has been acquired, i.e. its data may be used by command buffers recorded from now on
+		bool Completed(UploadTicket ticket) const noexcept;
+
+		VkSemaphore Semaphore() const noexcept { return timeline.Handle(); }
+		const UploadStatistics& Statistics() const noexcept { return statistics; }
+
+		//Copies into images at offsets aligned to this, covers every texel block size
+		constexpr static VkDeviceSize stagingAlignment{ 16 };
+
+	private:
+		struct Upload
+		{
+			UploadTicket ticket;
+			bool image;
+			BufferUpload buffer;
+			ImageUpload texture;
+			//Bytes of a buffer upload already copied
+			VkDeviceSize progress;
+		};
+
+		struct Batch
+		{
+			uint64_t value;
+			//Returned to the free list once the batch is done, its staging memory along with it
+			VkCommandBuffer commandBuffer;
+			//Staging memory of the batch including what wrapping around the ring skipped
+			VkDeviceSize stagingBytes;
+			std::vector<VkBufferMemoryBarrier> bufferAcquires;
+			std::vector<VkImageMemoryBarrier> imageAcquires;
+			std::vector<UploadTicket> finishedTickets;
+		};
+
+		//Returns noStaging when the ring has no contiguous block of size left
+		VkDeviceSize AllocateStaging(VkDeviceSize size) noexcept;
+		void RetireBatches();
+		//Bytes copied, zero when the upload doesn't fit in what's left of the budget or the staging ring
+		VkDeviceSize RecordUpload(Upload& upload, Batch& batch, VkDeviceSize budget, bool firstCopy);
+		uint64_t QueuedBytes() const noexcept;
+
+		constexpr static VkDeviceSize noStaging{ ~VkDeviceSize{ 0 } };
+
+		std::array<std::deque<Upload>, uploadPriorityCount> queues;
+		//Submitted batches in submit order, still owning their staging memory or waiting to be acquired
+		std::deque<Batch> batches;
+		std::vector<VkCommandBuffer> freeCommandBuffers;
+		std::unordered_set<UploadTicket> pendingTickets;
+		std::vector<VkBufferMemoryBarrier> bufferReleases;
+		std::vector<VkImageMemoryBarrier> imageReleases;
+
+		VkBuffer stagingBuffer;
+		VmaAllocation stagingAllocation;
+		std::byte* stagingData;
+		VkDeviceSize stagingCapacity;
+		VkDeviceSize stagingHead{ 0 };
+		VkDeviceSize stagingTail{ 0 };
+		VkDeviceSize stagingUsed{ 0 };
+
+		CommandPool<VK_QUEUE_TRANSFER_BIT> commandPool;
+		TimelineSemaphore timeline;
+		VkQueue queue;
+		uint32_t transferQueueFamily;
+		uint32_t consumerQueueFamily;
+
+		UploadTicket nextTicket{ 1 };
+		uint64_t nextValue{ 1 };
+		UploadStatistics statistics{};
+
+		const VkDevice parent;
+		const VmaAllocator memoryAllocator;
+	};
+}
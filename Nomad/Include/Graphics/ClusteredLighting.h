@@ -0,0 +1,145 @@
+#pragma once
+#include "GPU/vk_mem_alloc.h"
+
+#include <vulkan/vulkan_core.h>
+#include <glm/ext/matrix_float4x4.hpp>
+#include <glm/ext/vector_float3.hpp>
+
+#include <cstdint>
+#include <vector>
+
+namespace cof
+{
+	struct Shader;
+	struct CullingView;
+
+	//Matches Light in ClusteredLighting.glsl (std430), world space
+	struct Light
+	{
+		glm::vec3 position;
+		float range;
+		glm::vec3 color;
+		//Cosine of the outer cone half angle, -1 for point lights
+		float spotCosOuter;
+		glm::vec3 direction;
+		float spotCosInner;
+	};
+	static_assert(sizeof(Light) == 48);
+
+	//Matches ClusterGrid in ClusteredLighting.glsl (std140).
+	//Screen tiles of tileSize pixels times countZ depth slices spaced exponentially between zNear and zFar,
+	//slice = floor(log(depth) * sliceScale + sliceBias), everything beyond zFar ends up in the last slice.
+	//zNear has to be the near plane of the reversed infinite projection, fragments derive their depth from it
+	struct ClusterGrid
+	{
+		uint32_t countX;
+		uint32_t countY;
+		uint32_t countZ;
+		uint32_t tileSize;
+		float zNear;
+		float zFar;
+		float sliceScale;
+		float sliceBias;
+		uint32_t lightCount;
+		uint32_t lightIndexCapacity;
+		uint32_t extentWidth;
+		uint32_t extentHeight;
+
+		uint32_t ClusterCount() const noexcept { return countX * countY * countZ; }
+	};
+	static_assert(sizeof(ClusterGrid) == 48);
+
+	ClusterGrid MakeClusterGrid(VkExtent2D extent, float zNear, float zFar, uint32_t tileSize = 64, uint32_t sliceCount = 24) noexcept;
+
+	//Per cluster light counts of a CPU binning that mirrors ClusterLightCull.comp.glsl.
+	//averageLightsPerCluster is what a clustered fragment loops over, a brute force fragment loops over lightCount
+	struct LightCullingStatistics
+	{
+		uint32_t lightCount;
+		uint32_t clusterCount;
+		uint32_t occupiedClusterCount;
+		uint32_t maxLightsPerCluster;
+		uint32_t overflowedClusterCount;
+		float averageLightsPerCluster;
+		float averageLightsPerOccupiedCluster;
+
+		void Print() const;
+	};
+
+	LightCullingStatistics BinLightsReference(const std::vector<Light>& lights, const ClusterGrid& grid, const CullingView& cullingView);
+
+	//Matches LightCullingCounters in ClusterLightCull.comp.glsl (std430), counted by the GPU every time the pass runs
+	struct LightCullingCounters
+	{
+		uint32_t lightIndexCount;
+		//Clusters that found more than maxLightsPerCluster lights, and the lights past that they dropped
+		uint32_t overflowedClusterCount;
+		uint32_t droppedLightCount;
+		//Clusters left unlit because the shared index list was full
+		uint32_t unlitClusterCount;
+	};
+
+	//Bins lights into a froxel grid and writes a compact light index list per cluster.
+	//The descriptor set doubles as the lighting set of forward fragment shaders:
+	//binding 0 lights, 1 cluster (offset, count) pairs, 2 light indices, 3 ClusterGrid uniform
+	class ClusteredLightCullingPass
+	{
+	public:
+		ClusteredLightCullingPass(	const VkDevice device,
+									VmaAllocator allocator,
+									const ClusterGrid& clusterGrid,
+									const cof::Shader& cullingShader);
+		~ClusteredLightCullingPass();
+
+		ClusteredLightCullingPass(const ClusteredLightCullingPass& other) = delete;
+		ClusteredLightCullingPass& operator=(const ClusteredLightCullingPass& other) = delete;
+		ClusteredLightCullingPass(ClusteredLightCullingPass&& other) = delete;
+		ClusteredLightCullingPass& operator=(ClusteredLightCullingPass&& other) = delete;
+
+		//lightBuffer holds lightCount Lights
+		void BindLights(VkBuffer lightBuffer, uint32_t lightCount);
+
+		//Makes the cluster lists visible to fragment shaders and copies the counters for Counters to read.
+		//Expects the previous frame's fragment shaders to be done reading them
+		void Record(VkCommandBuffer commandBuffer, const CullingView& cullingView) const;
+
+		//Of the last recorded culling, once the submission it was recorded into completed
+		LightCullingCounters Counters() const;
+
+		VkDescriptorSetLayout DescriptorSetLayout() const noexcept { return descriptorSetLayout; }
+		VkDescriptorSet DescriptorSet() const noexcept { return descriptorSet; }
+		const ClusterGrid& Grid() const noexcept { return grid; }
+
+		constexpr static uint32_t workGroupSize{ 64 };
+		//Specialization constant of ClusteredForward.frag.glsl, false loops over every light for comparison
+		constexpr static uint32_t clusteredConstantId{ 1 };
+		//Matches MAX_LIGHTS_PER_CLUSTER in ClusterLightCull.comp.glsl
+		constexpr static uint32_t maxLightsPerCluster{ 256 };
+		//Budget of the shared index list, sized for an average of this many lights per cluster
+		constexpr static uint32_t averageLightIndexBudget{ 64 };
+
+	private:
+		VkBuffer clusterBuffer;
+		VmaAllocation clusterAllocation;
+		VkBuffer lightIndexBuffer;
+		VmaAllocation lightIndexAllocation;
+		VkBuffer gridBuffer;
+		VmaAllocation gridAllocation;
+		VkBuffer counterBuffer;
+		VmaAllocation counterAllocation;
+		VkBuffer readbackBuffer;
+		VmaAllocation readbackAllocation;
+		const LightCullingCounters* readbackCounters;
+
+		VkDescriptorSetLayout descriptorSetLayout;
+		VkPipelineLayout pipelineLayout;
+		VkPipeline pipeline;
+		VkDescriptorPool descriptorPool;
+		VkDescriptorSet descriptorSet;
+
+		ClusterGrid grid;
+
+		const VkDevice parent;
+		const VmaAllocator memoryAllocator;
+	};
+}
@@ -0,0 +1,143 @@
+#pragma once
+#include "Graphics/RenderPass.h"
+#include "Graphics/DepthBuffer.h"
+#include "Graphics/VisibilityBuffer.h"
+#include "GPU/vk_mem_alloc.h"
+
+#include <vulkan/vulkan_core.h>
+#include <glm/ext/matrix_float4x4.hpp>
+#include <glm/ext/vector_float3.hpp>
+#include <glm/ext/vector_float4.hpp>
+
+#include <cstdint>
+#include <vector>
+
+namespace cof
+{
+	struct Shader;
+
+	enum class GBufferLayout
+	{
+		//sRGB8 albedo, octahedral normal in RG16F, roughness and metalness in RG8
+		Packed,
+		//RGBA16F albedo, normal and material, the usual starting point packing is measured against
+		Naive
+	};
+
+	struct GBufferFormats
+	{
+		VkFormat albedo;
+		VkFormat normal;
+		VkFormat material;
+		//Color targets plus depth
+		uint32_t bytesPerPixel;
+	};
+
+	//Matches GBufferMaterial in GBuffer.glsl (std430)
+	struct GBufferMaterial
+	{
+		glm::vec4 baseColor;
+		float roughness;
+		float metalness;
+		float padding[2];
+	};
+	static_assert(sizeof(GBufferMaterial) == 32);
+
+	//Off chip traffic of one frame estimated from the attachment formats, assuming the G-buffer is written once by the geometry
+	//subpass and read once by the lighting subpass. Nothing is measured, overdraw, compression and caches all change the real figure
+	struct GBufferBandwidth
+	{
+		GBufferLayout layout;
+		VkExtent2D extent;
+		uint32_t bytesPerPixel;
+		//The attachments are never stored, so a tiler only writes the lit image
+		uint64_t tiledBytes;
+		//An immediate mode GPU writes and reads every target through memory
+		uint64_t immediateBytes;
+
+		void Print() const;
+	};
+
+	GBufferBandwidth EstimateGBufferBandwidth(GBufferLayout layout, VkExtent2D extent) noexcept;
+
+	//Deferred alternative to the forward pass. Geometry and lighting are two subpasses of one render pass and
+	//the lighting subpass reads the G-buffer as input attachments, so tile based GPUs keep it on chip.
+	//Draws are the same VisibilityDraws the visibility buffer consumes
+	class DeferredGBuffer
+	{
+	public:
+		struct Shaders
+		{
+			const cof::Shader& geometryVertex;
+			const cof::Shader& geometryFragment;
+			const cof::Shader& lightingVertex;
+			const cof::Shader& lightingFragment;
+		};
+
+		DeferredGBuffer(const VkDevice device,
+						VmaAllocator allocator,
+						const VkExtent2D bufferExtent,
+						const Shaders& shaders,
+						const GBufferLayout gbufferLayout);
+		~DeferredGBuffer();
+
+		DeferredGBuffer(const DeferredGBuffer& other) = delete;
+		DeferredGBuffer& operator=(const DeferredGBuffer& other) = delete;
+		DeferredGBuffer(DeferredGBuffer&& other) = delete;
+		DeferredGBuffer& operator=(DeferredGBuffer&& other) = delete;
+
+		//drawBuffer holds the VisibilityDraws passed to Record, materialBuffer their GBufferMaterials
+		void BindScene(VkBuffer drawBuffer, VkBuffer materialBuffer);
+
+		//Leaves the lit image in VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, ready to be blitted to the swapchain.
+		//lightDirection is the direction the light travels in, ambient is added to the diffuse term
+		void Record(VkCommandBuffer commandBuffer,
+					VkBuffer indexBuffer,
+					const std::vector<VisibilityDraw>& draws,
+					const glm::mat4& viewProjection,
+					const glm::vec3& cameraPosition,
+					const glm::vec3& lightDirection,
+					float ambient) const;
+
+		VkImage LitImage() const noexcept { return litImage; }
+		VkExtent2D Extent() const noexcept { return extent; }
+		GBufferLayout Layout() const noexcept { return layout; }
+
+		static GBufferFormats Formats(GBufferLayout gbufferLayout) noexcept;
+
+		constexpr static VkFormat litFormat{ VK_FORMAT_R8G8B8A8_UNORM };
+		//Specialization constant of the G-buffer shaders selecting the packed encoding
+		constexpr static uint32_t packedConstantId{ 0 };
+
+	private:
+		VkImage albedoImage;
+		VmaAllocation albedoAllocation;
+		VkImageView albedoView;
+		VkImage normalImage;
+		VmaAllocation normalAllocation;
+		VkImageView normalView;
+		VkImage materialImage;
+		VmaAllocation materialAllocation;
+		VkImageView materialView;
+		VkImage litImage;
+		VmaAllocation litAllocation;
+		VkImageView litView;
+		DepthBuffer depthBuffer;
+
+		RenderPass renderPass;
+		VkFramebuffer framebuffer;
+
+		VkDescriptorSetLayout descriptorSetLayout;
+		VkPipelineLayout pipelineLayout;
+		VkPipeline geometryPipeline;
+		VkPipeline lightingPipeline;
+		VkDescriptorPool descriptorPool;
+		VkDescriptorSet descriptorSet;
+
+		VkExtent2D extent;
+		GBufferLayout layout;
+
+		const VkDevice parent;
+		const VmaAllocator memoryAllocator;
+	};
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include "GPU/vk_mem_alloc.h"
+
+#include <vulkan/vulkan_core.h>
+#include <glm/ext/matrix_float4x4.hpp>
+
+namespace cof
+{
+	//Reversed-Z depth attachment, created alongside the swapchain with the same extent.
+	//Near maps to 1 and infinity to 0, so float precision is spread evenly over distance
+	class DepthBuffer
+	{
+	public:
+		//additionalUsage is or'ed with VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, e.g. sampled for a depth pyramid or
+		//transient for depth that is never stored, which then goes to lazily allocated memory where available
+		DepthBuffer(const VkDevice device, VmaAllocator allocator, const VkExtent2D imageExtent, const VkImageUsageFlags additionalUsage = 0);
+		~DepthBuffer();
+
+		DepthBuffer(const DepthBuffer& other) = delete;
+		DepthBuffer& operator=(const DepthBuffer& other) = delete;
+		DepthBuffer(DepthBuffer&& other) = delete;
+		DepthBuffer& operator=(DepthBuffer&& other) = delete;
+
+		VkImage Image() const noexcept { return image; }
+		VkImageView View() const noexcept { return view; }
+		VkExtent2D Extent() const noexcept { return extent; }
+
+		constexpr static VkFormat format{ VK_FORMAT_D32_SFLOAT };
+		constexpr static float clearDepth{ 0.0f };
+		constexpr static VkCompareOp compareOp{ VK_COMPARE_OP_GREATER };
+
+	private:
+		VkImage image;
+		VmaAllocation allocation;
+		VkImageView view;
+		VkExtent2D extent;
+
+		const VkDevice parent;
+		const VmaAllocator memoryAllocator;
+	};
+
+	//Right handed view space looking down -z, Vulkan clip space with depth = zNear / -z, so there is no far plane.
+	//y is not flipped, callers author their geometry for Vulkan's y down framebuffer
+	glm::mat4 InfiniteReversedPerspective(float fovY, float aspectRatio, float zNear) noexcept;
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include "GPU/vk_mem_alloc.h"
+
+#include <vulkan/vulkan_core.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace cof
+{
+	struct Shader;
+
+	//Hierarchical-Z pyramid, every texel holds the farthest depth of its footprint in the depth buffer
+	class DepthPyramid
+	{
+	public:
+		DepthPyramid(	const VkDevice device,
+						VmaAllocator allocator,
+						const VkExtent2D depthExtent,
+						const cof::Shader& reduceShader,
+						const bool reversedZ);
+		~DepthPyramid();
+
+		DepthPyramid(const DepthPyramid& other) = delete;
+		DepthPyramid& operator=(const DepthPyramid& other) = delete;
+		DepthPyramid(DepthPyramid&& other) = delete;
+		DepthPyramid& operator=(DepthPyramid&& other) = delete;
+
+		//depthView must be in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL when Record is executed
+		void BindDepth(VkImageView depthView);
+
+		//Leaves the pyramid in VK_IMAGE_LAYOUT_GENERAL, readable by compute shaders
+		void Record(VkCommandBuffer commandBuffer) const;
+
+		VkImage Image() const noexcept { return image; }
+		VkImageView View() const noexcept { return fullView; }
+		VkSampler Sampler() const noexcept { return sampler; }
+		VkExtent2D Extent() const noexcept { return extent; }
+		uint32_t MipCount() const noexcept { return mipCount; }
+
+		constexpr static uint32_t workGroupSize{ 8 };
+
+	private:
+		VkImage image;
+		VmaAllocation allocation;
+		VkImageView fullView;
+		std::vector<VkImageView> mipViews;
+		VkSampler sampler;
+
+		VkDescriptorSetLayout descriptorSetLayout;
+		VkPipelineLayout pipelineLayout;
+		VkPipeline pipeline;
+		VkDescriptorPool descriptorPool;
+		std::vector<VkDescriptorSet> descriptorSets;
+
+		VkExtent2D extent;
+		uint32_t mipCount;
+
+		const VkDevice parent;
+		const VmaAllocator memoryAllocator;
+	};
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include <vulkan/vulkan_core.h>
+#include <glm/ext/vector_float4.hpp>
+#include <glm/ext/matrix_float4x4.hpp>
+
+#include <array>
+#include <cstdint>
+
+namespace cof
+{
+	struct Shader;
+
+	struct Frustum
+	{
+		std::array<glm::vec4, 6> planes;
+	};
+
+	//Planes point inwards, Vulkan clip space (0 <= z <= w)
+	Frustum ExtractFrustum(const glm::mat4& viewProjection) noexcept;
+
+	//Matches the DrawInstance struct in FrustumCull.comp.glsl (std430)
+	struct DrawInstance
+	{
+		glm::vec4 boundingSphere;
+		uint32_t indexCount;
+		uint32_t firstIndex;
+		int32_t vertexOffset;
+		uint32_t padding;
+	};
+	static_assert(sizeof(DrawInstance) == 32);
+
+	class FrustumCullingPass
+	{
+	public:
+		FrustumCullingPass(const VkDevice device, const cof::Shader& cullingShader);
+		~FrustumCullingPass();
+
+		FrustumCullingPass(const FrustumCullingPass& other) = delete;
+		FrustumCullingPass& operator=(const FrustumCullingPass& other) = delete;
+		FrustumCullingPass(FrustumCullingPass&& other) = delete;
+		FrustumCullingPass& operator=(FrustumCullingPass&& other) = delete;
+
+		//drawCommandBuffer holds one VkDrawIndexedIndirectCommand per instance, drawCountBuffer a single uint32_t
+		void BindBuffers(VkBuffer instanceBuffer, VkBuffer drawCommandBuffer, VkBuffer drawCountBuffer);
+
+		//Resets the draw count, culls and makes the results visible to the indirect draw stage
+		void Record(VkCommandBuffer commandBuffer, const Frustum& frustum, uint32_t instanceCount) const;
+		//The two halves of Record without any barriers, for a RenderGraph that tracks the draw buffers itself
+		void RecordReset(VkCommandBuffer commandBuffer) const;
+		void RecordCulling(VkCommandBuffer commandBuffer, const Frustum& frustum, uint32_t instanceCount) const;
+		void RecordDraw(VkCommandBuffer commandBuffer, uint32_t maxDrawCount) const;
+
+		VkPipeline Pipeline() const noexcept { return pipeline; }
+		VkPipelineLayout PipelineLayout() const noexcept { return pipelineLayout; }
+
+		constexpr static uint32_t workGroupSize{ 64 };
+
+	private:
+		VkDescriptorSetLayout descriptorSetLayout;
+		VkPipelineLayout pipelineLayout;
+		VkPipeline pipeline;
+		VkDescriptorPool descriptorPool;
+		VkDescriptorSet descriptorSet;
+
+		VkBuffer drawCommands{ VK_NULL_HANDLE };
+		VkBuffer drawCount{ VK_NULL_HANDLE };
+
+		const VkDevice parent;
+	};
+}
@@ -0,0 +1,201 @@
+#pragma once
+#include "Graphics/FrustumCulling.h"
+#include "Graphics/MeshLod.h"
+#include "Graphics/Vertex.h"
+#include "Graphics/VertexQuantization.h"
+#include "Graphics/VisibilityBuffer.h"
+#include "GPU/GeometryBuffer.h"
+#include "GPU/UploadStreamer.h"
+
+#include <vulkan/vulkan_core.h>
+#include <glm/ext/matrix_float4x4.hpp>
+#include <glm/ext/vector_float3.hpp>
+#include <glm/ext/vector_float4.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace cof
+{
+	struct GPUContext;
+
+	constexpr uint32_t clusterPageSize{ 128 * 1024 };
+
+	//A page holds whole meshlets of one LOD as QuantizedLitVertices followed by 32 bit indices relative to the page's
+	//first vertex, so a resident page is drawn as a single VisibilityDraw. Only this metadata stays in memory
+	struct ClusterPage
+	{
+		//Object space, around the bounds of its meshlets
+		glm::vec4 boundingSphere;
+		uint32_t lod;
+		uint32_t meshletCount;
+		uint32_t vertexCount;
+		uint32_t indexCount;
+	};
+
+	struct ClusterPageMesh
+	{
+		std::vector<ClusterPage> pages;
+		//Pages of LOD n are pages[lodFirstPages[n]] up to pages[lodFirstPages[n + 1]]
+		std::vector<uint32_t> lodFirstPages;
+		std::vector<float> lodErrors;
+		//Around every page, for LOD selection
+		glm::vec4 boundingSphere;
+		QuantizationTransform quantization;
+
+		uint32_t LodCount() const noexcept { return static_cast<uint32_t>(lodErrors.size()); }
+	};
+
+	struct CookedClusterMesh
+	{
+		ClusterPageMesh mesh;
+		//Per page, meant to be written to disk and loaded again by GeometryStreamer
+		std::vector<std::vector<std::byte>> pageData;
+	};
+
+	//Splits every LOD of chain into meshlets and packs them into pages of at most pageSize bytes in meshlet order, which
+	//keeps pages spatially coherent. Vertices shared by meshlets in different pages are stored in both
+	CookedClusterMesh CookClusterPages(	const LodChain& chain,
+										const std::vector<QuantizedLitVertex>& vertices,
+										const std::vector<glm::vec3>& positions,
+										const QuantizationTransform& quantization,
+										uint32_t pageSize = clusterPageSize);
+
+	struct GeometryStreamingStatistics
+	{
+		uint32_t pageCount;
+		uint32_t residentPages;
+		uint32_t loadingPages;
+		uint32_t slotCount;
+		uint32_t drawnPages;
+		//Instances drawn with a coarser LOD than they asked for, because its pages hadn't arrived yet or didn't fit the draws
+		uint32_t fallbackInstances;
+		//Instances whose LOD had more visible pages than draws were left, a coarser LOD was requested instead
+		uint32_t cappedInstances;
+		//Instances not drawn, even their coarsest LOD didn't fit the draws
+		uint32_t droppedInstances;
+		uint64_t streamedBytes;
+		uint32_t evictionCount;
+		VkDeviceSize vramBytes;
+		//Page metadata kept in memory, page data itself only lives in RAM while it's queued for upload
+		size_t metadataBytes;
+
+		void Print() const;
+	};
+
+	//Out-of-core geometry in a paged device buffer of fixed size slots. Every frame each instance picks the LOD whose
+	//error projects below the pixel threshold, and that LOD's pages inside the frustum are requested. Until all of them
+	//are resident the instance is drawn with the finest coarser LOD that is, the coarsest LOD of every mesh is loaded
+	//up front and never evicted. Slots are reused least recently drawn first once retireLatency frames passed, and at
+	//most maxLoadingPages pages are in flight, which bounds both VRAM and the RAM holding page data. Every page is a draw of
+	//its own and a visibility pixel addresses at most maxDraws of them: instances are served nearest first, and an
+	//instance whose pages exceed what's left after reserving the coarsest LODs of the ones behind it moves to a coarser LOD.
+	//When even the coarsest LODs don't fit the farthest instances are left out
+	class GeometryStreamer
+	{
+	public:
+		GeometryStreamer(const cof::GPUContext& gpuContext, UploadStreamer& uploadStreamer, uint32_t pageSlotCount, uint32_t maxLoadingPages);
+
+		GeometryStreamer(const GeometryStreamer& other) = delete;
+		GeometryStreamer& operator=(const GeometryStreamer& other) = delete;
+		GeometryStreamer(GeometryStreamer&& other) = delete;
+		GeometryStreamer& operator=(GeometryStreamer&& other) = delete;
+
+		//loadPage returns the pageData CookClusterPages produced for a page, e.g. read from disk
+		uint32_t AddMesh(ClusterPageMesh mesh, std::function<std::vector<std::byte>(uint32_t pageIndex)> loadPage);
+		uint32_t AddInstance(uint32_t meshIndex, const glm::mat4& model, uint32_t materialIndex);
+
+		//Requests the pages the view needs and returns the draws of what's resident, indexing Buffer, at most maxDraws.
+		//projectionScale is projection[1][1] * viewportHeight / 2, as for SelectLod
+		const std::vector<VisibilityDraw>& Update(const glm::mat4& viewProjection, const glm::vec3& cameraPosition, float projectionScale, float maxPixelError);
+
+		//Index buffer of the draws
+		VkBuffer Buffer() const noexcept { return pageBuffer.Handle(); }
+		GeometryStreamingStatistics Statistics() const noexcept;
+
+		//Updates a slot stays untouched after it was last drawn, the frames drawing it have finished by then
+		constexpr static uint32_t retireLatency{ 2 };
+		constexpr static uint32_t maxDraws{ VisibilityBuffer::maxDrawCount };
+
+	private:
+		struct Mesh
+		{
+			ClusterPageMesh pages;
+			std::function<std::vector<std::byte>(uint32_t pageIndex)> loadPage;
+			//Index of the mesh's first page into pageStates
+			uint32_t firstPage;
+		};
+
+		struct Instance
+		{
+			uint32_t mesh;
+			glm::mat4 model;
+			//Largest axis scale of model, distances are divided by it to compare against object space errors
+			float scale;
+			uint32_t materialIndex;
+		};
+
+		struct PageState
+		{
+			uint32_t mesh;
+			uint32_t slot;
+			//Non zero while the upload is in flight
+			UploadTicket ticket;
+			uint64_t lastUsedFrame;
+			bool pinned;
+		};
+
+		struct PageRequest
+		{
+			uint32_t page;
+			float distance;
+		};
+
+		struct VisibleInstance
+		{
+			uint32_t instance;
+			float distance;
+			//LOD whose error projects below the pixel threshold
+			uint32_t selectedLod;
+			//Pages of the coarsest LOD in the frustum
+			uint32_t minimumDraws;
+		};
+
+		bool Request(uint32_t page, UploadPriority priority);
+		//Free slot or the least recently drawn one, noSlot when every slot is pinned, loading or still in use
+		uint32_t AllocateSlot();
+		bool IsResident(uint32_t page) const noexcept { return pageStates[page].slot != noSlot && pageStates[page].ticket == 0; }
+		//Fills visiblePages with the pages of the instance's LOD in the frustum
+		void CollectVisiblePages(const Instance& instance, uint32_t lod, const Frustum& frustum);
+		VisibilityDraw PageDraw(const Instance& instance, uint32_t page) const noexcept;
+
+		constexpr static uint32_t noSlot{ 0xffffffff };
+		constexpr static uint32_t noPage{ 0xffffffff };
+		constexpr static uint32_t noLod{ 0xffffffff };
+
+		GeometryBuffer pageBuffer;
+		VkDeviceSize slotBase;
+		UploadStreamer& uploads;
+
+		std::vector<Mesh> meshes;
+		std::vector<Instance> instances;
+		std::vector<PageState> pageStates;
+		std::vector<uint32_t> slotPages;
+		std::vector<PageRequest> requests;
+		std::vector<VisibleInstance> visibleInstances;
+		std::vector<uint32_t> visiblePages;
+		std::vector<VisibilityDraw> draws;
+
+		uint32_t maxLoading;
+		uint32_t loadingCount{ 0 };
+		uint64_t frame{ 0 };
+		uint32_t drawnPages{ 0 };
+		uint32_t fallbackInstances{ 0 };
+		uint32_t cappedInstances{ 0 };
+		uint32_t droppedInstances{ 0 };
+		uint64_t streamedBytes{ 0 };
+		uint32_t evictionCount{ 0 };
+	};
+}
@@ -0,0 +1,112 @@
+#pragma once
+#include <glm/ext/matrix_float4x4.hpp>
+#include <glm/ext/vector_float4.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace cof
+{
+	//Elements of an accessor within its buffer
+	struct GltfAccessorView
+	{
+		const std::byte* data;
+		size_t count;
+		size_t stride;
+		uint32_t componentType;
+		uint32_t componentCount;
+	};
+
+	//The parts of a glTF 2.0 document GltfScene builds from, with every buffer loaded. References between objects are
+	//kept as the document has them, noIndex where one is missing or isn't a valid index, so they're checked against the
+	//array they point into before use
+	struct GltfDocument
+	{
+		struct BufferView
+		{
+			uint32_t buffer;
+			size_t byteOffset;
+			size_t byteLength;
+			//Zero for tightly packed elements
+			size_t byteStride;
+		};
+
+		struct Accessor
+		{
+			uint32_t bufferView;
+			size_t byteOffset;
+			size_t count;
+			uint32_t componentType;
+			//1 to 4 for SCALAR to VEC4, zero for matrices and unknown types
+			uint32_t componentCount;
+			bool sparse;
+		};
+
+		struct Primitive
+		{
+			//Accessors of the attributes GltfScene reads
+			uint32_t position;
+			uint32_t normal;
+			uint32_t texCoord;
+			//noIndex for non-indexed geometry
+			uint32_t indices;
+			uint32_t material;
+			uint32_t mode;
+		};
+
+		struct Mesh
+		{
+			std::string name;
+			std::vector<Primitive> primitives;
+		};
+
+		struct Material
+		{
+			glm::vec4 baseColorFactor;
+			uint32_t baseColorTexture;
+		};
+
+		struct Node
+		{
+			//matrix, or translation * rotation * scale
+			glm::mat4 transform;
+			uint32_t mesh;
+			std::vector<uint32_t> children;
+		};
+
+		std::vector<std::vector<std::byte>> buffers;
+		std::vector<BufferView> bufferViews;
+		std::vector<Accessor> accessors;
+		std::vector<Mesh> meshes;
+		std::vector<Material> materials;
+		//Image of every texture
+		std::vector<uint32_t> textureSources;
+		//Empty for images in buffer views
+		std::vector<std::string> imageUris;
+		std::vector<Node> nodes;
+		//Root nodes of every scene
+		std::vector<std::vector<uint32_t>> scenes;
+		//Default scene, noIndex if the document doesn't name one
+		uint32_t scene;
+
+		//Nullopt for sparse accessors, accessors without a buffer view, of unknown types or reaching past their view
+		std::optional<GltfAccessorView> ResolveAccessor(uint32_t accessor) const;
+
+		constexpr static uint32_t noIndex{ 0xffffffff };
+		constexpr static uint32_t componentTypeUnsignedByte{ 5121 };
+		constexpr static uint32_t componentTypeUnsignedShort{ 5123 };
+		constexpr static uint32_t componentTypeUnsignedInt{ 5125 };
+		constexpr static uint32_t componentTypeFloat{ 5126 };
+		constexpr static uint32_t modeTriangles{ 4 };
+	};
+
+	//Parses the JSON of a .gltf file and loads its buffers, from files in directory or from base64 data URIs. Members of
+	//the wrong type count as missing. Nullopt if json isn't valid JSON or a buffer can't be loaded, with a message for the latter
+	std::optional<GltfDocument> ParseGltf(std::string_view json, const std::filesystem::path& directory);
+	std::optional<GltfDocument> LoadGltf(const std::filesystem::path& path);
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include "Graphics/Vertex.h"
+#include "Graphics/FrustumCulling.h"
+#include "Graphics/MeshOptimizer.h"
+
+#include <glm/ext/vector_float2.hpp>
+#include <glm/ext/vector_float3.hpp>
+#include <glm/ext/vector_float4.hpp>
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace cof
+{
+	//Post-transform cache statistics of one primitive of a glTF mesh, before and after it was optimized
+	struct PrimitiveCacheReport
+	{
+		//The mesh's name in the document, empty if it has none
+		std::string meshName;
+		uint32_t meshIndex;
+		uint32_t primitiveIndex;
+		MeshOptimizer::OptimizationReport report;
+	};
+
+	//Static geometry of a glTF scene flattened into one vertex and one index stream in world space, ready for the GPU
+	//driven draws. Every primitive a node instantiates gets vertices and a DrawInstance of its own, indices are relative
+	//to the instance's vertexOffset
+	struct GltfScene
+	{
+		std::vector<UnlitColoredVertex> vertices;
+		//TEXCOORD_0 of every vertex, zero where a primitive has none
+		std::vector<glm::vec2> texCoords;
+		std::vector<uint32_t> indices;
+		std::vector<DrawInstance> drawInstances;
+		//Unlit base color factor of every DrawInstance's material, for renderers that light the scene themselves
+		std::vector<glm::vec4> baseColors;
+		//Image of every DrawInstance's base color texture, the factor in baseColors multiplies it. noImage without one
+		std::vector<uint32_t> baseColorImages;
+		//Files of the document's images next to the .gltf, empty for images in data URIs or buffer views
+		std::vector<std::filesystem::path> images;
+		glm::vec3 boundsMin;
+		glm::vec3 boundsMax;
+		uint64_t triangleCount;
+		//Post-transform cache statistics of every loaded mesh primitive in order of first use. Nodes instantiating the same
+		//mesh share its entries, the primitives are optimized the same way for each of them
+		std::vector<PrimitiveCacheReport> primitiveCacheReports;
+		//Post-transform cache statistics of all instances together, before and after they were optimized
+		MeshOptimizer::OptimizationReport vertexCacheReport;
+		//Index into primitiveCacheReports of every DrawInstance's mesh primitive. Instances of the same primitive share its
+		//index order, mirrored ones with the last two corners of every triangle swapped
+		std::vector<uint32_t> primitives;
+
+		constexpr static uint32_t noImage{ 0xffffffff };
+	};
+
+	//Loads the default scene of a .gltf file through LoadGltf, buffers are read from files next to it or from base64 data URIs.
+	//Only triangle lists with float positions are loaded, other primitives are skipped. A vertex gets its material's base
+	//color factor lit by a fixed directional light, base color textures are only referenced and float TEXCOORD_0 kept for
+	//renderers that sample them. Images aren't loaded. Every primitive is run through
+	//MeshOptimizer::Optimize, unreferenced vertices are dropped. Nullopt and a message if the file can't be read
+	std::optional<GltfScene> LoadGltfScene(const std::filesystem::path& path);
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <glm/ext/vector_float3.hpp>
+
+#include <cstdint>
+#include <vector>
+
+namespace cof
+{
+	struct MeshLod
+	{
+		uint32_t firstIndex;
+		uint32_t indexCount;
+		//Estimated object space deviation from the full detail surface: the largest collapse error of every simplification
+		//step down to this LOD, summed. A collapse error is the area weighted RMS distance of the kept vertex to the planes of
+		//the triangles merged into it, so parts of the surface can deviate further
+		float error;
+	};
+
+	//Every LOD indexes the same vertex buffer, their indices are stored back to back from the most detailed one down
+	struct LodChain
+	{
+		std::vector<uint32_t> indices;
+		std::vector<MeshLod> lods;
+
+		void Print(const char* label) const;
+	};
+
+	constexpr static uint32_t defaultMaxLodCount{ 8 };
+
+	//Quadric error metric edge collapse onto existing vertices, stops at targetIndexCount or once a collapse's area weighted
+	//RMS plane distance would exceed targetError, resultError is the largest one applied.
+	//Borders are kept in place and vertices shared by attribute seams are never moved
+	std::vector<uint32_t> SimplifyMesh(	const std::vector<uint32_t>& indices,
+										const std::vector<glm::vec3>& positions,
+										size_t targetIndexCount,
+										float targetError,
+										float& resultError);
+
+	//Halves the triangle count per LOD until the summed error estimate reaches maxError, maxLodCount is reached or the mesh
+	//stops simplifying
+	LodChain BuildLodChain(	const std::vector<uint32_t>& indices,
+							const std::vector<glm::vec3>& positions,
+							float maxError,
+							uint32_t maxLodCount = defaultMaxLodCount);
+
+	//Picks the coarsest LOD whose estimated error projects to at most maxPixelError pixels.
+	//distance is to the closest point of the instance bounds divided by the instance scale,
+	//projectionScale is projection[1][1] * viewportHeight / 2
+	inline uint32_t SelectLod(const LodChain& chain, float distance, float projectionScale, float maxPixelError) noexcept
+	{
+		const float maxError{ maxPixelError * distance / projectionScale };
+
+		uint32_t lod{ 0 };
+		while (lod + 1 < chain.lods.size() && chain.lods[lod + 1].error <= maxError)
+		{
+			++lod;
+		}
+
+		return lod;
+	}
+}
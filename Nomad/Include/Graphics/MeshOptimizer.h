@@ -0,0 +1,91 @@
+#pragma once
+#include <glm/ext/vector_float3.hpp>
+
+#include <cstdint>
+#include <vector>
+
+namespace cof::MeshOptimizer
+{
+	constexpr static uint32_t defaultCacheSize{ 16 };
+	constexpr static uint32_t unusedVertex{ ~0u };
+
+	struct VertexCacheStatistics
+	{
+		uint32_t triangleCount;
+		uint32_t vertexCount;
+		uint32_t transformedVertexCount;
+		//Average cache miss ratio, transformed vertices per triangle, 0.5 at best and 3 at worst
+		float acmr;
+		//Average transform to vertex ratio, 1 at best
+		float atvr;
+
+		void Print(const char* label) const;
+	};
+
+	//Simulates a FIFO post-transform cache, the ATVR only counts vertices referenced by the indices
+	VertexCacheStatistics AnalyzeVertexCache(const std::vector<uint32_t>& indices, uint32_t vertexCount, uint32_t cacheSize = defaultCacheSize);
+
+	//Forsyth's linear-speed vertex cache optimisation, degenerate triangles are kept
+	std::vector<uint32_t> OptimizeVertexCache(const std::vector<uint32_t>& indices, uint32_t vertexCount);
+
+	//Splits cache optimised indices into clusters at cache restarts and sorts the clusters outside in,
+	//threshold bounds how much the ACMR may grow by splitting clusters further
+	std::vector<uint32_t> OptimizeOverdraw(	const std::vector<uint32_t>& indices,
+											const std::vector<glm::vec3>& positions,
+											float threshold = 1.05f,
+											uint32_t cacheSize = defaultCacheSize);
+
+	//Numbers vertices in order of first use, unreferenced vertices map to unusedVertex
+	std::vector<uint32_t> GenerateVertexFetchRemap(const std::vector<uint32_t>& indices, uint32_t vertexCount, uint32_t& uniqueVertexCount);
+
+	void RemapIndices(std::vector<uint32_t>& indices, const std::vector<uint32_t>& remap);
+
+	template<typename Vertex>
+	std::vector<Vertex> RemapVertices(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& remap, uint32_t uniqueVertexCount)
+	{
+		std::vector<Vertex> remapped(uniqueVertexCount);
+		for (size_t vertex{}; vertex < vertices.size(); ++vertex)
+		{
+			if (remap[vertex] != unusedVertex)
+			{
+				remapped[remap[vertex]] = vertices[vertex];
+			}
+		}
+
+		return remapped;
+	}
+
+	struct OptimizationReport
+	{
+		VertexCacheStatistics before;
+		VertexCacheStatistics after;
+
+		void Print(const char* label) const;
+	};
+
+	//Runs the vertex cache, overdraw and vertex fetch passes in that order on a mesh whose vertices have a position member
+	template<typename Vertex>
+	OptimizationReport Optimize(std::vector<uint32_t>& indices, std::vector<Vertex>& vertices)
+	{
+		const uint32_t vertexCount{ static_cast<uint32_t>(vertices.size()) };
+
+		OptimizationReport report{};
+		report.before = AnalyzeVertexCache(indices, vertexCount);
+
+		std::vector<glm::vec3> positions(vertices.size());
+		for (size_t vertex{}; vertex < vertices.size(); ++vertex)
+		{
+			positions[vertex] = vertices[vertex].position;
+		}
+
+		indices = OptimizeOverdraw(OptimizeVertexCache(indices, vertexCount), positions);
+
+		uint32_t uniqueVertexCount{};
+		const std::vector<uint32_t> remap = GenerateVertexFetchRemap(indices, vertexCount, uniqueVertexCount);
+		RemapIndices(indices, remap);
+		vertices = RemapVertices(vertices, remap, uniqueVertexCount);
+
+		report.after = AnalyzeVertexCache(indices, uniqueVertexCount);
+		return report;
+	}
+}
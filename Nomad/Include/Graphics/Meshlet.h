@@ -0,0 +1,42 @@
+#pragma once
+#include <glm/ext/vector_float3.hpp>
+#include <glm/ext/vector_float4.hpp>
+
+#include <cstdint>
+#include <vector>
+
+namespace cof
+{
+	//Matches the Meshlet struct in MeshletCull.comp.glsl (std430)
+	struct Meshlet
+	{
+		glm::vec4 boundingSphere;
+		//xyz apex, the cone is ignored when the cutoff is 1
+		glm::vec4 coneApex;
+		//xyz axis, w cutoff
+		glm::vec4 coneAxisCutoff;
+		uint32_t vertexOffset;
+		uint32_t triangleOffset;
+		uint32_t vertexCount;
+		uint32_t triangleCount;
+	};
+	static_assert(sizeof(Meshlet) == 64);
+
+	struct MeshletMesh
+	{
+		std::vector<Meshlet> meshlets;
+		//Indices into the vertex buffer of the source mesh
+		std::vector<uint32_t> meshletVertices;
+		//Three indices into meshletVertices per triangle, relative to Meshlet::vertexOffset
+		std::vector<uint8_t> meshletTriangles;
+	};
+
+	constexpr static uint32_t defaultMeshletMaxVertices{ 64 };
+	constexpr static uint32_t defaultMeshletMaxTriangles{ 124 };
+
+	//Triangles are expected to wind counter-clockwise when seen from the front, as in glTF
+	MeshletMesh BuildMeshlets(	const std::vector<uint32_t>& indices,
+								const std::vector<glm::vec3>& positions,
+								const uint32_t maxVertices = defaultMeshletMaxVertices,
+								const uint32_t maxTriangles = defaultMeshletMaxTriangles);
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <vulkan/vulkan_core.h>
+
+#include <cstdint>
+
+namespace cof
+{
+	struct Shader;
+	struct CullingView;
+	class DepthPyramid;
+
+	//Culls meshlets by frustum, normal cone and optionally Hi-Z occlusion,
+	//the surviving triangles are compacted into an index buffer drawn by a single indirect draw
+	class MeshletCullingPass
+	{
+	public:
+		MeshletCullingPass(const VkDevice device, const cof::Shader& cullingShader, const bool reversedZ);
+		~MeshletCullingPass();
+
+		MeshletCullingPass(const MeshletCullingPass& other) = delete;
+		MeshletCullingPass& operator=(const MeshletCullingPass& other) = delete;
+		MeshletCullingPass(MeshletCullingPass&& other) = delete;
+		MeshletCullingPass& operator=(MeshletCullingPass&& other) = delete;
+
+		//meshletTriangleBuffer holds MeshletMesh::meshletTriangles padded to a multiple of four bytes,
+		//compactedIndexBuffer room for every triangle of every meshlet, drawCommandBuffer one VkDrawIndexedIndirectCommand
+		void BindBuffers(	VkBuffer meshletBuffer,
+							VkBuffer meshletVertexBuffer,
+							VkBuffer meshletTriangleBuffer,
+							VkBuffer compactedIndexBuffer,
+							VkBuffer drawCommandBuffer,
+							uint32_t meshletCount);
+
+		//Has to be bound even when occlusion culling is disabled, the shader statically uses it
+		void BindDepthPyramid(const cof::DepthPyramid& depthPyramid);
+
+		void Record(VkCommandBuffer commandBuffer, const CullingView& cullingView, bool occlusionEnabled) const;
+
+		//Binds the compacted index buffer, vertex buffers are left to the caller
+		void RecordDraw(VkCommandBuffer commandBuffer) const;
+
+		constexpr static uint32_t maxWorkGroupCountX{ 65535 };
+
+	private:
+		VkDescriptorSetLayout descriptorSetLayout;
+		VkPipelineLayout pipelineLayout;
+		VkPipeline pipeline;
+		VkDescriptorPool descriptorPool;
+		VkDescriptorSet descriptorSet;
+
+		VkBuffer compactedIndices{ VK_NULL_HANDLE };
+		VkBuffer drawCommand{ VK_NULL_HANDLE };
+		uint32_t boundMeshletCount{ 0 };
+		VkExtent2D pyramidExtent{ 0, 0 };
+
+		const VkDevice parent;
+	};
+}
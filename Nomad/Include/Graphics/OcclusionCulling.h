@@ -0,0 +1,81 @@
+#pragma once
+#include <vulkan/vulkan_core.h>
+#include <glm/ext/matrix_float4x4.hpp>
+
+#include <cstdint>
+
+namespace cof
+{
+	struct Shader;
+	class DepthPyramid;
+
+	struct CullingView
+	{
+		glm::mat4 view;
+		glm::mat4 projection;
+		float zNear;
+		float zFar; //0 for an infinite far plane
+	};
+
+	//Matches the CullingCounters buffer in OcclusionCull.comp.glsl
+	struct OcclusionCullingStatistics
+	{
+		uint32_t earlyDrawCount;
+		uint32_t lateDrawCount;
+		uint32_t frustumCulledCount;
+		uint32_t occlusionCulledCount;
+
+		float CulledPercentage(uint32_t instanceCount) const noexcept;
+		void Print(uint32_t instanceCount) const;
+	};
+	static_assert(sizeof(OcclusionCullingStatistics) == 16);
+
+	//Two phase Hi-Z culling:
+	//Early draws what was visible last frame, the depth pyramid is rebuilt from that depth,
+	//Late retests every instance against it and draws what became visible
+	class OcclusionCullingPass
+	{
+	public:
+		enum class Phase : uint32_t
+		{
+			Early,
+			Late
+		};
+
+		OcclusionCullingPass(const VkDevice device, const cof::Shader& cullingShader, const bool reversedZ);
+		~OcclusionCullingPass();
+
+		OcclusionCullingPass(const OcclusionCullingPass& other) = delete;
+		OcclusionCullingPass& operator=(const OcclusionCullingPass& other) = delete;
+		OcclusionCullingPass(OcclusionCullingPass&& other) = delete;
+		OcclusionCullingPass& operator=(OcclusionCullingPass&& other) = delete;
+
+		//visibilityBuffer holds one zero initialized uint32_t per instance,
+		//drawCommandBuffer two VkDrawIndexedIndirectCommand per instance, counterBuffer one OcclusionCullingStatistics
+		void BindBuffers(VkBuffer instanceBuffer, VkBuffer visibilityBuffer, VkBuffer drawCommandBuffer, VkBuffer counterBuffer, uint32_t maxInstanceCount);
+		void BindDepthPyramid(const cof::DepthPyramid& depthPyramid);
+
+		//The early phase also resets the counters, the late phase expects the depth pyramid to be up to date
+		void Record(VkCommandBuffer commandBuffer, Phase phase, const CullingView& cullingView, uint32_t instanceCount) const;
+		void RecordDraw(VkCommandBuffer commandBuffer, Phase phase) const;
+
+		//Copies the counters so they can be read once the frame's fence has been signaled
+		void RecordStatisticsCopy(VkCommandBuffer commandBuffer, VkBuffer readbackBuffer) const;
+
+		constexpr static uint32_t workGroupSize{ 64 };
+
+	private:
+		VkDescriptorSetLayout descriptorSetLayout;
+		VkPipelineLayout pipelineLayout;
+		VkPipeline pipeline;
+		VkDescriptorPool descriptorPool;
+		VkDescriptorSet descriptorSet;
+
+		VkBuffer drawCommands{ VK_NULL_HANDLE };
+		VkBuffer counters{ VK_NULL_HANDLE };
+		uint32_t instanceCapacity{ 0 };
+		VkExtent2D pyramidExtent{ 0, 0 };
+
+		const VkDevice parent;
+	};
+}
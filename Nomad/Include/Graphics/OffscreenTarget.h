@@ -0,0 +1,53 @@
+#pragma once
+#include "Graphics/PresentationTarget.h"
+#include "GPU/vk_mem_alloc.h"
+
+#include <vulkan/vulkan_core.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace cof
+{
+	struct GPUContext;
+
+	//Presentation without a window or surface, e.g. for benchmarks on machines with only a software Vulkan driver.
+	//Renders into a ring of device local images, acquiring and presenting are empty submits on queue that signal and
+	//consume the semaphores. Frames leave their image in VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL so it can be saved
+	class OffscreenTarget : public PresentationTarget
+	{
+	public:
+		OffscreenTarget(const cof::GPUContext& gpuContext, VmaAllocator allocator, VkQueue queue, VkFormat imageFormat, VkExtent2D imageExtent, VkImageUsageFlags usage, uint32_t imageCount = 2);
+		~OffscreenTarget() override;
+
+		OffscreenTarget(const OffscreenTarget& other) = delete;
+		OffscreenTarget& operator=(const OffscreenTarget& other) = delete;
+		OffscreenTarget(OffscreenTarget&& other) = delete;
+		OffscreenTarget& operator=(OffscreenTarget&& other) = delete;
+
+		VkFormat Format() const noexcept override { return format; }
+		VkExtent2D Extent() const noexcept override { return extent; }
+		VkImage Image(uint32_t index) const noexcept override { return images[index]; }
+		VkImageLayout PresentLayout() const noexcept override { return VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL; }
+
+		uint32_t AcquireNextImage(VkSemaphore acquireSemaphore) override;
+		void Present(VkQueue presentQueue, VkSemaphore renderingFinishedSemaphore, uint32_t imageIndex) override;
+
+		//Writes the last presented image as a binary PPM, waiting for the queue to finish. 8 bit RGBA and BGRA formats only
+		bool Save(const char* path);
+
+	private:
+		std::vector<VkImage> images;
+		std::vector<VmaAllocation> allocations;
+		VkFormat format;
+		VkExtent2D extent;
+		VkQueue targetQueue;
+		uint32_t queueFamilyIndex;
+		uint32_t nextImage{ 0 };
+		uint32_t lastPresented{ 0 };
+		bool presented{ false };
+
+		const VkDevice parent;
+		const VmaAllocator memoryAllocator;
+	};
+}
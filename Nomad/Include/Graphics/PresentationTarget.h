@@ -0,0 +1,26 @@
+#pragma once
+#include <vulkan/vulkan_core.h>
+
+#include <cstdint>
+
+namespace cof
+{
+	//What a frame renders into and hands its result to, a swapchain or images nobody looks at until they're saved.
+	//A frame acquires an image, renders into it after waiting on the acquire semaphore and presents it once the
+	//semaphore its submit signals is signaled. Both semaphores are binary and are consumed by the target
+	class PresentationTarget
+	{
+	public:
+		virtual ~PresentationTarget() = default;
+
+		virtual VkFormat Format() const noexcept = 0;
+		virtual VkExtent2D Extent() const noexcept = 0;
+		virtual VkImage Image(uint32_t index) const noexcept = 0;
+		//Layout a frame leaves the image in for Present
+		virtual VkImageLayout PresentLayout() const noexcept = 0;
+
+		//Signals acquireSemaphore once the returned image may be rendered into
+		virtual uint32_t AcquireNextImage(VkSemaphore acquireSemaphore) = 0;
+		virtual void Present(VkQueue queue, VkSemaphore renderingFinishedSemaphore, uint32_t imageIndex) = 0;
+	};
+}
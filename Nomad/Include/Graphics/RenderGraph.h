@@ -0,0 +1,215 @@
+#pragma once
+#include "GPU/vk_mem_alloc.h"
+
+#include <vulkan/vulkan_core.h>
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace cof
+{
+	class GpuProfiler;
+
+	using RenderResource = uint32_t;
+
+	//How a pass touches a resource, each usage maps to fixed stages, access flags and image layout.
+	//Write usages discard the previous contents, ReadWrite usages keep them
+	enum class ResourceUsage
+	{
+		TransferRead,
+		TransferWrite,
+		IndirectRead,
+		IndexRead,
+		VertexRead,
+		//Storage buffers fetched by vertex pulling shaders
+		VertexShaderRead,
+		UniformRead,
+		ComputeRead,
+		ComputeWrite,
+		ComputeReadWrite,
+		ComputeSampled,
+		FragmentRead,
+		FragmentSampled,
+		ColorWrite,
+		ColorReadWrite,
+		DepthWrite,
+		DepthReadWrite,
+		DepthRead,
+		InputAttachment
+	};
+
+	//Last known state of a resource, imports pass the state left behind by whatever ran before the graph
+	struct ResourceState
+	{
+		VkPipelineStageFlags stages;
+		VkAccessFlags access;
+		VkImageLayout layout;
+	};
+
+	struct ResourceAccess
+	{
+		RenderResource resource;
+		ResourceUsage usage;
+		//Layout a render pass leaves the attachment in through its finalLayout, undefined if it stays in the usage's layout
+		VkImageLayout finalLayout{ VK_IMAGE_LAYOUT_UNDEFINED };
+	};
+
+	//Image owned by the graph, its usage flags follow from the passes that access it
+	struct TransientImageInfo
+	{
+		VkFormat format;
+		VkExtent2D extent;
+		VkImageAspectFlags aspect;
+	};
+
+	struct RenderGraphPass
+	{
+		std::string name;
+		//At most one access per resource
+		std::vector<ResourceAccess> accesses;
+		std::function<void(VkCommandBuffer)> execute;
+		//Passes with effects the graph can't see, such as readbacks, are never culled
+		bool sideEffects{ false };
+	};
+
+	struct RenderGraphStatistics
+	{
+		uint32_t passCount;
+		uint32_t culledPassCount;
+		//Batches of independent passes, every batch is preceded by at most one vkCmdPipelineBarrier
+		uint32_t levelCount;
+		uint32_t barrierCount;
+		uint32_t imageBarrierCount;
+		uint32_t compileCount;
+		uint32_t transientImageCount;
+		uint32_t lazyImageCount;
+		//Estimate of what the transient images would take with an allocation each, the sum of their memory requirements.
+		//They're never allocated that way, so it isn't measured
+		VkDeviceSize dedicatedBytes;
+		//What they take with aliasing, without the lazily allocated ones
+		VkDeviceSize residentBytes;
+		//Images that never leave their pass, only backed on demand by tile based GPUs
+		VkDeviceSize lazyBytes;
+		//Measured with vmaCalculateStats around the creation of the transient images: the bytes of their allocations, the
+		//lazily allocated ones included, and the device memory VMA allocated for them in new blocks
+		VkDeviceSize vmaAllocatedBytes;
+		VkDeviceSize vmaDeviceMemoryBytes;
+
+		void Print() const;
+	};
+
+	//Passes declare the resources they read and write instead of synchronizing themselves. On compile the graph culls
+	//passes that don't contribute to an output, groups independent passes into levels and emits one batched barrier
+	//with all memory dependencies and layout transitions in front of every level. Compiling only happens when the pass
+	//set or the outputs change, swapping the image or buffer behind an import, e.g. the acquired swapchain image, is free.
+	//Transient images only live from the first to the last level that touches them and share memory with images whose
+	//lifetimes don't overlap. Every Execute assumes the previous one has finished on the GPU
+	class RenderGraph
+	{
+	public:
+		RenderGraph(const VkDevice device, VmaAllocator allocator);
+		~RenderGraph();
+
+		RenderGraph(const RenderGraph& other) = delete;
+		RenderGraph& operator=(const RenderGraph& other) = delete;
+		RenderGraph(RenderGraph&& other) = delete;
+		RenderGraph& operator=(RenderGraph&& other) = delete;
+
+		//initialState is assumed at the start of every Execute
+		RenderResource ImportImage(std::string_view name, VkImage image, const VkImageSubresourceRange& range, const ResourceState& initialState);
+		RenderResource ImportBuffer(std::string_view name, VkBuffer buffer, const ResourceState& initialState);
+		void SetImage(RenderResource resource, VkImage image) noexcept;
+		void SetBuffer(RenderResource resource, VkBuffer buffer) noexcept;
+		//Created on compile, attachments only accessed by a single pass get VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT
+		RenderResource CreateImage(std::string_view name, const TransientImageInfo& info);
+
+		VkImage Image(RenderResource resource) const noexcept { return resources[resource].image; }
+		//Transient images only
+		VkImageView View(RenderResource resource) const noexcept { return resources[resource].view; }
+
+		//The last write to an output is kept alive and the resource is left in finalLayout at the end of Execute
+		void MarkOutput(RenderResource resource, VkImageLayout finalLayout = VK_IMAGE_LAYOUT_UNDEFINED);
+
+		//Passes are recorded in insertion order unless they are independent
+		void AddPass(RenderGraphPass pass);
+		void RemovePass(std::string_view name);
+		bool HasPass(std::string_view name) const noexcept;
+
+		//Compiles ahead of Execute, e.g. to build framebuffers around transient images.
+		//Recompiling recreates the transient images, the GPU has to be done with the old ones
+		void Compile();
+		void Execute(VkCommandBuffer commandBuffer);
+
+		RenderGraphStatistics Statistics() const noexcept;
+
+		//Times every pass as a scope named after it, nested in whatever scope is open around Execute. Null stops profiling
+		void Profile(GpuProfiler* gpuProfiler) noexcept { profiler = gpuProfiler; }
+
+	private:
+		struct Resource
+		{
+			std::string name;
+			VkImage image;
+			VkBuffer buffer;
+			VkImageSubresourceRange range;
+			ResourceState initialState;
+			bool output;
+			VkImageLayout finalLayout;
+
+			bool transient;
+			TransientImageInfo transientInfo;
+			VkImageView view;
+			//Lazily allocated images only, the others are bound to aliasedAllocation
+			VmaAllocation allocation;
+			bool lazy;
+			bool aliased;
+			VkDeviceSize aliasOffset;
+			VkDeviceSize memorySize;
+			uint32_t firstLevel;
+			uint32_t lastLevel;
+		};
+
+		struct BarrierBatch
+		{
+			VkPipelineStageFlags srcStages{ 0 };
+			VkPipelineStageFlags dstStages{ 0 };
+			VkMemoryBarrier memoryBarrier{ .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+			std::vector<VkImageMemoryBarrier> imageBarriers;
+			//Resource of every image barrier, the VkImage is patched in on execute
+			std::vector<RenderResource> imageResources;
+
+			bool Empty() const noexcept { return srcStages == 0 && dstStages == 0; }
+		};
+
+		struct Level
+		{
+			BarrierBatch barriers;
+			std::vector<uint32_t> passes;
+		};
+
+		void CreateTransientImages();
+		void DestroyTransientImages();
+		void RecordBarriers(VkCommandBuffer commandBuffer, BarrierBatch& batch);
+
+		std::vector<Resource> resources;
+		std::vector<RenderGraphPass> passes;
+
+		std::vector<Level> levels;
+		BarrierBatch finalBarriers;
+		std::vector<uint32_t> passLevels;
+		VmaAllocation aliasedAllocation{ VK_NULL_HANDLE };
+		VkDeviceSize aliasedBytes{ 0 };
+		VkDeviceSize vmaAllocatedBytes{ 0 };
+		VkDeviceSize vmaDeviceMemoryBytes{ 0 };
+		uint32_t culledPassCount{ 0 };
+		uint32_t compileCount{ 0 };
+		bool dirty{ true };
+		GpuProfiler* profiler{ nullptr };
+
+		const VkDevice parent;
+		const VmaAllocator memoryAllocator;
+	};
+}
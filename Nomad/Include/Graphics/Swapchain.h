@@ -1,10 +1,12 @@
 #pragma once
+#include "Graphics/PresentationTarget.h"
+
 #include <vulkan/vulkan_core.h>
 #include <vector>
 namespace cof
 {
 	struct GPUContext;
-	class Swapchain
+	class Swapchain : public PresentationTarget
 	{
 	private:
 		struct ImageMetaData;
@@ -20,7 +22,7 @@ namespace cof
 			const VkSurfaceFormatKHR desiredSurfaceFormat
 		);
 
-		~Swapchain();
+		~Swapchain() override;
 
 		Swapchain(const Swapchain& other) = delete;
 		Swapchain& operator=(const Swapchain& other) = delete;
@@ -30,7 +32,7 @@ namespace cof
 		VkSwapchainKHR Handle() const noexcept { return handle; }
 		const ImageMetaData& ImageMetaData() const noexcept { return imageMetaData; }
 		const std::vector<VkImage>& Images() const noexcept{ return images; }
-		VkImage Image(uint32_t index) const noexcept { return images[index]; }
+		VkImage Image(uint32_t index) const noexcept override { return images[index]; }
 
 		const uint32_t AcquireNextImage
 		(
@@ -39,6 +41,13 @@ namespace cof
 			VkFence fence
 		);
 
+		VkFormat Format() const noexcept override { return imageMetaData.format; }
+		VkExtent2D Extent() const noexcept override { return imageMetaData.extent; }
+		VkImageLayout PresentLayout() const noexcept override { return VK_IMAGE_LAYOUT_PRESENT_SRC_KHR; }
+		//Waits indefinitely, queue has to support presenting to the surface
+		uint32_t AcquireNextImage(VkSemaphore acquireSemaphore) override;
+		void Present(VkQueue queue, VkSemaphore renderingFinishedSemaphore, uint32_t imageIndex) override;
+
 	private:
 		VkSwapchainKHR handle;
 		const VkDevice parent;
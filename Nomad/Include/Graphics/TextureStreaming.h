@@ -0,0 +1,264 @@
+#pragma once
+#include "Graphics/RenderPass.h"
+#include "Graphics/VisibilityBuffer.h"
+#include "GPU/UploadStreamer.h"
+#include "GPU/vk_mem_alloc.h"
+
+#include <vulkan/vulkan_core.h>
+#include <glm/ext/matrix_float4x4.hpp>
+
+#include <array>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace cof
+{
+	struct Shader;
+
+	//Rasterizes VisibilityDraws at a fraction of the screen resolution and writes the finest LOD each material is sampled
+	//at into a buffer, in units of a texture with a single texel. Occluded surfaces request too, which only errs on the side
+	//of streaming in early. The buffer is copied into a ring of readback buffers and read a few frames later, never stalling
+	class TextureFeedbackPass
+	{
+	public:
+		struct Shaders
+		{
+			const cof::Shader& vertex;
+			const cof::Shader& fragment;
+		};
+
+		TextureFeedbackPass(const VkDevice device, VmaAllocator allocator, const Shaders& shaders, VkExtent2D screenExtent, uint32_t feedbackMaterialCount);
+		~TextureFeedbackPass();
+
+		TextureFeedbackPass(const TextureFeedbackPass& other) = delete;
+		TextureFeedbackPass& operator=(const TextureFeedbackPass& other) = delete;
+		TextureFeedbackPass(TextureFeedbackPass&& other) = delete;
+		TextureFeedbackPass& operator=(TextureFeedbackPass&& other) = delete;
+
+		//drawBuffer holds the VisibilityDraws passed to Record
+		void BindScene(VkBuffer drawBuffer);
+
+		//Resets the requests, draws and copies them into this frame's readback buffer
+		void Record(VkCommandBuffer commandBuffer, VkBuffer indexBuffer, const std::vector<VisibilityDraw>& draws, const glm::mat4& viewProjection);
+
+		//LOD per material of the frame recorded readbackLatency Records ago, in units of a texture with a single texel at
+		//full resolution. Materials that weren't seen, and every material before the first readback, hold noRequest
+		const std::vector<float>& Requests();
+
+		//Frames a readback buffer is left alone before it's read, the GPU is done with it by then
+		constexpr static uint32_t readbackLatency{ 2 };
+		//Feedback is rendered at 1 / feedbackDivisor of the screen resolution in both dimensions
+		constexpr static uint32_t feedbackDivisor{ 4 };
+		constexpr static float noRequest{ 1e30f };
+
+		//Matches the encoding in TextureFeedback.glsl
+		constexpr static float lodOffset{ 32.0f };
+		constexpr static float lodScale{ 256.0f };
+		constexpr static uint32_t noFeedback{ 0xffffffff };
+
+	private:
+		RenderPass renderPass;
+		VkFramebuffer framebuffer;
+		VkExtent2D extent;
+
+		VkDescriptorSetLayout descriptorSetLayout;
+		VkPipelineLayout pipelineLayout;
+		VkPipeline pipeline;
+		VkDescriptorPool descriptorPool;
+		VkDescriptorSet descriptorSet;
+
+		VkBuffer feedbackBuffer;
+		VmaAllocation feedbackAllocation;
+		std::array<VkBuffer, readbackLatency + 1> readbackBuffers;
+		std::array<VmaAllocation, readbackLatency + 1> readbackAllocations;
+		std::array<const uint32_t*, readbackLatency + 1> readbackData;
+
+		std::vector<float> requests;
+		uint32_t materialCount;
+		uint64_t recordCount{ 0 };
+		uint64_t readCount{ 0 };
+
+		const VkDevice parent;
+		const VmaAllocator memoryAllocator;
+	};
+
+	//Source of a streamed texture, loadMip returns the tightly packed texels of one mip level, e.g. read from disk.
+	//It's called on the streaming thread
+	struct StreamedTextureInfo
+	{
+		VkFormat format;
+		VkExtent2D extent;
+		uint32_t mipCount;
+		//Material whose feedback drives the texture's residency
+		uint32_t materialIndex;
+		std::function<std::vector<std::byte>(uint32_t mipLevel)> loadMip;
+	};
+
+	struct TextureStreamingStatistics
+	{
+		uint32_t textureCount;
+		//Textures streaming mips in or out right now
+		uint32_t streamingCount;
+		VkDeviceSize residentBytes;
+		VkDeviceSize budgetBytes;
+		//What every texture would take fully resident
+		VkDeviceSize fullBytes;
+		uint64_t streamedInBytes;
+		uint32_t evictionCount;
+
+		void Print() const;
+	};
+
+	//Mip residency of sampled textures driven by TextureFeedbackPass. Textures start with only their tail resident, the mips
+	//of at most tailExtent texels on a side. When feedback asks for finer mips than resident, the texture moves to a new
+	//image holding the requested mip and everything below it. The mips are loaded on a streaming thread and go through the
+	//UploadStreamer coarse to fine.
+	//The old image stays in use until the new one holds the same mips, from then on the view's base mip follows the finest
+	//mip that arrived, which clamps sampling to data that's there. Images that would exceed the VRAM budget first evict the
+	//least recently requested textures down to their tail. A frame's descriptors stay untouched while it's in flight, every
+	//Update moves on to the next of descriptorSetCount sets and only rewrites the views that changed since that set was used.
+	//Needs the descriptorBindingPartiallyBound feature, textures whose tail hasn't arrived have no descriptor
+	class TextureStreamer
+	{
+	public:
+		TextureStreamer(const VkDevice device, VmaAllocator allocator, UploadStreamer& uploadStreamer, uint32_t textureCapacity, VkDeviceSize budgetBytes);
+		//Waits for the mip being loaded, the GPU and the UploadStreamer have to be done with every image
+		~TextureStreamer();
+
+		TextureStreamer(const TextureStreamer& other) = delete;
+		TextureStreamer& operator=(const TextureStreamer& other) = delete;
+		TextureStreamer(TextureStreamer&& other) = delete;
+		TextureStreamer& operator=(TextureStreamer&& other) = delete;
+
+		//Returns the texture's index into the combined image sampler array of DescriptorSet. Its tail is loaded right away,
+		//the texture may be sampled from the first Update after the loaded mips were uploaded and acquired
+		uint32_t AddTexture(StreamedTextureInfo info);
+
+		//Queues the mips loaded since the last call for upload and applies the feedback of TextureFeedbackPass::Requests,
+		//indexed by material, once per frame
+		void Update(const std::vector<float>& requests);
+
+		//Binding 0, a combined image sampler per texture, for the fragment stage
+		VkDescriptorSetLayout DescriptorSetLayout() const noexcept { return descriptorSetLayout; }
+		//The set of the frame recorded after the last Update
+		VkDescriptorSet DescriptorSet() const noexcept { return descriptorSets[frame % descriptorSetCount]; }
+		//Whether the texture has a descriptor in DescriptorSet, draws sampling it have to wait until it does
+		bool Sampleable(uint32_t textureIndex) const noexcept { return textures[textureIndex].current.view != VK_NULL_HANDLE; }
+
+		TextureStreamingStatistics Statistics() const noexcept;
+
+		//Largest side of the mips that stay resident
+		constexpr static uint32_t tailExtent{ 64 };
+		//Replaced images are destroyed after this many Updates, the frames using them have finished by then
+		constexpr static uint32_t retireLatency{ 2 };
+		//The frames using a set have finished once it comes around again, for the same reason as retireLatency
+		constexpr static uint32_t descriptorSetCount{ retireLatency + 1 };
+
+	private:
+		struct MipImage
+		{
+			VkImage image{ VK_NULL_HANDLE };
+			VmaAllocation allocation{ VK_NULL_HANDLE };
+			VkImageView view{ VK_NULL_HANDLE };
+			//Source mip stored in the image's level 0
+			uint32_t baseMip{ 0 };
+			VkDeviceSize bytes{ 0 };
+		};
+
+		struct Texture
+		{
+			StreamedTextureInfo info;
+			uint32_t tailMip;
+			//Memory of an image holding only the tail, what's left after an eviction
+			VkDeviceSize tailBytes;
+			MipImage current;
+			//Finest mip the current view samples
+			uint32_t viewMip;
+			//Image being streamed into
+			MipImage pending;
+			//Upload per mip of the image being filled, pending if there is one and current otherwise, empty once all arrived.
+			//noTicket while the mip is still being loaded
+			std::vector<UploadTicket> tickets;
+			uint32_t requestedMip;
+			uint64_t lastRequestFrame;
+		};
+
+		struct RetiredImage
+		{
+			MipImage image;
+			uint64_t frame;
+		};
+
+		struct MipLoad
+		{
+			uint32_t textureIndex;
+			uint32_t mip;
+			UploadPriority priority;
+		};
+
+		struct LoadedMip
+		{
+			MipLoad load;
+			std::vector<std::byte> texels;
+		};
+
+		//Tails skip the budget and never evict, nothing can be drawn without them
+		bool StartStreaming(uint32_t textureIndex, uint32_t baseMip, UploadPriority priority, bool mayExceedBudget);
+		//Swaps in the pending image and lowers the view's base mip as uploads arrive
+		void Progress(uint32_t textureIndex);
+		//Creates the image without memory, bytes holds its memory requirements
+		MipImage CreateMipImage(const StreamedTextureInfo& info, uint32_t baseMip) const;
+		VkImageView CreateView(const MipImage& image, const StreamedTextureInfo& info, uint32_t viewMip) const;
+		//Brings DescriptorSet up to date with the textures' current views
+		void WriteDescriptors();
+		void Retire(MipImage& image);
+		//Evicts nothing unless the victims free at least bytes together
+		bool EvictFor(VkDeviceSize bytes, uint32_t requester);
+		void LoadMips();
+		void EnqueueLoadedMips();
+
+		//Never completes, UploadStreamer hands out tickets counting up from zero
+		constexpr static UploadTicket noTicket{ ~UploadTicket{ 0 } };
+
+		//Reserved up front, the streaming thread reads the loadMip of existing textures while new ones are added
+		std::vector<Texture> textures;
+		std::vector<RetiredImage> retiredImages;
+
+		VkSampler sampler;
+		VkDescriptorSetLayout descriptorSetLayout;
+		VkDescriptorPool descriptorPool;
+		std::array<VkDescriptorSet, descriptorSetCount> descriptorSets;
+		//View every set's descriptors hold per texture
+		std::array<std::vector<VkImageView>, descriptorSetCount> writtenViews;
+
+		UploadStreamer& uploads;
+		uint32_t maxTextureCount;
+		VkDeviceSize budget;
+		VkDeviceSize residentBytes{ 0 };
+		//Bytes of current images a pending image will replace
+		VkDeviceSize releasingBytes{ 0 };
+		VkDeviceSize fullBytes{ 0 };
+		uint64_t streamedInBytes{ 0 };
+		uint32_t evictionCount{ 0 };
+		uint64_t frame{ 0 };
+
+		//Shared with the streaming thread
+		std::mutex mutex;
+		std::condition_variable wake;
+		std::deque<MipLoad> loadQueue;
+		std::vector<LoadedMip> loadedMips;
+		bool stopping{ false };
+
+		const VkDevice parent;
+		const VmaAllocator memoryAllocator;
+
+		//Last, so it starts once everything it touches exists
+		std::thread streamingThread;
+	};
+}
@@ -2,21 +2,48 @@
 #include <glm/ext/vector_float2.hpp>
 #include <glm/ext/vector_float3.hpp>
 #include <glm/ext/vector_float4.hpp>
+#include <vulkan/vulkan_core.h>
+
+#include <array>
+#include <cstdint>
 
 namespace cof
 {
-	struct BaseUnlitVertex
+	//Packed attribute types, format is how the vertex input stage fetches them
+	struct Unorm16x4
 	{
-		glm::vec3 position;
+		std::array<uint16_t, 4> value;
+		constexpr static VkFormat format{ VK_FORMAT_R16G16B16A16_UNORM };
 	};
 
-	struct UnlitColoredVertex : BaseUnlitVertex
+	struct Snorm16x2
 	{
+		std::array<int16_t, 2> value;
+		constexpr static VkFormat format{ VK_FORMAT_R16G16_SNORM };
+	};
+
+	struct Half2
+	{
+		std::array<uint16_t, 2> value;
+		constexpr static VkFormat format{ VK_FORMAT_R16G16_SFLOAT };
+	};
+
+	struct Unorm8x4
+	{
+		std::array<uint8_t, 4> value;
+		constexpr static VkFormat format{ VK_FORMAT_R8G8B8A8_UNORM };
+	};
+
+	//Standard layout aggregates without base classes, so VertexLayout can take offsetof their members
+	struct UnlitColoredVertex
+	{
+		glm::vec3 position;
 		glm::vec4 color;
 	};
 
-	struct UnlitTexturedVertex : BaseUnlitVertex
+	struct UnlitTexturedVertex
 	{
+		glm::vec3 position;
 		glm::vec2 texCoord;
 	};
 
@@ -25,4 +52,32 @@ namespace cof
 		glm::vec3 position;
 		glm::vec3 normal;
 	};
+
+	struct LitTexturedVertex
+	{
+		glm::vec3 position;
+		glm::vec3 normal;
+		//w holds the bitangent sign
+		glm::vec4 tangent;
+		glm::vec2 texCoord;
+	};
+
+	//Positions are unorm16 within the mesh bounds and need the mesh's QuantizationTransform applied
+	struct QuantizedUnlitColoredVertex
+	{
+		Unorm16x4 position;
+		Unorm8x4 color;
+	};
+	static_assert(sizeof(QuantizedUnlitColoredVertex) == 12);
+
+	struct QuantizedLitVertex
+	{
+		//w holds the bitangent sign, 0 for -1 and 1 for +1
+		Unorm16x4 position;
+		//Octahedral encoded unit vectors
+		Snorm16x2 normal;
+		Snorm16x2 tangent;
+		Half2 texCoord;
+	};
+	static_assert(sizeof(QuantizedLitVertex) == 20);
 }
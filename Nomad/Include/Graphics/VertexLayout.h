@@ -0,0 +1,173 @@
+#pragma once
+#include "Graphics/Vertex.h"
+
+#include <vulkan/vulkan_core.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+//Reflects a vertex struct member, the format follows from the member's type
+#define COF_VERTEX_ATTRIBUTE(Vertex, member) cof::VertexAttribute{ static_cast<uint32_t>(offsetof(Vertex, member)), static_cast<uint32_t>(sizeof(Vertex::member)), cof::AttributeFormat<decltype(Vertex::member)>::value }
+
+namespace cof
+{
+	template<typename Attribute>
+	struct AttributeFormat
+	{
+		constexpr static VkFormat value{ Attribute::format };
+	};
+
+	template<> struct AttributeFormat<float> { constexpr static VkFormat value{ VK_FORMAT_R32_SFLOAT }; };
+	template<> struct AttributeFormat<uint32_t> { constexpr static VkFormat value{ VK_FORMAT_R32_UINT }; };
+	template<> struct AttributeFormat<glm::vec2> { constexpr static VkFormat value{ VK_FORMAT_R32G32_SFLOAT }; };
+	template<> struct AttributeFormat<glm::vec3> { constexpr static VkFormat value{ VK_FORMAT_R32G32B32_SFLOAT }; };
+	template<> struct AttributeFormat<glm::vec4> { constexpr static VkFormat value{ VK_FORMAT_R32G32B32A32_SFLOAT }; };
+
+	struct VertexAttribute
+	{
+		uint32_t offset;
+		uint32_t size;
+		VkFormat format;
+	};
+
+	//Attributes in shader location order, position always comes first
+	template<typename Vertex>
+	struct VertexAttributes;
+
+	template<> struct VertexAttributes<UnlitColoredVertex>
+	{
+		constexpr static std::array attributes{ COF_VERTEX_ATTRIBUTE(UnlitColoredVertex, position), COF_VERTEX_ATTRIBUTE(UnlitColoredVertex, color) };
+	};
+
+	template<> struct VertexAttributes<UnlitTexturedVertex>
+	{
+		constexpr static std::array attributes{ COF_VERTEX_ATTRIBUTE(UnlitTexturedVertex, position), COF_VERTEX_ATTRIBUTE(UnlitTexturedVertex, texCoord) };
+	};
+
+	template<> struct VertexAttributes<BaseLitVertex>
+	{
+		constexpr static std::array attributes{ COF_VERTEX_ATTRIBUTE(BaseLitVertex, position), COF_VERTEX_ATTRIBUTE(BaseLitVertex, normal) };
+	};
+
+	template<> struct VertexAttributes<LitTexturedVertex>
+	{
+		constexpr static std::array attributes
+		{
+			COF_VERTEX_ATTRIBUTE(LitTexturedVertex, position),
+			COF_VERTEX_ATTRIBUTE(LitTexturedVertex, normal),
+			COF_VERTEX_ATTRIBUTE(LitTexturedVertex, tangent),
+			COF_VERTEX_ATTRIBUTE(LitTexturedVertex, texCoord)
+		};
+	};
+
+	template<> struct VertexAttributes<QuantizedUnlitColoredVertex>
+	{
+		constexpr static std::array attributes{ COF_VERTEX_ATTRIBUTE(QuantizedUnlitColoredVertex, position), COF_VERTEX_ATTRIBUTE(QuantizedUnlitColoredVertex, color) };
+	};
+
+	template<> struct VertexAttributes<QuantizedLitVertex>
+	{
+		constexpr static std::array attributes
+		{
+			COF_VERTEX_ATTRIBUTE(QuantizedLitVertex, position),
+			COF_VERTEX_ATTRIBUTE(QuantizedLitVertex, normal),
+			COF_VERTEX_ATTRIBUTE(QuantizedLitVertex, tangent),
+			COF_VERTEX_ATTRIBUTE(QuantizedLitVertex, texCoord)
+		};
+	};
+
+	enum class VertexStreams
+	{
+		//One binding holding whole vertices
+		Interleaved,
+		//One binding per attribute, binding n feeds location n
+		Deinterleaved
+	};
+
+	//Compile time binding and attribute descriptions for the first attributeCount attributes of Vertex,
+	//a deinterleaved layout with an attributeCount of 1 only fetches the position stream
+	template<typename Vertex, VertexStreams streams = VertexStreams::Interleaved, size_t attributeCount = VertexAttributes<Vertex>::attributes.size()>
+	struct VertexLayout
+	{
+		static_assert(attributeCount > 0 && attributeCount <= VertexAttributes<Vertex>::attributes.size());
+		//offsetof is only defined for standard layout types
+		static_assert(std::is_standard_layout_v<Vertex>);
+
+		constexpr static size_t bindingCount{ streams == VertexStreams::Interleaved ? 1 : attributeCount };
+
+		constexpr static std::array<VkVertexInputBindingDescription, bindingCount> bindings = []()
+		{
+			std::array<VkVertexInputBindingDescription, bindingCount> descriptions{};
+			for (uint32_t binding{}; binding < bindingCount; ++binding)
+			{
+				descriptions[binding] = VkVertexInputBindingDescription
+				{
+					.binding = binding,
+					.stride = streams == VertexStreams::Interleaved ? static_cast<uint32_t>(sizeof(Vertex)) : VertexAttributes<Vertex>::attributes[binding].size,
+					.inputRate = VK_VERTEX_INPUT_RATE_VERTEX
+				};
+			}
+			return descriptions;
+		}();
+
+		constexpr static std::array<VkVertexInputAttributeDescription, attributeCount> attributes = []()
+		{
+			std::array<VkVertexInputAttributeDescription, attributeCount> descriptions{};
+			for (uint32_t location{}; location < attributeCount; ++location)
+			{
+				const VertexAttribute& attribute = VertexAttributes<Vertex>::attributes[location];
+				descriptions[location] = VkVertexInputAttributeDescription
+				{
+					.location = location,
+					.binding = streams == VertexStreams::Interleaved ? 0 : location,
+					.format = attribute.format,
+					.offset = streams == VertexStreams::Interleaved ? attribute.offset : 0
+				};
+			}
+			return descriptions;
+		}();
+
+		constexpr static VkPipelineVertexInputStateCreateInfo InputState() noexcept
+		{
+			return VkPipelineVertexInputStateCreateInfo
+			{
+				.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+				.vertexBindingDescriptionCount = static_cast<uint32_t>(bindings.size()),
+				.pVertexBindingDescriptions = bindings.data(),
+				.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributes.size()),
+				.pVertexAttributeDescriptions = attributes.data()
+			};
+		}
+	};
+
+	//Vertex pulling shaders fetch their own vertices, so a single pipeline serves every vertex format
+	constexpr static VkPipelineVertexInputStateCreateInfo pulledVertexInputState
+	{
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO
+	};
+
+	//Splits interleaved vertices into one tightly packed stream per attribute, matching VertexStreams::Deinterleaved
+	template<typename Vertex>
+	std::vector<std::vector<std::byte>> DeinterleaveVertices(const std::vector<Vertex>& vertices)
+	{
+		constexpr auto& attributes = VertexAttributes<Vertex>::attributes;
+
+		std::vector<std::vector<std::byte>> streams(attributes.size());
+		for (size_t attribute{}; attribute < attributes.size(); ++attribute)
+		{
+			streams[attribute].resize(vertices.size() * attributes[attribute].size);
+			for (size_t vertex{}; vertex < vertices.size(); ++vertex)
+			{
+				std::memcpy(streams[attribute].data() + vertex * attributes[attribute].size,
+					reinterpret_cast<const std::byte*>(&vertices[vertex]) + attributes[attribute].offset,
+					attributes[attribute].size);
+			}
+		}
+
+		return streams;
+	}
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include "Graphics/Vertex.h"
+
+#include <glm/ext/matrix_float4x4.hpp>
+
+#include <vector>
+
+namespace cof
+{
+	//Maps unorm16 positions back into the mesh bounds, position = offset + quantized * scale
+	struct QuantizationTransform
+	{
+		glm::vec3 offset;
+		glm::vec3 scale;
+
+		//Meant to be folded into the model matrix, it maps the normalized positions a UNORM vertex fetch returns
+		glm::mat4 Matrix() const noexcept;
+	};
+
+	//Largest error measured by decoding every quantized vertex again
+	struct QuantizationError
+	{
+		float position;
+		float color;
+		float normalDegrees;
+		float tangentDegrees;
+		float texCoord;
+
+		void Print(const char* label, size_t vertexCount, size_t sourceStride, size_t quantizedStride) const;
+	};
+
+	Snorm16x2 EncodeOctahedral(const glm::vec3& unitVector) noexcept;
+	glm::vec3 DecodeOctahedral(const Snorm16x2& encoded) noexcept;
+
+	//Rounds to nearest, so the error per axis stays within half a step of the mesh extent / 65535
+	std::vector<QuantizedUnlitColoredVertex> QuantizeVertices(const std::vector<UnlitColoredVertex>& vertices, QuantizationTransform& transform, QuantizationError& error);
+	std::vector<QuantizedLitVertex> QuantizeVertices(const std::vector<LitTexturedVertex>& vertices, QuantizationTransform& transform, QuantizationError& error);
+}
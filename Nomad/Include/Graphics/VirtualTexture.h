@@ -0,0 +1,273 @@
+#pragma once
+#include "Graphics/DepthBuffer.h"
+#include "Graphics/RenderPass.h"
+#include "Graphics/VisibilityBuffer.h"
+#include "GPU/vk_mem_alloc.h"
+
+#include <vulkan/vulkan_core.h>
+#include <glm/ext/matrix_float4x4.hpp>
+
+#include <array>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace cof
+{
+	struct Shader;
+
+	//Matches VirtualTextureMaterial in VirtualTexture.glsl (std430)
+	struct VirtualTextureMaterial
+	{
+		uint32_t textureIndex;
+		//Pages on a side at mip 0
+		uint32_t pageCount;
+		uint32_t mipCount;
+		uint32_t padding;
+	};
+
+	constexpr uint32_t noVirtualTexture{ 0xffffffff };
+
+	struct VirtualPage
+	{
+		uint32_t textureIndex;
+		uint32_t mip;
+		uint32_t x;
+		uint32_t y;
+	};
+
+	//Matches PackVirtualPage in VirtualTexture.glsl
+	constexpr uint32_t PackVirtualPage(const VirtualPage& page) noexcept
+	{
+		return (page.textureIndex << 26) | (page.mip << 22) | (page.y << 11) | page.x;
+	}
+
+	constexpr VirtualPage UnpackVirtualPage(uint32_t packedPage) noexcept
+	{
+		return VirtualPage{ packedPage >> 26, (packedPage >> 22) & 0xf, packedPage & 0x7ff, (packedPage >> 11) & 0x7ff };
+	}
+
+	//Rasterizes VisibilityDraws depth tested at a fraction of the screen resolution and writes the virtual page each
+	//pixel samples into a buffer. Like TextureFeedbackPass the buffer is read back a few frames later, Requests returns
+	//every page requested that frame once
+	class VirtualTextureFeedbackPass
+	{
+	public:
+		//vertex is TextureFeedback.vert.glsl, fragment VirtualTextureFeedback.frag.glsl
+		struct Shaders
+		{
+			const cof::Shader& vertex;
+			const cof::Shader& fragment;
+		};
+
+		VirtualTextureFeedbackPass(const VkDevice device, VmaAllocator allocator, const Shaders& shaders, VkExtent2D screenExtent);
+		~VirtualTextureFeedbackPass();
+
+		VirtualTextureFeedbackPass(const VirtualTextureFeedbackPass& other) = delete;
+		VirtualTextureFeedbackPass& operator=(const VirtualTextureFeedbackPass& other) = delete;
+		VirtualTextureFeedbackPass(VirtualTextureFeedbackPass&& other) = delete;
+		VirtualTextureFeedbackPass& operator=(VirtualTextureFeedbackPass&& other) = delete;
+
+		//drawBuffer holds the VisibilityDraws passed to Record, materialBuffer a VirtualTextureMaterial per material
+		void BindScene(VkBuffer drawBuffer, VkBuffer materialBuffer);
+
+		void Record(VkCommandBuffer commandBuffer, VkBuffer indexBuffer, const std::vector<VisibilityDraw>& draws, const glm::mat4& viewProjection);
+
+		//Packed VirtualPages of the frame recorded readbackLatency Records ago, each once, empty until then
+		const std::vector<uint32_t>& Requests();
+
+		constexpr static uint32_t readbackLatency{ 2 };
+		//Pages are at least 128 texels, a coarse target still sees every page on screen
+		constexpr static uint32_t feedbackDivisor{ 8 };
+		constexpr static uint32_t noRequest{ 0xffffffff };
+
+	private:
+		DepthBuffer depthBuffer;
+		RenderPass renderPass;
+		VkFramebuffer framebuffer;
+		VkExtent2D extent;
+
+		VkDescriptorSetLayout descriptorSetLayout;
+		VkPipelineLayout pipelineLayout;
+		VkPipeline pipeline;
+		VkDescriptorPool descriptorPool;
+		VkDescriptorSet descriptorSet;
+
+		VkBuffer requestBuffer;
+		VmaAllocation requestAllocation;
+		std::array<VkBuffer, readbackLatency + 1> readbackBuffers;
+		std::array<VmaAllocation, readbackLatency + 1> readbackAllocations;
+		std::array<const uint32_t*, readbackLatency + 1> readbackData;
+
+		std::vector<uint32_t> requests;
+		uint64_t recordCount{ 0 };
+		uint64_t readCount{ 0 };
+
+		const VkDevice parent;
+		const VmaAllocator memoryAllocator;
+	};
+
+	struct VirtualTextureInfo
+	{
+		//Texels on a side at mip 0, a power of two multiple of VirtualTextureCache::pageSize
+		uint32_t extent;
+		//Returns the physicalPageSize squared RGBA8 texels of a page including its border, e.g. decoded from disk.
+		//Called on the streaming thread
+		std::function<std::vector<std::byte>(const VirtualPage& page)> loadPage;
+	};
+
+	struct VirtualTextureStatistics
+	{
+		//Unique page requests looked up in the cache, counting each frame separately
+		uint64_t requestCount;
+		uint64_t hitCount;
+		uint32_t residentPages;
+		uint32_t pageCapacity;
+		uint64_t lastFrameUploadBytes;
+		uint64_t uploadBytes;
+		uint64_t frameCount;
+		VkDeviceSize atlasBytes;
+		VkDeviceSize indirectionBytes;
+		//Host visible staging, not part of the VRAM footprint
+		VkDeviceSize stagingBytes;
+
+		double HitRate() const noexcept { return requestCount == 0 ? 1.0 : static_cast<double>(hitCount) / static_cast<double>(requestCount); }
+		void Print() const;
+	};
+
+	//Virtual texturing without sparse residency. Every virtual texture is cut into pages of pageSize texels per mip, the
+	//resident ones live in slots of a fixed size physical atlas. A mipmapped indirection texture per virtual texture maps
+	//each page to the finest resident page covering it, so missing pages fall back to coarser ones. Feedback requests
+	//pages, misses are decoded on a streaming thread, and the decoded pages are copied into slots freed by LRU on the
+	//graphics queue, together with the indirection texels they change. The coarsest page of every texture is pinned.
+	//Binding 0 of DescriptorSet is the atlas, binding 1 the indirection textures, see SampleVirtualTexture. Textures may be
+	//added while the set is in use, which needs the descriptorBindingSampledImageUpdateAfterBind,
+	//descriptorBindingUpdateUnusedWhilePending and descriptorBindingPartiallyBound features
+	class VirtualTextureCache
+	{
+	public:
+		//atlasPageCount slots on a side, pageUploadsPerFrame bounds the pages RecordUploads copies
+		VirtualTextureCache(const VkDevice device, VmaAllocator allocator, uint32_t atlasPageCount, uint32_t textureCapacity, uint32_t pageUploadsPerFrame);
+		//Waits for the page being decoded, the GPU has to be done with the atlas
+		~VirtualTextureCache();
+
+		VirtualTextureCache(const VirtualTextureCache& other) = delete;
+		VirtualTextureCache& operator=(const VirtualTextureCache& other) = delete;
+		VirtualTextureCache(VirtualTextureCache&& other) = delete;
+		VirtualTextureCache& operator=(VirtualTextureCache&& other) = delete;
+
+		uint32_t AddTexture(VirtualTextureInfo info);
+		//What VirtualTextureFeedbackPass and the shaders sampling the texture need to know about it
+		VirtualTextureMaterial Material(uint32_t textureIndex) const noexcept;
+
+		//Looks the requests of VirtualTextureFeedbackPass::Requests up and queues the missing pages for decoding,
+		//coarse mips first. Pages that weren't decoded yet and aren't requested anymore are dropped
+		void Update(const std::vector<uint32_t>& requests);
+
+		//Copies pages decoded since the last call into the atlas and rewrites the indirection of textures that changed.
+		//A page evicting another is only copied together with the indirection of both textures, pages without the staging
+		//for it wait for the next call. Staging memory is reused after stagingSlots calls, the GPU has to be done with the
+		//command buffer by then
+		void RecordUploads(VkCommandBuffer commandBuffer);
+
+		VkDescriptorSetLayout DescriptorSetLayout() const noexcept { return descriptorSetLayout; }
+		VkDescriptorSet DescriptorSet() const noexcept { return descriptorSet; }
+		//Whether the texture's indirection was written by a RecordUploads, draws sampling it have to wait until it was
+		bool Sampleable(uint32_t textureIndex) const noexcept { return textures[textureIndex].indirectionInitialized; }
+		VirtualTextureStatistics Statistics() const noexcept;
+
+		constexpr static uint32_t pageSize{ 128 };
+		//Texels of the neighbouring pages around every page, enough for bilinear filtering
+		constexpr static uint32_t pageBorder{ 4 };
+		constexpr static uint32_t physicalPageSize{ pageSize + 2 * pageBorder };
+		constexpr static VkDeviceSize pageBytes{ physicalPageSize * physicalPageSize * 4 };
+		constexpr static VkFormat atlasFormat{ VK_FORMAT_R8G8B8A8_SRGB };
+		//Bounded by the bits of a packed VirtualPage, and by the staging reserved for rewritten indirection textures
+		constexpr static uint32_t maxTextureCount{ 64 };
+		constexpr static uint32_t maxPageCount{ 512 };
+		constexpr static uint32_t stagingSlots{ 2 };
+
+	private:
+		struct Slot
+		{
+			uint32_t page{ noPage };
+			uint64_t lastUsedFrame{ 0 };
+			bool pinned{ false };
+		};
+
+		struct Texture
+		{
+			VirtualTextureInfo info;
+			uint32_t pageCount;
+			uint32_t mipCount;
+			VkImage indirectionImage;
+			VmaAllocation indirectionAllocation;
+			VkImageView indirectionView;
+			bool indirectionInitialized;
+		};
+
+		struct DecodedPage
+		{
+			uint32_t page;
+			std::vector<std::byte> texels;
+		};
+
+		void StreamPages();
+		//Free slot or the least recently used one, noSlot when every slot is pinned or used this frame
+		uint32_t AllocateSlot();
+		bool IsPinned(uint32_t packedPage) const noexcept;
+
+		constexpr static uint32_t noPage{ 0xffffffff };
+		constexpr static uint32_t noSlot{ 0xffffffff };
+
+		//Reserved up front, the streaming thread reads the loadPage of existing textures while new ones are added
+		std::vector<Texture> textures;
+		std::vector<Slot> slots;
+		//Packed page to slot
+		std::unordered_map<uint32_t, uint32_t> residentPages;
+		//Queued, being decoded or decoded but not copied yet
+		std::unordered_set<uint32_t> loadingPages;
+
+		VkImage atlasImage;
+		VmaAllocation atlasAllocation;
+		VkImageView atlasView;
+		bool atlasInitialized{ false };
+		VkSampler atlasSampler;
+		VkSampler indirectionSampler;
+		VkDescriptorSetLayout descriptorSetLayout;
+		VkDescriptorPool descriptorPool;
+		VkDescriptorSet descriptorSet;
+
+		VkBuffer stagingBuffer;
+		VmaAllocation stagingAllocation;
+		std::byte* stagingData;
+		VkDeviceSize stagingSlotSize;
+		uint64_t uploadCount{ 0 };
+
+		uint32_t atlasPagesPerSide;
+		uint32_t maxTextures;
+		uint32_t maxPageUploads;
+		uint64_t frame{ 0 };
+		VirtualTextureStatistics statistics{};
+
+		//Shared with the streaming thread
+		std::mutex mutex;
+		std::condition_variable wake;
+		std::deque<uint32_t> loadQueue;
+		std::vector<DecodedPage> decodedPages;
+		bool stopping{ false };
+
+		const VkDevice parent;
+		const VmaAllocator memoryAllocator;
+
+		//Last, so it starts once everything it touches exists
+		std::thread streamingThread;
+	};
+}
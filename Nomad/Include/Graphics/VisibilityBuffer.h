@@ -0,0 +1,124 @@
+#pragma once
+#include "GPU/vk_mem_alloc.h"
+
+#include <vulkan/vulkan_core.h>
+#include <glm/ext/matrix_float4x4.hpp>
+#include <glm/ext/vector_float3.hpp>
+#include <glm/ext/vector_float4.hpp>
+
+#include <cstdint>
+#include <vector>
+
+namespace cof
+{
+	struct Shader;
+
+	//Matches VisibilityDraw in VisibilityBuffer.glsl (std430), vertices are QuantizedLitVertex
+	struct VisibilityDraw
+	{
+		glm::mat4 model;
+		//QuantizationTransform of the mesh, w unused
+		glm::vec4 dequantizeOffset;
+		glm::vec4 dequantizeScale;
+		VkDeviceAddress vertices;
+		//Indices relative to vertices, firstIndex locates the same indices in the index buffer used by RecordGeometry
+		VkDeviceAddress indices;
+		uint32_t indexCount;
+		uint32_t firstIndex;
+		uint32_t materialIndex;
+		uint32_t padding;
+	};
+	static_assert(sizeof(VisibilityDraw) == 128);
+
+	struct VisibilityMaterial
+	{
+		glm::vec4 baseColor;
+	};
+
+	//Rasterizes (draw index, triangle index) per pixel, then classifies 8x8 tiles by material and
+	//shades each pixel once per material with attributes rebuilt from analytic barycentrics.
+	//Shading cost no longer depends on overdraw or on how many triangles cover a pixel.
+	//The triangle index is gl_PrimitiveID, which needs the geometryShader feature enabled on the device
+	class VisibilityBuffer
+	{
+	public:
+		struct Shaders
+		{
+			const cof::Shader& geometryVertex;
+			const cof::Shader& geometryFragment;
+			const cof::Shader& classify;
+			const cof::Shader& resolve;
+		};
+
+		VisibilityBuffer(	const VkDevice device,
+							const VkPhysicalDeviceFeatures& enabledFeatures,
+							VmaAllocator allocator,
+							const VkExtent2D bufferExtent,
+							const Shaders& shaders,
+							const bool reversedZ);
+		~VisibilityBuffer();
+
+		VisibilityBuffer(const VisibilityBuffer& other) = delete;
+		VisibilityBuffer& operator=(const VisibilityBuffer& other) = delete;
+		VisibilityBuffer(VisibilityBuffer&& other) = delete;
+		VisibilityBuffer& operator=(VisibilityBuffer&& other) = delete;
+
+		//drawBuffer holds the VisibilityDraws passed to RecordGeometry, materialBuffer materialCount VisibilityMaterials
+		void BindScene(VkBuffer drawBuffer, VkBuffer materialBuffer, uint32_t materialCount);
+
+		//Leaves the visibility image in VK_IMAGE_LAYOUT_GENERAL and depth in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL.
+		//Every draw may have at most 2^triangleIdBits triangles
+		void RecordGeometry(VkCommandBuffer commandBuffer, VkBuffer indexBuffer, const std::vector<VisibilityDraw>& draws, const glm::mat4& viewProjection) const;
+
+		//Leaves the shaded image in VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, ready to be blitted to the swapchain.
+		//lightDirection is the direction the light travels in, ambient is added to the diffuse term
+		void RecordResolve(VkCommandBuffer commandBuffer, const glm::mat4& viewProjection, const glm::vec3& lightDirection, float ambient) const;
+
+		VkImage ShadedImage() const noexcept { return shadedImage; }
+		VkImageView DepthView() const noexcept { return depthView; }
+		VkImageView VisibilityView() const noexcept { return visibilityView; }
+		VkExtent2D Extent() const noexcept { return extent; }
+
+		constexpr static uint32_t triangleIdBits{ 23 };
+		constexpr static uint32_t maxDrawCount{ (1u << (32 - triangleIdBits)) - 1 };
+		constexpr static uint32_t maxMaterialCount{ 32 };
+		constexpr static uint32_t tileSize{ 8 };
+		constexpr static uint32_t emptyVisibility{ 0xffffffff };
+
+	private:
+		VkImage visibilityImage;
+		VmaAllocation visibilityAllocation;
+		VkImageView visibilityView;
+		VkImage depthImage;
+		VmaAllocation depthAllocation;
+		VkImageView depthView;
+		VkImage shadedImage;
+		VmaAllocation shadedAllocation;
+		VkImageView shadedView;
+
+		VkBuffer tileListBuffer;
+		VmaAllocation tileListAllocation;
+		VkBuffer materialDispatchBuffer;
+		VmaAllocation materialDispatchAllocation;
+
+		VkRenderPass renderPass;
+		VkFramebuffer framebuffer;
+
+		VkDescriptorSetLayout descriptorSetLayout;
+		VkPipelineLayout pipelineLayout;
+		VkPipeline geometryPipeline;
+		VkPipeline classifyPipeline;
+		VkPipeline resolvePipeline;
+		VkDescriptorPool descriptorPool;
+		VkDescriptorSet descriptorSet;
+
+		VkExtent2D extent;
+		uint32_t tileCountX;
+		uint32_t tileCountY;
+		uint32_t boundMaterialCount{ 0 };
+		bool reversedDepth;
+
+		const VkDevice parent;
+		const VmaAllocator memoryAllocator;
+	};
+}
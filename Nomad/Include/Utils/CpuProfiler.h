@@ -0,0 +1,83 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define COF_HAS_RDTSC 1
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#define COF_HAS_RDTSC 1
+#endif
+
+namespace cof
+{
+	//Raw timestamp of CPU zones, the time stamp counter where there is one, steady_clock nanoseconds otherwise.
+	//Only converted to time when a trace is written
+	inline uint64_t CpuTicks() noexcept
+	{
+#if defined(COF_HAS_RDTSC)
+		return __rdtsc();
+#else
+		return static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+	}
+
+	//Interval on a track of its own next to the CPU threads in a trace, e.g. GPU work. Placed relative to a CPU timestamp
+	struct TraceEvent
+	{
+		std::string name;
+		std::string track;
+		uint64_t anchorTicks;
+		double beginMicroseconds;
+		double durationMicroseconds;
+	};
+
+	//Appends a zone to the calling thread's event buffer. Every thread owns a ring of its own, so recording takes no
+	//lock, only the first zone of a thread registers the ring. name has to outlive the trace, e.g. a string literal
+	void RecordCpuZone(const char* name, uint64_t beginTicks, uint64_t endTicks) noexcept;
+	void SetCpuThreadName(std::string_view name);
+
+	//Writes the zones every thread recorded, the most recent cpuZoneCapacity per thread, and extraEvents as Chrome trace
+	//JSON, which chrome://tracing and Perfetto open. Zones a thread overwrites while the trace is written are left out
+	bool WriteChromeTrace(const char* path, const std::vector<TraceEvent>& extraEvents = {});
+
+	constexpr uint32_t cpuZoneCapacity{ 1 << 16 };
+
+	//Times its own lifetime, use CPU_ZONE instead so zones compile out without NOMAD_CPU_PROFILER
+	class CpuZone
+	{
+	public:
+		explicit CpuZone(const char* zoneName) noexcept
+			: name{ zoneName }
+			, beginTicks{ CpuTicks() }
+		{
+		}
+
+		~CpuZone()
+		{
+			RecordCpuZone(name, beginTicks, CpuTicks());
+		}
+
+		CpuZone(const CpuZone& other) = delete;
+		CpuZone& operator=(const CpuZone& other) = delete;
+		CpuZone(CpuZone&& other) = delete;
+		CpuZone& operator=(CpuZone&& other) = delete;
+
+	private:
+		const char* name;
+		uint64_t beginTicks;
+	};
+}
+
+#define COF_ZONE_CONCAT_IMPL(a, b) a##b
+#define COF_ZONE_CONCAT(a, b) COF_ZONE_CONCAT_IMPL(a, b)
+
+#if defined(NOMAD_CPU_PROFILER)
+#define CPU_ZONE(name) const cof::CpuZone COF_ZONE_CONCAT(cpuZone, __LINE__){ name }
+#else
+#define CPU_ZONE(name) ((void)0)
+#endif
@@ -0,0 +1,26 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <vector>
+
+namespace cof
+{
+	//RGBA8 texels, rows from top to bottom without padding
+	struct Image
+	{
+		uint32_t width;
+		uint32_t height;
+		std::vector<std::byte> texels;
+	};
+
+	//The image formats glTF references, JPEG through libjpeg and PNG through libpng.
+	//Gray and palette images expand to RGB, 16 bit channels keep their high byte and images without alpha get an opaque one.
+	//Malformed or truncated data gives nullopt
+	std::optional<Image> DecodeImage(const std::vector<std::byte>& data);
+	std::optional<Image> LoadImageFile(const std::filesystem::path& path);
+
+	//Next mip level, every texel averages up to 2x2 texels of image. Color is averaged as linear light, alpha as is
+	Image DownsampleImage(const Image& image);
+}
@@ -0,0 +1,115 @@
+#include "GPU/AsyncCompute.h"
+
+#include <vulkan/vulkan_core.h>
+
+#include <cstdio>
+#include <vector>
+
+namespace cof
+{
+	static void RecordOwnershipBarrier(VkCommandBuffer commandBuffer,
+									   const std::vector<VkBuffer>& buffers,
+									   uint32_t srcQueueFamily,
+									   uint32_t dstQueueFamily,
+									   VkPipelineStageFlags srcStages,
+									   VkAccessFlags srcAccess,
+									   VkPipelineStageFlags dstStages,
+									   VkAccessFlags dstAccess)
+	{
+		if (srcQueueFamily == dstQueueFamily || buffers.empty())
+		{
+			return;
+		}
+
+		std::vector<VkBufferMemoryBarrier> bufferBarriers;
+		bufferBarriers.reserve(buffers.size());
+		for (VkBuffer buffer : buffers)
+		{
+			bufferBarriers.push_back(VkBufferMemoryBarrier
+			{
+				.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+				.srcAccessMask = srcAccess,
+				.dstAccessMask = dstAccess,
+				.srcQueueFamilyIndex = srcQueueFamily,
+				.dstQueueFamilyIndex = dstQueueFamily,
+				.buffer = buffer,
+				.offset = 0,
+				.size = VK_WHOLE_SIZE
+			});
+		}
+
+		vkCmdPipelineBarrier(commandBuffer, srcStages, dstStages, 0, 0, nullptr,
+			static_cast<uint32_t>(bufferBarriers.size()), bufferBarriers.data(), 0, nullptr);
+	}
+
+	void RecordBufferRelease(VkCommandBuffer commandBuffer,
+							 const std::vector<VkBuffer>& buffers,
+							 uint32_t srcQueueFamily,
+							 uint32_t dstQueueFamily,
+							 VkPipelineStageFlags srcStages,
+							 VkAccessFlags srcAccess)
+	{
+		//The destination half of a release is ignored, the semaphore carries the dependency to the other queue
+		RecordOwnershipBarrier(commandBuffer, buffers, srcQueueFamily, dstQueueFamily, srcStages, srcAccess, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0);
+	}
+
+	void RecordBufferAcquire(VkCommandBuffer commandBuffer,
+							 const std::vector<VkBuffer>& buffers,
+							 uint32_t srcQueueFamily,
+							 uint32_t dstQueueFamily,
+							 VkPipelineStageFlags dstStages,
+							 VkAccessFlags dstAccess)
+	{
+		//Likewise the source half of an acquire, its stages only have to match the semaphore wait
+		RecordOwnershipBarrier(commandBuffer, buffers, srcQueueFamily, dstQueueFamily, dstStages, 0, dstStages, dstAccess);
+	}
+
+	void QueueOverlapSamples::AddTimestamps(const uint64_t (&timestamps)[4], float timestampPeriod) noexcept
+	{
+		//Only timestamps of the same queue are subtracted
+		const double nanosecondsToMilliseconds{ static_cast<double>(timestampPeriod) * 1e-6 };
+		graphicsMilliseconds += static_cast<double>(timestamps[1] - timestamps[0]) * nanosecondsToMilliseconds;
+		computeMilliseconds += static_cast<double>(timestamps[3] - timestamps[2]) * nanosecondsToMilliseconds;
+		++timestampFrames;
+	}
+
+	void QueueOverlapSamples::AddFrame(bool serialized, double wallMilliseconds) noexcept
+	{
+		if (serialized)
+		{
+			serializedMilliseconds += wallMilliseconds;
+			++serializedFrames;
+		}
+		else
+		{
+			overlappedMilliseconds += wallMilliseconds;
+			++overlappedFrames;
+		}
+	}
+
+	static double Average(double sum, uint32_t count) noexcept
+	{
+		return count == 0 ? 0.0 : sum / static_cast<double>(count);
+	}
+
+	QueueOverlap MeasureQueueOverlap(const QueueOverlapSamples& samples) noexcept
+	{
+		QueueOverlap overlap
+		{
+			.graphicsMilliseconds = Average(samples.graphicsMilliseconds, samples.timestampFrames),
+			.computeMilliseconds = Average(samples.computeMilliseconds, samples.timestampFrames),
+			.overlappedMilliseconds = Average(samples.overlappedMilliseconds, samples.overlappedFrames),
+			.serializedMilliseconds = Average(samples.serializedMilliseconds, samples.serializedFrames)
+		};
+		//Negative when the second submit costs more than the overlap wins, left as is so it shows up in the report
+		overlap.savedMilliseconds = overlap.serializedMilliseconds - overlap.overlappedMilliseconds;
+
+		return overlap;
+	}
+
+	void QueueOverlap::Print() const
+	{
+		printf("Graphics %.3f ms, compute %.3f ms on the GPU. Frame %.3f ms overlapped, %.3f ms serialized, %.3f ms saved by overlap\n",
+			graphicsMilliseconds, computeMilliseconds, overlappedMilliseconds, serializedMilliseconds, savedMilliseconds);
+	}
+}
@@ -0,0 +1,90 @@
+#include "GPU/AttachmentMemory.h"
+
+#include <vulkan/vulkan_core.h>
+
+#include <algorithm>
+#include <assert.h>
+#include <iterator>
+#include <numeric>
+
+namespace cof
+{
+	bool CreateAttachmentImage(VmaAllocator allocator, const VkImageCreateInfo& imageInfo, VkImage& image, VmaAllocation& allocation)
+	{
+		[[maybe_unused]] VkResult errorCode{ VK_RESULT_MAX_ENUM };
+
+		if (imageInfo.usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT)
+		{
+			VmaAllocationCreateInfo lazyAllocInfo
+			{
+				.usage = VMA_MEMORY_USAGE_UNKNOWN,
+				.requiredFlags = VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT
+			};
+
+			//VMA destroys the image again when no memory type is lazily allocated
+			if (vmaCreateImage(allocator, &imageInfo, &lazyAllocInfo, &image, &allocation, nullptr) == VK_SUCCESS)
+			{
+				return true;
+			}
+		}
+
+		VmaAllocationCreateInfo imageAllocInfo
+		{
+			.usage = VMA_MEMORY_USAGE_GPU_ONLY
+		};
+
+		errorCode = vmaCreateImage(allocator, &imageInfo, &imageAllocInfo, &image, &allocation, nullptr);
+		assert(errorCode == VK_SUCCESS);
+		return false;
+	}
+
+	VkDeviceSize PlaceAliasedImages(const std::vector<AliasedImage>& images, std::vector<VkDeviceSize>& offsets)
+	{
+		std::vector<uint32_t> order(images.size());
+		std::iota(order.begin(), order.end(), 0);
+		std::stable_sort(order.begin(), order.end(), [&images](uint32_t lhs, uint32_t rhs) { return images[lhs].size > images[rhs].size; });
+
+		offsets.assign(images.size(), 0);
+		std::vector<uint32_t> placed;
+		VkDeviceSize allocationSize{ 0 };
+
+		for (uint32_t image : order)
+		{
+			const AliasedImage& current{ images[image] };
+			auto AlignUp = [&current](VkDeviceSize offset) { return (offset + current.alignment - 1) / current.alignment * current.alignment; };
+
+			std::vector<uint32_t> live;
+			std::copy_if(placed.begin(), placed.end(), std::back_inserter(live), [&images, &current](uint32_t other)
+			{
+				return images[other].firstLevel <= current.lastLevel && current.firstLevel <= images[other].lastLevel;
+			});
+
+			//The lowest fitting offset is either the start of the allocation or right behind an image that is alive at the same time
+			std::vector<VkDeviceSize> candidates{ 0 };
+			for (uint32_t other : live)
+			{
+				candidates.push_back(AlignUp(offsets[other] + images[other].size));
+			}
+			std::sort(candidates.begin(), candidates.end());
+
+			for (VkDeviceSize candidate : candidates)
+			{
+				const bool fits = std::none_of(live.begin(), live.end(), [&](uint32_t other)
+				{
+					return candidate < offsets[other] + images[other].size && offsets[other] < candidate + current.size;
+				});
+
+				if (fits)
+				{
+					offsets[image] = candidate;
+					break;
+				}
+			}
+
+			placed.push_back(image);
+			allocationSize = std::max(allocationSize, offsets[image] + current.size);
+		}
+
+		return allocationSize;
+	}
+}
@@ -2,6 +2,7 @@
 #include "Utils/Utils.h"
 #include "Utils/VulkanUtils.h"
 
+#include <array>
 #include <cstdint>
 #include <cstdio>
 #include <cstddef>
@@ -21,7 +22,8 @@ namespace cof
 	GPUContext::GPUContext(	const VkInstance instance, 
 							const uint64_t desiredFeaturesBitMask, 
 							const VkQueueFlags desiredQueueFamilies, 
-							const std::vector<const char*>& desiredExtensions)
+							const std::vector<const char*>& desiredExtensions,
+							const void* desiredFeatureChain)
 		: physicalDevice{ RequestPhysicalDevice(instance, desiredFeaturesBitMask) }
 	{
 
@@ -109,21 +111,12 @@ namespace cof
 		{
 			assert(IsExtensionSupported(availableDeviceExtensions, desiredExtension));
 		}
-		VkPhysicalDeviceFeatures physicalDeviceFeatures;
-		vkGetPhysicalDeviceFeatures(physicalDevice, &physicalDeviceFeatures);
-		auto deviceFeaturesArray = cof::ArrayCast<VkBool32>(physicalDeviceFeatures);
-		for (size_t currentBit{}; currentBit < deviceFeaturesArray.size(); ++currentBit)
-		{
-			constexpr static uint64_t maskChecker{ 1 };
-			deviceFeaturesArray[currentBit] = (desiredFeaturesBitMask >> currentBit) & maskChecker;
-		}
-
-		VkPhysicalDeviceFeatures enabledDeviceFeatures = cof::ReverseArrayCast<VkPhysicalDeviceFeatures>(deviceFeaturesArray);
+		enabledFeatures = FeaturesFromBitMask(desiredFeaturesBitMask);
 
 		VkDeviceCreateInfo deviceCreateInfo
 		{
 			VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,							
-			nullptr,														
+			desiredFeatureChain,														
 			0,																
 			static_cast<uint32_t>(queueCreateInfos.size()),
 			queueCreateInfos.data(),
@@ -131,7 +124,7 @@ namespace cof
 			nullptr,														
 			static_cast<uint32_t>(desiredExtensions.size()),		
 			desiredExtensions.data(),
-			&enabledDeviceFeatures
+			&enabledFeatures
 		};
 
 		result = vkCreateDevice(physicalDevice, &deviceCreateInfo, nullptr, &logicalDevice);
@@ -169,13 +162,7 @@ namespace cof
 			vkGetPhysicalDeviceFeatures(physicalDeviceCandidate, &physicalDeviceCandidateFeatures);
 			vkGetPhysicalDeviceProperties(physicalDeviceCandidate, &physicalDeviceCandidateProperties);
 
-			uint64_t deviceFeaturesBitMask{};
-			auto deviceFeaturesArray = cof::ArrayCast<VkBool32>(physicalDeviceCandidateFeatures);
-
-			for (std::size_t currentBit{}; currentBit < deviceFeaturesArray.size(); ++currentBit)
-			{
-				deviceFeaturesBitMask |= static_cast<uint64_t>(deviceFeaturesArray[currentBit]) << currentBit;
-			}
+			const uint64_t deviceFeaturesBitMask{ FeaturesBitMask(physicalDeviceCandidateFeatures) };
 
 			if ((deviceFeaturesBitMask & desiredFeaturesBitMask) != desiredFeaturesBitMask)
 			{
@@ -193,6 +180,31 @@ namespace cof
 		return selectedDevice;
 	}
 
+	static_assert(sizeof(VkPhysicalDeviceFeatures) / sizeof(VkBool32) <= 64, "Every feature needs a bit of the mask");
+
+	uint64_t FeaturesBitMask(const VkPhysicalDeviceFeatures& features) noexcept
+	{
+		const auto featuresArray = cof::ArrayCast<VkBool32>(features);
+
+		uint64_t featuresBitMask{};
+		for (std::size_t currentBit{}; currentBit < featuresArray.size(); ++currentBit)
+		{
+			featuresBitMask |= static_cast<uint64_t>(featuresArray[currentBit]) << currentBit;
+		}
+		return featuresBitMask;
+	}
+
+	VkPhysicalDeviceFeatures FeaturesFromBitMask(const uint64_t featuresBitMask) noexcept
+	{
+		std::array<VkBool32, sizeof(VkPhysicalDeviceFeatures) / sizeof(VkBool32)> featuresArray;
+		for (size_t currentBit{}; currentBit < featuresArray.size(); ++currentBit)
+		{
+			constexpr static uint64_t maskChecker{ 1 };
+			featuresArray[currentBit] = static_cast<VkBool32>((featuresBitMask >> currentBit) & maskChecker);
+		}
+		return cof::ReverseArrayCast<VkPhysicalDeviceFeatures>(featuresArray);
+	}
+
 	const uint32_t GetGraphicsQueueFamilyIndex(const std::vector<VkQueueFamilyProperties>& queueFamilies)
 	{
 		for (size_t i{}; i < queueFamilies.size(); ++i)
@@ -0,0 +1,89 @@
+#include "GPU/GeometryBuffer.h"
+#include "GPU/GPUContext.h"
+
+#include <vulkan/vulkan_core.h>
+
+#include <limits>
+#include <assert.h>
+
+namespace cof
+{
+	GeometryBuffer::GeometryBuffer(const cof::GPUContext& gpuContext, VkDeviceSize bufferCapacity)
+		: capacity{ bufferCapacity }, parent{ gpuContext.LogicalDevice() }
+	{
+		[[maybe_unused]] VkResult errorCode{ VK_RESULT_MAX_ENUM };
+
+		VkBufferCreateInfo bufferInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+			.size = bufferCapacity,
+			.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+			.sharingMode = VK_SHARING_MODE_EXCLUSIVE
+		};
+
+		errorCode = vkCreateBuffer(parent, &bufferInfo, nullptr, &handle);
+		assert(errorCode == VK_SUCCESS);
+
+		VkMemoryRequirements memoryRequirements;
+		vkGetBufferMemoryRequirements(parent, handle, &memoryRequirements);
+
+		VkPhysicalDeviceMemoryProperties memoryProperties;
+		vkGetPhysicalDeviceMemoryProperties(gpuContext.PhysicalDevice(), &memoryProperties);
+
+		uint32_t memoryTypeIndex{ std::numeric_limits<uint32_t>::max() };
+		for (uint32_t memoryType{}; memoryType < memoryProperties.memoryTypeCount; ++memoryType)
+		{
+			if ((memoryRequirements.memoryTypeBits & (1u << memoryType)) && (memoryProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT))
+			{
+				memoryTypeIndex = memoryType;
+				break;
+			}
+		}
+		assert(memoryTypeIndex != std::numeric_limits<uint32_t>::max());
+
+		VkMemoryAllocateFlagsInfo allocateFlagsInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO,
+			.flags = VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT
+		};
+
+		VkMemoryAllocateInfo allocateInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+			.pNext = &allocateFlagsInfo,
+			.allocationSize = memoryRequirements.size,
+			.memoryTypeIndex = memoryTypeIndex
+		};
+
+		errorCode = vkAllocateMemory(parent, &allocateInfo, nullptr, &memory);
+		assert(errorCode == VK_SUCCESS);
+
+		errorCode = vkBindBufferMemory(parent, handle, memory, 0);
+		assert(errorCode == VK_SUCCESS);
+
+		VkBufferDeviceAddressInfo addressInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO,
+			.buffer = handle
+		};
+
+		deviceAddress = vkGetBufferDeviceAddress(parent, &addressInfo);
+	}
+
+	GeometryBuffer::~GeometryBuffer()
+	{
+		vkDestroyBuffer(parent, handle, nullptr);
+		vkFreeMemory(parent, memory, nullptr);
+	}
+
+	VkDeviceSize GeometryBuffer::Allocate(VkDeviceSize allocationSize, VkDeviceSize alignment)
+	{
+		assert(alignment != 0 && (alignment & (alignment - 1)) == 0);
+
+		const VkDeviceSize offset{ (size + alignment - 1) & ~(alignment - 1) };
+		assert(offset + allocationSize <= capacity);
+
+		size = offset + allocationSize;
+		return offset;
+	}
+}
@@ -0,0 +1,462 @@
+#include "GPU/GpuProfiler.h"
+
+#include <algorithm>
+#include <assert.h>
+#include <cstdio>
+
+namespace cof
+{
+	//Bit order is the order the counters are written in, see PipelineStatistics
+	constexpr static VkQueryPipelineStatisticFlags statisticFlags
+	{
+		VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT |
+		VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT |
+		VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+		VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT |
+		VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+		VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT |
+		VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT
+	};
+	static_assert(sizeof(PipelineStatistics) == 7 * sizeof(uint64_t));
+
+	PipelineStatistics& PipelineStatistics::operator+=(const PipelineStatistics& other) noexcept
+	{
+		inputAssemblyVertices += other.inputAssemblyVertices;
+		inputAssemblyPrimitives += other.inputAssemblyPrimitives;
+		vertexShaderInvocations += other.vertexShaderInvocations;
+		clippingInvocations += other.clippingInvocations;
+		clippingPrimitives += other.clippingPrimitives;
+		fragmentShaderInvocations += other.fragmentShaderInvocations;
+		computeShaderInvocations += other.computeShaderInvocations;
+		return *this;
+	}
+
+	//Nearest rank on a sorted range
+	static double Percentile(const std::vector<double>& sorted, double percentile) noexcept
+	{
+		const size_t rank{ static_cast<size_t>(percentile * static_cast<double>(sorted.size() - 1) + 0.5) };
+		return sorted[std::min(rank, sorted.size() - 1)];
+	}
+
+	GpuProfiler::GpuProfiler(const VkDevice device, const VkPhysicalDevice physicalDevice, uint32_t queueFamilyIndex, uint32_t frameSlotCount, bool pipelineStatistics, uint32_t maxScopesPerFrame)
+		: frameSlots(frameSlotCount)
+		, maxQueries{ maxScopesPerFrame * 2 }
+		, collectStatistics{ pipelineStatistics }
+		, parent{ device }
+	{
+		assert(frameSlotCount != 0);
+
+		VkPhysicalDeviceProperties physicalDeviceProperties;
+		vkGetPhysicalDeviceProperties(physicalDevice, &physicalDeviceProperties);
+		timestampPeriod = static_cast<double>(physicalDeviceProperties.limits.timestampPeriod);
+
+		uint32_t queueFamilyCount{ 0 };
+		vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+		std::vector<VkQueueFamilyProperties> queueFamilyProperties{ queueFamilyCount };
+		vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilyProperties.data());
+		timestampValidBits = queueFamilyProperties[queueFamilyIndex].timestampValidBits;
+
+		VkQueryPoolCreateInfo queryPoolInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+			.queryType = VK_QUERY_TYPE_TIMESTAMP,
+			.queryCount = maxQueries
+		};
+
+		//A scope has a segment of its own and one more after each nested scope, which is bounded by the timestamp count
+		VkQueryPoolCreateInfo statisticsPoolInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+			.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS,
+			.queryCount = maxQueries,
+			.pipelineStatistics = statisticFlags
+		};
+
+		collectStatistics = collectStatistics && Enabled();
+
+		for (FrameSlot& slot : frameSlots)
+		{
+			slot.queryPool = VK_NULL_HANDLE;
+			slot.statisticsPool = VK_NULL_HANDLE;
+			if (Enabled())
+			{
+				[[maybe_unused]] VkResult errorCode = vkCreateQueryPool(parent, &queryPoolInfo, nullptr, &slot.queryPool);
+				assert(errorCode == VK_SUCCESS);
+			}
+			if (collectStatistics)
+			{
+				[[maybe_unused]] VkResult errorCode = vkCreateQueryPool(parent, &statisticsPoolInfo, nullptr, &slot.statisticsPool);
+				assert(errorCode == VK_SUCCESS);
+				slot.segments.reserve(maxQueries);
+			}
+			slot.scopes.reserve(maxScopesPerFrame);
+		}
+
+		queryResults.resize(maxQueries);
+		statisticsResults.resize(collectStatistics ? maxQueries : 0);
+	}
+
+	GpuProfiler::~GpuProfiler()
+	{
+		for (FrameSlot& slot : frameSlots)
+		{
+			vkDestroyQueryPool(parent, slot.queryPool, nullptr);
+			vkDestroyQueryPool(parent, slot.statisticsPool, nullptr);
+		}
+	}
+
+	void GpuProfiler::BeginFrame(VkCommandBuffer commandBuffer, uint32_t frameSlot)
+	{
+		assert(openScopes.empty());
+		if (!Enabled())
+		{
+			return;
+		}
+
+		currentSlot = &frameSlots[frameSlot];
+		ReadBack(*currentSlot);
+
+		currentSlot->scopes.clear();
+		currentSlot->segments.clear();
+		currentSlot->queryCount = 0;
+		currentSlot->submitTicks = 0;
+		vkCmdResetQueryPool(commandBuffer, currentSlot->queryPool, 0, maxQueries);
+		if (collectStatistics)
+		{
+			vkCmdResetQueryPool(commandBuffer, currentSlot->statisticsPool, 0, maxQueries);
+		}
+	}
+
+	void GpuProfiler::BeginScope(VkCommandBuffer commandBuffer, std::string_view name, VkPipelineStageFlagBits stage)
+	{
+		if (!Enabled())
+		{
+			return;
+		}
+		assert(currentSlot != nullptr);
+
+		const uint32_t node{ FindNode(openScopes.empty() ? noParent : openScopes.back().node, name) };
+		const uint32_t parentScope{ openScopes.empty() ? noScope : openScopes.back().scope };
+		uint32_t scope{ noScope };
+
+		if (currentSlot->queryCount + 2 <= maxQueries)
+		{
+			scope = static_cast<uint32_t>(currentSlot->scopes.size());
+			currentSlot->scopes.push_back(RecordedScope{ .node = node, .parentScope = parentScope, .beginQuery = currentSlot->queryCount, .endQuery = currentSlot->queryCount + 1 });
+			currentSlot->queryCount += 2;
+
+			vkCmdWriteTimestamp(commandBuffer, stage, currentSlot->queryPool, currentSlot->scopes[scope].beginQuery);
+		}
+
+		openScopes.push_back(OpenScope{ .node = node, .scope = scope });
+
+		if (collectStatistics)
+		{
+			EndSegment(commandBuffer);
+			BeginSegment(commandBuffer, scope);
+		}
+	}
+
+	void GpuProfiler::EndScope(VkCommandBuffer commandBuffer, VkPipelineStageFlagBits stage)
+	{
+		if (!Enabled())
+		{
+			return;
+		}
+		assert(!openScopes.empty());
+
+		const OpenScope openScope{ openScopes.back() };
+		openScopes.pop_back();
+
+		if (collectStatistics)
+		{
+			EndSegment(commandBuffer);
+			BeginSegment(commandBuffer, openScopes.empty() ? noScope : openScopes.back().scope);
+		}
+
+		if (openScope.scope != noScope)
+		{
+			vkCmdWriteTimestamp(commandBuffer, stage, currentSlot->queryPool, currentSlot->scopes[openScope.scope].endQuery);
+		}
+	}
+
+	void GpuProfiler::Submitted() noexcept
+	{
+		if (currentSlot != nullptr)
+		{
+			currentSlot->submitTicks = CpuTicks();
+		}
+	}
+
+	const std::vector<GpuScopeTiming>& GpuProfiler::Timings()
+	{
+		if (nodeOrder.size() != nodes.size())
+		{
+			//Children are always created after their parent, so a stack walk in creation order is depth first
+			nodeOrder.clear();
+			std::vector<uint32_t> stack;
+			for (uint32_t root{ static_cast<uint32_t>(nodes.size()) }; root-- > 0;)
+			{
+				if (nodes[root].parent == noParent)
+				{
+					stack.push_back(root);
+				}
+			}
+
+			while (!stack.empty())
+			{
+				const uint32_t node{ stack.back() };
+				stack.pop_back();
+				nodeOrder.push_back(node);
+
+				for (uint32_t child{ static_cast<uint32_t>(nodes.size()) }; child-- > node + 1;)
+				{
+					if (nodes[child].parent == node)
+					{
+						stack.push_back(child);
+					}
+				}
+			}
+		}
+
+		timings.clear();
+		std::vector<uint32_t> timingIndices(nodes.size());
+		for (const uint32_t node : nodeOrder)
+		{
+			const Node& scopeNode{ nodes[node] };
+			timingIndices[node] = static_cast<uint32_t>(timings.size());
+
+			GpuScopeTiming timing
+			{
+				.name = scopeNode.name,
+				.parent = scopeNode.parent == noParent ? noParent : timingIndices[scopeNode.parent],
+				.depth = scopeNode.depth,
+				.sampleCount = scopeNode.sampleCount,
+				.lastMilliseconds = scopeNode.lastMilliseconds,
+				.lastStatistics = scopeNode.lastStatistics
+			};
+
+			if (!scopeNode.history.empty())
+			{
+				sortedHistory = scopeNode.history;
+				std::sort(sortedHistory.begin(), sortedHistory.end());
+
+				double sum{ 0.0 };
+				for (const double milliseconds : sortedHistory)
+				{
+					sum += milliseconds;
+				}
+
+				timing.averageMilliseconds = sum / static_cast<double>(sortedHistory.size());
+				timing.medianMilliseconds = Percentile(sortedHistory, 0.5);
+				timing.p95Milliseconds = Percentile(sortedHistory, 0.95);
+				timing.p99Milliseconds = Percentile(sortedHistory, 0.99);
+				timing.maxMilliseconds = sortedHistory.back();
+			}
+
+			timings.push_back(std::move(timing));
+		}
+
+		return timings;
+	}
+
+	void GpuProfiler::Print()
+	{
+		if (!Enabled())
+		{
+			printf("GPU profiler: no timestamp support on the queue family\n");
+			return;
+		}
+
+		printf("%-40s %9s %9s %9s %9s %9s %9s (ms over %u frames)\n", "GPU scope", "last", "average", "median", "p95", "p99", "max", historyLength);
+		for (const GpuScopeTiming& timing : Timings())
+		{
+			const int indent{ static_cast<int>(timing.depth * 2) };
+			printf("%*s%-*s %9.3f %9.3f %9.3f %9.3f %9.3f %9.3f\n", indent, "", 40 - indent, timing.name.c_str(),
+				timing.lastMilliseconds, timing.averageMilliseconds, timing.medianMilliseconds, timing.p95Milliseconds, timing.p99Milliseconds, timing.maxMilliseconds);
+		}
+	}
+
+	void GpuProfiler::PrintStatistics(uint32_t pixelCount)
+	{
+		if (!collectStatistics)
+		{
+			printf("GPU profiler: pipeline statistics aren't collected\n");
+			return;
+		}
+
+		printf("%-40s %12s %12s %12s %12s %12s %12s %12s %9s %9s\n", "GPU scope", "IA vertices", "IA prims", "VS invoc", "clip invoc", "clip prims",
+			"FS invoc", "CS invoc", "culled", "overdraw");
+		for (const GpuScopeTiming& timing : Timings())
+		{
+			const PipelineStatistics& statistics{ timing.lastStatistics };
+			//Share of the assembled primitives that never made it out of the clipper, by culling or clipping
+			const double culled{ statistics.inputAssemblyPrimitives == 0 ? 0.0
+				: 1.0 - static_cast<double>(statistics.clippingPrimitives) / static_cast<double>(statistics.inputAssemblyPrimitives) };
+			const double overdraw{ pixelCount == 0 ? 0.0 : static_cast<double>(statistics.fragmentShaderInvocations) / static_cast<double>(pixelCount) };
+
+			const int indent{ static_cast<int>(timing.depth * 2) };
+			printf("%*s%-*s %12llu %12llu %12llu %12llu %12llu %12llu %12llu %8.1f%% %9.2f\n", indent, "", 40 - indent, timing.name.c_str(),
+				static_cast<unsigned long long>(statistics.inputAssemblyVertices),
+				static_cast<unsigned long long>(statistics.inputAssemblyPrimitives),
+				static_cast<unsigned long long>(statistics.vertexShaderInvocations),
+				static_cast<unsigned long long>(statistics.clippingInvocations),
+				static_cast<unsigned long long>(statistics.clippingPrimitives),
+				static_cast<unsigned long long>(statistics.fragmentShaderInvocations),
+				static_cast<unsigned long long>(statistics.computeShaderInvocations),
+				culled * 100.0, overdraw);
+		}
+	}
+
+	void GpuProfiler::ReadBack(FrameSlot& slot)
+	{
+		if (slot.queryCount == 0)
+		{
+			return;
+		}
+
+		if (collectStatistics)
+		{
+			ReadBackStatistics(slot);
+		}
+
+		//Never waits, a slot whose fence hasn't signaled yet just loses its frame
+		const VkResult result{ vkGetQueryPoolResults(parent, slot.queryPool, 0, slot.queryCount, slot.queryCount * sizeof(uint64_t),
+			queryResults.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) };
+		if (result != VK_SUCCESS)
+		{
+			return;
+		}
+
+		const uint64_t validMask{ timestampValidBits >= 64 ? ~uint64_t{ 0 } : (uint64_t{ 1 } << timestampValidBits) - 1 };
+		const double ticksToMilliseconds{ timestampPeriod * 1e-6 };
+
+		for (const RecordedScope& scope : slot.scopes)
+		{
+			Node& node{ nodes[scope.node] };
+			//Masked so a counter wrapping inside the scope still gives the right duration
+			const uint64_t ticks{ (queryResults[scope.endQuery] - queryResults[scope.beginQuery]) & validMask };
+			const double milliseconds{ static_cast<double>(ticks) * ticksToMilliseconds };
+
+			if (node.history.size() < historyLength)
+			{
+				node.history.push_back(milliseconds);
+			}
+			else
+			{
+				node.history[node.sampleCount % historyLength] = milliseconds;
+			}
+			node.lastMilliseconds = milliseconds;
+			++node.sampleCount;
+		}
+
+		if (slot.submitTicks == 0 || slot.scopes.empty())
+		{
+			return;
+		}
+
+		//The first scope recorded is the first to execute
+		const uint64_t frameBegin{ queryResults[slot.scopes.front().beginQuery] };
+		const double ticksToMicroseconds{ timestampPeriod * 1e-3 };
+		for (const RecordedScope& scope : slot.scopes)
+		{
+			const uint64_t begin{ queryResults[scope.beginQuery] };
+			traceEvents.push_back(TraceEvent
+			{
+				.name = nodes[scope.node].name,
+				.track = "GPU",
+				.anchorTicks = slot.submitTicks,
+				.beginMicroseconds = static_cast<double>((begin - frameBegin) & validMask) * ticksToMicroseconds,
+				.durationMicroseconds = static_cast<double>((queryResults[scope.endQuery] - begin) & validMask) * ticksToMicroseconds
+			});
+		}
+
+		while (traceEvents.size() > traceEventCapacity)
+		{
+			traceEvents.pop_front();
+		}
+	}
+
+	void GpuProfiler::ReadBackStatistics(FrameSlot& slot)
+	{
+		if (slot.segments.empty())
+		{
+			return;
+		}
+
+		const uint32_t segmentCount{ static_cast<uint32_t>(slot.segments.size()) };
+		const VkResult result{ vkGetQueryPoolResults(parent, slot.statisticsPool, 0, segmentCount, segmentCount * sizeof(PipelineStatistics),
+			statisticsResults.data(), sizeof(PipelineStatistics), VK_QUERY_RESULT_64_BIT) };
+		if (result != VK_SUCCESS)
+		{
+			return;
+		}
+
+		scopeStatistics.assign(slot.scopes.size(), PipelineStatistics{});
+		for (uint32_t segment{}; segment < segmentCount; ++segment)
+		{
+			scopeStatistics[slot.segments[segment].scope] += statisticsResults[segment];
+		}
+
+		//Nested scopes are recorded after their parent, walking backwards adds every scope to its parent once it's complete
+		for (uint32_t scope{ static_cast<uint32_t>(slot.scopes.size()) }; scope-- > 0;)
+		{
+			if (slot.scopes[scope].parentScope != noScope)
+			{
+				scopeStatistics[slot.scopes[scope].parentScope] += scopeStatistics[scope];
+			}
+		}
+
+		for (Node& node : nodes)
+		{
+			node.lastStatistics = {};
+		}
+		for (uint32_t scope{}; scope < slot.scopes.size(); ++scope)
+		{
+			nodes[slot.scopes[scope].node].lastStatistics += scopeStatistics[scope];
+		}
+	}
+
+	void GpuProfiler::BeginSegment(VkCommandBuffer commandBuffer, uint32_t scope)
+	{
+		if (scope == noScope || currentSlot->segments.size() == maxQueries)
+		{
+			return;
+		}
+
+		activeSegmentQuery = static_cast<uint32_t>(currentSlot->segments.size());
+		currentSlot->segments.push_back(StatisticsSegment{ .scope = scope });
+		vkCmdBeginQuery(commandBuffer, currentSlot->statisticsPool, activeSegmentQuery, 0);
+	}
+
+	void GpuProfiler::EndSegment(VkCommandBuffer commandBuffer)
+	{
+		if (activeSegmentQuery == noQuery)
+		{
+			return;
+		}
+
+		vkCmdEndQuery(commandBuffer, currentSlot->statisticsPool, activeSegmentQuery);
+		activeSegmentQuery = noQuery;
+	}
+
+	uint32_t GpuProfiler::FindNode(uint32_t parentNode, std::string_view name)
+	{
+		for (uint32_t node{}; node < nodes.size(); ++node)
+		{
+			if (nodes[node].parent == parentNode && nodes[node].name == name)
+			{
+				return node;
+			}
+		}
+
+		nodes.push_back(Node
+		{
+			.name = std::string{ name },
+			.parent = parentNode,
+			.depth = parentNode == noParent ? 0 : nodes[parentNode].depth + 1
+		});
+		nodes.back().history.reserve(historyLength);
+		return static_cast<uint32_t>(nodes.size() - 1);
+	}
+}
@@ -23,4 +23,52 @@ namespace cof
 	{
 		vkDestroySemaphore(parent, handle, nullptr);
 	}
+
+	TimelineSemaphore::TimelineSemaphore(VkDevice device, uint64_t initialValue)
+		: parent{ device }
+	{
+		VkSemaphoreTypeCreateInfo semaphoreTypeInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+			.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+			.initialValue = initialValue
+		};
+
+		VkSemaphoreCreateInfo semaphoreCreateInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+			.pNext = &semaphoreTypeInfo
+		};
+
+		[[maybe_unused]] VkResult errorCode = vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &handle);
+		assert(errorCode == VK_SUCCESS);
+	}
+
+	TimelineSemaphore::~TimelineSemaphore()
+	{
+		vkDestroySemaphore(parent, handle, nullptr);
+	}
+
+	uint64_t TimelineSemaphore::Value() const
+	{
+		uint64_t value{ 0 };
+		[[maybe_unused]] VkResult errorCode = vkGetSemaphoreCounterValue(parent, handle, &value);
+		assert(errorCode == VK_SUCCESS);
+		return value;
+	}
+
+	bool TimelineSemaphore::Wait(uint64_t value, uint64_t timeout) const
+	{
+		VkSemaphoreWaitInfo waitInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+			.semaphoreCount = 1,
+			.pSemaphores = &handle,
+			.pValues = &value
+		};
+
+		const VkResult errorCode{ vkWaitSemaphores(parent, &waitInfo, timeout) };
+		assert(errorCode == VK_SUCCESS || errorCode == VK_TIMEOUT);
+		return errorCode == VK_SUCCESS;
+	}
 }
\ No newline at end of file
@@ -27,7 +27,7 @@ namespace cof
 		handle = VK_NULL_HANDLE;
 	}
 
-	Shader LoadShader(std::filesystem::path&& shaderPath, const VkDevice device)
+	std::vector<std::byte> ReadShaderFile(const std::filesystem::path& shaderPath)
 	{
 		std::ifstream shaderFile{ shaderPath, std::ios::ate | std::ios::binary };
 
@@ -38,21 +38,17 @@ namespace cof
 
 		shaderFile.seekg(0);
 		shaderFile.read(reinterpret_cast<char*>(buffer.data()), fileSize); //Maybe UB?
-		return Shader{ device, buffer };
+		return buffer;
 	}
 
-	Shader cof::LoadShader( const std::filesystem::path& shaderPath, const VkDevice device)
+	Shader LoadShader(std::filesystem::path&& shaderPath, const VkDevice device)
 	{
-		std::ifstream shaderFile{ shaderPath, std::ios::ate | std::ios::binary };
-
-		assert(shaderFile.is_open());
-
-		size_t fileSize = static_cast<size_t>(shaderFile.tellg());
-		std::vector<std::byte> buffer{ fileSize };
+		return Shader{ device, ReadShaderFile(shaderPath) };
+	}
 
-		shaderFile.seekg(0);
-		shaderFile.read(reinterpret_cast<char*>(buffer.data()), fileSize); //Maybe UB?
-		return Shader{ device, buffer };
+	Shader cof::LoadShader( const std::filesystem::path& shaderPath, const VkDevice device)
+	{
+		return Shader{ device, ReadShaderFile(shaderPath) };
 	}
 
 }
\ No newline at end of file
@@ -0,0 +1,481 @@
+#include "GPU/UploadStreamer.h"
+#include "GPU/GPUContext.h"
+#include "Utils/CpuProfiler.h"
+
+#include <vulkan/vulkan_core.h>
+
+#include <algorithm>
+#include <assert.h>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <numeric>
+#include <utility>
+
+namespace cof
+{
+	static VkDeviceSize AlignUp(VkDeviceSize size, VkDeviceSize alignment) noexcept
+	{
+		return (size + alignment - 1) & ~(alignment - 1);
+	}
+
+	UploadStreamer::UploadStreamer(const cof::GPUContext& gpuContext, VmaAllocator allocator, uint32_t consumerFamily, VkDeviceSize stagingSize)
+		: stagingCapacity{ AlignUp(stagingSize, stagingAlignment) }
+		, commandPool{ gpuContext, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT }
+		, timeline{ gpuContext.LogicalDevice() }
+		, queue{ gpuContext.Queue<VK_QUEUE_TRANSFER_BIT>() }
+		, transferQueueFamily{ gpuContext.QueueFamilyIndex<VK_QUEUE_TRANSFER_BIT>() }
+		, consumerQueueFamily{ consumerFamily }
+		, parent{ gpuContext.LogicalDevice() }
+		, memoryAllocator{ allocator }
+	{
+		VkBufferCreateInfo stagingBufferInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+			.size = stagingCapacity,
+			.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			.sharingMode = VK_SHARING_MODE_EXCLUSIVE
+		};
+
+		VmaAllocationCreateInfo stagingAllocInfo
+		{
+			.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT,
+			.usage = VMA_MEMORY_USAGE_CPU_ONLY
+		};
+
+		VmaAllocationInfo stagingAllocationInfo;
+		[[maybe_unused]] VkResult errorCode = vmaCreateBuffer(memoryAllocator, &stagingBufferInfo, &stagingAllocInfo, &stagingBuffer, &stagingAllocation, &stagingAllocationInfo);
+		assert(errorCode == VK_SUCCESS);
+		stagingData = static_cast<std::byte*>(stagingAllocationInfo.pMappedData);
+	}
+
+	UploadStreamer::~UploadStreamer()
+	{
+		timeline.Wait(nextValue - 1, std::numeric_limits<uint64_t>::max());
+		vmaDestroyBuffer(memoryAllocator, stagingBuffer, stagingAllocation);
+	}
+
+	UploadTicket UploadStreamer::Enqueue(BufferUpload upload, UploadPriority priority)
+	{
+		const uint32_t priorityIndex{ static_cast<uint32_t>(priority) };
+		statistics.queuedBytes[priorityIndex] += upload.data.size();
+
+		const UploadTicket ticket{ nextTicket++ };
+		pendingTickets.insert(ticket);
+		queues[priorityIndex].push_back(Upload{ .ticket = ticket, .image = false, .buffer = std::move(upload), .texture = {}, .progress = 0 });
+		return ticket;
+	}
+
+	UploadTicket UploadStreamer::Enqueue(ImageUpload upload, UploadPriority priority)
+	{
+		assert(upload.data.size() <= stagingCapacity);
+		const uint32_t priorityIndex{ static_cast<uint32_t>(priority) };
+		statistics.queuedBytes[priorityIndex] += upload.data.size();
+
+		const UploadTicket ticket{ nextTicket++ };
+		pendingTickets.insert(ticket);
+		queues[priorityIndex].push_back(Upload{ .ticket = ticket, .image = true, .buffer = {}, .texture = std::move(upload), .progress = 0 });
+		return ticket;
+	}
+
+	void UploadStreamer::Submit(VkDeviceSize budget)
+	{
+		CPU_ZONE("UploadStreamer::Submit");
+
+		RetireBatches();
+
+		Batch batch
+		{
+			.value = nextValue,
+			.commandBuffer = VK_NULL_HANDLE,
+			.stagingBytes = 0
+		};
+
+		if (freeCommandBuffers.empty())
+		{
+			VkCommandBufferAllocateInfo allocInfo
+			{
+				.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+				.commandPool = commandPool.Handle(),
+				.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+				.commandBufferCount = 1u
+			};
+
+			[[maybe_unused]] VkResult errorCode = vkAllocateCommandBuffers(parent, &allocInfo, &batch.commandBuffer);
+			assert(errorCode == VK_SUCCESS);
+		}
+		else
+		{
+			batch.commandBuffer = freeCommandBuffers.back();
+			freeCommandBuffers.pop_back();
+			vkResetCommandBuffer(batch.commandBuffer, 0);
+		}
+
+		VkCommandBufferBeginInfo beginInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+			.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
+		};
+
+		vkBeginCommandBuffer(batch.commandBuffer, &beginInfo);
+
+		const VkDeviceSize stagingUsedBefore{ stagingUsed };
+		VkDeviceSize submitBytes{ 0 };
+		bool stop{ false };
+
+		for (uint32_t priorityIndex{}; priorityIndex < uploadPriorityCount && !stop; ++priorityIndex)
+		{
+			std::deque<Upload>& uploads{ queues[priorityIndex] };
+			while (!uploads.empty())
+			{
+				Upload& upload{ uploads.front() };
+				const VkDeviceSize copiedBytes{ RecordUpload(upload, batch, budget - submitBytes, submitBytes == 0) };
+				if (copiedBytes == 0)
+				{
+					stop = true;
+					break;
+				}
+
+				submitBytes += copiedBytes;
+				statistics.uploadedBytes[priorityIndex] += copiedBytes;
+				statistics.queuedBytes[priorityIndex] -= copiedBytes;
+
+				const bool finished{ upload.image || upload.progress == upload.buffer.data.size() };
+				if (!finished)
+				{
+					stop = true;
+					break;
+				}
+
+				batch.finishedTickets.push_back(upload.ticket);
+				uploads.pop_front();
+
+				if (submitBytes >= budget)
+				{
+					stop = true;
+					break;
+				}
+			}
+		}
+
+		statistics.lastSubmitBytes = submitBytes;
+
+		if (submitBytes == 0)
+		{
+			vkEndCommandBuffer(batch.commandBuffer);
+			freeCommandBuffers.push_back(batch.commandBuffer);
+			return;
+		}
+
+		//One barrier hands everything in the batch over to the consumer, the semaphore carries the dependency on
+		if (!bufferReleases.empty() || !imageReleases.empty())
+		{
+			vkCmdPipelineBarrier(batch.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr,
+				static_cast<uint32_t>(bufferReleases.size()), bufferReleases.data(),
+				static_cast<uint32_t>(imageReleases.size()), imageReleases.data());
+			bufferReleases.clear();
+			imageReleases.clear();
+		}
+
+		[[maybe_unused]] VkResult errorCode = vkEndCommandBuffer(batch.commandBuffer);
+		assert(errorCode == VK_SUCCESS);
+
+		VkTimelineSemaphoreSubmitInfo timelineInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+			.signalSemaphoreValueCount = 1,
+			.pSignalSemaphoreValues = &batch.value
+		};
+
+		const VkSemaphore signalSemaphore{ timeline.Handle() };
+
+		VkSubmitInfo submitInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+			.pNext = &timelineInfo,
+			.commandBufferCount = 1,
+			.pCommandBuffers = &batch.commandBuffer,
+			.signalSemaphoreCount = 1,
+			.pSignalSemaphores = &signalSemaphore
+		};
+
+		errorCode = vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE);
+		assert(errorCode == VK_SUCCESS);
+
+		batch.stagingBytes = stagingUsed - stagingUsedBefore;
+		batches.push_back(std::move(batch));
+		++nextValue;
+		++statistics.submitCount;
+	}
+
+	void UploadStreamer::Flush()
+	{
+		while (QueuedBytes() != 0)
+		{
+			Submit(std::numeric_limits<VkDeviceSize>::max());
+			//Frees the staging ring for whatever didn't fit
+			timeline.Wait(nextValue - 1, std::numeric_limits<uint64_t>::max());
+			RetireBatches();
+		}
+	}
+
+	uint64_t UploadStreamer::RecordAcquires(VkCommandBuffer commandBuffer)
+	{
+		CPU_ZONE("UploadStreamer::RecordAcquires");
+
+		RetireBatches();
+
+		std::vector<VkBufferMemoryBarrier> bufferAcquires;
+		std::vector<VkImageMemoryBarrier> imageAcquires;
+		uint64_t waitValue{ 0 };
+
+		while (!batches.empty() && batches.front().commandBuffer == VK_NULL_HANDLE)
+		{
+			const Batch& batch{ batches.front() };
+			bufferAcquires.insert(bufferAcquires.end(), batch.bufferAcquires.begin(), batch.bufferAcquires.end());
+			imageAcquires.insert(imageAcquires.end(), batch.imageAcquires.begin(), batch.imageAcquires.end());
+			for (UploadTicket ticket : batch.finishedTickets)
+			{
+				pendingTickets.erase(ticket);
+			}
+			waitValue = batch.value;
+			batches.pop_front();
+		}
+
+		//The stages of the uploads' first uses aren't tracked, all commands covers every one of them
+		if (!bufferAcquires.empty() || !imageAcquires.empty())
+		{
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr,
+				static_cast<uint32_t>(bufferAcquires.size()), bufferAcquires.data(),
+				static_cast<uint32_t>(imageAcquires.size()), imageAcquires.data());
+		}
+
+		return waitValue;
+	}
+
+	bool UploadStreamer::Completed(UploadTicket ticket) const noexcept
+	{
+		return ticket < nextTicket && !pendingTickets.contains(ticket);
+	}
+
+	VkDeviceSize UploadStreamer::AllocateStaging(VkDeviceSize size) noexcept
+	{
+		size = AlignUp(size, stagingAlignment);
+
+		if (stagingUsed == 0)
+		{
+			stagingHead = 0;
+			stagingTail = 0;
+		}
+
+		const bool full{ stagingUsed == stagingCapacity || (stagingHead == stagingTail && stagingUsed != 0) };
+		if (full)
+		{
+			return noStaging;
+		}
+
+		if (stagingHead >= stagingTail)
+		{
+			if (stagingCapacity - stagingHead >= size)
+			{
+				const VkDeviceSize offset{ stagingHead };
+				stagingHead += size;
+				stagingUsed += size;
+				return offset;
+			}
+
+			//Skips the end of the ring, the skipped bytes stay with the batch until it's retired
+			if (stagingTail >= size)
+			{
+				stagingUsed += stagingCapacity - stagingHead + size;
+				stagingHead = size;
+				return 0;
+			}
+
+			return noStaging;
+		}
+
+		if (stagingTail - stagingHead >= size)
+		{
+			const VkDeviceSize offset{ stagingHead };
+			stagingHead += size;
+			stagingUsed += size;
+			return offset;
+		}
+
+		return noStaging;
+	}
+
+	void UploadStreamer::RetireBatches()
+	{
+		const uint64_t completedValue{ timeline.Value() };
+
+		for (Batch& batch : batches)
+		{
+			if (batch.value > completedValue)
+			{
+				break;
+			}
+
+			if (batch.commandBuffer != VK_NULL_HANDLE)
+			{
+				freeCommandBuffers.push_back(batch.commandBuffer);
+				batch.commandBuffer = VK_NULL_HANDLE;
+
+				stagingTail = (stagingTail + batch.stagingBytes) % stagingCapacity;
+				stagingUsed -= batch.stagingBytes;
+			}
+		}
+	}
+
+	VkDeviceSize UploadStreamer::RecordUpload(Upload& upload, Batch& batch, VkDeviceSize budget, bool firstCopy)
+	{
+		const bool transfer{ transferQueueFamily != consumerQueueFamily };
+		const uint32_t srcQueueFamily{ transfer ? transferQueueFamily : VK_QUEUE_FAMILY_IGNORED };
+		const uint32_t dstQueueFamily{ transfer ? consumerQueueFamily : VK_QUEUE_FAMILY_IGNORED };
+
+		if (!upload.image)
+		{
+			BufferUpload& bufferUpload{ upload.buffer };
+			const VkDeviceSize chunkSize{ std::min({ bufferUpload.data.size() - upload.progress, budget, stagingCapacity }) };
+
+			const VkDeviceSize stagingOffset{ AllocateStaging(chunkSize) };
+			if (stagingOffset == noStaging)
+			{
+				++statistics.stagingStallCount;
+				return 0;
+			}
+
+			memcpy(stagingData + stagingOffset, bufferUpload.data.data() + upload.progress, static_cast<size_t>(chunkSize));
+
+			const VkBufferCopy copyRegion
+			{
+				.srcOffset = stagingOffset,
+				.dstOffset = bufferUpload.offset + upload.progress,
+				.size = chunkSize
+			};
+
+			vkCmdCopyBuffer(batch.commandBuffer, stagingBuffer, bufferUpload.buffer, 1, &copyRegion);
+
+			VkBufferMemoryBarrier barrier
+			{
+				.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+				.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+				.dstAccessMask = 0,
+				.srcQueueFamilyIndex = srcQueueFamily,
+				.dstQueueFamilyIndex = dstQueueFamily,
+				.buffer = bufferUpload.buffer,
+				.offset = copyRegion.dstOffset,
+				.size = chunkSize
+			};
+
+			//Within one family the semaphore alone makes the copy visible
+			if (transfer)
+			{
+				bufferReleases.push_back(barrier);
+
+				barrier.srcAccessMask = 0;
+				barrier.dstAccessMask = bufferUpload.dstAccess;
+				batch.bufferAcquires.push_back(barrier);
+			}
+
+			upload.progress += chunkSize;
+			return chunkSize;
+		}
+
+		ImageUpload& imageUpload{ upload.texture };
+		const VkDeviceSize imageSize{ imageUpload.data.size() };
+		if (imageSize > budget && !firstCopy)
+		{
+			return 0;
+		}
+
+		const VkDeviceSize stagingOffset{ AllocateStaging(imageSize) };
+		if (stagingOffset == noStaging)
+		{
+			++statistics.stagingStallCount;
+			return 0;
+		}
+
+		memcpy(stagingData + stagingOffset, imageUpload.data.data(), static_cast<size_t>(imageSize));
+
+		const VkImageSubresourceRange range
+		{
+			.aspectMask = imageUpload.subresource.aspectMask,
+			.baseMipLevel = imageUpload.subresource.mipLevel,
+			.levelCount = 1,
+			.baseArrayLayer = imageUpload.subresource.baseArrayLayer,
+			.layerCount = imageUpload.subresource.layerCount
+		};
+
+		const VkImageMemoryBarrier toTransfer
+		{
+			.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+			.srcAccessMask = 0,
+			.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+			.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+			.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+			.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+			.image = imageUpload.image,
+			.subresourceRange = range
+		};
+
+		vkCmdPipelineBarrier(batch.commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &toTransfer);
+
+		const VkBufferImageCopy copyRegion
+		{
+			.bufferOffset = stagingOffset,
+			.bufferRowLength = 0,
+			.bufferImageHeight = 0,
+			.imageSubresource = imageUpload.subresource,
+			.imageOffset = imageUpload.offset,
+			.imageExtent = imageUpload.extent
+		};
+
+		vkCmdCopyBufferToImage(batch.commandBuffer, stagingBuffer, imageUpload.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copyRegion);
+
+		//Within one family the release barrier is a plain layout transition
+		VkImageMemoryBarrier barrier
+		{
+			.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+			.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+			.dstAccessMask = 0,
+			.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			.newLayout = imageUpload.finalLayout,
+			.srcQueueFamilyIndex = srcQueueFamily,
+			.dstQueueFamilyIndex = dstQueueFamily,
+			.image = imageUpload.image,
+			.subresourceRange = range
+		};
+
+		imageReleases.push_back(barrier);
+
+		if (transfer)
+		{
+			barrier.srcAccessMask = 0;
+			barrier.dstAccessMask = imageUpload.dstAccess;
+			batch.imageAcquires.push_back(barrier);
+		}
+
+		return imageSize;
+	}
+
+	uint64_t UploadStreamer::QueuedBytes() const noexcept
+	{
+		return std::accumulate(statistics.queuedBytes.begin(), statistics.queuedBytes.end(), uint64_t{ 0 });
+	}
+
+	void UploadStatistics::Print() const
+	{
+		constexpr const char* priorityNames[uploadPriorityCount]{ "Visible", "Prefetch", "Background" };
+
+		for (uint32_t priorityIndex{}; priorityIndex < uploadPriorityCount; ++priorityIndex)
+		{
+			printf("%-10s %10.2f MiB uploaded, %10.2f MiB queued\n", priorityNames[priorityIndex],
+				static_cast<double>(uploadedBytes[priorityIndex]) / (1024.0 * 1024.0),
+				static_cast<double>(queuedBytes[priorityIndex]) / (1024.0 * 1024.0));
+		}
+		printf("%u submits, %.2f KiB in the last one, %u staging stalls\n", submitCount, static_cast<double>(lastSubmitBytes) / 1024.0, stagingStallCount);
+	}
+}
@@ -0,0 +1,368 @@
+#include "Graphics/ClusteredLighting.h"
+#include "Graphics/OcclusionCulling.h"
+#include "GPU/Shader.h"
+
+#include <vulkan/vulkan_core.h>
+#include <glm/geometric.hpp>
+
+#include <algorithm>
+#include <array>
+#include <assert.h>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+namespace cof
+{
+	constexpr static uint32_t lightingBindingCount{ 5 };
+	constexpr static uint32_t gridBinding{ 3 };
+	constexpr static uint32_t counterBinding{ 4 };
+
+	//Matches CullingConstants in ClusterLightCull.comp.glsl
+	struct LightCullingConstants
+	{
+		glm::mat4 view;
+		glm::vec2 projectionScale;
+	};
+
+	ClusterGrid MakeClusterGrid(VkExtent2D extent, float zNear, float zFar, uint32_t tileSize, uint32_t sliceCount) noexcept
+	{
+		assert(zNear > 0.0f && zFar > zNear);
+
+		const float logDepthRange{ std::log(zFar / zNear) };
+
+		ClusterGrid grid
+		{
+			.countX = (extent.width + tileSize - 1) / tileSize,
+			.countY = (extent.height + tileSize - 1) / tileSize,
+			.countZ = sliceCount,
+			.tileSize = tileSize,
+			.zNear = zNear,
+			.zFar = zFar,
+			.sliceScale = static_cast<float>(sliceCount) / logDepthRange,
+			.sliceBias = -static_cast<float>(sliceCount) * std::log(zNear) / logDepthRange,
+			.lightCount = 0,
+			.extentWidth = extent.width,
+			.extentHeight = extent.height
+		};
+
+		grid.lightIndexCapacity = grid.ClusterCount() * ClusteredLightCullingPass::averageLightIndexBudget;
+		return grid;
+	}
+
+	void LightCullingStatistics::Print() const
+	{
+		printf("%4u lights: %u/%u clusters occupied, %.2f lights per cluster (%.2f per occupied, max %u, %u overflowed), brute force %u per fragment, %.1fx fewer\n",
+			lightCount, occupiedClusterCount, clusterCount, averageLightsPerCluster, averageLightsPerOccupiedCluster, maxLightsPerCluster, overflowedClusterCount,
+			lightCount, averageLightsPerCluster > 0.0f ? static_cast<float>(lightCount) / averageLightsPerCluster : 0.0f);
+	}
+
+	static float SliceDepth(const ClusterGrid& grid, uint32_t slice) noexcept
+	{
+		return std::exp((static_cast<float>(slice) - grid.sliceBias) / grid.sliceScale);
+	}
+
+	LightCullingStatistics BinLightsReference(const std::vector<Light>& lights, const ClusterGrid& grid, const CullingView& cullingView)
+	{
+		const glm::vec2 projectionScale{ cullingView.projection[0][0], cullingView.projection[1][1] };
+
+		std::vector<glm::vec4> viewLights(lights.size());
+		for (size_t light{}; light < lights.size(); ++light)
+		{
+			const glm::vec4 viewPosition = cullingView.view * glm::vec4{ lights[light].position, 1.0f };
+			viewLights[light] = glm::vec4{ viewPosition.x, viewPosition.y, -viewPosition.z, lights[light].range };
+		}
+
+		LightCullingStatistics statistics
+		{
+			.lightCount = static_cast<uint32_t>(lights.size()),
+			.clusterCount = grid.ClusterCount()
+		};
+
+		uint64_t totalLightCount{ 0 };
+		for (uint32_t z{}; z < grid.countZ; ++z)
+		{
+			const float sliceNear{ SliceDepth(grid, z) };
+			const float sliceFar{ z + 1 == grid.countZ ? 1e30f : SliceDepth(grid, z + 1) };
+
+			for (uint32_t y{}; y < grid.countY; ++y)
+			{
+				for (uint32_t x{}; x < grid.countX; ++x)
+				{
+					//Same froxel bounds as the compute shader
+					const glm::vec2 extent{ static_cast<float>(grid.extentWidth), static_cast<float>(grid.extentHeight) };
+					const glm::vec2 ndcMin = glm::vec2{ static_cast<float>(x * grid.tileSize), static_cast<float>(y * grid.tileSize) } / extent * 2.0f - 1.0f;
+					const glm::vec2 ndcMax = glm::min(glm::vec2{ static_cast<float>((x + 1) * grid.tileSize), static_cast<float>((y + 1) * grid.tileSize) } / extent, glm::vec2{ 1.0f }) * 2.0f - 1.0f;
+
+					const glm::vec2 nearMin = ndcMin * sliceNear / projectionScale;
+					const glm::vec2 nearMax = ndcMax * sliceNear / projectionScale;
+					const glm::vec2 farMin = ndcMin * sliceFar / projectionScale;
+					const glm::vec2 farMax = ndcMax * sliceFar / projectionScale;
+
+					const glm::vec3 boxMin{ glm::min(glm::min(nearMin, nearMax), glm::min(farMin, farMax)), sliceNear };
+					const glm::vec3 boxMax{ glm::max(glm::max(nearMin, nearMax), glm::max(farMin, farMax)), sliceFar };
+
+					uint32_t clusterLightCount{ 0 };
+					for (const glm::vec4& light : viewLights)
+					{
+						const glm::vec3 center{ light };
+						const glm::vec3 delta = center - glm::clamp(center, boxMin, boxMax);
+						clusterLightCount += glm::dot(delta, delta) <= light.w * light.w ? 1 : 0;
+					}
+
+					statistics.occupiedClusterCount += clusterLightCount > 0 ? 1 : 0;
+					statistics.overflowedClusterCount += clusterLightCount > ClusteredLightCullingPass::maxLightsPerCluster ? 1 : 0;
+					statistics.maxLightsPerCluster = std::max(statistics.maxLightsPerCluster, clusterLightCount);
+					totalLightCount += std::min(clusterLightCount, ClusteredLightCullingPass::maxLightsPerCluster);
+				}
+			}
+		}
+
+		statistics.averageLightsPerCluster = static_cast<float>(totalLightCount) / static_cast<float>(statistics.clusterCount);
+		statistics.averageLightsPerOccupiedCluster = statistics.occupiedClusterCount > 0 ? static_cast<float>(totalLightCount) / static_cast<float>(statistics.occupiedClusterCount) : 0.0f;
+		return statistics;
+	}
+
+	ClusteredLightCullingPass::ClusteredLightCullingPass(	const VkDevice device,
+															VmaAllocator allocator,
+															const ClusterGrid& clusterGrid,
+															const cof::Shader& cullingShader)
+		: grid{ clusterGrid }
+		, parent{ device }
+		, memoryAllocator{ allocator }
+	{
+		[[maybe_unused]] VkResult errorCode{ VK_RESULT_MAX_ENUM };
+
+		VmaAllocationCreateInfo bufferAllocInfo
+		{
+			.usage = VMA_MEMORY_USAGE_GPU_ONLY
+		};
+
+		auto createBuffer = [this, &bufferAllocInfo](VkDeviceSize size, VkBufferUsageFlags usage, VkBuffer& buffer, VmaAllocation& allocation)
+		{
+			VkBufferCreateInfo bufferInfo
+			{
+				.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+				.size = size,
+				.usage = usage,
+				.sharingMode = VK_SHARING_MODE_EXCLUSIVE
+			};
+
+			[[maybe_unused]] VkResult bufferErrorCode = vmaCreateBuffer(memoryAllocator, &bufferInfo, &bufferAllocInfo, &buffer, &allocation, nullptr);
+			assert(bufferErrorCode == VK_SUCCESS);
+		};
+
+		createBuffer(sizeof(glm::uvec2) * grid.ClusterCount(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, clusterBuffer, clusterAllocation);
+		createBuffer(sizeof(uint32_t) * grid.lightIndexCapacity, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, lightIndexBuffer, lightIndexAllocation);
+		createBuffer(sizeof(ClusterGrid), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, gridBuffer, gridAllocation);
+		createBuffer(sizeof(LightCullingCounters), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, counterBuffer, counterAllocation);
+
+		const VkBufferCreateInfo readbackInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+			.size = sizeof(LightCullingCounters),
+			.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			.sharingMode = VK_SHARING_MODE_EXCLUSIVE
+		};
+
+		const VmaAllocationCreateInfo readbackAllocInfo
+		{
+			.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT,
+			.usage = VMA_MEMORY_USAGE_GPU_TO_CPU
+		};
+
+		VmaAllocationInfo readbackAllocationInfo;
+		errorCode = vmaCreateBuffer(memoryAllocator, &readbackInfo, &readbackAllocInfo, &readbackBuffer, &readbackAllocation, &readbackAllocationInfo);
+		assert(errorCode == VK_SUCCESS);
+		//Zeroed so Counters reads nothing overflowed before the first culling
+		std::memset(readbackAllocationInfo.pMappedData, 0, sizeof(LightCullingCounters));
+		vmaFlushAllocation(memoryAllocator, readbackAllocation, 0, VK_WHOLE_SIZE);
+		readbackCounters = static_cast<const LightCullingCounters*>(readbackAllocationInfo.pMappedData);
+
+		std::array<VkDescriptorSetLayoutBinding, lightingBindingCount> bindings{};
+		for (uint32_t binding{}; binding < bindings.size(); ++binding)
+		{
+			bindings[binding] = VkDescriptorSetLayoutBinding
+			{
+				.binding = binding,
+				.descriptorType = binding == gridBinding ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+				.descriptorCount = 1,
+				.stageFlags = static_cast<VkShaderStageFlags>(binding == counterBinding ? VK_SHADER_STAGE_COMPUTE_BIT : VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_FRAGMENT_BIT)
+			};
+		}
+
+		VkDescriptorSetLayoutCreateInfo descriptorSetLayoutInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+			.bindingCount = static_cast<uint32_t>(bindings.size()),
+			.pBindings = bindings.data()
+		};
+
+		errorCode = vkCreateDescriptorSetLayout(device, &descriptorSetLayoutInfo, nullptr, &descriptorSetLayout);
+		assert(errorCode == VK_SUCCESS);
+
+		VkPushConstantRange pushConstantRange
+		{
+			.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+			.offset = 0,
+			.size = sizeof(LightCullingConstants)
+		};
+
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+			.setLayoutCount = 1,
+			.pSetLayouts = &descriptorSetLayout,
+			.pushConstantRangeCount = 1,
+			.pPushConstantRanges = &pushConstantRange
+		};
+
+		errorCode = vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout);
+		assert(errorCode == VK_SUCCESS);
+
+		VkComputePipelineCreateInfo pipelineInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+			.stage =
+			{
+				.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+				.stage = VK_SHADER_STAGE_COMPUTE_BIT,
+				.module = cullingShader.Handle(),
+				.pName = "main"
+			},
+			.layout = pipelineLayout
+		};
+
+		errorCode = vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline);
+		assert(errorCode == VK_SUCCESS);
+
+		std::array poolSizes
+		{
+			VkDescriptorPoolSize{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, lightingBindingCount - 1 },
+			VkDescriptorPoolSize{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1 }
+		};
+
+		VkDescriptorPoolCreateInfo descriptorPoolInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+			.maxSets = 1,
+			.poolSizeCount = static_cast<uint32_t>(poolSizes.size()),
+			.pPoolSizes = poolSizes.data()
+		};
+
+		errorCode = vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool);
+		assert(errorCode == VK_SUCCESS);
+
+		VkDescriptorSetAllocateInfo descriptorSetInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+			.descriptorPool = descriptorPool,
+			.descriptorSetCount = 1,
+			.pSetLayouts = &descriptorSetLayout
+		};
+
+		errorCode = vkAllocateDescriptorSets(device, &descriptorSetInfo, &descriptorSet);
+		assert(errorCode == VK_SUCCESS);
+
+		VkDescriptorBufferInfo clusterBufferInfo{ clusterBuffer, 0, VK_WHOLE_SIZE };
+		VkDescriptorBufferInfo lightIndexBufferInfo{ lightIndexBuffer, 0, VK_WHOLE_SIZE };
+		VkDescriptorBufferInfo gridBufferInfo{ gridBuffer, 0, VK_WHOLE_SIZE };
+		VkDescriptorBufferInfo counterBufferInfo{ counterBuffer, 0, VK_WHOLE_SIZE };
+
+		std::array descriptorWrites
+		{
+			VkWriteDescriptorSet{ .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, .dstSet = descriptorSet, .dstBinding = 1, .descriptorCount = 1, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .pBufferInfo = &clusterBufferInfo },
+			VkWriteDescriptorSet{ .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, .dstSet = descriptorSet, .dstBinding = 2, .descriptorCount = 1, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .pBufferInfo = &lightIndexBufferInfo },
+			VkWriteDescriptorSet{ .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, .dstSet = descriptorSet, .dstBinding = gridBinding, .descriptorCount = 1, .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, .pBufferInfo = &gridBufferInfo },
+			VkWriteDescriptorSet{ .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, .dstSet = descriptorSet, .dstBinding = counterBinding, .descriptorCount = 1, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .pBufferInfo = &counterBufferInfo }
+		};
+
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+	}
+
+	ClusteredLightCullingPass::~ClusteredLightCullingPass()
+	{
+		vkDestroyDescriptorPool(parent, descriptorPool, nullptr);
+		vkDestroyPipeline(parent, pipeline, nullptr);
+		vkDestroyPipelineLayout(parent, pipelineLayout, nullptr);
+		vkDestroyDescriptorSetLayout(parent, descriptorSetLayout, nullptr);
+
+		vmaDestroyBuffer(memoryAllocator, readbackBuffer, readbackAllocation);
+		vmaDestroyBuffer(memoryAllocator, counterBuffer, counterAllocation);
+		vmaDestroyBuffer(memoryAllocator, gridBuffer, gridAllocation);
+		vmaDestroyBuffer(memoryAllocator, lightIndexBuffer, lightIndexAllocation);
+		vmaDestroyBuffer(memoryAllocator, clusterBuffer, clusterAllocation);
+	}
+
+	void ClusteredLightCullingPass::BindLights(VkBuffer lightBuffer, uint32_t lightCount)
+	{
+		grid.lightCount = lightCount;
+
+		VkDescriptorBufferInfo lightBufferInfo{ lightBuffer, 0, VK_WHOLE_SIZE };
+
+		VkWriteDescriptorSet descriptorWrite
+		{
+			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			.dstSet = descriptorSet,
+			.dstBinding = 0,
+			.descriptorCount = 1,
+			.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			.pBufferInfo = &lightBufferInfo
+		};
+
+		vkUpdateDescriptorSets(parent, 1, &descriptorWrite, 0, nullptr);
+	}
+
+	void ClusteredLightCullingPass::Record(VkCommandBuffer commandBuffer, const CullingView& cullingView) const
+	{
+		vkCmdUpdateBuffer(commandBuffer, gridBuffer, 0, sizeof(ClusterGrid), &grid);
+		vkCmdFillBuffer(commandBuffer, counterBuffer, 0, sizeof(LightCullingCounters), 0);
+
+		VkMemoryBarrier clearBarrier
+		{
+			.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+			.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+			.dstAccessMask = VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT
+		};
+
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 1, &clearBarrier, 0, nullptr, 0, nullptr);
+
+		LightCullingConstants constants
+		{
+			.view = cullingView.view,
+			.projectionScale = glm::vec2{ cullingView.projection[0][0], cullingView.projection[1][1] }
+		};
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+		vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(LightCullingConstants), &constants);
+		vkCmdDispatch(commandBuffer, grid.countX, grid.countY, grid.countZ);
+
+		VkMemoryBarrier cullingBarrier
+		{
+			.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+			.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+			.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT
+		};
+
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &cullingBarrier, 0, nullptr, 0, nullptr);
+
+		const VkBufferCopy counterCopy{ .srcOffset = 0, .dstOffset = 0, .size = sizeof(LightCullingCounters) };
+		vkCmdCopyBuffer(commandBuffer, counterBuffer, readbackBuffer, 1, &counterCopy);
+
+		VkMemoryBarrier hostBarrier
+		{
+			.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+			.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+			.dstAccessMask = VK_ACCESS_HOST_READ_BIT
+		};
+
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &hostBarrier, 0, nullptr, 0, nullptr);
+	}
+
+	LightCullingCounters ClusteredLightCullingPass::Counters() const
+	{
+		vmaInvalidateAllocation(memoryAllocator, readbackAllocation, 0, VK_WHOLE_SIZE);
+		return *readbackCounters;
+	}
+}
@@ -0,0 +1,661 @@
+#include "Graphics/DeferredGBuffer.h"
+#include "Graphics/VertexLayout.h"
+#include "GPU/AttachmentMemory.h"
+#include "GPU/Shader.h"
+
+#include <vulkan/vulkan_core.h>
+#include <glm/matrix.hpp>
+
+#include <array>
+#include <assert.h>
+#include <cstdio>
+
+namespace cof
+{
+	//Matches GBufferConstants in GBuffer.glsl
+	struct GBufferConstants
+	{
+		//viewProjection while rasterizing, pixel coordinates and depth to world space while lighting
+		glm::mat4 transform;
+		glm::vec4 lightDirection;
+		glm::vec4 cameraPosition;
+		uint32_t drawIndex;
+	};
+
+	constexpr static VkShaderStageFlags gbufferStages{ VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT };
+
+	enum GBufferAttachment : uint32_t
+	{
+		albedoAttachment,
+		normalAttachment,
+		materialAttachment,
+		depthAttachment,
+		litAttachment,
+		attachmentCount
+	};
+
+	constexpr static uint32_t geometrySubpass{ 0 };
+	constexpr static uint32_t lightingSubpass{ 1 };
+
+	constexpr static std::array<VkAttachmentReference, 3> gbufferWriteReferences
+	{
+		VkAttachmentReference{ albedoAttachment, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL },
+		VkAttachmentReference{ normalAttachment, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL },
+		VkAttachmentReference{ materialAttachment, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL }
+	};
+
+	constexpr static VkAttachmentReference depthWriteReference{ depthAttachment, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
+
+	//Input attachment index n of the lighting shader reads reference n
+	constexpr static std::array<VkAttachmentReference, 4> gbufferReadReferences
+	{
+		VkAttachmentReference{ albedoAttachment, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL },
+		VkAttachmentReference{ normalAttachment, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL },
+		VkAttachmentReference{ materialAttachment, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL },
+		VkAttachmentReference{ depthAttachment, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL }
+	};
+
+	constexpr static VkAttachmentReference depthReadReference{ depthAttachment, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL };
+	constexpr static VkAttachmentReference litReference{ litAttachment, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+
+	static std::vector<VkAttachmentDescription> GBufferAttachments(GBufferLayout layout)
+	{
+		const GBufferFormats formats{ DeferredGBuffer::Formats(layout) };
+
+		//Nothing but the lit image leaves the render pass
+		auto transient = [](VkFormat format, VkImageLayout layoutInPass)
+		{
+			return VkAttachmentDescription
+			{
+				.format = format,
+				.samples = VK_SAMPLE_COUNT_1_BIT,
+				.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+				.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+				.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+				.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+				.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+				.finalLayout = layoutInPass
+			};
+		};
+
+		std::vector<VkAttachmentDescription> attachments
+		{
+			transient(formats.albedo, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+			transient(formats.normal, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+			transient(formats.material, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+			transient(DepthBuffer::format, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL),
+			transient(DeferredGBuffer::litFormat, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL)
+		};
+
+		attachments[depthAttachment].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		attachments[litAttachment].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		attachments[litAttachment].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		return attachments;
+	}
+
+	static std::vector<VkSubpassDescription> GBufferSubpasses()
+	{
+		return
+		{
+			VkSubpassDescription
+			{
+				.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
+				.colorAttachmentCount = static_cast<uint32_t>(gbufferWriteReferences.size()),
+				.pColorAttachments = gbufferWriteReferences.data(),
+				.pDepthStencilAttachment = &depthWriteReference
+			},
+			//Depth is bound read only as well, so the lighting subpass can skip the background with the depth test
+			VkSubpassDescription
+			{
+				.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
+				.inputAttachmentCount = static_cast<uint32_t>(gbufferReadReferences.size()),
+				.pInputAttachments = gbufferReadReferences.data(),
+				.colorAttachmentCount = 1,
+				.pColorAttachments = &litReference,
+				.pDepthStencilAttachment = &depthReadReference
+			}
+		};
+	}
+
+	static std::vector<VkSubpassDependency> GBufferDependencies()
+	{
+		return
+		{
+			//The previous frame's lighting has to be done with the G-buffer before it is overwritten
+			VkSubpassDependency
+			{
+				.srcSubpass = VK_SUBPASS_EXTERNAL,
+				.dstSubpass = geometrySubpass,
+				.srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+				.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT,
+				.srcAccessMask = 0,
+				.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT
+			},
+			//By region, every pixel only reads what its own fragments wrote, which is what lets a tiler stay on chip
+			VkSubpassDependency
+			{
+				.srcSubpass = geometrySubpass,
+				.dstSubpass = lightingSubpass,
+				.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+				.dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT,
+				.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+				.dstAccessMask = VK_ACCESS_INPUT_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT,
+				.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT
+			},
+			//The previous frame's blit has to be done reading the lit image
+			VkSubpassDependency
+			{
+				.srcSubpass = VK_SUBPASS_EXTERNAL,
+				.dstSubpass = lightingSubpass,
+				.srcStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT,
+				.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+				.srcAccessMask = 0,
+				.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT
+			},
+			VkSubpassDependency
+			{
+				.srcSubpass = lightingSubpass,
+				.dstSubpass = VK_SUBPASS_EXTERNAL,
+				.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+				.dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT,
+				.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+				.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT
+			}
+		};
+	}
+
+	static void CreateImage(VmaAllocator allocator, VkExtent2D extent, VkFormat format, VkImageUsageFlags usage, VkImage& image, VmaAllocation& allocation)
+	{
+		VkImageCreateInfo imageInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+			.imageType = VK_IMAGE_TYPE_2D,
+			.format = format,
+			.extent = { extent.width, extent.height, 1 },
+			.mipLevels = 1,
+			.arrayLayers = 1,
+			.samples = VK_SAMPLE_COUNT_1_BIT,
+			.tiling = VK_IMAGE_TILING_OPTIMAL,
+			.usage = usage,
+			.sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+			.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED
+		};
+
+		CreateAttachmentImage(allocator, imageInfo, image, allocation);
+	}
+
+	static VkImageView CreateImageView(VkDevice device, VkImage image, VkFormat format)
+	{
+		VkImageViewCreateInfo viewInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+			.image = image,
+			.viewType = VK_IMAGE_VIEW_TYPE_2D,
+			.format = format,
+			.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 }
+		};
+
+		VkImageView view;
+		[[maybe_unused]] VkResult errorCode = vkCreateImageView(device, &viewInfo, nullptr, &view);
+		assert(errorCode == VK_SUCCESS);
+		return view;
+	}
+
+	GBufferFormats DeferredGBuffer::Formats(GBufferLayout gbufferLayout) noexcept
+	{
+		//RG16F instead of RG16 unorm/snorm, it is the only two channel 16 bit format every device can render to
+		switch (gbufferLayout)
+		{
+		case GBufferLayout::Packed:
+			return GBufferFormats{ VK_FORMAT_R8G8B8A8_SRGB, VK_FORMAT_R16G16_SFLOAT, VK_FORMAT_R8G8_UNORM, 4 + 4 + 2 + 4 };
+		case GBufferLayout::Naive:
+		default:
+			return GBufferFormats{ VK_FORMAT_R16G16B16A16_SFLOAT, VK_FORMAT_R16G16B16A16_SFLOAT, VK_FORMAT_R16G16B16A16_SFLOAT, 8 + 8 + 8 + 4 };
+		}
+	}
+
+	GBufferBandwidth EstimateGBufferBandwidth(GBufferLayout layout, VkExtent2D extent) noexcept
+	{
+		constexpr uint64_t litBytesPerPixel{ 4 };
+
+		const uint64_t pixelCount{ static_cast<uint64_t>(extent.width) * extent.height };
+		const uint32_t bytesPerPixel{ DeferredGBuffer::Formats(layout).bytesPerPixel };
+
+		return GBufferBandwidth
+		{
+			.layout = layout,
+			.extent = extent,
+			.bytesPerPixel = bytesPerPixel,
+			.tiledBytes = pixelCount * litBytesPerPixel,
+			.immediateBytes = pixelCount * (2 * bytesPerPixel + litBytesPerPixel)
+		};
+	}
+
+	void GBufferBandwidth::Print() const
+	{
+		constexpr double megabyte{ 1024.0 * 1024.0 };
+
+		printf("%s G-buffer at %ux%u: %u bytes per pixel, estimated %.1f MiB per frame immediate, %.1f MiB per frame tiled\n",
+			layout == GBufferLayout::Packed ? "Packed" : "Naive", extent.width, extent.height, bytesPerPixel,
+			static_cast<double>(immediateBytes) / megabyte, static_cast<double>(tiledBytes) / megabyte);
+	}
+
+	DeferredGBuffer::DeferredGBuffer(	const VkDevice device,
+										VmaAllocator allocator,
+										const VkExtent2D bufferExtent,
+										const Shaders& shaders,
+										const GBufferLayout gbufferLayout)
+		: depthBuffer{ device, allocator, bufferExtent, VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT }
+		, renderPass{ device, GBufferAttachments(gbufferLayout), GBufferSubpasses(), GBufferDependencies() }
+		, extent{ bufferExtent }
+		, layout{ gbufferLayout }
+		, parent{ device }
+		, memoryAllocator{ allocator }
+	{
+		[[maybe_unused]] VkResult errorCode{ VK_RESULT_MAX_ENUM };
+
+		const GBufferFormats formats{ Formats(layout) };
+		//Only the lit image is stored, the G-buffer lives and dies inside the render pass
+		constexpr VkImageUsageFlags gbufferUsage{ VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT };
+
+		CreateImage(memoryAllocator, extent, formats.albedo, gbufferUsage, albedoImage, albedoAllocation);
+		CreateImage(memoryAllocator, extent, formats.normal, gbufferUsage, normalImage, normalAllocation);
+		CreateImage(memoryAllocator, extent, formats.material, gbufferUsage, materialImage, materialAllocation);
+		CreateImage(memoryAllocator, extent, litFormat, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, litImage, litAllocation);
+
+		albedoView = CreateImageView(device, albedoImage, formats.albedo);
+		normalView = CreateImageView(device, normalImage, formats.normal);
+		materialView = CreateImageView(device, materialImage, formats.material);
+		litView = CreateImageView(device, litImage, litFormat);
+
+		std::array<VkImageView, attachmentCount> framebufferAttachments{ albedoView, normalView, materialView, depthBuffer.View(), litView };
+
+		VkFramebufferCreateInfo framebufferInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
+			.renderPass = renderPass.Handle(),
+			.attachmentCount = static_cast<uint32_t>(framebufferAttachments.size()),
+			.pAttachments = framebufferAttachments.data(),
+			.width = extent.width,
+			.height = extent.height,
+			.layers = 1
+		};
+
+		errorCode = vkCreateFramebuffer(device, &framebufferInfo, nullptr, &framebuffer);
+		assert(errorCode == VK_SUCCESS);
+
+		//Bindings 2 to 5 are input attachments 0 to 3
+		std::array bindings
+		{
+			VkDescriptorSetLayoutBinding{ .binding = 0, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_VERTEX_BIT },
+			VkDescriptorSetLayoutBinding{ .binding = 1, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT },
+			VkDescriptorSetLayoutBinding{ .binding = 2, .descriptorType = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT },
+			VkDescriptorSetLayoutBinding{ .binding = 3, .descriptorType = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT },
+			VkDescriptorSetLayoutBinding{ .binding = 4, .descriptorType = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT },
+			VkDescriptorSetLayoutBinding{ .binding = 5, .descriptorType = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT }
+		};
+
+		VkDescriptorSetLayoutCreateInfo descriptorSetLayoutInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+			.bindingCount = static_cast<uint32_t>(bindings.size()),
+			.pBindings = bindings.data()
+		};
+
+		errorCode = vkCreateDescriptorSetLayout(device, &descriptorSetLayoutInfo, nullptr, &descriptorSetLayout);
+		assert(errorCode == VK_SUCCESS);
+
+		VkPushConstantRange pushConstantRange
+		{
+			.stageFlags = gbufferStages,
+			.offset = 0,
+			.size = sizeof(GBufferConstants)
+		};
+
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+			.setLayoutCount = 1,
+			.pSetLayouts = &descriptorSetLayout,
+			.pushConstantRangeCount = 1,
+			.pPushConstantRanges = &pushConstantRange
+		};
+
+		errorCode = vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout);
+		assert(errorCode == VK_SUCCESS);
+
+		const VkBool32 packed{ layout == GBufferLayout::Packed ? VK_TRUE : VK_FALSE };
+
+		VkSpecializationMapEntry packedEntry
+		{
+			.constantID = packedConstantId,
+			.offset = 0,
+			.size = sizeof(VkBool32)
+		};
+
+		VkSpecializationInfo specializationInfo
+		{
+			.mapEntryCount = 1,
+			.pMapEntries = &packedEntry,
+			.dataSize = sizeof(VkBool32),
+			.pData = &packed
+		};
+
+		std::array geometryStages
+		{
+			VkPipelineShaderStageCreateInfo
+			{
+				.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+				.stage = VK_SHADER_STAGE_VERTEX_BIT,
+				.module = shaders.geometryVertex.Handle(),
+				.pName = "main"
+			},
+			VkPipelineShaderStageCreateInfo
+			{
+				.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+				.stage = VK_SHADER_STAGE_FRAGMENT_BIT,
+				.module = shaders.geometryFragment.Handle(),
+				.pName = "main",
+				.pSpecializationInfo = &specializationInfo
+			}
+		};
+
+		std::array lightingStages
+		{
+			VkPipelineShaderStageCreateInfo
+			{
+				.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+				.stage = VK_SHADER_STAGE_VERTEX_BIT,
+				.module = shaders.lightingVertex.Handle(),
+				.pName = "main"
+			},
+			VkPipelineShaderStageCreateInfo
+			{
+				.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+				.stage = VK_SHADER_STAGE_FRAGMENT_BIT,
+				.module = shaders.lightingFragment.Handle(),
+				.pName = "main",
+				.pSpecializationInfo = &specializationInfo
+			}
+		};
+
+		VkPipelineInputAssemblyStateCreateInfo inputAssembly
+		{
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
+			.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+			.primitiveRestartEnable = VK_FALSE
+		};
+
+		VkViewport viewport
+		{
+			.x = 0.0f,
+			.y = 0.0f,
+			.width = static_cast<float>(extent.width),
+			.height = static_cast<float>(extent.height),
+			.minDepth = 0.0f,
+			.maxDepth = 1.0f
+		};
+
+		VkRect2D scissor
+		{
+			.offset = { 0, 0 },
+			.extent = extent
+		};
+
+		VkPipelineViewportStateCreateInfo viewportState
+		{
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
+			.viewportCount = 1,
+			.pViewports = &viewport,
+			.scissorCount = 1,
+			.pScissors = &scissor
+		};
+
+		VkPipelineRasterizationStateCreateInfo geometryRasterizer
+		{
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
+			.depthClampEnable = VK_FALSE,
+			.rasterizerDiscardEnable = VK_FALSE,
+			.polygonMode = VK_POLYGON_MODE_FILL,
+			.cullMode = VK_CULL_MODE_BACK_BIT,
+			.frontFace = VK_FRONT_FACE_CLOCKWISE,
+			.depthBiasEnable = VK_FALSE,
+			.lineWidth = 1.0f
+		};
+
+		VkPipelineRasterizationStateCreateInfo lightingRasterizer{ geometryRasterizer };
+		lightingRasterizer.cullMode = VK_CULL_MODE_NONE;
+
+		VkPipelineMultisampleStateCreateInfo multisampling
+		{
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
+			.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT
+		};
+
+		VkPipelineDepthStencilStateCreateInfo geometryDepthStencil
+		{
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
+			.depthTestEnable = VK_TRUE,
+			.depthWriteEnable = VK_TRUE,
+			.depthCompareOp = DepthBuffer::compareOp
+		};
+
+		//The fullscreen triangle sits at depth 0, the cleared far depth, so only covered pixels pass and get lit
+		VkPipelineDepthStencilStateCreateInfo lightingDepthStencil
+		{
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
+			.depthTestEnable = VK_TRUE,
+			.depthWriteEnable = VK_FALSE,
+			.depthCompareOp = VK_COMPARE_OP_LESS
+		};
+
+		std::array<VkPipelineColorBlendAttachmentState, 3> gbufferBlendAttachments{};
+		for (VkPipelineColorBlendAttachmentState& blendAttachment : gbufferBlendAttachments)
+		{
+			blendAttachment = VkPipelineColorBlendAttachmentState
+			{
+				.blendEnable = VK_FALSE,
+				.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT
+			};
+		}
+
+		VkPipelineColorBlendStateCreateInfo geometryBlending
+		{
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
+			.logicOpEnable = VK_FALSE,
+			.attachmentCount = static_cast<uint32_t>(gbufferBlendAttachments.size()),
+			.pAttachments = gbufferBlendAttachments.data()
+		};
+
+		VkPipelineColorBlendStateCreateInfo lightingBlending
+		{
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
+			.logicOpEnable = VK_FALSE,
+			.attachmentCount = 1,
+			.pAttachments = gbufferBlendAttachments.data()
+		};
+
+		std::array pipelineInfos
+		{
+			VkGraphicsPipelineCreateInfo
+			{
+				.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+				.stageCount = static_cast<uint32_t>(geometryStages.size()),
+				.pStages = geometryStages.data(),
+				.pVertexInputState = &pulledVertexInputState,
+				.pInputAssemblyState = &inputAssembly,
+				.pViewportState = &viewportState,
+				.pRasterizationState = &geometryRasterizer,
+				.pMultisampleState = &multisampling,
+				.pDepthStencilState = &geometryDepthStencil,
+				.pColorBlendState = &geometryBlending,
+				.layout = pipelineLayout,
+				.renderPass = renderPass.Handle(),
+				.subpass = geometrySubpass
+			},
+			VkGraphicsPipelineCreateInfo
+			{
+				.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+				.stageCount = static_cast<uint32_t>(lightingStages.size()),
+				.pStages = lightingStages.data(),
+				.pVertexInputState = &pulledVertexInputState,
+				.pInputAssemblyState = &inputAssembly,
+				.pViewportState = &viewportState,
+				.pRasterizationState = &lightingRasterizer,
+				.pMultisampleState = &multisampling,
+				.pDepthStencilState = &lightingDepthStencil,
+				.pColorBlendState = &lightingBlending,
+				.layout = pipelineLayout,
+				.renderPass = renderPass.Handle(),
+				.subpass = lightingSubpass
+			}
+		};
+
+		std::array<VkPipeline, 2> pipelines{};
+		errorCode = vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, static_cast<uint32_t>(pipelineInfos.size()), pipelineInfos.data(), nullptr, pipelines.data());
+		assert(errorCode == VK_SUCCESS);
+
+		geometryPipeline = pipelines[0];
+		lightingPipeline = pipelines[1];
+
+		std::array poolSizes
+		{
+			VkDescriptorPoolSize{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2 },
+			VkDescriptorPoolSize{ VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 4 }
+		};
+
+		VkDescriptorPoolCreateInfo descriptorPoolInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+			.maxSets = 1,
+			.poolSizeCount = static_cast<uint32_t>(poolSizes.size()),
+			.pPoolSizes = poolSizes.data()
+		};
+
+		errorCode = vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool);
+		assert(errorCode == VK_SUCCESS);
+
+		VkDescriptorSetAllocateInfo descriptorSetInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+			.descriptorPool = descriptorPool,
+			.descriptorSetCount = 1,
+			.pSetLayouts = &descriptorSetLayout
+		};
+
+		errorCode = vkAllocateDescriptorSets(device, &descriptorSetInfo, &descriptorSet);
+		assert(errorCode == VK_SUCCESS);
+
+		std::array inputAttachmentInfos
+		{
+			VkDescriptorImageInfo{ .imageView = albedoView, .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL },
+			VkDescriptorImageInfo{ .imageView = normalView, .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL },
+			VkDescriptorImageInfo{ .imageView = materialView, .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL },
+			VkDescriptorImageInfo{ .imageView = depthBuffer.View(), .imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL }
+		};
+
+		std::array<VkWriteDescriptorSet, inputAttachmentInfos.size()> descriptorWrites{};
+		for (uint32_t inputAttachment{}; inputAttachment < inputAttachmentInfos.size(); ++inputAttachment)
+		{
+			descriptorWrites[inputAttachment] = VkWriteDescriptorSet
+			{
+				.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+				.dstSet = descriptorSet,
+				.dstBinding = 2 + inputAttachment,
+				.descriptorCount = 1,
+				.descriptorType = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT,
+				.pImageInfo = &inputAttachmentInfos[inputAttachment]
+			};
+		}
+
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+	}
+
+	DeferredGBuffer::~DeferredGBuffer()
+	{
+		vkDestroyDescriptorPool(parent, descriptorPool, nullptr);
+		vkDestroyPipeline(parent, lightingPipeline, nullptr);
+		vkDestroyPipeline(parent, geometryPipeline, nullptr);
+		vkDestroyPipelineLayout(parent, pipelineLayout, nullptr);
+		vkDestroyDescriptorSetLayout(parent, descriptorSetLayout, nullptr);
+		vkDestroyFramebuffer(parent, framebuffer, nullptr);
+
+		vkDestroyImageView(parent, litView, nullptr);
+		vkDestroyImageView(parent, materialView, nullptr);
+		vkDestroyImageView(parent, normalView, nullptr);
+		vkDestroyImageView(parent, albedoView, nullptr);
+		vmaDestroyImage(memoryAllocator, litImage, litAllocation);
+		vmaDestroyImage(memoryAllocator, materialImage, materialAllocation);
+		vmaDestroyImage(memoryAllocator, normalImage, normalAllocation);
+		vmaDestroyImage(memoryAllocator, albedoImage, albedoAllocation);
+	}
+
+	void DeferredGBuffer::BindScene(VkBuffer drawBuffer, VkBuffer materialBuffer)
+	{
+		VkDescriptorBufferInfo drawBufferInfo{ drawBuffer, 0, VK_WHOLE_SIZE };
+		VkDescriptorBufferInfo materialBufferInfo{ materialBuffer, 0, VK_WHOLE_SIZE };
+
+		std::array descriptorWrites
+		{
+			VkWriteDescriptorSet{ .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, .dstSet = descriptorSet, .dstBinding = 0, .descriptorCount = 1, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .pBufferInfo = &drawBufferInfo },
+			VkWriteDescriptorSet{ .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, .dstSet = descriptorSet, .dstBinding = 1, .descriptorCount = 1, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .pBufferInfo = &materialBufferInfo }
+		};
+
+		vkUpdateDescriptorSets(parent, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+	}
+
+	void DeferredGBuffer::Record(	VkCommandBuffer commandBuffer,
+									VkBuffer indexBuffer,
+									const std::vector<VisibilityDraw>& draws,
+									const glm::mat4& viewProjection,
+									const glm::vec3& cameraPosition,
+									const glm::vec3& lightDirection,
+									float ambient) const
+	{
+		std::array<VkClearValue, attachmentCount> clearValues{};
+		clearValues[depthAttachment].depthStencil = { DepthBuffer::clearDepth, 0 };
+
+		VkRenderPassBeginInfo renderPassInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+			.renderPass = renderPass.Handle(),
+			.framebuffer = framebuffer,
+			.renderArea = { { 0, 0 }, extent },
+			.clearValueCount = static_cast<uint32_t>(clearValues.size()),
+			.pClearValues = clearValues.data()
+		};
+
+		GBufferConstants constants
+		{
+			.transform = viewProjection,
+			.lightDirection = glm::vec4{ lightDirection, ambient },
+			.cameraPosition = glm::vec4{ cameraPosition, 1.0f }
+		};
+
+		vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, geometryPipeline);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+		vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+
+		for (uint32_t drawIndex{}; drawIndex < draws.size(); ++drawIndex)
+		{
+			constants.drawIndex = drawIndex;
+			vkCmdPushConstants(commandBuffer, pipelineLayout, gbufferStages, 0, sizeof(GBufferConstants), &constants);
+			vkCmdDrawIndexed(commandBuffer, draws[drawIndex].indexCount, 1, draws[drawIndex].firstIndex, 0, 0);
+		}
+
+		vkCmdNextSubpass(commandBuffer, VK_SUBPASS_CONTENTS_INLINE);
+
+		glm::mat4 pixelToNdc{ 1.0f };
+		pixelToNdc[0][0] = 2.0f / static_cast<float>(extent.width);
+		pixelToNdc[1][1] = 2.0f / static_cast<float>(extent.height);
+		pixelToNdc[3] = glm::vec4{ -1.0f, -1.0f, 0.0f, 1.0f };
+
+		constants.transform = glm::inverse(viewProjection) * pixelToNdc;
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, lightingPipeline);
+		vkCmdPushConstants(commandBuffer, pipelineLayout, gbufferStages, 0, sizeof(GBufferConstants), &constants);
+		vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+
+		vkCmdEndRenderPass(commandBuffer);
+	}
+}
@@ -0,0 +1,65 @@
+#include "Graphics/DepthBuffer.h"
+#include "GPU/AttachmentMemory.h"
+
+#include <vulkan/vulkan_core.h>
+
+#include <assert.h>
+#include <cmath>
+
+namespace cof
+{
+	DepthBuffer::DepthBuffer(const VkDevice device, VmaAllocator allocator, const VkExtent2D imageExtent, const VkImageUsageFlags additionalUsage)
+		: extent{ imageExtent }
+		, parent{ device }
+		, memoryAllocator{ allocator }
+	{
+		[[maybe_unused]] VkResult errorCode{ VK_RESULT_MAX_ENUM };
+
+		VkImageCreateInfo imageInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+			.imageType = VK_IMAGE_TYPE_2D,
+			.format = format,
+			.extent = { extent.width, extent.height, 1 },
+			.mipLevels = 1,
+			.arrayLayers = 1,
+			.samples = VK_SAMPLE_COUNT_1_BIT,
+			.tiling = VK_IMAGE_TILING_OPTIMAL,
+			.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | additionalUsage,
+			.sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+			.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED
+		};
+
+		CreateAttachmentImage(memoryAllocator, imageInfo, image, allocation);
+
+		VkImageViewCreateInfo viewInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+			.image = image,
+			.viewType = VK_IMAGE_VIEW_TYPE_2D,
+			.format = format,
+			.subresourceRange = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 1 }
+		};
+
+		errorCode = vkCreateImageView(device, &viewInfo, nullptr, &view);
+		assert(errorCode == VK_SUCCESS);
+	}
+
+	DepthBuffer::~DepthBuffer()
+	{
+		vkDestroyImageView(parent, view, nullptr);
+		vmaDestroyImage(memoryAllocator, image, allocation);
+	}
+
+	glm::mat4 InfiniteReversedPerspective(float fovY, float aspectRatio, float zNear) noexcept
+	{
+		const float focalLength{ 1.0f / std::tan(fovY * 0.5f) };
+
+		glm::mat4 projection{ 0.0f };
+		projection[0][0] = focalLength / aspectRatio;
+		projection[1][1] = focalLength;
+		projection[2][3] = -1.0f;
+		projection[3][2] = zNear;
+		return projection;
+	}
+}
@@ -0,0 +1,354 @@
+#include "Graphics/DepthPyramid.h"
+#include "GPU/Shader.h"
+
+#include <vulkan/vulkan_core.h>
+
+#include <array>
+#include <algorithm>
+#include <assert.h>
+
+namespace cof
+{
+	struct ReduceConstants
+	{
+		uint32_t destinationWidth;
+		uint32_t destinationHeight;
+	};
+
+	static uint32_t PreviousPowerOfTwo(uint32_t value)
+	{
+		uint32_t result{ 1 };
+		while (result * 2 <= value)
+		{
+			result *= 2;
+		}
+		return result;
+	}
+
+	DepthPyramid::DepthPyramid(	const VkDevice device,
+								VmaAllocator allocator,
+								const VkExtent2D depthExtent,
+								const cof::Shader& reduceShader,
+								const bool reversedZ)
+		: extent{ PreviousPowerOfTwo(depthExtent.width), PreviousPowerOfTwo(depthExtent.height) }
+		, parent{ device }
+		, memoryAllocator{ allocator }
+	{
+		[[maybe_unused]] VkResult errorCode{ VK_RESULT_MAX_ENUM };
+
+		mipCount = 1;
+		while ((std::max(extent.width, extent.height) >> mipCount) != 0)
+		{
+			++mipCount;
+		}
+
+		VkImageCreateInfo imageInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+			.imageType = VK_IMAGE_TYPE_2D,
+			.format = VK_FORMAT_R32_SFLOAT,
+			.extent = { extent.width, extent.height, 1 },
+			.mipLevels = mipCount,
+			.arrayLayers = 1,
+			.samples = VK_SAMPLE_COUNT_1_BIT,
+			.tiling = VK_IMAGE_TILING_OPTIMAL,
+			.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+			.sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+			.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED
+		};
+
+		VmaAllocationCreateInfo imageAllocInfo
+		{
+			.usage = VMA_MEMORY_USAGE_GPU_ONLY
+		};
+
+		errorCode = vmaCreateImage(memoryAllocator, &imageInfo, &imageAllocInfo, &image, &allocation, nullptr);
+		assert(errorCode == VK_SUCCESS);
+
+		VkImageViewCreateInfo viewInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+			.image = image,
+			.viewType = VK_IMAGE_VIEW_TYPE_2D,
+			.format = VK_FORMAT_R32_SFLOAT,
+			.subresourceRange =
+			{
+				.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+				.baseMipLevel = 0,
+				.levelCount = mipCount,
+				.baseArrayLayer = 0,
+				.layerCount = 1
+			}
+		};
+
+		errorCode = vkCreateImageView(device, &viewInfo, nullptr, &fullView);
+		assert(errorCode == VK_SUCCESS);
+
+		mipViews.resize(mipCount);
+		for (uint32_t mip{}; mip < mipCount; ++mip)
+		{
+			viewInfo.subresourceRange.baseMipLevel = mip;
+			viewInfo.subresourceRange.levelCount = 1;
+
+			errorCode = vkCreateImageView(device, &viewInfo, nullptr, &mipViews[mip]);
+			assert(errorCode == VK_SUCCESS);
+		}
+
+		VkSamplerCreateInfo samplerInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+			.magFilter = VK_FILTER_NEAREST,
+			.minFilter = VK_FILTER_NEAREST,
+			.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+			.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+			.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+			.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+			.minLod = 0.0f,
+			.maxLod = static_cast<float>(mipCount)
+		};
+
+		errorCode = vkCreateSampler(device, &samplerInfo, nullptr, &sampler);
+		assert(errorCode == VK_SUCCESS);
+
+		std::array bindings
+		{
+			VkDescriptorSetLayoutBinding
+			{
+				.binding = 0,
+				.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+				.descriptorCount = 1,
+				.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT
+			},
+			VkDescriptorSetLayoutBinding
+			{
+				.binding = 1,
+				.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+				.descriptorCount = 1,
+				.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT
+			}
+		};
+
+		VkDescriptorSetLayoutCreateInfo descriptorSetLayoutInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+			.bindingCount = static_cast<uint32_t>(bindings.size()),
+			.pBindings = bindings.data()
+		};
+
+		errorCode = vkCreateDescriptorSetLayout(device, &descriptorSetLayoutInfo, nullptr, &descriptorSetLayout);
+		assert(errorCode == VK_SUCCESS);
+
+		VkPushConstantRange pushConstantRange
+		{
+			.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+			.offset = 0,
+			.size = sizeof(ReduceConstants)
+		};
+
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+			.setLayoutCount = 1,
+			.pSetLayouts = &descriptorSetLayout,
+			.pushConstantRangeCount = 1,
+			.pPushConstantRanges = &pushConstantRange
+		};
+
+		errorCode = vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout);
+		assert(errorCode == VK_SUCCESS);
+
+		const VkBool32 reversedZConstant{ reversedZ ? VK_TRUE : VK_FALSE };
+
+		VkSpecializationMapEntry specializationEntry
+		{
+			.constantID = 0,
+			.offset = 0,
+			.size = sizeof(VkBool32)
+		};
+
+		VkSpecializationInfo specializationInfo
+		{
+			.mapEntryCount = 1,
+			.pMapEntries = &specializationEntry,
+			.dataSize = sizeof(VkBool32),
+			.pData = &reversedZConstant
+		};
+
+		VkComputePipelineCreateInfo pipelineInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+			.stage =
+			{
+				.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+				.stage = VK_SHADER_STAGE_COMPUTE_BIT,
+				.module = reduceShader.Handle(),
+				.pName = "main",
+				.pSpecializationInfo = &specializationInfo
+			},
+			.layout = pipelineLayout
+		};
+
+		errorCode = vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline);
+		assert(errorCode == VK_SUCCESS);
+
+		std::array poolSizes
+		{
+			VkDescriptorPoolSize{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, mipCount },
+			VkDescriptorPoolSize{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, mipCount }
+		};
+
+		VkDescriptorPoolCreateInfo descriptorPoolInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+			.maxSets = mipCount,
+			.poolSizeCount = static_cast<uint32_t>(poolSizes.size()),
+			.pPoolSizes = poolSizes.data()
+		};
+
+		errorCode = vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool);
+		assert(errorCode == VK_SUCCESS);
+
+		std::vector<VkDescriptorSetLayout> setLayouts(mipCount, descriptorSetLayout);
+		descriptorSets.resize(mipCount);
+
+		VkDescriptorSetAllocateInfo descriptorSetInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+			.descriptorPool = descriptorPool,
+			.descriptorSetCount = mipCount,
+			.pSetLayouts = setLayouts.data()
+		};
+
+		errorCode = vkAllocateDescriptorSets(device, &descriptorSetInfo, descriptorSets.data());
+		assert(errorCode == VK_SUCCESS);
+
+		//Every mip after the first reduces the previous one, the first mip is bound in BindDepth
+		for (uint32_t mip{}; mip < mipCount; ++mip)
+		{
+			VkDescriptorImageInfo sourceInfo
+			{
+				.sampler = sampler,
+				.imageView = mip > 0 ? mipViews[mip - 1] : VK_NULL_HANDLE,
+				.imageLayout = VK_IMAGE_LAYOUT_GENERAL
+			};
+
+			VkDescriptorImageInfo destinationInfo
+			{
+				.imageView = mipViews[mip],
+				.imageLayout = VK_IMAGE_LAYOUT_GENERAL
+			};
+
+			std::array descriptorWrites
+			{
+				VkWriteDescriptorSet
+				{
+					.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+					.dstSet = descriptorSets[mip],
+					.dstBinding = 0,
+					.descriptorCount = 1,
+					.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+					.pImageInfo = &sourceInfo
+				},
+				VkWriteDescriptorSet
+				{
+					.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+					.dstSet = descriptorSets[mip],
+					.dstBinding = 1,
+					.descriptorCount = 1,
+					.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+					.pImageInfo = &destinationInfo
+				}
+			};
+
+			const uint32_t firstWrite{ mip > 0 ? 0u : 1u };
+			vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()) - firstWrite, descriptorWrites.data() + firstWrite, 0, nullptr);
+		}
+	}
+
+	DepthPyramid::~DepthPyramid()
+	{
+		vkDestroyDescriptorPool(parent, descriptorPool, nullptr);
+		vkDestroyPipeline(parent, pipeline, nullptr);
+		vkDestroyPipelineLayout(parent, pipelineLayout, nullptr);
+		vkDestroyDescriptorSetLayout(parent, descriptorSetLayout, nullptr);
+		vkDestroySampler(parent, sampler, nullptr);
+
+		for (auto mipView : mipViews)
+		{
+			vkDestroyImageView(parent, mipView, nullptr);
+		}
+
+		vkDestroyImageView(parent, fullView, nullptr);
+		vmaDestroyImage(memoryAllocator, image, allocation);
+	}
+
+	void DepthPyramid::BindDepth(VkImageView depthView)
+	{
+		VkDescriptorImageInfo depthInfo
+		{
+			.sampler = sampler,
+			.imageView = depthView,
+			.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+		};
+
+		VkWriteDescriptorSet descriptorWrite
+		{
+			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			.dstSet = descriptorSets[0],
+			.dstBinding = 0,
+			.descriptorCount = 1,
+			.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+			.pImageInfo = &depthInfo
+		};
+
+		vkUpdateDescriptorSets(parent, 1, &descriptorWrite, 0, nullptr);
+	}
+
+	void DepthPyramid::Record(VkCommandBuffer commandBuffer) const
+	{
+		//The pyramid is rebuilt from scratch, previous contents can be discarded
+		VkImageMemoryBarrier discardBarrier
+		{
+			.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+			.srcAccessMask = 0,
+			.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+			.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+			.newLayout = VK_IMAGE_LAYOUT_GENERAL,
+			.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+			.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+			.image = image,
+			.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, mipCount, 0, 1 }
+		};
+
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &discardBarrier);
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+
+		for (uint32_t mip{}; mip < mipCount; ++mip)
+		{
+			ReduceConstants constants
+			{
+				.destinationWidth = std::max(extent.width >> mip, 1u),
+				.destinationHeight = std::max(extent.height >> mip, 1u)
+			};
+
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSets[mip], 0, nullptr);
+			vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ReduceConstants), &constants);
+			vkCmdDispatch(commandBuffer, (constants.destinationWidth + workGroupSize - 1) / workGroupSize, (constants.destinationHeight + workGroupSize - 1) / workGroupSize, 1);
+
+			VkImageMemoryBarrier reduceBarrier
+			{
+				.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+				.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+				.dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
+				.oldLayout = VK_IMAGE_LAYOUT_GENERAL,
+				.newLayout = VK_IMAGE_LAYOUT_GENERAL,
+				.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				.image = image,
+				.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, mip, 1, 0, 1 }
+			};
+
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &reduceBarrier);
+		}
+	}
+}
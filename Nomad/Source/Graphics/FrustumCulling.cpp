@@ -0,0 +1,229 @@
+#include "Graphics/FrustumCulling.h"
+#include "GPU/Shader.h"
+
+#include <vulkan/vulkan_core.h>
+#include <glm/geometric.hpp>
+
+#include <array>
+#include <assert.h>
+
+namespace cof
+{
+	constexpr static uint32_t storageBufferCount{ 3 };
+
+	struct CullingConstants
+	{
+		Frustum frustum;
+		uint32_t instanceCount;
+	};
+
+	Frustum ExtractFrustum(const glm::mat4& viewProjection) noexcept
+	{
+		auto row = [&viewProjection](int index)
+		{
+			return glm::vec4{ viewProjection[0][index], viewProjection[1][index], viewProjection[2][index], viewProjection[3][index] };
+		};
+
+		Frustum frustum
+		{
+			.planes
+			{
+				row(3) + row(0),
+				row(3) - row(0),
+				row(3) + row(1),
+				row(3) - row(1),
+				row(2),
+				row(3) - row(2)
+			}
+		};
+
+		for (auto& plane : frustum.planes)
+		{
+			const float length = glm::length(glm::vec3{ plane });
+
+			//An infinite far plane degenerates, make it accept everything
+			plane = length > 0.0f ? plane / length : glm::vec4{ 0.0f, 0.0f, 0.0f, 1.0f };
+		}
+
+		return frustum;
+	}
+
+	FrustumCullingPass::FrustumCullingPass(const VkDevice device, const cof::Shader& cullingShader)
+		: parent{ device }
+	{
+		[[maybe_unused]] VkResult errorCode{ VK_RESULT_MAX_ENUM };
+
+		std::array<VkDescriptorSetLayoutBinding, storageBufferCount> bindings{};
+		for (uint32_t binding{}; binding < bindings.size(); ++binding)
+		{
+			bindings[binding] = VkDescriptorSetLayoutBinding
+			{
+				.binding = binding,
+				.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+				.descriptorCount = 1,
+				.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT
+			};
+		}
+
+		VkDescriptorSetLayoutCreateInfo descriptorSetLayoutInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+			.bindingCount = static_cast<uint32_t>(bindings.size()),
+			.pBindings = bindings.data()
+		};
+
+		errorCode = vkCreateDescriptorSetLayout(device, &descriptorSetLayoutInfo, nullptr, &descriptorSetLayout);
+		assert(errorCode == VK_SUCCESS);
+
+		VkPushConstantRange pushConstantRange
+		{
+			.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+			.offset = 0,
+			.size = sizeof(CullingConstants)
+		};
+
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+			.setLayoutCount = 1,
+			.pSetLayouts = &descriptorSetLayout,
+			.pushConstantRangeCount = 1,
+			.pPushConstantRanges = &pushConstantRange
+		};
+
+		errorCode = vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout);
+		assert(errorCode == VK_SUCCESS);
+
+		VkComputePipelineCreateInfo pipelineInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+			.stage =
+			{
+				.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+				.stage = VK_SHADER_STAGE_COMPUTE_BIT,
+				.module = cullingShader.Handle(),
+				.pName = "main"
+			},
+			.layout = pipelineLayout
+		};
+
+		errorCode = vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline);
+		assert(errorCode == VK_SUCCESS);
+
+		VkDescriptorPoolSize poolSize
+		{
+			.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			.descriptorCount = storageBufferCount
+		};
+
+		VkDescriptorPoolCreateInfo descriptorPoolInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+			.maxSets = 1,
+			.poolSizeCount = 1,
+			.pPoolSizes = &poolSize
+		};
+
+		errorCode = vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool);
+		assert(errorCode == VK_SUCCESS);
+
+		VkDescriptorSetAllocateInfo descriptorSetInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+			.descriptorPool = descriptorPool,
+			.descriptorSetCount = 1,
+			.pSetLayouts = &descriptorSetLayout
+		};
+
+		errorCode = vkAllocateDescriptorSets(device, &descriptorSetInfo, &descriptorSet);
+		assert(errorCode == VK_SUCCESS);
+	}
+
+	FrustumCullingPass::~FrustumCullingPass()
+	{
+		vkDestroyDescriptorPool(parent, descriptorPool, nullptr);
+		vkDestroyPipeline(parent, pipeline, nullptr);
+		vkDestroyPipelineLayout(parent, pipelineLayout, nullptr);
+		vkDestroyDescriptorSetLayout(parent, descriptorSetLayout, nullptr);
+	}
+
+	void FrustumCullingPass::BindBuffers(VkBuffer instanceBuffer, VkBuffer drawCommandBuffer, VkBuffer drawCountBuffer)
+	{
+		drawCommands = drawCommandBuffer;
+		drawCount = drawCountBuffer;
+
+		std::array<VkDescriptorBufferInfo, storageBufferCount> bufferInfos
+		{
+			VkDescriptorBufferInfo{ instanceBuffer, 0, VK_WHOLE_SIZE },
+			VkDescriptorBufferInfo{ drawCommandBuffer, 0, VK_WHOLE_SIZE },
+			VkDescriptorBufferInfo{ drawCountBuffer, 0, VK_WHOLE_SIZE }
+		};
+
+		std::array<VkWriteDescriptorSet, storageBufferCount> descriptorWrites{};
+		for (uint32_t binding{}; binding < descriptorWrites.size(); ++binding)
+		{
+			descriptorWrites[binding] = VkWriteDescriptorSet
+			{
+				.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+				.dstSet = descriptorSet,
+				.dstBinding = binding,
+				.descriptorCount = 1,
+				.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+				.pBufferInfo = &bufferInfos[binding]
+			};
+		}
+
+		vkUpdateDescriptorSets(parent, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+	}
+
+	void FrustumCullingPass::Record(VkCommandBuffer commandBuffer, const Frustum& frustum, uint32_t instanceCount) const
+	{
+		RecordReset(commandBuffer);
+
+		VkMemoryBarrier clearBarrier
+		{
+			.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+			.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+			.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT
+		};
+
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &clearBarrier, 0, nullptr, 0, nullptr);
+
+		RecordCulling(commandBuffer, frustum, instanceCount);
+
+		VkMemoryBarrier cullingBarrier
+		{
+			.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+			.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+			.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT
+		};
+
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 1, &cullingBarrier, 0, nullptr, 0, nullptr);
+	}
+
+	void FrustumCullingPass::RecordReset(VkCommandBuffer commandBuffer) const
+	{
+		assert(drawCount != VK_NULL_HANDLE);
+
+		vkCmdFillBuffer(commandBuffer, drawCount, 0, sizeof(uint32_t), 0);
+	}
+
+	void FrustumCullingPass::RecordCulling(VkCommandBuffer commandBuffer, const Frustum& frustum, uint32_t instanceCount) const
+	{
+		CullingConstants constants
+		{
+			.frustum = frustum,
+			.instanceCount = instanceCount
+		};
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+		vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullingConstants), &constants);
+		vkCmdDispatch(commandBuffer, (instanceCount + workGroupSize - 1) / workGroupSize, 1, 1);
+	}
+
+	void FrustumCullingPass::RecordDraw(VkCommandBuffer commandBuffer, uint32_t maxDrawCount) const
+	{
+		vkCmdDrawIndexedIndirectCount(commandBuffer, drawCommands, 0, drawCount, 0, maxDrawCount, sizeof(VkDrawIndexedIndirectCommand));
+	}
+}
@@ -0,0 +1,470 @@
+#include "Graphics/GeometryStreaming.h"
+#include "Graphics/FrustumCulling.h"
+#include "Graphics/Meshlet.h"
+#include "GPU/GPUContext.h"
+#include "Utils/CpuProfiler.h"
+
+#include <glm/geometric.hpp>
+
+#include <algorithm>
+#include <assert.h>
+#include <cfloat>
+#include <cstdio>
+#include <cstring>
+#include <utility>
+
+namespace cof
+{
+	//Sphere around spheres, centered on their bounding box
+	static glm::vec4 EnclosingSphere(const std::vector<glm::vec4>& spheres) noexcept
+	{
+		glm::vec3 minimum{ FLT_MAX };
+		glm::vec3 maximum{ -FLT_MAX };
+		for (const glm::vec4& sphere : spheres)
+		{
+			minimum = glm::min(minimum, glm::vec3{ sphere } - sphere.w);
+			maximum = glm::max(maximum, glm::vec3{ sphere } + sphere.w);
+		}
+
+		const glm::vec3 center{ (minimum + maximum) * 0.5f };
+		float radius{ 0.0f };
+		for (const glm::vec4& sphere : spheres)
+		{
+			radius = std::max(radius, glm::distance(center, glm::vec3{ sphere }) + sphere.w);
+		}
+
+		return glm::vec4{ center, radius };
+	}
+
+	static bool SphereInFrustum(const Frustum& frustum, const glm::vec3& center, float radius) noexcept
+	{
+		return std::all_of(frustum.planes.begin(), frustum.planes.end(), [&center, radius](const glm::vec4& plane)
+		{
+			return glm::dot(glm::vec3{ plane }, center) + plane.w >= -radius;
+		});
+	}
+
+	CookedClusterMesh CookClusterPages(	const LodChain& chain,
+										const std::vector<QuantizedLitVertex>& vertices,
+										const std::vector<glm::vec3>& positions,
+										const QuantizationTransform& quantization,
+										uint32_t pageSize)
+	{
+		CookedClusterMesh cooked{ .mesh = { .quantization = quantization } };
+		ClusterPageMesh& mesh{ cooked.mesh };
+
+		std::vector<QuantizedLitVertex> pageVertices;
+		std::vector<uint32_t> pageIndices;
+		std::vector<glm::vec4> meshletSpheres;
+		std::vector<glm::vec4> pageSpheres;
+
+		auto flushPage = [&](uint32_t lod)
+		{
+			if (meshletSpheres.empty())
+			{
+				return;
+			}
+
+			const size_t vertexBytes{ pageVertices.size() * sizeof(QuantizedLitVertex) };
+			const size_t indexBytes{ pageIndices.size() * sizeof(uint32_t) };
+
+			std::vector<std::byte> data(vertexBytes + indexBytes);
+			std::memcpy(data.data(), pageVertices.data(), vertexBytes);
+			std::memcpy(data.data() + vertexBytes, pageIndices.data(), indexBytes);
+
+			mesh.pages.push_back(ClusterPage
+			{
+				.boundingSphere = EnclosingSphere(meshletSpheres),
+				.lod = lod,
+				.meshletCount = static_cast<uint32_t>(meshletSpheres.size()),
+				.vertexCount = static_cast<uint32_t>(pageVertices.size()),
+				.indexCount = static_cast<uint32_t>(pageIndices.size())
+			});
+			pageSpheres.push_back(mesh.pages.back().boundingSphere);
+			cooked.pageData.push_back(std::move(data));
+
+			pageVertices.clear();
+			pageIndices.clear();
+			meshletSpheres.clear();
+		};
+
+		for (uint32_t lod{}; lod < chain.lods.size(); ++lod)
+		{
+			mesh.lodFirstPages.push_back(static_cast<uint32_t>(mesh.pages.size()));
+			mesh.lodErrors.push_back(chain.lods[lod].error);
+
+			const auto firstIndex{ chain.indices.begin() + chain.lods[lod].firstIndex };
+			const MeshletMesh meshletMesh{ BuildMeshlets(std::vector<uint32_t>(firstIndex, firstIndex + chain.lods[lod].indexCount), positions) };
+
+			for (const Meshlet& meshlet : meshletMesh.meshlets)
+			{
+				const size_t pageBytes{ (pageVertices.size() + meshlet.vertexCount) * sizeof(QuantizedLitVertex) + (pageIndices.size() + meshlet.triangleCount * 3) * sizeof(uint32_t) };
+				if (pageBytes > pageSize)
+				{
+					flushPage(lod);
+				}
+				assert(meshlet.vertexCount * sizeof(QuantizedLitVertex) + meshlet.triangleCount * 3 * sizeof(uint32_t) <= pageSize);
+
+				const uint32_t firstVertex{ static_cast<uint32_t>(pageVertices.size()) };
+				for (uint32_t vertex{}; vertex < meshlet.vertexCount; ++vertex)
+				{
+					pageVertices.push_back(vertices[meshletMesh.meshletVertices[meshlet.vertexOffset + vertex]]);
+				}
+				for (uint32_t corner{}; corner < meshlet.triangleCount * 3; ++corner)
+				{
+					pageIndices.push_back(firstVertex + meshletMesh.meshletTriangles[meshlet.triangleOffset + corner]);
+				}
+				meshletSpheres.push_back(meshlet.boundingSphere);
+			}
+
+			//Pages never mix LODs, only one LOD of an instance is drawn at a time
+			flushPage(lod);
+		}
+
+		mesh.lodFirstPages.push_back(static_cast<uint32_t>(mesh.pages.size()));
+		mesh.boundingSphere = pageSpheres.empty() ? glm::vec4{ 0.0f } : EnclosingSphere(pageSpheres);
+		return cooked;
+	}
+
+	void GeometryStreamingStatistics::Print() const
+	{
+		constexpr double megabyte{ 1024.0 * 1024.0 };
+
+		printf("Geometry streaming: %u / %u slots resident of %u pages, %u loading, %u pages drawn, %u instances on a coarser LOD\n",
+			residentPages, slotCount, pageCount, loadingPages, drawnPages, fallbackInstances);
+		printf("%u instances coarser and %u left out to stay within %u draws\n", cappedInstances, droppedInstances, GeometryStreamer::maxDraws);
+		printf("%.1f MiB streamed, %u evictions, %.1f MiB VRAM, %.1f KiB page metadata\n",
+			static_cast<double>(streamedBytes) / megabyte, evictionCount, static_cast<double>(vramBytes) / megabyte, static_cast<double>(metadataBytes) / 1024.0);
+	}
+
+	GeometryStreamer::GeometryStreamer(const cof::GPUContext& gpuContext, UploadStreamer& uploadStreamer, uint32_t pageSlotCount, uint32_t maxLoadingPages)
+		: pageBuffer{ gpuContext, static_cast<VkDeviceSize>(pageSlotCount) * clusterPageSize }
+		, uploads{ uploadStreamer }
+		, slotPages(pageSlotCount, noPage)
+		, maxLoading{ maxLoadingPages }
+	{
+		slotBase = pageBuffer.Allocate(pageBuffer.Capacity(), sizeof(uint32_t));
+	}
+
+	uint32_t GeometryStreamer::AddMesh(ClusterPageMesh mesh, std::function<std::vector<std::byte>(uint32_t pageIndex)> loadPage)
+	{
+		const uint32_t meshIndex{ static_cast<uint32_t>(meshes.size()) };
+		const uint32_t firstPage{ static_cast<uint32_t>(pageStates.size()) };
+		const uint32_t coarsestLod{ mesh.LodCount() - 1 };
+
+		for (uint32_t page{}; page < mesh.pages.size(); ++page)
+		{
+			pageStates.push_back(PageState
+			{
+				.mesh = meshIndex,
+				.slot = noSlot,
+				.ticket = 0,
+				.lastUsedFrame = 0,
+				.pinned = mesh.pages[page].lod == coarsestLod
+			});
+		}
+
+		const uint32_t coarsestFirst{ mesh.lodFirstPages[coarsestLod] };
+		const uint32_t coarsestEnd{ mesh.lodFirstPages[coarsestLod + 1] };
+		meshes.push_back(Mesh{ .pages = std::move(mesh), .loadPage = std::move(loadPage), .firstPage = firstPage });
+
+		//Every instance can always fall back to the coarsest LOD, so there has to be room for it
+		for (uint32_t page{ coarsestFirst }; page < coarsestEnd; ++page)
+		{
+			[[maybe_unused]] const bool requested{ Request(firstPage + page, UploadPriority::Visible) };
+			assert(requested);
+		}
+
+		return meshIndex;
+	}
+
+	uint32_t GeometryStreamer::AddInstance(uint32_t meshIndex, const glm::mat4& model, uint32_t materialIndex)
+	{
+		const float scale{ std::max({ glm::length(glm::vec3{ model[0] }), glm::length(glm::vec3{ model[1] }), glm::length(glm::vec3{ model[2] }) }) };
+		instances.push_back(Instance{ .mesh = meshIndex, .model = model, .scale = scale, .materialIndex = materialIndex });
+		return static_cast<uint32_t>(instances.size() - 1);
+	}
+
+	const std::vector<VisibilityDraw>& GeometryStreamer::Update(const glm::mat4& viewProjection, const glm::vec3& cameraPosition, float projectionScale, float maxPixelError)
+	{
+		CPU_ZONE("GeometryStreamer::Update");
+
+		++frame;
+		draws.clear();
+		requests.clear();
+		drawnPages = 0;
+		fallbackInstances = 0;
+		cappedInstances = 0;
+
+		for (PageState& pageState : pageStates)
+		{
+			if (pageState.ticket != 0 && uploads.Completed(pageState.ticket))
+			{
+				pageState.ticket = 0;
+				--loadingCount;
+			}
+		}
+
+		const Frustum frustum{ ExtractFrustum(viewProjection) };
+
+		visibleInstances.clear();
+		for (uint32_t instanceIndex{}; instanceIndex < instances.size(); ++instanceIndex)
+		{
+			const Instance& instance{ instances[instanceIndex] };
+			const Mesh& mesh{ meshes[instance.mesh] };
+			const glm::vec3 center{ instance.model * glm::vec4{ glm::vec3{ mesh.pages.boundingSphere }, 1.0f } };
+			const float radius{ mesh.pages.boundingSphere.w * instance.scale };
+			if (!SphereInFrustum(frustum, center, radius))
+			{
+				continue;
+			}
+
+			//Same selection as SelectLod, against the errors of the cooked LODs
+			const float distance{ std::max(glm::distance(center, cameraPosition) - radius, 0.0f) };
+			const float maxError{ maxPixelError * distance / instance.scale / projectionScale };
+			uint32_t selectedLod{ 0 };
+			while (selectedLod + 1 < mesh.pages.LodCount() && mesh.pages.lodErrors[selectedLod + 1] <= maxError)
+			{
+				++selectedLod;
+			}
+
+			CollectVisiblePages(instance, mesh.pages.LodCount() - 1, frustum);
+			visibleInstances.push_back(VisibleInstance
+			{
+				.instance = instanceIndex,
+				.distance = distance,
+				.selectedLod = selectedLod,
+				.minimumDraws = static_cast<uint32_t>(visiblePages.size())
+			});
+		}
+
+		//Nearest first, they keep their LOD when the draws run short
+		std::sort(visibleInstances.begin(), visibleInstances.end(), [](const VisibleInstance& a, const VisibleInstance& b)
+		{
+			return a.distance < b.distance;
+		});
+
+		//Draws the coarsest LODs of the instances after the current one take, the farthest instances that don't fit at all are left out
+		size_t reservedDraws{ 0 };
+		size_t fittingCount{ 0 };
+		while (fittingCount < visibleInstances.size() && reservedDraws + visibleInstances[fittingCount].minimumDraws <= maxDraws)
+		{
+			reservedDraws += visibleInstances[fittingCount].minimumDraws;
+			++fittingCount;
+		}
+		droppedInstances = static_cast<uint32_t>(visibleInstances.size() - fittingCount);
+
+		for (size_t visibleIndex{}; visibleIndex < fittingCount; ++visibleIndex)
+		{
+			const VisibleInstance& visibleInstance{ visibleInstances[visibleIndex] };
+			const Instance& instance{ instances[visibleInstance.instance] };
+			const Mesh& mesh{ meshes[instance.mesh] };
+			reservedDraws -= visibleInstance.minimumDraws;
+			//At least minimumDraws, what was reserved for this instance is part of it
+			const size_t availableDraws{ maxDraws - reservedDraws - draws.size() };
+
+			//Finest LOD that fits, its missing pages are requested
+			uint32_t requestedLod{ noLod };
+			for (uint32_t lod{ visibleInstance.selectedLod }; lod < mesh.pages.LodCount(); ++lod)
+			{
+				CollectVisiblePages(instance, lod, frustum);
+
+				//The coarsest LOD is pinned, only its first upload can leave it incomplete, and it always fits
+				const bool last{ lod + 1 == mesh.pages.LodCount() };
+				if (visiblePages.size() > availableDraws && !last)
+				{
+					continue;
+				}
+				if (requestedLod == noLod)
+				{
+					requestedLod = lod;
+				}
+
+				bool complete{ true };
+				for (const uint32_t globalPage : visiblePages)
+				{
+					if (IsResident(globalPage))
+					{
+						//Kept while its siblings load, even when a coarser LOD is drawn meanwhile
+						pageStates[globalPage].lastUsedFrame = frame;
+					}
+					else
+					{
+						complete = false;
+						if (lod == requestedLod && pageStates[globalPage].slot == noSlot)
+						{
+							const glm::vec4& sphere{ mesh.pages.pages[globalPage - mesh.firstPage].boundingSphere };
+							const glm::vec3 pageCenter{ instance.model * glm::vec4{ glm::vec3{ sphere }, 1.0f } };
+							requests.push_back(PageRequest{ globalPage, std::max(glm::distance(pageCenter, cameraPosition) - sphere.w * instance.scale, 0.0f) });
+						}
+					}
+				}
+
+				if (!complete && !last)
+				{
+					continue;
+				}
+
+				for (const uint32_t page : visiblePages)
+				{
+					if (IsResident(page))
+					{
+						draws.push_back(PageDraw(instance, page));
+						++drawnPages;
+					}
+				}
+
+				if (lod != visibleInstance.selectedLod)
+				{
+					++fallbackInstances;
+				}
+				if (requestedLod != visibleInstance.selectedLod)
+				{
+					++cappedInstances;
+				}
+				break;
+			}
+		}
+		assert(draws.size() <= maxDraws);
+
+		//Nearest pages first, several instances of a mesh may want the same page
+		std::sort(requests.begin(), requests.end(), [](const PageRequest& a, const PageRequest& b)
+		{
+			return a.distance < b.distance;
+		});
+
+		for (const PageRequest& request : requests)
+		{
+			if (loadingCount >= maxLoading)
+			{
+				break;
+			}
+			if (pageStates[request.page].slot == noSlot && !Request(request.page, UploadPriority::Visible))
+			{
+				break;
+			}
+		}
+
+		return draws;
+	}
+
+	GeometryStreamingStatistics GeometryStreamer::Statistics() const noexcept
+	{
+		size_t metadataBytes{ pageStates.size() * sizeof(PageState) };
+		for (const Mesh& mesh : meshes)
+		{
+			metadataBytes += mesh.pages.pages.size() * sizeof(ClusterPage) + mesh.pages.lodFirstPages.size() * sizeof(uint32_t) + mesh.pages.lodErrors.size() * sizeof(float);
+		}
+
+		const uint32_t usedSlots{ static_cast<uint32_t>(std::count_if(slotPages.begin(), slotPages.end(), [](uint32_t page) { return page != noPage; })) };
+
+		return GeometryStreamingStatistics
+		{
+			.pageCount = static_cast<uint32_t>(pageStates.size()),
+			.residentPages = usedSlots - loadingCount,
+			.loadingPages = loadingCount,
+			.slotCount = static_cast<uint32_t>(slotPages.size()),
+			.drawnPages = drawnPages,
+			.fallbackInstances = fallbackInstances,
+			.cappedInstances = cappedInstances,
+			.droppedInstances = droppedInstances,
+			.streamedBytes = streamedBytes,
+			.evictionCount = evictionCount,
+			.vramBytes = pageBuffer.Capacity(),
+			.metadataBytes = metadataBytes
+		};
+	}
+
+	bool GeometryStreamer::Request(uint32_t page, UploadPriority priority)
+	{
+		const uint32_t slot{ AllocateSlot() };
+		if (slot == noSlot)
+		{
+			return false;
+		}
+
+		if (slotPages[slot] != noPage)
+		{
+			pageStates[slotPages[slot]].slot = noSlot;
+			++evictionCount;
+		}
+
+		PageState& pageState{ pageStates[page] };
+		const Mesh& mesh{ meshes[pageState.mesh] };
+		std::vector<std::byte> data{ mesh.loadPage(page - mesh.firstPage) };
+		assert(data.size() <= clusterPageSize);
+		streamedBytes += data.size();
+
+		pageState.slot = slot;
+		pageState.lastUsedFrame = frame;
+		pageState.ticket = uploads.Enqueue(BufferUpload
+		{
+			.buffer = pageBuffer.Handle(),
+			.offset = slotBase + static_cast<VkDeviceSize>(slot) * clusterPageSize,
+			.data = std::move(data),
+			.dstAccess = VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_SHADER_READ_BIT
+		}, priority);
+
+		slotPages[slot] = page;
+		++loadingCount;
+		return true;
+	}
+
+	uint32_t GeometryStreamer::AllocateSlot()
+	{
+		uint32_t leastRecentlyUsed{ noSlot };
+		for (uint32_t slot{}; slot < slotPages.size(); ++slot)
+		{
+			if (slotPages[slot] == noPage)
+			{
+				return slot;
+			}
+
+			const PageState& pageState{ pageStates[slotPages[slot]] };
+			if (!pageState.pinned && pageState.ticket == 0 && frame - pageState.lastUsedFrame > retireLatency
+				&& (leastRecentlyUsed == noSlot || pageState.lastUsedFrame < pageStates[slotPages[leastRecentlyUsed]].lastUsedFrame))
+			{
+				leastRecentlyUsed = slot;
+			}
+		}
+
+		return leastRecentlyUsed;
+	}
+
+	void GeometryStreamer::CollectVisiblePages(const Instance& instance, uint32_t lod, const Frustum& frustum)
+	{
+		const Mesh& mesh{ meshes[instance.mesh] };
+		visiblePages.clear();
+		for (uint32_t page{ mesh.pages.lodFirstPages[lod] }; page < mesh.pages.lodFirstPages[lod + 1]; ++page)
+		{
+			const glm::vec4& sphere{ mesh.pages.pages[page].boundingSphere };
+			const glm::vec3 pageCenter{ instance.model * glm::vec4{ glm::vec3{ sphere }, 1.0f } };
+			if (SphereInFrustum(frustum, pageCenter, sphere.w * instance.scale))
+			{
+				visiblePages.push_back(mesh.firstPage + page);
+			}
+		}
+	}
+
+	VisibilityDraw GeometryStreamer::PageDraw(const Instance& instance, uint32_t page) const noexcept
+	{
+		const Mesh& mesh{ meshes[instance.mesh] };
+		const ClusterPage& clusterPage{ mesh.pages.pages[page - mesh.firstPage] };
+
+		const VkDeviceSize vertexOffset{ slotBase + static_cast<VkDeviceSize>(pageStates[page].slot) * clusterPageSize };
+		const VkDeviceSize indexOffset{ vertexOffset + clusterPage.vertexCount * sizeof(QuantizedLitVertex) };
+
+		return VisibilityDraw
+		{
+			.model = instance.model,
+			.dequantizeOffset = glm::vec4{ mesh.pages.quantization.offset, 0.0f },
+			.dequantizeScale = glm::vec4{ mesh.pages.quantization.scale, 0.0f },
+			.vertices = pageBuffer.DeviceAddress(vertexOffset),
+			.indices = pageBuffer.DeviceAddress(indexOffset),
+			.indexCount = clusterPage.indexCount,
+			.firstIndex = static_cast<uint32_t>(indexOffset / sizeof(uint32_t)),
+			.materialIndex = instance.materialIndex,
+			.padding = 0
+		};
+	}
+}
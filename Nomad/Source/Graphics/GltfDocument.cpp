@@ -0,0 +1,355 @@
+#include "Graphics/GltfDocument.h"
+
+#include <nlohmann/json.hpp>
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <utility>
+
+namespace cof
+{
+	using Json = nlohmann::json;
+
+	//Lookups that treat missing members and members of the wrong type alike, nlohmann::json asserts or throws on both
+	static const Json& Member(const Json& object, const char* key)
+	{
+		static const Json missing{};
+		if (!object.is_object())
+		{
+			return missing;
+		}
+
+		const auto member{ object.find(key) };
+		return member != object.end() ? *member : missing;
+	}
+
+	//Elements of an array member, none if it isn't one
+	static const Json& Elements(const Json& object, const char* key)
+	{
+		//Parentheses, braces would make it the only element of an array
+		static const Json empty(Json::array());
+		const Json& member{ Member(object, key) };
+		return member.is_array() ? member : empty;
+	}
+
+	static double ToNumber(const Json& value, double fallback = 0.0)
+	{
+		return value.is_number() ? value.get<double>() : fallback;
+	}
+
+	static size_t ToSize(const Json& value)
+	{
+		const double number{ ToNumber(value) };
+		return number >= 0.0 && number < 4294967296.0 ? static_cast<size_t>(number) : 0;
+	}
+
+	static uint32_t ToIndex(const Json& value)
+	{
+		const double index{ ToNumber(value, -1.0) };
+		return index >= 0.0 && index < static_cast<double>(GltfDocument::noIndex) ? static_cast<uint32_t>(index) : GltfDocument::noIndex;
+	}
+
+	static std::string ToString(const Json& value)
+	{
+		return value.is_string() ? value.get<std::string>() : std::string{};
+	}
+
+	static std::optional<std::vector<std::byte>> ReadFile(const std::filesystem::path& path)
+	{
+		std::ifstream file{ path, std::ios::binary };
+		if (!file)
+		{
+			return std::nullopt;
+		}
+
+		const std::vector<char> bytes{ std::istreambuf_iterator<char>{ file }, std::istreambuf_iterator<char>{} };
+		std::vector<std::byte> data(bytes.size());
+		std::memcpy(data.data(), bytes.data(), bytes.size());
+		return data;
+	}
+
+	static std::optional<std::vector<std::byte>> DecodeBase64(std::string_view text)
+	{
+		auto sextet = [](char character) -> int
+		{
+			if (character >= 'A' && character <= 'Z') return character - 'A';
+			if (character >= 'a' && character <= 'z') return character - 'a' + 26;
+			if (character >= '0' && character <= '9') return character - '0' + 52;
+			if (character == '+') return 62;
+			if (character == '/') return 63;
+			return -1;
+		};
+
+		std::vector<std::byte> data;
+		data.reserve(text.size() / 4 * 3);
+
+		uint32_t bits{ 0 };
+		uint32_t bitCount{ 0 };
+		for (const char character : text)
+		{
+			if (character == '=')
+			{
+				break;
+			}
+
+			const int value{ sextet(character) };
+			if (value < 0)
+			{
+				return std::nullopt;
+			}
+
+			bits = (bits << 6) | static_cast<uint32_t>(value);
+			bitCount += 6;
+			if (bitCount >= 8)
+			{
+				bitCount -= 8;
+				data.push_back(static_cast<std::byte>((bits >> bitCount) & 0xff));
+			}
+		}
+
+		return data;
+	}
+
+	static std::optional<std::vector<std::byte>> LoadBuffer(const Json& buffer, const std::filesystem::path& directory)
+	{
+		const std::string uri{ ToString(Member(buffer, "uri")) };
+		std::optional<std::vector<std::byte>> data;
+
+		constexpr std::string_view dataUri{ "data:" };
+		if (uri.compare(0, dataUri.size(), dataUri) == 0)
+		{
+			const size_t payload{ uri.find(";base64,") };
+			if (payload != std::string::npos)
+			{
+				data = DecodeBase64(std::string_view{ uri }.substr(payload + 8));
+			}
+		}
+		else if (!uri.empty())
+		{
+			data = ReadFile(directory / uri);
+		}
+
+		if (!data || data->size() < ToSize(Member(buffer, "byteLength")))
+		{
+			printf("Couldn't load glTF buffer %s\n", uri.compare(0, dataUri.size(), dataUri) == 0 ? "data URI" : uri.c_str());
+			return std::nullopt;
+		}
+
+		return data;
+	}
+
+	static glm::mat4 NodeTransform(const Json& node)
+	{
+		glm::mat4 transform{ 1.0f };
+		if (const Json& matrix{ Elements(node, "matrix") }; matrix.size() == 16)
+		{
+			//Column major like glm
+			for (int column{}; column < 4; ++column)
+			{
+				for (int row{}; row < 4; ++row)
+				{
+					transform[column][row] = static_cast<float>(ToNumber(matrix[static_cast<size_t>(column * 4 + row)]));
+				}
+			}
+			return transform;
+		}
+
+		//Translation * rotation * scale, the rotation is a unit quaternion stored as x, y, z, w
+		const Json& translation{ Elements(node, "translation") };
+		const Json& rotation{ Elements(node, "rotation") };
+		const Json& scale{ Elements(node, "scale") };
+
+		if (rotation.size() == 4)
+		{
+			const float x{ static_cast<float>(ToNumber(rotation[0])) };
+			const float y{ static_cast<float>(ToNumber(rotation[1])) };
+			const float z{ static_cast<float>(ToNumber(rotation[2])) };
+			const float w{ static_cast<float>(ToNumber(rotation[3], 1.0)) };
+
+			transform[0] = glm::vec4{ 1.0f - 2.0f * (y * y + z * z), 2.0f * (x * y + z * w), 2.0f * (x * z - y * w), 0.0f };
+			transform[1] = glm::vec4{ 2.0f * (x * y - z * w), 1.0f - 2.0f * (x * x + z * z), 2.0f * (y * z + x * w), 0.0f };
+			transform[2] = glm::vec4{ 2.0f * (x * z + y * w), 2.0f * (y * z - x * w), 1.0f - 2.0f * (x * x + y * y), 0.0f };
+		}
+		if (scale.size() == 3)
+		{
+			for (int axis{}; axis < 3; ++axis)
+			{
+				transform[axis] *= static_cast<float>(ToNumber(scale[static_cast<size_t>(axis)], 1.0));
+			}
+		}
+		if (translation.size() == 3)
+		{
+			transform[3] = glm::vec4{ static_cast<float>(ToNumber(translation[0])), static_cast<float>(ToNumber(translation[1])), static_cast<float>(ToNumber(translation[2])), 1.0f };
+		}
+
+		return transform;
+	}
+
+	static std::vector<uint32_t> ToIndices(const Json& indices)
+	{
+		std::vector<uint32_t> result;
+		for (const Json& index : indices)
+		{
+			result.push_back(ToIndex(index));
+		}
+		return result;
+	}
+
+	std::optional<GltfAccessorView> GltfDocument::ResolveAccessor(uint32_t accessorIndex) const
+	{
+		if (accessorIndex >= accessors.size())
+		{
+			return std::nullopt;
+		}
+
+		const Accessor& accessor{ accessors[accessorIndex] };
+		if (accessor.sparse || accessor.componentCount == 0 || accessor.bufferView >= bufferViews.size())
+		{
+			return std::nullopt;
+		}
+
+		const BufferView& bufferView{ bufferViews[accessor.bufferView] };
+		if (bufferView.buffer >= buffers.size())
+		{
+			return std::nullopt;
+		}
+
+		const size_t componentSize{ accessor.componentType == componentTypeUnsignedByte ? 1u : accessor.componentType == componentTypeUnsignedShort ? 2u : 4u };
+		const size_t elementSize{ componentSize * accessor.componentCount };
+		const size_t stride{ bufferView.byteStride != 0 ? bufferView.byteStride : elementSize };
+		const size_t viewEnd{ bufferView.byteOffset + bufferView.byteLength };
+		const size_t accessorEnd{ bufferView.byteOffset + accessor.byteOffset + (accessor.count == 0 ? 0 : (accessor.count - 1) * stride + elementSize) };
+		if (viewEnd > buffers[bufferView.buffer].size() || accessorEnd > viewEnd)
+		{
+			return std::nullopt;
+		}
+
+		return GltfAccessorView
+		{
+			.data = buffers[bufferView.buffer].data() + bufferView.byteOffset + accessor.byteOffset,
+			.count = accessor.count,
+			.stride = stride,
+			.componentType = accessor.componentType,
+			.componentCount = accessor.componentCount
+		};
+	}
+
+	std::optional<GltfDocument> ParseGltf(std::string_view json, const std::filesystem::path& directory)
+	{
+		const Json document(Json::parse(json, nullptr, false));
+		if (document.is_discarded())
+		{
+			return std::nullopt;
+		}
+
+		GltfDocument gltf{ .scene = ToIndex(Member(document, "scene")) };
+
+		for (const Json& buffer : Elements(document, "buffers"))
+		{
+			std::optional<std::vector<std::byte>> data{ LoadBuffer(buffer, directory) };
+			if (!data)
+			{
+				return std::nullopt;
+			}
+			gltf.buffers.push_back(std::move(*data));
+		}
+
+		for (const Json& bufferView : Elements(document, "bufferViews"))
+		{
+			gltf.bufferViews.push_back(GltfDocument::BufferView
+			{
+				.buffer = ToIndex(Member(bufferView, "buffer")),
+				.byteOffset = ToSize(Member(bufferView, "byteOffset")),
+				.byteLength = ToSize(Member(bufferView, "byteLength")),
+				.byteStride = ToSize(Member(bufferView, "byteStride"))
+			});
+		}
+
+		for (const Json& accessor : Elements(document, "accessors"))
+		{
+			const std::string type{ ToString(Member(accessor, "type")) };
+			gltf.accessors.push_back(GltfDocument::Accessor
+			{
+				.bufferView = ToIndex(Member(accessor, "bufferView")),
+				.byteOffset = ToSize(Member(accessor, "byteOffset")),
+				.count = ToSize(Member(accessor, "count")),
+				.componentType = static_cast<uint32_t>(ToSize(Member(accessor, "componentType"))),
+				.componentCount = type == "SCALAR" ? 1u : type == "VEC2" ? 2u : type == "VEC3" ? 3u : type == "VEC4" ? 4u : 0u,
+				.sparse = !Member(accessor, "sparse").is_null()
+			});
+		}
+
+		for (const Json& mesh : Elements(document, "meshes"))
+		{
+			GltfDocument::Mesh& added{ gltf.meshes.emplace_back() };
+			added.name = ToString(Member(mesh, "name"));
+			for (const Json& primitive : Elements(mesh, "primitives"))
+			{
+				const Json& attributes{ Member(primitive, "attributes") };
+				added.primitives.push_back(GltfDocument::Primitive
+				{
+					.position = ToIndex(Member(attributes, "POSITION")),
+					.normal = ToIndex(Member(attributes, "NORMAL")),
+					.texCoord = ToIndex(Member(attributes, "TEXCOORD_0")),
+					.indices = ToIndex(Member(primitive, "indices")),
+					.material = ToIndex(Member(primitive, "material")),
+					.mode = static_cast<uint32_t>(ToNumber(Member(primitive, "mode"), GltfDocument::modeTriangles))
+				});
+			}
+		}
+
+		for (const Json& material : Elements(document, "materials"))
+		{
+			const Json& pbr{ Member(material, "pbrMetallicRoughness") };
+			const Json& factor{ Elements(pbr, "baseColorFactor") };
+			gltf.materials.push_back(GltfDocument::Material
+			{
+				.baseColorFactor = factor.size() == 4
+					? glm::vec4{ static_cast<float>(ToNumber(factor[0])), static_cast<float>(ToNumber(factor[1])), static_cast<float>(ToNumber(factor[2])), static_cast<float>(ToNumber(factor[3])) }
+					: glm::vec4{ 1.0f },
+				.baseColorTexture = ToIndex(Member(Member(pbr, "baseColorTexture"), "index"))
+			});
+		}
+
+		for (const Json& texture : Elements(document, "textures"))
+		{
+			gltf.textureSources.push_back(ToIndex(Member(texture, "source")));
+		}
+
+		for (const Json& image : Elements(document, "images"))
+		{
+			gltf.imageUris.push_back(ToString(Member(image, "uri")));
+		}
+
+		for (const Json& node : Elements(document, "nodes"))
+		{
+			gltf.nodes.push_back(GltfDocument::Node
+			{
+				.transform = NodeTransform(node),
+				.mesh = ToIndex(Member(node, "mesh")),
+				.children = ToIndices(Elements(node, "children"))
+			});
+		}
+
+		for (const Json& scene : Elements(document, "scenes"))
+		{
+			gltf.scenes.push_back(ToIndices(Elements(scene, "nodes")));
+		}
+
+		return gltf;
+	}
+
+	std::optional<GltfDocument> LoadGltf(const std::filesystem::path& path)
+	{
+		std::ifstream file{ path, std::ios::binary };
+		if (!file)
+		{
+			return std::nullopt;
+		}
+
+		const std::string json{ std::istreambuf_iterator<char>{ file }, std::istreambuf_iterator<char>{} };
+		return ParseGltf(json, path.parent_path());
+	}
+}
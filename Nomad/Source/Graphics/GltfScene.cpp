@@ -0,0 +1,345 @@
+#include "Graphics/GltfScene.h"
+#include "Graphics/GltfDocument.h"
+
+#include <glm/ext/matrix_float3x3.hpp>
+#include <glm/ext/matrix_float4x4.hpp>
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <utility>
+
+namespace cof
+{
+	//Lights the base color so shapes read without textures
+	static const glm::vec3 lightDirection{ 0.267f, 0.890f, 0.178f };
+	constexpr float ambient{ 0.25f };
+
+	//A vertex of the primitive being optimized, MeshOptimizer reorders the texture coordinates along with the vertices
+	struct PrimitiveVertex
+	{
+		glm::vec3 position;
+		glm::vec4 color;
+		glm::vec2 texCoord;
+	};
+
+	static glm::vec3 ReadVec3(const GltfAccessorView& view, size_t element) noexcept
+	{
+		glm::vec3 value;
+		std::memcpy(&value, view.data + element * view.stride, sizeof(value));
+		return value;
+	}
+
+	static glm::vec2 ReadVec2(const GltfAccessorView& view, size_t element) noexcept
+	{
+		glm::vec2 value;
+		std::memcpy(&value, view.data + element * view.stride, sizeof(value));
+		return value;
+	}
+
+	static uint32_t ReadIndex(const GltfAccessorView& view, size_t element) noexcept
+	{
+		const std::byte* data{ view.data + element * view.stride };
+		switch (view.componentType)
+		{
+		case GltfDocument::componentTypeUnsignedByte:
+			return std::to_integer<uint32_t>(data[0]);
+		case GltfDocument::componentTypeUnsignedShort:
+		{
+			uint16_t index;
+			std::memcpy(&index, data, sizeof(index));
+			return index;
+		}
+		default:
+		{
+			uint32_t index;
+			std::memcpy(&index, data, sizeof(index));
+			return index;
+		}
+		}
+	}
+
+	static glm::vec4 BaseColor(const GltfDocument& document, const GltfDocument::Primitive& primitive)
+	{
+		return primitive.material < document.materials.size() ? document.materials[primitive.material].baseColorFactor : glm::vec4{ 1.0f };
+	}
+
+	//Image behind the material's base color texture, GltfScene::noImage if it has none
+	static uint32_t BaseColorImage(const GltfDocument& document, const GltfDocument::Primitive& primitive)
+	{
+		if (primitive.material >= document.materials.size())
+		{
+			return GltfScene::noImage;
+		}
+
+		const uint32_t texture{ document.materials[primitive.material].baseColorTexture };
+		const uint32_t image{ texture < document.textureSources.size() ? document.textureSources[texture] : GltfDocument::noIndex };
+		return image < document.imageUris.size() ? image : GltfScene::noImage;
+	}
+
+	//Sums the counts and derives the ratios of the sum, so large primitives weigh more
+	static void Accumulate(MeshOptimizer::VertexCacheStatistics& total, const MeshOptimizer::VertexCacheStatistics& statistics) noexcept
+	{
+		total.triangleCount += statistics.triangleCount;
+		total.vertexCount += statistics.vertexCount;
+		total.transformedVertexCount += statistics.transformedVertexCount;
+		total.acmr = total.triangleCount != 0 ? static_cast<float>(total.transformedVertexCount) / static_cast<float>(total.triangleCount) : 0.0f;
+		total.atvr = total.vertexCount != 0 ? static_cast<float>(total.transformedVertexCount) / static_cast<float>(total.vertexCount) : 0.0f;
+	}
+
+	//Appends primitiveIndex of meshIndex in world space as an instance of its own, false if it's skipped
+	static bool AppendPrimitive(GltfScene& scene, const GltfDocument& document, size_t meshIndex, size_t primitiveIndex, const glm::mat4& transform)
+	{
+		const GltfDocument::Mesh& mesh{ document.meshes[meshIndex] };
+		const GltfDocument::Primitive& primitive{ mesh.primitives[primitiveIndex] };
+
+		const std::optional<GltfAccessorView> positions{ document.ResolveAccessor(primitive.position) };
+		if (primitive.mode != GltfDocument::modeTriangles || !positions || positions->componentType != GltfDocument::componentTypeFloat || positions->componentCount != 3)
+		{
+			return false;
+		}
+
+		std::optional<GltfAccessorView> normals{ document.ResolveAccessor(primitive.normal) };
+		if (normals && (normals->componentType != GltfDocument::componentTypeFloat || normals->componentCount != 3 || normals->count != positions->count))
+		{
+			normals.reset();
+		}
+
+		std::optional<GltfAccessorView> texCoords{ document.ResolveAccessor(primitive.texCoord) };
+		if (texCoords && (texCoords->componentType != GltfDocument::componentTypeFloat || texCoords->componentCount != 2 || texCoords->count != positions->count))
+		{
+			texCoords.reset();
+		}
+
+		const std::optional<GltfAccessorView> indices{ document.ResolveAccessor(primitive.indices) };
+		if (primitive.indices != GltfDocument::noIndex && (!indices || indices->componentCount != 1 || indices->componentType == GltfDocument::componentTypeFloat))
+		{
+			return false;
+		}
+
+		const glm::vec4 baseColor{ BaseColor(document, primitive) };
+		const glm::vec3 axisX{ transform[0] };
+		const glm::vec3 axisY{ transform[1] };
+		const glm::vec3 axisZ{ transform[2] };
+		const float determinant{ glm::dot(axisX, glm::cross(axisY, axisZ)) };
+		const bool mirrored{ determinant < 0.0f };
+		//Cofactor matrix, the inverse transpose scaled by the determinant. Normals are normalized anyway, only its sign matters
+		const float normalSign{ mirrored ? -1.0f : 1.0f };
+		glm::mat3 normalTransform{ 1.0f };
+		normalTransform[0] = glm::cross(axisY, axisZ) * normalSign;
+		normalTransform[1] = glm::cross(axisZ, axisX) * normalSign;
+		normalTransform[2] = glm::cross(axisX, axisY) * normalSign;
+
+		//The primitive is optimized in its own space, so every instance of it gets the same index order
+		std::vector<PrimitiveVertex> primitiveVertices;
+		primitiveVertices.reserve(positions->count);
+		for (size_t vertex{}; vertex < positions->count; ++vertex)
+		{
+			float lighting{ 1.0f };
+			if (normals)
+			{
+				const glm::vec3 normal{ normalTransform * ReadVec3(*normals, vertex) };
+				const float normalLength{ glm::length(normal) };
+				lighting = ambient + (1.0f - ambient) * std::max(normalLength > 0.0f ? glm::dot(normal / normalLength, lightDirection) : 0.0f, 0.0f);
+			}
+
+			primitiveVertices.push_back(PrimitiveVertex
+			{
+				.position = ReadVec3(*positions, vertex),
+				.color = glm::vec4{ glm::vec3{ baseColor } * lighting, baseColor.w },
+				.texCoord = texCoords ? ReadVec2(*texCoords, vertex) : glm::vec2{ 0.0f }
+			});
+		}
+
+		std::vector<uint32_t> primitiveIndices;
+		const size_t indexCount{ indices ? indices->count : positions->count };
+		for (size_t triangle{}; triangle + 3 <= indexCount; triangle += 3)
+		{
+			uint32_t corners[3];
+			for (size_t corner{}; corner < 3; ++corner)
+			{
+				corners[corner] = indices ? ReadIndex(*indices, triangle + corner) : static_cast<uint32_t>(triangle + corner);
+			}
+
+			if (corners[0] >= positions->count || corners[1] >= positions->count || corners[2] >= positions->count)
+			{
+				continue;
+			}
+
+			primitiveIndices.insert(primitiveIndices.end(), std::begin(corners), std::end(corners));
+		}
+
+		if (primitiveIndices.empty())
+		{
+			return false;
+		}
+
+		const MeshOptimizer::OptimizationReport report{ MeshOptimizer::Optimize(primitiveIndices, primitiveVertices) };
+		Accumulate(scene.vertexCacheReport.before, report.before);
+		Accumulate(scene.vertexCacheReport.after, report.after);
+
+		const auto reported{ std::find_if(scene.primitiveCacheReports.begin(), scene.primitiveCacheReports.end(), [meshIndex, primitiveIndex](const PrimitiveCacheReport& entry)
+		{
+			return entry.meshIndex == meshIndex && entry.primitiveIndex == primitiveIndex;
+		}) };
+		scene.primitives.push_back(static_cast<uint32_t>(reported - scene.primitiveCacheReports.begin()));
+		if (reported == scene.primitiveCacheReports.end())
+		{
+			scene.primitiveCacheReports.push_back(PrimitiveCacheReport
+			{
+				.meshName = mesh.name,
+				.meshIndex = static_cast<uint32_t>(meshIndex),
+				.primitiveIndex = static_cast<uint32_t>(primitiveIndex),
+				.report = report
+			});
+		}
+
+		const size_t firstVertex{ scene.vertices.size() };
+		glm::vec3 boundsMin{ std::numeric_limits<float>::max() };
+		glm::vec3 boundsMax{ std::numeric_limits<float>::lowest() };
+		for (const PrimitiveVertex& vertex : primitiveVertices)
+		{
+			const glm::vec3 position{ transform * glm::vec4{ vertex.position, 1.0f } };
+
+			UnlitColoredVertex& added{ scene.vertices.emplace_back() };
+			added.position = position;
+			added.color = vertex.color;
+			scene.texCoords.push_back(vertex.texCoord);
+
+			boundsMin = glm::min(boundsMin, position);
+			boundsMax = glm::max(boundsMax, position);
+		}
+
+		const size_t firstIndex{ scene.indices.size() };
+		for (size_t triangle{}; triangle < primitiveIndices.size(); triangle += 3)
+		{
+			//Mirroring transforms flip the winding, swapping two indices of every triangle restores it
+			const size_t second{ mirrored ? 2u : 1u };
+			scene.indices.insert(scene.indices.end(), { primitiveIndices[triangle], primitiveIndices[triangle + second], primitiveIndices[triangle + 3 - second] });
+		}
+
+		const glm::vec3 center{ (boundsMin + boundsMax) * 0.5f };
+		float radius{ 0.0f };
+		for (size_t vertex{ firstVertex }; vertex < scene.vertices.size(); ++vertex)
+		{
+			radius = std::max(radius, glm::length(scene.vertices[vertex].position - center));
+		}
+
+		scene.drawInstances.push_back(DrawInstance
+		{
+			.boundingSphere = glm::vec4{ center, radius },
+			.indexCount = static_cast<uint32_t>(scene.indices.size() - firstIndex),
+			.firstIndex = static_cast<uint32_t>(firstIndex),
+			.vertexOffset = static_cast<int32_t>(firstVertex)
+		});
+		scene.baseColors.push_back(baseColor);
+		scene.baseColorImages.push_back(BaseColorImage(document, primitive));
+
+		scene.boundsMin = glm::min(scene.boundsMin, boundsMin);
+		scene.boundsMax = glm::max(scene.boundsMax, boundsMax);
+		scene.triangleCount += (scene.indices.size() - firstIndex) / 3;
+		return true;
+	}
+
+	std::optional<GltfScene> LoadGltfScene(const std::filesystem::path& path)
+	{
+		const std::optional<GltfDocument> document{ LoadGltf(path) };
+		if (!document)
+		{
+			printf("Couldn't load %s\n", path.string().c_str());
+			return std::nullopt;
+		}
+
+		GltfScene scene
+		{
+			.boundsMin = glm::vec3{ std::numeric_limits<float>::max() },
+			.boundsMax = glm::vec3{ std::numeric_limits<float>::lowest() },
+			.triangleCount = 0,
+			.vertexCacheReport = {}
+		};
+
+		for (const std::string& uri : document->imageUris)
+		{
+			scene.images.push_back(uri.empty() || uri.compare(0, 5, "data:") == 0 ? std::filesystem::path{} : path.parent_path() / uri);
+		}
+
+		//Without a scene every root node is drawn
+		const std::vector<GltfDocument::Node>& nodes{ document->nodes };
+		std::vector<std::pair<size_t, glm::mat4>> pendingNodes;
+		if (const uint32_t sceneIndex{ document->scene != GltfDocument::noIndex ? document->scene : 0 }; sceneIndex < document->scenes.size())
+		{
+			for (const uint32_t node : document->scenes[sceneIndex])
+			{
+				pendingNodes.emplace_back(node, glm::mat4{ 1.0f });
+			}
+		}
+		else
+		{
+			std::vector<bool> isChild(nodes.size(), false);
+			for (const GltfDocument::Node& node : nodes)
+			{
+				for (const uint32_t child : node.children)
+				{
+					if (child < isChild.size())
+					{
+						isChild[child] = true;
+					}
+				}
+			}
+			for (size_t node{}; node < nodes.size(); ++node)
+			{
+				if (!isChild[node])
+				{
+					pendingNodes.emplace_back(node, glm::mat4{ 1.0f });
+				}
+			}
+		}
+
+		uint32_t skippedPrimitives{ 0 };
+		//glTF node hierarchies are trees, the visit limit only guards against malformed files with cycles
+		size_t remainingVisits{ nodes.size() * 4 + 16 };
+		while (!pendingNodes.empty() && remainingVisits-- > 0)
+		{
+			const auto [nodeIndex, parentTransform] = pendingNodes.back();
+			pendingNodes.pop_back();
+			if (nodeIndex >= nodes.size())
+			{
+				continue;
+			}
+
+			const GltfDocument::Node& node{ nodes[nodeIndex] };
+			const glm::mat4 transform{ parentTransform * node.transform };
+
+			if (node.mesh < document->meshes.size())
+			{
+				for (size_t primitive{}; primitive < document->meshes[node.mesh].primitives.size(); ++primitive)
+				{
+					skippedPrimitives += AppendPrimitive(scene, *document, node.mesh, primitive, transform) ? 0 : 1;
+				}
+			}
+
+			for (const uint32_t child : node.children)
+			{
+				pendingNodes.emplace_back(child, transform);
+			}
+		}
+
+		if (skippedPrimitives != 0)
+		{
+			printf("Skipped %u unsupported primitives of %s\n", skippedPrimitives, path.string().c_str());
+		}
+
+		if (scene.drawInstances.empty())
+		{
+			printf("%s has no triangles to draw\n", path.string().c_str());
+			return std::nullopt;
+		}
+
+		return scene;
+	}
+}
@@ -0,0 +1,448 @@
+#include "Graphics/MeshLod.h"
+
+#include <glm/geometric.hpp>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <unordered_map>
+#include <unordered_set>
+#include <assert.h>
+
+namespace cof
+{
+	//Keeps open borders from drifting inwards
+	constexpr static double borderWeight{ 10.0 };
+
+	enum class VertexKind : uint8_t
+	{
+		Interior,
+		Border,
+		Locked
+	};
+
+	//Sum of squared distances to a set of weighted planes, divided by the total weight to stay in object space units
+	struct Quadric
+	{
+		double a00, a11, a22, a01, a02, a12;
+		double b0, b1, b2;
+		double c;
+		double weight;
+
+		static Quadric FromPlane(const glm::vec3& normal, double distance, double planeWeight)
+		{
+			return Quadric
+			{
+				.a00 = normal.x * normal.x * planeWeight,
+				.a11 = normal.y * normal.y * planeWeight,
+				.a22 = normal.z * normal.z * planeWeight,
+				.a01 = normal.x * normal.y * planeWeight,
+				.a02 = normal.x * normal.z * planeWeight,
+				.a12 = normal.y * normal.z * planeWeight,
+				.b0 = normal.x * distance * planeWeight,
+				.b1 = normal.y * distance * planeWeight,
+				.b2 = normal.z * distance * planeWeight,
+				.c = distance * distance * planeWeight,
+				.weight = planeWeight
+			};
+		}
+
+		Quadric& operator+=(const Quadric& other)
+		{
+			a00 += other.a00; a11 += other.a11; a22 += other.a22;
+			a01 += other.a01; a02 += other.a02; a12 += other.a12;
+			b0 += other.b0; b1 += other.b1; b2 += other.b2;
+			c += other.c;
+			weight += other.weight;
+			return *this;
+		}
+
+		double SquaredError(const glm::vec3& position) const
+		{
+			const double x{ position.x };
+			const double y{ position.y };
+			const double z{ position.z };
+
+			const double error
+			{
+				a00 * x * x + a11 * y * y + a22 * z * z
+				+ 2.0 * (a01 * x * y + a02 * x * z + a12 * y * z)
+				+ 2.0 * (b0 * x + b1 * y + b2 * z)
+				+ c
+			};
+
+			return weight > 0.0 ? std::abs(error) / weight : 0.0;
+		}
+	};
+
+	struct Collapse
+	{
+		uint32_t from;
+		uint32_t to;
+		double squaredError;
+	};
+
+	static uint64_t EdgeKey(uint32_t from, uint32_t to)
+	{
+		return static_cast<uint64_t>(from) << 32 | to;
+	}
+
+	static std::vector<VertexKind> ClassifyVertices(const std::vector<uint32_t>& indices, const std::vector<glm::vec3>& positions, std::unordered_set<uint64_t>& borderEdges)
+	{
+		std::vector<VertexKind> kinds(positions.size(), VertexKind::Interior);
+
+		//Vertices split along attribute seams share a position, moving one of them would tear the seam open
+		std::unordered_map<uint64_t, uint32_t> firstVertexAtPosition;
+		firstVertexAtPosition.reserve(positions.size());
+
+		auto positionKey = [](const glm::vec3& position)
+		{
+			uint32_t bits[3];
+			std::memcpy(bits, &position, sizeof(bits));
+			return (static_cast<uint64_t>(bits[0]) * 73856093u) ^ (static_cast<uint64_t>(bits[1]) * 19349663u << 21) ^ (static_cast<uint64_t>(bits[2]) * 83492791u << 42);
+		};
+
+		for (uint32_t vertex{}; vertex < positions.size(); ++vertex)
+		{
+			auto [entry, inserted] = firstVertexAtPosition.try_emplace(positionKey(positions[vertex]), vertex);
+			if (!inserted && positions[entry->second] == positions[vertex])
+			{
+				kinds[entry->second] = VertexKind::Locked;
+				kinds[vertex] = VertexKind::Locked;
+			}
+		}
+
+		std::unordered_set<uint64_t> edges;
+		edges.reserve(indices.size());
+		for (size_t index{}; index < indices.size(); index += 3)
+		{
+			for (uint32_t corner{}; corner < 3; ++corner)
+			{
+				edges.insert(EdgeKey(indices[index + corner], indices[index + (corner + 1) % 3]));
+			}
+		}
+
+		//An edge without a twin running the other way lies on an open border
+		for (size_t index{}; index < indices.size(); index += 3)
+		{
+			for (uint32_t corner{}; corner < 3; ++corner)
+			{
+				const uint32_t from{ indices[index + corner] };
+				const uint32_t to{ indices[index + (corner + 1) % 3] };
+
+				if (!edges.contains(EdgeKey(to, from)))
+				{
+					borderEdges.insert(EdgeKey(from, to));
+					for (auto vertex : { from, to })
+					{
+						if (kinds[vertex] == VertexKind::Interior)
+						{
+							kinds[vertex] = VertexKind::Border;
+						}
+					}
+				}
+			}
+		}
+
+		return kinds;
+	}
+
+	static std::vector<Quadric> ComputeQuadrics(const std::vector<uint32_t>& indices, const std::vector<glm::vec3>& positions, const std::unordered_set<uint64_t>& borderEdges)
+	{
+		std::vector<Quadric> quadrics(positions.size(), Quadric{});
+
+		for (size_t index{}; index < indices.size(); index += 3)
+		{
+			const glm::vec3& a = positions[indices[index + 0]];
+			const glm::vec3& b = positions[indices[index + 1]];
+			const glm::vec3& c = positions[indices[index + 2]];
+
+			const glm::vec3 normal = glm::cross(b - a, c - a);
+			const float area{ glm::length(normal) };
+			if (area <= 0.0f)
+			{
+				continue;
+			}
+
+			const glm::vec3 unitNormal = normal / area;
+			const Quadric plane = Quadric::FromPlane(unitNormal, -glm::dot(unitNormal, a), area);
+
+			for (uint32_t corner{}; corner < 3; ++corner)
+			{
+				quadrics[indices[index + corner]] += plane;
+			}
+
+			//Border edges get a plane perpendicular to the triangle that pins them in place
+			for (uint32_t corner{}; corner < 3; ++corner)
+			{
+				const uint32_t from{ indices[index + corner] };
+				const uint32_t to{ indices[index + (corner + 1) % 3] };
+
+				if (!borderEdges.contains(EdgeKey(from, to)))
+				{
+					continue;
+				}
+
+				const glm::vec3& start = positions[from];
+				const glm::vec3 edge = positions[to] - start;
+				const float edgeLength{ glm::length(edge) };
+				if (edgeLength <= 0.0f)
+				{
+					continue;
+				}
+
+				const glm::vec3 borderNormal = glm::normalize(glm::cross(edge, unitNormal));
+				const Quadric border = Quadric::FromPlane(borderNormal, -glm::dot(borderNormal, start), static_cast<double>(edgeLength) * edgeLength * borderWeight);
+
+				quadrics[from] += border;
+				quadrics[to] += border;
+			}
+		}
+
+		return quadrics;
+	}
+
+	static bool FlipsTriangle(	const std::vector<uint32_t>& indices,
+								const std::vector<glm::vec3>& positions,
+								const std::vector<uint32_t>& adjacencyOffsets,
+								const std::vector<uint32_t>& adjacentTriangles,
+								const Collapse& collapse)
+	{
+		for (uint32_t adjacency{ adjacencyOffsets[collapse.from] }; adjacency < adjacencyOffsets[collapse.from + 1]; ++adjacency)
+		{
+			const uint32_t triangle{ adjacentTriangles[adjacency] };
+			const uint32_t a{ indices[triangle * 3 + 0] };
+			const uint32_t b{ indices[triangle * 3 + 1] };
+			const uint32_t c{ indices[triangle * 3 + 2] };
+
+			//Triangles on the collapsed edge disappear
+			if (a == collapse.to || b == collapse.to || c == collapse.to)
+			{
+				continue;
+			}
+
+			auto moved = [&](uint32_t vertex) -> const glm::vec3& { return positions[vertex == collapse.from ? collapse.to : vertex]; };
+
+			const glm::vec3 normal = glm::cross(positions[b] - positions[a], positions[c] - positions[a]);
+			const glm::vec3 movedNormal = glm::cross(moved(b) - moved(a), moved(c) - moved(a));
+
+			if (glm::dot(normal, movedNormal) <= 0.0f)
+			{
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	std::vector<uint32_t> SimplifyMesh(	const std::vector<uint32_t>& indices,
+										const std::vector<glm::vec3>& positions,
+										size_t targetIndexCount,
+										float targetError,
+										float& resultError)
+	{
+		assert(indices.size() % 3 == 0);
+
+		const uint32_t vertexCount{ static_cast<uint32_t>(positions.size()) };
+		const double maxSquaredError{ static_cast<double>(targetError) * targetError };
+
+		std::unordered_set<uint64_t> borderEdges;
+		const std::vector<VertexKind> kinds = ClassifyVertices(indices, positions, borderEdges);
+		std::vector<Quadric> quadrics = ComputeQuadrics(indices, positions, borderEdges);
+
+		std::vector<uint32_t> result = indices;
+		std::vector<uint32_t> remap(vertexCount);
+		std::vector<bool> locked(vertexCount);
+		std::vector<Collapse> collapses;
+		std::vector<uint32_t> adjacencyOffsets(static_cast<size_t>(vertexCount) + 1);
+		std::vector<uint32_t> adjacentTriangles;
+
+		double maxAppliedError{ 0.0 };
+
+		auto canCollapse = [&](uint32_t from, uint32_t to)
+		{
+			switch (kinds[from])
+			{
+			case VertexKind::Interior:
+				return true;
+			case VertexKind::Border:
+				//Border vertices may only slide along the border
+				return borderEdges.contains(EdgeKey(from, to)) || borderEdges.contains(EdgeKey(to, from));
+			default:
+				return false;
+			}
+		};
+
+		//Each pass collapses the cheapest independent edges, then the index buffer is rewritten
+		while (result.size() > targetIndexCount)
+		{
+			const uint32_t triangleCount{ static_cast<uint32_t>(result.size() / 3) };
+
+			std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+			for (auto index : result)
+			{
+				++adjacencyOffsets[index + 1];
+			}
+
+			for (uint32_t vertex{}; vertex < vertexCount; ++vertex)
+			{
+				adjacencyOffsets[vertex + 1] += adjacencyOffsets[vertex];
+			}
+
+			adjacentTriangles.resize(result.size());
+			std::vector<uint32_t> adjacencyFill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+			for (uint32_t triangle{}; triangle < triangleCount; ++triangle)
+			{
+				for (uint32_t corner{}; corner < 3; ++corner)
+				{
+					adjacentTriangles[adjacencyFill[result[triangle * 3 + corner]]++] = triangle;
+				}
+			}
+
+			collapses.clear();
+			for (uint32_t triangle{}; triangle < triangleCount; ++triangle)
+			{
+				for (uint32_t corner{}; corner < 3; ++corner)
+				{
+					const uint32_t first{ result[triangle * 3 + corner] };
+					const uint32_t second{ result[triangle * 3 + (corner + 1) % 3] };
+
+					Quadric combined = quadrics[first];
+					combined += quadrics[second];
+
+					Collapse best{ .from = first, .to = second, .squaredError = DBL_MAX };
+					if (canCollapse(first, second))
+					{
+						best.squaredError = combined.SquaredError(positions[second]);
+					}
+
+					if (canCollapse(second, first))
+					{
+						const double squaredError{ combined.SquaredError(positions[first]) };
+						if (squaredError < best.squaredError)
+						{
+							best = Collapse{ .from = second, .to = first, .squaredError = squaredError };
+						}
+					}
+
+					if (best.squaredError <= maxSquaredError)
+					{
+						collapses.push_back(best);
+					}
+				}
+			}
+
+			std::sort(collapses.begin(), collapses.end(), [](const Collapse& lhs, const Collapse& rhs) { return lhs.squaredError < rhs.squaredError; });
+
+			for (uint32_t vertex{}; vertex < vertexCount; ++vertex)
+			{
+				remap[vertex] = vertex;
+			}
+			std::fill(locked.begin(), locked.end(), false);
+
+			//Every collapse removes roughly two triangles
+			const size_t collapseBudget{ (result.size() - targetIndexCount) / 6 + 1 };
+			size_t appliedCount{ 0 };
+
+			for (const Collapse& collapse : collapses)
+			{
+				if (appliedCount == collapseBudget)
+				{
+					break;
+				}
+
+				if (locked[collapse.from] || locked[collapse.to] || FlipsTriangle(result, positions, adjacencyOffsets, adjacentTriangles, collapse))
+				{
+					continue;
+				}
+
+				remap[collapse.from] = collapse.to;
+				quadrics[collapse.to] += quadrics[collapse.from];
+				maxAppliedError = std::max(maxAppliedError, collapse.squaredError);
+				++appliedCount;
+
+				//The triangles around the collapsed vertex changed, keep their vertices out of this pass
+				for (uint32_t adjacency{ adjacencyOffsets[collapse.from] }; adjacency < adjacencyOffsets[collapse.from + 1]; ++adjacency)
+				{
+					const uint32_t triangle{ adjacentTriangles[adjacency] };
+					for (uint32_t corner{}; corner < 3; ++corner)
+					{
+						locked[result[triangle * 3 + corner]] = true;
+					}
+				}
+			}
+
+			if (appliedCount == 0)
+			{
+				break;
+			}
+
+			size_t writeIndex{ 0 };
+			for (size_t index{}; index < result.size(); index += 3)
+			{
+				const uint32_t a{ remap[result[index + 0]] };
+				const uint32_t b{ remap[result[index + 1]] };
+				const uint32_t c{ remap[result[index + 2]] };
+
+				if (a != b && b != c && a != c)
+				{
+					result[writeIndex++] = a;
+					result[writeIndex++] = b;
+					result[writeIndex++] = c;
+				}
+			}
+
+			result.resize(writeIndex);
+		}
+
+		resultError = static_cast<float>(std::sqrt(maxAppliedError));
+		return result;
+	}
+
+	LodChain BuildLodChain(	const std::vector<uint32_t>& indices,
+							const std::vector<glm::vec3>& positions,
+							float maxError,
+							uint32_t maxLodCount)
+	{
+		assert(maxLodCount > 0);
+
+		LodChain chain{ .indices = indices };
+		chain.lods.push_back(MeshLod{ .firstIndex = 0, .indexCount = static_cast<uint32_t>(indices.size()), .error = 0.0f });
+
+		std::vector<uint32_t> current = indices;
+		float error{ 0.0f };
+
+		while (chain.lods.size() < maxLodCount)
+		{
+			const size_t targetIndexCount{ current.size() / 6 * 3 };
+
+			//Each LOD is simplified from the previous one, so the errors add up
+			float lodError{ 0.0f };
+			std::vector<uint32_t> simplified = SimplifyMesh(current, positions, targetIndexCount, maxError - error, lodError);
+
+			//Not worth another LOD when the error bound stops the simplifier early
+			if (simplified.empty() || simplified.size() * 20 > current.size() * 19)
+			{
+				break;
+			}
+
+			error += lodError;
+			chain.lods.push_back(MeshLod{ .firstIndex = static_cast<uint32_t>(chain.indices.size()), .indexCount = static_cast<uint32_t>(simplified.size()), .error = error });
+			chain.indices.insert(chain.indices.end(), simplified.begin(), simplified.end());
+			current = std::move(simplified);
+		}
+
+		return chain;
+	}
+
+	void LodChain::Print(const char* label) const
+	{
+		printf("%s: %zu LODs\n", label, lods.size());
+		for (size_t lod{}; lod < lods.size(); ++lod)
+		{
+			printf("\tLOD %zu: %u triangles, error %g\n", lod, lods[lod].indexCount / 3, lods[lod].error);
+		}
+	}
+}
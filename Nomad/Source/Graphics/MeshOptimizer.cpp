@@ -0,0 +1,427 @@
+#include "Graphics/MeshOptimizer.h"
+
+#include <glm/geometric.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <assert.h>
+
+namespace cof::MeshOptimizer
+{
+	constexpr static uint32_t noTriangle{ std::numeric_limits<uint32_t>::max() };
+
+	//Scoring parameters from Forsyth's "Linear-Speed Vertex Cache Optimisation"
+	constexpr static int32_t forsythCacheSize{ 32 };
+	constexpr static float cacheDecayPower{ 1.5f };
+	constexpr static float lastTriangleScore{ 0.75f };
+	constexpr static float valenceBoostScale{ 2.0f };
+	constexpr static float valenceBoostPower{ 0.5f };
+
+	static float VertexScore(int32_t cachePosition, uint32_t liveTriangleCount)
+	{
+		if (liveTriangleCount == 0)
+		{
+			return -1.0f;
+		}
+
+		float score{ 0.0f };
+		if (cachePosition >= 0)
+		{
+			//The vertices of the last triangle get a fixed score so the next triangle doesn't simply reuse an edge of it
+			if (cachePosition < 3)
+			{
+				score = lastTriangleScore;
+			}
+			else
+			{
+				const float scaler{ 1.0f / static_cast<float>(forsythCacheSize - 3) };
+				score = std::pow(1.0f - static_cast<float>(cachePosition - 3) * scaler, cacheDecayPower);
+			}
+		}
+
+		//Favour vertices with few triangles left so they don't end up stranded
+		score += valenceBoostScale * std::pow(static_cast<float>(liveTriangleCount), -valenceBoostPower);
+		return score;
+	}
+
+	//Counts FIFO cache misses, advancing the timestamp past the cache size empties the cache
+	struct FifoCache
+	{
+		std::vector<uint32_t> timestamps;
+		uint32_t timestamp;
+		uint32_t size;
+
+		FifoCache(uint32_t vertexCount, uint32_t cacheSize)
+			: timestamps(vertexCount, 0), timestamp{ cacheSize + 1 }, size{ cacheSize }
+		{
+		}
+
+		uint32_t Misses(uint32_t a, uint32_t b, uint32_t c)
+		{
+			uint32_t misses{ 0 };
+			for (auto vertex : { a, b, c })
+			{
+				if (timestamp - timestamps[vertex] > size)
+				{
+					timestamps[vertex] = timestamp++;
+					++misses;
+				}
+			}
+
+			return misses;
+		}
+
+		void Flush()
+		{
+			timestamp += size + 1;
+		}
+	};
+
+	void VertexCacheStatistics::Print(const char* label) const
+	{
+		printf("%s: %u triangles, %u vertices, %u transformed, ACMR %.3f, ATVR %.3f\n",
+			label, triangleCount, vertexCount, transformedVertexCount, acmr, atvr);
+	}
+
+	void OptimizationReport::Print(const char* label) const
+	{
+		printf("%s: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", label, before.acmr, after.acmr, before.atvr, after.atvr);
+	}
+
+	VertexCacheStatistics AnalyzeVertexCache(const std::vector<uint32_t>& indices, uint32_t vertexCount, uint32_t cacheSize)
+	{
+		assert(indices.size() % 3 == 0);
+
+		FifoCache cache{ vertexCount, cacheSize };
+		std::vector<bool> referenced(vertexCount, false);
+
+		VertexCacheStatistics statistics{ .triangleCount = static_cast<uint32_t>(indices.size() / 3) };
+
+		for (size_t index{}; index < indices.size(); index += 3)
+		{
+			statistics.transformedVertexCount += cache.Misses(indices[index + 0], indices[index + 1], indices[index + 2]);
+		}
+
+		for (auto index : indices)
+		{
+			if (!referenced[index])
+			{
+				referenced[index] = true;
+				++statistics.vertexCount;
+			}
+		}
+
+		if (statistics.triangleCount > 0)
+		{
+			statistics.acmr = static_cast<float>(statistics.transformedVertexCount) / static_cast<float>(statistics.triangleCount);
+			statistics.atvr = static_cast<float>(statistics.transformedVertexCount) / static_cast<float>(statistics.vertexCount);
+		}
+
+		return statistics;
+	}
+
+	std::vector<uint32_t> OptimizeVertexCache(const std::vector<uint32_t>& indices, uint32_t vertexCount)
+	{
+		assert(indices.size() % 3 == 0);
+
+		const uint32_t triangleCount{ static_cast<uint32_t>(indices.size() / 3) };
+
+		//Live triangles per vertex, emitted triangles are swapped out of the vertex's range
+		std::vector<uint32_t> liveTriangleCounts(vertexCount, 0);
+		for (auto index : indices)
+		{
+			++liveTriangleCounts[index];
+		}
+
+		std::vector<uint32_t> adjacencyOffsets(static_cast<size_t>(vertexCount) + 1, 0);
+		for (uint32_t vertex{}; vertex < vertexCount; ++vertex)
+		{
+			adjacencyOffsets[vertex + 1] = adjacencyOffsets[vertex] + liveTriangleCounts[vertex];
+		}
+
+		std::vector<uint32_t> adjacentTriangles(indices.size());
+		std::vector<uint32_t> adjacencyFill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+		for (uint32_t triangle{}; triangle < triangleCount; ++triangle)
+		{
+			for (uint32_t corner{}; corner < 3; ++corner)
+			{
+				adjacentTriangles[adjacencyFill[indices[triangle * 3 + corner]]++] = triangle;
+			}
+		}
+
+		std::vector<float> vertexScores(vertexCount);
+		for (uint32_t vertex{}; vertex < vertexCount; ++vertex)
+		{
+			vertexScores[vertex] = VertexScore(-1, liveTriangleCounts[vertex]);
+		}
+
+		std::vector<float> triangleScores(triangleCount);
+		std::vector<bool> emitted(triangleCount, false);
+
+		uint32_t bestTriangle{ noTriangle };
+		float bestScore{ -std::numeric_limits<float>::max() };
+
+		for (uint32_t triangle{}; triangle < triangleCount; ++triangle)
+		{
+			triangleScores[triangle] = vertexScores[indices[triangle * 3 + 0]] + vertexScores[indices[triangle * 3 + 1]] + vertexScores[indices[triangle * 3 + 2]];
+			if (triangleScores[triangle] > bestScore)
+			{
+				bestTriangle = triangle;
+				bestScore = triangleScores[triangle];
+			}
+		}
+
+		std::vector<uint32_t> optimized;
+		optimized.reserve(indices.size());
+
+		std::vector<uint32_t> cache;
+		std::vector<uint32_t> nextCache;
+		cache.reserve(forsythCacheSize + 3);
+		nextCache.reserve(forsythCacheSize + 3);
+
+		uint32_t nextUnemitted{ 0 };
+
+		for (uint32_t emittedCount{}; emittedCount < triangleCount; ++emittedCount)
+		{
+			//Dead end, restart from the first triangle that hasn't been emitted yet
+			if (bestTriangle == noTriangle)
+			{
+				while (emitted[nextUnemitted])
+				{
+					++nextUnemitted;
+				}
+
+				bestTriangle = nextUnemitted;
+			}
+
+			emitted[bestTriangle] = true;
+			nextCache.clear();
+
+			for (uint32_t corner{}; corner < 3; ++corner)
+			{
+				const uint32_t vertex{ indices[bestTriangle * 3 + corner] };
+				optimized.push_back(vertex);
+
+				const uint32_t adjacencyBegin{ adjacencyOffsets[vertex] };
+				for (uint32_t adjacency{ adjacencyBegin }; adjacency < adjacencyBegin + liveTriangleCounts[vertex];)
+				{
+					if (adjacentTriangles[adjacency] == bestTriangle)
+					{
+						adjacentTriangles[adjacency] = adjacentTriangles[adjacencyBegin + --liveTriangleCounts[vertex]];
+					}
+					else
+					{
+						++adjacency;
+					}
+				}
+
+				if (std::find(nextCache.begin(), nextCache.end(), vertex) == nextCache.end())
+				{
+					nextCache.push_back(vertex);
+				}
+			}
+
+			for (auto vertex : cache)
+			{
+				if (std::find(nextCache.begin(), nextCache.end(), vertex) == nextCache.end())
+				{
+					nextCache.push_back(vertex);
+				}
+			}
+
+			//Vertices pushed out of the cache lose their cache score
+			for (size_t position{ forsythCacheSize }; position < nextCache.size(); ++position)
+			{
+				vertexScores[nextCache[position]] = VertexScore(-1, liveTriangleCounts[nextCache[position]]);
+			}
+
+			std::swap(cache, nextCache);
+			cache.resize(std::min(cache.size(), static_cast<size_t>(forsythCacheSize)));
+
+			for (size_t position{}; position < cache.size(); ++position)
+			{
+				vertexScores[cache[position]] = VertexScore(static_cast<int32_t>(position), liveTriangleCounts[cache[position]]);
+			}
+
+			//Only triangles touching the cache changed score, the best of them is emitted next
+			bestTriangle = noTriangle;
+			bestScore = -std::numeric_limits<float>::max();
+
+			for (auto vertex : cache)
+			{
+				for (uint32_t adjacency{ adjacencyOffsets[vertex] }; adjacency < adjacencyOffsets[vertex] + liveTriangleCounts[vertex]; ++adjacency)
+				{
+					const uint32_t triangle{ adjacentTriangles[adjacency] };
+					triangleScores[triangle] = vertexScores[indices[triangle * 3 + 0]] + vertexScores[indices[triangle * 3 + 1]] + vertexScores[indices[triangle * 3 + 2]];
+
+					if (triangleScores[triangle] > bestScore)
+					{
+						bestTriangle = triangle;
+						bestScore = triangleScores[triangle];
+					}
+				}
+			}
+		}
+
+		return optimized;
+	}
+
+	std::vector<uint32_t> OptimizeOverdraw(	const std::vector<uint32_t>& indices,
+											const std::vector<glm::vec3>& positions,
+											float threshold,
+											uint32_t cacheSize)
+	{
+		assert(indices.size() % 3 == 0);
+
+		const uint32_t triangleCount{ static_cast<uint32_t>(indices.size() / 3) };
+		const uint32_t vertexCount{ static_cast<uint32_t>(positions.size()) };
+
+		if (triangleCount == 0)
+		{
+			return indices;
+		}
+
+		//A triangle missing all three vertices restarts the cache, clusters can be reordered there for free
+		std::vector<uint32_t> hardClusters;
+		{
+			FifoCache cache{ vertexCount, cacheSize };
+			for (uint32_t triangle{}; triangle < triangleCount; ++triangle)
+			{
+				const uint32_t misses{ cache.Misses(indices[triangle * 3 + 0], indices[triangle * 3 + 1], indices[triangle * 3 + 2]) };
+				if (triangle == 0 || misses == 3)
+				{
+					hardClusters.push_back(triangle);
+				}
+			}
+		}
+
+		//Split further wherever the cluster so far is within threshold of the whole cluster's ACMR
+		std::vector<uint32_t> clusters;
+		{
+			FifoCache cache{ vertexCount, cacheSize };
+			for (size_t hardCluster{}; hardCluster < hardClusters.size(); ++hardCluster)
+			{
+				const uint32_t begin{ hardClusters[hardCluster] };
+				const uint32_t end{ hardCluster + 1 < hardClusters.size() ? hardClusters[hardCluster + 1] : triangleCount };
+
+				cache.Flush();
+				uint32_t clusterMisses{ 0 };
+				for (uint32_t triangle{ begin }; triangle < end; ++triangle)
+				{
+					clusterMisses += cache.Misses(indices[triangle * 3 + 0], indices[triangle * 3 + 1], indices[triangle * 3 + 2]);
+				}
+
+				const float clusterAcmr{ static_cast<float>(clusterMisses) / static_cast<float>(end - begin) };
+
+				cache.Flush();
+				clusters.push_back(begin);
+				uint32_t subClusterBegin{ begin };
+				uint32_t subClusterMisses{ 0 };
+
+				for (uint32_t triangle{ begin }; triangle < end; ++triangle)
+				{
+					subClusterMisses += cache.Misses(indices[triangle * 3 + 0], indices[triangle * 3 + 1], indices[triangle * 3 + 2]);
+
+					const float subClusterAcmr{ static_cast<float>(subClusterMisses) / static_cast<float>(triangle + 1 - subClusterBegin) };
+					if (triangle + 1 < end && subClusterAcmr <= clusterAcmr * threshold)
+					{
+						clusters.push_back(triangle + 1);
+						subClusterBegin = triangle + 1;
+						subClusterMisses = 0;
+						cache.Flush();
+					}
+				}
+			}
+		}
+
+		glm::vec3 meshCentroid{ 0.0f };
+		for (auto index : indices)
+		{
+			meshCentroid += positions[index];
+		}
+		meshCentroid /= static_cast<float>(indices.size());
+
+		//Clusters facing away from the mesh centre are on the outside and likely to occlude the rest
+		std::vector<float> sortKeys(clusters.size());
+		for (size_t cluster{}; cluster < clusters.size(); ++cluster)
+		{
+			const uint32_t begin{ clusters[cluster] };
+			const uint32_t end{ cluster + 1 < clusters.size() ? clusters[cluster + 1] : triangleCount };
+
+			glm::vec3 centroid{ 0.0f };
+			glm::vec3 normal{ 0.0f };
+			float area{ 0.0f };
+
+			for (uint32_t triangle{ begin }; triangle < end; ++triangle)
+			{
+				const glm::vec3& a = positions[indices[triangle * 3 + 0]];
+				const glm::vec3& b = positions[indices[triangle * 3 + 1]];
+				const glm::vec3& c = positions[indices[triangle * 3 + 2]];
+
+				const glm::vec3 triangleNormal = glm::cross(b - a, c - a);
+				const float triangleArea{ glm::length(triangleNormal) };
+
+				centroid += (a + b + c) * (triangleArea / 3.0f);
+				normal += triangleNormal;
+				area += triangleArea;
+			}
+
+			const float normalLength{ glm::length(normal) };
+			if (area > 0.0f && normalLength > 0.0f)
+			{
+				sortKeys[cluster] = glm::dot(centroid / area - meshCentroid, normal / normalLength);
+			}
+			else
+			{
+				sortKeys[cluster] = 0.0f;
+			}
+		}
+
+		std::vector<uint32_t> clusterOrder(clusters.size());
+		for (uint32_t cluster{}; cluster < clusterOrder.size(); ++cluster)
+		{
+			clusterOrder[cluster] = cluster;
+		}
+
+		std::stable_sort(clusterOrder.begin(), clusterOrder.end(), [&](uint32_t lhs, uint32_t rhs) { return sortKeys[lhs] > sortKeys[rhs]; });
+
+		std::vector<uint32_t> optimized;
+		optimized.reserve(indices.size());
+
+		for (auto cluster : clusterOrder)
+		{
+			const uint32_t begin{ clusters[cluster] };
+			const uint32_t end{ cluster + 1 < clusters.size() ? clusters[cluster + 1] : triangleCount };
+			optimized.insert(optimized.end(), indices.begin() + begin * 3, indices.begin() + end * 3);
+		}
+
+		return optimized;
+	}
+
+	std::vector<uint32_t> GenerateVertexFetchRemap(const std::vector<uint32_t>& indices, uint32_t vertexCount, uint32_t& uniqueVertexCount)
+	{
+		std::vector<uint32_t> remap(vertexCount, unusedVertex);
+		uniqueVertexCount = 0;
+
+		for (auto index : indices)
+		{
+			if (remap[index] == unusedVertex)
+			{
+				remap[index] = uniqueVertexCount++;
+			}
+		}
+
+		return remap;
+	}
+
+	void RemapIndices(std::vector<uint32_t>& indices, const std::vector<uint32_t>& remap)
+	{
+		for (auto& index : indices)
+		{
+			assert(remap[index] != unusedVertex);
+			index = remap[index];
+		}
+	}
+}
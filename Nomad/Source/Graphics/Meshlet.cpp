@@ -0,0 +1,258 @@
+#include "Graphics/Meshlet.h"
+
+#include <glm/geometric.hpp>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <limits>
+#include <assert.h>
+
+namespace cof
+{
+	constexpr static uint8_t unassignedLocalIndex{ 0xff };
+
+	static void ComputeMeshletBounds(Meshlet& meshlet, const MeshletMesh& mesh, const std::vector<glm::vec3>& positions)
+	{
+		glm::vec3 minimum{ FLT_MAX };
+		glm::vec3 maximum{ -FLT_MAX };
+
+		for (uint32_t vertex{}; vertex < meshlet.vertexCount; ++vertex)
+		{
+			const glm::vec3& position = positions[mesh.meshletVertices[meshlet.vertexOffset + vertex]];
+			minimum = glm::min(minimum, position);
+			maximum = glm::max(maximum, position);
+		}
+
+		const glm::vec3 center = (minimum + maximum) * 0.5f;
+		float radius{ 0.0f };
+
+		for (uint32_t vertex{}; vertex < meshlet.vertexCount; ++vertex)
+		{
+			radius = std::max(radius, glm::distance(center, positions[mesh.meshletVertices[meshlet.vertexOffset + vertex]]));
+		}
+
+		meshlet.boundingSphere = glm::vec4{ center, radius };
+		meshlet.coneApex = glm::vec4{ center, 0.0f };
+		meshlet.coneAxisCutoff = glm::vec4{ 0.0f, 0.0f, 1.0f, 1.0f };
+
+		auto trianglePosition = [&](uint32_t triangle, uint32_t corner) -> const glm::vec3&
+		{
+			const uint8_t localIndex = mesh.meshletTriangles[meshlet.triangleOffset + triangle * 3 + corner];
+			return positions[mesh.meshletVertices[meshlet.vertexOffset + localIndex]];
+		};
+
+		glm::vec3 normalSum{ 0.0f };
+		for (uint32_t triangle{}; triangle < meshlet.triangleCount; ++triangle)
+		{
+			const glm::vec3 normal = glm::cross(trianglePosition(triangle, 1) - trianglePosition(triangle, 0), trianglePosition(triangle, 2) - trianglePosition(triangle, 0));
+			const float area = glm::length(normal);
+			if (area > 0.0f)
+			{
+				normalSum += normal / area;
+			}
+		}
+
+		const float normalSumLength = glm::length(normalSum);
+		if (normalSumLength <= 0.0f)
+		{
+			return;
+		}
+
+		const glm::vec3 axis = normalSum / normalSumLength;
+		float minimumDot{ 1.0f };
+
+		for (uint32_t triangle{}; triangle < meshlet.triangleCount; ++triangle)
+		{
+			const glm::vec3 normal = glm::cross(trianglePosition(triangle, 1) - trianglePosition(triangle, 0), trianglePosition(triangle, 2) - trianglePosition(triangle, 0));
+			const float area = glm::length(normal);
+			if (area > 0.0f)
+			{
+				minimumDot = std::min(minimumDot, glm::dot(normal / area, axis));
+			}
+		}
+
+		//The normals spread over more than a hemisphere, some triangle always faces the camera
+		if (minimumDot <= 0.0f)
+		{
+			return;
+		}
+
+		//Move the apex back until it lies behind every triangle plane
+		float maximumDistance{ 0.0f };
+		for (uint32_t triangle{}; triangle < meshlet.triangleCount; ++triangle)
+		{
+			const glm::vec3& origin = trianglePosition(triangle, 0);
+			const glm::vec3 normal = glm::cross(trianglePosition(triangle, 1) - origin, trianglePosition(triangle, 2) - origin);
+			const float area = glm::length(normal);
+			if (area > 0.0f)
+			{
+				const glm::vec3 unitNormal = normal / area;
+				maximumDistance = std::max(maximumDistance, glm::dot(center - origin, unitNormal) / glm::dot(axis, unitNormal));
+			}
+		}
+
+		meshlet.coneApex = glm::vec4{ center - axis * maximumDistance, 0.0f };
+		meshlet.coneAxisCutoff = glm::vec4{ axis, std::sqrt(1.0f - minimumDot * minimumDot) };
+	}
+
+	MeshletMesh BuildMeshlets(	const std::vector<uint32_t>& indices,
+								const std::vector<glm::vec3>& positions,
+								const uint32_t maxVertices,
+								const uint32_t maxTriangles)
+	{
+		assert(indices.size() % 3 == 0);
+		assert(maxVertices >= 3 && maxVertices < unassignedLocalIndex && maxTriangles > 0);
+
+		const uint32_t triangleCount{ static_cast<uint32_t>(indices.size() / 3) };
+		const uint32_t vertexCount{ static_cast<uint32_t>(positions.size()) };
+
+		//Triangles touching each vertex, used to grow meshlets over connected surfaces
+		std::vector<uint32_t> adjacencyOffsets(static_cast<size_t>(vertexCount) + 1, 0);
+		for (auto index : indices)
+		{
+			++adjacencyOffsets[index + 1];
+		}
+
+		for (uint32_t vertex{}; vertex < vertexCount; ++vertex)
+		{
+			adjacencyOffsets[vertex + 1] += adjacencyOffsets[vertex];
+		}
+
+		std::vector<uint32_t> adjacentTriangles(indices.size());
+		std::vector<uint32_t> adjacencyFill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+		for (uint32_t triangle{}; triangle < triangleCount; ++triangle)
+		{
+			for (uint32_t corner{}; corner < 3; ++corner)
+			{
+				adjacentTriangles[adjacencyFill[indices[triangle * 3 + corner]]++] = triangle;
+			}
+		}
+
+		MeshletMesh mesh{};
+		std::vector<bool> emitted(triangleCount, false);
+		std::vector<uint8_t> localIndices(vertexCount, unassignedLocalIndex);
+
+		Meshlet current{};
+
+		auto newVertexCount = [&](uint32_t triangle)
+		{
+			const uint32_t a = indices[triangle * 3 + 0];
+			const uint32_t b = indices[triangle * 3 + 1];
+			const uint32_t c = indices[triangle * 3 + 2];
+
+			return static_cast<uint32_t>(localIndices[a] == unassignedLocalIndex)
+				+ static_cast<uint32_t>(localIndices[b] == unassignedLocalIndex)
+				+ static_cast<uint32_t>(localIndices[c] == unassignedLocalIndex);
+		};
+
+		auto flush = [&]()
+		{
+			if (current.triangleCount == 0)
+			{
+				return;
+			}
+
+			ComputeMeshletBounds(current, mesh, positions);
+			mesh.meshlets.push_back(current);
+
+			for (uint32_t vertex{}; vertex < current.vertexCount; ++vertex)
+			{
+				localIndices[mesh.meshletVertices[current.vertexOffset + vertex]] = unassignedLocalIndex;
+			}
+
+			current = Meshlet
+			{
+				.vertexOffset = static_cast<uint32_t>(mesh.meshletVertices.size()),
+				.triangleOffset = static_cast<uint32_t>(mesh.meshletTriangles.size())
+			};
+		};
+
+		auto tryAppend = [&](uint32_t triangle)
+		{
+			if (current.vertexCount + newVertexCount(triangle) > maxVertices || current.triangleCount == maxTriangles)
+			{
+				return false;
+			}
+
+			for (uint32_t corner{}; corner < 3; ++corner)
+			{
+				const uint32_t vertex = indices[triangle * 3 + corner];
+				if (localIndices[vertex] == unassignedLocalIndex)
+				{
+					localIndices[vertex] = static_cast<uint8_t>(current.vertexCount++);
+					mesh.meshletVertices.push_back(vertex);
+				}
+				mesh.meshletTriangles.push_back(localIndices[vertex]);
+			}
+
+			++current.triangleCount;
+			emitted[triangle] = true;
+			return true;
+		};
+
+		//Degenerate triangles never produce pixels
+		for (uint32_t triangle{}; triangle < triangleCount; ++triangle)
+		{
+			const uint32_t a = indices[triangle * 3 + 0];
+			const uint32_t b = indices[triangle * 3 + 1];
+			const uint32_t c = indices[triangle * 3 + 2];
+			emitted[triangle] = a == b || b == c || a == c;
+		}
+
+		uint32_t nextSeed{ 0 };
+		while (true)
+		{
+			//Prefer the neighbouring triangle that adds the fewest vertices
+			uint32_t bestTriangle{ std::numeric_limits<uint32_t>::max() };
+			uint32_t bestNewVertexCount{ std::numeric_limits<uint32_t>::max() };
+
+			for (uint32_t vertex{}; vertex < current.vertexCount && bestNewVertexCount > 0; ++vertex)
+			{
+				const uint32_t meshVertex = mesh.meshletVertices[current.vertexOffset + vertex];
+				for (uint32_t adjacency{ adjacencyOffsets[meshVertex] }; adjacency < adjacencyOffsets[meshVertex + 1]; ++adjacency)
+				{
+					const uint32_t triangle = adjacentTriangles[adjacency];
+					if (emitted[triangle])
+					{
+						continue;
+					}
+
+					const uint32_t candidateNewVertexCount = newVertexCount(triangle);
+					if (candidateNewVertexCount < bestNewVertexCount)
+					{
+						bestTriangle = triangle;
+						bestNewVertexCount = candidateNewVertexCount;
+					}
+				}
+			}
+
+			if (bestTriangle == std::numeric_limits<uint32_t>::max())
+			{
+				while (nextSeed < triangleCount && emitted[nextSeed])
+				{
+					++nextSeed;
+				}
+
+				if (nextSeed == triangleCount)
+				{
+					break;
+				}
+
+				//The meshlet's connected surface is used up, a disconnected triangle would loosen its bounds and cone
+				flush();
+				bestTriangle = nextSeed;
+			}
+
+			if (!tryAppend(bestTriangle))
+			{
+				flush();
+				[[maybe_unused]] const bool appended = tryAppend(bestTriangle);
+				assert(appended);
+			}
+		}
+
+		flush();
+		return mesh;
+	}
+}
@@ -0,0 +1,272 @@
+#include "Graphics/MeshletCulling.h"
+#include "Graphics/OcclusionCulling.h"
+#include "Graphics/DepthPyramid.h"
+#include "GPU/Shader.h"
+
+#include <vulkan/vulkan_core.h>
+#include <glm/ext/vector_float4.hpp>
+
+#include <array>
+#include <algorithm>
+#include <assert.h>
+
+namespace cof
+{
+	constexpr static uint32_t meshletStorageBufferCount{ 5 };
+
+	struct MeshletCullingConstants
+	{
+		glm::mat4 view;
+		glm::vec4 projection;
+		float zNear;
+		float zFar;
+		uint32_t pyramidWidth;
+		uint32_t pyramidHeight;
+		uint32_t meshletCount;
+		uint32_t occlusionEnabled;
+	};
+
+	MeshletCullingPass::MeshletCullingPass(const VkDevice device, const cof::Shader& cullingShader, const bool reversedZ)
+		: parent{ device }
+	{
+		[[maybe_unused]] VkResult errorCode{ VK_RESULT_MAX_ENUM };
+
+		std::array<VkDescriptorSetLayoutBinding, meshletStorageBufferCount + 1> bindings{};
+		for (uint32_t binding{}; binding < bindings.size(); ++binding)
+		{
+			bindings[binding] = VkDescriptorSetLayoutBinding
+			{
+				.binding = binding,
+				.descriptorType = binding < meshletStorageBufferCount ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+				.descriptorCount = 1,
+				.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT
+			};
+		}
+
+		VkDescriptorSetLayoutCreateInfo descriptorSetLayoutInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+			.bindingCount = static_cast<uint32_t>(bindings.size()),
+			.pBindings = bindings.data()
+		};
+
+		errorCode = vkCreateDescriptorSetLayout(device, &descriptorSetLayoutInfo, nullptr, &descriptorSetLayout);
+		assert(errorCode == VK_SUCCESS);
+
+		VkPushConstantRange pushConstantRange
+		{
+			.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+			.offset = 0,
+			.size = sizeof(MeshletCullingConstants)
+		};
+
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+			.setLayoutCount = 1,
+			.pSetLayouts = &descriptorSetLayout,
+			.pushConstantRangeCount = 1,
+			.pPushConstantRanges = &pushConstantRange
+		};
+
+		errorCode = vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout);
+		assert(errorCode == VK_SUCCESS);
+
+		const VkBool32 reversedZConstant{ reversedZ ? VK_TRUE : VK_FALSE };
+
+		VkSpecializationMapEntry specializationEntry
+		{
+			.constantID = 0,
+			.offset = 0,
+			.size = sizeof(VkBool32)
+		};
+
+		VkSpecializationInfo specializationInfo
+		{
+			.mapEntryCount = 1,
+			.pMapEntries = &specializationEntry,
+			.dataSize = sizeof(VkBool32),
+			.pData = &reversedZConstant
+		};
+
+		VkComputePipelineCreateInfo pipelineInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+			.stage =
+			{
+				.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+				.stage = VK_SHADER_STAGE_COMPUTE_BIT,
+				.module = cullingShader.Handle(),
+				.pName = "main",
+				.pSpecializationInfo = &specializationInfo
+			},
+			.layout = pipelineLayout
+		};
+
+		errorCode = vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline);
+		assert(errorCode == VK_SUCCESS);
+
+		std::array poolSizes
+		{
+			VkDescriptorPoolSize{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, meshletStorageBufferCount },
+			VkDescriptorPoolSize{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1 }
+		};
+
+		VkDescriptorPoolCreateInfo descriptorPoolInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+			.maxSets = 1,
+			.poolSizeCount = static_cast<uint32_t>(poolSizes.size()),
+			.pPoolSizes = poolSizes.data()
+		};
+
+		errorCode = vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool);
+		assert(errorCode == VK_SUCCESS);
+
+		VkDescriptorSetAllocateInfo descriptorSetInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+			.descriptorPool = descriptorPool,
+			.descriptorSetCount = 1,
+			.pSetLayouts = &descriptorSetLayout
+		};
+
+		errorCode = vkAllocateDescriptorSets(device, &descriptorSetInfo, &descriptorSet);
+		assert(errorCode == VK_SUCCESS);
+	}
+
+	MeshletCullingPass::~MeshletCullingPass()
+	{
+		vkDestroyDescriptorPool(parent, descriptorPool, nullptr);
+		vkDestroyPipeline(parent, pipeline, nullptr);
+		vkDestroyPipelineLayout(parent, pipelineLayout, nullptr);
+		vkDestroyDescriptorSetLayout(parent, descriptorSetLayout, nullptr);
+	}
+
+	void MeshletCullingPass::BindBuffers(	VkBuffer meshletBuffer,
+											VkBuffer meshletVertexBuffer,
+											VkBuffer meshletTriangleBuffer,
+											VkBuffer compactedIndexBuffer,
+											VkBuffer drawCommandBuffer,
+											uint32_t meshletCount)
+	{
+		compactedIndices = compactedIndexBuffer;
+		drawCommand = drawCommandBuffer;
+		boundMeshletCount = meshletCount;
+
+		std::array<VkDescriptorBufferInfo, meshletStorageBufferCount> bufferInfos
+		{
+			VkDescriptorBufferInfo{ meshletBuffer, 0, VK_WHOLE_SIZE },
+			VkDescriptorBufferInfo{ meshletVertexBuffer, 0, VK_WHOLE_SIZE },
+			VkDescriptorBufferInfo{ meshletTriangleBuffer, 0, VK_WHOLE_SIZE },
+			VkDescriptorBufferInfo{ compactedIndexBuffer, 0, VK_WHOLE_SIZE },
+			VkDescriptorBufferInfo{ drawCommandBuffer, 0, VK_WHOLE_SIZE }
+		};
+
+		std::array<VkWriteDescriptorSet, meshletStorageBufferCount> descriptorWrites{};
+		for (uint32_t binding{}; binding < descriptorWrites.size(); ++binding)
+		{
+			descriptorWrites[binding] = VkWriteDescriptorSet
+			{
+				.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+				.dstSet = descriptorSet,
+				.dstBinding = binding,
+				.descriptorCount = 1,
+				.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+				.pBufferInfo = &bufferInfos[binding]
+			};
+		}
+
+		vkUpdateDescriptorSets(parent, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+	}
+
+	void MeshletCullingPass::BindDepthPyramid(const cof::DepthPyramid& depthPyramid)
+	{
+		pyramidExtent = depthPyramid.Extent();
+
+		VkDescriptorImageInfo pyramidInfo
+		{
+			.sampler = depthPyramid.Sampler(),
+			.imageView = depthPyramid.View(),
+			.imageLayout = VK_IMAGE_LAYOUT_GENERAL
+		};
+
+		VkWriteDescriptorSet descriptorWrite
+		{
+			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			.dstSet = descriptorSet,
+			.dstBinding = meshletStorageBufferCount,
+			.descriptorCount = 1,
+			.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+			.pImageInfo = &pyramidInfo
+		};
+
+		vkUpdateDescriptorSets(parent, 1, &descriptorWrite, 0, nullptr);
+	}
+
+	void MeshletCullingPass::Record(VkCommandBuffer commandBuffer, const CullingView& cullingView, bool occlusionEnabled) const
+	{
+		assert(drawCommand != VK_NULL_HANDLE && pyramidExtent.width != 0);
+
+		VkDrawIndexedIndirectCommand resetCommand
+		{
+			.indexCount = 0,
+			.instanceCount = 1,
+			.firstIndex = 0,
+			.vertexOffset = 0,
+			.firstInstance = 0
+		};
+
+		vkCmdUpdateBuffer(commandBuffer, drawCommand, 0, sizeof(VkDrawIndexedIndirectCommand), &resetCommand);
+
+		VkMemoryBarrier resetBarrier
+		{
+			.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+			.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+			.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT
+		};
+
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &resetBarrier, 0, nullptr, 0, nullptr);
+
+		const glm::mat4& projection = cullingView.projection;
+
+		MeshletCullingConstants constants
+		{
+			.view = cullingView.view,
+			.projection = glm::vec4{ projection[0][0], projection[1][1], projection[2][2], projection[3][2] },
+			.zNear = cullingView.zNear,
+			.zFar = cullingView.zFar,
+			.pyramidWidth = pyramidExtent.width,
+			.pyramidHeight = pyramidExtent.height,
+			.meshletCount = boundMeshletCount,
+			.occlusionEnabled = occlusionEnabled ? 1u : 0u
+		};
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+		vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(MeshletCullingConstants), &constants);
+
+		//One workgroup per meshlet, spilling into y when the meshlets exceed the dispatch limit
+		const uint32_t groupCountX{ std::min(boundMeshletCount, maxWorkGroupCountX) };
+		const uint32_t groupCountY{ (boundMeshletCount + maxWorkGroupCountX - 1) / maxWorkGroupCountX };
+		vkCmdDispatch(commandBuffer, groupCountX, groupCountY, 1);
+
+		VkMemoryBarrier cullingBarrier
+		{
+			.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+			.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+			.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_INDEX_READ_BIT
+		};
+
+		vkCmdPipelineBarrier(	commandBuffer,
+								VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+								VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+								0, 1, &cullingBarrier, 0, nullptr, 0, nullptr);
+	}
+
+	void MeshletCullingPass::RecordDraw(VkCommandBuffer commandBuffer) const
+	{
+		vkCmdBindIndexBuffer(commandBuffer, compactedIndices, 0, VK_INDEX_TYPE_UINT32);
+		vkCmdDrawIndexedIndirect(commandBuffer, drawCommand, 0, 1, sizeof(VkDrawIndexedIndirectCommand));
+	}
+}
@@ -0,0 +1,295 @@
+#include "Graphics/OcclusionCulling.h"
+#include "Graphics/DepthPyramid.h"
+#include "GPU/Shader.h"
+
+#include <vulkan/vulkan_core.h>
+#include <glm/ext/vector_float4.hpp>
+
+#include <array>
+#include <cstdio>
+#include <assert.h>
+
+namespace cof
+{
+	constexpr static uint32_t occlusionStorageBufferCount{ 4 };
+
+	struct OcclusionCullingConstants
+	{
+		glm::mat4 view;
+		glm::vec4 projection;
+		float zNear;
+		float zFar;
+		uint32_t pyramidWidth;
+		uint32_t pyramidHeight;
+		uint32_t instanceCount;
+		uint32_t phase;
+		uint32_t lateDrawOffset;
+	};
+
+	float OcclusionCullingStatistics::CulledPercentage(uint32_t instanceCount) const noexcept
+	{
+		if (instanceCount == 0)
+		{
+			return 0.0f;
+		}
+
+		return 100.0f * static_cast<float>(frustumCulledCount + occlusionCulledCount) / static_cast<float>(instanceCount);
+	}
+
+	void OcclusionCullingStatistics::Print(uint32_t instanceCount) const
+	{
+		printf("Culling: %u instances, %u early draws, %u late draws, %u frustum culled, %u occlusion culled (%.1f%% culled)\n",
+			instanceCount, earlyDrawCount, lateDrawCount, frustumCulledCount, occlusionCulledCount, CulledPercentage(instanceCount));
+	}
+
+	OcclusionCullingPass::OcclusionCullingPass(const VkDevice device, const cof::Shader& cullingShader, const bool reversedZ)
+		: parent{ device }
+	{
+		[[maybe_unused]] VkResult errorCode{ VK_RESULT_MAX_ENUM };
+
+		std::array<VkDescriptorSetLayoutBinding, occlusionStorageBufferCount + 1> bindings{};
+		for (uint32_t binding{}; binding < bindings.size(); ++binding)
+		{
+			bindings[binding] = VkDescriptorSetLayoutBinding
+			{
+				.binding = binding,
+				.descriptorType = binding < occlusionStorageBufferCount ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+				.descriptorCount = 1,
+				.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT
+			};
+		}
+
+		VkDescriptorSetLayoutCreateInfo descriptorSetLayoutInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+			.bindingCount = static_cast<uint32_t>(bindings.size()),
+			.pBindings = bindings.data()
+		};
+
+		errorCode = vkCreateDescriptorSetLayout(device, &descriptorSetLayoutInfo, nullptr, &descriptorSetLayout);
+		assert(errorCode == VK_SUCCESS);
+
+		VkPushConstantRange pushConstantRange
+		{
+			.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+			.offset = 0,
+			.size = sizeof(OcclusionCullingConstants)
+		};
+
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+			.setLayoutCount = 1,
+			.pSetLayouts = &descriptorSetLayout,
+			.pushConstantRangeCount = 1,
+			.pPushConstantRanges = &pushConstantRange
+		};
+
+		errorCode = vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout);
+		assert(errorCode == VK_SUCCESS);
+
+		const VkBool32 reversedZConstant{ reversedZ ? VK_TRUE : VK_FALSE };
+
+		VkSpecializationMapEntry specializationEntry
+		{
+			.constantID = 0,
+			.offset = 0,
+			.size = sizeof(VkBool32)
+		};
+
+		VkSpecializationInfo specializationInfo
+		{
+			.mapEntryCount = 1,
+			.pMapEntries = &specializationEntry,
+			.dataSize = sizeof(VkBool32),
+			.pData = &reversedZConstant
+		};
+
+		VkComputePipelineCreateInfo pipelineInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+			.stage =
+			{
+				.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+				.stage = VK_SHADER_STAGE_COMPUTE_BIT,
+				.module = cullingShader.Handle(),
+				.pName = "main",
+				.pSpecializationInfo = &specializationInfo
+			},
+			.layout = pipelineLayout
+		};
+
+		errorCode = vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline);
+		assert(errorCode == VK_SUCCESS);
+
+		std::array poolSizes
+		{
+			VkDescriptorPoolSize{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, occlusionStorageBufferCount },
+			VkDescriptorPoolSize{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1 }
+		};
+
+		VkDescriptorPoolCreateInfo descriptorPoolInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+			.maxSets = 1,
+			.poolSizeCount = static_cast<uint32_t>(poolSizes.size()),
+			.pPoolSizes = poolSizes.data()
+		};
+
+		errorCode = vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool);
+		assert(errorCode == VK_SUCCESS);
+
+		VkDescriptorSetAllocateInfo descriptorSetInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+			.descriptorPool = descriptorPool,
+			.descriptorSetCount = 1,
+			.pSetLayouts = &descriptorSetLayout
+		};
+
+		errorCode = vkAllocateDescriptorSets(device, &descriptorSetInfo, &descriptorSet);
+		assert(errorCode == VK_SUCCESS);
+	}
+
+	OcclusionCullingPass::~OcclusionCullingPass()
+	{
+		vkDestroyDescriptorPool(parent, descriptorPool, nullptr);
+		vkDestroyPipeline(parent, pipeline, nullptr);
+		vkDestroyPipelineLayout(parent, pipelineLayout, nullptr);
+		vkDestroyDescriptorSetLayout(parent, descriptorSetLayout, nullptr);
+	}
+
+	void OcclusionCullingPass::BindBuffers(VkBuffer instanceBuffer, VkBuffer visibilityBuffer, VkBuffer drawCommandBuffer, VkBuffer counterBuffer, uint32_t maxInstanceCount)
+	{
+		drawCommands = drawCommandBuffer;
+		counters = counterBuffer;
+		instanceCapacity = maxInstanceCount;
+
+		std::array<VkDescriptorBufferInfo, occlusionStorageBufferCount> bufferInfos
+		{
+			VkDescriptorBufferInfo{ instanceBuffer, 0, VK_WHOLE_SIZE },
+			VkDescriptorBufferInfo{ visibilityBuffer, 0, VK_WHOLE_SIZE },
+			VkDescriptorBufferInfo{ drawCommandBuffer, 0, VK_WHOLE_SIZE },
+			VkDescriptorBufferInfo{ counterBuffer, 0, VK_WHOLE_SIZE }
+		};
+
+		std::array<VkWriteDescriptorSet, occlusionStorageBufferCount> descriptorWrites{};
+		for (uint32_t binding{}; binding < descriptorWrites.size(); ++binding)
+		{
+			descriptorWrites[binding] = VkWriteDescriptorSet
+			{
+				.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+				.dstSet = descriptorSet,
+				.dstBinding = binding,
+				.descriptorCount = 1,
+				.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+				.pBufferInfo = &bufferInfos[binding]
+			};
+		}
+
+		vkUpdateDescriptorSets(parent, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+	}
+
+	void OcclusionCullingPass::BindDepthPyramid(const cof::DepthPyramid& depthPyramid)
+	{
+		pyramidExtent = depthPyramid.Extent();
+
+		VkDescriptorImageInfo pyramidInfo
+		{
+			.sampler = depthPyramid.Sampler(),
+			.imageView = depthPyramid.View(),
+			.imageLayout = VK_IMAGE_LAYOUT_GENERAL
+		};
+
+		VkWriteDescriptorSet descriptorWrite
+		{
+			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			.dstSet = descriptorSet,
+			.dstBinding = occlusionStorageBufferCount,
+			.descriptorCount = 1,
+			.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+			.pImageInfo = &pyramidInfo
+		};
+
+		vkUpdateDescriptorSets(parent, 1, &descriptorWrite, 0, nullptr);
+	}
+
+	void OcclusionCullingPass::Record(VkCommandBuffer commandBuffer, Phase phase, const CullingView& cullingView, uint32_t instanceCount) const
+	{
+		assert(counters != VK_NULL_HANDLE && instanceCount <= instanceCapacity);
+
+		if (phase == Phase::Early)
+		{
+			vkCmdFillBuffer(commandBuffer, counters, 0, sizeof(OcclusionCullingStatistics), 0);
+
+			VkMemoryBarrier clearBarrier
+			{
+				.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+				.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+				.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT
+			};
+
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &clearBarrier, 0, nullptr, 0, nullptr);
+		}
+
+		const glm::mat4& projection = cullingView.projection;
+
+		OcclusionCullingConstants constants
+		{
+			.view = cullingView.view,
+			.projection = glm::vec4{ projection[0][0], projection[1][1], projection[2][2], projection[3][2] },
+			.zNear = cullingView.zNear,
+			.zFar = cullingView.zFar,
+			.pyramidWidth = pyramidExtent.width,
+			.pyramidHeight = pyramidExtent.height,
+			.instanceCount = instanceCount,
+			.phase = static_cast<uint32_t>(phase),
+			.lateDrawOffset = instanceCapacity
+		};
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+		vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(OcclusionCullingConstants), &constants);
+		vkCmdDispatch(commandBuffer, (instanceCount + workGroupSize - 1) / workGroupSize, 1, 1);
+
+		//Covers the indirect draws and the visibility handed from one phase to the next
+		VkMemoryBarrier cullingBarrier
+		{
+			.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+			.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+			.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT
+		};
+
+		vkCmdPipelineBarrier(	commandBuffer,
+								VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+								VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+								0, 1, &cullingBarrier, 0, nullptr, 0, nullptr);
+	}
+
+	void OcclusionCullingPass::RecordDraw(VkCommandBuffer commandBuffer, Phase phase) const
+	{
+		const uint32_t phaseIndex{ static_cast<uint32_t>(phase) };
+		const VkDeviceSize commandOffset{ static_cast<VkDeviceSize>(phaseIndex) * instanceCapacity * sizeof(VkDrawIndexedIndirectCommand) };
+
+		vkCmdDrawIndexedIndirectCount(commandBuffer, drawCommands, commandOffset, counters, phaseIndex * sizeof(uint32_t), instanceCapacity, sizeof(VkDrawIndexedIndirectCommand));
+	}
+
+	void OcclusionCullingPass::RecordStatisticsCopy(VkCommandBuffer commandBuffer, VkBuffer readbackBuffer) const
+	{
+		VkMemoryBarrier counterBarrier
+		{
+			.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+			.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+			.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT
+		};
+
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &counterBarrier, 0, nullptr, 0, nullptr);
+
+		VkBufferCopy copyRegion
+		{
+			.size = sizeof(OcclusionCullingStatistics)
+		};
+
+		vkCmdCopyBuffer(commandBuffer, counters, readbackBuffer, 1, &copyRegion);
+	}
+}
@@ -0,0 +1,223 @@
+#include "Graphics/OffscreenTarget.h"
+#include "GPU/GPUContext.h"
+#include "Utils/CpuProfiler.h"
+
+#include <vulkan/vulkan_core.h>
+
+#include <assert.h>
+#include <cstddef>
+#include <fstream>
+
+namespace cof
+{
+	OffscreenTarget::OffscreenTarget(const cof::GPUContext& gpuContext, VmaAllocator allocator, VkQueue queue, VkFormat imageFormat, VkExtent2D imageExtent, VkImageUsageFlags usage, uint32_t imageCount)
+		: images(imageCount)
+		, allocations(imageCount)
+		, format{ imageFormat }
+		, extent{ imageExtent }
+		, targetQueue{ queue }
+		, queueFamilyIndex{ gpuContext.QueueFamilyIndex<VK_QUEUE_GRAPHICS_BIT>() }
+		, parent{ gpuContext.LogicalDevice() }
+		, memoryAllocator{ allocator }
+	{
+		VkImageCreateInfo imageInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+			.imageType = VK_IMAGE_TYPE_2D,
+			.format = format,
+			.extent = { extent.width, extent.height, 1 },
+			.mipLevels = 1,
+			.arrayLayers = 1,
+			.samples = VK_SAMPLE_COUNT_1_BIT,
+			.tiling = VK_IMAGE_TILING_OPTIMAL,
+			.usage = usage | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+			.sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+			.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED
+		};
+
+		VmaAllocationCreateInfo allocationInfo
+		{
+			.usage = VMA_MEMORY_USAGE_GPU_ONLY
+		};
+
+		for (uint32_t image{}; image < imageCount; ++image)
+		{
+			[[maybe_unused]] VkResult errorCode = vmaCreateImage(memoryAllocator, &imageInfo, &allocationInfo, &images[image], &allocations[image], nullptr);
+			assert(errorCode == VK_SUCCESS);
+		}
+	}
+
+	OffscreenTarget::~OffscreenTarget()
+	{
+		for (uint32_t image{}; image < images.size(); ++image)
+		{
+			vmaDestroyImage(memoryAllocator, images[image], allocations[image]);
+		}
+	}
+
+	uint32_t OffscreenTarget::AcquireNextImage(VkSemaphore acquireSemaphore)
+	{
+		CPU_ZONE("OffscreenTarget::AcquireNextImage");
+
+		//Nothing to wait for, the frames using the image before have finished once the queue got to this submit
+		VkSubmitInfo submitInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+			.signalSemaphoreCount = 1,
+			.pSignalSemaphores = &acquireSemaphore
+		};
+
+		[[maybe_unused]] VkResult errorCode = vkQueueSubmit(targetQueue, 1, &submitInfo, VK_NULL_HANDLE);
+		assert(errorCode == VK_SUCCESS);
+
+		const uint32_t imageIndex{ nextImage };
+		nextImage = (nextImage + 1) % static_cast<uint32_t>(images.size());
+		return imageIndex;
+	}
+
+	void OffscreenTarget::Present(VkQueue presentQueue, VkSemaphore renderingFinishedSemaphore, uint32_t imageIndex)
+	{
+		CPU_ZONE("OffscreenTarget::Present");
+
+		//Only unsignals the semaphore, so the next frame can signal it again
+		const VkPipelineStageFlags waitStage{ VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT };
+		VkSubmitInfo submitInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+			.waitSemaphoreCount = 1,
+			.pWaitSemaphores = &renderingFinishedSemaphore,
+			.pWaitDstStageMask = &waitStage
+		};
+
+		[[maybe_unused]] VkResult errorCode = vkQueueSubmit(presentQueue, 1, &submitInfo, VK_NULL_HANDLE);
+		assert(errorCode == VK_SUCCESS);
+
+		lastPresented = imageIndex;
+		presented = true;
+	}
+
+	bool OffscreenTarget::Save(const char* path)
+	{
+		const bool bgra{ format == VK_FORMAT_B8G8R8A8_UNORM || format == VK_FORMAT_B8G8R8A8_SRGB };
+		const bool rgba{ format == VK_FORMAT_R8G8B8A8_UNORM || format == VK_FORMAT_R8G8B8A8_SRGB };
+		if (!presented || (!bgra && !rgba))
+		{
+			return false;
+		}
+
+		const VkDeviceSize imageBytes{ static_cast<VkDeviceSize>(extent.width) * extent.height * 4 };
+
+		VkBufferCreateInfo bufferInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+			.size = imageBytes,
+			.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			.sharingMode = VK_SHARING_MODE_EXCLUSIVE
+		};
+
+		VmaAllocationCreateInfo readbackAllocationInfo
+		{
+			.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT,
+			.usage = VMA_MEMORY_USAGE_GPU_TO_CPU
+		};
+
+		VkBuffer readbackBuffer;
+		VmaAllocation readbackAllocation;
+		VmaAllocationInfo readbackInfo;
+		[[maybe_unused]] VkResult errorCode = vmaCreateBuffer(memoryAllocator, &bufferInfo, &readbackAllocationInfo, &readbackBuffer, &readbackAllocation, &readbackInfo);
+		assert(errorCode == VK_SUCCESS);
+
+		VkCommandPoolCreateInfo poolInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+			.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+			.queueFamilyIndex = queueFamilyIndex
+		};
+
+		VkCommandPool commandPool;
+		errorCode = vkCreateCommandPool(parent, &poolInfo, nullptr, &commandPool);
+		assert(errorCode == VK_SUCCESS);
+
+		VkCommandBufferAllocateInfo commandBufferInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+			.commandPool = commandPool,
+			.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+			.commandBufferCount = 1
+		};
+
+		VkCommandBuffer commandBuffer;
+		errorCode = vkAllocateCommandBuffers(parent, &commandBufferInfo, &commandBuffer);
+		assert(errorCode == VK_SUCCESS);
+
+		VkCommandBufferBeginInfo beginInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+			.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
+		};
+
+		vkBeginCommandBuffer(commandBuffer, &beginInfo);
+
+		//The frame's final barrier already moved the image to the transfer source layout, only its writes need to be visible
+		VkMemoryBarrier renderBarrier
+		{
+			.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+			.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT,
+			.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT
+		};
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &renderBarrier, 0, nullptr, 0, nullptr);
+
+		VkBufferImageCopy region
+		{
+			.bufferOffset = 0,
+			.bufferRowLength = 0,
+			.bufferImageHeight = 0,
+			.imageSubresource = { .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .mipLevel = 0, .baseArrayLayer = 0, .layerCount = 1 },
+			.imageOffset = { 0, 0, 0 },
+			.imageExtent = { extent.width, extent.height, 1 }
+		};
+		vkCmdCopyImageToBuffer(commandBuffer, images[lastPresented], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readbackBuffer, 1, &region);
+
+		VkMemoryBarrier hostBarrier
+		{
+			.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+			.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+			.dstAccessMask = VK_ACCESS_HOST_READ_BIT
+		};
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &hostBarrier, 0, nullptr, 0, nullptr);
+
+		errorCode = vkEndCommandBuffer(commandBuffer);
+		assert(errorCode == VK_SUCCESS);
+
+		VkSubmitInfo submitInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+			.commandBufferCount = 1,
+			.pCommandBuffers = &commandBuffer
+		};
+
+		errorCode = vkQueueSubmit(targetQueue, 1, &submitInfo, VK_NULL_HANDLE);
+		assert(errorCode == VK_SUCCESS);
+		vkQueueWaitIdle(targetQueue);
+
+		vmaInvalidateAllocation(memoryAllocator, readbackAllocation, 0, VK_WHOLE_SIZE);
+		const std::byte* texels{ static_cast<const std::byte*>(readbackInfo.pMappedData) };
+
+		std::vector<char> pixels(static_cast<size_t>(extent.width) * extent.height * 3);
+		for (size_t pixel{}; pixel < static_cast<size_t>(extent.width) * extent.height; ++pixel)
+		{
+			const std::byte* texel{ texels + pixel * 4 };
+			pixels[pixel * 3 + 0] = static_cast<char>(texel[bgra ? 2 : 0]);
+			pixels[pixel * 3 + 1] = static_cast<char>(texel[1]);
+			pixels[pixel * 3 + 2] = static_cast<char>(texel[bgra ? 0 : 2]);
+		}
+
+		vkDestroyCommandPool(parent, commandPool, nullptr);
+		vmaDestroyBuffer(memoryAllocator, readbackBuffer, readbackAllocation);
+
+		std::ofstream file{ path, std::ios::binary };
+		file << "P6\n" << extent.width << ' ' << extent.height << "\n255\n";
+		file.write(pixels.data(), static_cast<std::streamsize>(pixels.size()));
+		return static_cast<bool>(file);
+	}
+}
@@ -0,0 +1,820 @@
+#include "Graphics/RenderGraph.h"
+#include "GPU/AttachmentMemory.h"
+#include "GPU/GpuProfiler.h"
+#include "Utils/CpuProfiler.h"
+
+#include <vulkan/vulkan_core.h>
+
+#include <algorithm>
+#include <assert.h>
+#include <cstdio>
+
+namespace cof
+{
+	struct UsageInfo
+	{
+		VkPipelineStageFlags stages;
+		VkAccessFlags access;
+		//Ignored for buffers
+		VkImageLayout layout;
+		bool reads;
+		bool writes;
+		//Images only
+		VkImageUsageFlags imageUsage;
+	};
+
+	constexpr static uint32_t noPass{ ~0u };
+
+	constexpr static VkAccessFlags writeAccessMask
+	{
+		VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+		VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_HOST_WRITE_BIT | VK_ACCESS_MEMORY_WRITE_BIT
+	};
+
+	constexpr static VkPipelineStageFlags fragmentTestStages{ VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT };
+
+	static UsageInfo Usage(ResourceUsage usage) noexcept
+	{
+		switch (usage)
+		{
+		case ResourceUsage::TransferRead:
+			return { VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, true, false, VK_IMAGE_USAGE_TRANSFER_SRC_BIT };
+		case ResourceUsage::TransferWrite:
+			return { VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, false, true, VK_IMAGE_USAGE_TRANSFER_DST_BIT };
+		case ResourceUsage::IndirectRead:
+			return { VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, true, false, 0 };
+		case ResourceUsage::IndexRead:
+			return { VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_INDEX_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, true, false, 0 };
+		case ResourceUsage::VertexRead:
+			return { VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, true, false, 0 };
+		case ResourceUsage::VertexShaderRead:
+			return { VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, true, false, 0 };
+		case ResourceUsage::UniformRead:
+			return { VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_UNIFORM_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, true, false, 0 };
+		case ResourceUsage::ComputeRead:
+			return { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, true, false, VK_IMAGE_USAGE_STORAGE_BIT };
+		case ResourceUsage::ComputeWrite:
+			return { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, false, true, VK_IMAGE_USAGE_STORAGE_BIT };
+		case ResourceUsage::ComputeReadWrite:
+			return { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, true, true, VK_IMAGE_USAGE_STORAGE_BIT };
+		case ResourceUsage::ComputeSampled:
+			return { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, true, false, VK_IMAGE_USAGE_SAMPLED_BIT };
+		case ResourceUsage::FragmentRead:
+			return { VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, true, false, VK_IMAGE_USAGE_STORAGE_BIT };
+		case ResourceUsage::FragmentSampled:
+			return { VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, true, false, VK_IMAGE_USAGE_SAMPLED_BIT };
+		case ResourceUsage::ColorWrite:
+			return { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, false, true, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT };
+		case ResourceUsage::ColorReadWrite:
+			return { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, true, true, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT };
+		//Depth tests read the attachment even right after a clear
+		case ResourceUsage::DepthWrite:
+			return { fragmentTestStages, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, false, true, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT };
+		case ResourceUsage::DepthReadWrite:
+			return { fragmentTestStages, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, true, true, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT };
+		case ResourceUsage::DepthRead:
+			return { fragmentTestStages, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, true, false, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT };
+		case ResourceUsage::InputAttachment:
+			return { VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_INPUT_ATTACHMENT_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, true, false, VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT };
+		}
+
+		assert(false);
+		return {};
+	}
+
+	void RenderGraphStatistics::Print() const
+	{
+		constexpr double megabyte{ 1024.0 * 1024.0 };
+
+		printf("Render graph: %u passes, %u culled, %u levels, %u barriers with %u layout transitions, compiled %u times\n",
+			passCount, culledPassCount, levelCount, barrierCount, imageBarrierCount, compileCount);
+		printf("Transient images: %u, %u lazily allocated, estimated %.1f MiB without aliasing, %.1f MiB resident after aliasing, %.1f MiB lazy\n",
+			transientImageCount, lazyImageCount, static_cast<double>(dedicatedBytes) / megabyte,
+			static_cast<double>(residentBytes) / megabyte, static_cast<double>(lazyBytes) / megabyte);
+		printf("Transient images as VMA counts them: %.1f MiB allocated, %.1f MiB of new device memory\n",
+			static_cast<double>(vmaAllocatedBytes) / megabyte, static_cast<double>(vmaDeviceMemoryBytes) / megabyte);
+	}
+
+	RenderGraph::RenderGraph(const VkDevice device, VmaAllocator allocator)
+		: parent{ device }
+		, memoryAllocator{ allocator }
+	{
+	}
+
+	RenderGraph::~RenderGraph()
+	{
+		DestroyTransientImages();
+	}
+
+	RenderResource RenderGraph::ImportImage(std::string_view name, VkImage image, const VkImageSubresourceRange& range, const ResourceState& initialState)
+	{
+		resources.push_back(Resource
+		{
+			.name = std::string{ name },
+			.image = image,
+			.buffer = VK_NULL_HANDLE,
+			.range = range,
+			.initialState = initialState,
+			.output = false,
+			.finalLayout = VK_IMAGE_LAYOUT_UNDEFINED
+		});
+
+		dirty = true;
+		return static_cast<RenderResource>(resources.size() - 1);
+	}
+
+	RenderResource RenderGraph::ImportBuffer(std::string_view name, VkBuffer buffer, const ResourceState& initialState)
+	{
+		assert(buffer != VK_NULL_HANDLE);
+
+		resources.push_back(Resource
+		{
+			.name = std::string{ name },
+			.image = VK_NULL_HANDLE,
+			.buffer = buffer,
+			.range = {},
+			.initialState = initialState,
+			.output = false,
+			.finalLayout = VK_IMAGE_LAYOUT_UNDEFINED
+		});
+
+		dirty = true;
+		return static_cast<RenderResource>(resources.size() - 1);
+	}
+
+	void RenderGraph::SetImage(RenderResource resource, VkImage image) noexcept
+	{
+		assert(resource < resources.size() && resources[resource].buffer == VK_NULL_HANDLE);
+		resources[resource].image = image;
+	}
+
+	void RenderGraph::SetBuffer(RenderResource resource, VkBuffer buffer) noexcept
+	{
+		assert(resource < resources.size() && resources[resource].buffer != VK_NULL_HANDLE && buffer != VK_NULL_HANDLE);
+		resources[resource].buffer = buffer;
+	}
+
+	RenderResource RenderGraph::CreateImage(std::string_view name, const TransientImageInfo& info)
+	{
+		resources.push_back(Resource
+		{
+			.name = std::string{ name },
+			.image = VK_NULL_HANDLE,
+			.buffer = VK_NULL_HANDLE,
+			.range = { info.aspect, 0, 1, 0, 1 },
+			.initialState = { 0, 0, VK_IMAGE_LAYOUT_UNDEFINED },
+			.output = false,
+			.finalLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+			.transient = true,
+			.transientInfo = info
+		});
+
+		dirty = true;
+		return static_cast<RenderResource>(resources.size() - 1);
+	}
+
+	void RenderGraph::MarkOutput(RenderResource resource, VkImageLayout finalLayout)
+	{
+		assert(resource < resources.size());
+		resources[resource].output = true;
+		resources[resource].finalLayout = finalLayout;
+		dirty = true;
+	}
+
+	void RenderGraph::AddPass(RenderGraphPass pass)
+	{
+		assert(!HasPass(pass.name));
+		passes.push_back(std::move(pass));
+		dirty = true;
+	}
+
+	void RenderGraph::RemovePass(std::string_view name)
+	{
+		auto pass = std::find_if(passes.begin(), passes.end(), [name](const RenderGraphPass& candidate) { return candidate.name == name; });
+		assert(pass != passes.end());
+		passes.erase(pass);
+		dirty = true;
+	}
+
+	bool RenderGraph::HasPass(std::string_view name) const noexcept
+	{
+		return std::any_of(passes.begin(), passes.end(), [name](const RenderGraphPass& candidate) { return candidate.name == name; });
+	}
+
+	void RenderGraph::Compile()
+	{
+		CPU_ZONE("RenderGraph::Compile");
+
+		const uint32_t passCount{ static_cast<uint32_t>(passes.size()) };
+
+		auto LastWriter = [this](RenderResource resource, uint32_t before)
+		{
+			for (uint32_t pass{ before }; pass-- > 0;)
+			{
+				for (const ResourceAccess& access : passes[pass].accesses)
+				{
+					if (access.resource == resource && Usage(access.usage).writes)
+					{
+						return pass;
+					}
+				}
+			}
+			return noPass;
+		};
+
+		//Walk back from the outputs, a pass is live when a live pass reads what it wrote last
+		std::vector<bool> live(passCount, false);
+		std::vector<uint32_t> worklist;
+
+		auto MarkLive = [&live, &worklist](uint32_t pass)
+		{
+			if (pass != noPass && !live[pass])
+			{
+				live[pass] = true;
+				worklist.push_back(pass);
+			}
+		};
+
+		for (uint32_t pass{}; pass < passCount; ++pass)
+		{
+			if (passes[pass].sideEffects)
+			{
+				MarkLive(pass);
+			}
+		}
+
+		for (RenderResource resource{}; resource < resources.size(); ++resource)
+		{
+			if (resources[resource].output)
+			{
+				MarkLive(LastWriter(resource, passCount));
+			}
+		}
+
+		while (!worklist.empty())
+		{
+			const uint32_t pass{ worklist.back() };
+			worklist.pop_back();
+
+			for (const ResourceAccess& access : passes[pass].accesses)
+			{
+				if (Usage(access.usage).reads)
+				{
+					MarkLive(LastWriter(access.resource, pass));
+				}
+			}
+		}
+
+		culledPassCount = static_cast<uint32_t>(std::count(live.begin(), live.end(), false));
+
+		//A pass goes one level past every pass it has a read after write, write after read or write after write hazard with.
+		//Reads that change the layout count as writes, later reads in that layout may share its level
+		struct Tracking
+		{
+			uint32_t writer;
+			std::vector<uint32_t> readers;
+			uint32_t layoutPass;
+			VkImageLayout layout;
+		};
+
+		std::vector<Tracking> tracking(resources.size());
+		for (RenderResource resource{}; resource < resources.size(); ++resource)
+		{
+			tracking[resource] = Tracking{ .writer = noPass, .readers = {}, .layoutPass = noPass, .layout = resources[resource].initialState.layout };
+		}
+
+		passLevels.assign(passCount, 0);
+		uint32_t levelCount{ 0 };
+
+		for (uint32_t pass{}; pass < passCount; ++pass)
+		{
+			if (!live[pass])
+			{
+				continue;
+			}
+
+			uint32_t level{ 0 };
+			auto After = [&level, this](uint32_t other) { if (other != noPass) level = std::max(level, passLevels[other] + 1); };
+
+			for (const ResourceAccess& access : passes[pass].accesses)
+			{
+				const UsageInfo usage{ Usage(access.usage) };
+				const Tracking& state{ tracking[access.resource] };
+				const bool transition{ resources[access.resource].buffer == VK_NULL_HANDLE && usage.layout != state.layout };
+
+				After(state.writer);
+				if (usage.writes || transition)
+				{
+					std::for_each(state.readers.begin(), state.readers.end(), After);
+				}
+				else if (state.layoutPass != noPass)
+				{
+					level = std::max(level, passLevels[state.layoutPass]);
+				}
+			}
+
+			passLevels[pass] = level;
+			levelCount = std::max(levelCount, level + 1);
+
+			for (const ResourceAccess& access : passes[pass].accesses)
+			{
+				const UsageInfo usage{ Usage(access.usage) };
+				Tracking& state{ tracking[access.resource] };
+				const bool transition{ resources[access.resource].buffer == VK_NULL_HANDLE && usage.layout != state.layout };
+
+				if (usage.writes)
+				{
+					state.writer = pass;
+					state.readers.clear();
+					state.layoutPass = noPass;
+				}
+				else if (transition)
+				{
+					state.readers.assign(1, pass);
+					state.layoutPass = pass;
+				}
+				else
+				{
+					state.readers.push_back(pass);
+				}
+
+				state.layout = access.finalLayout != VK_IMAGE_LAYOUT_UNDEFINED ? access.finalLayout : usage.layout;
+			}
+		}
+
+		levels.assign(levelCount, Level{});
+		for (uint32_t pass{}; pass < passCount; ++pass)
+		{
+			if (live[pass])
+			{
+				levels[passLevels[pass]].passes.push_back(pass);
+			}
+		}
+
+		DestroyTransientImages();
+		CreateTransientImages();
+
+		//Replay the accesses in execution order, merging every hazard into the barrier in front of its level
+		struct State
+		{
+			VkPipelineStageFlags writeStages;
+			VkAccessFlags writeAccess;
+			VkPipelineStageFlags readStages;
+			//Stages and accesses the last write has already been made visible to
+			VkPipelineStageFlags visibleStages;
+			VkAccessFlags visibleAccess;
+			VkImageLayout layout;
+		};
+
+		std::vector<State> states(resources.size());
+		for (RenderResource resource{}; resource < resources.size(); ++resource)
+		{
+			const ResourceState& initialState{ resources[resource].initialState };
+			states[resource] = State
+			{
+				.writeStages = initialState.stages,
+				.writeAccess = initialState.access & writeAccessMask,
+				.readStages = initialState.stages,
+				.visibleStages = 0,
+				.visibleAccess = 0,
+				.layout = initialState.layout
+			};
+		}
+
+		auto AddTransition = [this](BarrierBatch& batch, RenderResource resource, const State& state, VkImageLayout oldLayout, VkImageLayout newLayout, VkPipelineStageFlags dstStages, VkAccessFlags dstAccess)
+		{
+			const VkPipelineStageFlags srcStages{ state.writeStages | state.readStages };
+			batch.srcStages |= srcStages != 0 ? srcStages : static_cast<VkPipelineStageFlags>(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+			batch.dstStages |= dstStages;
+			batch.imageBarriers.push_back(VkImageMemoryBarrier
+			{
+				.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+				.srcAccessMask = state.writeAccess,
+				.dstAccessMask = dstAccess,
+				.oldLayout = oldLayout,
+				.newLayout = newLayout,
+				.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				.image = VK_NULL_HANDLE,
+				.subresourceRange = resources[resource].range
+			});
+			batch.imageResources.push_back(resource);
+		};
+
+		//The first access to an aliased image waits for every image it shares memory with that died before
+		auto InheritAliasedStates = [this, &states](RenderResource resource)
+		{
+			const Resource& current{ resources[resource] };
+			for (RenderResource other{}; other < resources.size(); ++other)
+			{
+				const Resource& previous{ resources[other] };
+				if (other != resource && previous.aliased && previous.lastLevel < current.firstLevel &&
+					previous.aliasOffset < current.aliasOffset + current.memorySize && current.aliasOffset < previous.aliasOffset + previous.memorySize)
+				{
+					states[resource].writeStages |= states[other].writeStages | states[other].readStages;
+					states[resource].writeAccess |= states[other].writeAccess;
+				}
+			}
+		};
+
+		std::vector<bool> touched(resources.size(), false);
+
+		for (Level& level : levels)
+		{
+			BarrierBatch& batch{ level.barriers };
+
+			for (uint32_t pass : level.passes)
+			{
+				for (const ResourceAccess& access : passes[pass].accesses)
+				{
+					const UsageInfo usage{ Usage(access.usage) };
+					State& state{ states[access.resource] };
+					const bool image{ resources[access.resource].buffer == VK_NULL_HANDLE };
+
+					if (!touched[access.resource] && resources[access.resource].transient)
+					{
+						//Transient contents start out undefined
+						assert(!usage.reads);
+						if (resources[access.resource].aliased)
+						{
+							InheritAliasedStates(access.resource);
+						}
+					}
+					touched[access.resource] = true;
+
+					const bool transition{ image && usage.layout != state.layout };
+
+					if (usage.writes || transition)
+					{
+						if (transition)
+						{
+							//Writes that discard the contents don't need the old layout preserved
+							AddTransition(batch, access.resource, state, usage.reads ? state.layout : VK_IMAGE_LAYOUT_UNDEFINED, usage.layout, usage.stages, usage.access);
+						}
+						else if ((state.writeStages | state.readStages) != 0)
+						{
+							batch.srcStages |= state.writeStages | state.readStages;
+							batch.dstStages |= usage.stages;
+							if (state.writeAccess != 0)
+							{
+								batch.memoryBarrier.srcAccessMask |= state.writeAccess;
+								batch.memoryBarrier.dstAccessMask |= usage.access;
+							}
+						}
+
+						//The transition of a read is made visible to the reading pass only
+						state = State
+						{
+							.writeStages = usage.stages,
+							.writeAccess = usage.access & writeAccessMask,
+							.readStages = usage.writes ? 0 : usage.stages,
+							.visibleStages = usage.writes ? 0 : usage.stages,
+							.visibleAccess = usage.writes ? 0 : usage.access,
+							.layout = usage.layout
+						};
+					}
+					else
+					{
+						//Reads after reads only need ordering against the next write
+						if (state.writeStages != 0 && ((usage.stages & ~state.visibleStages) != 0 || (usage.access & ~state.visibleAccess) != 0))
+						{
+							batch.srcStages |= state.writeStages;
+							batch.dstStages |= usage.stages;
+							if (state.writeAccess != 0)
+							{
+								batch.memoryBarrier.srcAccessMask |= state.writeAccess;
+								batch.memoryBarrier.dstAccessMask |= usage.access;
+							}
+							state.visibleStages |= usage.stages;
+							state.visibleAccess |= usage.access;
+						}
+
+						state.readStages |= usage.stages;
+					}
+
+					if (image && access.finalLayout != VK_IMAGE_LAYOUT_UNDEFINED)
+					{
+						state.layout = access.finalLayout;
+					}
+				}
+			}
+		}
+
+		finalBarriers = BarrierBatch{};
+		for (RenderResource resource{}; resource < resources.size(); ++resource)
+		{
+			const Resource& output{ resources[resource] };
+			if (output.output && output.buffer == VK_NULL_HANDLE && output.finalLayout != VK_IMAGE_LAYOUT_UNDEFINED && output.finalLayout != states[resource].layout)
+			{
+				AddTransition(finalBarriers, resource, states[resource], states[resource].layout, output.finalLayout, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0);
+			}
+		}
+
+		++compileCount;
+		dirty = false;
+	}
+
+	void RenderGraph::CreateTransientImages()
+	{
+		[[maybe_unused]] VkResult errorCode{ VK_RESULT_MAX_ENUM };
+
+		//Anything else allocating from another thread meanwhile ends up in the figures too
+		VmaStats statsBefore;
+		vmaCalculateStats(memoryAllocator, &statsBefore);
+
+		std::vector<VkImageUsageFlags> usages(resources.size(), 0);
+		std::vector<uint32_t> accessingPasses(resources.size(), noPass);
+		std::vector<bool> singlePass(resources.size(), true);
+
+		for (Resource& resource : resources)
+		{
+			resource.firstLevel = noPass;
+			resource.lastLevel = 0;
+		}
+
+		for (uint32_t level{}; level < levels.size(); ++level)
+		{
+			for (uint32_t pass : levels[level].passes)
+			{
+				for (const ResourceAccess& access : passes[pass].accesses)
+				{
+					Resource& resource{ resources[access.resource] };
+					resource.firstLevel = std::min(resource.firstLevel, level);
+					resource.lastLevel = std::max(resource.lastLevel, level);
+
+					usages[access.resource] |= Usage(access.usage).imageUsage;
+					singlePass[access.resource] = singlePass[access.resource] && (accessingPasses[access.resource] == noPass || accessingPasses[access.resource] == pass);
+					accessingPasses[access.resource] = pass;
+				}
+			}
+		}
+
+		constexpr VkImageUsageFlags attachmentUsage{ VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT };
+
+		std::vector<AliasedImage> aliasedImages;
+		std::vector<RenderResource> aliasedResources;
+		uint32_t memoryTypeBits{ ~0u };
+		VkDeviceSize alignment{ 1 };
+
+		for (RenderResource resource{}; resource < resources.size(); ++resource)
+		{
+			Resource& transient{ resources[resource] };
+			//Images of culled passes aren't created at all
+			if (!transient.transient || transient.firstLevel == noPass)
+			{
+				continue;
+			}
+
+			//Attachments that never leave their render pass are never stored, so they need no memory on a tiler
+			const bool transientAttachment{ singlePass[resource] && !transient.output && (usages[resource] & ~attachmentUsage) == 0 };
+
+			VkImageUsageFlags usage{ usages[resource] };
+			if (transientAttachment)
+			{
+				usage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+			}
+
+			VkImageCreateInfo imageInfo
+			{
+				.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+				.imageType = VK_IMAGE_TYPE_2D,
+				.format = transient.transientInfo.format,
+				.extent = { transient.transientInfo.extent.width, transient.transientInfo.extent.height, 1 },
+				.mipLevels = 1,
+				.arrayLayers = 1,
+				.samples = VK_SAMPLE_COUNT_1_BIT,
+				.tiling = VK_IMAGE_TILING_OPTIMAL,
+				.usage = usage,
+				.sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+				.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED
+			};
+
+			VkMemoryRequirements requirements;
+
+			if (transientAttachment)
+			{
+				transient.lazy = CreateAttachmentImage(memoryAllocator, imageInfo, transient.image, transient.allocation);
+
+				//Without lazily allocated memory the attachment is better off aliased like everything else
+				if (!transient.lazy)
+				{
+					vmaDestroyImage(memoryAllocator, transient.image, transient.allocation);
+					transient.image = VK_NULL_HANDLE;
+					transient.allocation = VK_NULL_HANDLE;
+				}
+			}
+
+			if (transient.lazy)
+			{
+				vkGetImageMemoryRequirements(parent, transient.image, &requirements);
+			}
+			else
+			{
+				errorCode = vkCreateImage(parent, &imageInfo, nullptr, &transient.image);
+				assert(errorCode == VK_SUCCESS);
+
+				vkGetImageMemoryRequirements(parent, transient.image, &requirements);
+				memoryTypeBits &= requirements.memoryTypeBits;
+				alignment = std::max(alignment, requirements.alignment);
+
+				aliasedImages.push_back(AliasedImage{ requirements.size, requirements.alignment, transient.firstLevel, transient.lastLevel });
+				aliasedResources.push_back(resource);
+				transient.aliased = true;
+			}
+
+			transient.memorySize = requirements.size;
+		}
+
+		if (!aliasedImages.empty())
+		{
+			std::vector<VkDeviceSize> offsets;
+			aliasedBytes = PlaceAliasedImages(aliasedImages, offsets);
+
+			//Optimal tiling color and depth images share memory types on every desktop vendor
+			assert(memoryTypeBits != 0);
+
+			VkMemoryRequirements requirements
+			{
+				.size = aliasedBytes,
+				.alignment = alignment,
+				.memoryTypeBits = memoryTypeBits
+			};
+
+			VmaAllocationCreateInfo allocInfo
+			{
+				.usage = VMA_MEMORY_USAGE_GPU_ONLY
+			};
+
+			errorCode = vmaAllocateMemory(memoryAllocator, &requirements, &allocInfo, &aliasedAllocation, nullptr);
+			assert(errorCode == VK_SUCCESS);
+
+			for (size_t image{}; image < aliasedImages.size(); ++image)
+			{
+				Resource& transient{ resources[aliasedResources[image]] };
+				transient.aliasOffset = offsets[image];
+
+				errorCode = vmaBindImageMemory2(memoryAllocator, aliasedAllocation, transient.aliasOffset, transient.image, nullptr);
+				assert(errorCode == VK_SUCCESS);
+			}
+		}
+
+		for (Resource& transient : resources)
+		{
+			if (!transient.transient || transient.image == VK_NULL_HANDLE)
+			{
+				continue;
+			}
+
+			VkImageViewCreateInfo viewInfo
+			{
+				.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+				.image = transient.image,
+				.viewType = VK_IMAGE_VIEW_TYPE_2D,
+				.format = transient.transientInfo.format,
+				.subresourceRange = transient.range
+			};
+
+			errorCode = vkCreateImageView(parent, &viewInfo, nullptr, &transient.view);
+			assert(errorCode == VK_SUCCESS);
+		}
+
+		VmaStats statsAfter;
+		vmaCalculateStats(memoryAllocator, &statsAfter);
+
+		auto deviceMemoryBytes = [](const VmaStats& stats) { return stats.total.usedBytes + stats.total.unusedBytes; };
+		vmaAllocatedBytes = statsAfter.total.usedBytes > statsBefore.total.usedBytes ? statsAfter.total.usedBytes - statsBefore.total.usedBytes : 0;
+		vmaDeviceMemoryBytes = deviceMemoryBytes(statsAfter) > deviceMemoryBytes(statsBefore) ? deviceMemoryBytes(statsAfter) - deviceMemoryBytes(statsBefore) : 0;
+	}
+
+	void RenderGraph::DestroyTransientImages()
+	{
+		for (Resource& transient : resources)
+		{
+			if (!transient.transient || transient.image == VK_NULL_HANDLE)
+			{
+				continue;
+			}
+
+			vkDestroyImageView(parent, transient.view, nullptr);
+			if (transient.aliased)
+			{
+				vkDestroyImage(parent, transient.image, nullptr);
+			}
+			else
+			{
+				vmaDestroyImage(memoryAllocator, transient.image, transient.allocation);
+			}
+
+			transient.image = VK_NULL_HANDLE;
+			transient.view = VK_NULL_HANDLE;
+			transient.allocation = VK_NULL_HANDLE;
+			transient.lazy = false;
+			transient.aliased = false;
+			transient.aliasOffset = 0;
+			transient.memorySize = 0;
+		}
+
+		if (aliasedAllocation != VK_NULL_HANDLE)
+		{
+			vmaFreeMemory(memoryAllocator, aliasedAllocation);
+			aliasedAllocation = VK_NULL_HANDLE;
+			aliasedBytes = 0;
+		}
+
+		vmaAllocatedBytes = 0;
+		vmaDeviceMemoryBytes = 0;
+	}
+
+	void RenderGraph::RecordBarriers(VkCommandBuffer commandBuffer, BarrierBatch& batch)
+	{
+		if (batch.Empty())
+		{
+			return;
+		}
+
+		for (size_t barrier{}; barrier < batch.imageBarriers.size(); ++barrier)
+		{
+			batch.imageBarriers[barrier].image = resources[batch.imageResources[barrier]].image;
+			assert(batch.imageBarriers[barrier].image != VK_NULL_HANDLE);
+		}
+
+		const bool memoryBarrier{ batch.memoryBarrier.srcAccessMask != 0 || batch.memoryBarrier.dstAccessMask != 0 };
+
+		vkCmdPipelineBarrier(commandBuffer, batch.srcStages, batch.dstStages, 0,
+			memoryBarrier ? 1 : 0, memoryBarrier ? &batch.memoryBarrier : nullptr,
+			0, nullptr,
+			static_cast<uint32_t>(batch.imageBarriers.size()), batch.imageBarriers.data());
+	}
+
+	void RenderGraph::Execute(VkCommandBuffer commandBuffer)
+	{
+		CPU_ZONE("RenderGraph::Execute");
+
+		if (dirty)
+		{
+			Compile();
+		}
+
+		for (Level& level : levels)
+		{
+			RecordBarriers(commandBuffer, level.barriers);
+
+			for (uint32_t pass : level.passes)
+			{
+				if (profiler != nullptr)
+				{
+					profiler->BeginScope(commandBuffer, passes[pass].name);
+				}
+
+				passes[pass].execute(commandBuffer);
+
+				if (profiler != nullptr)
+				{
+					profiler->EndScope(commandBuffer);
+				}
+			}
+		}
+
+		RecordBarriers(commandBuffer, finalBarriers);
+	}
+
+	RenderGraphStatistics RenderGraph::Statistics() const noexcept
+	{
+		RenderGraphStatistics statistics
+		{
+			.passCount = static_cast<uint32_t>(passes.size()),
+			.culledPassCount = culledPassCount,
+			.levelCount = static_cast<uint32_t>(levels.size()),
+			.barrierCount = finalBarriers.Empty() ? 0u : 1u,
+			.imageBarrierCount = static_cast<uint32_t>(finalBarriers.imageBarriers.size()),
+			.compileCount = compileCount,
+			.transientImageCount = 0,
+			.lazyImageCount = 0,
+			.dedicatedBytes = 0,
+			.residentBytes = aliasedBytes,
+			.lazyBytes = 0,
+			.vmaAllocatedBytes = vmaAllocatedBytes,
+			.vmaDeviceMemoryBytes = vmaDeviceMemoryBytes
+		};
+
+		for (const Resource& transient : resources)
+		{
+			if (transient.transient && transient.image != VK_NULL_HANDLE)
+			{
+				++statistics.transientImageCount;
+				statistics.lazyImageCount += transient.lazy ? 1 : 0;
+				statistics.dedicatedBytes += transient.memorySize;
+				statistics.lazyBytes += transient.lazy ? transient.memorySize : 0;
+				statistics.residentBytes += transient.lazy || transient.aliased ? 0 : transient.memorySize;
+			}
+		}
+
+		for (const Level& level : levels)
+		{
+			statistics.barrierCount += level.barriers.Empty() ? 0 : 1;
+			statistics.imageBarrierCount += static_cast<uint32_t>(level.barriers.imageBarriers.size());
+		}
+
+		return statistics;
+	}
+}
@@ -1,5 +1,6 @@
 #include <Graphics/Swapchain.h>
 #include <GPU/GPUContext.h>
+#include <Utils/CpuProfiler.h>
 
 #include <assert.h>
 #include <cstdlib>
@@ -140,6 +141,8 @@ namespace cof
 
 	const uint32_t Swapchain::AcquireNextImage(uint64_t timeout, VkSemaphore semaphore, VkFence fence)
 	{
+		CPU_ZONE("Swapchain::AcquireNextImage");
+
 		uint32_t imageIndex;
 		VkResult spawchainStatus = vkAcquireNextImageKHR(parent, handle, timeout, semaphore, fence, &imageIndex);
 		switch (spawchainStatus) //TODO handle different cases
@@ -159,4 +162,40 @@ namespace cof
 
 		return imageIndex;
 	}
+
+	uint32_t Swapchain::AcquireNextImage(VkSemaphore acquireSemaphore)
+	{
+		return AcquireNextImage(std::numeric_limits<uint64_t>::max(), acquireSemaphore, VK_NULL_HANDLE);
+	}
+
+	void Swapchain::Present(VkQueue queue, VkSemaphore renderingFinishedSemaphore, uint32_t imageIndex)
+	{
+		CPU_ZONE("Swapchain::Present");
+
+		VkPresentInfoKHR presentInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
+			.waitSemaphoreCount = 1,
+			.pWaitSemaphores = &renderingFinishedSemaphore,
+			.swapchainCount = 1,
+			.pSwapchains = &handle,
+			.pImageIndices = &imageIndex
+		};
+
+		[[maybe_unused]] VkResult errorCode = vkQueuePresentKHR(queue, &presentInfo);
+		switch (errorCode) //TODO handle different cases, like AcquireNextImage
+		{
+		case VK_SUCCESS:
+			break;
+		case VK_SUBOPTIMAL_KHR:
+			assert(false);
+			break;
+		case VK_ERROR_OUT_OF_DATE_KHR:
+			assert(false);
+			break;
+		default:
+			assert(errorCode == VK_SUCCESS);
+			break;
+		}
+	}
 }
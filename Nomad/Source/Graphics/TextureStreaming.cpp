@@ -0,0 +1,964 @@
+#include "Graphics/TextureStreaming.h"
+#include "Graphics/VertexLayout.h"
+#include "GPU/Shader.h"
+#include "Utils/CpuProfiler.h"
+
+#include <vulkan/vulkan_core.h>
+
+#include <algorithm>
+#include <assert.h>
+#include <cmath>
+#include <cstdio>
+#include <utility>
+
+namespace cof
+{
+	//Matches FeedbackConstants in TextureFeedback.glsl
+	struct FeedbackConstants
+	{
+		glm::mat4 viewProjection;
+		uint32_t drawIndex;
+	};
+
+	static std::vector<VkSubpassDescription> FeedbackSubpasses()
+	{
+		//No attachments, the fragment shader only writes the feedback buffer
+		return { VkSubpassDescription{ .pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS } };
+	}
+
+	static VkExtent2D MipExtent(VkExtent2D extent, uint32_t mipLevel) noexcept
+	{
+		return { std::max(extent.width >> mipLevel, 1u), std::max(extent.height >> mipLevel, 1u) };
+	}
+
+	TextureFeedbackPass::TextureFeedbackPass(const VkDevice device, VmaAllocator allocator, const Shaders& shaders, VkExtent2D screenExtent, uint32_t feedbackMaterialCount)
+		: renderPass{ device, {}, FeedbackSubpasses(), {} }
+		, extent{ std::max(screenExtent.width / feedbackDivisor, 1u), std::max(screenExtent.height / feedbackDivisor, 1u) }
+		, requests(feedbackMaterialCount, noRequest)
+		, materialCount{ feedbackMaterialCount }
+		, parent{ device }
+		, memoryAllocator{ allocator }
+	{
+		[[maybe_unused]] VkResult errorCode{ VK_RESULT_MAX_ENUM };
+
+		VkFramebufferCreateInfo framebufferInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
+			.renderPass = renderPass.Handle(),
+			.attachmentCount = 0,
+			.width = extent.width,
+			.height = extent.height,
+			.layers = 1
+		};
+
+		errorCode = vkCreateFramebuffer(device, &framebufferInfo, nullptr, &framebuffer);
+		assert(errorCode == VK_SUCCESS);
+
+		std::array bindings
+		{
+			VkDescriptorSetLayoutBinding{ .binding = 0, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_VERTEX_BIT },
+			VkDescriptorSetLayoutBinding{ .binding = 1, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT }
+		};
+
+		VkDescriptorSetLayoutCreateInfo descriptorSetLayoutInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+			.bindingCount = static_cast<uint32_t>(bindings.size()),
+			.pBindings = bindings.data()
+		};
+
+		errorCode = vkCreateDescriptorSetLayout(device, &descriptorSetLayoutInfo, nullptr, &descriptorSetLayout);
+		assert(errorCode == VK_SUCCESS);
+
+		VkPushConstantRange pushConstantRange
+		{
+			.stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+			.offset = 0,
+			.size = sizeof(FeedbackConstants)
+		};
+
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+			.setLayoutCount = 1,
+			.pSetLayouts = &descriptorSetLayout,
+			.pushConstantRangeCount = 1,
+			.pPushConstantRanges = &pushConstantRange
+		};
+
+		errorCode = vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout);
+		assert(errorCode == VK_SUCCESS);
+
+		std::array shaderStages
+		{
+			VkPipelineShaderStageCreateInfo
+			{
+				.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+				.stage = VK_SHADER_STAGE_VERTEX_BIT,
+				.module = shaders.vertex.Handle(),
+				.pName = "main"
+			},
+			VkPipelineShaderStageCreateInfo
+			{
+				.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+				.stage = VK_SHADER_STAGE_FRAGMENT_BIT,
+				.module = shaders.fragment.Handle(),
+				.pName = "main"
+			}
+		};
+
+		VkPipelineInputAssemblyStateCreateInfo inputAssembly
+		{
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
+			.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+			.primitiveRestartEnable = VK_FALSE
+		};
+
+		VkViewport viewport
+		{
+			.x = 0.0f,
+			.y = 0.0f,
+			.width = static_cast<float>(extent.width),
+			.height = static_cast<float>(extent.height),
+			.minDepth = 0.0f,
+			.maxDepth = 1.0f
+		};
+
+		VkRect2D scissor
+		{
+			.offset = { 0, 0 },
+			.extent = extent
+		};
+
+		VkPipelineViewportStateCreateInfo viewportState
+		{
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
+			.viewportCount = 1,
+			.pViewports = &viewport,
+			.scissorCount = 1,
+			.pScissors = &scissor
+		};
+
+		VkPipelineRasterizationStateCreateInfo rasterizer
+		{
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
+			.depthClampEnable = VK_FALSE,
+			.rasterizerDiscardEnable = VK_FALSE,
+			.polygonMode = VK_POLYGON_MODE_FILL,
+			.cullMode = VK_CULL_MODE_BACK_BIT,
+			.frontFace = VK_FRONT_FACE_CLOCKWISE,
+			.depthBiasEnable = VK_FALSE,
+			.lineWidth = 1.0f
+		};
+
+		VkPipelineMultisampleStateCreateInfo multisampling
+		{
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
+			.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT
+		};
+
+		VkPipelineColorBlendStateCreateInfo blending
+		{
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
+			.logicOpEnable = VK_FALSE,
+			.attachmentCount = 0
+		};
+
+		VkGraphicsPipelineCreateInfo pipelineInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+			.stageCount = static_cast<uint32_t>(shaderStages.size()),
+			.pStages = shaderStages.data(),
+			.pVertexInputState = &pulledVertexInputState,
+			.pInputAssemblyState = &inputAssembly,
+			.pViewportState = &viewportState,
+			.pRasterizationState = &rasterizer,
+			.pMultisampleState = &multisampling,
+			.pColorBlendState = &blending,
+			.layout = pipelineLayout,
+			.renderPass = renderPass.Handle(),
+			.subpass = 0
+		};
+
+		errorCode = vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline);
+		assert(errorCode == VK_SUCCESS);
+
+		VkDescriptorPoolSize poolSize{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2 };
+
+		VkDescriptorPoolCreateInfo descriptorPoolInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+			.maxSets = 1,
+			.poolSizeCount = 1,
+			.pPoolSizes = &poolSize
+		};
+
+		errorCode = vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool);
+		assert(errorCode == VK_SUCCESS);
+
+		VkDescriptorSetAllocateInfo descriptorSetInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+			.descriptorPool = descriptorPool,
+			.descriptorSetCount = 1,
+			.pSetLayouts = &descriptorSetLayout
+		};
+
+		errorCode = vkAllocateDescriptorSets(device, &descriptorSetInfo, &descriptorSet);
+		assert(errorCode == VK_SUCCESS);
+
+		const VkDeviceSize feedbackSize{ sizeof(uint32_t) * static_cast<VkDeviceSize>(materialCount) };
+
+		VkBufferCreateInfo feedbackBufferInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+			.size = feedbackSize,
+			.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			.sharingMode = VK_SHARING_MODE_EXCLUSIVE
+		};
+
+		VmaAllocationCreateInfo feedbackAllocInfo{ .usage = VMA_MEMORY_USAGE_GPU_ONLY };
+
+		errorCode = vmaCreateBuffer(memoryAllocator, &feedbackBufferInfo, &feedbackAllocInfo, &feedbackBuffer, &feedbackAllocation, nullptr);
+		assert(errorCode == VK_SUCCESS);
+
+		VkBufferCreateInfo readbackBufferInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+			.size = feedbackSize,
+			.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			.sharingMode = VK_SHARING_MODE_EXCLUSIVE
+		};
+
+		VmaAllocationCreateInfo readbackAllocInfo
+		{
+			.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT,
+			.usage = VMA_MEMORY_USAGE_GPU_TO_CPU
+		};
+
+		for (size_t slot{}; slot < readbackBuffers.size(); ++slot)
+		{
+			VmaAllocationInfo readbackAllocationInfo;
+			errorCode = vmaCreateBuffer(memoryAllocator, &readbackBufferInfo, &readbackAllocInfo, &readbackBuffers[slot], &readbackAllocations[slot], &readbackAllocationInfo);
+			assert(errorCode == VK_SUCCESS);
+			readbackData[slot] = static_cast<const uint32_t*>(readbackAllocationInfo.pMappedData);
+		}
+
+		VkDescriptorBufferInfo feedbackBufferDescriptor{ feedbackBuffer, 0, VK_WHOLE_SIZE };
+
+		VkWriteDescriptorSet descriptorWrite
+		{
+			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			.dstSet = descriptorSet,
+			.dstBinding = 1,
+			.descriptorCount = 1,
+			.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			.pBufferInfo = &feedbackBufferDescriptor
+		};
+
+		vkUpdateDescriptorSets(device, 1, &descriptorWrite, 0, nullptr);
+	}
+
+	TextureFeedbackPass::~TextureFeedbackPass()
+	{
+		for (size_t slot{}; slot < readbackBuffers.size(); ++slot)
+		{
+			vmaDestroyBuffer(memoryAllocator, readbackBuffers[slot], readbackAllocations[slot]);
+		}
+		vmaDestroyBuffer(memoryAllocator, feedbackBuffer, feedbackAllocation);
+
+		vkDestroyDescriptorPool(parent, descriptorPool, nullptr);
+		vkDestroyPipeline(parent, pipeline, nullptr);
+		vkDestroyPipelineLayout(parent, pipelineLayout, nullptr);
+		vkDestroyDescriptorSetLayout(parent, descriptorSetLayout, nullptr);
+		vkDestroyFramebuffer(parent, framebuffer, nullptr);
+	}
+
+	void TextureFeedbackPass::BindScene(VkBuffer drawBuffer)
+	{
+		VkDescriptorBufferInfo drawBufferInfo{ drawBuffer, 0, VK_WHOLE_SIZE };
+
+		VkWriteDescriptorSet descriptorWrite
+		{
+			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			.dstSet = descriptorSet,
+			.dstBinding = 0,
+			.descriptorCount = 1,
+			.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			.pBufferInfo = &drawBufferInfo
+		};
+
+		vkUpdateDescriptorSets(parent, 1, &descriptorWrite, 0, nullptr);
+	}
+
+	void TextureFeedbackPass::Record(VkCommandBuffer commandBuffer, VkBuffer indexBuffer, const std::vector<VisibilityDraw>& draws, const glm::mat4& viewProjection)
+	{
+		const VkDeviceSize feedbackSize{ sizeof(uint32_t) * static_cast<VkDeviceSize>(materialCount) };
+		const size_t slot{ recordCount % readbackBuffers.size() };
+
+		auto feedbackBarrier = [this, feedbackSize](VkAccessFlags srcAccess, VkAccessFlags dstAccess)
+		{
+			return VkBufferMemoryBarrier
+			{
+				.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+				.srcAccessMask = srcAccess,
+				.dstAccessMask = dstAccess,
+				.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				.buffer = feedbackBuffer,
+				.offset = 0,
+				.size = feedbackSize
+			};
+		};
+
+		//The previous frame's copy has to be done reading before the reset
+		VkBufferMemoryBarrier resetBarrier{ feedbackBarrier(0, VK_ACCESS_TRANSFER_WRITE_BIT) };
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 1, &resetBarrier, 0, nullptr);
+		vkCmdFillBuffer(commandBuffer, feedbackBuffer, 0, feedbackSize, noFeedback);
+
+		VkBufferMemoryBarrier writeBarrier{ feedbackBarrier(VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT) };
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 1, &writeBarrier, 0, nullptr);
+
+		VkRenderPassBeginInfo renderPassInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+			.renderPass = renderPass.Handle(),
+			.framebuffer = framebuffer,
+			.renderArea = { { 0, 0 }, extent }
+		};
+
+		FeedbackConstants constants{ .viewProjection = viewProjection };
+
+		vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+		vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+
+		for (uint32_t drawIndex{}; drawIndex < draws.size(); ++drawIndex)
+		{
+			constants.drawIndex = drawIndex;
+			vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(FeedbackConstants), &constants);
+			vkCmdDrawIndexed(commandBuffer, draws[drawIndex].indexCount, 1, draws[drawIndex].firstIndex, 0, 0);
+		}
+
+		vkCmdEndRenderPass(commandBuffer);
+
+		VkBufferMemoryBarrier copyBarrier{ feedbackBarrier(VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT) };
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 1, &copyBarrier, 0, nullptr);
+
+		VkBufferCopy region{ .srcOffset = 0, .dstOffset = 0, .size = feedbackSize };
+		vkCmdCopyBuffer(commandBuffer, feedbackBuffer, readbackBuffers[slot], 1, &region);
+
+		VkBufferMemoryBarrier hostBarrier
+		{
+			.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+			.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+			.dstAccessMask = VK_ACCESS_HOST_READ_BIT,
+			.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+			.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+			.buffer = readbackBuffers[slot],
+			.offset = 0,
+			.size = feedbackSize
+		};
+
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &hostBarrier, 0, nullptr);
+		++recordCount;
+	}
+
+	const std::vector<float>& TextureFeedbackPass::Requests()
+	{
+		if (recordCount <= readbackLatency)
+		{
+			return requests;
+		}
+
+		//Requests stay as they are when no frame was recorded since the last call
+		const uint64_t readRecord{ recordCount - 1 - readbackLatency };
+		if (readCount == readRecord + 1)
+		{
+			return requests;
+		}
+
+		const size_t slot{ readRecord % readbackBuffers.size() };
+		vmaInvalidateAllocation(memoryAllocator, readbackAllocations[slot], 0, VK_WHOLE_SIZE);
+
+		//Rendering at a fraction of the resolution scales the derivatives up by feedbackDivisor
+		const float resolutionBias{ std::log2(static_cast<float>(feedbackDivisor)) };
+		for (uint32_t material{}; material < materialCount; ++material)
+		{
+			const uint32_t request{ readbackData[slot][material] };
+			requests[material] = request == noFeedback ? noRequest : static_cast<float>(request) / lodScale - lodOffset - resolutionBias;
+		}
+
+		readCount = readRecord + 1;
+		return requests;
+	}
+
+	void TextureStreamingStatistics::Print() const
+	{
+		constexpr double megabyte{ 1024.0 * 1024.0 };
+
+		printf("%u textures, %u streaming, %.1f / %.1f MiB resident of %.1f MiB fully resident, %.1f MiB streamed in, %u evictions\n",
+			textureCount, streamingCount, static_cast<double>(residentBytes) / megabyte, static_cast<double>(budgetBytes) / megabyte,
+			static_cast<double>(fullBytes) / megabyte, static_cast<double>(streamedInBytes) / megabyte, evictionCount);
+	}
+
+	TextureStreamer::TextureStreamer(const VkDevice device, VmaAllocator allocator, UploadStreamer& uploadStreamer, uint32_t textureCapacity, VkDeviceSize budgetBytes)
+		: uploads{ uploadStreamer }
+		, maxTextureCount{ textureCapacity }
+		, budget{ budgetBytes }
+		, parent{ device }
+		, memoryAllocator{ allocator }
+	{
+		[[maybe_unused]] VkResult errorCode{ VK_RESULT_MAX_ENUM };
+
+		VkSamplerCreateInfo samplerInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+			.magFilter = VK_FILTER_LINEAR,
+			.minFilter = VK_FILTER_LINEAR,
+			.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR,
+			.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT,
+			.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT,
+			.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT,
+			.minLod = 0.0f,
+			.maxLod = VK_LOD_CLAMP_NONE
+		};
+
+		errorCode = vkCreateSampler(device, &samplerInfo, nullptr, &sampler);
+		assert(errorCode == VK_SUCCESS);
+
+		VkDescriptorSetLayoutBinding binding
+		{
+			.binding = 0,
+			.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+			.descriptorCount = maxTextureCount,
+			.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT
+		};
+
+		//Slots of textures that were never written may stay empty as long as no draw samples them
+		const VkDescriptorBindingFlags bindingFlags{ VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT };
+
+		VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO,
+			.bindingCount = 1,
+			.pBindingFlags = &bindingFlags
+		};
+
+		VkDescriptorSetLayoutCreateInfo descriptorSetLayoutInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+			.pNext = &bindingFlagsInfo,
+			.bindingCount = 1,
+			.pBindings = &binding
+		};
+
+		errorCode = vkCreateDescriptorSetLayout(device, &descriptorSetLayoutInfo, nullptr, &descriptorSetLayout);
+		assert(errorCode == VK_SUCCESS);
+
+		VkDescriptorPoolSize poolSize{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, maxTextureCount * descriptorSetCount };
+
+		VkDescriptorPoolCreateInfo descriptorPoolInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+			.maxSets = descriptorSetCount,
+			.poolSizeCount = 1,
+			.pPoolSizes = &poolSize
+		};
+
+		errorCode = vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool);
+		assert(errorCode == VK_SUCCESS);
+
+		std::array<VkDescriptorSetLayout, descriptorSetCount> setLayouts;
+		setLayouts.fill(descriptorSetLayout);
+
+		VkDescriptorSetAllocateInfo descriptorSetInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+			.descriptorPool = descriptorPool,
+			.descriptorSetCount = descriptorSetCount,
+			.pSetLayouts = setLayouts.data()
+		};
+
+		errorCode = vkAllocateDescriptorSets(device, &descriptorSetInfo, descriptorSets.data());
+		assert(errorCode == VK_SUCCESS);
+
+		textures.reserve(maxTextureCount);
+		streamingThread = std::thread{ &TextureStreamer::LoadMips, this };
+	}
+
+	TextureStreamer::~TextureStreamer()
+	{
+		{
+			std::lock_guard lock{ mutex };
+			stopping = true;
+		}
+		wake.notify_all();
+		streamingThread.join();
+
+		auto destroy = [this](MipImage& image)
+		{
+			if (image.view != VK_NULL_HANDLE)
+			{
+				vkDestroyImageView(parent, image.view, nullptr);
+			}
+			if (image.image != VK_NULL_HANDLE)
+			{
+				vmaDestroyImage(memoryAllocator, image.image, image.allocation);
+			}
+		};
+
+		for (RetiredImage& retired : retiredImages)
+		{
+			destroy(retired.image);
+		}
+		for (Texture& texture : textures)
+		{
+			destroy(texture.pending);
+			destroy(texture.current);
+		}
+
+		vkDestroyDescriptorPool(parent, descriptorPool, nullptr);
+		vkDestroyDescriptorSetLayout(parent, descriptorSetLayout, nullptr);
+		vkDestroySampler(parent, sampler, nullptr);
+	}
+
+	uint32_t TextureStreamer::AddTexture(StreamedTextureInfo info)
+	{
+		assert(textures.size() < maxTextureCount);
+		assert(info.mipCount > 0);
+
+		uint32_t tailMip{ 0 };
+		while (tailMip + 1 < info.mipCount)
+		{
+			const VkExtent2D mipExtent{ MipExtent(info.extent, tailMip) };
+			if (std::max(mipExtent.width, mipExtent.height) <= tailExtent)
+			{
+				break;
+			}
+			++tailMip;
+		}
+
+		MipImage fullImage{ CreateMipImage(info, 0) };
+		fullBytes += fullImage.bytes;
+		vkDestroyImage(parent, fullImage.image, nullptr);
+
+		MipImage tailImage{ CreateMipImage(info, tailMip) };
+		const VkDeviceSize tailBytes{ tailImage.bytes };
+		vkDestroyImage(parent, tailImage.image, nullptr);
+
+		const uint32_t textureIndex{ static_cast<uint32_t>(textures.size()) };
+		const uint32_t mipCount{ info.mipCount };
+		textures.push_back(Texture
+		{
+			.info = std::move(info),
+			.tailMip = tailMip,
+			.tailBytes = tailBytes,
+			.current = {},
+			.viewMip = mipCount,
+			.pending = {},
+			.tickets = {},
+			.requestedMip = tailMip,
+			.lastRequestFrame = frame
+		});
+
+		StartStreaming(textureIndex, tailMip, UploadPriority::Prefetch, true);
+		return textureIndex;
+	}
+
+	void TextureStreamer::Update(const std::vector<float>& requests)
+	{
+		CPU_ZONE("TextureStreamer::Update");
+
+		++frame;
+
+		std::erase_if(retiredImages, [this](RetiredImage& retired)
+		{
+			if (frame - retired.frame < retireLatency)
+			{
+				return false;
+			}
+
+			if (retired.image.view != VK_NULL_HANDLE)
+			{
+				vkDestroyImageView(parent, retired.image.view, nullptr);
+			}
+			if (retired.image.image != VK_NULL_HANDLE)
+			{
+				vmaDestroyImage(memoryAllocator, retired.image.image, retired.image.allocation);
+			}
+			return true;
+		});
+
+		EnqueueLoadedMips();
+		for (uint32_t textureIndex{}; textureIndex < textures.size(); ++textureIndex)
+		{
+			Progress(textureIndex);
+		}
+		WriteDescriptors();
+
+		//The request is the LOD of a single texel texture, a texture with 2^n texels on a side samples n mips finer
+		std::vector<uint32_t> candidates;
+		for (uint32_t textureIndex{}; textureIndex < textures.size(); ++textureIndex)
+		{
+			Texture& texture{ textures[textureIndex] };
+			const uint32_t material{ texture.info.materialIndex };
+			if (material >= requests.size() || requests[material] >= TextureFeedbackPass::noRequest)
+			{
+				continue;
+			}
+
+			const float maxSide{ static_cast<float>(std::max(texture.info.extent.width, texture.info.extent.height)) };
+			const float mip{ std::floor(std::log2(maxSide) + requests[material]) };
+			texture.requestedMip = static_cast<uint32_t>(std::clamp(mip, 0.0f, static_cast<float>(texture.tailMip)));
+			texture.lastRequestFrame = frame;
+
+			//Textures still filling in finish first, a new image would throw their uploads away
+			if (texture.requestedMip < texture.current.baseMip && texture.pending.image == VK_NULL_HANDLE && texture.tickets.empty())
+			{
+				candidates.push_back(textureIndex);
+			}
+		}
+
+		//The most blurry textures first, they get the budget when it runs short
+		std::sort(candidates.begin(), candidates.end(), [this](uint32_t a, uint32_t b)
+		{
+			const Texture& textureA{ textures[a] };
+			const Texture& textureB{ textures[b] };
+			return textureA.current.baseMip - textureA.requestedMip > textureB.current.baseMip - textureB.requestedMip;
+		});
+
+		//When the requested mip doesn't fit, a coarser one still sharpens the texture
+		for (uint32_t textureIndex : candidates)
+		{
+			const Texture& texture{ textures[textureIndex] };
+			for (uint32_t baseMip{ texture.requestedMip }; baseMip < texture.current.baseMip; ++baseMip)
+			{
+				if (StartStreaming(textureIndex, baseMip, UploadPriority::Visible, false))
+				{
+					break;
+				}
+			}
+		}
+	}
+
+	TextureStreamingStatistics TextureStreamer::Statistics() const noexcept
+	{
+		const uint32_t streamingCount{ static_cast<uint32_t>(std::count_if(textures.begin(), textures.end(), [](const Texture& texture)
+		{
+			return texture.pending.image != VK_NULL_HANDLE || !texture.tickets.empty();
+		})) };
+
+		return TextureStreamingStatistics
+		{
+			.textureCount = static_cast<uint32_t>(textures.size()),
+			.streamingCount = streamingCount,
+			.residentBytes = residentBytes,
+			.budgetBytes = budget,
+			.fullBytes = fullBytes,
+			.streamedInBytes = streamedInBytes,
+			.evictionCount = evictionCount
+		};
+	}
+
+	bool TextureStreamer::StartStreaming(uint32_t textureIndex, uint32_t baseMip, UploadPriority priority, bool mayExceedBudget)
+	{
+		MipImage image{ CreateMipImage(textures[textureIndex].info, baseMip) };
+
+		//Images being replaced count as gone, their memory is freed as soon as their replacements arrive
+		const VkDeviceSize needed{ residentBytes - releasingBytes + image.bytes };
+		if (!mayExceedBudget && needed > budget && !EvictFor(needed - budget, textureIndex))
+		{
+			vkDestroyImage(parent, image.image, nullptr);
+			return false;
+		}
+
+		VmaAllocationCreateInfo allocInfo{ .usage = VMA_MEMORY_USAGE_GPU_ONLY };
+
+		[[maybe_unused]] VkResult errorCode = vmaAllocateMemoryForImage(memoryAllocator, image.image, &allocInfo, &image.allocation, nullptr);
+		assert(errorCode == VK_SUCCESS);
+		errorCode = vmaBindImageMemory(memoryAllocator, image.allocation, image.image);
+		assert(errorCode == VK_SUCCESS);
+
+		Texture& texture{ textures[textureIndex] };
+		residentBytes += image.bytes;
+		releasingBytes += texture.current.bytes;
+
+		//Coarse to fine, so the view can follow the data as it arrives. Visible loads overtake prefetches
+		texture.tickets.assign(texture.info.mipCount - baseMip, noTicket);
+		{
+			std::lock_guard lock{ mutex };
+			for (uint32_t mip{ texture.info.mipCount }; mip-- > baseMip;)
+			{
+				loadQueue.push_back(MipLoad{ .textureIndex = textureIndex, .mip = mip, .priority = priority });
+			}
+			std::stable_sort(loadQueue.begin(), loadQueue.end(), [](const MipLoad& a, const MipLoad& b)
+			{
+				return a.priority < b.priority;
+			});
+		}
+		wake.notify_one();
+
+		texture.pending = image;
+		return true;
+	}
+
+	void TextureStreamer::EnqueueLoadedMips()
+	{
+		std::vector<LoadedMip> mips;
+		{
+			std::lock_guard lock{ mutex };
+			mips.swap(loadedMips);
+		}
+
+		//A texture only streams into a new image once every mip of the last one arrived, so the loads always belong to
+		//the image being filled
+		for (LoadedMip& loaded : mips)
+		{
+			Texture& texture{ textures[loaded.load.textureIndex] };
+			const MipImage& image{ texture.pending.image != VK_NULL_HANDLE ? texture.pending : texture.current };
+			const uint32_t level{ loaded.load.mip - image.baseMip };
+			assert(loaded.load.mip >= image.baseMip && texture.tickets[level] == noTicket);
+
+			const VkExtent2D mipExtent{ MipExtent(texture.info.extent, loaded.load.mip) };
+			streamedInBytes += loaded.texels.size();
+
+			texture.tickets[level] = uploads.Enqueue(ImageUpload
+			{
+				.image = image.image,
+				.subresource = { VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1 },
+				.offset = { 0, 0, 0 },
+				.extent = { mipExtent.width, mipExtent.height, 1 },
+				.data = std::move(loaded.texels),
+				.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+				.dstAccess = VK_ACCESS_SHADER_READ_BIT
+			}, loaded.load.priority);
+		}
+	}
+
+	void TextureStreamer::LoadMips()
+	{
+		SetCpuThreadName("Texture streaming");
+
+		while (true)
+		{
+			MipLoad load;
+			{
+				std::unique_lock lock{ mutex };
+				wake.wait(lock, [this] { return stopping || !loadQueue.empty(); });
+				if (stopping)
+				{
+					return;
+				}
+
+				load = loadQueue.front();
+				loadQueue.pop_front();
+			}
+
+			std::vector<std::byte> texels;
+			{
+				CPU_ZONE("TextureStreamer::LoadMip");
+				texels = textures[load.textureIndex].info.loadMip(load.mip);
+			}
+
+			std::lock_guard lock{ mutex };
+			loadedMips.push_back(LoadedMip{ load, std::move(texels) });
+		}
+	}
+
+	void TextureStreamer::Progress(uint32_t textureIndex)
+	{
+		Texture& texture{ textures[textureIndex] };
+		if (texture.tickets.empty())
+		{
+			return;
+		}
+
+		const bool hasPending{ texture.pending.image != VK_NULL_HANDLE };
+		const uint32_t baseMip{ hasPending ? texture.pending.baseMip : texture.current.baseMip };
+
+		uint32_t arrivedMip{ texture.info.mipCount };
+		while (arrivedMip > baseMip && uploads.Completed(texture.tickets[arrivedMip - 1 - baseMip]))
+		{
+			--arrivedMip;
+		}
+
+		if (arrivedMip == texture.info.mipCount)
+		{
+			return;
+		}
+
+		if (hasPending)
+		{
+			//The old image stays in use until the new one is at least as sharp, or complete when it's an eviction
+			if (arrivedMip > texture.viewMip && arrivedMip != baseMip)
+			{
+				return;
+			}
+
+			releasingBytes -= texture.current.bytes;
+			Retire(texture.current);
+			texture.current = std::exchange(texture.pending, MipImage{});
+		}
+		else if (arrivedMip >= texture.viewMip)
+		{
+			return;
+		}
+		else
+		{
+			MipImage oldView{ .view = texture.current.view };
+			Retire(oldView);
+		}
+
+		texture.viewMip = arrivedMip;
+		texture.current.view = CreateView(texture.current, texture.info, texture.viewMip);
+
+		if (arrivedMip == baseMip)
+		{
+			texture.tickets.clear();
+		}
+	}
+
+	TextureStreamer::MipImage TextureStreamer::CreateMipImage(const StreamedTextureInfo& info, uint32_t baseMip) const
+	{
+		const VkExtent2D baseExtent{ MipExtent(info.extent, baseMip) };
+
+		VkImageCreateInfo imageInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+			.imageType = VK_IMAGE_TYPE_2D,
+			.format = info.format,
+			.extent = { baseExtent.width, baseExtent.height, 1 },
+			.mipLevels = info.mipCount - baseMip,
+			.arrayLayers = 1,
+			.samples = VK_SAMPLE_COUNT_1_BIT,
+			.tiling = VK_IMAGE_TILING_OPTIMAL,
+			.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+			.sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+			.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED
+		};
+
+		MipImage image{ .baseMip = baseMip };
+		[[maybe_unused]] VkResult errorCode = vkCreateImage(parent, &imageInfo, nullptr, &image.image);
+		assert(errorCode == VK_SUCCESS);
+
+		VkMemoryRequirements memoryRequirements;
+		vkGetImageMemoryRequirements(parent, image.image, &memoryRequirements);
+		image.bytes = memoryRequirements.size;
+		return image;
+	}
+
+	VkImageView TextureStreamer::CreateView(const MipImage& image, const StreamedTextureInfo& info, uint32_t viewMip) const
+	{
+		//The base mip keeps sampling away from levels whose data hasn't arrived
+		VkImageViewCreateInfo viewInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+			.image = image.image,
+			.viewType = VK_IMAGE_VIEW_TYPE_2D,
+			.format = info.format,
+			.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, viewMip - image.baseMip, VK_REMAINING_MIP_LEVELS, 0, 1 }
+		};
+
+		VkImageView view;
+		[[maybe_unused]] VkResult errorCode = vkCreateImageView(parent, &viewInfo, nullptr, &view);
+		assert(errorCode == VK_SUCCESS);
+		return view;
+	}
+
+	void TextureStreamer::WriteDescriptors()
+	{
+		std::vector<VkImageView>& views{ writtenViews[frame % descriptorSetCount] };
+		views.resize(textures.size(), VK_NULL_HANDLE);
+
+		//Reserved up front, the writes point into it
+		std::vector<VkDescriptorImageInfo> imageInfos;
+		imageInfos.reserve(textures.size());
+		std::vector<VkWriteDescriptorSet> descriptorWrites;
+		for (uint32_t textureIndex{}; textureIndex < textures.size(); ++textureIndex)
+		{
+			const VkImageView view{ textures[textureIndex].current.view };
+			if (view == views[textureIndex])
+			{
+				continue;
+			}
+			views[textureIndex] = view;
+
+			imageInfos.push_back(VkDescriptorImageInfo
+			{
+				.sampler = sampler,
+				.imageView = view,
+				.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+			});
+
+			descriptorWrites.push_back(VkWriteDescriptorSet
+			{
+				.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+				.dstSet = DescriptorSet(),
+				.dstBinding = 0,
+				.dstArrayElement = textureIndex,
+				.descriptorCount = 1,
+				.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+				.pImageInfo = &imageInfos.back()
+			});
+		}
+
+		if (!descriptorWrites.empty())
+		{
+			vkUpdateDescriptorSets(parent, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+		}
+	}
+
+	void TextureStreamer::Retire(MipImage& image)
+	{
+		if (image.image != VK_NULL_HANDLE || image.view != VK_NULL_HANDLE)
+		{
+			retiredImages.push_back(RetiredImage{ .image = image, .frame = frame });
+		}
+		residentBytes -= image.bytes;
+		image = MipImage{};
+	}
+
+	bool TextureStreamer::EvictFor(VkDeviceSize bytes, uint32_t requester)
+	{
+		//Least recently requested first, textures on screen this frame and textures mid stream are left alone
+		std::vector<uint32_t> victims;
+		for (uint32_t textureIndex{}; textureIndex < textures.size(); ++textureIndex)
+		{
+			const Texture& texture{ textures[textureIndex] };
+			if (textureIndex != requester && texture.lastRequestFrame != frame && texture.current.baseMip < texture.tailMip
+				&& texture.pending.image == VK_NULL_HANDLE && texture.tickets.empty())
+			{
+				victims.push_back(textureIndex);
+			}
+		}
+
+		std::sort(victims.begin(), victims.end(), [this](uint32_t a, uint32_t b)
+		{
+			return textures[a].lastRequestFrame < textures[b].lastRequestFrame;
+		});
+
+		//An eviction swaps the current image for one holding only the tail. Nothing is evicted when even every victim
+		//together frees too little, the sharp images would be thrown away for a request that fails anyway
+		VkDeviceSize freedBytes{ 0 };
+		size_t victimCount{ 0 };
+		while (victimCount < victims.size() && freedBytes < bytes)
+		{
+			const Texture& texture{ textures[victims[victimCount++]] };
+			freedBytes += texture.current.bytes - std::min(texture.tailBytes, texture.current.bytes);
+		}
+		if (freedBytes < bytes)
+		{
+			return false;
+		}
+
+		//The tail is uploaded again into a small image, the large one is freed once it arrived
+		for (size_t victim{}; victim < victimCount; ++victim)
+		{
+			StartStreaming(victims[victim], textures[victims[victim]].tailMip, UploadPriority::Visible, true);
+			++evictionCount;
+		}
+		return true;
+	}
+}
@@ -0,0 +1,173 @@
+#include "Graphics/VertexQuantization.h"
+
+#include <glm/geometric.hpp>
+#include <glm/gtc/packing.hpp>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+
+namespace cof
+{
+	constexpr static float unorm16Max{ 65535.0f };
+	constexpr static float snorm16Max{ 32767.0f };
+	constexpr static float unorm8Max{ 255.0f };
+	constexpr static float radiansToDegrees{ 57.2957795f };
+
+	glm::mat4 QuantizationTransform::Matrix() const noexcept
+	{
+		//The vertex fetch already normalized the positions to [0, 1], so they're scaled by the full extent like DequantizePosition does
+		glm::mat4 matrix{ 1.0f };
+		matrix[0][0] = scale.x * unorm16Max;
+		matrix[1][1] = scale.y * unorm16Max;
+		matrix[2][2] = scale.z * unorm16Max;
+		matrix[3] = glm::vec4{ offset, 1.0f };
+		return matrix;
+	}
+
+	void QuantizationError::Print(const char* label, size_t vertexCount, size_t sourceStride, size_t quantizedStride) const
+	{
+		printf("%s: %zu vertices, %zu -> %zu bytes (%.2fx), max error position %g, color %g, normal %.3f deg, tangent %.3f deg, uv %g\n",
+			label, vertexCount, vertexCount * sourceStride, vertexCount * quantizedStride,
+			static_cast<double>(sourceStride) / static_cast<double>(quantizedStride),
+			position, color, normalDegrees, tangentDegrees, texCoord);
+	}
+
+	static uint16_t QuantizeUnorm16(float value) noexcept
+	{
+		return static_cast<uint16_t>(std::lround(std::clamp(value, 0.0f, 1.0f) * unorm16Max));
+	}
+
+	static int16_t QuantizeSnorm16(float value) noexcept
+	{
+		return static_cast<int16_t>(std::lround(std::clamp(value, -1.0f, 1.0f) * snorm16Max));
+	}
+
+	static uint8_t QuantizeUnorm8(float value) noexcept
+	{
+		return static_cast<uint8_t>(std::lround(std::clamp(value, 0.0f, 1.0f) * unorm8Max));
+	}
+
+	Snorm16x2 EncodeOctahedral(const glm::vec3& unitVector) noexcept
+	{
+		const glm::vec3 octahedron = unitVector / (std::abs(unitVector.x) + std::abs(unitVector.y) + std::abs(unitVector.z));
+
+		float x{ octahedron.x };
+		float y{ octahedron.y };
+
+		//The lower hemisphere folds over the diagonals onto the outer triangles of the square
+		if (octahedron.z < 0.0f)
+		{
+			x = (1.0f - std::abs(octahedron.y)) * (octahedron.x >= 0.0f ? 1.0f : -1.0f);
+			y = (1.0f - std::abs(octahedron.x)) * (octahedron.y >= 0.0f ? 1.0f : -1.0f);
+		}
+
+		return Snorm16x2{ { QuantizeSnorm16(x), QuantizeSnorm16(y) } };
+	}
+
+	glm::vec3 DecodeOctahedral(const Snorm16x2& encoded) noexcept
+	{
+		const float x{ std::max(static_cast<float>(encoded.value[0]) / snorm16Max, -1.0f) };
+		const float y{ std::max(static_cast<float>(encoded.value[1]) / snorm16Max, -1.0f) };
+
+		glm::vec3 unitVector{ x, y, 1.0f - std::abs(x) - std::abs(y) };
+		const float fold{ std::max(-unitVector.z, 0.0f) };
+		unitVector.x += unitVector.x >= 0.0f ? -fold : fold;
+		unitVector.y += unitVector.y >= 0.0f ? -fold : fold;
+
+		return glm::normalize(unitVector);
+	}
+
+	static float AngleDegrees(const glm::vec3& lhs, const glm::vec3& rhs) noexcept
+	{
+		return std::acos(std::clamp(glm::dot(glm::normalize(lhs), rhs), -1.0f, 1.0f)) * radiansToDegrees;
+	}
+
+	template<typename Vertex>
+	static QuantizationTransform ComputeQuantizationTransform(const std::vector<Vertex>& vertices) noexcept
+	{
+		glm::vec3 minimum{ FLT_MAX };
+		glm::vec3 maximum{ -FLT_MAX };
+
+		for (const Vertex& vertex : vertices)
+		{
+			minimum = glm::min(minimum, vertex.position);
+			maximum = glm::max(maximum, vertex.position);
+		}
+
+		if (vertices.empty())
+		{
+			minimum = maximum = glm::vec3{ 0.0f };
+		}
+
+		//Flat axes still need a non-zero scale to divide by
+		const glm::vec3 extent = glm::max(maximum - minimum, glm::vec3{ FLT_MIN });
+		return QuantizationTransform{ .offset = minimum, .scale = extent / unorm16Max };
+	}
+
+	static Unorm16x4 QuantizePosition(const glm::vec3& position, const QuantizationTransform& transform, float w, float& error) noexcept
+	{
+		const glm::vec3 normalized = (position - transform.offset) / (transform.scale * unorm16Max);
+		const Unorm16x4 quantized{ { QuantizeUnorm16(normalized.x), QuantizeUnorm16(normalized.y), QuantizeUnorm16(normalized.z), QuantizeUnorm16(w) } };
+
+		const glm::vec3 decoded = transform.offset + glm::vec3{ static_cast<float>(quantized.value[0]), static_cast<float>(quantized.value[1]), static_cast<float>(quantized.value[2]) } * transform.scale;
+		error = std::max(error, glm::distance(decoded, position));
+		return quantized;
+	}
+
+	std::vector<QuantizedUnlitColoredVertex> QuantizeVertices(const std::vector<UnlitColoredVertex>& vertices, QuantizationTransform& transform, QuantizationError& error)
+	{
+		transform = ComputeQuantizationTransform(vertices);
+		error = QuantizationError{};
+
+		std::vector<QuantizedUnlitColoredVertex> quantized(vertices.size());
+		for (size_t vertex{}; vertex < vertices.size(); ++vertex)
+		{
+			const glm::vec4& color = vertices[vertex].color;
+
+			quantized[vertex] = QuantizedUnlitColoredVertex
+			{
+				.position = QuantizePosition(vertices[vertex].position, transform, 0.0f, error.position),
+				.color = Unorm8x4{ { QuantizeUnorm8(color.x), QuantizeUnorm8(color.y), QuantizeUnorm8(color.z), QuantizeUnorm8(color.w) } }
+			};
+
+			for (uint32_t channel{}; channel < 4; ++channel)
+			{
+				const float decoded{ static_cast<float>(quantized[vertex].color.value[channel]) / unorm8Max };
+				error.color = std::max(error.color, std::abs(decoded - std::clamp(color[channel], 0.0f, 1.0f)));
+			}
+		}
+
+		return quantized;
+	}
+
+	std::vector<QuantizedLitVertex> QuantizeVertices(const std::vector<LitTexturedVertex>& vertices, QuantizationTransform& transform, QuantizationError& error)
+	{
+		transform = ComputeQuantizationTransform(vertices);
+		error = QuantizationError{};
+
+		std::vector<QuantizedLitVertex> quantized(vertices.size());
+		for (size_t vertex{}; vertex < vertices.size(); ++vertex)
+		{
+			const LitTexturedVertex& source = vertices[vertex];
+			const glm::vec3 tangent{ source.tangent };
+
+			quantized[vertex] = QuantizedLitVertex
+			{
+				.position = QuantizePosition(source.position, transform, source.tangent.w < 0.0f ? 0.0f : 1.0f, error.position),
+				.normal = EncodeOctahedral(glm::normalize(source.normal)),
+				.tangent = EncodeOctahedral(glm::normalize(tangent)),
+				.texCoord = Half2{ { glm::packHalf1x16(source.texCoord.x), glm::packHalf1x16(source.texCoord.y) } }
+			};
+
+			error.normalDegrees = std::max(error.normalDegrees, AngleDegrees(source.normal, DecodeOctahedral(quantized[vertex].normal)));
+			error.tangentDegrees = std::max(error.tangentDegrees, AngleDegrees(tangent, DecodeOctahedral(quantized[vertex].tangent)));
+
+			const glm::vec2 decodedTexCoord{ glm::unpackHalf1x16(quantized[vertex].texCoord.value[0]), glm::unpackHalf1x16(quantized[vertex].texCoord.value[1]) };
+			error.texCoord = std::max(error.texCoord, glm::length(decodedTexCoord - source.texCoord));
+		}
+
+		return quantized;
+	}
+}
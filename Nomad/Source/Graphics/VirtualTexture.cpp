@@ -0,0 +1,1146 @@
+#include "Graphics/VirtualTexture.h"
+#include "Graphics/VertexLayout.h"
+#include "GPU/Shader.h"
+#include "Utils/CpuProfiler.h"
+
+#include <vulkan/vulkan_core.h>
+
+#include <algorithm>
+#include <assert.h>
+#include <bit>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include <utility>
+
+namespace cof
+{
+	//Matches FeedbackConstants in TextureFeedback.glsl
+	struct PageFeedbackConstants
+	{
+		glm::mat4 viewProjection;
+		uint32_t drawIndex;
+	};
+
+	//Matches the specialization constants of VirtualTextureFeedback.frag.glsl
+	struct PageFeedbackSpecialization
+	{
+		uint32_t width;
+		float lodBias;
+	};
+
+	constexpr static VkAttachmentReference feedbackDepthReference{ 0, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
+
+	static std::vector<VkAttachmentDescription> PageFeedbackAttachments()
+	{
+		return
+		{
+			VkAttachmentDescription
+			{
+				.format = DepthBuffer::format,
+				.samples = VK_SAMPLE_COUNT_1_BIT,
+				.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+				.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+				.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+				.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+				.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+				.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL
+			}
+		};
+	}
+
+	static std::vector<VkSubpassDescription> PageFeedbackSubpasses()
+	{
+		return
+		{
+			VkSubpassDescription
+			{
+				.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
+				.pDepthStencilAttachment = &feedbackDepthReference
+			}
+		};
+	}
+
+	static std::vector<VkSubpassDependency> PageFeedbackDependencies()
+	{
+		return
+		{
+			//The previous frame's feedback has to be done with the depth buffer before it is cleared
+			VkSubpassDependency
+			{
+				.srcSubpass = VK_SUBPASS_EXTERNAL,
+				.dstSubpass = 0,
+				.srcStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+				.dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+				.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+				.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT
+			}
+		};
+	}
+
+	//Bytes of the whole mip chain of an indirection texture
+	static VkDeviceSize IndirectionBytes(uint32_t pageCount) noexcept
+	{
+		VkDeviceSize bytes{ 0 };
+		for (VkDeviceSize mipPageCount{ pageCount }; mipPageCount > 0; mipPageCount /= 2)
+		{
+			bytes += sizeof(uint32_t) * mipPageCount * mipPageCount;
+		}
+		return bytes;
+	}
+
+	static VkExtent2D FeedbackExtent(VkExtent2D screenExtent) noexcept
+	{
+		const uint32_t divisor{ VirtualTextureFeedbackPass::feedbackDivisor };
+		return { std::max(screenExtent.width / divisor, 1u), std::max(screenExtent.height / divisor, 1u) };
+	}
+
+	VirtualTextureFeedbackPass::VirtualTextureFeedbackPass(const VkDevice device, VmaAllocator allocator, const Shaders& shaders, VkExtent2D screenExtent)
+		: depthBuffer{ device, allocator, FeedbackExtent(screenExtent), VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT }
+		, renderPass{ device, PageFeedbackAttachments(), PageFeedbackSubpasses(), PageFeedbackDependencies() }
+		, extent{ FeedbackExtent(screenExtent) }
+		, parent{ device }
+		, memoryAllocator{ allocator }
+	{
+		[[maybe_unused]] VkResult errorCode{ VK_RESULT_MAX_ENUM };
+
+		VkImageView depthView{ depthBuffer.View() };
+
+		VkFramebufferCreateInfo framebufferInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
+			.renderPass = renderPass.Handle(),
+			.attachmentCount = 1,
+			.pAttachments = &depthView,
+			.width = extent.width,
+			.height = extent.height,
+			.layers = 1
+		};
+
+		errorCode = vkCreateFramebuffer(device, &framebufferInfo, nullptr, &framebuffer);
+		assert(errorCode == VK_SUCCESS);
+
+		std::array bindings
+		{
+			VkDescriptorSetLayoutBinding{ .binding = 0, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_VERTEX_BIT },
+			VkDescriptorSetLayoutBinding{ .binding = 1, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT },
+			VkDescriptorSetLayoutBinding{ .binding = 2, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT }
+		};
+
+		VkDescriptorSetLayoutCreateInfo descriptorSetLayoutInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+			.bindingCount = static_cast<uint32_t>(bindings.size()),
+			.pBindings = bindings.data()
+		};
+
+		errorCode = vkCreateDescriptorSetLayout(device, &descriptorSetLayoutInfo, nullptr, &descriptorSetLayout);
+		assert(errorCode == VK_SUCCESS);
+
+		VkPushConstantRange pushConstantRange
+		{
+			.stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+			.offset = 0,
+			.size = sizeof(PageFeedbackConstants)
+		};
+
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+			.setLayoutCount = 1,
+			.pSetLayouts = &descriptorSetLayout,
+			.pushConstantRangeCount = 1,
+			.pPushConstantRanges = &pushConstantRange
+		};
+
+		errorCode = vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout);
+		assert(errorCode == VK_SUCCESS);
+
+		const PageFeedbackSpecialization specialization
+		{
+			.width = extent.width,
+			.lodBias = std::log2(static_cast<float>(feedbackDivisor))
+		};
+
+		std::array specializationEntries
+		{
+			VkSpecializationMapEntry{ .constantID = 0, .offset = offsetof(PageFeedbackSpecialization, width), .size = sizeof(uint32_t) },
+			VkSpecializationMapEntry{ .constantID = 1, .offset = offsetof(PageFeedbackSpecialization, lodBias), .size = sizeof(float) }
+		};
+
+		VkSpecializationInfo specializationInfo
+		{
+			.mapEntryCount = static_cast<uint32_t>(specializationEntries.size()),
+			.pMapEntries = specializationEntries.data(),
+			.dataSize = sizeof(PageFeedbackSpecialization),
+			.pData = &specialization
+		};
+
+		std::array shaderStages
+		{
+			VkPipelineShaderStageCreateInfo
+			{
+				.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+				.stage = VK_SHADER_STAGE_VERTEX_BIT,
+				.module = shaders.vertex.Handle(),
+				.pName = "main"
+			},
+			VkPipelineShaderStageCreateInfo
+			{
+				.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+				.stage = VK_SHADER_STAGE_FRAGMENT_BIT,
+				.module = shaders.fragment.Handle(),
+				.pName = "main",
+				.pSpecializationInfo = &specializationInfo
+			}
+		};
+
+		VkPipelineInputAssemblyStateCreateInfo inputAssembly
+		{
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
+			.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+			.primitiveRestartEnable = VK_FALSE
+		};
+
+		VkViewport viewport
+		{
+			.x = 0.0f,
+			.y = 0.0f,
+			.width = static_cast<float>(extent.width),
+			.height = static_cast<float>(extent.height),
+			.minDepth = 0.0f,
+			.maxDepth = 1.0f
+		};
+
+		VkRect2D scissor
+		{
+			.offset = { 0, 0 },
+			.extent = extent
+		};
+
+		VkPipelineViewportStateCreateInfo viewportState
+		{
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
+			.viewportCount = 1,
+			.pViewports = &viewport,
+			.scissorCount = 1,
+			.pScissors = &scissor
+		};
+
+		VkPipelineRasterizationStateCreateInfo rasterizer
+		{
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
+			.depthClampEnable = VK_FALSE,
+			.rasterizerDiscardEnable = VK_FALSE,
+			.polygonMode = VK_POLYGON_MODE_FILL,
+			.cullMode = VK_CULL_MODE_BACK_BIT,
+			.frontFace = VK_FRONT_FACE_CLOCKWISE,
+			.depthBiasEnable = VK_FALSE,
+			.lineWidth = 1.0f
+		};
+
+		VkPipelineMultisampleStateCreateInfo multisampling
+		{
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
+			.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT
+		};
+
+		VkPipelineDepthStencilStateCreateInfo depthStencil
+		{
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
+			.depthTestEnable = VK_TRUE,
+			.depthWriteEnable = VK_TRUE,
+			.depthCompareOp = DepthBuffer::compareOp
+		};
+
+		VkPipelineColorBlendStateCreateInfo blending
+		{
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
+			.logicOpEnable = VK_FALSE,
+			.attachmentCount = 0
+		};
+
+		VkGraphicsPipelineCreateInfo pipelineInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+			.stageCount = static_cast<uint32_t>(shaderStages.size()),
+			.pStages = shaderStages.data(),
+			.pVertexInputState = &pulledVertexInputState,
+			.pInputAssemblyState = &inputAssembly,
+			.pViewportState = &viewportState,
+			.pRasterizationState = &rasterizer,
+			.pMultisampleState = &multisampling,
+			.pDepthStencilState = &depthStencil,
+			.pColorBlendState = &blending,
+			.layout = pipelineLayout,
+			.renderPass = renderPass.Handle(),
+			.subpass = 0
+		};
+
+		errorCode = vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline);
+		assert(errorCode == VK_SUCCESS);
+
+		VkDescriptorPoolSize poolSize{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3 };
+
+		VkDescriptorPoolCreateInfo descriptorPoolInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+			.maxSets = 1,
+			.poolSizeCount = 1,
+			.pPoolSizes = &poolSize
+		};
+
+		errorCode = vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool);
+		assert(errorCode == VK_SUCCESS);
+
+		VkDescriptorSetAllocateInfo descriptorSetInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+			.descriptorPool = descriptorPool,
+			.descriptorSetCount = 1,
+			.pSetLayouts = &descriptorSetLayout
+		};
+
+		errorCode = vkAllocateDescriptorSets(device, &descriptorSetInfo, &descriptorSet);
+		assert(errorCode == VK_SUCCESS);
+
+		const VkDeviceSize requestSize{ sizeof(uint32_t) * static_cast<VkDeviceSize>(extent.width) * extent.height };
+
+		VkBufferCreateInfo requestBufferInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+			.size = requestSize,
+			.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			.sharingMode = VK_SHARING_MODE_EXCLUSIVE
+		};
+
+		VmaAllocationCreateInfo requestAllocInfo{ .usage = VMA_MEMORY_USAGE_GPU_ONLY };
+
+		errorCode = vmaCreateBuffer(memoryAllocator, &requestBufferInfo, &requestAllocInfo, &requestBuffer, &requestAllocation, nullptr);
+		assert(errorCode == VK_SUCCESS);
+
+		VkBufferCreateInfo readbackBufferInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+			.size = requestSize,
+			.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			.sharingMode = VK_SHARING_MODE_EXCLUSIVE
+		};
+
+		VmaAllocationCreateInfo readbackAllocInfo
+		{
+			.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT,
+			.usage = VMA_MEMORY_USAGE_GPU_TO_CPU
+		};
+
+		for (size_t slot{}; slot < readbackBuffers.size(); ++slot)
+		{
+			VmaAllocationInfo readbackAllocationInfo;
+			errorCode = vmaCreateBuffer(memoryAllocator, &readbackBufferInfo, &readbackAllocInfo, &readbackBuffers[slot], &readbackAllocations[slot], &readbackAllocationInfo);
+			assert(errorCode == VK_SUCCESS);
+			readbackData[slot] = static_cast<const uint32_t*>(readbackAllocationInfo.pMappedData);
+		}
+
+		VkDescriptorBufferInfo requestBufferDescriptor{ requestBuffer, 0, VK_WHOLE_SIZE };
+
+		VkWriteDescriptorSet descriptorWrite
+		{
+			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			.dstSet = descriptorSet,
+			.dstBinding = 1,
+			.descriptorCount = 1,
+			.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			.pBufferInfo = &requestBufferDescriptor
+		};
+
+		vkUpdateDescriptorSets(device, 1, &descriptorWrite, 0, nullptr);
+	}
+
+	VirtualTextureFeedbackPass::~VirtualTextureFeedbackPass()
+	{
+		for (size_t slot{}; slot < readbackBuffers.size(); ++slot)
+		{
+			vmaDestroyBuffer(memoryAllocator, readbackBuffers[slot], readbackAllocations[slot]);
+		}
+		vmaDestroyBuffer(memoryAllocator, requestBuffer, requestAllocation);
+
+		vkDestroyDescriptorPool(parent, descriptorPool, nullptr);
+		vkDestroyPipeline(parent, pipeline, nullptr);
+		vkDestroyPipelineLayout(parent, pipelineLayout, nullptr);
+		vkDestroyDescriptorSetLayout(parent, descriptorSetLayout, nullptr);
+		vkDestroyFramebuffer(parent, framebuffer, nullptr);
+	}
+
+	void VirtualTextureFeedbackPass::BindScene(VkBuffer drawBuffer, VkBuffer materialBuffer)
+	{
+		VkDescriptorBufferInfo drawBufferInfo{ drawBuffer, 0, VK_WHOLE_SIZE };
+		VkDescriptorBufferInfo materialBufferInfo{ materialBuffer, 0, VK_WHOLE_SIZE };
+
+		std::array descriptorWrites
+		{
+			VkWriteDescriptorSet{ .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, .dstSet = descriptorSet, .dstBinding = 0, .descriptorCount = 1, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .pBufferInfo = &drawBufferInfo },
+			VkWriteDescriptorSet{ .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, .dstSet = descriptorSet, .dstBinding = 2, .descriptorCount = 1, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .pBufferInfo = &materialBufferInfo }
+		};
+
+		vkUpdateDescriptorSets(parent, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+	}
+
+	void VirtualTextureFeedbackPass::Record(VkCommandBuffer commandBuffer, VkBuffer indexBuffer, const std::vector<VisibilityDraw>& draws, const glm::mat4& viewProjection)
+	{
+		const VkDeviceSize requestSize{ sizeof(uint32_t) * static_cast<VkDeviceSize>(extent.width) * extent.height };
+		const size_t slot{ recordCount % readbackBuffers.size() };
+
+		auto requestBarrier = [this, requestSize](VkAccessFlags srcAccess, VkAccessFlags dstAccess)
+		{
+			return VkBufferMemoryBarrier
+			{
+				.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+				.srcAccessMask = srcAccess,
+				.dstAccessMask = dstAccess,
+				.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				.buffer = requestBuffer,
+				.offset = 0,
+				.size = requestSize
+			};
+		};
+
+		//The previous frame's copy has to be done reading before the reset
+		VkBufferMemoryBarrier resetBarrier{ requestBarrier(0, VK_ACCESS_TRANSFER_WRITE_BIT) };
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 1, &resetBarrier, 0, nullptr);
+		vkCmdFillBuffer(commandBuffer, requestBuffer, 0, requestSize, noRequest);
+
+		VkBufferMemoryBarrier writeBarrier{ requestBarrier(VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_WRITE_BIT) };
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 1, &writeBarrier, 0, nullptr);
+
+		VkClearValue clearValue{ .depthStencil = { DepthBuffer::clearDepth, 0 } };
+
+		VkRenderPassBeginInfo renderPassInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+			.renderPass = renderPass.Handle(),
+			.framebuffer = framebuffer,
+			.renderArea = { { 0, 0 }, extent },
+			.clearValueCount = 1,
+			.pClearValues = &clearValue
+		};
+
+		PageFeedbackConstants constants{ .viewProjection = viewProjection };
+
+		vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+		vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+
+		for (uint32_t drawIndex{}; drawIndex < draws.size(); ++drawIndex)
+		{
+			constants.drawIndex = drawIndex;
+			vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(PageFeedbackConstants), &constants);
+			vkCmdDrawIndexed(commandBuffer, draws[drawIndex].indexCount, 1, draws[drawIndex].firstIndex, 0, 0);
+		}
+
+		vkCmdEndRenderPass(commandBuffer);
+
+		VkBufferMemoryBarrier copyBarrier{ requestBarrier(VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT) };
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 1, &copyBarrier, 0, nullptr);
+
+		VkBufferCopy region{ .srcOffset = 0, .dstOffset = 0, .size = requestSize };
+		vkCmdCopyBuffer(commandBuffer, requestBuffer, readbackBuffers[slot], 1, &region);
+
+		VkBufferMemoryBarrier hostBarrier
+		{
+			.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+			.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+			.dstAccessMask = VK_ACCESS_HOST_READ_BIT,
+			.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+			.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+			.buffer = readbackBuffers[slot],
+			.offset = 0,
+			.size = requestSize
+		};
+
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &hostBarrier, 0, nullptr);
+		++recordCount;
+	}
+
+	const std::vector<uint32_t>& VirtualTextureFeedbackPass::Requests()
+	{
+		if (recordCount <= readbackLatency)
+		{
+			return requests;
+		}
+
+		const uint64_t readRecord{ recordCount - 1 - readbackLatency };
+		if (readCount == readRecord + 1)
+		{
+			return requests;
+		}
+
+		const size_t slot{ readRecord % readbackBuffers.size() };
+		vmaInvalidateAllocation(memoryAllocator, readbackAllocations[slot], 0, VK_WHOLE_SIZE);
+
+		const uint32_t* pixels{ readbackData[slot] };
+		const size_t pixelCount{ static_cast<size_t>(extent.width) * extent.height };
+
+		requests.clear();
+		std::copy_if(pixels, pixels + pixelCount, std::back_inserter(requests), [](uint32_t request) { return request != noRequest; });
+		std::sort(requests.begin(), requests.end());
+		requests.erase(std::unique(requests.begin(), requests.end()), requests.end());
+
+		readCount = readRecord + 1;
+		return requests;
+	}
+
+	void VirtualTextureStatistics::Print() const
+	{
+		constexpr double kilobyte{ 1024.0 };
+		constexpr double megabyte{ 1024.0 * 1024.0 };
+
+		printf("Virtual texturing: %.1f%% hit rate over %llu page requests, %u / %u pages resident\n",
+			HitRate() * 100.0, static_cast<unsigned long long>(requestCount), residentPages, pageCapacity);
+		printf("%.1f KiB uploaded last frame, %.1f KiB per frame on average\n", static_cast<double>(lastFrameUploadBytes) / kilobyte,
+			frameCount == 0 ? 0.0 : static_cast<double>(uploadBytes) / kilobyte / static_cast<double>(frameCount));
+		printf("VRAM %.1f MiB: %.1f MiB atlas, %.1f MiB indirection, %.1f MiB host visible staging\n",
+			static_cast<double>(atlasBytes + indirectionBytes) / megabyte, static_cast<double>(atlasBytes) / megabyte,
+			static_cast<double>(indirectionBytes) / megabyte, static_cast<double>(stagingBytes) / megabyte);
+	}
+
+	VirtualTextureCache::VirtualTextureCache(const VkDevice device, VmaAllocator allocator, uint32_t atlasPageCount, uint32_t textureCapacity, uint32_t pageUploadsPerFrame)
+		: slots(static_cast<size_t>(atlasPageCount) * atlasPageCount)
+		, atlasPagesPerSide{ atlasPageCount }
+		, maxTextures{ std::min(textureCapacity, maxTextureCount) }
+		, maxPageUploads{ pageUploadsPerFrame }
+		, parent{ device }
+		, memoryAllocator{ allocator }
+	{
+		//Indirection texels store the slot in 8 bits per axis
+		assert(atlasPagesPerSide > 0 && atlasPagesPerSide <= 256);
+		[[maybe_unused]] VkResult errorCode{ VK_RESULT_MAX_ENUM };
+
+		const uint32_t atlasSide{ atlasPagesPerSide * physicalPageSize };
+
+		VkImageCreateInfo atlasInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+			.imageType = VK_IMAGE_TYPE_2D,
+			.format = atlasFormat,
+			.extent = { atlasSide, atlasSide, 1 },
+			.mipLevels = 1,
+			.arrayLayers = 1,
+			.samples = VK_SAMPLE_COUNT_1_BIT,
+			.tiling = VK_IMAGE_TILING_OPTIMAL,
+			.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+			.sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+			.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED
+		};
+
+		VmaAllocationCreateInfo imageAllocInfo{ .usage = VMA_MEMORY_USAGE_GPU_ONLY };
+
+		VmaAllocationInfo atlasAllocationInfo;
+		errorCode = vmaCreateImage(memoryAllocator, &atlasInfo, &imageAllocInfo, &atlasImage, &atlasAllocation, &atlasAllocationInfo);
+		assert(errorCode == VK_SUCCESS);
+		statistics.atlasBytes = atlasAllocationInfo.size;
+
+		VkImageViewCreateInfo atlasViewInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+			.image = atlasImage,
+			.viewType = VK_IMAGE_VIEW_TYPE_2D,
+			.format = atlasFormat,
+			.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 }
+		};
+
+		errorCode = vkCreateImageView(device, &atlasViewInfo, nullptr, &atlasView);
+		assert(errorCode == VK_SUCCESS);
+
+		//The atlas has no mips, borders keep bilinear filtering inside a page
+		VkSamplerCreateInfo atlasSamplerInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+			.magFilter = VK_FILTER_LINEAR,
+			.minFilter = VK_FILTER_LINEAR,
+			.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+			.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+			.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+			.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+			.minLod = 0.0f,
+			.maxLod = 0.0f
+		};
+
+		errorCode = vkCreateSampler(device, &atlasSamplerInfo, nullptr, &atlasSampler);
+		assert(errorCode == VK_SUCCESS);
+
+		VkSamplerCreateInfo indirectionSamplerInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+			.magFilter = VK_FILTER_NEAREST,
+			.minFilter = VK_FILTER_NEAREST,
+			.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+			.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+			.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+			.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+			.minLod = 0.0f,
+			.maxLod = static_cast<float>(std::bit_width(maxPageCount))
+		};
+
+		errorCode = vkCreateSampler(device, &indirectionSamplerInfo, nullptr, &indirectionSampler);
+		assert(errorCode == VK_SUCCESS);
+
+		std::array bindings
+		{
+			VkDescriptorSetLayoutBinding{ .binding = 0, .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT },
+			VkDescriptorSetLayoutBinding{ .binding = 1, .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, .descriptorCount = maxTextures, .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT }
+		};
+
+		//AddTexture writes an indirection descriptor while frames using the set are recorded or in flight, those frames
+		//never sample the new texture
+		std::array<VkDescriptorBindingFlags, 2> bindingFlags
+		{
+			0,
+			VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT | VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT
+		};
+
+		VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO,
+			.bindingCount = static_cast<uint32_t>(bindingFlags.size()),
+			.pBindingFlags = bindingFlags.data()
+		};
+
+		VkDescriptorSetLayoutCreateInfo descriptorSetLayoutInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+			.pNext = &bindingFlagsInfo,
+			.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT,
+			.bindingCount = static_cast<uint32_t>(bindings.size()),
+			.pBindings = bindings.data()
+		};
+
+		errorCode = vkCreateDescriptorSetLayout(device, &descriptorSetLayoutInfo, nullptr, &descriptorSetLayout);
+		assert(errorCode == VK_SUCCESS);
+
+		VkDescriptorPoolSize poolSize{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1 + maxTextures };
+
+		VkDescriptorPoolCreateInfo descriptorPoolInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+			.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT,
+			.maxSets = 1,
+			.poolSizeCount = 1,
+			.pPoolSizes = &poolSize
+		};
+
+		errorCode = vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool);
+		assert(errorCode == VK_SUCCESS);
+
+		VkDescriptorSetAllocateInfo descriptorSetInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+			.descriptorPool = descriptorPool,
+			.descriptorSetCount = 1,
+			.pSetLayouts = &descriptorSetLayout
+		};
+
+		errorCode = vkAllocateDescriptorSets(device, &descriptorSetInfo, &descriptorSet);
+		assert(errorCode == VK_SUCCESS);
+
+		VkDescriptorImageInfo atlasDescriptor{ atlasSampler, atlasView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+
+		VkWriteDescriptorSet descriptorWrite
+		{
+			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			.dstSet = descriptorSet,
+			.dstBinding = 0,
+			.descriptorCount = 1,
+			.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+			.pImageInfo = &atlasDescriptor
+		};
+
+		vkUpdateDescriptorSets(device, 1, &descriptorWrite, 0, nullptr);
+
+		//Every slot can take a frame's pages and two rewritten indirection textures of the largest size, the first page
+		//always fits together with the texture it's added to and the texture it evicts a page of
+		stagingSlotSize = maxPageUploads * pageBytes + 2 * IndirectionBytes(maxPageCount);
+
+		VkBufferCreateInfo stagingBufferInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+			.size = stagingSlotSize * stagingSlots,
+			.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			.sharingMode = VK_SHARING_MODE_EXCLUSIVE
+		};
+
+		VmaAllocationCreateInfo stagingAllocInfo
+		{
+			.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT,
+			.usage = VMA_MEMORY_USAGE_CPU_ONLY
+		};
+
+		VmaAllocationInfo stagingAllocationInfo;
+		errorCode = vmaCreateBuffer(memoryAllocator, &stagingBufferInfo, &stagingAllocInfo, &stagingBuffer, &stagingAllocation, &stagingAllocationInfo);
+		assert(errorCode == VK_SUCCESS);
+		stagingData = static_cast<std::byte*>(stagingAllocationInfo.pMappedData);
+		statistics.stagingBytes = stagingBufferInfo.size;
+
+		textures.reserve(maxTextures);
+		streamingThread = std::thread{ &VirtualTextureCache::StreamPages, this };
+	}
+
+	VirtualTextureCache::~VirtualTextureCache()
+	{
+		{
+			std::lock_guard lock{ mutex };
+			stopping = true;
+		}
+		wake.notify_all();
+		streamingThread.join();
+
+		vmaDestroyBuffer(memoryAllocator, stagingBuffer, stagingAllocation);
+		for (Texture& texture : textures)
+		{
+			vkDestroyImageView(parent, texture.indirectionView, nullptr);
+			vmaDestroyImage(memoryAllocator, texture.indirectionImage, texture.indirectionAllocation);
+		}
+
+		vkDestroyDescriptorPool(parent, descriptorPool, nullptr);
+		vkDestroyDescriptorSetLayout(parent, descriptorSetLayout, nullptr);
+		vkDestroySampler(parent, indirectionSampler, nullptr);
+		vkDestroySampler(parent, atlasSampler, nullptr);
+		vkDestroyImageView(parent, atlasView, nullptr);
+		vmaDestroyImage(memoryAllocator, atlasImage, atlasAllocation);
+	}
+
+	uint32_t VirtualTextureCache::AddTexture(VirtualTextureInfo info)
+	{
+		assert(textures.size() < maxTextures);
+		assert(info.extent % pageSize == 0 && std::has_single_bit(info.extent / pageSize) && info.extent / pageSize <= maxPageCount);
+
+		const uint32_t textureIndex{ static_cast<uint32_t>(textures.size()) };
+		const uint32_t pageCount{ info.extent / pageSize };
+		const uint32_t mipCount{ static_cast<uint32_t>(std::bit_width(pageCount)) };
+
+		VkImageCreateInfo indirectionInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+			.imageType = VK_IMAGE_TYPE_2D,
+			.format = VK_FORMAT_R8G8B8A8_UINT,
+			.extent = { pageCount, pageCount, 1 },
+			.mipLevels = mipCount,
+			.arrayLayers = 1,
+			.samples = VK_SAMPLE_COUNT_1_BIT,
+			.tiling = VK_IMAGE_TILING_OPTIMAL,
+			.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+			.sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+			.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED
+		};
+
+		VmaAllocationCreateInfo indirectionAllocInfo{ .usage = VMA_MEMORY_USAGE_GPU_ONLY };
+
+		Texture texture
+		{
+			.info = std::move(info),
+			.pageCount = pageCount,
+			.mipCount = mipCount,
+			.indirectionInitialized = false
+		};
+
+		VmaAllocationInfo indirectionAllocationInfo;
+		[[maybe_unused]] VkResult errorCode = vmaCreateImage(memoryAllocator, &indirectionInfo, &indirectionAllocInfo, &texture.indirectionImage, &texture.indirectionAllocation, &indirectionAllocationInfo);
+		assert(errorCode == VK_SUCCESS);
+		statistics.indirectionBytes += indirectionAllocationInfo.size;
+
+		VkImageViewCreateInfo viewInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+			.image = texture.indirectionImage,
+			.viewType = VK_IMAGE_VIEW_TYPE_2D,
+			.format = VK_FORMAT_R8G8B8A8_UINT,
+			.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, mipCount, 0, 1 }
+		};
+
+		errorCode = vkCreateImageView(parent, &viewInfo, nullptr, &texture.indirectionView);
+		assert(errorCode == VK_SUCCESS);
+
+		VkDescriptorImageInfo indirectionDescriptor{ indirectionSampler, texture.indirectionView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+
+		VkWriteDescriptorSet descriptorWrite
+		{
+			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			.dstSet = descriptorSet,
+			.dstBinding = 1,
+			.dstArrayElement = textureIndex,
+			.descriptorCount = 1,
+			.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+			.pImageInfo = &indirectionDescriptor
+		};
+
+		vkUpdateDescriptorSets(parent, 1, &descriptorWrite, 0, nullptr);
+
+		textures.push_back(std::move(texture));
+
+		//The coarsest page is every other page's last fallback, it goes first and stays
+		const uint32_t coarsestPage{ PackVirtualPage(VirtualPage{ textureIndex, mipCount - 1, 0, 0 }) };
+		loadingPages.insert(coarsestPage);
+		{
+			std::lock_guard lock{ mutex };
+			loadQueue.push_front(coarsestPage);
+		}
+		wake.notify_one();
+
+		return textureIndex;
+	}
+
+	VirtualTextureMaterial VirtualTextureCache::Material(uint32_t textureIndex) const noexcept
+	{
+		const Texture& texture{ textures[textureIndex] };
+		return VirtualTextureMaterial{ .textureIndex = textureIndex, .pageCount = texture.pageCount, .mipCount = texture.mipCount, .padding = 0 };
+	}
+
+	void VirtualTextureCache::Update(const std::vector<uint32_t>& requests)
+	{
+		CPU_ZONE("VirtualTextureCache::Update");
+
+		++frame;
+		++statistics.frameCount;
+
+		//Missing pages including the ones already loading, the ancestors of a request are its fallbacks and wanted too
+		std::vector<uint32_t> wantedPages;
+		for (const uint32_t request : requests)
+		{
+			const VirtualPage page{ UnpackVirtualPage(request) };
+			if (page.textureIndex >= textures.size() || page.mip >= textures[page.textureIndex].mipCount)
+			{
+				continue;
+			}
+
+			const uint32_t mipPageCount{ textures[page.textureIndex].pageCount >> page.mip };
+			if (page.x >= mipPageCount || page.y >= mipPageCount)
+			{
+				continue;
+			}
+
+			++statistics.requestCount;
+			if (residentPages.contains(request))
+			{
+				++statistics.hitCount;
+			}
+
+			for (VirtualPage ancestor{ page }; ancestor.mip < textures[page.textureIndex].mipCount; ++ancestor.mip, ancestor.x /= 2, ancestor.y /= 2)
+			{
+				const uint32_t packedAncestor{ PackVirtualPage(ancestor) };
+				const auto resident{ residentPages.find(packedAncestor) };
+				if (resident != residentPages.end())
+				{
+					slots[resident->second].lastUsedFrame = frame;
+				}
+				else
+				{
+					wantedPages.push_back(packedAncestor);
+				}
+			}
+		}
+
+		std::sort(wantedPages.begin(), wantedPages.end());
+		wantedPages.erase(std::unique(wantedPages.begin(), wantedPages.end()), wantedPages.end());
+
+		auto coarserFirst = [](uint32_t a, uint32_t b)
+		{
+			return UnpackVirtualPage(a).mip > UnpackVirtualPage(b).mip;
+		};
+
+		{
+			std::lock_guard lock{ mutex };
+
+			std::erase_if(loadQueue, [this, &wantedPages](uint32_t page)
+			{
+				if (IsPinned(page) || std::binary_search(wantedPages.begin(), wantedPages.end(), page))
+				{
+					return false;
+				}
+				loadingPages.erase(page);
+				return true;
+			});
+
+			for (const uint32_t page : wantedPages)
+			{
+				if (loadingPages.insert(page).second)
+				{
+					loadQueue.push_back(page);
+				}
+			}
+
+			std::stable_sort(loadQueue.begin(), loadQueue.end(), coarserFirst);
+		}
+		wake.notify_one();
+	}
+
+	void VirtualTextureCache::RecordUploads(VkCommandBuffer commandBuffer)
+	{
+		CPU_ZONE("VirtualTextureCache::RecordUploads");
+
+		std::vector<DecodedPage> pages;
+		{
+			std::lock_guard lock{ mutex };
+			const size_t pageCount{ std::min<size_t>(decodedPages.size(), maxPageUploads) };
+			std::move(decodedPages.begin(), decodedPages.begin() + pageCount, std::back_inserter(pages));
+			decodedPages.erase(decodedPages.begin(), decodedPages.begin() + pageCount);
+		}
+
+		const VkDeviceSize stagingOffset{ (uploadCount++ % stagingSlots) * stagingSlotSize };
+		VkDeviceSize stagingUsed{ 0 };
+
+		//Textures whose indirection this call rewrites and the staging reserved for them. A texture that gains or loses a
+		//page is rewritten by the same call, its indirection would point at a slot holding another page otherwise
+		std::vector<uint32_t> rebuiltTextures;
+		std::vector<bool> rebuilt(textures.size(), false);
+		VkDeviceSize rebuildBytes{ 0 };
+		auto rebuildCost = [this, &rebuilt](uint32_t textureIndex) -> VkDeviceSize
+		{
+			return textureIndex == noVirtualTexture || rebuilt[textureIndex] ? 0 : IndirectionBytes(textures[textureIndex].pageCount);
+		};
+		auto rebuild = [&rebuiltTextures, &rebuilt, &rebuildBytes, &rebuildCost](uint32_t textureIndex)
+		{
+			rebuildBytes += rebuildCost(textureIndex);
+			if (!rebuilt[textureIndex])
+			{
+				rebuilt[textureIndex] = true;
+				rebuiltTextures.push_back(textureIndex);
+			}
+		};
+
+		std::vector<VkBufferImageCopy> atlasCopies;
+		std::vector<DecodedPage> deferredPages;
+		for (DecodedPage& decodedPage : pages)
+		{
+			assert(decodedPage.texels.size() == pageBytes);
+
+			//Every slot holds a page used this frame, the page is requested again once there's room
+			const uint32_t slot{ AllocateSlot() };
+			if (slot == noSlot)
+			{
+				loadingPages.erase(decodedPage.page);
+				continue;
+			}
+
+			const uint32_t textureIndex{ UnpackVirtualPage(decodedPage.page).textureIndex };
+			const uint32_t evictedTexture{ slots[slot].page != noPage ? UnpackVirtualPage(slots[slot].page).textureIndex : noVirtualTexture };
+			const VkDeviceSize evictedCost{ evictedTexture != textureIndex ? rebuildCost(evictedTexture) : 0 };
+
+			//Without room for both indirections the page waits for the next call, the slot keeps its page until then
+			if (stagingUsed + pageBytes + rebuildBytes + rebuildCost(textureIndex) + evictedCost > stagingSlotSize)
+			{
+				deferredPages.push_back(std::move(decodedPage));
+				continue;
+			}
+
+			loadingPages.erase(decodedPage.page);
+			if (evictedTexture != noVirtualTexture)
+			{
+				residentPages.erase(slots[slot].page);
+				rebuild(evictedTexture);
+			}
+
+			slots[slot] = Slot{ .page = decodedPage.page, .lastUsedFrame = frame, .pinned = IsPinned(decodedPage.page) };
+			residentPages[decodedPage.page] = slot;
+			rebuild(textureIndex);
+
+			std::memcpy(stagingData + stagingOffset + stagingUsed, decodedPage.texels.data(), pageBytes);
+			atlasCopies.push_back(VkBufferImageCopy
+			{
+				.bufferOffset = stagingOffset + stagingUsed,
+				.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 },
+				.imageOffset = { static_cast<int32_t>(slot % atlasPagesPerSide * physicalPageSize), static_cast<int32_t>(slot / atlasPagesPerSide * physicalPageSize), 0 },
+				.imageExtent = { physicalPageSize, physicalPageSize, 1 }
+			});
+			stagingUsed += pageBytes;
+		}
+
+		if (!deferredPages.empty())
+		{
+			std::lock_guard lock{ mutex };
+			decodedPages.insert(decodedPages.begin(), std::make_move_iterator(deferredPages.begin()), std::make_move_iterator(deferredPages.end()));
+		}
+
+		//Textures added since the last call get their first indirection in the staging that's left
+		for (uint32_t textureIndex{}; textureIndex < textures.size(); ++textureIndex)
+		{
+			if (!textures[textureIndex].indirectionInitialized && stagingUsed + rebuildBytes + rebuildCost(textureIndex) <= stagingSlotSize)
+			{
+				rebuild(textureIndex);
+			}
+		}
+
+		//Indirection is rebuilt coarse to fine, a page without a resident page of its own inherits its parent's texel
+		std::vector<std::pair<uint32_t, std::vector<VkBufferImageCopy>>> indirectionCopies;
+		for (const uint32_t textureIndex : rebuiltTextures)
+		{
+			Texture& texture{ textures[textureIndex] };
+
+			std::vector<VkBufferImageCopy> copies;
+			const uint32_t* coarser{ nullptr };
+			for (uint32_t mip{ texture.mipCount }; mip-- > 0;)
+			{
+				const uint32_t mipPageCount{ texture.pageCount >> mip };
+				uint32_t* texels{ reinterpret_cast<uint32_t*>(stagingData + stagingOffset + stagingUsed) };
+
+				for (uint32_t y{}; y < mipPageCount; ++y)
+				{
+					for (uint32_t x{}; x < mipPageCount; ++x)
+					{
+						const auto resident{ residentPages.find(PackVirtualPage(VirtualPage{ textureIndex, mip, x, y })) };
+						if (resident != residentPages.end())
+						{
+							const uint32_t slot{ resident->second };
+							texels[y * mipPageCount + x] = (slot % atlasPagesPerSide) | (slot / atlasPagesPerSide) << 8 | mip << 16 | 1u << 24;
+						}
+						else
+						{
+							texels[y * mipPageCount + x] = coarser ? coarser[(y / 2) * (mipPageCount / 2) + x / 2] : 0;
+						}
+					}
+				}
+
+				copies.push_back(VkBufferImageCopy
+				{
+					.bufferOffset = stagingOffset + stagingUsed,
+					.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, mip, 0, 1 },
+					.imageOffset = { 0, 0, 0 },
+					.imageExtent = { mipPageCount, mipPageCount, 1 }
+				});
+
+				coarser = texels;
+				stagingUsed += sizeof(uint32_t) * mipPageCount * mipPageCount;
+			}
+
+			indirectionCopies.emplace_back(textureIndex, std::move(copies));
+		}
+
+		statistics.lastFrameUploadBytes = stagingUsed;
+		statistics.uploadBytes += stagingUsed;
+
+		//Previous frames sample the atlas and indirection on the same queue, the barriers keep the copies behind them
+		std::vector<VkImageMemoryBarrier> transferBarriers;
+		std::vector<VkImageMemoryBarrier> readBarriers;
+		auto transition = [&transferBarriers, &readBarriers](VkImage image, uint32_t mipCount, bool initialized)
+		{
+			VkImageMemoryBarrier barrier
+			{
+				.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+				.srcAccessMask = 0,
+				.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+				.oldLayout = initialized ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED,
+				.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+				.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				.image = image,
+				.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, mipCount, 0, 1 }
+			};
+			transferBarriers.push_back(barrier);
+
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			readBarriers.push_back(barrier);
+		};
+
+		//The atlas is transitioned on the first call even without pages, it's bound from then on
+		if (!atlasCopies.empty() || !atlasInitialized)
+		{
+			transition(atlasImage, 1, atlasInitialized);
+			atlasInitialized = true;
+		}
+		for (const auto& [textureIndex, copies] : indirectionCopies)
+		{
+			Texture& texture{ textures[textureIndex] };
+			transition(texture.indirectionImage, texture.mipCount, texture.indirectionInitialized);
+			texture.indirectionInitialized = true;
+		}
+
+		if (transferBarriers.empty())
+		{
+			return;
+		}
+
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+			0, nullptr, 0, nullptr, static_cast<uint32_t>(transferBarriers.size()), transferBarriers.data());
+
+		if (!atlasCopies.empty())
+		{
+			vkCmdCopyBufferToImage(commandBuffer, stagingBuffer, atlasImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(atlasCopies.size()), atlasCopies.data());
+		}
+		for (const auto& [textureIndex, copies] : indirectionCopies)
+		{
+			vkCmdCopyBufferToImage(commandBuffer, stagingBuffer, textures[textureIndex].indirectionImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(copies.size()), copies.data());
+		}
+
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+			0, nullptr, 0, nullptr, static_cast<uint32_t>(readBarriers.size()), readBarriers.data());
+	}
+
+	VirtualTextureStatistics VirtualTextureCache::Statistics() const noexcept
+	{
+		VirtualTextureStatistics result{ statistics };
+		result.residentPages = static_cast<uint32_t>(residentPages.size());
+		result.pageCapacity = static_cast<uint32_t>(slots.size());
+		return result;
+	}
+
+	void VirtualTextureCache::StreamPages()
+	{
+		SetCpuThreadName("Virtual texture streaming");
+
+		while (true)
+		{
+			uint32_t page;
+			{
+				std::unique_lock lock{ mutex };
+				wake.wait(lock, [this] { return stopping || !loadQueue.empty(); });
+				if (stopping)
+				{
+					return;
+				}
+
+				page = loadQueue.front();
+				loadQueue.pop_front();
+			}
+
+			const VirtualPage virtualPage{ UnpackVirtualPage(page) };
+			std::vector<std::byte> texels;
+			{
+				CPU_ZONE("VirtualTextureCache::LoadPage");
+				texels = textures[virtualPage.textureIndex].info.loadPage(virtualPage);
+			}
+
+			std::lock_guard lock{ mutex };
+			decodedPages.push_back(DecodedPage{ page, std::move(texels) });
+		}
+	}
+
+	uint32_t VirtualTextureCache::AllocateSlot()
+	{
+		uint32_t leastRecentlyUsed{ noSlot };
+		for (uint32_t slot{}; slot < slots.size(); ++slot)
+		{
+			if (slots[slot].page == noPage)
+			{
+				return slot;
+			}
+
+			if (!slots[slot].pinned && slots[slot].lastUsedFrame < frame
+				&& (leastRecentlyUsed == noSlot || slots[slot].lastUsedFrame < slots[leastRecentlyUsed].lastUsedFrame))
+			{
+				leastRecentlyUsed = slot;
+			}
+		}
+
+		return leastRecentlyUsed;
+	}
+
+	bool VirtualTextureCache::IsPinned(uint32_t packedPage) const noexcept
+	{
+		const VirtualPage page{ UnpackVirtualPage(packedPage) };
+		return page.mip + 1 == textures[page.textureIndex].mipCount;
+	}
+}
@@ -0,0 +1,595 @@
+#include "Graphics/VisibilityBuffer.h"
+#include "Graphics/VertexLayout.h"
+#include "GPU/Shader.h"
+
+#include <vulkan/vulkan_core.h>
+
+#include <algorithm>
+#include <array>
+#include <assert.h>
+
+namespace cof
+{
+	//Matches VisibilityConstants in VisibilityBuffer.glsl
+	struct VisibilityConstants
+	{
+		glm::mat4 viewProjection;
+		glm::vec4 lightDirection;
+		uint32_t drawOrMaterialIndex;
+		uint32_t tileCount;
+		uint32_t extentWidth;
+		uint32_t extentHeight;
+	};
+
+	constexpr static VkShaderStageFlags visibilityStages{ VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT };
+
+	static void CreateImage(VmaAllocator allocator, VkExtent2D extent, VkFormat format, VkImageUsageFlags usage, VkImage& image, VmaAllocation& allocation)
+	{
+		VkImageCreateInfo imageInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+			.imageType = VK_IMAGE_TYPE_2D,
+			.format = format,
+			.extent = { extent.width, extent.height, 1 },
+			.mipLevels = 1,
+			.arrayLayers = 1,
+			.samples = VK_SAMPLE_COUNT_1_BIT,
+			.tiling = VK_IMAGE_TILING_OPTIMAL,
+			.usage = usage,
+			.sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+			.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED
+		};
+
+		VmaAllocationCreateInfo imageAllocInfo
+		{
+			.usage = VMA_MEMORY_USAGE_GPU_ONLY
+		};
+
+		[[maybe_unused]] VkResult errorCode = vmaCreateImage(allocator, &imageInfo, &imageAllocInfo, &image, &allocation, nullptr);
+		assert(errorCode == VK_SUCCESS);
+	}
+
+	static VkImageView CreateImageView(VkDevice device, VkImage image, VkFormat format, VkImageAspectFlags aspect)
+	{
+		VkImageViewCreateInfo viewInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+			.image = image,
+			.viewType = VK_IMAGE_VIEW_TYPE_2D,
+			.format = format,
+			.subresourceRange = { aspect, 0, 1, 0, 1 }
+		};
+
+		VkImageView view;
+		[[maybe_unused]] VkResult errorCode = vkCreateImageView(device, &viewInfo, nullptr, &view);
+		assert(errorCode == VK_SUCCESS);
+		return view;
+	}
+
+	static VkPipeline CreateComputePipeline(VkDevice device, const cof::Shader& shader, VkPipelineLayout layout)
+	{
+		VkComputePipelineCreateInfo pipelineInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+			.stage =
+			{
+				.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+				.stage = VK_SHADER_STAGE_COMPUTE_BIT,
+				.module = shader.Handle(),
+				.pName = "main"
+			},
+			.layout = layout
+		};
+
+		VkPipeline pipeline;
+		[[maybe_unused]] VkResult errorCode = vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline);
+		assert(errorCode == VK_SUCCESS);
+		return pipeline;
+	}
+
+	VisibilityBuffer::VisibilityBuffer(	const VkDevice device,
+										[[maybe_unused]] const VkPhysicalDeviceFeatures& enabledFeatures,
+										VmaAllocator allocator,
+										const VkExtent2D bufferExtent,
+										const Shaders& shaders,
+										const bool reversedZ)
+		: extent{ bufferExtent }
+		, tileCountX{ (bufferExtent.width + tileSize - 1) / tileSize }
+		, tileCountY{ (bufferExtent.height + tileSize - 1) / tileSize }
+		, reversedDepth{ reversedZ }
+		, parent{ device }
+		, memoryAllocator{ allocator }
+	{
+		//The geometry fragment shader writes gl_PrimitiveID
+		assert(enabledFeatures.geometryShader == VK_TRUE);
+
+		[[maybe_unused]] VkResult errorCode{ VK_RESULT_MAX_ENUM };
+
+		CreateImage(memoryAllocator, extent, VK_FORMAT_R32_UINT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_STORAGE_BIT, visibilityImage, visibilityAllocation);
+		CreateImage(memoryAllocator, extent, VK_FORMAT_D32_SFLOAT, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, depthImage, depthAllocation);
+		CreateImage(memoryAllocator, extent, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, shadedImage, shadedAllocation);
+
+		visibilityView = CreateImageView(device, visibilityImage, VK_FORMAT_R32_UINT, VK_IMAGE_ASPECT_COLOR_BIT);
+		depthView = CreateImageView(device, depthImage, VK_FORMAT_D32_SFLOAT, VK_IMAGE_ASPECT_DEPTH_BIT);
+		shadedView = CreateImageView(device, shadedImage, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_ASPECT_COLOR_BIT);
+
+		VmaAllocationCreateInfo bufferAllocInfo
+		{
+			.usage = VMA_MEMORY_USAGE_GPU_ONLY
+		};
+
+		VkBufferCreateInfo tileListInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+			.size = sizeof(uint32_t) * maxMaterialCount * tileCountX * tileCountY,
+			.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			.sharingMode = VK_SHARING_MODE_EXCLUSIVE
+		};
+
+		errorCode = vmaCreateBuffer(memoryAllocator, &tileListInfo, &bufferAllocInfo, &tileListBuffer, &tileListAllocation, nullptr);
+		assert(errorCode == VK_SUCCESS);
+
+		VkBufferCreateInfo materialDispatchInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+			.size = sizeof(VkDispatchIndirectCommand) * maxMaterialCount,
+			.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			.sharingMode = VK_SHARING_MODE_EXCLUSIVE
+		};
+
+		errorCode = vmaCreateBuffer(memoryAllocator, &materialDispatchInfo, &bufferAllocInfo, &materialDispatchBuffer, &materialDispatchAllocation, nullptr);
+		assert(errorCode == VK_SUCCESS);
+
+		std::array attachments
+		{
+			VkAttachmentDescription
+			{
+				.format = VK_FORMAT_R32_UINT,
+				.samples = VK_SAMPLE_COUNT_1_BIT,
+				.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+				.storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+				.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+				.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+				.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+				.finalLayout = VK_IMAGE_LAYOUT_GENERAL
+			},
+			VkAttachmentDescription
+			{
+				.format = VK_FORMAT_D32_SFLOAT,
+				.samples = VK_SAMPLE_COUNT_1_BIT,
+				.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+				.storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+				.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+				.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+				.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+				.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+			}
+		};
+
+		VkAttachmentReference visibilityReference{ 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+		VkAttachmentReference depthReference{ 1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
+
+		VkSubpassDescription subpass
+		{
+			.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
+			.colorAttachmentCount = 1,
+			.pColorAttachments = &visibilityReference,
+			.pDepthStencilAttachment = &depthReference
+		};
+
+		std::array dependencies
+		{
+			//The previous frame's resolve and depth reads have to finish before the attachments are cleared
+			VkSubpassDependency
+			{
+				.srcSubpass = VK_SUBPASS_EXTERNAL,
+				.dstSubpass = 0,
+				.srcStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT,
+				.srcAccessMask = 0,
+				.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT
+			},
+			VkSubpassDependency
+			{
+				.srcSubpass = 0,
+				.dstSubpass = VK_SUBPASS_EXTERNAL,
+				.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+				.dstStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+				.dstAccessMask = VK_ACCESS_SHADER_READ_BIT
+			}
+		};
+
+		VkRenderPassCreateInfo renderPassInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
+			.attachmentCount = static_cast<uint32_t>(attachments.size()),
+			.pAttachments = attachments.data(),
+			.subpassCount = 1,
+			.pSubpasses = &subpass,
+			.dependencyCount = static_cast<uint32_t>(dependencies.size()),
+			.pDependencies = dependencies.data()
+		};
+
+		errorCode = vkCreateRenderPass(device, &renderPassInfo, nullptr, &renderPass);
+		assert(errorCode == VK_SUCCESS);
+
+		std::array framebufferAttachments{ visibilityView, depthView };
+
+		VkFramebufferCreateInfo framebufferInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
+			.renderPass = renderPass,
+			.attachmentCount = static_cast<uint32_t>(framebufferAttachments.size()),
+			.pAttachments = framebufferAttachments.data(),
+			.width = extent.width,
+			.height = extent.height,
+			.layers = 1
+		};
+
+		errorCode = vkCreateFramebuffer(device, &framebufferInfo, nullptr, &framebuffer);
+		assert(errorCode == VK_SUCCESS);
+
+		std::array bindings
+		{
+			VkDescriptorSetLayoutBinding{ .binding = 0, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_COMPUTE_BIT },
+			VkDescriptorSetLayoutBinding{ .binding = 1, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT },
+			VkDescriptorSetLayoutBinding{ .binding = 2, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT },
+			VkDescriptorSetLayoutBinding{ .binding = 3, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT },
+			VkDescriptorSetLayoutBinding{ .binding = 4, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT },
+			VkDescriptorSetLayoutBinding{ .binding = 5, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT }
+		};
+
+		VkDescriptorSetLayoutCreateInfo descriptorSetLayoutInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+			.bindingCount = static_cast<uint32_t>(bindings.size()),
+			.pBindings = bindings.data()
+		};
+
+		errorCode = vkCreateDescriptorSetLayout(device, &descriptorSetLayoutInfo, nullptr, &descriptorSetLayout);
+		assert(errorCode == VK_SUCCESS);
+
+		//Every pass shares one layout, the push constants carry the draw index when rasterizing and the material index when resolving
+		VkPushConstantRange pushConstantRange
+		{
+			.stageFlags = visibilityStages,
+			.offset = 0,
+			.size = sizeof(VisibilityConstants)
+		};
+
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+			.setLayoutCount = 1,
+			.pSetLayouts = &descriptorSetLayout,
+			.pushConstantRangeCount = 1,
+			.pPushConstantRanges = &pushConstantRange
+		};
+
+		errorCode = vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout);
+		assert(errorCode == VK_SUCCESS);
+
+		std::array shaderStages
+		{
+			VkPipelineShaderStageCreateInfo
+			{
+				.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+				.stage = VK_SHADER_STAGE_VERTEX_BIT,
+				.module = shaders.geometryVertex.Handle(),
+				.pName = "main"
+			},
+			VkPipelineShaderStageCreateInfo
+			{
+				.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+				.stage = VK_SHADER_STAGE_FRAGMENT_BIT,
+				.module = shaders.geometryFragment.Handle(),
+				.pName = "main"
+			}
+		};
+
+		VkPipelineInputAssemblyStateCreateInfo inputAssembly
+		{
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
+			.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+			.primitiveRestartEnable = VK_FALSE
+		};
+
+		VkViewport viewport
+		{
+			.x = 0.0f,
+			.y = 0.0f,
+			.width = static_cast<float>(extent.width),
+			.height = static_cast<float>(extent.height),
+			.minDepth = 0.0f,
+			.maxDepth = 1.0f
+		};
+
+		VkRect2D scissor
+		{
+			.offset = { 0, 0 },
+			.extent = extent
+		};
+
+		VkPipelineViewportStateCreateInfo viewportState
+		{
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
+			.viewportCount = 1,
+			.pViewports = &viewport,
+			.scissorCount = 1,
+			.pScissors = &scissor
+		};
+
+		VkPipelineRasterizationStateCreateInfo rasterizer
+		{
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
+			.depthClampEnable = VK_FALSE,
+			.rasterizerDiscardEnable = VK_FALSE,
+			.polygonMode = VK_POLYGON_MODE_FILL,
+			.cullMode = VK_CULL_MODE_BACK_BIT,
+			.frontFace = VK_FRONT_FACE_CLOCKWISE,
+			.depthBiasEnable = VK_FALSE,
+			.lineWidth = 1.0f
+		};
+
+		VkPipelineMultisampleStateCreateInfo multisampling
+		{
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
+			.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT
+		};
+
+		VkPipelineDepthStencilStateCreateInfo depthStencil
+		{
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
+			.depthTestEnable = VK_TRUE,
+			.depthWriteEnable = VK_TRUE,
+			.depthCompareOp = reversedDepth ? VK_COMPARE_OP_GREATER : VK_COMPARE_OP_LESS
+		};
+
+		VkPipelineColorBlendAttachmentState visibilityBlendAttachment
+		{
+			.blendEnable = VK_FALSE,
+			.colorWriteMask = VK_COLOR_COMPONENT_R_BIT
+		};
+
+		VkPipelineColorBlendStateCreateInfo colorBlending
+		{
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
+			.logicOpEnable = VK_FALSE,
+			.attachmentCount = 1,
+			.pAttachments = &visibilityBlendAttachment
+		};
+
+		VkGraphicsPipelineCreateInfo geometryPipelineInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+			.stageCount = static_cast<uint32_t>(shaderStages.size()),
+			.pStages = shaderStages.data(),
+			.pVertexInputState = &pulledVertexInputState,
+			.pInputAssemblyState = &inputAssembly,
+			.pViewportState = &viewportState,
+			.pRasterizationState = &rasterizer,
+			.pMultisampleState = &multisampling,
+			.pDepthStencilState = &depthStencil,
+			.pColorBlendState = &colorBlending,
+			.layout = pipelineLayout,
+			.renderPass = renderPass,
+			.subpass = 0
+		};
+
+		errorCode = vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &geometryPipelineInfo, nullptr, &geometryPipeline);
+		assert(errorCode == VK_SUCCESS);
+
+		classifyPipeline = CreateComputePipeline(device, shaders.classify, pipelineLayout);
+		resolvePipeline = CreateComputePipeline(device, shaders.resolve, pipelineLayout);
+
+		std::array poolSizes
+		{
+			VkDescriptorPoolSize{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4 },
+			VkDescriptorPoolSize{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 2 }
+		};
+
+		VkDescriptorPoolCreateInfo descriptorPoolInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+			.maxSets = 1,
+			.poolSizeCount = static_cast<uint32_t>(poolSizes.size()),
+			.pPoolSizes = poolSizes.data()
+		};
+
+		errorCode = vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool);
+		assert(errorCode == VK_SUCCESS);
+
+		VkDescriptorSetAllocateInfo descriptorSetInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+			.descriptorPool = descriptorPool,
+			.descriptorSetCount = 1,
+			.pSetLayouts = &descriptorSetLayout
+		};
+
+		errorCode = vkAllocateDescriptorSets(device, &descriptorSetInfo, &descriptorSet);
+		assert(errorCode == VK_SUCCESS);
+
+		VkDescriptorImageInfo visibilityInfo{ .imageView = visibilityView, .imageLayout = VK_IMAGE_LAYOUT_GENERAL };
+		VkDescriptorImageInfo shadedInfo{ .imageView = shadedView, .imageLayout = VK_IMAGE_LAYOUT_GENERAL };
+		VkDescriptorBufferInfo tileListBufferInfo{ tileListBuffer, 0, VK_WHOLE_SIZE };
+		VkDescriptorBufferInfo materialDispatchBufferInfo{ materialDispatchBuffer, 0, VK_WHOLE_SIZE };
+
+		std::array descriptorWrites
+		{
+			VkWriteDescriptorSet{ .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, .dstSet = descriptorSet, .dstBinding = 2, .descriptorCount = 1, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, .pImageInfo = &visibilityInfo },
+			VkWriteDescriptorSet{ .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, .dstSet = descriptorSet, .dstBinding = 3, .descriptorCount = 1, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, .pImageInfo = &shadedInfo },
+			VkWriteDescriptorSet{ .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, .dstSet = descriptorSet, .dstBinding = 4, .descriptorCount = 1, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .pBufferInfo = &tileListBufferInfo },
+			VkWriteDescriptorSet{ .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, .dstSet = descriptorSet, .dstBinding = 5, .descriptorCount = 1, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .pBufferInfo = &materialDispatchBufferInfo }
+		};
+
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+	}
+
+	VisibilityBuffer::~VisibilityBuffer()
+	{
+		vkDestroyDescriptorPool(parent, descriptorPool, nullptr);
+		vkDestroyPipeline(parent, resolvePipeline, nullptr);
+		vkDestroyPipeline(parent, classifyPipeline, nullptr);
+		vkDestroyPipeline(parent, geometryPipeline, nullptr);
+		vkDestroyPipelineLayout(parent, pipelineLayout, nullptr);
+		vkDestroyDescriptorSetLayout(parent, descriptorSetLayout, nullptr);
+		vkDestroyFramebuffer(parent, framebuffer, nullptr);
+		vkDestroyRenderPass(parent, renderPass, nullptr);
+
+		vmaDestroyBuffer(memoryAllocator, materialDispatchBuffer, materialDispatchAllocation);
+		vmaDestroyBuffer(memoryAllocator, tileListBuffer, tileListAllocation);
+
+		vkDestroyImageView(parent, shadedView, nullptr);
+		vkDestroyImageView(parent, depthView, nullptr);
+		vkDestroyImageView(parent, visibilityView, nullptr);
+		vmaDestroyImage(memoryAllocator, shadedImage, shadedAllocation);
+		vmaDestroyImage(memoryAllocator, depthImage, depthAllocation);
+		vmaDestroyImage(memoryAllocator, visibilityImage, visibilityAllocation);
+	}
+
+	void VisibilityBuffer::BindScene(VkBuffer drawBuffer, VkBuffer materialBuffer, uint32_t materialCount)
+	{
+		assert(materialCount <= maxMaterialCount);
+		boundMaterialCount = materialCount;
+
+		VkDescriptorBufferInfo drawBufferInfo{ drawBuffer, 0, VK_WHOLE_SIZE };
+		VkDescriptorBufferInfo materialBufferInfo{ materialBuffer, 0, VK_WHOLE_SIZE };
+
+		std::array descriptorWrites
+		{
+			VkWriteDescriptorSet{ .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, .dstSet = descriptorSet, .dstBinding = 0, .descriptorCount = 1, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .pBufferInfo = &drawBufferInfo },
+			VkWriteDescriptorSet{ .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, .dstSet = descriptorSet, .dstBinding = 1, .descriptorCount = 1, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .pBufferInfo = &materialBufferInfo }
+		};
+
+		vkUpdateDescriptorSets(parent, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+	}
+
+	void VisibilityBuffer::RecordGeometry(VkCommandBuffer commandBuffer, VkBuffer indexBuffer, const std::vector<VisibilityDraw>& draws, const glm::mat4& viewProjection) const
+	{
+		assert(draws.size() <= maxDrawCount);
+		//Triangles past the triangle index bits would alias the first ones of the next draw
+		assert(std::all_of(draws.begin(), draws.end(), [](const VisibilityDraw& draw) { return draw.indexCount / 3 <= (1u << triangleIdBits); }));
+
+		std::array<VkClearValue, 2> clearValues{};
+		clearValues[0].color.uint32[0] = emptyVisibility;
+		clearValues[1].depthStencil = { reversedDepth ? 0.0f : 1.0f, 0 };
+
+		VkRenderPassBeginInfo renderPassInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+			.renderPass = renderPass,
+			.framebuffer = framebuffer,
+			.renderArea = { { 0, 0 }, extent },
+			.clearValueCount = static_cast<uint32_t>(clearValues.size()),
+			.pClearValues = clearValues.data()
+		};
+
+		vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, geometryPipeline);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+		vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+
+		VisibilityConstants constants
+		{
+			.viewProjection = viewProjection,
+			.tileCount = tileCountX * tileCountY,
+			.extentWidth = extent.width,
+			.extentHeight = extent.height
+		};
+
+		for (uint32_t drawIndex{}; drawIndex < draws.size(); ++drawIndex)
+		{
+			constants.drawOrMaterialIndex = drawIndex;
+			vkCmdPushConstants(commandBuffer, pipelineLayout, visibilityStages, 0, sizeof(VisibilityConstants), &constants);
+			vkCmdDrawIndexed(commandBuffer, draws[drawIndex].indexCount, 1, draws[drawIndex].firstIndex, 0, 0);
+		}
+
+		vkCmdEndRenderPass(commandBuffer);
+	}
+
+	void VisibilityBuffer::RecordResolve(VkCommandBuffer commandBuffer, const glm::mat4& viewProjection, const glm::vec3& lightDirection, float ambient) const
+	{
+		std::array<VkDispatchIndirectCommand, maxMaterialCount> emptyDispatches{};
+		for (auto& dispatch : emptyDispatches)
+		{
+			dispatch = VkDispatchIndirectCommand{ 0, 1, 1 };
+		}
+
+		vkCmdUpdateBuffer(commandBuffer, materialDispatchBuffer, 0, sizeof(emptyDispatches), emptyDispatches.data());
+
+		VkMemoryBarrier resetBarrier
+		{
+			.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+			.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+			.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT
+		};
+
+		//The shaded image is fully rewritten every frame
+		VkImageMemoryBarrier shadedBarrier
+		{
+			.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+			.srcAccessMask = 0,
+			.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+			.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+			.newLayout = VK_IMAGE_LAYOUT_GENERAL,
+			.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+			.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+			.image = shadedImage,
+			.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 }
+		};
+
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &resetBarrier, 0, nullptr, 1, &shadedBarrier);
+
+		VisibilityConstants constants
+		{
+			.viewProjection = viewProjection,
+			.lightDirection = glm::vec4{ lightDirection, ambient },
+			.tileCount = tileCountX * tileCountY,
+			.extentWidth = extent.width,
+			.extentHeight = extent.height
+		};
+
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+		vkCmdPushConstants(commandBuffer, pipelineLayout, visibilityStages, 0, sizeof(VisibilityConstants), &constants);
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, classifyPipeline);
+		vkCmdDispatch(commandBuffer, tileCountX, tileCountY, 1);
+
+		VkMemoryBarrier classifyBarrier
+		{
+			.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+			.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+			.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT
+		};
+
+		vkCmdPipelineBarrier(	commandBuffer,
+								VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+								VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+								0, 1, &classifyBarrier, 0, nullptr, 0, nullptr);
+
+		//One indirect dispatch per material over only the tiles it covers
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, resolvePipeline);
+		for (uint32_t materialIndex{}; materialIndex < boundMaterialCount; ++materialIndex)
+		{
+			constants.drawOrMaterialIndex = materialIndex;
+			vkCmdPushConstants(commandBuffer, pipelineLayout, visibilityStages, 0, sizeof(VisibilityConstants), &constants);
+			vkCmdDispatchIndirect(commandBuffer, materialDispatchBuffer, sizeof(VkDispatchIndirectCommand) * materialIndex);
+		}
+
+		VkImageMemoryBarrier resolveBarrier
+		{
+			.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+			.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+			.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+			.oldLayout = VK_IMAGE_LAYOUT_GENERAL,
+			.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+			.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+			.image = shadedImage,
+			.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 }
+		};
+
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &resolveBarrier);
+	}
+}
@@ -0,0 +1,219 @@
+#include "Utils/CpuProfiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+
+namespace cof
+{
+	//A ring slot, written by the owning thread while WriteChromeTrace may read it. sequence is the index of the zone in
+	//the slot plus one, and zero while the slot is being overwritten, so a reader can tell a torn zone from a whole one
+	struct CpuZoneSlot
+	{
+		std::atomic<uint64_t> sequence{ 0 };
+		std::atomic<const char*> name{ nullptr };
+		std::atomic<uint64_t> beginTicks{ 0 };
+		std::atomic<uint64_t> endTicks{ 0 };
+	};
+
+	struct ThreadZones
+	{
+		std::unique_ptr<CpuZoneSlot[]> events;
+		//Zones ever recorded, only the owning thread writes it
+		std::atomic<uint64_t> count{ 0 };
+		uint32_t threadIndex;
+		//Guarded by the registry's mutex
+		std::string name;
+	};
+
+	//Outlives the threads, so a trace still has the zones of threads that exited
+	struct ZoneRegistry
+	{
+		std::mutex mutex;
+		std::vector<std::unique_ptr<ThreadZones>> threads;
+	};
+
+	//Tick and time at startup, ticks are converted to microseconds since then
+	struct ClockAnchor
+	{
+		uint64_t ticks;
+		std::chrono::steady_clock::time_point time;
+	};
+
+	static const ClockAnchor startAnchor{ CpuTicks(), std::chrono::steady_clock::now() };
+	static thread_local ThreadZones* threadZones{ nullptr };
+
+	static ZoneRegistry& Registry()
+	{
+		static ZoneRegistry registry;
+		return registry;
+	}
+
+	static ThreadZones& CurrentThreadZones()
+	{
+		if (threadZones == nullptr)
+		{
+			ZoneRegistry& registry{ Registry() };
+			const std::lock_guard lock{ registry.mutex };
+
+			auto zones{ std::make_unique<ThreadZones>() };
+			zones->events = std::make_unique<CpuZoneSlot[]>(cpuZoneCapacity);
+			zones->threadIndex = static_cast<uint32_t>(registry.threads.size());
+			zones->name = "Thread " + std::to_string(zones->threadIndex);
+
+			threadZones = zones.get();
+			registry.threads.push_back(std::move(zones));
+		}
+
+		return *threadZones;
+	}
+
+	//The time stamp counter runs at a constant rate on every CPU since invariant TSC, measured against steady_clock
+	static double NanosecondsPerTick() noexcept
+	{
+#if defined(COF_HAS_RDTSC)
+		const uint64_t ticks{ CpuTicks() };
+		const std::chrono::duration<double, std::nano> elapsed{ std::chrono::steady_clock::now() - startAnchor.time };
+		return ticks > startAnchor.ticks ? elapsed.count() / static_cast<double>(ticks - startAnchor.ticks) : 1.0;
+#else
+		return 1.0;
+#endif
+	}
+
+	static void WriteEscaped(std::ofstream& trace, std::string_view text)
+	{
+		for (const char character : text)
+		{
+			if (character == '"' || character == '\\')
+			{
+				trace << '\\' << character;
+			}
+			else if (static_cast<unsigned char>(character) >= 0x20)
+			{
+				trace << character;
+			}
+		}
+	}
+
+	static void WriteThreadName(std::ofstream& trace, uint32_t threadIndex, std::string_view name)
+	{
+		trace << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << threadIndex << ",\"args\":{\"name\":\"";
+		WriteEscaped(trace, name);
+		trace << "\"}}";
+	}
+
+	static void WriteZone(std::ofstream& trace, uint32_t threadIndex, std::string_view name, double beginMicroseconds, double durationMicroseconds)
+	{
+		char times[64];
+		snprintf(times, sizeof(times), "\"ts\":%.3f,\"dur\":%.3f", beginMicroseconds, durationMicroseconds);
+
+		trace << "{\"name\":\"";
+		WriteEscaped(trace, name);
+		trace << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << threadIndex << ',' << times << '}';
+	}
+
+	void RecordCpuZone(const char* name, uint64_t beginTicks, uint64_t endTicks) noexcept
+	{
+		ThreadZones& zones{ CurrentThreadZones() };
+		const uint64_t index{ zones.count.load(std::memory_order_relaxed) };
+		CpuZoneSlot& slot{ zones.events[index % cpuZoneCapacity] };
+
+		//The fence keeps the zone's stores behind the invalidation, a reader that sees any of them sees the slot invalid
+		slot.sequence.store(0, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		slot.name.store(name, std::memory_order_relaxed);
+		slot.beginTicks.store(beginTicks, std::memory_order_relaxed);
+		slot.endTicks.store(endTicks, std::memory_order_relaxed);
+		slot.sequence.store(index + 1, std::memory_order_release);
+		zones.count.store(index + 1, std::memory_order_release);
+	}
+
+	void SetCpuThreadName(std::string_view name)
+	{
+		ThreadZones& zones{ CurrentThreadZones() };
+		const std::lock_guard lock{ Registry().mutex };
+		zones.name = name;
+	}
+
+	bool WriteChromeTrace(const char* path, const std::vector<TraceEvent>& extraEvents)
+	{
+		std::ofstream trace{ path };
+		if (!trace)
+		{
+			return false;
+		}
+
+		const double microsecondsPerTick{ NanosecondsPerTick() * 1e-3 };
+		auto toMicroseconds = [microsecondsPerTick](uint64_t ticks)
+		{
+			return (static_cast<double>(ticks) - static_cast<double>(startAnchor.ticks)) * microsecondsPerTick;
+		};
+
+		trace << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+		bool first{ true };
+		auto separate = [&first, &trace]()
+		{
+			trace << (first ? "" : ",\n");
+			first = false;
+		};
+
+		ZoneRegistry& registry{ Registry() };
+		{
+			const std::lock_guard lock{ registry.mutex };
+			for (const std::unique_ptr<ThreadZones>& zones : registry.threads)
+			{
+				separate();
+				WriteThreadName(trace, zones->threadIndex, zones->name);
+
+				const uint64_t count{ zones->count.load(std::memory_order_acquire) };
+				for (uint64_t event{ count > cpuZoneCapacity ? count - cpuZoneCapacity : 0 }; event < count; ++event)
+				{
+					//Zones the thread overwrote since count was read, or is overwriting, are left out
+					const CpuZoneSlot& slot{ zones->events[event % cpuZoneCapacity] };
+					if (slot.sequence.load(std::memory_order_acquire) != event + 1)
+					{
+						continue;
+					}
+
+					const char* name{ slot.name.load(std::memory_order_relaxed) };
+					const uint64_t beginTicks{ slot.beginTicks.load(std::memory_order_relaxed) };
+					const uint64_t endTicks{ slot.endTicks.load(std::memory_order_relaxed) };
+					std::atomic_thread_fence(std::memory_order_acquire);
+					if (slot.sequence.load(std::memory_order_relaxed) != event + 1)
+					{
+						continue;
+					}
+
+					separate();
+					WriteZone(trace, zones->threadIndex, name, toMicroseconds(beginTicks), static_cast<double>(endTicks - beginTicks) * microsecondsPerTick);
+				}
+			}
+		}
+
+		//Every other track gets a thread id past the CPU threads, in order of appearance
+		constexpr uint32_t firstTrackIndex{ 0x10000 };
+		std::vector<std::string_view> tracks;
+		for (const TraceEvent& event : extraEvents)
+		{
+			auto track{ std::find(tracks.begin(), tracks.end(), event.track) };
+			if (track == tracks.end())
+			{
+				tracks.push_back(event.track);
+				track = tracks.end() - 1;
+
+				separate();
+				WriteThreadName(trace, firstTrackIndex + static_cast<uint32_t>(tracks.size() - 1), event.track);
+			}
+
+			separate();
+			WriteZone(trace, firstTrackIndex + static_cast<uint32_t>(track - tracks.begin()), event.name,
+				toMicroseconds(event.anchorTicks) + event.beginMicroseconds, event.durationMicroseconds);
+		}
+
+		trace << "\n]}\n";
+		return static_cast<bool>(trace);
+	}
+}
@@ -0,0 +1,274 @@
+#include "Utils/Image.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <csetjmp>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+#include <jpeglib.h>
+#include <jerror.h>
+#include <png.h>
+
+namespace cof
+{
+	static std::byte ClampToByte(float value) noexcept
+	{
+		return static_cast<std::byte>(static_cast<uint32_t>(std::clamp(value + 0.5f, 0.0f, 255.0f)));
+	}
+
+	//libjpeg reports errors through error_exit, which must not return. It jumps back into ReadJpeg
+	struct JpegErrorManager
+	{
+		jpeg_error_mgr manager;
+		std::jmp_buf jumpBuffer;
+		//libjpeg only warns when the data ends early and fills the rest of the image with gray
+		bool truncated;
+	};
+
+	static void ExitJpegDecoder(j_common_ptr decoder)
+	{
+		std::longjmp(reinterpret_cast<JpegErrorManager*>(decoder->err)->jumpBuffer, 1);
+	}
+
+	static void NoteJpegMessage(j_common_ptr decoder, int level)
+	{
+		if (level < 0 && decoder->err->msg_code == JWRN_JPEG_EOF)
+		{
+			reinterpret_cast<JpegErrorManager*>(decoder->err)->truncated = true;
+		}
+	}
+
+	//Locals of the function calling setjmp are indeterminate after the longjmp if they changed in between,
+	//so the decode writes only through references and the caller owns the results
+	static bool ReadJpeg(jpeg_decompress_struct& decoder, JpegErrorManager& errorManager, const std::vector<std::byte>& data, Image& image, std::vector<JSAMPROW>& rows)
+	{
+		if (setjmp(errorManager.jumpBuffer))
+		{
+			return false;
+		}
+
+		jpeg_mem_src(&decoder, reinterpret_cast<const unsigned char*>(data.data()), static_cast<unsigned long>(data.size()));
+		jpeg_read_header(&decoder, TRUE);
+		decoder.out_color_space = JCS_RGB;
+		jpeg_start_decompress(&decoder);
+
+		image.width = decoder.output_width;
+		image.height = decoder.output_height;
+		image.texels.resize(static_cast<size_t>(image.width) * image.height * 4);
+
+		//Scanlines are decoded as RGB into the front of each RGBA row and spread out from the back
+		rows.resize(image.height);
+		for (uint32_t y{}; y < image.height; ++y)
+		{
+			rows[y] = reinterpret_cast<JSAMPROW>(image.texels.data() + static_cast<size_t>(y) * image.width * 4);
+		}
+		while (decoder.output_scanline < decoder.output_height)
+		{
+			jpeg_read_scanlines(&decoder, rows.data() + decoder.output_scanline, decoder.output_height - decoder.output_scanline);
+		}
+		jpeg_finish_decompress(&decoder);
+		return !errorManager.truncated;
+	}
+
+	static std::optional<Image> DecodeJpeg(const std::vector<std::byte>& data)
+	{
+		jpeg_decompress_struct decoder{};
+		JpegErrorManager errorManager{};
+		decoder.err = jpeg_std_error(&errorManager.manager);
+		errorManager.manager.error_exit = ExitJpegDecoder;
+		errorManager.manager.emit_message = NoteJpegMessage;
+		jpeg_create_decompress(&decoder);
+
+		Image image{};
+		std::vector<JSAMPROW> rows;
+		const bool decoded{ ReadJpeg(decoder, errorManager, data, image, rows) };
+		jpeg_destroy_decompress(&decoder);
+		if (!decoded)
+		{
+			return std::nullopt;
+		}
+
+		for (JSAMPROW row : rows)
+		{
+			for (uint32_t x{ image.width }; x-- > 0;)
+			{
+				row[x * 4 + 3] = 0xff;
+				row[x * 4 + 2] = row[x * 3 + 2];
+				row[x * 4 + 1] = row[x * 3 + 1];
+				row[x * 4 + 0] = row[x * 3 + 0];
+			}
+		}
+
+		return image;
+	}
+
+	struct PngSource
+	{
+		const std::vector<std::byte>& data;
+		size_t position;
+	};
+
+	static void ReadPngData(png_structp decoder, png_bytep destination, png_size_t size)
+	{
+		PngSource& source{ *static_cast<PngSource*>(png_get_io_ptr(decoder)) };
+		if (size > source.data.size() - source.position)
+		{
+			png_error(decoder, "Read past the end of the data");
+		}
+		std::memcpy(destination, source.data.data() + source.position, size);
+		source.position += size;
+	}
+
+	//Like libjpeg, errors jump back into ReadPng without printing
+	static void ExitPngDecoder(png_structp decoder, png_const_charp)
+	{
+		png_longjmp(decoder, 1);
+	}
+
+	static void IgnorePngWarning(png_structp, png_const_charp)
+	{
+	}
+
+	static bool ReadPng(png_structp decoder, png_infop info, PngSource& source, Image& image, std::vector<png_bytep>& rows)
+	{
+		if (setjmp(png_jmpbuf(decoder)))
+		{
+			return false;
+		}
+
+		png_set_read_fn(decoder, &source, ReadPngData);
+		png_read_info(decoder, info);
+
+		//Every color type and bit depth becomes 8 bit RGBA. 16 bit channels keep their high byte
+		png_set_strip_16(decoder);
+		png_set_packing(decoder);
+		png_set_palette_to_rgb(decoder);
+		png_set_expand_gray_1_2_4_to_8(decoder);
+		png_set_tRNS_to_alpha(decoder);
+		png_set_gray_to_rgb(decoder);
+		png_set_filler(decoder, 0xff, PNG_FILLER_AFTER);
+		png_set_interlace_handling(decoder);
+		png_read_update_info(decoder, info);
+
+		image.width = png_get_image_width(decoder, info);
+		image.height = png_get_image_height(decoder, info);
+		image.texels.resize(static_cast<size_t>(image.width) * image.height * 4);
+		rows.resize(image.height);
+		for (uint32_t y{}; y < image.height; ++y)
+		{
+			rows[y] = reinterpret_cast<png_bytep>(image.texels.data() + static_cast<size_t>(y) * image.width * 4);
+		}
+		png_read_image(decoder, rows.data());
+		png_read_end(decoder, nullptr);
+		return true;
+	}
+
+	static std::optional<Image> DecodePng(const std::vector<std::byte>& data)
+	{
+		if (data.size() < 8 || png_sig_cmp(reinterpret_cast<png_const_bytep>(data.data()), 0, 8) != 0)
+		{
+			return std::nullopt;
+		}
+
+		png_structp decoder{ png_create_read_struct(PNG_LIBPNG_VER_STRING, nullptr, ExitPngDecoder, IgnorePngWarning) };
+		if (!decoder)
+		{
+			return std::nullopt;
+		}
+		png_infop info{ png_create_info_struct(decoder) };
+
+		Image image{};
+		std::vector<png_bytep> rows;
+		PngSource source{ .data = data, .position = 0 };
+		const bool decoded{ info && ReadPng(decoder, info, source, image, rows) };
+		png_destroy_read_struct(&decoder, &info, nullptr);
+		if (!decoded)
+		{
+			return std::nullopt;
+		}
+		return image;
+	}
+
+	std::optional<Image> DecodeImage(const std::vector<std::byte>& data)
+	{
+		if (data.size() >= 2 && data[0] == std::byte{ 0xff } && data[1] == std::byte{ 0xd8 })
+		{
+			return DecodeJpeg(data);
+		}
+		return DecodePng(data);
+	}
+
+	std::optional<Image> LoadImageFile(const std::filesystem::path& path)
+	{
+		std::ifstream file{ path, std::ios::binary };
+		if (!file)
+		{
+			return std::nullopt;
+		}
+
+		const std::vector<char> bytes{ std::istreambuf_iterator<char>{ file }, std::istreambuf_iterator<char>{} };
+		std::vector<std::byte> data(bytes.size());
+		std::memcpy(data.data(), bytes.data(), bytes.size());
+		return DecodeImage(data);
+	}
+
+	Image DownsampleImage(const Image& image)
+	{
+		static const std::array<float, 256> toLinear{ []()
+		{
+			std::array<float, 256> linear{};
+			for (uint32_t value{}; value < 256; ++value)
+			{
+				const float srgb{ static_cast<float>(value) / 255.0f };
+				linear[value] = srgb <= 0.04045f ? srgb / 12.92f : std::pow((srgb + 0.055f) / 1.055f, 2.4f);
+			}
+			return linear;
+		}() };
+
+		auto toSrgb = [](float linear)
+		{
+			const float srgb{ linear <= 0.0031308f ? linear * 12.92f : 1.055f * std::pow(linear, 1.0f / 2.4f) - 0.055f };
+			return ClampToByte(srgb * 255.0f);
+		};
+
+		Image mip{ .width = std::max(image.width / 2, 1u), .height = std::max(image.height / 2, 1u) };
+		mip.texels.resize(static_cast<size_t>(mip.width) * mip.height * 4);
+
+		for (uint32_t y{}; y < mip.height; ++y)
+		{
+			//A side of one texel has nothing to average with
+			const uint32_t sourceRows[]{ std::min(2 * y, image.height - 1), std::min(2 * y + 1, image.height - 1) };
+			for (uint32_t x{}; x < mip.width; ++x)
+			{
+				const uint32_t sourceColumns[]{ std::min(2 * x, image.width - 1), std::min(2 * x + 1, image.width - 1) };
+
+				float sums[4]{};
+				for (uint32_t sourceRow : sourceRows)
+				{
+					for (uint32_t sourceColumn : sourceColumns)
+					{
+						const std::byte* texel{ image.texels.data() + (static_cast<size_t>(sourceRow) * image.width + sourceColumn) * 4 };
+						for (size_t channel{}; channel < 3; ++channel)
+						{
+							sums[channel] += toLinear[std::to_integer<size_t>(texel[channel])];
+						}
+						sums[3] += static_cast<float>(std::to_integer<uint32_t>(texel[3]));
+					}
+				}
+
+				std::byte* texel{ mip.texels.data() + (static_cast<size_t>(y) * mip.width + x) * 4 };
+				for (size_t channel{}; channel < 3; ++channel)
+				{
+					texel[channel] = toSrgb(sums[channel] * 0.25f);
+				}
+				texel[3] = ClampToByte(sums[3] * 0.25f);
+			}
+		}
+
+		return mip;
+	}
+}
@@ -0,0 +1,192 @@
+#include "UnitTest.h"
+
+#include "Graphics/GltfDocument.h"
+
+#include <glm/ext/vector_float3.hpp>
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+static std::string EncodeBase64(const std::vector<std::byte>& data)
+{
+	constexpr char alphabet[]{ "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/" };
+	std::string text;
+	for (size_t byte{}; byte < data.size(); byte += 3)
+	{
+		uint32_t bits{ std::to_integer<uint32_t>(data[byte]) << 16 };
+		bits |= byte + 1 < data.size() ? std::to_integer<uint32_t>(data[byte + 1]) << 8 : 0;
+		bits |= byte + 2 < data.size() ? std::to_integer<uint32_t>(data[byte + 2]) : 0;
+
+		text += alphabet[bits >> 18 & 63];
+		text += alphabet[bits >> 12 & 63];
+		text += byte + 1 < data.size() ? alphabet[bits >> 6 & 63] : '=';
+		text += byte + 2 < data.size() ? alphabet[bits & 63] : '=';
+	}
+	return text;
+}
+
+//One triangle, three float positions followed by three unsigned short indices
+static std::vector<std::byte> TriangleBuffer()
+{
+	const float positions[]{ 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f };
+	const uint16_t indices[]{ 0, 1, 2 };
+
+	std::vector<std::byte> data(sizeof(positions) + sizeof(indices));
+	std::memcpy(data.data(), positions, sizeof(positions));
+	std::memcpy(data.data() + sizeof(positions), indices, sizeof(indices));
+	return data;
+}
+
+//accessors and nodes are spliced in as JSON, the buffer and its two views are fixed
+static std::string TriangleDocument(const std::string& accessors, const std::string& nodes)
+{
+	const std::vector<std::byte> buffer{ TriangleBuffer() };
+	return R"({
+		"asset": { "version": "2.0" },
+		"scene": 0,
+		"scenes": [ { "nodes": [ 0 ] } ],
+		"buffers": [ { "byteLength": )" + std::to_string(buffer.size()) + R"(, "uri": "data:application/octet-stream;base64,)" + EncodeBase64(buffer) + R"(" } ],
+		"bufferViews": [ { "buffer": 0, "byteOffset": 0, "byteLength": 36 }, { "buffer": 0, "byteOffset": 36, "byteLength": 6 } ],
+		"accessors": )" + accessors + R"(,
+		"meshes": [ { "name": "Triangle", "primitives": [ { "attributes": { "POSITION": 0 }, "indices": 1, "material": 0 } ] } ],
+		"materials": [ { "pbrMetallicRoughness": { "baseColorFactor": [ 0.5, 0.25, 1.0, 1.0 ], "baseColorTexture": { "index": 0 } } } ],
+		"textures": [ { "source": 0 } ],
+		"images": [ { "uri": "albedo.png" } ],
+		"nodes": )" + nodes + R"(
+	})";
+}
+
+static const std::string triangleAccessors{ R"([
+	{ "bufferView": 0, "componentType": 5126, "count": 3, "type": "VEC3" },
+	{ "bufferView": 1, "componentType": 5123, "count": 3, "type": "SCALAR" }
+])" };
+
+UNIT_TEST(ParseGltfReadsTriangle)
+{
+	const std::optional<cof::GltfDocument> document{ cof::ParseGltf(TriangleDocument(triangleAccessors, R"([ { "mesh": 0 } ])"), {}) };
+	EXPECT(document.has_value());
+	if (!document)
+	{
+		return;
+	}
+
+	EXPECT(document->scene == 0 && document->scenes.size() == 1 && document->scenes[0] == std::vector<uint32_t>{ 0 });
+	EXPECT(document->buffers.size() == 1 && document->buffers[0] == TriangleBuffer());
+	EXPECT(document->meshes.size() == 1 && document->meshes[0].name == "Triangle");
+	EXPECT(document->nodes.size() == 1 && document->nodes[0].mesh == 0 && document->nodes[0].children.empty());
+
+	const cof::GltfDocument::Primitive& primitive{ document->meshes[0].primitives[0] };
+	EXPECT(primitive.position == 0 && primitive.indices == 1 && primitive.material == 0);
+	EXPECT(primitive.normal == cof::GltfDocument::noIndex && primitive.texCoord == cof::GltfDocument::noIndex);
+	EXPECT(primitive.mode == cof::GltfDocument::modeTriangles);
+
+	EXPECT(document->materials.size() == 1 && document->materials[0].baseColorFactor == glm::vec4(0.5f, 0.25f, 1.0f, 1.0f));
+	EXPECT(document->materials[0].baseColorTexture == 0 && document->textureSources == std::vector<uint32_t>{ 0 });
+	EXPECT(document->imageUris == std::vector<std::string>{ "albedo.png" });
+
+	const std::optional<cof::GltfAccessorView> positions{ document->ResolveAccessor(primitive.position) };
+	const std::optional<cof::GltfAccessorView> indices{ document->ResolveAccessor(primitive.indices) };
+	EXPECT(positions && positions->count == 3 && positions->stride == 12 && positions->componentCount == 3);
+	EXPECT(indices && indices->count == 3 && indices->stride == 2 && indices->componentType == cof::GltfDocument::componentTypeUnsignedShort);
+	if (!positions || !indices)
+	{
+		return;
+	}
+
+	float secondPosition[3];
+	std::memcpy(secondPosition, positions->data + positions->stride, sizeof(secondPosition));
+	EXPECT(secondPosition[0] == 1.0f && secondPosition[1] == 0.0f && secondPosition[2] == 0.0f);
+
+	uint16_t lastIndex;
+	std::memcpy(&lastIndex, indices->data + 2 * indices->stride, sizeof(lastIndex));
+	EXPECT(lastIndex == 2);
+}
+
+UNIT_TEST(ParseGltfComposesNodeTransform)
+{
+	//Translation * rotation * scale, the rotation turns x into y
+	const std::optional<cof::GltfDocument> document{ cof::ParseGltf(TriangleDocument(triangleAccessors, R"([
+		{ "translation": [ 1, 2, 3 ], "rotation": [ 0, 0, 0.70710678, 0.70710678 ], "scale": [ 2, 2, 2 ], "children": [ 1 ] },
+		{ "matrix": [ 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 5, 6, 7, 1 ], "mesh": 0 }
+	])"), {}) };
+	EXPECT(document && document->nodes.size() == 2);
+	if (!document || document->nodes.size() != 2)
+	{
+		return;
+	}
+
+	const glm::vec3 transformed{ document->nodes[0].transform * glm::vec4{ 1.0f, 0.0f, 0.0f, 1.0f } };
+	EXPECT_NEAR(transformed.x, 1.0f, 1e-5f);
+	EXPECT_NEAR(transformed.y, 4.0f, 1e-5f);
+	EXPECT_NEAR(transformed.z, 3.0f, 1e-5f);
+	EXPECT(document->nodes[0].mesh == cof::GltfDocument::noIndex && document->nodes[0].children == std::vector<uint32_t>{ 1 });
+
+	//Matrices are column major
+	EXPECT(document->nodes[1].transform[3] == glm::vec4(5.0f, 6.0f, 7.0f, 1.0f));
+}
+
+UNIT_TEST(ParseGltfTreatsWrongTypesAsMissing)
+{
+	const std::optional<cof::GltfDocument> document{ cof::ParseGltf(TriangleDocument(R"([
+		{ "bufferView": "0", "componentType": 5126, "count": 3, "type": "VEC3" },
+		{ "bufferView": 1, "componentType": 5123, "count": -3, "type": 1 }
+	])", R"([ { "mesh": "0", "children": 1, "scale": "large" } ])"), {}) };
+	EXPECT(document.has_value());
+	if (!document)
+	{
+		return;
+	}
+
+	EXPECT(document->accessors[0].bufferView == cof::GltfDocument::noIndex);
+	EXPECT(document->accessors[1].count == 0 && document->accessors[1].componentCount == 0);
+	EXPECT(!document->ResolveAccessor(0) && !document->ResolveAccessor(1));
+	EXPECT(document->nodes[0].mesh == cof::GltfDocument::noIndex && document->nodes[0].children.empty());
+	for (int column{}; column < 4; ++column)
+	{
+		EXPECT(document->nodes[0].transform[column] == glm::mat4{ 1.0f }[column]);
+	}
+}
+
+UNIT_TEST(ResolveAccessorChecksBounds)
+{
+	const std::optional<cof::GltfDocument> document{ cof::ParseGltf(TriangleDocument(R"([
+		{ "bufferView": 0, "componentType": 5126, "count": 4, "type": "VEC3" },
+		{ "bufferView": 1, "byteOffset": 2, "componentType": 5123, "count": 2, "type": "SCALAR" },
+		{ "bufferView": 0, "componentType": 5126, "count": 3, "type": "VEC3", "sparse": {} },
+		{ "bufferView": 0, "componentType": 5126, "count": 1, "type": "MAT4" },
+		{ "bufferView": 7, "componentType": 5126, "count": 1, "type": "VEC3" },
+		{ "bufferView": 1, "componentType": 5123, "count": 0, "type": "SCALAR" }
+	])", "[]"), {}) };
+	EXPECT(document && document->accessors.size() == 6);
+	if (!document)
+	{
+		return;
+	}
+
+	//Past the end of its view, fits with its offset, sparse, a matrix, a missing view and empty
+	EXPECT(!document->ResolveAccessor(0));
+	EXPECT(document->ResolveAccessor(1) && document->ResolveAccessor(1)->count == 2);
+	EXPECT(!document->ResolveAccessor(2));
+	EXPECT(!document->ResolveAccessor(3));
+	EXPECT(!document->ResolveAccessor(4));
+	EXPECT(document->ResolveAccessor(5) && document->ResolveAccessor(5)->count == 0);
+	EXPECT(!document->ResolveAccessor(6));
+	EXPECT(!document->ResolveAccessor(cof::GltfDocument::noIndex));
+}
+
+UNIT_TEST(ParseGltfRejectsMalformedDocuments)
+{
+	const std::string valid{ TriangleDocument(triangleAccessors, "[]") };
+	EXPECT(cof::ParseGltf(valid, {}).has_value());
+
+	EXPECT(!cof::ParseGltf("", {}));
+	EXPECT(!cof::ParseGltf(valid.substr(0, valid.size() / 2), {}));
+	EXPECT(!cof::ParseGltf(R"({ "buffers": [ { "byteLength": 4, "uri": "data:application/octet-stream;base64,AA!=" } ] })", {}));
+	EXPECT(!cof::ParseGltf(R"({ "buffers": [ { "byteLength": 8, "uri": "data:application/octet-stream;base64,AAAA" } ] })", {}));
+	EXPECT(!cof::ParseGltf(R"({ "buffers": [ { "byteLength": 8, "uri": "missing.bin" } ] })", "NomadTestsMissingDirectory"));
+
+	//Valid JSON that isn't much of a glTF still parses, there's just nothing in it
+	const std::optional<cof::GltfDocument> empty{ cof::ParseGltf("[ 1, 2 ]", {}) };
+	EXPECT(empty && empty->meshes.empty() && empty->scene == cof::GltfDocument::noIndex);
+}
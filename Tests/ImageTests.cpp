@@ -0,0 +1,236 @@
+#include "UnitTest.h"
+
+#include "Utils/Image.h"
+
+#include <jpeglib.h>
+#include <png.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+static int32_t Channel(const cof::Image& image, uint32_t x, uint32_t y, uint32_t channel)
+{
+	return std::to_integer<int32_t>(image.texels[(static_cast<size_t>(y) * image.width + x) * 4 + channel]);
+}
+
+//format is one of png_image's PNG_FORMAT_*, 16 bit formats take uint16_t texels
+static std::vector<std::byte> EncodePng(uint32_t width, uint32_t height, uint32_t format, const void* texels)
+{
+	png_image image{};
+	image.version = PNG_IMAGE_VERSION;
+	image.width = width;
+	image.height = height;
+	image.format = format;
+
+	png_alloc_size_t size{ 0 };
+	png_image_write_to_memory(&image, nullptr, &size, 0, texels, 0, nullptr);
+	std::vector<std::byte> data(size);
+	png_image_write_to_memory(&image, data.data(), &size, 0, texels, 0, nullptr);
+	data.resize(size);
+	return data;
+}
+
+//components is 1 for gray and 3 for RGB
+static std::vector<std::byte> EncodeJpeg(uint32_t width, uint32_t height, int components, const std::vector<uint8_t>& texels)
+{
+	jpeg_compress_struct encoder{};
+	jpeg_error_mgr errorManager{};
+	encoder.err = jpeg_std_error(&errorManager);
+	jpeg_create_compress(&encoder);
+
+	unsigned char* buffer{ nullptr };
+	unsigned long size{ 0 };
+	jpeg_mem_dest(&encoder, &buffer, &size);
+
+	encoder.image_width = width;
+	encoder.image_height = height;
+	encoder.input_components = components;
+	encoder.in_color_space = components == 1 ? JCS_GRAYSCALE : JCS_RGB;
+	jpeg_set_defaults(&encoder);
+	jpeg_set_quality(&encoder, 100, TRUE);
+	jpeg_start_compress(&encoder, TRUE);
+	while (encoder.next_scanline < encoder.image_height)
+	{
+		JSAMPROW row{ const_cast<uint8_t*>(texels.data()) + static_cast<size_t>(encoder.next_scanline) * width * components };
+		jpeg_write_scanlines(&encoder, &row, 1);
+	}
+	jpeg_finish_compress(&encoder);
+	jpeg_destroy_compress(&encoder);
+
+	std::vector<std::byte> data(size);
+	std::memcpy(data.data(), buffer, size);
+	std::free(buffer);
+	return data;
+}
+
+UNIT_TEST(DecodePngAddsOpaqueAlpha)
+{
+	const uint8_t texels[]{ 10, 20, 30, 40, 50, 60, 70, 80, 90, 100, 110, 120, 130, 140, 150, 160, 170, 180 };
+	const std::optional<cof::Image> image{ cof::DecodeImage(EncodePng(3, 2, PNG_FORMAT_RGB, texels)) };
+	EXPECT(image && image->width == 3 && image->height == 2 && image->texels.size() == 3 * 2 * 4);
+	if (!image)
+	{
+		return;
+	}
+
+	for (uint32_t texel{}; texel < 6; ++texel)
+	{
+		for (uint32_t channel{}; channel < 3; ++channel)
+		{
+			EXPECT(Channel(*image, texel % 3, texel / 3, channel) == texels[texel * 3 + channel]);
+		}
+		EXPECT(Channel(*image, texel % 3, texel / 3, 3) == 255);
+	}
+}
+
+UNIT_TEST(DecodePngKeepsAlpha)
+{
+	const uint8_t texels[]{ 255, 0, 0, 0, 0, 255, 0, 128 };
+	const std::optional<cof::Image> image{ cof::DecodeImage(EncodePng(2, 1, PNG_FORMAT_RGBA, texels)) };
+	EXPECT(image && image->texels.size() == sizeof(texels));
+	if (!image)
+	{
+		return;
+	}
+
+	EXPECT(std::memcmp(image->texels.data(), texels, sizeof(texels)) == 0);
+}
+
+UNIT_TEST(DecodePngExpands16BitGray)
+{
+	//Linear formats are written as 16 bit, the decoder keeps the high byte
+	const uint16_t texels[]{ 0x1234, 0xabcd };
+	const std::optional<cof::Image> image{ cof::DecodeImage(EncodePng(2, 1, PNG_FORMAT_LINEAR_Y, texels)) };
+	EXPECT(image && image->width == 2 && image->height == 1);
+	if (!image)
+	{
+		return;
+	}
+
+	for (uint32_t channel{}; channel < 3; ++channel)
+	{
+		EXPECT(Channel(*image, 0, 0, channel) == 0x12);
+		EXPECT(Channel(*image, 1, 0, channel) == 0xab);
+	}
+	EXPECT(Channel(*image, 1, 0, 3) == 255);
+}
+
+UNIT_TEST(DecodeJpegMatchesSource)
+{
+	//Flat color survives JPEG at full quality up to rounding
+	constexpr uint32_t extent{ 16 };
+	std::vector<uint8_t> texels;
+	for (uint32_t texel{}; texel < extent * extent; ++texel)
+	{
+		texels.insert(texels.end(), { 200, 80, 30 });
+	}
+
+	const std::optional<cof::Image> image{ cof::DecodeImage(EncodeJpeg(extent, extent, 3, texels)) };
+	EXPECT(image && image->width == extent && image->height == extent);
+	if (!image)
+	{
+		return;
+	}
+
+	for (uint32_t y{}; y < extent; ++y)
+	{
+		for (uint32_t x{}; x < extent; ++x)
+		{
+			EXPECT_NEAR(Channel(*image, x, y, 0), 200, 3);
+			EXPECT_NEAR(Channel(*image, x, y, 1), 80, 3);
+			EXPECT_NEAR(Channel(*image, x, y, 2), 30, 3);
+			EXPECT(Channel(*image, x, y, 3) == 255);
+		}
+	}
+}
+
+UNIT_TEST(DecodeJpegExpandsGray)
+{
+	const std::vector<uint8_t> texels(8 * 8, 90);
+	const std::optional<cof::Image> image{ cof::DecodeImage(EncodeJpeg(8, 8, 1, texels)) };
+	EXPECT(image && image->width == 8 && image->height == 8);
+	if (!image)
+	{
+		return;
+	}
+
+	for (uint32_t channel{}; channel < 3; ++channel)
+	{
+		EXPECT_NEAR(Channel(*image, 7, 7, channel), 90, 2);
+	}
+	EXPECT(Channel(*image, 7, 7, 3) == 255);
+}
+
+UNIT_TEST(DecodeImageRejectsMalformedData)
+{
+	//Noise, so most of either file is image data
+	constexpr uint32_t extent{ 32 };
+	std::vector<uint8_t> texels(extent * extent * 3);
+	for (size_t texel{}; texel < texels.size(); ++texel)
+	{
+		texels[texel] = static_cast<uint8_t>(texel * 2654435761u >> 24);
+	}
+	std::vector<std::byte> png{ EncodePng(extent, extent, PNG_FORMAT_RGB, texels.data()) };
+	std::vector<std::byte> jpeg{ EncodeJpeg(extent, extent, 3, texels) };
+
+	//Cut off inside the image data, so the headers are intact
+	png.resize(png.size() * 3 / 4);
+	jpeg.resize(jpeg.size() * 3 / 4);
+	EXPECT(!cof::DecodeImage(png));
+	EXPECT(!cof::DecodeImage(jpeg));
+
+	EXPECT(!cof::DecodeImage({}));
+	EXPECT(!cof::DecodeImage(std::vector<std::byte>(64, std::byte{ 0x5a })));
+	EXPECT(!cof::DecodeImage({ std::byte{ 0xff }, std::byte{ 0xd8 }, std::byte{ 0x00 } }));
+}
+
+UNIT_TEST(DownsampleAveragesLinearLight)
+{
+	//Black and white average to half the light, which is 188 in sRGB. Alpha averages as is
+	const cof::Image image
+	{
+		.width = 2,
+		.height = 2,
+		.texels =
+		{
+			std::byte{ 0 }, std::byte{ 0 }, std::byte{ 0 }, std::byte{ 0 },
+			std::byte{ 255 }, std::byte{ 255 }, std::byte{ 255 }, std::byte{ 255 },
+			std::byte{ 255 }, std::byte{ 255 }, std::byte{ 255 }, std::byte{ 0 },
+			std::byte{ 0 }, std::byte{ 0 }, std::byte{ 0 }, std::byte{ 255 }
+		}
+	};
+
+	const cof::Image mip{ cof::DownsampleImage(image) };
+	EXPECT(mip.width == 1 && mip.height == 1 && mip.texels.size() == 4);
+	for (uint32_t channel{}; channel < 3; ++channel)
+	{
+		EXPECT_NEAR(Channel(mip, 0, 0, channel), 188, 1);
+	}
+	EXPECT_NEAR(Channel(mip, 0, 0, 3), 128, 1);
+}
+
+UNIT_TEST(DownsampleClampsOddExtents)
+{
+	//A 3x1 image halves to 1x1 from its first two texels, a 1x1 image stays 1x1
+	const cof::Image image
+	{
+		.width = 3,
+		.height = 1,
+		.texels =
+		{
+			std::byte{ 100 }, std::byte{ 100 }, std::byte{ 100 }, std::byte{ 255 },
+			std::byte{ 100 }, std::byte{ 100 }, std::byte{ 100 }, std::byte{ 255 },
+			std::byte{ 0 }, std::byte{ 0 }, std::byte{ 0 }, std::byte{ 0 }
+		}
+	};
+
+	const cof::Image mip{ cof::DownsampleImage(image) };
+	EXPECT(mip.width == 1 && mip.height == 1);
+	EXPECT_NEAR(Channel(mip, 0, 0, 0), 100, 1);
+	EXPECT(Channel(mip, 0, 0, 3) == 255);
+
+	const cof::Image last{ cof::DownsampleImage(mip) };
+	EXPECT(last.width == 1 && last.height == 1);
+	EXPECT(std::memcmp(last.texels.data(), mip.texels.data(), 4) == 0);
+}
@@ -0,0 +1,201 @@
+#include "UnitTest.h"
+
+#include "Graphics/MeshLod.h"
+
+#include <glm/ext/vector_float3.hpp>
+#include <glm/geometric.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+//A grid of quads in the z = 0 plane facing +z, vertex (x, y) is y * (width + 1) + x
+static std::vector<uint32_t> PlaneIndices(uint32_t width, uint32_t height)
+{
+	std::vector<uint32_t> indices;
+	for (uint32_t y{}; y < height; ++y)
+	{
+		for (uint32_t x{}; x < width; ++x)
+		{
+			const uint32_t corner{ y * (width + 1) + x };
+			const uint32_t above{ corner + width + 1 };
+			indices.insert(indices.end(), { corner, corner + 1, above, corner + 1, above + 1, above });
+		}
+	}
+
+	return indices;
+}
+
+static std::vector<glm::vec3> PlanePositions(uint32_t width, uint32_t height, float bumpHeight = 0.0f)
+{
+	std::vector<glm::vec3> positions;
+	for (uint32_t y{}; y <= height; ++y)
+	{
+		for (uint32_t x{}; x <= width; ++x)
+		{
+			//The center vertex is lifted out of the plane
+			const bool bump{ x == width / 2 && y == height / 2 };
+			positions.push_back(glm::vec3{ static_cast<float>(x), static_cast<float>(y), bump ? bumpHeight : 0.0f });
+		}
+	}
+
+	return positions;
+}
+
+static bool References(const std::vector<uint32_t>& indices, uint32_t vertex)
+{
+	return std::find(indices.begin(), indices.end(), vertex) != indices.end();
+}
+
+static bool AllFacePositiveZ(const std::vector<uint32_t>& indices, const std::vector<glm::vec3>& positions)
+{
+	for (size_t index{}; index < indices.size(); index += 3)
+	{
+		const glm::vec3 normal{ glm::cross(positions[indices[index + 1]] - positions[indices[index]], positions[indices[index + 2]] - positions[indices[index]]) };
+		if (normal.z <= 0.0f)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+UNIT_TEST(SimplifyPlaneWithoutError)
+{
+	const std::vector<uint32_t> indices{ PlaneIndices(8, 8) };
+	const std::vector<glm::vec3> positions{ PlanePositions(8, 8) };
+
+	float error{ -1.0f };
+	const std::vector<uint32_t> simplified{ cof::SimplifyMesh(indices, positions, 0, 1e-3f, error) };
+
+	EXPECT(simplified.size() % 3 == 0);
+	EXPECT(simplified.size() * 4 < indices.size());
+	EXPECT_NEAR(error, 0.0f, 1e-4f);
+	EXPECT(AllFacePositiveZ(simplified, positions));
+	//Moving a corner along either border would cut the plane short
+	for (uint32_t corner : { 0u, 8u, 72u, 80u })
+	{
+		EXPECT(References(simplified, corner));
+	}
+}
+
+UNIT_TEST(SimplifyStopsAtTargetIndexCount)
+{
+	const std::vector<uint32_t> indices{ PlaneIndices(16, 16) };
+	const std::vector<glm::vec3> positions{ PlanePositions(16, 16) };
+
+	float error{};
+	const std::vector<uint32_t> simplified{ cof::SimplifyMesh(indices, positions, indices.size() / 2, 1.0f, error) };
+
+	EXPECT(simplified.size() <= indices.size() / 2);
+	//A pass collapses at most the budget it needs, it doesn't run far past the target
+	EXPECT(simplified.size() >= indices.size() / 4);
+}
+
+UNIT_TEST(SimplifyKeepsWithinTargetError)
+{
+	const std::vector<uint32_t> indices{ PlaneIndices(8, 8) };
+	const std::vector<glm::vec3> positions{ PlanePositions(8, 8, 0.5f) };
+
+	float error{};
+	const std::vector<uint32_t> simplified{ cof::SimplifyMesh(indices, positions, 0, 0.05f, error) };
+
+	EXPECT(simplified.size() < indices.size());
+	EXPECT(error <= 0.05f);
+	//The bump can't be flattened within the error, so it stays
+	EXPECT(References(simplified, 4 * 9 + 4));
+}
+
+UNIT_TEST(SimplifyKeepsSeamVertices)
+{
+	//Two 4 by 4 planes side by side, the right one's first column shares the positions of the left one's last column
+	const std::vector<uint32_t> left{ PlaneIndices(4, 4) };
+	std::vector<glm::vec3> positions{ PlanePositions(4, 4) };
+	const uint32_t rightFirstVertex{ static_cast<uint32_t>(positions.size()) };
+
+	std::vector<uint32_t> indices{ left };
+	for (uint32_t index : left)
+	{
+		indices.push_back(rightFirstVertex + index);
+	}
+	for (const glm::vec3& position : PlanePositions(4, 4))
+	{
+		positions.push_back(position + glm::vec3{ 4.0f, 0.0f, 0.0f });
+	}
+
+	float error{};
+	const std::vector<uint32_t> simplified{ cof::SimplifyMesh(indices, positions, 0, 1e-3f, error) };
+
+	EXPECT(simplified.size() < indices.size());
+	for (uint32_t row{}; row <= 4; ++row)
+	{
+		EXPECT(References(simplified, row * 5 + 4));
+		EXPECT(References(simplified, rightFirstVertex + row * 5));
+	}
+}
+
+UNIT_TEST(BuildLodChainHalvesTriangles)
+{
+	const std::vector<uint32_t> indices{ PlaneIndices(32, 32) };
+	const std::vector<glm::vec3> positions{ PlanePositions(32, 32, 0.25f) };
+
+	const cof::LodChain chain{ cof::BuildLodChain(indices, positions, 4.0f, 5) };
+
+	EXPECT(chain.lods.size() > 1);
+	EXPECT(chain.lods.size() <= 5);
+	EXPECT(chain.lods[0].firstIndex == 0);
+	EXPECT(chain.lods[0].indexCount == indices.size());
+	EXPECT(chain.lods[0].error == 0.0f);
+	for (size_t lod{ 1 }; lod < chain.lods.size(); ++lod)
+	{
+		const cof::MeshLod& previous{ chain.lods[lod - 1] };
+		const cof::MeshLod& current{ chain.lods[lod] };
+		EXPECT(current.firstIndex == previous.firstIndex + previous.indexCount);
+		EXPECT(current.indexCount < previous.indexCount);
+		EXPECT(current.error >= previous.error);
+		EXPECT(current.error <= 4.0f);
+	}
+
+	const cof::MeshLod& last{ chain.lods.back() };
+	EXPECT(chain.indices.size() == static_cast<size_t>(last.firstIndex) + last.indexCount);
+}
+
+UNIT_TEST(BuildLodChainOfEmptyMesh)
+{
+	const cof::LodChain chain{ cof::BuildLodChain({}, {}, 1.0f) };
+
+	EXPECT(chain.lods.size() == 1);
+	EXPECT(chain.lods[0].indexCount == 0);
+}
+
+UNIT_TEST(SelectLodByProjectedError)
+{
+	const cof::LodChain chain
+	{
+		.lods =
+		{
+			cof::MeshLod{ .firstIndex = 0, .indexCount = 300, .error = 0.0f },
+			cof::MeshLod{ .firstIndex = 300, .indexCount = 150, .error = 0.01f },
+			cof::MeshLod{ .firstIndex = 450, .indexCount = 75, .error = 0.1f },
+			cof::MeshLod{ .firstIndex = 525, .indexCount = 36, .error = 1.0f }
+		}
+	};
+
+	//A pixel at distance d covers d / 1000 units
+	EXPECT(cof::SelectLod(chain, 1.0f, 1000.0f, 1.0f) == 0);
+	EXPECT(cof::SelectLod(chain, 10.0f, 1000.0f, 1.0f) == 1);
+	EXPECT(cof::SelectLod(chain, 50.0f, 1000.0f, 1.0f) == 1);
+	EXPECT(cof::SelectLod(chain, 100.0f, 1000.0f, 1.0f) == 2);
+	EXPECT(cof::SelectLod(chain, 1e6f, 1000.0f, 1.0f) == 3);
+	//Allowing more pixels of error picks coarser LODs at the same distance
+	EXPECT(cof::SelectLod(chain, 10.0f, 1000.0f, 10.0f) == 2);
+}
+
+UNIT_TEST(SelectLodOfSingleLod)
+{
+	const cof::LodChain chain{ .lods = { cof::MeshLod{ .firstIndex = 0, .indexCount = 3, .error = 0.0f } } };
+
+	EXPECT(cof::SelectLod(chain, 1e6f, 1.0f, 1.0f) == 0);
+}
@@ -0,0 +1,176 @@
+#include "UnitTest.h"
+
+#include "Graphics/MeshOptimizer.h"
+
+#include <glm/ext/vector_float3.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <vector>
+
+//A grid of quads, two triangles each, emitted column by column so a small cache misses on every row
+static std::vector<uint32_t> GridIndices(uint32_t width, uint32_t height)
+{
+	std::vector<uint32_t> indices;
+	for (uint32_t x{}; x < width; ++x)
+	{
+		for (uint32_t y{}; y < height; ++y)
+		{
+			const uint32_t corner{ y * (width + 1) + x };
+			const uint32_t below{ corner + width + 1 };
+			indices.insert(indices.end(), { corner, below, corner + 1, corner + 1, below, below + 1 });
+		}
+	}
+
+	return indices;
+}
+
+static std::vector<glm::vec3> GridPositions(uint32_t width, uint32_t height)
+{
+	std::vector<glm::vec3> positions;
+	for (uint32_t y{}; y <= height; ++y)
+	{
+		for (uint32_t x{}; x <= width; ++x)
+		{
+			positions.push_back(glm::vec3{ static_cast<float>(x), static_cast<float>(y), 0.0f });
+		}
+	}
+
+	return positions;
+}
+
+//Every triangle rotated so its smallest index comes first, sorted, so reordering triangles compares equal but flipping
+//their winding doesn't
+static std::vector<std::array<uint32_t, 3>> SortedTriangles(const std::vector<uint32_t>& indices)
+{
+	std::vector<std::array<uint32_t, 3>> triangles;
+	for (size_t index{}; index < indices.size(); index += 3)
+	{
+		std::array<uint32_t, 3> triangle{ indices[index], indices[index + 1], indices[index + 2] };
+		std::rotate(triangle.begin(), std::min_element(triangle.begin(), triangle.end()), triangle.end());
+		triangles.push_back(triangle);
+	}
+
+	std::sort(triangles.begin(), triangles.end());
+	return triangles;
+}
+
+UNIT_TEST(AnalyzeVertexCacheOfOneTriangle)
+{
+	const cof::MeshOptimizer::VertexCacheStatistics statistics = cof::MeshOptimizer::AnalyzeVertexCache({ 0, 1, 2 }, 3);
+
+	EXPECT(statistics.triangleCount == 1);
+	EXPECT(statistics.transformedVertexCount == 3);
+	EXPECT_NEAR(statistics.acmr, 3.0f, 1e-6f);
+	EXPECT_NEAR(statistics.atvr, 1.0f, 1e-6f);
+}
+
+UNIT_TEST(AnalyzeVertexCacheHitsRepeatedVertices)
+{
+	const cof::MeshOptimizer::VertexCacheStatistics statistics = cof::MeshOptimizer::AnalyzeVertexCache({ 0, 1, 2, 2, 1, 0 }, 3);
+
+	EXPECT(statistics.transformedVertexCount == 3);
+	EXPECT_NEAR(statistics.acmr, 1.5f, 1e-6f);
+}
+
+UNIT_TEST(AnalyzeVertexCacheIgnoresUnreferencedVertices)
+{
+	const cof::MeshOptimizer::VertexCacheStatistics statistics = cof::MeshOptimizer::AnalyzeVertexCache({ 0, 1, 2 }, 10);
+
+	EXPECT_NEAR(statistics.atvr, 1.0f, 1e-6f);
+}
+
+UNIT_TEST(AnalyzeVertexCacheEvictsFirstIn)
+{
+	//With room for three vertices the fourth pushes out vertex 0, reloading it pushes out vertex 1 even though it was
+	//just hit, so both miss again while vertex 3 still hits
+	const cof::MeshOptimizer::VertexCacheStatistics statistics = cof::MeshOptimizer::AnalyzeVertexCache({ 0, 1, 2, 3, 2, 1, 0, 1, 3 }, 4, 3);
+
+	EXPECT(statistics.transformedVertexCount == 6);
+}
+
+UNIT_TEST(OptimizeVertexCacheKeepsTriangles)
+{
+	const std::vector<uint32_t> indices{ GridIndices(16, 16) };
+	const std::vector<uint32_t> optimized{ cof::MeshOptimizer::OptimizeVertexCache(indices, 17 * 17) };
+
+	EXPECT(SortedTriangles(optimized) == SortedTriangles(indices));
+}
+
+UNIT_TEST(OptimizeVertexCacheLowersAcmr)
+{
+	const std::vector<uint32_t> indices{ GridIndices(32, 32) };
+	const std::vector<uint32_t> optimized{ cof::MeshOptimizer::OptimizeVertexCache(indices, 33 * 33) };
+
+	const float before{ cof::MeshOptimizer::AnalyzeVertexCache(indices, 33 * 33).acmr };
+	const float after{ cof::MeshOptimizer::AnalyzeVertexCache(optimized, 33 * 33).acmr };
+	EXPECT(after < before);
+	//A grid's best possible ACMR is 0.5, Forsyth gets well under 1 with a 16 entry cache
+	EXPECT(after < 0.9f);
+}
+
+UNIT_TEST(OptimizeVertexCacheKeepsDegenerateTriangles)
+{
+	const std::vector<uint32_t> indices{ 0, 1, 2, 2, 2, 3 };
+	const std::vector<uint32_t> optimized{ cof::MeshOptimizer::OptimizeVertexCache(indices, 4) };
+
+	EXPECT(SortedTriangles(optimized) == SortedTriangles(indices));
+}
+
+UNIT_TEST(OptimizeOverdrawKeepsTrianglesWithinThreshold)
+{
+	const std::vector<uint32_t> indices{ cof::MeshOptimizer::OptimizeVertexCache(GridIndices(32, 32), 33 * 33) };
+	const std::vector<uint32_t> sorted{ cof::MeshOptimizer::OptimizeOverdraw(indices, GridPositions(32, 32)) };
+
+	EXPECT(SortedTriangles(sorted) == SortedTriangles(indices));
+
+	const float before{ cof::MeshOptimizer::AnalyzeVertexCache(indices, 33 * 33).acmr };
+	const float after{ cof::MeshOptimizer::AnalyzeVertexCache(sorted, 33 * 33).acmr };
+	EXPECT(after <= before * 1.05f + 1e-6f);
+}
+
+UNIT_TEST(GenerateVertexFetchRemapNumbersInFirstUse)
+{
+	uint32_t uniqueVertexCount{};
+	const std::vector<uint32_t> remap{ cof::MeshOptimizer::GenerateVertexFetchRemap({ 3, 1, 3, 0 }, 5, uniqueVertexCount) };
+
+	EXPECT(uniqueVertexCount == 3);
+	EXPECT(remap[3] == 0);
+	EXPECT(remap[1] == 1);
+	EXPECT(remap[0] == 2);
+	EXPECT(remap[2] == cof::MeshOptimizer::unusedVertex);
+	EXPECT(remap[4] == cof::MeshOptimizer::unusedVertex);
+}
+
+UNIT_TEST(OptimizeDropsUnusedVertices)
+{
+	struct Vertex
+	{
+		glm::vec3 position;
+	};
+
+	//The grid's vertices and one no triangle uses
+	std::vector<Vertex> vertices;
+	for (const glm::vec3& position : GridPositions(8, 8))
+	{
+		vertices.push_back(Vertex{ position });
+	}
+	vertices.push_back(Vertex{ glm::vec3{ -1.0f } });
+
+	std::vector<uint32_t> indices{ GridIndices(8, 8) };
+	const std::vector<uint32_t> original{ indices };
+	const cof::MeshOptimizer::OptimizationReport report{ cof::MeshOptimizer::Optimize(indices, vertices) };
+
+	EXPECT(vertices.size() == 81);
+	EXPECT(report.after.acmr <= report.before.acmr);
+
+	//The same triangles by position, whatever the new numbering
+	std::vector<uint32_t> sequential(indices.size());
+	for (size_t index{}; index < indices.size(); ++index)
+	{
+		EXPECT(indices[index] < vertices.size());
+		sequential[index] = static_cast<uint32_t>(vertices[indices[index]].position.y * 9.0f + vertices[indices[index]].position.x);
+	}
+	EXPECT(SortedTriangles(sequential) == SortedTriangles(original));
+}
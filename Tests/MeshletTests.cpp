@@ -0,0 +1,72 @@
+#include "UnitTest.h"
+
+#include "Graphics/Meshlet.h"
+
+#include <glm/ext/vector_float3.hpp>
+
+#include <cstdint>
+#include <vector>
+
+//A width by height grid of quads facing +z, offset along x
+static void AppendPlane(std::vector<uint32_t>& indices, std::vector<glm::vec3>& positions, uint32_t width, uint32_t height, float offset)
+{
+	const uint32_t firstVertex{ static_cast<uint32_t>(positions.size()) };
+	for (uint32_t y{}; y <= height; ++y)
+	{
+		for (uint32_t x{}; x <= width; ++x)
+		{
+			positions.push_back(glm::vec3{ offset + static_cast<float>(x), static_cast<float>(y), 0.0f });
+		}
+	}
+
+	for (uint32_t y{}; y < height; ++y)
+	{
+		for (uint32_t x{}; x < width; ++x)
+		{
+			const uint32_t corner{ firstVertex + y * (width + 1) + x };
+			const uint32_t above{ corner + width + 1 };
+			indices.insert(indices.end(), { corner, corner + 1, above, corner + 1, above + 1, above });
+		}
+	}
+}
+
+UNIT_TEST(MeshletsCoverEveryTriangleOnce)
+{
+	std::vector<uint32_t> indices;
+	std::vector<glm::vec3> positions;
+	AppendPlane(indices, positions, 16, 16, 0.0f);
+
+	const cof::MeshletMesh mesh{ cof::BuildMeshlets(indices, positions) };
+
+	uint32_t triangleCount{ 0 };
+	for (const cof::Meshlet& meshlet : mesh.meshlets)
+	{
+		EXPECT(meshlet.vertexCount <= cof::defaultMeshletMaxVertices);
+		EXPECT(meshlet.triangleCount <= cof::defaultMeshletMaxTriangles);
+		triangleCount += meshlet.triangleCount;
+	}
+
+	EXPECT(triangleCount == indices.size() / 3);
+	EXPECT(mesh.meshletTriangles.size() == indices.size());
+}
+
+UNIT_TEST(MeshletsOfDisconnectedPlanesStaySeparate)
+{
+	//Each plane fits one meshlet, so a meshlet spanning both could only come from restarting at a new seed
+	std::vector<uint32_t> indices;
+	std::vector<glm::vec3> positions;
+	AppendPlane(indices, positions, 2, 2, 0.0f);
+	AppendPlane(indices, positions, 2, 2, 100.0f);
+
+	const cof::MeshletMesh mesh{ cof::BuildMeshlets(indices, positions) };
+
+	EXPECT(mesh.meshlets.size() == 2);
+	for (const cof::Meshlet& meshlet : mesh.meshlets)
+	{
+		EXPECT(meshlet.triangleCount == 8);
+		EXPECT(meshlet.boundingSphere.w < 2.0f);
+		//A flat meshlet's cone is a single direction
+		EXPECT(meshlet.coneAxisCutoff.z > 0.99f);
+		EXPECT(meshlet.coneAxisCutoff.w < 1e-3f);
+	}
+}
@@ -0,0 +1,79 @@
+#include "UnitTest.h"
+
+#include <cstdio>
+#include <string_view>
+
+namespace cof
+{
+	static unsigned failedExpectations{ 0 };
+
+	std::deque<UnitTest>& UnitTests()
+	{
+		//Registration runs during static initialization of other translation units, so no namespace scope registry
+		static std::deque<UnitTest> tests;
+		return tests;
+	}
+
+	bool RegisterUnitTest(const char* name, UnitTestFunction function)
+	{
+		UnitTests().push_back(UnitTest{ name, function });
+		return true;
+	}
+
+	void FailExpectation(const char* expression, const char* file, int line) noexcept
+	{
+		printf("  %s(%d): expected %s\n", file, line, expression);
+		++failedExpectations;
+	}
+}
+
+//Runs every registered test of the CPU side code, nothing here needs a GPU. Tests register themselves with UNIT_TEST,
+//a new one only needs its source file added to the target. The exit code is 1 if any test failed.
+//
+//NomadTests [--filter name] [--list]
+int main(int argc, char** argv)
+{
+	std::string_view filter;
+	for (int argument{ 1 }; argument < argc; ++argument)
+	{
+		const std::string_view option{ argv[argument] };
+		if (option == "--filter" && argument + 1 < argc)
+		{
+			filter = argv[++argument];
+		}
+		else if (option == "--list")
+		{
+			for (const cof::UnitTest& test : cof::UnitTests())
+			{
+				printf("%s\n", test.name);
+			}
+			return 0;
+		}
+		else
+		{
+			printf("Unknown option %s\n", argv[argument]);
+			return 2;
+		}
+	}
+
+	unsigned testCount{ 0 };
+	unsigned failedTests{ 0 };
+	for (const cof::UnitTest& test : cof::UnitTests())
+	{
+		if (std::string_view{ test.name }.find(filter) == std::string_view::npos)
+		{
+			continue;
+		}
+
+		const unsigned failedBefore{ cof::failedExpectations };
+		test.function();
+		const bool passed{ cof::failedExpectations == failedBefore };
+		printf("%s %s\n", passed ? "Passed" : "Failed", test.name);
+
+		++testCount;
+		failedTests += passed ? 0 : 1;
+	}
+
+	printf("%u of %u tests passed\n", testCount - failedTests, testCount);
+	return failedTests == 0 ? 0 : 1;
+}
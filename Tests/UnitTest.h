@@ -0,0 +1,35 @@
+#pragma once
+#include <cmath>
+#include <deque>
+
+namespace cof
+{
+	using UnitTestFunction = void(*)();
+
+	struct UnitTest
+	{
+		const char* name;
+		UnitTestFunction function;
+	};
+
+	//Every registered test in registration order
+	std::deque<UnitTest>& UnitTests();
+	bool RegisterUnitTest(const char* name, UnitTestFunction function);
+
+	//Counts a failed expectation of the running test and prints where it is, the test keeps running so one run shows
+	//every failure
+	void FailExpectation(const char* expression, const char* file, int line) noexcept;
+}
+
+#define COF_TEST_CONCAT_IMPL(a, b) a##b
+#define COF_TEST_CONCAT(a, b) COF_TEST_CONCAT_IMPL(a, b)
+
+//Defines and registers a test, the body follows, e.g.
+//UNIT_TEST(RemapIndices) { EXPECT(indices[0] == 2); }
+#define UNIT_TEST(name) \
+	static void name(); \
+	[[maybe_unused]] static const bool COF_TEST_CONCAT(unitTest, __LINE__) = cof::RegisterUnitTest(#name, name); \
+	static void name()
+
+#define EXPECT(condition) ((condition) ? static_cast<void>(0) : cof::FailExpectation(#condition, __FILE__, __LINE__))
+#define EXPECT_NEAR(value, expected, tolerance) EXPECT(std::abs((value) - (expected)) <= (tolerance))
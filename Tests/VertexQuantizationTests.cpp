@@ -0,0 +1,123 @@
+#include "UnitTest.h"
+
+#include "Graphics/Vertex.h"
+#include "Graphics/VertexQuantization.h"
+
+#include <glm/ext/matrix_float4x4.hpp>
+#include <glm/ext/vector_float3.hpp>
+#include <glm/geometric.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+constexpr static float radiansToDegrees{ 57.2957795f };
+
+static float AngleDegrees(const glm::vec3& lhs, const glm::vec3& rhs)
+{
+	return std::acos(std::clamp(glm::dot(lhs, rhs), -1.0f, 1.0f)) * radiansToDegrees;
+}
+
+//Evenly spread over the sphere, so both hemispheres and every octant are covered
+static std::vector<glm::vec3> FibonacciSphere(uint32_t count)
+{
+	std::vector<glm::vec3> directions;
+	const float goldenAngle{ 2.39996323f };
+	for (uint32_t point{}; point < count; ++point)
+	{
+		const float z{ 1.0f - 2.0f * (static_cast<float>(point) + 0.5f) / static_cast<float>(count) };
+		const float radius{ std::sqrt(1.0f - z * z) };
+		const float angle{ goldenAngle * static_cast<float>(point) };
+		directions.push_back(glm::vec3{ radius * std::cos(angle), radius * std::sin(angle), z });
+	}
+
+	return directions;
+}
+
+UNIT_TEST(OctahedralRoundTripsAxes)
+{
+	for (const glm::vec3& axis : { glm::vec3{ 1.0f, 0.0f, 0.0f }, glm::vec3{ -1.0f, 0.0f, 0.0f }, glm::vec3{ 0.0f, 1.0f, 0.0f },
+		glm::vec3{ 0.0f, -1.0f, 0.0f }, glm::vec3{ 0.0f, 0.0f, 1.0f }, glm::vec3{ 0.0f, 0.0f, -1.0f } })
+	{
+		EXPECT(AngleDegrees(cof::DecodeOctahedral(cof::EncodeOctahedral(axis)), axis) < 1e-3f);
+	}
+}
+
+UNIT_TEST(OctahedralFoldsLowerHemisphere)
+{
+	const cof::Snorm16x2 up{ cof::EncodeOctahedral(glm::vec3{ 0.0f, 0.0f, 1.0f }) };
+	EXPECT(up.value[0] == 0 && up.value[1] == 0);
+
+	//-z lands on a corner of the square
+	const cof::Snorm16x2 down{ cof::EncodeOctahedral(glm::vec3{ 0.0f, 0.0f, -1.0f }) };
+	EXPECT(std::abs(down.value[0]) == 32767 && std::abs(down.value[1]) == 32767);
+
+	//Mirrored across the xy plane, a lower hemisphere vector lands outside the diamond of the upper hemisphere
+	const cof::Snorm16x2 below{ cof::EncodeOctahedral(glm::normalize(glm::vec3{ 0.3f, 0.2f, -0.5f })) };
+	EXPECT(std::abs(below.value[0]) + std::abs(below.value[1]) >= 32767);
+}
+
+UNIT_TEST(OctahedralRoundTripsSphere)
+{
+	float maxDegrees{ 0.0f };
+	for (const glm::vec3& direction : FibonacciSphere(4096))
+	{
+		const glm::vec3 decoded{ cof::DecodeOctahedral(cof::EncodeOctahedral(direction)) };
+		EXPECT_NEAR(glm::length(decoded), 1.0f, 1e-5f);
+		maxDegrees = std::max(maxDegrees, AngleDegrees(decoded, direction));
+	}
+
+	//16 bits per component keep the error within a few hundredths of a degree, the steps span the most angle next to
+	//the folds
+	EXPECT(maxDegrees < 0.05f);
+}
+
+UNIT_TEST(QuantizePositionsWithinHalfAStep)
+{
+	std::vector<cof::UnlitColoredVertex> vertices;
+	for (const glm::vec3& direction : FibonacciSphere(1000))
+	{
+		vertices.push_back(cof::UnlitColoredVertex{ direction * glm::vec3{ 10.0f, 2.0f, 0.5f } + glm::vec3{ 100.0f, -3.0f, 7.0f }, glm::vec4{ direction * 0.5f + 0.5f, 1.0f } });
+	}
+
+	cof::QuantizationTransform transform{};
+	cof::QuantizationError error{};
+	const std::vector<cof::QuantizedUnlitColoredVertex> quantized{ cof::QuantizeVertices(vertices, transform, error) };
+
+	EXPECT(quantized.size() == vertices.size());
+	//Half a step along every axis of a 20 by 4 by 1 box
+	const float halfStep{ glm::length(glm::vec3{ 20.0f, 4.0f, 1.0f } / 65535.0f) * 0.5f };
+	EXPECT(error.position <= halfStep * 1.01f);
+	EXPECT(error.color <= 0.5f / 255.0f + 1e-6f);
+
+	//The matrix maps what a UNORM fetch returns onto the decoded positions
+	const glm::mat4 matrix{ transform.Matrix() };
+	for (size_t vertex{}; vertex < vertices.size(); vertex += 97)
+	{
+		const glm::vec4 normalized
+		{
+			static_cast<float>(quantized[vertex].position.value[0]) / 65535.0f,
+			static_cast<float>(quantized[vertex].position.value[1]) / 65535.0f,
+			static_cast<float>(quantized[vertex].position.value[2]) / 65535.0f,
+			1.0f
+		};
+		EXPECT(glm::length(glm::vec3{ matrix * normalized } - vertices[vertex].position) <= halfStep * 1.01f);
+	}
+}
+
+UNIT_TEST(QuantizeFlatMesh)
+{
+	const std::vector<cof::UnlitColoredVertex> vertices
+	{
+		cof::UnlitColoredVertex{ glm::vec3{ 0.0f, 1.0f, 0.0f }, glm::vec4{ 1.0f } },
+		cof::UnlitColoredVertex{ glm::vec3{ 1.0f, 1.0f, 0.0f }, glm::vec4{ 1.0f } },
+		cof::UnlitColoredVertex{ glm::vec3{ 0.0f, 1.0f, 1.0f }, glm::vec4{ 1.0f } }
+	};
+
+	cof::QuantizationTransform transform{};
+	cof::QuantizationError error{};
+	cof::QuantizeVertices(vertices, transform, error);
+
+	EXPECT(transform.scale.y > 0.0f);
+	EXPECT(error.position < 1e-4f);
+}
@@ -2,10 +2,20 @@
 #include "GPU/CommandPool.h"
 #include "GPU/Shader.h"
 #include "GPU/Semaphore.h"
+#include "GPU/GeometryBuffer.h"
+#include "GPU/AsyncCompute.h"
+#include "GPU/UploadStreamer.h"
+#include "GPU/GpuProfiler.h"
+#include "Utils/CpuProfiler.h"
 #include "Graphics/Swapchain.h"
+#include "Graphics/OffscreenTarget.h"
 #include "Graphics/RenderPass.h"
+#include "Graphics/DepthBuffer.h"
 #include "Utils/VulkanUtils.h"
 #include "Graphics/Vertex.h"
+#include "Graphics/VertexLayout.h"
+#include "Graphics/FrustumCulling.h"
+#include "Graphics/RenderGraph.h"
 
 #include "GPU/vk_mem_alloc.h"
 
@@ -15,8 +25,12 @@
 #include <GLFW/glfw3.h>
 
 #include <array>
+#include <chrono>
+#include <memory>
+#include <optional>
 #include <string_view>
 #include <assert.h>
+#include <cstdio>
 #include <cstring>
 #include <cstdlib>
 #include <cstdint>
@@ -40,12 +54,44 @@ static VkApplicationInfo appInfo
 	1u,
 	"LunarG SDK",
 	1u,
-	VK_API_VERSION_1_1
+	VK_API_VERSION_1_2
 };
 
-constexpr static uint64_t desiredFeaturesBitMask{ 1 | 1 << 1 | 1 << 2 | 1 << 3 };
+//Pipeline statistics of every profiled scope, reported next to the timings
+constexpr static bool pipelineStatistics{ true };
+
+//multiDrawIndirect and drawIndirectFirstInstance are needed by the GPU driven draws,
+//geometryShader by the visibility buffer fragment shader reading gl_PrimitiveID, pipelineStatisticsQuery by the profiler
+constexpr static uint64_t desiredFeaturesBitMask{ 1 | 1 << 1 | 1 << 2 | 1 << 3 | 1 << 4 | 1 << 9 | 1 << 10 | (pipelineStatistics ? 1 << 24 : 0) };
 constexpr static VkQueueFlags queueFlags{ VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT };
-static std::vector<const char*> desiredDeviceExtensions{ VK_KHR_SWAPCHAIN_EXTENSION_NAME };
+//VK_KHR_swapchain is added unless running headless
+static std::vector<const char*> desiredDeviceExtensions{};
+
+static VkPhysicalDeviceVulkan12Features desiredVulkan12Features
+{
+	.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+	.drawIndirectCount = VK_TRUE,
+	.scalarBlockLayout = VK_TRUE,
+	.timelineSemaphore = VK_TRUE,
+	.bufferDeviceAddress = VK_TRUE
+};
+
+//Fetch vertices in the vertex shader through the geometry buffer's device address instead of the vertex input stage
+constexpr static bool vertexPulling{ true };
+
+//Lay down depth from a position only stream first, the color pass then shades every pixel exactly once
+constexpr static bool depthPrepass{ true };
+
+//Staging memory of the transfer queue and how much of it a single frame may fill, the rest waits for later frames
+constexpr static VkDeviceSize uploadStagingSize{ 32 * 1024 * 1024 };
+constexpr static VkDeviceSize uploadFrameBudget{ 4 * 1024 * 1024 };
+
+//Matches DrawConstants in PulledTriangle.vert.glsl, the other vertex shaders only read the matrix
+struct DrawConstants
+{
+	glm::mat4 viewProjection;
+	VkDeviceAddress vertexBuffer;
+};
 
 void createBuffer(const cof::GPUContext& gpuContext,VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory) {
 	VkBufferCreateInfo bufferInfo = {};
@@ -88,7 +134,56 @@ void createBuffer(const cof::GPUContext& gpuContext,VkDeviceSize size, VkBufferU
 	vkBindBufferMemory(gpuContext.LogicalDevice(), buffer, bufferMemory, 0);
 }
 
-int main()
+//--headless renders frameCount frames into offscreen images without a window, surface or VK_KHR_swapchain, so it runs
+//wherever there is a Vulkan driver, lavapipe included. --save writes the last frame as PPM, --trace the CPU and GPU zones.
+//--overlap submits culling after graphics finished every other frame and reports the wall time against the overlapped frames
+struct Options
+{
+	bool headless{ false };
+	bool measureOverlap{ false };
+	uint64_t frameCount{ 1000 };
+	const char* savePath{ nullptr };
+	const char* tracePath{ nullptr };
+};
+
+static Options ParseOptions(int argc, char** argv)
+{
+	Options options{};
+	for (int argument{ 1 }; argument < argc; ++argument)
+	{
+		const std::string_view option{ argv[argument] };
+		const bool hasValue{ argument + 1 < argc };
+
+		if (option == "--headless")
+		{
+			options.headless = true;
+		}
+		else if (option == "--overlap")
+		{
+			options.measureOverlap = true;
+		}
+		else if (option == "--frames" && hasValue)
+		{
+			options.frameCount = std::strtoull(argv[++argument], nullptr, 10);
+		}
+		else if (option == "--save" && hasValue)
+		{
+			options.savePath = argv[++argument];
+		}
+		else if (option == "--trace" && hasValue)
+		{
+			options.tracePath = argv[++argument];
+		}
+		else
+		{
+			printf("Unknown option %s\n", argv[argument]);
+		}
+	}
+
+	return options;
+}
+
+int main(int argc, char** argv)
 {
 
 #ifdef VK_USE_PLATFORM_WIN32_KHR
@@ -97,11 +192,20 @@ int main()
 	puts("linux");
 #endif
 
-	[[maybe_unused]] int glfwInitStatus = glfwInit();
-	assert(glfwInitStatus);
+	const Options options{ ParseOptions(argc, argv) };
+	constexpr VkExtent2D windowExtent{ 640, 480 };
 
-	glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-	GLFWwindow* window = glfwCreateWindow(640, 480, "Nomad", nullptr, nullptr);
+	GLFWwindow* window{ nullptr };
+	if (!options.headless)
+	{
+		[[maybe_unused]] int glfwInitStatus = glfwInit();
+		assert(glfwInitStatus);
+
+		glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+		window = glfwCreateWindow(static_cast<int>(windowExtent.width), static_cast<int>(windowExtent.height), "Nomad", nullptr, nullptr);
+
+		desiredDeviceExtensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+	}
 
 	[[maybe_unused]] VkResult errorCode{ VK_RESULT_MAX_ENUM };
 
@@ -113,11 +217,14 @@ int main()
 	errorCode = vkEnumerateInstanceExtensionProperties(nullptr, &instanceExtensionsCount, availableInstanceExtensions.data());
 	assert(errorCode == VK_SUCCESS);
 
-	uint32_t glfwExtensionCount;
-	const char** glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+	if (!options.headless)
+	{
+		uint32_t glfwExtensionCount;
+		const char** glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
 
-	desiredInstanceExtensions.reserve(desiredInstanceExtensions.size() + static_cast<size_t>(glfwExtensionCount));
-	desiredInstanceExtensions.insert(desiredInstanceExtensions.end(), glfwExtensions, glfwExtensions + glfwExtensionCount);
+		desiredInstanceExtensions.reserve(desiredInstanceExtensions.size() + static_cast<size_t>(glfwExtensionCount));
+		desiredInstanceExtensions.insert(desiredInstanceExtensions.end(), glfwExtensions, glfwExtensions + glfwExtensionCount);
+	}
 
 	for (auto& desiredInstanceextension : desiredInstanceExtensions)
 	{
@@ -140,11 +247,14 @@ int main()
  	errorCode = vkCreateInstance(&instInfo, nullptr, &instance);
  	assert(errorCode == VK_SUCCESS);
 
-	static VkSurfaceKHR surface;
-	errorCode = glfwCreateWindowSurface(instance, window, nullptr, &surface);
-	assert(errorCode == VK_SUCCESS);
+	static VkSurfaceKHR surface{ VK_NULL_HANDLE };
+	if (!options.headless)
+	{
+		errorCode = glfwCreateWindowSurface(instance, window, nullptr, &surface);
+		assert(errorCode == VK_SUCCESS);
+	}
 
-	cof::GPUContext gpuContext{ instance, desiredFeaturesBitMask, queueFlags, desiredDeviceExtensions };
+	cof::GPUContext gpuContext{ instance, desiredFeaturesBitMask, queueFlags, desiredDeviceExtensions, &desiredVulkan12Features };
 
 	const auto& queueFamilyIndices = gpuContext.QueueFamilyIndices();
 	const auto physicalDevice = gpuContext.PhysicalDevice();
@@ -176,85 +286,136 @@ int main()
 		.sharingMode = VK_SHARING_MODE_EXCLUSIVE
 	};
 
-	VkBufferCreateInfo stagingbufferInfo
-	{
-		.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
-		.size = bufferSize,
-		.usage =  VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		.sharingMode = VK_SHARING_MODE_EXCLUSIVE
-	};
-
 	VmaAllocationCreateInfo vertexBufferAllocInfo
 	{
 		.usage = VMA_MEMORY_USAGE_GPU_ONLY
 	};
 	
-	VmaAllocationCreateInfo stagingBufferAllocInfo
+	VkBuffer vertexBuffer;
+	VmaAllocation vertexAllocation;
+	vmaCreateBuffer(gpuMemallocator, &vertexbufferInfo, &vertexBufferAllocInfo, &vertexBuffer, &vertexAllocation, nullptr);
+
+	cof::GeometryBuffer geometryBuffer{ gpuContext, 64 * 1024 * 1024 };
+	const VkDeviceSize geometryVertexOffset{ geometryBuffer.Allocate(bufferSize) };
+
+	//Streams on the transfer queue and hands the data to the graphics queue, owns VMA memory like the render graphs
+	std::optional<cof::UploadStreamer> uploadStreamer;
+	uploadStreamer.emplace(gpuContext, gpuMemallocator, gpuContext.QueueFamilyIndex<VK_QUEUE_GRAPHICS_BIT>(), uploadStagingSize);
+
+	const std::byte* vertexBytes{ reinterpret_cast<const std::byte*>(vertices.data()) };
+
+	uploadStreamer->Enqueue(cof::BufferUpload
 	{
-		.usage = VMA_MEMORY_USAGE_CPU_ONLY
-	};
+		.buffer = vertexBuffer,
+		.offset = 0,
+		.data = { vertexBytes, vertexBytes + bufferSize },
+		.dstAccess = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT
+	}, cof::UploadPriority::Visible);
 
-	VkBuffer vertexBuffer, stagingBuffer;
-	VmaAllocation vertexAllocation, stagingAllocation;
-	vmaCreateBuffer(gpuMemallocator, &vertexbufferInfo, &vertexBufferAllocInfo, &vertexBuffer, &vertexAllocation, nullptr);
-	vmaCreateBuffer(gpuMemallocator, &stagingbufferInfo, &stagingBufferAllocInfo, &stagingBuffer, &stagingAllocation, nullptr);
+	uploadStreamer->Enqueue(cof::BufferUpload
+	{
+		.buffer = geometryBuffer.Handle(),
+		.offset = geometryVertexOffset,
+		.data = { vertexBytes, vertexBytes + bufferSize },
+		.dstAccess = VK_ACCESS_SHADER_READ_BIT
+	}, cof::UploadPriority::Visible);
 
-	void* vertexData;
-	vmaMapMemory(gpuMemallocator, stagingAllocation, &vertexData);
-	memcpy(vertexData, vertices.data(), static_cast<size_t>(bufferSize));
-	vmaUnmapMemory(gpuMemallocator, stagingAllocation);
+	//The first frame draws the triangle, so its vertices can't wait for the per frame budget
+	uploadStreamer->Flush();
 
-	cof::CommandPool<VK_QUEUE_TRANSFER_BIT> transferCommandPool{ gpuContext, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT };
+	std::vector<uint32_t> indices{ 0, 1, 2 };
 
-	VkCommandBufferAllocateInfo allocTransferCBufferInfo
+	std::vector<cof::DrawInstance> drawInstances
 	{
-		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
-		.commandPool = transferCommandPool.Handle(),
-		.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-		.commandBufferCount = 1u
+		{ .boundingSphere = glm::vec4{ 0.0f, 0.0f, 0.0f, 0.71f }, .indexCount = static_cast<uint32_t>(indices.size()), .firstIndex = 0, .vertexOffset = 0 }
 	};
 
-	VkCommandBuffer transferCommandBuffer;
-	errorCode = vkAllocateCommandBuffers(logicalDevice, &allocTransferCBufferInfo, &transferCommandBuffer);
-	assert(errorCode == VK_SUCCESS);
+	const uint32_t instanceCount{ static_cast<uint32_t>(drawInstances.size()) };
 
-	VkCommandBufferBeginInfo transferBeginInfo
+	auto createHostVisibleBuffer = [gpuMemallocator](const void* data, VkDeviceSize size, VkBufferUsageFlags usage, VkBuffer& buffer, VmaAllocation& allocation)
 	{
-		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-		.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
+		VkBufferCreateInfo bufferInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+			.size = size,
+			.usage = usage,
+			.sharingMode = VK_SHARING_MODE_EXCLUSIVE
+		};
+
+		VmaAllocationCreateInfo allocInfo
+		{
+			.usage = VMA_MEMORY_USAGE_CPU_TO_GPU
+		};
+
+		vmaCreateBuffer(gpuMemallocator, &bufferInfo, &allocInfo, &buffer, &allocation, nullptr);
+
+		void* mappedData;
+		vmaMapMemory(gpuMemallocator, allocation, &mappedData);
+		memcpy(mappedData, data, static_cast<size_t>(size));
+		vmaUnmapMemory(gpuMemallocator, allocation);
 	};
 
-	vkBeginCommandBuffer(transferCommandBuffer, &transferBeginInfo);
+	VkBuffer indexBuffer, instanceBuffer;
+	VmaAllocation indexAllocation, instanceAllocation;
+	createHostVisibleBuffer(indices.data(), sizeof(uint32_t) * indices.size(), VK_BUFFER_USAGE_INDEX_BUFFER_BIT, indexBuffer, indexAllocation);
+	createHostVisibleBuffer(drawInstances.data(), sizeof(cof::DrawInstance) * drawInstances.size(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, instanceBuffer, instanceAllocation);
+
+	const std::vector<std::byte> positionStream{ cof::DeinterleaveVertices(vertices)[0] };
 
-	VkBufferCopy copyRegion
+	VkBuffer positionBuffer;
+	VmaAllocation positionAllocation;
+	createHostVisibleBuffer(positionStream.data(), positionStream.size(), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, positionBuffer, positionAllocation);
+
+	VkBufferCreateInfo drawCommandBufferInfo
 	{
-		.size = bufferSize
+		.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+		.size = sizeof(VkDrawIndexedIndirectCommand) * instanceCount,
+		.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+		.sharingMode = VK_SHARING_MODE_EXCLUSIVE
 	};
 
-	VkBufferCopy copyRegions[]{ copyRegion };
-	vkCmdCopyBuffer(transferCommandBuffer, stagingBuffer, vertexBuffer, static_cast<uint32_t>(std::size(copyRegions)), copyRegions);
-	vkEndCommandBuffer(transferCommandBuffer);
+	VkBufferCreateInfo drawCountBufferInfo
+	{
+		.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+		.size = sizeof(uint32_t),
+		.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		.sharingMode = VK_SHARING_MODE_EXCLUSIVE
+	};
 
-	VkSubmitInfo submitInfo
+	VmaAllocationCreateInfo indirectBufferAllocInfo
 	{
-		.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-		.commandBufferCount = 1,
-		.pCommandBuffers = &transferCommandBuffer
+		.usage = VMA_MEMORY_USAGE_GPU_ONLY
 	};
 
-	VkQueue transferQueue;
-	vkGetDeviceQueue(logicalDevice, gpuContext.QueueFamilyIndex<VK_QUEUE_TRANSFER_BIT>(), 0, &transferQueue);
-	errorCode = vkQueueSubmit(transferQueue, 1, &submitInfo, VK_NULL_HANDLE); //TODO add fence
-	vkQueueWaitIdle(transferQueue);
+	//Culling for the next frame runs on the compute queue while the current frame draws, so the draw buffers are double buffered
+	constexpr uint32_t drawSetCount{ 2 };
+
+	std::array<VkBuffer, drawSetCount> drawCommandBuffers, drawCountBuffers;
+	std::array<VmaAllocation, drawSetCount> drawCommandAllocations, drawCountAllocations;
+	for (uint32_t drawSet{}; drawSet < drawSetCount; ++drawSet)
+	{
+		vmaCreateBuffer(gpuMemallocator, &drawCommandBufferInfo, &indirectBufferAllocInfo, &drawCommandBuffers[drawSet], &drawCommandAllocations[drawSet], nullptr);
+		vmaCreateBuffer(gpuMemallocator, &drawCountBufferInfo, &indirectBufferAllocInfo, &drawCountBuffers[drawSet], &drawCountAllocations[drawSet], nullptr);
+	}
+
+	cof::Shader frustumCullShader = cof::LoadShader(R"(D:\GameDev\Graphics\Vulkan\Nomad\Assets\Shaders\FrustumCull.comp.spv)", logicalDevice);
+	//One pass per draw set, a descriptor set can't be rebound while the other queue may still use it
+	cof::FrustumCullingPass frustumCullingPasses[drawSetCount]{ { logicalDevice, frustumCullShader }, { logicalDevice, frustumCullShader } };
+	for (uint32_t drawSet{}; drawSet < drawSetCount; ++drawSet)
+	{
+		frustumCullingPasses[drawSet].BindBuffers(instanceBuffer, drawCommandBuffers[drawSet], drawCountBuffers[drawSet]);
+	}
 
-	vkFreeCommandBuffers(logicalDevice, transferCommandPool.Handle(), 1, &transferCommandBuffer);
-	vmaDestroyBuffer(gpuMemallocator, stagingBuffer, stagingAllocation);
-	
 
 	uint32_t presentQueueFamilyIndex{ std::numeric_limits<uint32_t>::max() };
 	VkBool32 presentationSupported{ VK_FALSE };
 
-	if (errorCode = vkGetPhysicalDeviceSurfaceSupportKHR(physicalDevice, queueFamilyIndices.graphics, surface, &presentationSupported); 
+	//Offscreen images are presented by an empty submit, any queue does
+	if (options.headless)
+	{
+		presentQueueFamilyIndex = queueFamilyIndices.graphics;
+	}
+	else if (errorCode = vkGetPhysicalDeviceSurfaceSupportKHR(physicalDevice, queueFamilyIndices.graphics, surface, &presentationSupported); 
 		VK_SUCCESS == errorCode && VK_TRUE == presentationSupported)
 	{
 		presentQueueFamilyIndex = queueFamilyIndices.graphics;
@@ -272,59 +433,115 @@ int main()
 
 	assert(presentQueueFamilyIndex != std::numeric_limits<uint32_t>::max());
 
-	int windowWidth, windowHeight;
-	glfwGetWindowSize(window, &windowWidth, &windowHeight);
+	//Owns VMA memory when headless, released before the allocator at the end of main
+	std::unique_ptr<cof::PresentationTarget> presentationTarget;
+	cof::OffscreenTarget* offscreenTarget{ nullptr };
 
-	cof::Swapchain swapchain
+	if (options.headless)
 	{
-		gpuContext,
-		surface,
-		{ static_cast<uint32_t>(windowWidth), static_cast<uint32_t>(windowHeight) },
-		VK_PRESENT_MODE_MAILBOX_KHR,
-		VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
-		VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR,
-		{ VK_FORMAT_R8G8B8A8_UNORM, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR }
-	};
+		auto target{ std::make_unique<cof::OffscreenTarget>(gpuContext, gpuMemallocator, gpuContext.Queue<VK_QUEUE_GRAPHICS_BIT>(),
+			VK_FORMAT_R8G8B8A8_UNORM, windowExtent, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT) };
+		offscreenTarget = target.get();
+		presentationTarget = std::move(target);
+	}
+	else
+	{
+		int windowWidth, windowHeight;
+		glfwGetWindowSize(window, &windowWidth, &windowHeight);
+
+		presentationTarget = std::make_unique<cof::Swapchain>
+		(
+			gpuContext,
+			surface,
+			VkExtent2D{ static_cast<uint32_t>(windowWidth), static_cast<uint32_t>(windowHeight) },
+			VK_PRESENT_MODE_MAILBOX_KHR,
+			VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+			VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR,
+			VkSurfaceFormatKHR{ VK_FORMAT_R8G8B8A8_UNORM, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR }
+		);
+	}
 
 	VkAttachmentDescription colorAttachment
 	{
-		.format = swapchain.ImageMetaData().format,
+		.format = presentationTarget->Format(),
 		.samples = VK_SAMPLE_COUNT_1_BIT,
 		.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
 		.storeOp = VK_ATTACHMENT_STORE_OP_STORE,
 		.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
 		.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
-		.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-		.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR
+		//The render graph transitions the swapchain image before the pass
+		.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+		.finalLayout = presentationTarget->PresentLayout()
 
 	};
 
+	VkAttachmentDescription depthAttachment
+	{
+		.format = cof::DepthBuffer::format,
+		.samples = VK_SAMPLE_COUNT_1_BIT,
+		.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+		.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+		.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+		.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+		.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+		.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL
+	};
+
 	VkAttachmentReference colorAttachmentRef
 	{
 		.attachment = 0,
 		.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
 	};
 
+	VkAttachmentReference depthAttachmentRef
+	{
+		.attachment = 1,
+		.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL
+	};
+
+	//The color pass only tests against the prepass depth
+	VkAttachmentReference readOnlyDepthAttachmentRef
+	{
+		.attachment = 1,
+		.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL
+	};
+
+	VkSubpassDescription prepassSubpass
+	{
+		.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
+		.colorAttachmentCount = 0,
+		.pDepthStencilAttachment = &depthAttachmentRef
+	};
+
 	VkSubpassDescription subpass
 	{
 		.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
 		.colorAttachmentCount = 1,
 		.pColorAttachments = &colorAttachmentRef,
+		.pDepthStencilAttachment = depthPrepass ? &readOnlyDepthAttachmentRef : &depthAttachmentRef
 	};
 
-	VkSubpassDependency dependency
+	const uint32_t colorSubpass{ depthPrepass ? 1u : 0u };
+
+	//External dependencies come from the render graph's barriers, only the prepass to color dependency is internal
+	VkSubpassDependency prepassDependency
 	{
-		.srcSubpass = VK_SUBPASS_EXTERNAL,
-		.dstSubpass = 0,
-		.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-		.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-		.srcAccessMask = 0,
-		.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+		.srcSubpass = 0,
+		.dstSubpass = 1,
+		.srcStageMask = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+		.dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+		.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+		.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT,
+		.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT
 	};
 
-	cof::RenderPass forwardGeometryPass{ logicalDevice, {colorAttachment}, {subpass}, {dependency} };
+	cof::RenderPass forwardGeometryPass = depthPrepass
+		? cof::RenderPass{ logicalDevice, {colorAttachment, depthAttachment}, {prepassSubpass, subpass}, {prepassDependency} }
+		: cof::RenderPass{ logicalDevice, {colorAttachment, depthAttachment}, {subpass}, {} };
 
-	cof::Shader triangleVertShader = cof::LoadShader(R"(D:\GameDev\Graphics\Vulkan\Nomad\Assets\Shaders\VBufferTriangle.vert.spv)", logicalDevice);
+	cof::Shader triangleVertShader = cof::LoadShader(vertexPulling
+		? R"(D:\GameDev\Graphics\Vulkan\Nomad\Assets\Shaders\PulledTriangle.vert.spv)"
+		: R"(D:\GameDev\Graphics\Vulkan\Nomad\Assets\Shaders\VBufferTriangle.vert.spv)", logicalDevice);
 	cof::Shader triangleFragShader = cof::LoadShader(R"(D:\GameDev\Graphics\Vulkan\Nomad\Assets\Shaders\VBufferTriangle.frag.spv)", logicalDevice);
 
 	VkPipelineShaderStageCreateInfo shaderStages[] = 
@@ -343,40 +560,7 @@ int main()
 		}
 	};
 
-	VkVertexInputBindingDescription bindingDescription
-	{
-		.binding = 0,
-		.stride = sizeof(decltype(vertices)::value_type),
-		.inputRate = VK_VERTEX_INPUT_RATE_VERTEX
-	};
-
-	std::array<VkVertexInputAttributeDescription, 2> attributeDescriptions
-	{
-		VkVertexInputAttributeDescription
-		{
-			.location = 0,
-			.binding = 0,
-			.format = VK_FORMAT_R32G32B32_SFLOAT,
-			.offset = offsetof(decltype(vertices)::value_type, position)
-		},
-		VkVertexInputAttributeDescription
-		{
-			.location = 1,
-			.binding = 0,
-			.format = VK_FORMAT_R32G32B32A32_SFLOAT,
-			.offset = offsetof(decltype(vertices)::value_type, color)
-		}
-	};
-
-
-	VkPipelineVertexInputStateCreateInfo vertexInputInfo
-	{
-		.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
-		.vertexBindingDescriptionCount = 1,
-		.pVertexBindingDescriptions = &bindingDescription,
-		.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size()),
-		.pVertexAttributeDescriptions = attributeDescriptions.data()
-	};
+	VkPipelineVertexInputStateCreateInfo vertexInputInfo = vertexPulling ? cof::pulledVertexInputState : cof::VertexLayout<decltype(vertices)::value_type>::InputState();
 
 	VkPipelineInputAssemblyStateCreateInfo inputAssembly
 	{
@@ -389,8 +573,8 @@ int main()
 	{
 		.x = 0.0f,
 		.y = 0.0f,
-		.width = static_cast<float>(swapchain.ImageMetaData().extent.width),
-		.height = static_cast<float>(swapchain.ImageMetaData().extent.height),
+		.width = static_cast<float>(presentationTarget->Extent().width),
+		.height = static_cast<float>(presentationTarget->Extent().height),
 		.minDepth = 0.0f,
 		.maxDepth = 1.0f,
 	};
@@ -398,7 +582,7 @@ int main()
 	VkRect2D scissor
 	{
 		.offset = { 0, 0 },
-		.extent = swapchain.ImageMetaData().extent
+		.extent = presentationTarget->Extent()
 	};
 
 	VkPipelineViewportStateCreateInfo viewportState
@@ -443,9 +627,27 @@ int main()
 	};
 
 
+	//The prepass writes the depth the color pass tests for equality, the color pass itself doesn't write depth
+	VkPipelineDepthStencilStateCreateInfo depthStencil
+	{
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
+		.depthTestEnable = VK_TRUE,
+		.depthWriteEnable = depthPrepass ? VK_FALSE : VK_TRUE,
+		.depthCompareOp = depthPrepass ? VK_COMPARE_OP_EQUAL : cof::DepthBuffer::compareOp
+	};
+
+	VkPushConstantRange drawConstantRange
+	{
+		.stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+		.offset = 0,
+		.size = sizeof(DrawConstants)
+	};
+
 	VkPipelineLayoutCreateInfo pipelineLayoutInfo
 	{
-		.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+		.pushConstantRangeCount = 1,
+		.pPushConstantRanges = &drawConstantRange
 	};
 
 	VkPipelineLayout pipelineLayout;
@@ -461,19 +663,84 @@ int main()
 		.pViewportState = &viewportState,
 		.pRasterizationState = &rasterizer,
 		.pMultisampleState = &multisampling,
-		.pDepthStencilState = nullptr,
+		.pDepthStencilState = &depthStencil,
 		.pColorBlendState = &colorBlending,
 		.pDynamicState = nullptr,
 		.layout = pipelineLayout,
 		.renderPass = forwardGeometryPass.Handle(),
-		.subpass = 0,
+		.subpass = colorSubpass,
 	};
 
 	VkPipeline graphicsPipeline;
 	errorCode = vkCreateGraphicsPipelines(logicalDevice, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &graphicsPipeline);
 	assert(errorCode == VK_SUCCESS);
 
+	cof::Shader depthPrepassShader = cof::LoadShader(R"(D:\GameDev\Graphics\Vulkan\Nomad\Assets\Shaders\DepthPrepass.vert.spv)", logicalDevice);
+
+	VkPipelineShaderStageCreateInfo prepassShaderStage
+	{
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+		.stage = VK_SHADER_STAGE_VERTEX_BIT,
+		.module = depthPrepassShader.Handle(),
+		.pName = "main"
+	};
+
+	VkPipelineVertexInputStateCreateInfo prepassVertexInputInfo = cof::VertexLayout<decltype(vertices)::value_type, cof::VertexStreams::Deinterleaved, 1>::InputState();
+
+	VkPipelineDepthStencilStateCreateInfo prepassDepthStencil
+	{
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
+		.depthTestEnable = VK_TRUE,
+		.depthWriteEnable = VK_TRUE,
+		.depthCompareOp = cof::DepthBuffer::compareOp
+	};
+
+	VkPipelineColorBlendStateCreateInfo prepassColorBlending
+	{
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
+		.logicOpEnable = VK_FALSE,
+		.attachmentCount = 0
+	};
+
+	VkGraphicsPipelineCreateInfo prepassPipelineInfo
+	{
+		.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+		.stageCount = 1,
+		.pStages = &prepassShaderStage,
+		.pVertexInputState = &prepassVertexInputInfo,
+		.pInputAssemblyState = &inputAssembly,
+		.pViewportState = &viewportState,
+		.pRasterizationState = &rasterizer,
+		.pMultisampleState = &multisampling,
+		.pDepthStencilState = &prepassDepthStencil,
+		.pColorBlendState = &prepassColorBlending,
+		.layout = pipelineLayout,
+		.renderPass = forwardGeometryPass.Handle(),
+		.subpass = 0
+	};
+
+	VkPipeline prepassPipeline{ VK_NULL_HANDLE };
+	if constexpr (depthPrepass)
+	{
+		errorCode = vkCreateGraphicsPipelines(logicalDevice, VK_NULL_HANDLE, 1, &prepassPipelineInfo, nullptr, &prepassPipeline);
+		assert(errorCode == VK_SUCCESS);
+	}
+
+	const VkExtent2D swapchainExtent{ presentationTarget->Extent() };
+	const glm::mat4 projection{ cof::InfiniteReversedPerspective(1.0f, static_cast<float>(swapchainExtent.width) / static_cast<float>(swapchainExtent.height), 0.1f) };
+
+	//Camera two units in front of the triangle
+	glm::mat4 view{ 1.0f };
+	view[3][2] = -2.0f;
+
+	const DrawConstants drawConstants
+	{
+		.viewProjection = projection * view,
+		.vertexBuffer = vertexPulling ? geometryBuffer.DeviceAddress(geometryVertexOffset) : 0
+	};
+
 	cof::CommandPool<VK_QUEUE_GRAPHICS_BIT> graphicsCommandPool{ gpuContext, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT };
+	cof::CommandPool<VK_QUEUE_COMPUTE_BIT> computeCommandPool{ gpuContext, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT };
 
 	VkCommandBufferAllocateInfo allocCBufferInfo
 	{
@@ -488,10 +755,25 @@ int main()
 	errorCode = vkAllocateCommandBuffers(logicalDevice, &allocCBufferInfo, &graphicsCommandBuffer);
 	assert(errorCode == VK_SUCCESS);
 
+	allocCBufferInfo.commandPool = computeCommandPool.Handle();
+
+	VkCommandBuffer computeCommandBuffer;
+
+	errorCode = vkAllocateCommandBuffers(logicalDevice, &allocCBufferInfo, &computeCommandBuffer);
+	assert(errorCode == VK_SUCCESS);
+
+	//Without a separate compute family both queues are the same queue and culling simply runs before the next frame's graphics
+	const VkQueue graphicsQueue{ gpuContext.Queue<VK_QUEUE_GRAPHICS_BIT>() };
+	const VkQueue computeQueue{ gpuContext.Queue<VK_QUEUE_COMPUTE_BIT>() };
+	const uint32_t graphicsQueueFamily{ gpuContext.QueueFamilyIndex<VK_QUEUE_GRAPHICS_BIT>() };
+	const uint32_t computeQueueFamily{ gpuContext.HasAsyncCompute() ? gpuContext.QueueFamilyIndex<VK_QUEUE_COMPUTE_BIT>() : graphicsQueueFamily };
+
 	cof::Semaphore imageAvailableSemaphore{ logicalDevice };
 	cof::Semaphore renderingFinishedSemaphore{ logicalDevice };
+	//Signaled by the compute queue once the draw set the next frame consumes is culled and released
+	cof::Semaphore cullingFinishedSemaphore{ logicalDevice };
 
-	VkFence renderingFinishedFence;
+	VkFence renderingFinishedFence, cullingFinishedFence;
 
 	VkFenceCreateInfo fenceInfo
 	{
@@ -500,11 +782,244 @@ int main()
 
 	errorCode = vkCreateFence(logicalDevice, &fenceInfo, nullptr, &renderingFinishedFence);
 	assert(errorCode == VK_SUCCESS);
+	errorCode = vkCreateFence(logicalDevice, &fenceInfo, nullptr, &cullingFinishedFence);
+	assert(errorCode == VK_SUCCESS);
+
+	//Begin and end timestamp of the graphics and the compute submit, only written when both queues support timestamps
+	constexpr uint32_t graphicsQueryIndex{ 0 };
+	constexpr uint32_t computeQueryIndex{ 2 };
 
-	while (!glfwWindowShouldClose(window)) 
+	VkPhysicalDeviceProperties physicalDeviceProperties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &physicalDeviceProperties);
+
+	uint32_t queueFamilyCount{ 0 };
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+	std::vector<VkQueueFamilyProperties> queueFamilyProperties{ queueFamilyCount };
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilyProperties.data());
+
+	const bool measureQueueTimes{ options.measureOverlap && queueFamilyProperties[graphicsQueueFamily].timestampValidBits != 0 && queueFamilyProperties[computeQueueFamily].timestampValidBits != 0 };
+
+	VkQueryPoolCreateInfo queryPoolInfo
+	{
+		.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+		.queryType = VK_QUERY_TYPE_TIMESTAMP,
+		.queryCount = 4
+	};
+
+	VkQueryPool timestampQueryPool;
+	errorCode = vkCreateQueryPool(logicalDevice, &queryPoolInfo, nullptr, &timestampQueryPool);
+	assert(errorCode == VK_SUCCESS);
+
+	constexpr VkPipelineStageFlags cullingStages{ VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT };
+	constexpr VkAccessFlags cullingAccess{ VK_ACCESS_SHADER_WRITE_BIT };
+	constexpr VkPipelineStageFlags drawStages{ VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT };
+	constexpr VkAccessFlags drawAccess{ VK_ACCESS_INDIRECT_COMMAND_READ_BIT };
+
+	//Owns VMA memory, so both graphs have to be released before the allocator at the end of main
+	std::optional<cof::RenderGraph> cullingGraph;
+	cullingGraph.emplace(logicalDevice, gpuMemallocator);
+	std::optional<cof::RenderGraph> frameGraph;
+	frameGraph.emplace(logicalDevice, gpuMemallocator);
+
+	//Every frame waits on its fence before the next one, so a slot's timestamps are always available when it comes around again
+	constexpr uint32_t profilerFrameSlots{ 2 };
+	cof::GpuProfiler gpuProfiler{ logicalDevice, physicalDevice, graphicsQueueFamily, profilerFrameSlots, pipelineStatistics };
+	frameGraph->Profile(&gpuProfiler);
+
+	//Draw set culled by the compute queue and draw set drawn by the graphics queue
+	uint32_t cullSet{ 0 };
+	uint32_t drawSet{ 0 };
+
+	//The frame that last read a draw set has finished before it is culled again, so its previous contents need no dependency
+	const cof::RenderResource culledDrawCommands = cullingGraph->ImportBuffer("DrawCommands", drawCommandBuffers[0],
+		{ .stages = 0, .access = 0, .layout = VK_IMAGE_LAYOUT_UNDEFINED });
+	const cof::RenderResource culledDrawCount = cullingGraph->ImportBuffer("DrawCount", drawCountBuffers[0],
+		{ .stages = 0, .access = 0, .layout = VK_IMAGE_LAYOUT_UNDEFINED });
+
+	cullingGraph->MarkOutput(culledDrawCommands);
+	cullingGraph->MarkOutput(culledDrawCount);
+
+	cullingGraph->AddPass(
 	{
-		glfwPollEvents();
-		uint32_t imageIndex = swapchain.AcquireNextImage(std::numeric_limits<uint64_t>::max(), imageAvailableSemaphore.Handle(), VK_NULL_HANDLE);
+		.name = "ResetDrawCount",
+		.accesses = { { culledDrawCount, cof::ResourceUsage::TransferWrite } },
+		.execute = [&](VkCommandBuffer commandBuffer) { frustumCullingPasses[cullSet].RecordReset(commandBuffer); }
+	});
+
+	cullingGraph->AddPass(
+	{
+		.name = "FrustumCulling",
+		.accesses = { { culledDrawCommands, cof::ResourceUsage::ComputeWrite }, { culledDrawCount, cof::ResourceUsage::ComputeReadWrite } },
+		.execute = [&](VkCommandBuffer commandBuffer)
+		{
+			frustumCullingPasses[cullSet].RecordCulling(commandBuffer, cof::ExtractFrustum(drawConstants.viewProjection), instanceCount);
+		}
+	});
+
+	//Culls cullSet and hands it to the graphics queue, signaling cullingFinishedSemaphore
+	auto submitCulling = [&]()
+	{
+		VkCommandBufferBeginInfo beginInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+			.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
+		};
+
+		vkBeginCommandBuffer(computeCommandBuffer, &beginInfo);
+		if (measureQueueTimes)
+		{
+			vkCmdResetQueryPool(computeCommandBuffer, timestampQueryPool, computeQueryIndex, 2);
+			vkCmdWriteTimestamp(computeCommandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestampQueryPool, computeQueryIndex);
+		}
+
+		cullingGraph->SetBuffer(culledDrawCommands, drawCommandBuffers[cullSet]);
+		cullingGraph->SetBuffer(culledDrawCount, drawCountBuffers[cullSet]);
+		cullingGraph->Execute(computeCommandBuffer);
+
+		cof::RecordBufferRelease(computeCommandBuffer, { drawCommandBuffers[cullSet], drawCountBuffers[cullSet] },
+			computeQueueFamily, graphicsQueueFamily, cullingStages, cullingAccess);
+
+		if (measureQueueTimes)
+		{
+			vkCmdWriteTimestamp(computeCommandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestampQueryPool, computeQueryIndex + 1);
+		}
+
+		errorCode = vkEndCommandBuffer(computeCommandBuffer);
+		assert(errorCode == VK_SUCCESS);
+
+		VkSemaphore cullingSignalSemaphores[]{ cullingFinishedSemaphore.Handle() };
+
+		VkSubmitInfo cullingSubmitInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+			.commandBufferCount = 1,
+			.pCommandBuffers = &computeCommandBuffer,
+			.signalSemaphoreCount = static_cast<uint32_t>(std::size(cullingSignalSemaphores)),
+			.pSignalSemaphores = cullingSignalSemaphores
+		};
+
+		errorCode = vkQueueSubmit(computeQueue, 1, &cullingSubmitInfo, cullingFinishedFence);
+		assert(errorCode == VK_SUCCESS);
+	};
+
+	//Acquired images are waited on at the color attachment output stage, the barrier chains onto that wait
+	constexpr VkImageSubresourceRange colorRange{ .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .baseMipLevel = 0, .levelCount = 1, .baseArrayLayer = 0, .layerCount = 1 };
+
+	const cof::RenderResource swapchainImage = frameGraph->ImportImage("Swapchain", VK_NULL_HANDLE, colorRange,
+		{ .stages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, .access = 0, .layout = VK_IMAGE_LAYOUT_UNDEFINED });
+	//Depth never leaves the forward pass, so the graph gives it lazily allocated memory where the device has it
+	const cof::RenderResource depthImage = frameGraph->CreateImage("Depth", { cof::DepthBuffer::format, presentationTarget->Extent(), VK_IMAGE_ASPECT_DEPTH_BIT });
+	//The acquire barrier at the start of the frame already made the culled draws visible to the indirect draw stage
+	const cof::RenderResource drawCommands = frameGraph->ImportBuffer("DrawCommands", drawCommandBuffers[0],
+		{ .stages = drawStages, .access = 0, .layout = VK_IMAGE_LAYOUT_UNDEFINED });
+	const cof::RenderResource drawCount = frameGraph->ImportBuffer("DrawCount", drawCountBuffers[0],
+		{ .stages = drawStages, .access = 0, .layout = VK_IMAGE_LAYOUT_UNDEFINED });
+
+	frameGraph->MarkOutput(swapchainImage, presentationTarget->PresentLayout());
+
+	VkFramebuffer frameBuffer{ VK_NULL_HANDLE };
+
+	frameGraph->AddPass(
+	{
+		.name = "Forward",
+		.accesses =
+		{
+			{ drawCommands, cof::ResourceUsage::IndirectRead },
+			{ drawCount, cof::ResourceUsage::IndirectRead },
+			{ swapchainImage, cof::ResourceUsage::ColorWrite, presentationTarget->PresentLayout() },
+			{ depthImage, cof::ResourceUsage::DepthWrite }
+		},
+		.execute = [&](VkCommandBuffer commandBuffer)
+		{
+			VkClearValue clearValues[2]{};
+			clearValues[0].color = { 0.0f, 0.0f, 0.0f, 1.0f };
+			clearValues[1].depthStencil = { cof::DepthBuffer::clearDepth, 0 };
+
+			VkRenderPassBeginInfo renderPassInfo
+			{
+				.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+				.renderPass = forwardGeometryPass.Handle(),
+				.framebuffer = frameBuffer,
+				.renderArea =
+				{
+					.offset = {0, 0},
+					.extent = presentationTarget->Extent()
+				},
+				.clearValueCount = static_cast<uint32_t>(std::size(clearValues)),
+				.pClearValues = clearValues
+			};
+
+			vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+			vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(DrawConstants), &drawConstants);
+			vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+
+			if constexpr (depthPrepass)
+			{
+				VkDeviceSize positionOffset{ 0 };
+				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, prepassPipeline);
+				vkCmdBindVertexBuffers(commandBuffer, 0, 1, &positionBuffer, &positionOffset);
+				frustumCullingPasses[drawSet].RecordDraw(commandBuffer, instanceCount);
+				vkCmdNextSubpass(commandBuffer, VK_SUBPASS_CONTENTS_INLINE);
+			}
+
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+
+			if constexpr (!vertexPulling)
+			{
+				VkBuffer vertexBuffers[] = { vertexBuffer };
+				VkDeviceSize offsets[] = { 0 };
+				vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
+			}
+
+			frustumCullingPasses[drawSet].RecordDraw(commandBuffer, instanceCount);
+
+			vkCmdEndRenderPass(commandBuffer);
+		}
+	});
+
+	//Creates the depth image ahead of the framebuffers that reference it
+	frameGraph->Compile();
+
+	//The first frame draws a set culled up front, every frame after that culls the set of the next one
+	submitCulling();
+	vkWaitForFences(logicalDevice, 1, &cullingFinishedFence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+	vkResetFences(logicalDevice, 1, &cullingFinishedFence);
+
+	constexpr uint32_t overlapReportInterval{ 1000 };
+	cof::QueueOverlapSamples overlapSamples{};
+
+	constexpr uint32_t profilerReportInterval{ 1000 };
+	uint64_t frameNumber{ 0 };
+
+	//Pressing the key writes the CPU zones and GPU scopes recorded so far to traceFile
+	constexpr int traceKey{ GLFW_KEY_F12 };
+	constexpr const char* traceFile{ "NomadTrace.json" };
+	bool traceKeyDown{ false };
+
+	cof::SetCpuThreadName("Main");
+
+	const std::chrono::steady_clock::time_point loopStart{ std::chrono::steady_clock::now() };
+
+	while (options.headless ? frameNumber < options.frameCount : !glfwWindowShouldClose(window)) 
+	{
+		CPU_ZONE("Frame");
+
+		if (!options.headless)
+		{
+			{
+				CPU_ZONE("glfwPollEvents");
+				glfwPollEvents();
+			}
+
+			const bool traceKeyPressed{ glfwGetKey(window, traceKey) == GLFW_PRESS };
+			if (traceKeyPressed && !traceKeyDown)
+			{
+				printf("%s %s\n", cof::WriteChromeTrace(traceFile, gpuProfiler.TraceEvents()) ? "Wrote" : "Couldn't write", traceFile);
+			}
+			traceKeyDown = traceKeyPressed;
+		}
+
+		uint32_t imageIndex = presentationTarget->AcquireNextImage(imageAvailableSemaphore.Handle());
 
 		VkCommandBufferBeginInfo beginInfo
 		{
@@ -512,13 +1027,30 @@ int main()
 		};
 
 		vkBeginCommandBuffer(graphicsCommandBuffer, &beginInfo);
+		gpuProfiler.BeginFrame(graphicsCommandBuffer, static_cast<uint32_t>(frameNumber % profilerFrameSlots));
+		gpuProfiler.BeginScope(graphicsCommandBuffer, "Frame");
+
+		if (measureQueueTimes)
+		{
+			vkCmdResetQueryPool(graphicsCommandBuffer, timestampQueryPool, graphicsQueryIndex, 2);
+			vkCmdWriteTimestamp(graphicsCommandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestampQueryPool, graphicsQueryIndex);
+		}
+
+		cof::RecordBufferAcquire(graphicsCommandBuffer, { drawCommandBuffers[drawSet], drawCountBuffers[drawSet] },
+			computeQueueFamily, graphicsQueueFamily, drawStages, drawAccess);
+
+		//Streams this frame's share of the queued uploads and takes over whatever earlier frames finished
+		uploadStreamer->Submit(uploadFrameBudget);
+		gpuProfiler.BeginScope(graphicsCommandBuffer, "UploadAcquires");
+		const uint64_t uploadWaitValue{ uploadStreamer->RecordAcquires(graphicsCommandBuffer) };
+		gpuProfiler.EndScope(graphicsCommandBuffer);
 
 		VkImageViewCreateInfo createInfo
 		{
 			.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
-			.image = swapchain.Image(imageIndex),
+			.image = presentationTarget->Image(imageIndex),
 			.viewType = VK_IMAGE_VIEW_TYPE_2D,
-			.format = swapchain.ImageMetaData().format,
+			.format = presentationTarget->Format(),
 			.components = 
 			{
 				.r = VK_COMPONENT_SWIZZLE_IDENTITY,
@@ -539,57 +1071,53 @@ int main()
 		VkImageView imageView;
 		vkCreateImageView(logicalDevice, &createInfo, nullptr, &imageView);
 
+		VkImageView framebufferAttachments[]{ imageView, frameGraph->View(depthImage) };
+
 		VkFramebufferCreateInfo framebufferInfo
 		{
 			.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
 			.renderPass = forwardGeometryPass.Handle(),
-			.attachmentCount = 1,
-			.pAttachments = &imageView,
-			.width = swapchain.ImageMetaData().extent.width,
-			.height = swapchain.ImageMetaData().extent.height,
+			.attachmentCount = static_cast<uint32_t>(std::size(framebufferAttachments)),
+			.pAttachments = framebufferAttachments,
+			.width = presentationTarget->Extent().width,
+			.height = presentationTarget->Extent().height,
 			.layers = 1,
 		};
 
-		VkFramebuffer frameBuffer;
 		vkCreateFramebuffer(logicalDevice, &framebufferInfo, nullptr, &frameBuffer);
 
-		static VkClearValue clearColor{ 0.0f, 0.0f, 0.0f, 1.0f };
+		frameGraph->SetImage(swapchainImage, presentationTarget->Image(imageIndex));
+		frameGraph->SetBuffer(drawCommands, drawCommandBuffers[drawSet]);
+		frameGraph->SetBuffer(drawCount, drawCountBuffers[drawSet]);
+		frameGraph->Execute(graphicsCommandBuffer);
 
-		VkRenderPassBeginInfo renderPassInfo
+		if (measureQueueTimes)
 		{
-			.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
-			.renderPass = forwardGeometryPass.Handle(),
-			.framebuffer = frameBuffer,
-			.renderArea =
-			{
-				.offset = {0, 0},
-				.extent = swapchain.ImageMetaData().extent
-			},
-			.clearValueCount = 1,
-			.pClearValues = &clearColor
-		};
-
-		vkCmdBeginRenderPass(graphicsCommandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-		vkCmdBindPipeline(graphicsCommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
-
-		VkBuffer vertexBuffers[] = { vertexBuffer };
-		VkDeviceSize offsets[] = { 0 };
-		vkCmdBindVertexBuffers(graphicsCommandBuffer, 0, 1, vertexBuffers, offsets);
-
-		vkCmdDraw(graphicsCommandBuffer, static_cast<uint32_t>(vertices.size()), 1, 0, 0);
+			vkCmdWriteTimestamp(graphicsCommandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestampQueryPool, graphicsQueryIndex + 1);
+		}
 
-		vkCmdEndRenderPass(graphicsCommandBuffer);
+		gpuProfiler.EndScope(graphicsCommandBuffer);
 		errorCode = vkEndCommandBuffer(graphicsCommandBuffer);
 		assert(errorCode == VK_SUCCESS);
 
-		VkSemaphore waitSemaphores[] = { imageAvailableSemaphore.Handle() };
-		VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
+		VkSemaphore waitSemaphores[] = { imageAvailableSemaphore.Handle(), cullingFinishedSemaphore.Handle(), uploadStreamer->Semaphore() };
+		VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, drawStages, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT };
+		//Binary semaphores ignore their value, waiting on zero for the timeline is a no-op
+		uint64_t waitValues[] = { 0, 0, uploadWaitValue };
 		VkSemaphore signalSemaphores[] = { renderingFinishedSemaphore.Handle() };
 		VkCommandBuffer commandBuffers[]{ graphicsCommandBuffer };
 
+		VkTimelineSemaphoreSubmitInfo timelineInfo
+		{
+			.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+			.waitSemaphoreValueCount = static_cast<uint32_t>(std::size(waitValues)),
+			.pWaitSemaphoreValues = waitValues
+		};
+
 		VkSubmitInfo submitInfo
 		{
 			.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+			.pNext = &timelineInfo,
 			.waitSemaphoreCount = static_cast<uint32_t>(std::size(waitSemaphores)),
 			.pWaitSemaphores = waitSemaphores,
 			.pWaitDstStageMask = waitStages,
@@ -598,34 +1126,69 @@ int main()
 			.signalSemaphoreCount = static_cast<uint32_t>(std::size(signalSemaphores)),
 			.pSignalSemaphores = signalSemaphores
 		};
-		
-		VkQueue graphicsQueue;
-		vkGetDeviceQueue(logicalDevice, gpuContext.QueueFamilyIndex<VK_QUEUE_GRAPHICS_BIT>(), 0, &graphicsQueue);
-		errorCode = vkQueueSubmit(graphicsQueue, 1, &submitInfo, renderingFinishedFence);
 
+		//Every other frame of --overlap waits for graphics before culling, the same work with the queues back to back
+		const bool serializeQueues{ options.measureOverlap && frameNumber % 2 == 1 };
+		const std::chrono::steady_clock::time_point submitStart{ std::chrono::steady_clock::now() };
+
+		{
+			CPU_ZONE("vkQueueSubmit");
+			errorCode = vkQueueSubmit(graphicsQueue, 1, &submitInfo, renderingFinishedFence);
+		}
+		gpuProfiler.Submitted();
+
+		if (serializeQueues)
+		{
+			CPU_ZONE("SerializeQueues");
+			vkWaitForFences(logicalDevice, 1, &renderingFinishedFence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+		}
+
+		//Culls the next frame's draws while this frame renders
+		cullSet = (drawSet + 1) % drawSetCount;
+		{
+			CPU_ZONE("SubmitCulling");
+			submitCulling();
+		}
 		
-		VkFence waitFences[]{ renderingFinishedFence };
+		VkFence waitFences[]{ renderingFinishedFence, cullingFinishedFence };
 		const uint32_t numWaitFences{ static_cast<uint32_t>(std::size(waitFences)) };
 		
-		vkWaitForFences(logicalDevice, numWaitFences, waitFences, VK_TRUE, std::numeric_limits<uint64_t>::max());
-		vkResetFences(logicalDevice, numWaitFences, waitFences);
+		{
+			CPU_ZONE("vkWaitForFences");
+			vkWaitForFences(logicalDevice, numWaitFences, waitFences, VK_TRUE, std::numeric_limits<uint64_t>::max());
+			vkResetFences(logicalDevice, numWaitFences, waitFences);
+		}
+
+		if (options.measureOverlap)
+		{
+			const std::chrono::duration<double, std::milli> submitTime{ std::chrono::steady_clock::now() - submitStart };
+			overlapSamples.AddFrame(serializeQueues, submitTime.count());
 
-		VkSwapchainKHR swapchains[] = { swapchain.Handle() };
+			uint64_t timestamps[4];
+			if (measureQueueTimes && vkGetQueryPoolResults(logicalDevice, timestampQueryPool, 0, 4, sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) == VK_SUCCESS)
+			{
+				overlapSamples.AddTimestamps(timestamps, physicalDeviceProperties.limits.timestampPeriod);
+			}
 
-		VkPresentInfoKHR presentInfo
+			if (overlapSamples.overlappedFrames + overlapSamples.serializedFrames == overlapReportInterval)
+			{
+				cof::MeasureQueueOverlap(overlapSamples).Print();
+				overlapSamples = {};
+			}
+		}
+
+		if (++frameNumber % profilerReportInterval == 0)
 		{
-			.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
-			.waitSemaphoreCount = static_cast<uint32_t>(std::size(signalSemaphores)),
-			.pWaitSemaphores = signalSemaphores,
-			.swapchainCount = static_cast<uint32_t>(std::size(swapchains)),
-			.pSwapchains = swapchains,
-			.pImageIndices = &imageIndex
-		};
+			gpuProfiler.Print();
+			gpuProfiler.PrintStatistics(presentationTarget->Extent().width * presentationTarget->Extent().height);
+		}
+
+		drawSet = cullSet;
 
 		VkQueue presentQueue;
 		vkGetDeviceQueue(logicalDevice, presentQueueFamilyIndex, 0, &presentQueue);
 
-		vkQueuePresentKHR(presentQueue, &presentInfo);
+		presentationTarget->Present(presentQueue, renderingFinishedSemaphore.Handle(), imageIndex);
 
 		vkDestroyFramebuffer(logicalDevice, frameBuffer, nullptr);
 		vkDestroyImageView(logicalDevice, imageView, nullptr);
@@ -633,10 +1196,41 @@ int main()
 
 	vkDeviceWaitIdle(logicalDevice);
 
+	//Includes the wait for the last frame, the GPU profiler has the breakdown
+	const std::chrono::duration<double, std::milli> loopTime{ std::chrono::steady_clock::now() - loopStart };
+	printf("%llu frames, %.3f ms per frame\n", static_cast<unsigned long long>(frameNumber), frameNumber == 0 ? 0.0 : loopTime.count() / static_cast<double>(frameNumber));
+	gpuProfiler.Print();
+
+	if (options.tracePath != nullptr)
+	{
+		printf("%s %s\n", cof::WriteChromeTrace(options.tracePath, gpuProfiler.TraceEvents()) ? "Wrote" : "Couldn't write", options.tracePath);
+	}
+	if (options.savePath != nullptr)
+	{
+		//The swapchain's images belong to the presentation engine, only offscreen frames can be saved
+		const bool saved{ offscreenTarget != nullptr && offscreenTarget->Save(options.savePath) };
+		printf("%s %s\n", saved ? "Saved" : "Couldn't save", options.savePath);
+	}
+
+	presentationTarget.reset();
+	frameGraph.reset();
+	cullingGraph.reset();
+	uploadStreamer.reset();
+	for (uint32_t set{}; set < drawSetCount; ++set)
+	{
+		vmaDestroyBuffer(gpuMemallocator, drawCountBuffers[set], drawCountAllocations[set]);
+		vmaDestroyBuffer(gpuMemallocator, drawCommandBuffers[set], drawCommandAllocations[set]);
+	}
+	vmaDestroyBuffer(gpuMemallocator, instanceBuffer, instanceAllocation);
+	vmaDestroyBuffer(gpuMemallocator, positionBuffer, positionAllocation);
+	vmaDestroyBuffer(gpuMemallocator, indexBuffer, indexAllocation);
 	vmaDestroyBuffer(gpuMemallocator, vertexBuffer, vertexAllocation);
 	vmaDestroyAllocator(gpuMemallocator);
 
+	vkDestroyQueryPool(logicalDevice, timestampQueryPool, nullptr);
+	vkDestroyFence(logicalDevice, cullingFinishedFence, nullptr);
 	vkDestroyFence(logicalDevice, renderingFinishedFence, nullptr);
+	vkDestroyPipeline(logicalDevice, prepassPipeline, nullptr);
 	vkDestroyPipeline(logicalDevice, graphicsPipeline, nullptr);
 	vkDestroyPipelineLayout(logicalDevice, pipelineLayout, nullptr);
 